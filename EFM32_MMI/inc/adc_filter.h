@@ -0,0 +1,57 @@
+/*******************************************************************
+**                                                                **
+** ADC samples filtering and scaling functions.                   **
+** Hardware independent, can be compiled on any host.             **
+**                                                                **
+*******************************************************************/
+
+#ifndef __ADC_FILTER_H__
+#define __ADC_FILTER_H__
+
+/** \addtogroup MMI MyMeterInfo add-on functions
+ *  @{
+ */
+
+/*!
+ * @brief Samples reduction methods
+ */
+typedef enum {
+	ADCFilterMean = 0,			//!< Plain mean value of all samples
+	ADCFilterMedian = 1,		//!< Median value, rejects any isolated outlier
+	ADCFilterTrimmedMean = 2	//!< Mean value of the samples left after removing the lowest and highest quarters
+} ADC_FILTER;
+
+/*!
+ * @brief Reduce a buffer of ADC samples to a single value
+ * @param [in,out] samples	Samples buffer, sorted in place by ADCFilterMedian and ADCFilterTrimmedMean
+ * @param [in] count		Number of samples in buffer
+ * @param [in] filter		Reduction method
+ * @return 					Reduced value, rounded to nearest (0 if no samples)
+ */
+long ADCFilterSamples(short* samples, int count, ADC_FILTER filter);
+/*!
+ * @brief Make the samples of a differential capture positive
+ * @param [in,out] samples	Samples buffer, negative samples are negated in place (-32768 saturates to 32767)
+ * @param [in] count		Number of samples in buffer
+ */
+void ADCFilterRectify(short* samples, int count);
+/*!
+ * @brief Convert an ADC value measured on the 4-20 mA loop 120 Ohms shunt resistor in µA
+ * @param [in] value		ADC value (negative values are clipped to 0)
+ * @param [in] reference_mV	ADC voltage reference in mV
+ * @param [in] fullScale	ADC value that matches the reference voltage (half of the ADC full scale in differential mode)
+ * @return 					Loop current in µA
+ */
+unsigned long ADCScale4_20mA(long value, int reference_mV, int fullScale);
+/*!
+ * @brief Convert an ADC value measured behind the 0-10 V input 1/4 divider in mV
+ * @param [in] value		ADC value (negative values are clipped to 0)
+ * @param [in] reference_mV	ADC voltage reference in mV
+ * @param [in] fullScale	ADC value that matches the reference voltage (half of the ADC full scale in differential mode)
+ * @return 					Input voltage in mV
+ */
+unsigned long ADCScale0_10V(long value, int reference_mV, int fullScale);
+
+/** }@ */
+
+#endif
@@ -13,6 +13,7 @@
 
 #define CRC16_CCITT		0x1021  //!< @brief CCITT Standard CRC16 polynomial for X25/XMODEM/SD/HDLC/Bluetooth etc...
 #define CRC16_ANSI      0x8005 	//!< @brief ANSI/IBM CRC16 polynomial for BiSync/MODBUS/USB etc...
+#define CRC16_CCITT_INIT	0xFFFF	//!< @brief Initial value of the CCITT CRC16 of the USERDATA and records
 //! Macro to calculate standard CCITT CRC16 value
 #define CRC16_Calculate(b,c)  CRC16_CalculatePolynomial((b),(c),CRC16_CCITT)
 //! Macro to calculate standard CCITT CRC16 on memory range
@@ -28,6 +29,8 @@
 unsigned short CRC16_CalculatePolynomial(const unsigned char Byte, const unsigned short prevCrc, const unsigned short Polynomial);
 /*!
  * @brief Calculates a memory range CRC value on 16 bits, using any CRC polynom
+ * @remark The CRC16_CCITT polynomial is table driven, define CRC16_NIBBLE_TABLE to trade speed for a smaller table,
+ *         CRC16_SLICE_BY_4 to trade a larger table for speed, or CRC16_GPCRC to use the GPCRC peripheral
  * @param [in] Buffer		Buffer address to calculate CRC on
  * @param [in] length		Length of the provided buffer
  * @param [in] prevCrc		Previous value of the CRC
@@ -35,6 +38,25 @@ unsigned short CRC16_CalculatePolynomial(const unsigned char Byte, const unsigne
  * @return 					New CRC value
  */
 unsigned short CRC16_CalculateRangePolynomial(const unsigned char* Buffer, unsigned short length, unsigned short prevCrc, const unsigned short Polynomial);
+/*!
+ * @brief Start a streamed CCITT CRC16 computation
+ * @return 					Initial CRC value
+ */
+unsigned short CRC16_Init(void);
+/*!
+ * @brief Add a memory range to a streamed CCITT CRC16 computation
+ * @param [in] crc			CRC value returned by CRC16_Init or the previous CRC16_Update
+ * @param [in] Buffer		Buffer address to calculate CRC on
+ * @param [in] length		Length of the provided buffer
+ * @return 					New CRC value
+ */
+unsigned short CRC16_Update(unsigned short crc, const void* Buffer, unsigned short length);
+/*!
+ * @brief End a streamed CCITT CRC16 computation
+ * @param [in] crc			CRC value returned by the last CRC16_Update
+ * @return 					CRC of all the ranges, same as CRC16_CalculateRange over their concatenation
+ */
+unsigned short CRC16_Final(unsigned short crc);
 
 /** }@ */
 
@@ -39,6 +39,15 @@ short zoneOffset;		//!< Time Zone offset in hours
  * @param[out] dt		DATETIME_STRUCT to populate
  */
 void DateTimeFromSeconds(const unsigned long seconds, DATETIME_STRUCT* dt);
+/*!
+ * Converts an array of GMT number of seconds from 01/01/2000 into DATETIME_STRUCT
+ * @note Date is only computed once for consecutive values of the same day,
+ * which is the common case for historical records.
+ * @param[in] seconds	Array of number of seconds since 01/01/2000 to convert
+ * @param[out] dt		Array of DATETIME_STRUCT to populate
+ * @param[in] count		Number of values to convert
+ */
+void DateTimeFromSecondsBatch(const unsigned long* seconds, DATETIME_STRUCT* dt, int count);
 
 /*!
  * Returns the number of elapsed days until a month for a specific year.
@@ -91,9 +91,23 @@ typedef enum {
 	JOIN_COMPLETED,
 	SYSTEM_RESET,
 	RUN_TEST_EVENT,
+	LINK_STATS_EVENT,		//!< Send the link quality report - Manually set @hideinitializer
+	CRASH_REPORT_EVENT,		//!< Send the crash report - Manually set @hideinitializer
+	EVENT_COUNT,			//!< Number of event types, not an event @hideinitializer
 	UNKNOWN_EVENT	= 255	//!< Undefined event @hideinitializer
 } EVENT_TYPE;
 
+/*!
+ * @brief Event dispatcher pressure counters
+ */
+typedef struct {
+	unsigned long Posted;		//!< Number of events sent or posted
+	unsigned long Coalesced;	//!< Number of events merged with an already pending identical event
+	unsigned long Dispatched;	//!< Number of events returned by DeviceWaitForEvent
+	unsigned char Pending;		//!< Number of events currently pending
+	unsigned char MaxPending;	//!< Highest number of simultaneously pending events
+} EVENT_STATS;
+
 /* User data management */
 #define USERPAGE    0x0FE00000 	//!< Address of the user page in FLASH memory @hideinitializer
 /** @cond */
@@ -307,6 +321,10 @@ void DevicePulseInEnable(BOOL bEnable);
  * @return the number of values
  */
 unsigned long DeviceGetPulseInNumber(void);
+/*!
+ * @brief Clear DEVICE_PULSE_OFF so that the next pulse posts a PULSE_EVENT
+ */
+void DevicePulseInRearm(void);
 /*!
  * @brief return a pointer to a pulse value accumulator
  * @param[in] pulse pulse index pointer to return
@@ -349,13 +367,24 @@ void DeviceShowErrorCode(int code);
  * @param[in] led		system LED to flash
  * @param[in] number	number of flashes to execute
  * @param[in] duration	duration of each flash
+ * @remark Flashes are played in the background, see led_pattern.h
  */
 void DeviceFlashOneLedExt(LIST_INDEX led, short number, short duration);
 //! @brief Macro to issue a normal flash to a LED
 #define DeviceFlashOneLed(l,n) DeviceFlashOneLedExt((l),(n),LED_FLASH_NORMAL)
+/*!
+ * @brief Flash a system LED to signal an error or an alarm
+ * @param[in] led		system LED to flash
+ * @param[in] number	number of flashes to execute
+ * @param[in] duration	duration of each flash
+ * @remark Preempts the flashes of @ref DeviceFlashOneLedExt, which cannot interrupt it
+ */
+void DeviceAlertOneLedExt(LIST_INDEX led, short number, short duration);
 /* Single led platform */
 //! @brief Macro to flash LED0
 #define DeviceFlashLed(n) DeviceFlashOneLedExt(0,(n),LED_FLASH_NORMAL)
+//! @brief Macro to flash LED0 for an error or an alarm
+#define DeviceAlertLed(n) DeviceAlertOneLedExt(0,(n),LED_FLASH_NORMAL)
 //! @brief Macro to get LED0 current state
 #define DeviceGetLedState() DeviceGetLedStateExt(0)
 /*!
@@ -473,25 +502,43 @@ unsigned long DeviceGetBatteryVoltage(void);
 /*!
  * @brief Waits for a device event
  * @param[in] duration	Duration of device event wait (in system ticks)
- * @return an event value or 0 if no event occurred after duration
+ * @return the oldest pending event of the highest priority class or 0 if no event occurred after duration
  */
 EVENT_TYPE DeviceWaitForEvent(portTickType duration);
 /*!
- * @brief Sends a event to the event queue back (to be execute after all pending events)
+ * @brief Get the payload merged into the last event returned by DeviceWaitForEvent
+ * @return the payload bits (0 if none)
+ */
+unsigned long DeviceGetEventPayload(void);
+/*!
+ * @brief Sets an event pending
+ * @remark Pending events are dispatched according to their priority, an event already pending is not queued twice
  * @param[in] event type
  */
 void DeviceSendEvent(EVENT_TYPE event);
 /*!
- * @brief Posts an event to the event queue front (to be executed before any pending events)
+ * @brief Sets an event pending
+ * @remark Same as DeviceSendEvent, kept for compatibility
  * @param[in] event type
  */
 void DevicePostEvent(EVENT_TYPE event);
 /*!
- * @brief Posts an event to the event queue front (to be executed before any pending events)
+ * @brief Sets an event pending and ORs payload bits into its payload slot
+ * @param[in] event type
+ * @param[in] payload bits to merge with the event pending payload
+ */
+void DevicePostEventPayload(EVENT_TYPE event, unsigned long payload);
+/*!
+ * @brief Sets an event pending
  * @remark Must be used when called from an ISR.
  * @param[in] event type
  */
 void DevicePostEventFromISR(EVENT_TYPE event);
+/*!
+ * @brief Get a snapshot of the event dispatcher pressure counters
+ * @param[out] stats Counters snapshot
+ */
+void DeviceGetEventStats(EVENT_STATS* stats);
 
 /** }@ */
 
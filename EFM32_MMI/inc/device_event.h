@@ -0,0 +1,172 @@
+/*******************************************************************
+**                                                                **
+** Device Event Handling Implementation File                      **
+** Included once by device_impl.h, and by the host tests          **
+**                                                                **
+*******************************************************************/
+#ifndef __DEVICE_EVENT_H__
+#define __DEVICE_EVENT_H__
+#include <string.h>
+#include "device_def.h"
+
+/*
+ * Device Event Handling
+ *
+ * Pending events are kept in a bit set indexed by event rank (bit 0 = first
+ * event of the highest priority class). Posting an event only sets its bit,
+ * so posting is O(1), is safe from ISR and identical pending events are always
+ * merged together instead of filling a queue. DeviceWaitForEvent returns an
+ * event of the highest priority class pending, and the events of a same class
+ * in the order they were first posted.
+ */
+/** @cond */
+//! @brief Events ranks, by priority class from highest to lowest priority
+static const EVENT_TYPE EventPriorityOrder[] = {
+	SYSTEM_RESET, RESET_EVENT, POWER_FAIL_EVENT, BATTERYLOW_EVENT, ERROR_EVENT, RF_ERROR_EVENT,
+	RF_MLME, RF_INDICATION,
+	RUN_ATTACH, RUN_ATTACH_USE_OTTA, RUN_ATTACH_USE_ABP,
+	PSEUDO_JOIN_NETWORK, PSEUDO_JOIN_NETWORK_COMPLETED,
+	REQ_REAL_APP_KEY_ALLOC, REAL_APP_KEY_ALLOC_COMPLETED,
+	REQ_REAL_APP_KEY_RX_REPORT, REAL_APP_KEY_RX_REPORT_COMPLETED,
+	REAL_JOIN_NETWORK, REAL_JOIN_NETWORK_COMPLETED, JOIN_COMPLETED,
+	BUTTON_EVENT, RELOAD_EVENT, USER_EVENT, RUN_TEST_EVENT,
+	LINK_STATS_EVENT, CRASH_REPORT_EVENT, PERIODIC_RESEND, PERIODIC_EVENT, PULSE_EVENT
+};
+//! @brief Number of events of each priority class (system, radio, join, user, background)
+static const uint8_t EventClassSize[] = { 6, 2, 12, 4, 5 };
+#define EVENT_PRIORITY_COUNT	(sizeof(EventPriorityOrder)/sizeof(EventPriorityOrder[0]))
+#define EVENT_CLASS_COUNT		(sizeof(EventClassSize)/sizeof(EventClassSize[0]))
+// Every dispatchable event must have a rank and all ranks must fit in the pending bit set
+typedef char EVENT_PRIORITY_ORDER_CHECK[((EVENT_PRIORITY_COUNT == (EVENT_COUNT - 1)) && (EVENT_PRIORITY_COUNT <= 32)) ? 1 : -1];
+
+static uint8_t EventRank[EVENT_COUNT];					// Event -> priority rank (bit number)
+static uint32_t EventClassMask[EVENT_CLASS_COUNT];		// Ranks of each priority class
+static volatile uint32_t EventPending = 0;				// Pending events bit set
+static uint32_t EventSequence = 0;						// Posting order counter
+static uint32_t EventPostOrder[EVENT_COUNT];			// Posting order of the pending events
+static volatile unsigned long EventPayload[EVENT_COUNT];	// Per event payload slots
+static unsigned long EventCurrentPayload = 0;			// Payload of the last dispatched event
+static EVENT_STATS EventStats;
+static SemaphoreHandle_t xEventSignal = NULL;
+static StaticSemaphore_t xEventSignalBuffer;
+/** @endcond */
+
+static inline void DeviceEventInit(void) {
+	unsigned int rank = 0;
+	for (unsigned int i = 0; i < EVENT_PRIORITY_COUNT; i++)
+		EventRank[EventPriorityOrder[i]] = (uint8_t)i;
+	for (unsigned int i = 0; i < EVENT_CLASS_COUNT; i++) {
+		EventClassMask[i] = ((EventClassSize[i] < 32) ? (0x01UL << EventClassSize[i]) : 0) - 1;
+		EventClassMask[i] <<= rank;
+		rank += EventClassSize[i];
+	}
+	configASSERT(rank == EVENT_PRIORITY_COUNT);
+	EventPending = 0;
+	memset((void*)EventPayload,0,sizeof(EventPayload));
+	memset(&EventStats,0,sizeof(EventStats));
+	xEventSignal = xSemaphoreCreateBinaryStatic(&xEventSignalBuffer);
+}
+
+/*!
+ * @brief Mark an event as pending and merge its payload
+ * @remark Must be called with interrupts masked
+ * @return true if the event was not already pending
+ */
+static inline BOOL DeviceEventMark(EVENT_TYPE event, unsigned long payload) {
+	uint32_t mask = 0x01UL << EventRank[event];
+	EventPayload[event] |= payload;
+	EventStats.Posted++;
+	if (EventPending & mask) {
+		EventStats.Coalesced++;
+		return false;
+	}
+	EventPending |= mask;
+	EventPostOrder[event] = EventSequence++;
+	if (++EventStats.Pending > EventStats.MaxPending) EventStats.MaxPending = EventStats.Pending;
+	return true;
+}
+
+/*!
+ * @brief Remove the oldest pending event of the highest priority class from the pending set
+ * @return the event or IDLE_EVENT if nothing is pending
+ */
+static EVENT_TYPE DeviceEventTake(void) {
+EVENT_TYPE evt = IDLE_EVENT;
+	taskENTER_CRITICAL();
+	for (unsigned int i = 0; i < EVENT_CLASS_COUNT; i++) {
+		uint32_t pending = EventPending & EventClassMask[i];
+		if (!pending) continue;
+		// Oldest pending event of the class
+		evt = EventPriorityOrder[__builtin_ctz(pending)];
+		for (pending &= pending - 1; pending; pending &= pending - 1) {
+			EVENT_TYPE next = EventPriorityOrder[__builtin_ctz(pending)];
+			if ((int32_t)(EventPostOrder[next] - EventPostOrder[evt]) < 0) evt = next;
+		}
+		EventPending &= ~(0x01UL << EventRank[evt]);
+		EventCurrentPayload = EventPayload[evt];
+		EventPayload[evt] = 0;
+		EventStats.Pending--;
+		EventStats.Dispatched++;
+		break;
+	}
+	taskEXIT_CRITICAL();
+	return evt;
+}
+
+EVENT_TYPE DeviceWaitForEvent(portTickType duration) {
+EVENT_TYPE evt;
+TimeOut_t timeout;
+	if (!xEventSignal) return IDLE_EVENT;
+	vTaskSetTimeOutState(&timeout);
+	for (;;) {
+		if ((evt = DeviceEventTake()) != IDLE_EVENT) return evt;
+		if (xSemaphoreTake(xEventSignal,duration) != pdTRUE) return IDLE_EVENT;
+		if ((evt = DeviceEventTake()) != IDLE_EVENT) return evt;
+		// Stale signal, the event was already dispatched: wait for the remaining time
+		if (xTaskCheckForTimeOut(&timeout,&duration) != pdFALSE) return IDLE_EVENT;
+	}
+}
+unsigned long DeviceGetEventPayload(void) {
+	return EventCurrentPayload;
+}
+void DevicePostEventPayload(EVENT_TYPE event, unsigned long payload) {
+	if (xEventSignal && (event > IDLE_EVENT) && (event < EVENT_COUNT)) {
+		BOOL signal;
+		taskENTER_CRITICAL();
+		signal = DeviceEventMark(event,payload);
+		taskEXIT_CRITICAL();
+		if (signal) xSemaphoreGive(xEventSignal);
+	}
+}
+void DeviceSendEvent(EVENT_TYPE event) {
+	DevicePostEventPayload(event,0);
+}
+void DevicePostEvent(EVENT_TYPE event) {
+	DevicePostEventPayload(event,0);
+}
+static signed portBASE_TYPE DevicePostEventPayloadFromISR(EVENT_TYPE event, unsigned long payload) {
+	signed portBASE_TYPE sHigherPriorityTaskWoken = pdFALSE;
+	if (xEventSignal && (event > IDLE_EVENT) && (event < EVENT_COUNT)) {
+		BOOL signal;
+		UBaseType_t mask = portSET_INTERRUPT_MASK_FROM_ISR();
+		signal = DeviceEventMark(event,payload);
+		portCLEAR_INTERRUPT_MASK_FROM_ISR(mask);
+		if (signal) xSemaphoreGiveFromISR(xEventSignal,&sHigherPriorityTaskWoken);
+	}
+	return sHigherPriorityTaskWoken;
+}
+void DevicePostEventFromISR(EVENT_TYPE event) {
+	portEND_SWITCHING_ISR( DevicePostEventPayloadFromISR(event,0) );
+}
+static signed portBASE_TYPE DeviceSendEventFromISR(EVENT_TYPE event) {
+	return DevicePostEventPayloadFromISR(event,0);
+}
+void DeviceGetEventStats(EVENT_STATS* stats) {
+	if (stats) {
+		taskENTER_CRITICAL();
+		*stats = EventStats;
+		taskEXIT_CRITICAL();
+	}
+}
+
+#endif
@@ -18,6 +18,13 @@
 /* Hardware Init */
 
 #include <mmi_adc.h>
+#include <adc_filter.h>
+#include <zacwire.h>
+#include <sht_convert.h>
+#include <mmi_timer.h>
+#include "EFMEnergy.h"
+#include "led_pattern.h"
+#include "crash.h"
 #include <flash.h>
 #include <crc16.h>
 #include <string.h>
@@ -45,10 +52,6 @@ extern const SystemPort HAL[];
 #define HAL_CPU_SPEED	DEFAULTSPEED
 #endif
 
-#ifndef EVENT_QUEUE_SIZE
-#define EVENT_QUEUE_SIZE	16
-#endif
-static xQueueHandle xEventQueue = 0;
 #ifndef HAL_NB_BUTTON
 #define HAL_NB_BUTTON 0
 #endif
@@ -65,6 +68,17 @@ static volatile LIST_INDEX ButtonNumber = 0;
 #if HAL_NB_PULSE_IN > 0
 static volatile unsigned long PulseInValue[HAL_NB_PULSE_IN];
 #endif
+#if (HAL_NB_PULSE_IN > 0) && (NODE_TEMP == 0) && (NODE_PULSE > 0) && defined(PULSE_PCNT_LOCATION)
+#define PULSE_PCNT		1
+#ifndef PULSE_PCNT_INPUT
+#define PULSE_PCNT_INPUT	0	// Pulse input routed to PULSE_PCNT_LOCATION
+#endif
+#else
+#define PULSE_PCNT		0
+#endif
+#ifndef PULSE_DEBOUNCE_MS
+#define PULSE_DEBOUNCE_MS	10	// Shortest time between two pulses of an edge IRQ input, closer edges are bounces
+#endif
 /** @endcond */
 
 /* Replace Timer based 1ms wait functions with FreeRTOS based ones
@@ -136,51 +150,7 @@ unsigned char* DeviceApplicationBuild(void) {
 	return (unsigned char*)__DATE__" "__TIME__;
 }
 
-/*
- * Device Event Handling
- */
-static StaticQueue_t xStaticEventQueue;
-static uint8_t ucEventQueueStorageArea[ EVENT_QUEUE_SIZE * sizeof(EVENT_TYPE) ];
-
-static inline void DeviceEventInit(void) {
-	xEventQueue = xQueueCreateStatic(EVENT_QUEUE_SIZE,sizeof(EVENT_TYPE),ucEventQueueStorageArea,&xStaticEventQueue);
-}
-
-EVENT_TYPE DeviceWaitForEvent(portTickType duration) {
-EVENT_TYPE evt;
-	if (xEventQueue) {
-		if (xQueueReceive(xEventQueue,&evt,duration) == pdTRUE) return evt;
-	}
-	return IDLE_EVENT;
-}
-void DeviceSendEvent(EVENT_TYPE event) {
-	if (xEventQueue) {
-		xQueueSendToBack(xEventQueue,&event,0);
-	}
-}
-void DevicePostEvent(EVENT_TYPE event) {
-	if (xEventQueue) {
-		EVENT_TYPE e;
-		// Ignore already waiting event (avoid redondency)
-		if ((xQueuePeek(xEventQueue,&e,0) == pdTRUE) && (e == event)) return;
-		xQueueSendToFront(xEventQueue,&event,0);
-	}
-}
-void DevicePostEventFromISR(EVENT_TYPE event) {
-	if (xEventQueue) {
-		EVENT_TYPE e;
-		// Ignore already waiting event (avoid redondency)
-		if ((xQueuePeekFromISR(xEventQueue,&e) == pdTRUE) && (e == event)) return;
-		xQueueSendToFrontFromISR(xEventQueue,&event,NULL);
-	}
-}
-static signed portBASE_TYPE DeviceSendEventFromISR(EVENT_TYPE event) {
-	signed portBASE_TYPE sHigherPriorityTaskWoken = pdFALSE;
-	if (xEventQueue) {
-		xQueueSendToBackFromISR(xEventQueue,&event,&sHigherPriorityTaskWoken);
-	}
-	return sHigherPriorityTaskWoken;
-}
+#include "device_event.h"
 
 /*
  * Device Power Management handling
@@ -311,16 +281,22 @@ void DevicePressAlternateButton(LIST_INDEX button) {
 #endif
 }
 #if HAL_NB_BUTTON > 0
+/*
+ * The LED blinks from the pattern engine while the task only waits for the button release,
+ * then a short pause followed by the LED steady on shows that the step was reached.
+ */
+/** @cond */
+static const LEDPATTERN_STEP ButtonStepSteps[] = { { 0, 50, 1 }, { 0, 0, 0 } };
+static const LEDPATTERN ButtonStepPattern = { ButtonStepSteps, 1, LEDPATTERN_PRIORITY_FLASH };
+/** @endcond */
 static inline BOOL DeviceWaitForAlternateButton(LIST_INDEX button, unsigned short time, unsigned short period) {
-	if (!period) period = time;
-	for (unsigned short i=(time/period);i; i--) {
-		if (!DeviceCheckAlternateButtonIsStillDown(button,period)) { // Button released
-			return 0;
-		}
-		DeviceFlashLed((i%2) ? LED_FLASH_OFF : LED_FLASH_ON);
-	}
-    DeviceFlashLed(LED_FLASH_OFF); SysTimerWait1ms(50);
-    DeviceFlashLed(LED_FLASH_ON);
+	BOOL held;
+	if (period && (period < time)) LEDPATTERN_Flash(0, 0, period);
+	held = DeviceCheckAlternateButtonIsStillDown(button,time);
+	LEDPATTERN_StopFlash(0);
+	if (!held) return 0;	// Button released
+	LEDPATTERN_SetSteady(0, true);
+	LEDPATTERN_Play(0, &ButtonStepPattern);
 	return 1;
 }
 #endif
@@ -356,13 +332,99 @@ BOOL DevicePerformKeypressTasks(LIST_INDEX button,const BUTTON_TASKLIST* tasks)
 #elif (NODE_ANALOG > 0)
 // Nothing to do for analog sensor
 #else
+#include <pulse_count.h>
+#include <timebase.h>
+/*
+ * The inputs counted by their edge IRQ are debounced in software: an edge closer than
+ * PULSE_DEBOUNCE_MS to the last pulse of the input is a contact bounce or a glitch.
+ */
+/** @cond */
+static unsigned long PulseInLastEdge[HAL_NB_PULSE_IN];	// Time base ticks of the last pulse
+/** @endcond */
+#if (PULSE_PCNT > 0)
+#include <em_cmu.h>
+#include <em_gpio.h>
+#include <em_pcnt.h>
+/*
+ * The PULSE_PCNT_INPUT input clocks PCNT0 itself, so it keeps counting down to EM3 without
+ * waking the core. Its value is brought up to date when it is read and by the counter overflow
+ * IRQ, the only periodic wake up. The input edge IRQ is only enabled while a PULSE_EVENT is
+ * expected, that is while DEVICE_PULSE_OFF is clear. The PCNT has no filter when clocked by the
+ * pin, so the pin glitch filter is enabled instead: it removes spikes, not contact bounces, which
+ * need a RC filter on these inputs. The JG1 has a single PCNT and no other counter running in
+ * EM2/EM3, the other inputs keep their edge IRQ.
+ */
+/** @cond */
+#define PULSE_PCNT_TOP		0xFFFF
+static unsigned short PulsePcntLast = 0;	// Counter value when the input value was updated
+static BOOL PulsePcntOn = false;
+/** @endcond */
+
+static void DevicePulsePcntSync(void) {
+	unsigned short cnt;
+	if (!PulsePcntOn) return;
+	SystemIrqDisable();
+	// The counter runs on the pulse clock, read it until two reads agree
+	do {
+		cnt = (unsigned short)PCNT_CounterGet(PCNT0);
+	} while (cnt != (unsigned short)PCNT_CounterGet(PCNT0));
+	PulseInValue[PULSE_PCNT_INPUT] += PulseCountDelta(&PulsePcntLast, cnt);
+	SystemIrqEnable();
+}
+__interrupt_handler __attribute__((used)) void PCNT0_IRQHandler(void) {
+	PCNT_IntClear(PCNT0, PCNT_IF_OF);
+	DevicePulsePcntSync();
+}
+static void DevicePulsePcntEnable(BOOL bEnable) {
+	PCNT_Init_TypeDef init = PCNT_INIT_DEFAULT;
+
+	// Keep the pulses counted so far
+	DevicePulsePcntSync();
+	PulsePcntOn = false;
+	NVIC_DisableIRQ(PCNT0_IRQn);
+	if (!bEnable) {
+		PCNT_Enable(PCNT0, pcntModeDisable);
+		return;
+	}
+	// Register writes are synchronized to LFACLK before switching to the pulse clock. LFA is
+	// left alone if it has a source, otherwise it takes the RTCC one that is already running.
+	if (CMU_ClockSelectGet(cmuClock_LFA) == cmuSelect_Disabled)
+		CMU_ClockSelectSet(cmuClock_LFA, CMU_ClockSelectGet(cmuClock_LFE));
+	CMU_ClockEnable(cmuClock_PCNT0, true);
+	GPIO_PinModeSet(PULSE_IN[PULSE_PCNT_INPUT].port, PULSE_IN[PULSE_PCNT_INPUT].pin, gpioModeInput, 1);	// Glitch filter
+	PCNT0->ROUTELOC0 = (PCNT0->ROUTELOC0 & ~_PCNT_ROUTELOC0_S0INLOC_MASK) | PULSE_PCNT_LOCATION;
+	init.mode = pcntModeExtSingle;
+	init.counter = 0;
+	init.top = PULSE_PCNT_TOP;
+#ifdef PULSE_USE_RISING_EDGE
+	init.negEdge = false;
+#else
+	init.negEdge = true;
+#endif
+	PCNT_Init(PCNT0, &init);
+	PulsePcntLast = 0;
+	PCNT_IntClear(PCNT0, PCNT_IF_OF);
+	PCNT_IntEnable(PCNT0, PCNT_IEN_OF);
+	NVIC_ClearPendingIRQ(PCNT0_IRQn);
+	NVIC_EnableIRQ(PCNT0_IRQn);
+	PulsePcntOn = true;
+}
+#endif
 void PULSE_IN_IRQHandler(int pin) {
 	for(int i=0; i < HAL_NB_PULSE_IN ;i++) {
 		if(PULSE_IN[i].pin == pin) {
-			PulseInValue[i]++;
+#if (PULSE_PCNT > 0)
+			// PCNT0 counts this input, its edge IRQ is only used once to post PULSE_EVENT
+			if (i == PULSE_PCNT_INPUT) SystemDefinePortIrq(PULSE_IN[i], GPIOIRQNone);
+			else
+#endif
+			if (PulseCountDebounce(&PulseInLastEdge[i], TimeBaseGetTicks(), TimeBaseMsToTicks(PULSE_DEBOUNCE_MS)))
+				PulseInValue[i]++;
+			else
+				break;
 #ifndef PULSE_NO_EVENT
 			if (!GET_FLAG(DEVICE_PULSE_OFF))
-					portEND_SWITCHING_ISR( DeviceSendEventFromISR( PULSE_EVENT ) );
+					portEND_SWITCHING_ISR( DevicePostEventPayloadFromISR( PULSE_EVENT, SYSTEMBITMASK(i) ) );
 			SET_FLAG(DEVICE_PULSE_OFF);
 #endif
 			break;
@@ -387,6 +449,16 @@ void DevicePulseInEnable(BOOL bEnable) {
 #elif (NODE_PULSE > 0)
 	for (int i=0; i < HAL_NB_PULSE_IN; i++) {
 		SystemSetPortMode(PULSE_IN[i],(bEnable) ? PortIn : PortDisabled);
+		PulseInLastEdge[i] = TimeBaseGetTicks() - TimeBaseMsToTicks(PULSE_DEBOUNCE_MS);
+#if (PULSE_PCNT > 0)
+		if (i == PULSE_PCNT_INPUT) {
+			DevicePulsePcntEnable(bEnable);
+#ifndef PULSE_NO_EVENT
+			if (bEnable && !GET_FLAG(DEVICE_PULSE_OFF)) DevicePulseInRearm();
+#endif
+			continue;
+		}
+#endif
 #ifdef PULSE_USE_RISING_EDGE
     	SystemDefinePortIrqHandler(PULSE_IN[i], PULSE_IN_IRQHandler, GPIOIRQRising);
 #else
@@ -398,11 +470,24 @@ void DevicePulseInEnable(BOOL bEnable) {
 	(void)bEnable;	// Remove warning
 #endif // HAL_NB_PULSE_IN > 0
 }
+void DevicePulseInRearm(void) {
+	CLEAR_FLAG(DEVICE_PULSE_OFF);
+#if (PULSE_PCNT > 0) && !defined(PULSE_NO_EVENT)
+#ifdef PULSE_USE_RISING_EDGE
+	SystemDefinePortIrqHandler(PULSE_IN[PULSE_PCNT_INPUT], PULSE_IN_IRQHandler, GPIOIRQRising);
+#else
+	SystemDefinePortIrqHandler(PULSE_IN[PULSE_PCNT_INPUT], PULSE_IN_IRQHandler, GPIOIRQFalling);
+#endif
+#endif
+}
 unsigned long DeviceGetPulseInNumber(void) {
 	return HAL_NB_PULSE_IN;
 }
 unsigned long *DeviceGetPulseInValuePtr(LIST_INDEX pulse) {
 #if HAL_NB_PULSE_IN > 0
+#if (PULSE_PCNT > 0)
+	if (pulse == PULSE_PCNT_INPUT) DevicePulsePcntSync();
+#endif
 	if (pulse < HAL_NB_PULSE_IN)
 		return (unsigned long *)&PulseInValue[pulse];
 #else
@@ -412,6 +497,9 @@ unsigned long *DeviceGetPulseInValuePtr(LIST_INDEX pulse) {
 }
 unsigned long DeviceGetPulseInValue(LIST_INDEX pulse) {
 #if HAL_NB_PULSE_IN > 0
+#if (PULSE_PCNT > 0)
+	if (pulse == PULSE_PCNT_INPUT) DevicePulsePcntSync();
+#endif
 	if (pulse < HAL_NB_PULSE_IN)
 		return PulseInValue[pulse];
 #else
@@ -421,6 +509,10 @@ unsigned long DeviceGetPulseInValue(LIST_INDEX pulse) {
 }
 void DeviceSetPulseInValue(LIST_INDEX pulse, unsigned long value) {
 #if HAL_NB_PULSE_IN > 0
+#if (PULSE_PCNT > 0)
+	// Account the pending pulses before the value is replaced
+	if (pulse == PULSE_PCNT_INPUT) DevicePulsePcntSync();
+#endif
 	if (pulse < HAL_NB_PULSE_IN)
 		PulseInValue[pulse] = value;
 #else
@@ -456,108 +548,78 @@ BOOL DevicePulseOutState(void) {
 }
 
 #if (NODE_TEMP > 0)	// TSIC 306 type of sensor
-static inline BOOL EvenParity( unsigned char b )
-{
-    b ^= b >> 4;
-    b ^= b >> 2;
-    b ^= b >> 1;
-    return (BOOL)(b & 1);
-}
 /** @cond */
 #define TEMPLOWREF		(-50)
 #define TEMPHIREF		(150)
-#define TEMP_TIMEOUT	0x0000FFFFUL
+#define TEMP_CAPTURE_TIMEOUT	200		// Sensor starts within 85 ms and sends a frame every 100 ms
+#define TEMP_ATTEMPTS			2		// Number of frames to capture before giving up
+static unsigned short ZACWireEdges[ZACWIRE_FRAME_EDGES];
+static SemaphoreHandle_t xZACWireDone = NULL;
+static StaticSemaphore_t xZACWireDoneBuffer;
 /** @endcond */
-/*
- * @brief Reads a bit from the data wire of the TSIC sensor.
- * @param[in] maxTimeout  Maximum amount of loops to wait for a falling edge
- * @return the number of iteration between the rising edge and falling edge detection
- */
-static int DeviceGetZACWireBit(int maxTimeout) {
-	/* Mesure bit low level length */
-	/* Wait for falling edge of start of next bit.
-	 *  We are at 8k bps, so the timeout is of some 125 µsec */
-	/* This loop lasts for about 5 sec to timeout in case of missing sensor */
-	int timeout = maxTimeout;
-	/* Wait for falling edge */
-	while (--timeout && SystemGetPortState(TEMPSENSOR_VALUE)) __nop();
-	if (timeout) {
-		/* Wait for rising edge */
-		timeout = TEMP_TIMEOUT;
-		/* Block FreeRTOS Kernel during acquisition */
-		taskENTER_CRITICAL();
-		while(--timeout && !SystemGetPortState(TEMPSENSOR_VALUE)) __nop();
-		/* Resume FreeRTOS Kernel */
-		taskEXIT_CRITICAL();
-	}
-	/* Compute bit duration */
-	return (timeout) ? (TEMP_TIMEOUT - timeout) : 0;
+
+void INTTimerCapture_Handler(int count) {
+	(void)count;
+	if (xZACWireDone) {
+		BaseType_t xHigherPriorityTaskWoken = pdFALSE;
+		xSemaphoreGiveFromISR(xZACWireDone, &xHigherPriorityTaskWoken);
+		portEND_SWITCHING_ISR(xHigherPriorityTaskWoken);
+	}
 }
 /*
- * @brief Read a whole byte from the data wire of the TSIC sensor.
- * A byte consists in 8 bits + 1 even parity bit.
- * @return the read byte or 0 if error
- * @remark This function would raise the DEVICE_COMM_ERROR status flag upon communication error,
- * and add the DEVICE_PERMANENT_ERROR status flag if no falling edge has been detected which could
- * mean that the sensor is missing.
+ * @brief Capture the edges of a whole frame from the data wire of the TSIC sensor.
+ * Edges are time stamped by the timer input capture hardware, the calling task is blocked
+ * (core in EM1) while the frame is received.
+ * @return the number of captured edges
  */
-static unsigned long DeviceGetZACWireByte() {
-unsigned long value = 0;
-	if (GET_FLAG(DEVICE_COMM_ERROR) == 0) {
-		/* Get Strobe timer = 50% duty cycle */
-		int bitTime = DeviceGetZACWireBit(TEMP_TIMEOUT << 5) + 1;
-		if (bitTime > 1) {
-			/* Read 9 bits = (8 bits + parity) */
-			for (int b = 9; b ; b--) {
-				int timeout = DeviceGetZACWireBit(TEMP_TIMEOUT);
-				if (timeout) {
-					/* If rising edge occured before 50% duty cycle, it's a logic 1 */
-					value <<= 1;
-					value |= (timeout < bitTime) ? 1 : 0;
-				}
-				else {
-					SET_FLAG(DEVICE_COMM_ERROR);	/* Set Communication Status */
-					break;
-				}
-			}
-			/* Check Parity */
-			if ((value & 0x01) != EvenParity((unsigned char)(value >> 1))) {
-				SET_FLAG(DEVICE_COMM_ERROR);	/* Set Communication Status */
-			}
-			else
-				value >>=1;	/* Remove parity bit */
-		}
-		else {
-			/* Strobe capture error - Sensor is absent or failing. Set Permanent error flag*/
-			SET_FLAG(DEVICE_COMM_ERROR | DEVICE_PERMANENT_ERROR);	/* Set Communication Status */
-		}
+static int DeviceCaptureZACWireFrame(void) {
+	if (xZACWireDone == NULL) xZACWireDone = xSemaphoreCreateBinaryStatic(&xZACWireDoneBuffer);
+	xSemaphoreTake(xZACWireDone, 0);			// Discard any previous completion
+	// Only keep edges following the idle time between frames, a retry can start inside a frame
+	if (!TIMERCaptureStart(TEMPSENSOR_VALUE, ZACWireEdges, ZACWIRE_FRAME_EDGES, ZACWIRE_FRAME_GAP)) return 0;
+	if (xTaskGetSchedulerState() == taskSCHEDULER_RUNNING) {
+		xSemaphoreTake(xZACWireDone, TEMP_CAPTURE_TIMEOUT / portTICK_PERIOD_MS);
+	} else {
+		for (int i = TEMP_CAPTURE_TIMEOUT; i && !TIMERCaptureIsDone(); i--) SysTimerWait1ms(1);
 	}
-	return (GET_FLAG(DEVICE_COMM_ERROR) ? 0: (value & 0xFF));
+	return TIMERCaptureStop();
 }
 /*
- * @brief Read two consecutive bytes from the data wire of the TSIC sensor.
+ * @brief Read a temperature frame from the data wire of the TSIC sensor.
  * The read value, if no error, will be translated in a temperature value in °C
- * @return the read temperature in °C or 0 if error
+ * @return the read temperature in 1/10 °C or 0 if error
+ * @remark This function would raise the DEVICE_COMM_ERROR status flag upon communication error,
+ * and add the DEVICE_PERMANENT_ERROR status flag if no edge has been detected which could
+ * mean that the sensor is missing.
  */
 static unsigned long DeviceGetZACWireWord() {
+	ZACWIRE_STATUS status = ZACWireNoSignal;
+	unsigned short value = 0;
 	SystemSetPortMode(TEMPSENSOR_VALUE,PortInUp);
 	/* Detect sensor presence. It shall start after 60ms to 85ms
 	 * and then issue measure information (about 2.5 ms transmission time) 10 times per seconds
 	 */
 	SysTimerWait1ms(10);	/* Wait 10 ms for ZAC Wire input signal to get high */
-	int value = (DeviceGetZACWireByte() << 8) | DeviceGetZACWireByte();
-	if (value > 0x7FF) { value = 0; SET_FLAG(DEVICE_COMM_ERROR); }	/* Set Communication Status */
-	/* Compute °C from acquired value using manufacturer formula:
-	 *
-	 * T°C = ((Value / 2047) * (HIGHREF - LOWREF)) + LOWREF
-	 *
-	 * Where LOWREF = -50°C and HIGHREF = 150°C for TSic 306
-	 *
-	 */
-	if (!GET_FLAG(DEVICE_COMM_ERROR))
-		value = ((value * (long)((TEMPHIREF - TEMPLOWREF) * 10)) / 2047L) + (long)(TEMPLOWREF * 10);
+	vEFMEnergyRequire(EnergyClientCapture, EnergyModeEM1);	/* Timer capture requires EM1 */
+	for (int i = TEMP_ATTEMPTS; i; i--) {
+		/* On error, the next frame is captured while the sensor remains powered */
+		status = ZACWireDecode(ZACWireEdges, DeviceCaptureZACWireFrame(), &value);
+		if ((status == ZACWireOK) || (status == ZACWireNoSignal)) break;
+	}
+	vEFMEnergyRelease(EnergyClientCapture);
 	SystemDefinePort(TEMPSENSOR_VALUE);
-	return value;
+	switch (status) {
+	case ZACWireOK:
+		return (unsigned long)ZACWireToTemperature(value, TEMPLOWREF, TEMPHIREF);
+	case ZACWireNoSignal:
+		/* Sensor is absent or failing. Set Permanent error flag*/
+		SET_FLAG(DEVICE_COMM_ERROR | DEVICE_PERMANENT_ERROR);
+		break;
+	default:
+		SET_FLAG(DEVICE_COMM_ERROR);	/* Set Communication Status */
+		break;
+	}
+	return 0;
 }
 #endif
 
@@ -690,13 +752,12 @@ static void DeviceGetTemperature(LIST_INDEX sensor) {
 	SysTimerWait1ms(5);		// Wait for sensor startup
 	unsigned long temp = ReadSensorData(0x03);
 	if (!GET_FLAG(DEVICE_COMM_ERROR)) {
-		PulseInValue[0] = (temp / 10) - 397;
-		double hum = (double)ReadSensorData(0x05);
+		long temperature = SHTConvertTemperature((unsigned short)temp);
+		/* Report 0.1 °C and 0.1 %RH, rounded to nearest */
+		PulseInValue[0] = (unsigned long)((temperature + ((temperature < 0) ? -5 : 5)) / 10);
+		unsigned long hum = ReadSensorData(0x05);
 		if ((DeviceStatus & DEVICE_COMM_ERROR) == 0) {
-			hum += (double)(unsigned long)I2CRawReceive(1);
-			hum = (-20.468f + (0.367f * hum) + (-1.5955E-5f * (hum * hum)))
-				+ ((((double)((short)temp)/10) - 25.0f) * ((0.01f + 0.00008f * hum)));
-			PulseInValue[1] = ((unsigned long)((int)(hum)));
+			PulseInValue[1] = (unsigned long)((SHTCompensateHumidity((unsigned short)hum, temperature) + 5) / 10);
 		}
 	}
 	/* Switch off temperature sensor */
@@ -715,7 +776,59 @@ static void DeviceGetTemperature(LIST_INDEX sensor) {
 }
 #endif
 
-#define OVERSAMPLE 50
+#if (HAL_NB_PULSE_IN > 0) && (NODE_TEMP == 0) && (NODE_HYGRO == 0) && (NODE_ANALOG > 0)
+/** @cond */
+#ifndef ADCOVERSAMPLE
+#define ADCOVERSAMPLE		ADCOversample16			// Hardware averaging for each sample
+#endif
+#ifndef ADCSAMPLES
+#define ADCSAMPLES			16						// Number of samples captured by DMA
+#endif
+#ifndef ADCFILTER
+#define ADCFILTER			ADCFilterTrimmedMean	// Reduction applied to captured samples
+#endif
+#define ADC_CAPTURE_TIMEOUT	(100 / portTICK_PERIOD_MS)
+static short AnalogSamples[ADCSAMPLES];
+static SemaphoreHandle_t xAnalogDone = NULL;
+static StaticSemaphore_t xAnalogDoneBuffer;
+/** @endcond */
+
+void INTADCCapture_Handler(int ADCNum) {
+	(void)ADCNum;
+	if (xAnalogDone) {
+		BaseType_t xHigherPriorityTaskWoken = pdFALSE;
+		xSemaphoreGiveFromISR(xAnalogDone, &xHigherPriorityTaskWoken);
+		portEND_SWITCHING_ISR(xHigherPriorityTaskWoken);
+	}
+}
+
+/*!
+ * @brief Capture ADCSAMPLES hardware oversampled values using DMA
+ * @return number of samples captured
+ * @remark The calling task is blocked while the DMA fills the buffer,
+ * EM2 is prevented for the capture duration only as DMA requires EM1.
+ */
+static int DeviceCaptureAnalogSamples(void) {
+	int count = ADCSAMPLES;
+	if (xAnalogDone == NULL) xAnalogDone = xSemaphoreCreateBinaryStatic(&xAnalogDoneBuffer);
+	xSemaphoreTake(xAnalogDone, 0);						// Discard any previous completion
+	vEFMEnergyRequire(EnergyClientADC, EnergyModeEM1);	// Stay in EM1 while DMA is running
+	if (ADCCaptureStart(ADCNUM, ADCOVERSAMPLE, AnalogSamples, ADCSAMPLES)) {
+		if (xTaskGetSchedulerState() == taskSCHEDULER_RUNNING) {
+			if (xSemaphoreTake(xAnalogDone, ADC_CAPTURE_TIMEOUT) != pdTRUE) count = 0;
+		} else {
+			while (!ADCCaptureIsDone(ADCNUM));
+		}
+	} else {
+		// No DMA available: fallback to blocking conversions
+		for (int i = 0; i < ADCSAMPLES; i++) AnalogSamples[i] = (short)ADCConvertOnce(ADCNUM);
+	}
+	vEFMEnergyRelease(EnergyClientADC);
+	ADCFilterRectify(AnalogSamples, count);				// Make sure values are positive
+	return count;
+}
+#endif
+
 void DeviceCaptureAnalogValue(LIST_INDEX pulse) {
 #if (HAL_NB_PULSE_IN > 0)
 	if (pulse >= HAL_NB_PULSE_IN) return;
@@ -724,23 +837,21 @@ void DeviceCaptureAnalogValue(LIST_INDEX pulse) {
 #elif (NODE_ANALOG > 0) // Read Analog Value is enabled
 	// Open ADC in differential mode -> ADC full scale = Full Scale / 2
 	ADCOpenDifferential(ADCNUM,ADCLOCATION,ADCPCHANNEL,ADCNCHANNEL,ADCREF,ADCSAMPLEDELAY,ADCTIME);
-	PulseInValue[pulse] = 0;						// Reset result
-	for (int i = OVERSAMPLE; i; i--) {
-		int value  = (int)ADCConvertOnce(ADCNUM);	// Value can be negative
-		if (value < 0 ) value = -value;				// Make sure value is positive
-		PulseInValue[pulse] += value;				// Accumulate results
-	}
-	PulseInValue[pulse] /= (OVERSAMPLE);			// Compute mean value
+	int count = DeviceCaptureAnalogSamples();
+	int fullScale = ADCGetOversampledFullScale(ADCNUM) / 2;		// Depends on oversampling ratio
+	ADCCaptureStop(ADCNUM);
+	long value = ADCFilterSamples(AnalogSamples, count, ADCFILTER);
 #if defined(CONVERT_4_20MA)
 	// Convert to 400-20000 µA -> each ADC unit = (5000000 µV /2) / 120 Ohms / (FullScale/2)
-	// With minimum value = 0, and maximum value = 2047 => 0 µA to 20833 µA
-	// After division simplification by 40 to keep intermediate result in unsigned long format:
-	PulseInValue[pulse] = ( (ADCGetReference(ADCNUM) / 2) * PulseInValue[pulse] * 25) / (3 * (ADCGetFullScale(ADCNUM)/2));
+	PulseInValue[pulse] = ADCScale4_20mA(value, ADCGetReference(ADCNUM), fullScale);
 	if (PulseInValue[pulse] < 3000)	SET_FLAG(DEVICE_COMM_ERROR); // Error if < 3 mA
 #elif defined(CONVERT_0_10V) || defined(CONVERT_0_5V)
 	// Convert to 0 - 10000mV -> each ADC unit = 5000 / 2 * 4 / ((FullScale/2) - 1)
 	// Convert to 0 - 5000mV  -> each ADC unit = 2500 / 2 * 4 / ((FullScale/2) - 1)
-	PulseInValue[pulse] = ( ADCGetReference(ADCNUM) * PulseInValue[pulse] * 2) / (ADCGetFullScale(ADCNUM) / 2);
+	PulseInValue[pulse] = ADCScale0_10V(value, ADCGetReference(ADCNUM), fullScale);
+#else
+	PulseInValue[pulse] = (unsigned long)value;
+	(void)fullScale;
 #endif
 	ADCClose(ADCNUM,ADCPCHANNEL);
 #endif //  TEMP / ANALOG
@@ -757,6 +868,7 @@ void DeviceCaptureAnalogValue(LIST_INDEX pulse) {
 #pragma message "Warning: Added HAL_NB_LED definition"
 #endif
 static inline void DeviceInitLeds(void) {
+	LEDPATTERN_Init();
 #if (HAL_NB_LED > 0)
 	DeviceFlashLed(LED_FLASH_ON);
 #endif // HAL_NB_LED > 0
@@ -765,6 +877,7 @@ static inline void DeviceInitLeds(void) {
 #define DELAY50MS	10000UL
 /** @endcond */
 __attribute__((noreturn)) void DeviceShowErrorCode(int code) {
+	CRASH_Capture(CrashErrorCode, (uint32_t)code, 0);
 	SystemSetClockSpeed(VERYLOWSPEED);
 	for (int j=40; j; j--) {			/* Run this loop for at least 1 minute */
 		for (int i=10;i ; i--) {
@@ -788,24 +901,17 @@ __attribute__((noreturn)) void DeviceShowErrorCode(int code) {
 	__builtin_unreachable();
 }
 
-#if  HAL_NB_LED > 0
-static int bLED = 0;
-#endif
 void DeviceFlashOneLedExt(LIST_INDEX led, short number, short duration) {
 #if  HAL_NB_LED > 0
 	if (led < HAL_NB_LED) {
 		if (number == LED_FLASH_ON)
-			bLED |= SYSTEMBITMASK(led);
+			LEDPATTERN_SetSteady(led, true);
 		else if (number == LED_FLASH_TOGGLE)
-			bLED ^= SYSTEMBITMASK(led);
+			LEDPATTERN_SetSteady(led, !LEDPATTERN_GetSteady(led));
 		else if (number == LED_FLASH_OFF)
-			bLED &= ~SYSTEMBITMASK(led);
-		else
-			for(int i=(number*2);i; i--) {
-				SystemTogglePort(LED[led]);
-				vTaskDelay(configTICK_RATE_HZ / ((duration) ? duration : LED_FLASH_NORMAL));
-			}
-		SystemSetPortState(LED[led],bLED & SYSTEMBITMASK(led));
+			LEDPATTERN_SetSteady(led, false);
+		else if (number > 0)	/* Played from the timer IRQ, returns immediately */
+			LEDPATTERN_Flash(led, (number > 255) ? 255 : (uint8_t)number, 1000 / ((duration) ? duration : LED_FLASH_NORMAL));
 	}
 #else
 	(void) led;
@@ -813,6 +919,16 @@ void DeviceFlashOneLedExt(LIST_INDEX led, short number, short duration) {
 	(void) duration;
 #endif // HAL_NB_LED > 0
 }
+void DeviceAlertOneLedExt(LIST_INDEX led, short number, short duration) {
+#if  HAL_NB_LED > 0
+	if ((led < HAL_NB_LED) && (number > 0))
+		LEDPATTERN_Alert(led, (number > 255) ? 255 : (uint8_t)number, 1000 / ((duration) ? duration : LED_FLASH_NORMAL));
+#else
+	(void) led;
+	(void) number;
+	(void) duration;
+#endif // HAL_NB_LED > 0
+}
 BOOL DeviceGetLedStateExt(LIST_INDEX led) {
 #if HAL_NB_LED > 0
 	if (led < HAL_NB_LED) {
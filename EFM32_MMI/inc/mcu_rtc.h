@@ -6,6 +6,7 @@
 
 #ifndef __SYSRTC_H__
 #define __SYSRTC_H__
+#include <stdint.h>
 /** \addtogroup MMI MyMeterInfo add-on functions
  *  @{
  */
@@ -24,6 +25,27 @@ unsigned long RTCGetSeconds(void);
  * @param[in] seconds Number of elapsed seconds to set
  */
 void RTCSetSeconds(const unsigned long seconds);
+/*!
+ * @brief Get current RTC time with the time base resolution
+ * @return Number of 1/32768 s elapsed since 01/01/2000
+ */
+uint64_t RTCGetTicks(void);
+/*!
+ * @brief Set current RTC time with the time base resolution
+ * @param[in] ticks Number of 1/32768 s elapsed since 01/01/2000
+ */
+void RTCSetTicks(const uint64_t ticks);
+/*!
+ * @brief Get the RTC rate correction
+ * @return Correction in parts per billion, positive when the time base is slow
+ */
+long RTCGetTrim(void);
+/*!
+ * @brief Set the RTC rate correction applied from now on
+ * @param[in] ppb Correction in parts per billion, positive when the time base is slow
+ * @remark The time base itself is not changed, OS tick and MAC timers keep their rate
+ */
+void RTCSetTrim(const long ppb);
 
 /** }@ */
 #endif
@@ -60,6 +60,24 @@ typedef enum {
 	ADCSamplingTime128,//!< 128 clock cycles per sample
 	ADCSamplingTime256 //!< 256 clock cycles per sample
 }ADC_SAMPLINGTIME;
+/*!
+ * ADC hardware oversampling ratio: each conversion result is the average of several samples
+ */
+typedef enum {
+	ADCOversampleNone, //!< No oversampling, 12 bits results
+	ADCOversample2,    //!< 2 samples per result
+	ADCOversample4,    //!< 4 samples per result
+	ADCOversample8,    //!< 8 samples per result
+	ADCOversample16,   //!< 16 samples per result
+	ADCOversample32,   //!< 32 samples per result
+	ADCOversample64,   //!< 64 samples per result
+	ADCOversample128,  //!< 128 samples per result
+	ADCOversample256,  //!< 256 samples per result
+	ADCOversample512,  //!< 512 samples per result
+	ADCOversample1024, //!< 1024 samples per result
+	ADCOversample2048, //!< 2048 samples per result
+	ADCOversample4096  //!< 4096 samples per result
+}ADC_OVERSAMPLE;
 
 /*!
  * @brief User defined ADC complete IRQ handler
@@ -73,6 +91,11 @@ void INTAD_Handler(int ADCNum, unsigned long value);
  * @param[in] outLevel  ADC trigger level detected
  */
 void INTADCTrigger_Handler(int ADCNum, ADC_TRIGGER_OUTPUT outLevel);	// User defined interrupt
+/*!
+ * @brief User defined ADC capture complete IRQ handler
+ * @param[in] ADCNum	ADC port number (depends on microcontroller type)
+ */
+void INTADCCapture_Handler(int ADCNum);
 
 /*!
  * @brief Open an ADC port to perform either single or recurrent ADC conversions
@@ -113,6 +136,13 @@ int ADCGetReference(int ADCNum);
  * @return maximum possible value
  */
 int ADCGetFullScale(int ADCNum);
+/*!
+ * @brief Return the maximum possible value returned by an ADC conversion
+ * @param[in] ADCNum	ADC port number (depends on microcontroller type)
+ * @return maximum possible value
+ * @remark Unlike ADCGetFullScale, also valid for oversampling ratios from 16
+ */
+int ADCGetOversampledFullScale(int ADCNum);
 /*!
  * @ brief Perform a single synchronous ADC conversion and returns result directly
  * @param[in] ADCNum	ADC port number (depends on microcontroller type)
@@ -130,6 +160,28 @@ void ADCStartConvert(int ADCNum);
  * @param[in] ADCNum	ADC port number (depends on microcontroller type)
  */
 void ADCStopConvert(int ADCNum);
+/*!
+ * @brief Start capturing a buffer of hardware oversampled conversions using DMA
+ * @param[in] ADCNum	ADC port number (depends on microcontroller type)
+ * @param[in] ratio		Hardware oversampling ratio applied to each result
+ * @param[out] buffer	Buffer to fill with conversion results
+ * @param[in] count		Number of conversion results to capture (up to 2048)
+ * @return true if the capture was started
+ * @note The ADC port must be opened first. The core only has to stay in EM1 while the capture runs,
+ * the user defined capture IRQ handler is called when the buffer is full.
+ */
+BOOL ADCCaptureStart(int ADCNum, ADC_OVERSAMPLE ratio, short* buffer, int count);
+/*!
+ * @brief Check whether a capture started by ADCCaptureStart is complete
+ * @param[in] ADCNum	ADC port number (depends on microcontroller type)
+ * @return true if the buffer is full or no capture is running
+ */
+BOOL ADCCaptureIsDone(int ADCNum);
+/*!
+ * @brief Stop a capture and restore single conversion mode
+ * @param[in] ADCNum	ADC port number (depends on microcontroller type)
+ */
+void ADCCaptureStop(int ADCNum);
 
 // Trigger Level is in 1/64 of VDD increments
 /*!
@@ -20,14 +20,14 @@ __weak void TimerIrqHandler(void);
 
 /*!
  * @brief Timer hardware initialization
- * @remark the hardware timer is based upon milliseconds values
+ * @remark the timer uses a compare channel of the RTCC time base shared with the OS tick
  */
 void TIMERInit(void);
 
 /*!
  * @brief Starts the hardware timer for duration milliseconds
  * The TimerIrqHandler will be triggered when timer expires
- * @remark The timer is limited to less than 16,320,000 ms (about 4533 hours) which shall be enough
+ * @remark The timer is limited to less than 2^31 / 32768 s (about 18 hours) which shall be enough
  * @param duration
  */
 void TIMERStart(int duration);
@@ -37,5 +37,44 @@ void TIMERStart(int duration);
  */
 void TIMERStop(void);
 
+/*!
+ * @brief User defined edge capture complete IRQ handler
+ * @param[in] count Number of edges captured
+ * @remark This function must be re-defined by the user
+ */
+void INTTimerCapture_Handler(int count);
+
+/*!
+ * @brief Start capturing the time stamps of both edges of an input port
+ * Each edge latches the free running high frequency timer counter in hardware,
+ * so the core can sleep (EM1) between edges without loosing accuracy.
+ * @param[in] port		Input port to capture (any GPIO, routed through PRS)
+ * @param[out] buffer	Array receiving the 16 bits time stamps
+ * @param[in] count		Number of edges to capture
+ * @param[in] gap		Shortest idle time before the first edge (in µs), 0 to start with the first edge
+ * @return true if the capture was started
+ * @remark The INTTimerCapture_Handler is called when buffer is full. With a gap, the capture
+ * restarts on any edge following such an idle time, so that it is synchronized on frame boundaries.
+ */
+BOOL TIMERCaptureStart(const SystemPort port, unsigned short* buffer, int count, unsigned long gap);
+
+/*!
+ * @brief Check whether the capture buffer is full
+ * @return true if capture is complete or not started
+ */
+BOOL TIMERCaptureIsDone(void);
+
+/*!
+ * @brief Stop edge capture and release the timer
+ * @return number of edges captured
+ */
+int TIMERCaptureStop(void);
+
+/*!
+ * @brief Get the edge capture time stamps frequency
+ * @return time stamp frequency in Hz
+ */
+unsigned long TIMERCaptureGetFrequency(void);
+
 /** }@ */
 #endif /* EFM32_MMI_INC_MMI_TIMER_H_ */
@@ -0,0 +1,35 @@
+/*******************************************************************
+**                                                                **
+** Pulse input counting functions.                                **
+** Hardware independent, can be compiled on any host.             **
+**                                                                **
+*******************************************************************/
+
+#ifndef __PULSE_COUNT_H__
+#define __PULSE_COUNT_H__
+
+/** \addtogroup MMI MyMeterInfo add-on functions
+ *  @{
+ */
+
+#include <stdbool.h>
+
+/*!
+ * @brief Debounce an edge counted by its IRQ
+ * @param [in,out] lastEdge	Time of the last accepted edge, updated if the edge is accepted
+ * @param [in] now			Time of the edge, in the same free running unit
+ * @param [in] debounce		Shortest time between two accepted edges, 0 to accept all edges
+ * @return 					true if the edge is a pulse, false if it is a bounce or a glitch
+ */
+bool PulseCountDebounce(unsigned long* lastEdge, unsigned long now, unsigned long debounce);
+/*!
+ * @brief Account the pulses counted by a 16 bits hardware counter since its last read
+ * @param [in,out] last		Counter value at the last read, updated
+ * @param [in] count		Counter value now
+ * @return 					Number of pulses, the counter must be read at least once per wrap
+ */
+unsigned short PulseCountDelta(unsigned short* last, unsigned short count);
+
+/** }@ */
+
+#endif
@@ -0,0 +1,53 @@
+/*******************************************************************
+**                                                                **
+** SHT7x temperature and humidity sensor conversion functions.    **
+** Fixed point, hardware independent, can be compiled on any host.**
+**                                                                **
+*******************************************************************/
+
+#ifndef __SHT_CONVERT_H__
+#define __SHT_CONVERT_H__
+
+/** \addtogroup MMI MyMeterInfo add-on functions
+ *  @{
+ */
+
+#ifndef SHT_D1
+/*!
+ * @brief Temperature conversion offset d1 in 0.01 °C, depends on the sensor supply voltage (-39.7 °C at 3.5 V)
+ */
+#define SHT_D1		(-3970)
+#endif
+
+/*!
+ * @brief Convert a 14 bits temperature reading
+ * @param [in] raw		SOT sensor output
+ * @return 				Temperature in 0.01 °C, exact
+ */
+long SHTConvertTemperature(unsigned short raw);
+/*!
+ * @brief Convert a 12 bits humidity reading, without temperature compensation
+ * @param [in] raw		SORH sensor output
+ * @return 				Linear relative humidity in 0.01 %RH, not clipped, within 0.51 unit of the datasheet formula
+ */
+long SHTConvertHumidity(unsigned short raw);
+/*!
+ * @brief Convert a 12 bits humidity reading, compensated for the sensor temperature
+ * @param [in] raw			SORH sensor output
+ * @param [in] temperature	Temperature in 0.01 °C (see SHTConvertTemperature)
+ * @return 					Relative humidity in 0.01 %RH, clipped to 0 - 10000, within 1.01 unit of the datasheet formula
+ */
+long SHTCompensateHumidity(unsigned short raw, long temperature);
+/*!
+ * @brief Compute the dew point (Magnus formula, over ice below 0 °C)
+ * @param [in] humidity		Relative humidity in 0.01 %RH (see SHTCompensateHumidity), values below 1 are taken as 1
+ * @param [in] temperature	Temperature in 0.01 °C
+ * @return 					Dew point in 0.01 °C, within 2 units of the datasheet formula
+ * @remark Host only: the firmware reports the temperature and the humidity, from which the dew point
+ * can be derived on the server side. The uplink format has no room for it.
+ */
+long SHTDewPoint(long humidity, long temperature);
+
+/** }@ */
+
+#endif
@@ -282,6 +282,11 @@ BOOL SystemBatteryIsLow(void);
  * @return Battery voltage in mV
  */
 unsigned long SystemBatteryGetVoltage(void);
+/*!
+ * @brief Get the internal temperature sensor value
+ * @return Temperature in 1/10 °C
+ */
+short SystemGetTemperature(void);
 /*!
  * @brief External user defined Battery Low exception IRQ handler
  * @remark A default handler is defined as a weak defined function
@@ -0,0 +1,143 @@
+/*******************************************************************
+**                                                                **
+** Unified low frequency time base                                **
+** A single free running 32 bits RTCC counter serves the OS tick  **
+** and the LoRaMAC timer list through separate compare channels.  **
+**                                                                **
+*******************************************************************/
+
+#ifndef __TIMEBASE_H__
+#define __TIMEBASE_H__
+#include <stdint.h>
+/** \addtogroup MMI MyMeterInfo add-on functions
+ *  @{
+ */
+
+/*!
+ * @brief Time base counter frequency in Hz (LFXO or LFRCO, no prescaler)
+ */
+#define TIMEBASE_FREQUENCY		32768UL
+/*!
+ * @brief Number of bits to shift a number of ticks by to get seconds
+ */
+#define TIMEBASE_SHIFT			15
+/*!
+ * @brief TimeBaseGetNextDeadline value when no compare channel is armed
+ */
+#define TIMEBASE_NO_DEADLINE	0xFFFFFFFFUL
+
+/*!
+ * @brief Time base compare channels
+ */
+typedef enum {
+	TimeBaseOSChannel = 1,		//!< FreeRTOS tick (tickless idle)
+	TimeBaseTimerChannel = 2	//!< LoRaMAC timer list
+} TIMEBASE_CHANNEL;
+
+/*!
+ * @brief Convert milliseconds into time base ticks, rounded to nearest
+ * @param[in] ms	Number of milliseconds
+ * @return number of ticks (1 tick = 30.52 us)
+ */
+static inline uint32_t TimeBaseMsToTicks(uint32_t ms) {
+	return (uint32_t)((((uint64_t)ms << TIMEBASE_SHIFT) + 500) / 1000);
+}
+/*!
+ * @brief Convert time base ticks into milliseconds, truncated
+ * @param[in] ticks	Number of ticks
+ * @return number of milliseconds (wraps as a 32 bits value)
+ */
+static inline uint32_t TimeBaseTicksToMs(uint64_t ticks) {
+	return (uint32_t)((ticks * 1000) >> TIMEBASE_SHIFT);
+}
+/*!
+ * @brief Convert time base ticks into microseconds, truncated
+ * @param[in] ticks	Number of ticks
+ * @return number of microseconds
+ */
+static inline uint64_t TimeBaseTicksToUs(uint64_t ticks) {
+	return (ticks * 1000000) >> TIMEBASE_SHIFT;
+}
+/*!
+ * @brief Number of ticks elapsed between two 32 bits counter values, counter roll over safe
+ * @param[in] from	Start counter value
+ * @param[in] to	End counter value
+ * @return number of ticks
+ */
+static inline uint32_t TimeBaseElapsed(uint32_t from, uint32_t to) {
+	return to - from;
+}
+/*!
+ * @brief Check whether a counter value has been reached, counter roll over safe
+ * @param[in] target	Counter value to check
+ * @param[in] now		Current counter value
+ * @return non zero if target is now or in the past (less than 2^31 ticks = 18 hours ago)
+ */
+static inline int TimeBaseIsReached(uint32_t target, uint32_t now) {
+	return ((int32_t)(now - target) >= 0);
+}
+
+/*!
+ * @brief Start the time base counter if not running yet
+ * @remark The counter is never reset once started, all users rely on its continuity
+ */
+void TimeBaseInit(void);
+/*!
+ * @brief Get the 32 bits time base counter value
+ * @return counter value in 1/32768 s
+ */
+uint32_t TimeBaseGetTicks(void);
+/*!
+ * @brief Get the time base counter value extended with its roll over count
+ * @return number of 1/32768 s since time base start up
+ */
+uint64_t TimeBaseGetTicks64(void);
+/*!
+ * @brief Get the number of milliseconds since time base start up
+ * @return number of milliseconds (wraps after 49 days)
+ */
+uint32_t TimeBaseGetMs(void);
+/*!
+ * @brief Get the number of microseconds since time base start up
+ * @return number of microseconds (30.52 us resolution)
+ */
+uint64_t TimeBaseGetUs(void);
+/*!
+ * @brief Program a compare channel to fire at an absolute counter value
+ * @param[in] channel	Compare channel
+ * @param[in] target	Counter value. If already reached, the channel fires immediately.
+ */
+void TimeBaseSetCompare(TIMEBASE_CHANNEL channel, uint32_t target);
+/*!
+ * @brief Cancel a compare channel
+ * @param[in] channel	Compare channel
+ */
+void TimeBaseStopCompare(TIMEBASE_CHANNEL channel);
+/*!
+ * @brief Check whether a compare channel fired and its handler is not called yet
+ * @param[in] channel	Compare channel
+ * @return true if the channel IRQ is pending
+ */
+int TimeBaseIsPending(TIMEBASE_CHANNEL channel);
+/*!
+ * @brief Get the time left before the nearest armed compare channel fires
+ * @return number of ticks, 0 if a channel is pending, TIMEBASE_NO_DEADLINE if none is armed
+ */
+uint32_t TimeBaseGetNextDeadline(void);
+/*!
+ * @brief Account for time elapsed while the counter clock was stopped (EM3)
+ * @param[in] ticks	Number of ticks to add to the time base
+ * @remark Armed compare channels keep their absolute target and fire immediately if it was passed
+ */
+void TimeBaseSkip(uint32_t ticks);
+/*!
+ * @brief User defined OS tick compare channel IRQ handler
+ */
+void TimeBaseOSTick_Handler(void);
+/*!
+ * @brief User defined timer compare channel IRQ handler
+ */
+void TimeBaseTimer_Handler(void);
+
+/** }@ */
+#endif
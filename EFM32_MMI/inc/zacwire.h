@@ -0,0 +1,58 @@
+/*******************************************************************
+**                                                                **
+** ZACWire (TSIC sensors) frame decoding functions.               **
+** Hardware independent, can be compiled on any host.             **
+**                                                                **
+*******************************************************************/
+
+#ifndef __ZACWIRE_H__
+#define __ZACWIRE_H__
+
+/** \addtogroup MMI MyMeterInfo add-on functions
+ *  @{
+ */
+
+/*!
+ * @brief Number of edges in a TSIC temperature frame
+ * A frame holds 2 packets of 10 bits (start strobe + 8 data bits + even parity),
+ * each bit starts with a falling edge and ends with a rising edge.
+ */
+#define ZACWIRE_FRAME_EDGES		40
+/*!
+ * @brief Shortest idle time before a frame (in µs)
+ * The line stays high about 100 ms between frames, but never longer than a bit period
+ * (125 µs) inside a frame, so a capture synchronized on this gap always starts on a frame.
+ */
+#define ZACWIRE_FRAME_GAP		1000
+
+/*!
+ * @brief ZACWire decoding result
+ */
+typedef enum {
+	ZACWireOK = 0,			//!< Frame decoded
+	ZACWireNoSignal,		//!< No edge captured, sensor is absent or not powered
+	ZACWireFrameError,		//!< Missing edges or inconsistent bit timing
+	ZACWireParityError		//!< Parity check failed
+} ZACWIRE_STATUS;
+
+/*!
+ * @brief Decode a TSIC frame from its edges time stamps
+ * @param [in] edges	Edges time stamps, starting with the falling edge of the first start strobe.
+ * 						Time stamps are free running 16 bits counter values, any time base can be used.
+ * @param [in] count	Number of time stamps in edges
+ * @param [out] value	Decoded 11 bits sensor value
+ * @return 				Decoding status, value is only updated when ZACWireOK is returned
+ */
+ZACWIRE_STATUS ZACWireDecode(const unsigned short* edges, int count, unsigned short* value);
+/*!
+ * @brief Convert a TSIC sensor value in 1/10 °C
+ * @param [in] value	11 bits sensor value
+ * @param [in] lowRef	Sensor lowest temperature in °C (-50 for TSIC 306)
+ * @param [in] highRef	Sensor highest temperature in °C (150 for TSIC 306)
+ * @return 				Temperature in 1/10 °C
+ */
+long ZACWireToTemperature(unsigned short value, int lowRef, int highRef);
+
+/** }@ */
+
+#endif
@@ -0,0 +1,76 @@
+/*******************************************************************
+**                                                                **
+** ADC samples filtering and scaling functions.                   **
+**                                                                **
+*******************************************************************/
+
+#include "adc_filter.h"
+
+/** @cond */
+static void ADCFilterSort(short* samples, int count)
+{
+  // Insertion sort: sample buffers are small and often nearly sorted
+  for (int i = 1; i < count; i++)
+  {
+    short v = samples[i];
+    int j = i;
+    while ((j > 0) && (samples[j-1] > v))
+    {
+      samples[j] = samples[j-1];
+      j--;
+    }
+    samples[j] = v;
+  }
+}
+
+static long ADCFilterMeanRange(const short* samples, int count)
+{
+  long sum = 0;
+  for (int i = 0; i < count; i++)
+    sum += samples[i];
+  // Round to nearest, half away from zero
+  return (sum >= 0) ? ((sum + (count / 2)) / count) : -((-sum + (count / 2)) / count);
+}
+/** @endcond */
+
+long ADCFilterSamples(short* samples, int count, ADC_FILTER filter)
+{
+  if ((samples == 0) || (count <= 0)) return 0;
+  switch (filter)
+  {
+  case ADCFilterMedian:
+    ADCFilterSort(samples, count);
+    if (count & 1) return samples[count / 2];
+    return ADCFilterMeanRange(&samples[(count / 2) - 1], 2);
+  case ADCFilterTrimmedMean:
+    ADCFilterSort(samples, count);
+    return ADCFilterMeanRange(&samples[count / 4], count - (2 * (count / 4)));
+  case ADCFilterMean:
+  default:
+    return ADCFilterMeanRange(samples, count);
+  }
+}
+
+void ADCFilterRectify(short* samples, int count)
+{
+  if (samples == 0) return;
+  for (int i = 0; i < count; i++)
+  {
+    if (samples[i] < 0) samples[i] = (samples[i] == -32768) ? 32767 : -samples[i];
+  }
+}
+
+unsigned long ADCScale4_20mA(long value, int reference_mV, int fullScale)
+{
+  if ((value <= 0) || (fullScale <= 0)) return 0;
+  // Each ADC unit = (reference / fullScale) mV / 120 Ohms
+  // => µA = value * (reference / 2) * 25 / (3 * fullScale)
+  return (unsigned long)(((unsigned long long)value * (reference_mV / 2) * 25) / (3ULL * fullScale));
+}
+
+unsigned long ADCScale0_10V(long value, int reference_mV, int fullScale)
+{
+  if ((value <= 0) || (fullScale <= 0)) return 0;
+  // Each ADC unit = (reference / fullScale) * 4 / 2 mV
+  return (unsigned long)(((unsigned long long)value * reference_mV * 2) / (unsigned long long)fullScale);
+}
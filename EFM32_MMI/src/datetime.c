@@ -16,6 +16,28 @@ static const unsigned char daysInMonth[] = {31,28,31,30,31,30,31,31,30,31,30,31}
 static short _timeOffset = 0;
 static unsigned char *_DSTSpecs = NULL; //EUROPEAN_DST;
 
+#define DAYS_PER_4_YEARS	1461	// 3 * 365 + 366, every 4th year is a leap year from 2000
+
+/*
+ * DST transitions of one year for one specification, in local hours since January 1st 00:00
+ */
+typedef struct {
+  const unsigned char* specs;	// Specification the transitions were computed for
+  unsigned long locale;			// DateTimeSetLocale calls count when they were computed
+  unsigned short year;			// Year the transitions were computed for
+  unsigned char valid;			// Specification could be parsed
+  unsigned short start;			// First hour of DST period
+  unsigned short end;			// First hour after DST period
+} DST_CACHE;
+/*
+ * The cache is shared by all tasks without a lock: it is written under an odd sequence number
+ * and readers keep a copy only if the sequence number did not change while they copied it.
+ * A task finding the cache being written computes the transitions for itself.
+ */
+static DST_CACHE _dstCache = { NULL, 0, 0, 0, 0, 0 };
+static volatile unsigned long _dstSequence = 0;
+static volatile unsigned long _dstLocale = 0;
+
 static void alignShortCopy(unsigned char *buffer, unsigned short i) {
   buffer[0] = (unsigned char)(i & 0xFF);
   buffer[1] = (unsigned char)((i >> 8) & 0xFF);
@@ -34,37 +56,47 @@ unsigned char DateTimeDaysInMonth(unsigned char month, unsigned short year) {
 	return daysInMonth[month-1] + ((((year %4)==0) && (month==2)) ? 1 : 0);
 }
 
+/*
+ * Converts a day number into a date in constant time
+ * Day 1 is 01/01/2000, and as for DateTimeGetSeconds, every 4th year is a leap year
+ */
+static void daysToCivil(unsigned long N, unsigned short* year, unsigned char* month, unsigned char* day) {
+  N--;	// Day 0 is now 01/01/2000
+  unsigned short y = (unsigned short)((N / DAYS_PER_4_YEARS) * 4);
+  N %= DAYS_PER_4_YEARS;
+  // First year of each 4 years cycle is the leap year
+  if (N >= 366) {
+    N -= 366;
+    y += 1 + (N / 365);
+    N %= 365;
+  }
+  // Months are at least 28 days long, so N / 32 is the month or the previous one
+  unsigned char m = (unsigned char)(N >> 5) + 1;
+  if ((m < 12) && (N >= (unsigned long)daysinyear(m,y))) m++;
+  *year = y + 2000;
+  *month = m;
+  *day = (unsigned char)(N + 1 - daysinyear(m-1,y));
+}
+
 void DateTimeFromSeconds(const unsigned long seconds, DATETIME_STRUCT* dt) {
   if (dt) {
 	  memset(dt,0,sizeof(DATETIME_STRUCT));
     // Calculate the number of days
     unsigned long N = seconds / 86400UL;	// (24*60*60) = 86400 seconds per day
+    unsigned short year = 1999;
+    // Set Day of week
+    // if N = 1 -> 01Jan2000 = Saturday - So offset day of week by 6-1
+    dt->dayOfWeek = ((N % 7) + 5) % 7;
     if (N) {
-    	// Set Day of week
-    	// if N = 1 -> 01Jan2000 = Saturday - So offset day of week by 6-1
-    	dt->dayOfWeek = ((N % 7) + 5) % 7;
-		// Calculate Year
-		unsigned short year = 0;	// Starting year is 2000
-		while (N > daysinyear(12,year))
-		{
-			N -=daysinyear(12,year);
-			year++;
-		}
-		// Compute current month
-		dt->month = 0;
-		while ((++dt->month < 12) && (N > daysinyear(dt->month,year))) ;
-		N -= daysinyear(dt->month-1,year);
-		dt->day = (unsigned char)N;
-	    alignShortCopy((unsigned char*)&dt->year,year+2000);
+    	daysToCivil(N, &year, &dt->month, &dt->day);
     }
     else
     {
-    	dt->dayOfWeek = DateTimeFriday;
     	dt->month = 12;
     	dt->day = 31;
-        alignShortCopy((unsigned char*)&dt->year,1999);
     }
     // This strange code is necessary if the provided buffer is not memory aligned
+    alignShortCopy((unsigned char*)&dt->year,year);
     // Compute current time
     N = seconds % 86400UL;
     dt->hour= (unsigned char)(N / 3600UL);     	// (24*60*60) = 86400 seconds per day
@@ -74,6 +106,26 @@ void DateTimeFromSeconds(const unsigned long seconds, DATETIME_STRUCT* dt) {
   }
 }
 
+void DateTimeFromSecondsBatch(const unsigned long* seconds, DATETIME_STRUCT* dt, int count) {
+  unsigned long day = 0xFFFFFFFFUL;
+  for (int i = 0; i < count; i++) {
+    unsigned long N = seconds[i] / 86400UL;
+    if ((i > 0) && (N == day)) {
+      // Same day as previous record: only time has to be computed
+      dt[i] = dt[i-1];
+      N = seconds[i] % 86400UL;
+      dt[i].hour = (unsigned char)(N / 3600UL);
+      N %= 3600UL;
+      dt[i].min = (unsigned char)(N / 60UL);
+      dt[i].sec = (unsigned char)(N % 60UL);
+    }
+    else {
+      DateTimeFromSeconds(seconds[i], &dt[i]);
+      day = N;
+    }
+  }
+}
+
 unsigned long DateTimeGetSeconds(const DATETIME_STRUCT *dt)
 {
   unsigned short year;
@@ -189,20 +241,11 @@ unsigned char DateTimeFromISO8601String(DATETIME_STRUCT *dt, const unsigned char
 unsigned long DateTimeSecondsToFatTime(unsigned long seconds)
 {
   // Calculate the number of days
-  unsigned short N = seconds / 86400;	// (24*60*60) = 86400 seconds per day
-  // Calculate Year
-  unsigned short year = 0;	// Starting year is 2000
-  while (N > (((year % 4) == 0) ? 366 : 365))
-  {
-      N -=(((year % 4) == 0) ? 366 : 365);
-      year++;
-  }
-  // Compute current month
-  unsigned char month = 0;
-  while ((++month < 12) && (N > daysinyear(month,year))) ;
-  N -= daysinyear(month-1,year);
-  short day = (N) ? N : 1;
-  year += 2000;
+  unsigned long N = seconds / 86400;	// (24*60*60) = 86400 seconds per day
+  unsigned short year = 2000;
+  unsigned char month = 1;
+  unsigned char day = 1;
+  if (N) daysToCivil(N, &year, &month, &day);
   // Compute current time
   short hour=(seconds % 86400)/3600;     	// (24*60*60) = 86400 seconds per day
   short min= (seconds % 86400)%3600 / 60;      // 60 seconds per minute
@@ -280,39 +323,71 @@ int DateTimeSecondsIsDSTExt(const unsigned long seconds, unsigned char* DSTSpecs
 	  return DateTimeIsDSTExt(&timestamp,DSTSpecs);
 }
 
-int DateTimeIsDSTExt(DATETIME_STRUCT *dt, unsigned char* DSTSpecs) {
+/*
+ * Computes the local hour of year of a DST transition
+ */
+static unsigned short getDSTTransition(unsigned short year, unsigned char month,
+		unsigned char week, unsigned char dow, unsigned char time) {
+	// Get first day of week of the transition month
+	unsigned char dow1 = DateTimeDayOfWeek(year,month,1);
+	// Search for first dow, then for the requested week in month
+	unsigned char day = 1 + ((7 + dow - dow1) % 7) + (7 * (week-1));
+	unsigned char last = DateTimeDaysInMonth(month,year);
+	while (day > last) day -= 7;	// in case of last day of month, check for overflow
+	return (unsigned short)(((daysinyear(month-1,year) + day - 1) * 24) + time);
+}
+
+/*
+ * Gets the DST transitions for a specification and a year in dst
+ * The DST specification is only parsed once a year or when it changes
+ */
+static void getDSTCache(unsigned char* DSTSpecs, unsigned short year, DST_CACHE* dst) {
+	unsigned long locale = _dstLocale;
+	unsigned long sequence = __atomic_load_n(&_dstSequence, __ATOMIC_ACQUIRE);
+	if (!(sequence & 1)) {
+		*dst = _dstCache;
+		__atomic_thread_fence(__ATOMIC_ACQUIRE);
+		if ((_dstSequence == sequence) && (dst->specs == DSTSpecs) && (dst->locale == locale) && (dst->year == year)) return;
+	}
 	unsigned char m1, w1, d1, t1;
 	unsigned char m2, w2, d2, t2;
-	if (!DSTSpecs) return 0;
-	unsigned char* p = DSTSpecs;
+	dst->specs = DSTSpecs;
+	dst->locale = locale;
+	dst->year = year;
+	dst->valid = 0;
 	// Skip zone name and standard names
-	p = (unsigned char*)strchr((char*)p,',');
-	if (*p) p++;
-	p = getDSTData(p,&m1,&w1,&d1,&t1);
+	unsigned char* p = (unsigned char*)strchr((char*)DSTSpecs,',');
+	if (p) p = getDSTData(++p,&m1,&w1,&d1,&t1);
 	if (p) p = getDSTData(p,&m2,&w2,&d2,&t2);
-	if (!p) return 0;
-	if ((dt->month < m1) || (dt->month > (m2+1))) return 0;
-	if ((dt->month > m1) && (dt->month < m2)) return 1;
-	// So now, we are in either m1 or m2 month
-	// Get first day of week of the current month (either m1 or m2)
-	unsigned char day = 1;
-	unsigned char dow = DateTimeDayOfWeek(dt->year,dt->month,day);
-	// Seach for first d1 or d2
-	while (dow != ((dt->month == m1) ? d1 : d2)) { day++; dow = (dow + 1) % 7; }
-	// search for w1 or w2 date in month
-	day += (7 * (((dt->month == m1) ? w1 : w2)-1));
-	while (day > DateTimeDaysInMonth(dt->month,dt->year)) day -= 7;	// in case of last day of month, check for overflow
-	if (dt->day < day) return (dt->month == m1) ? 0 : 1;
-	if (dt->day > day) return  (dt->month == m1) ? 1 : 0;
-	// Ouch ! We are exactly the day of time change
-	if (dt->hour < ((dt->month == m1) ? t1 : t2)) return  (dt->month == m1) ? 0 : 1;
-	if (dt->hour >= ((dt->month == m1) ? t1 : t2)) return  (dt->month == m1) ? 1 : 0;
-	return 0;
+	if (p && m1 && (m1 < 13) && m2 && (m2 < 13) && w1 && w2 && (d1 < 7) && (d2 < 7)) {
+		dst->start = getDSTTransition(year,m1,w1,d1,t1);
+		dst->end = getDSTTransition(year,m2,w2,d2,t2);
+		dst->valid = 1;
+	}
+	// Publish the transitions, unless another task is writing the cache
+	if (!(sequence & 1) && __atomic_compare_exchange_n(&_dstSequence, &sequence, sequence + 1,
+			0, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+		_dstCache = *dst;
+		__atomic_store_n(&_dstSequence, sequence + 2, __ATOMIC_RELEASE);
+	}
+}
+
+int DateTimeIsDSTExt(DATETIME_STRUCT *dt, unsigned char* DSTSpecs) {
+	DST_CACHE dst;
+	if (!DSTSpecs || !dt->month || (dt->month > 12)) return 0;
+	unsigned short year = alignGetShort((unsigned char*)&dt->year);
+	getDSTCache(DSTSpecs, year, &dst);
+	if (!dst.valid) return 0;
+	unsigned short hour = (unsigned short)(((daysinyear(dt->month-1,year) + dt->day - 1) * 24) + dt->hour);
+	if (dst.start <= dst.end) return ((hour >= dst.start) && (hour < dst.end)) ? 1 : 0;
+	// Southern hemisphere: DST period spans over new year
+	return ((hour >= dst.start) || (hour < dst.end)) ? 1 : 0;
 }
 
 void DateTimeSetLocale(unsigned char *DSTSpecs) {
 	_DSTSpecs = DSTSpecs;
 	_timeOffset = 0;
+	__atomic_add_fetch(&_dstLocale, 1, __ATOMIC_RELEASE);	// Specification content may have changed
 	if (DSTSpecs) {
 		// DSTSpecs = "std +/- offset dst_std,rules
 		// If std is not defined, <> can be used. ex. <+05>-05
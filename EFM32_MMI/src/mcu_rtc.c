@@ -6,16 +6,57 @@
 
 #include "mcu_rtc.h"
 #include "system.h"
+#include "timebase.h"
 
-static unsigned long _RTC_Counter;
+// Wall time is anchored on the time base and runs at its rate corrected by _RTC_Trim
+static uint64_t _RTC_AnchorTicks = 0;							// Time base value at the anchor
+static uint64_t _RTC_AnchorTime = 86400ULL << TIMEBASE_SHIFT;	// Wall time at the anchor, 01/01/2000 until set
+static long _RTC_Trim = 0;										// Rate correction in parts per billion
+
+static uint64_t RTCCorrected(uint64_t now)
+{
+  int64_t elapsed = (int64_t)(now - _RTC_AnchorTicks);
+  return _RTC_AnchorTime + elapsed + (elapsed * _RTC_Trim) / 1000000000LL;
+}
+
+uint64_t RTCGetTicks(void)
+{
+  SystemIrqDisable();
+  uint64_t time = RTCCorrected(TimeBaseGetTicks64());
+  SystemIrqEnable();
+  return time;
+}
+
+void RTCSetTicks(const uint64_t ticks)
+{
+  SystemIrqDisable();
+  _RTC_AnchorTicks = TimeBaseGetTicks64();
+  _RTC_AnchorTime = ticks;
+  SystemIrqEnable();
+}
+
+long RTCGetTrim(void)
+{
+  return _RTC_Trim;
+}
+
+void RTCSetTrim(const long ppb)
+{
+  SystemIrqDisable();
+  // Re-anchor so that the new rate only applies from now on
+  uint64_t now = TimeBaseGetTicks64();
+  _RTC_AnchorTime = RTCCorrected(now);
+  _RTC_AnchorTicks = now;
+  _RTC_Trim = ppb;
+  SystemIrqEnable();
+}
 
 unsigned long RTCGetSeconds(void)
 {
-  unsigned long N = ((_RTC_Counter) ? _RTC_Counter : 86400UL) + SystemGetSystemSeconds();
-  return N;
+  return (unsigned long)(RTCGetTicks() >> TIMEBASE_SHIFT);
 }
 
 void RTCSetSeconds(const unsigned long seconds)
 {
-  _RTC_Counter = seconds - SystemGetSystemSeconds();
+  RTCSetTicks((uint64_t)seconds << TIMEBASE_SHIFT);
 }
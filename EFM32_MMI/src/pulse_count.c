@@ -0,0 +1,22 @@
+/*******************************************************************
+**                                                                **
+** Pulse input counting functions.                                **
+**                                                                **
+*******************************************************************/
+
+#include "pulse_count.h"
+
+bool PulseCountDebounce(unsigned long* lastEdge, unsigned long now, unsigned long debounce)
+{
+  // Unsigned difference, the time may wrap between two edges
+  if ((now - *lastEdge) < debounce) return false;
+  *lastEdge = now;
+  return true;
+}
+
+unsigned short PulseCountDelta(unsigned short* last, unsigned short count)
+{
+  unsigned short delta = (unsigned short)(count - *last);
+  *last = count;
+  return delta;
+}
@@ -0,0 +1,95 @@
+/*******************************************************************
+**                                                                **
+** SHT7x temperature and humidity sensor conversion functions.    **
+**                                                                **
+*******************************************************************/
+
+#include "sht_convert.h"
+#include <stdint.h>
+
+/** @cond */
+/*
+ * Datasheet formulas for 14 bits temperature and 12 bits humidity readings:
+ *   T = d1 + 0.01 * SOT
+ *   RHlinear = -2.0468 + 0.0367 * SORH - 1.5955E-6 * SORH^2
+ *   RHtrue = (T - 25) * (0.01 + 0.00008 * SORH) + RHlinear
+ *   Td = Tn * g / (m - g), g = ln(RH / 100) + m * T / (Tn + T)
+ * Results are in 0.01 units: the temperature and the compensation term are exact integer
+ * ratios, the humidity polynomial is evaluated in Q28 with 32x32 bits products only.
+ */
+#define SHT_C1_Q28		(-54943369134LL)	// -204.68 (0.01 %RH) in Q28
+#define SHT_C2_Q28		985158124L			// 3.67
+#define SHT_C3_Q28		42829L				// 1.5955E-4
+#define SHT_LN2_Q16		45426L				// ln(2)
+#define SHT_LN100_Q16	603609L				// ln(10000), 100 %RH in 0.01 %RH
+#define SHT_LN_STEPS	5					// ln table has 2^5 steps between 1 and 2
+
+// Magnus coefficients, Tn in 0.01 °C
+#define SHT_WATER_TN	24312L
+#define SHT_WATER_M100	1762L
+#define SHT_ICE_TN		27262L
+#define SHT_ICE_M100	2246L
+
+// ln(1 + i/32) in Q16
+static const unsigned short SHTLnTable[(1 << SHT_LN_STEPS) + 1] = {
+	    0,  2017,  3973,  5873,  7719,  9515, 11262, 12965,
+	14624, 16242, 17821, 19364, 20870, 22343, 23783, 25193,
+	26573, 27924, 29248, 30546, 31818, 33067, 34292, 35494,
+	36675, 37835, 38975, 40095, 41196, 42280, 43345, 44394,
+	45426
+};
+
+static long SHTDivideRound(long num, long den)
+{
+  // Round to nearest, half away from zero (den > 0)
+  return (num >= 0) ? ((num + (den / 2)) / den) : -((-num + (den / 2)) / den);
+}
+
+// Natural logarithm of x (x > 0) in Q16, interpolated from the table (error < 1.3E-4)
+static long SHTLn(unsigned long x)
+{
+  int k = 31 - __builtin_clz(x);
+  unsigned long f = (k > 16) ? (x >> (k - 16)) : (x << (16 - k));	// Mantissa in Q16, 1 to 2
+  unsigned long r = f - 0x10000UL;
+  unsigned long i = r >> (16 - SHT_LN_STEPS);
+  unsigned long frac = r & ((1UL << (16 - SHT_LN_STEPS)) - 1);
+  long step = (long)SHTLnTable[i + 1] - (long)SHTLnTable[i];
+  return (k * SHT_LN2_Q16) + SHTLnTable[i] + (((step * (long)frac) + (1L << (15 - SHT_LN_STEPS))) >> (16 - SHT_LN_STEPS));
+}
+/** @endcond */
+
+long SHTConvertTemperature(unsigned short raw)
+{
+  return SHT_D1 + (long)(raw & 0x3FFF);
+}
+
+long SHTConvertHumidity(unsigned short raw)
+{
+  uint32_t s = raw & 0x0FFF;
+  int64_t acc = SHT_C1_Q28 + ((int64_t)SHT_C2_Q28 * s) - ((int64_t)SHT_C3_Q28 * (s * s));
+  return (long)((acc + (1LL << 27)) >> 28);
+}
+
+long SHTCompensateHumidity(unsigned short raw, long temperature)
+{
+  long s = raw & 0x0FFF;
+  // (T - 25) * (0.01 + 0.00008 * SORH) in 0.01 %RH is (T - 2500) * (125 + SORH) / 12500
+  long rh = SHTConvertHumidity(raw) + SHTDivideRound((temperature - 2500) * (125 + s), 12500);
+  if (rh < 0) return 0;
+  if (rh > 10000) return 10000;
+  return rh;
+}
+
+long SHTDewPoint(long humidity, long temperature)
+{
+  long tn = (temperature < 0) ? SHT_ICE_TN : SHT_WATER_TN;
+  long m100 = (temperature < 0) ? SHT_ICE_M100 : SHT_WATER_M100;
+  if (humidity < 1) humidity = 1;
+  if (humidity > 10000) humidity = 10000;
+  // g = ln(RH / 100) + m * T / (Tn + T) in Q16
+  long ratio = (temperature * 65536L) / (tn + temperature);
+  long g = SHTLn((unsigned long)humidity) - SHT_LN100_Q16 + SHTDivideRound(ratio * m100, 100);
+  // Td = Tn * g / (m - g), in Q12 to keep the product in 32 bits
+  long m = SHTDivideRound(m100 * 65536L, 100);
+  return SHTDivideRound(tn * SHTDivideRound(g, 16), SHTDivideRound(m - g, 16));
+}
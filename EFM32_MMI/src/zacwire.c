@@ -0,0 +1,64 @@
+/*******************************************************************
+**                                                                **
+** ZACWire (TSIC sensors) frame decoding functions.               **
+**                                                                **
+*******************************************************************/
+
+#include "zacwire.h"
+
+/** @cond */
+#define ZACWIRE_PACKET_EDGES	(ZACWIRE_FRAME_EDGES / 2)
+#define ZACWIRE_PACKET_BITS		9		// 8 data bits + parity
+
+static int ZACWireOddParity(unsigned int b)
+{
+  b ^= b >> 4;
+  b ^= b >> 2;
+  b ^= b >> 1;
+  return (int)(b & 1);
+}
+
+/*
+ * Decode one packet: start strobe (50% duty cycle) followed by 9 bits.
+ * A bit whose low level is shorter than the strobe one is a logic 1.
+ */
+static ZACWIRE_STATUS ZACWireDecodePacket(const unsigned short* edges, unsigned char* byte)
+{
+  unsigned short strobe = (unsigned short)(edges[1] - edges[0]);
+  unsigned int value = 0;
+  unsigned int minPeriod = (strobe << 1) - (strobe >> 2), maxPeriod = (strobe << 1) + (strobe >> 2);
+  if (strobe == 0) return ZACWireFrameError;
+  for (int b = 0; b < ZACWIRE_PACKET_BITS; b++)
+  {
+    const unsigned short* bit = &edges[2 + (b << 1)];
+    unsigned short low = (unsigned short)(bit[1] - bit[0]);
+    unsigned short period = (unsigned short)(bit[0] - bit[-2]);
+    // A bit period lasts twice the strobe low level (+/- 12.5%), a missed edge shifts the next ones
+    if ((low == 0) || (low >= period) || (period < minPeriod) || (period > maxPeriod)) return ZACWireFrameError;
+    value = (value << 1) | ((low < strobe) ? 1 : 0);
+  }
+  // Parity bit makes the number of 1 even
+  if ((int)(value & 0x01) != ZACWireOddParity(value >> 1)) return ZACWireParityError;
+  *byte = (unsigned char)(value >> 1);
+  return ZACWireOK;
+}
+/** @endcond */
+
+ZACWIRE_STATUS ZACWireDecode(const unsigned short* edges, int count, unsigned short* value)
+{
+  unsigned char high, low;
+  ZACWIRE_STATUS status;
+  if ((edges == 0) || (count <= 0)) return ZACWireNoSignal;
+  if (count < ZACWIRE_FRAME_EDGES) return ZACWireFrameError;
+  if ((status = ZACWireDecodePacket(edges, &high)) != ZACWireOK) return status;
+  if ((status = ZACWireDecodePacket(&edges[ZACWIRE_PACKET_EDGES], &low)) != ZACWireOK) return status;
+  if (high > 0x07) return ZACWireFrameError;	// Only 11 bits are significant
+  if (value) *value = (unsigned short)((high << 8) | low);
+  return ZACWireOK;
+}
+
+long ZACWireToTemperature(unsigned short value, int lowRef, int highRef)
+{
+  // Manufacturer formula: T°C = ((Value / 2047) * (HIGHREF - LOWREF)) + LOWREF
+  return (((long)value * (long)((highRef - lowRef) * 10)) / 2047L) + (long)(lowRef * 10);
+}
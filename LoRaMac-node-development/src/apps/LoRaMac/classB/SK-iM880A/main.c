@@ -648,6 +648,8 @@ int main( void )
                 LoRaMacPrimitives.MacMcpsIndication = McpsIndication;
                 LoRaMacPrimitives.MacMlmeConfirm = MlmeConfirm;
                 LoRaMacCallbacks.GetBatteryLevel = BoardGetBatteryLevel;
+                LoRaMacCallbacks.GetRxBuffer = NULL;
+                LoRaMacCallbacks.TxDone = NULL;
                 LoRaMacInitialization( &LoRaMacPrimitives, &LoRaMacCallbacks, LORAMAC_REGION_EU868 );
 
                 TimerInit( &TxNextPacketTimer, OnTxNextPacketTimerEvent );
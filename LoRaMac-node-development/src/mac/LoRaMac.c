@@ -23,6 +23,9 @@ Maintainer: Miguel Luis ( Semtech ), Gregory Cristian ( Semtech ) and Daniel Jae
 #include "region/Region.h"
 #include "LoRaMacCrypto.h"
 #include "LoRaMacTest.h"
+#include "rx-calibration.h"
+#include "adr-predict.h"
+#include "perf.h"
 #include "trace.h"
 
 #undef	__MODULE__
@@ -187,6 +190,11 @@ static bool IsLoRaMacNetworkJoined = false;
  */
 static bool AdrCtrlOn = false;
 
+/*!
+ * LoRaMac predictive ADR status
+ */
+static bool AdrPredictOn = false;
+
 /*!
  * Counts the number of missed ADR acknowledgements
  */
@@ -493,20 +501,6 @@ static void RxWindowSetup( bool rxContinuous, uint32_t maxRxWindow );
  */
 static LoRaMacStatus_t AddMacCommand( uint8_t cmd, uint8_t p1, uint8_t p2 );
 
-/*!
- * \brief Parses the MAC commands which must be repeated.
- *
- * \Remark MAC layer internal function
- *
- * \param [IN] cmdBufIn  Buffer which stores the MAC commands to send
- * \param [IN] length  Length of the input buffer to parse
- * \param [OUT] cmdBufOut  Buffer which stores the MAC commands which must be
- *                         repeated.
- *
- * \retval Size of the MAC commands to repeat.
- */
-static uint8_t ParseMacCommandsToRepeat( uint8_t* cmdBufIn, uint8_t length, uint8_t* cmdBufOut );
-
 /*!
  * \brief Validates if the payload fits into the frame, taking the datarate
  *        into account.
@@ -614,6 +608,7 @@ static void OnRadioTxDone( void )
     TimerTime_t curTime = TimerGetCurrentTime( );
 
 //    TRACE(0,"OnRadioTxDone\n");
+    RxCalibrationTxDone( );
     if( LoRaMacDeviceClass != CLASS_C )
     {
         Radio.Sleep( );
@@ -665,6 +660,12 @@ static void OnRadioTxDone( void )
         LastTxIsJoinRequest = false;
     }
 
+    if( ( IsLoRaMacNetworkJoined == true ) && ( LastTxIsJoinRequest == false ) &&
+        ( LoRaMacCallbacks != NULL ) && ( LoRaMacCallbacks->TxDone != NULL ) )
+    {
+        LoRaMacCallbacks->TxDone( UpLinkCounter );
+    }
+
     // Store last Tx channel
     LastTxChannel = Channel;
     // Update last tx done time for the current channel
@@ -674,6 +675,7 @@ static void OnRadioTxDone( void )
     RegionSetBandTxDone( LoRaMacRegion, &txDone );
     // Update Aggregated last tx done time
     AggregatedLastTxDoneTime = curTime;
+    MlmeConfirm.TxDoneTime = curTime;
 
     if( NodeAckRequested == false )
     {
@@ -699,6 +701,24 @@ static void PrepareRxDoneAbort( void )
     TimerStart( &MacStateCheckTimer );
 }
 
+/*!
+ * \brief Gets the buffer a received payload is handed over to the application in
+ *
+ * \param [IN] size Payload size
+ * \retval Application buffer, owned by the MAC until the indication, or the MAC
+ *         buffer if the application has none
+ */
+static uint8_t* GetRxPayloadBuffer( uint8_t size )
+{
+    uint8_t* buffer = NULL;
+
+    if( ( LoRaMacCallbacks != NULL ) && ( LoRaMacCallbacks->GetRxBuffer != NULL ) )
+    {
+        buffer = LoRaMacCallbacks->GetRxBuffer( size );
+    }
+    return ( buffer != NULL ) ? buffer : LoRaMacRxPayload;
+}
+
 static void OnRadioRxDone( uint8_t *payload, uint16_t size, int16_t rssi, int8_t snr )
 {
     LoRaMacHeader_t macHdr;
@@ -728,11 +748,27 @@ static void OnRadioRxDone( uint8_t *payload, uint16_t size, int16_t rssi, int8_t
     uint8_t multicast = 0;
 
     bool isMicOk = false;
+    uint32_t rxDelay = 0;
+
+    RxCalibrationRxDone( Radio.TimeOnAir( SX1276.Settings.Modem, size ) );
+    if( LoRaMacDeviceClass == CLASS_A )
+    {
+        // Nominal delay of the window the frame was received in
+        if( IsLoRaMacNetworkJoined == false )
+        {
+            rxDelay = ( RxSlot == 0 ) ? LoRaMacParams.JoinAcceptDelay1 : LoRaMacParams.JoinAcceptDelay2;
+        }
+        else
+        {
+            rxDelay = ( RxSlot == 0 ) ? LoRaMacParams.ReceiveDelay1 : LoRaMacParams.ReceiveDelay2;
+        }
+    }
 
     McpsConfirm.AckReceived = false;
     McpsIndication.Rssi = rssi;
     McpsIndication.Snr = snr;
     McpsIndication.RxSlot = RxSlot;
+    McpsIndication.Channel = Channel;
     McpsIndication.Port = 0;
     McpsIndication.Multicast = 0;
     McpsIndication.FramePending = 0;
@@ -775,6 +811,7 @@ static void OnRadioRxDone( uint8_t *payload, uint16_t size, int16_t rssi, int8_t
             DUMP(0, LoRaMacRxPayload, size, "%16s : ", "Join Payload");
             if( micRx == mic )
             {
+                RxCalibrationRxValid( rxDelay );
                 LoRaMacJoinComputeSKeys( LoRaMacAppKey, LoRaMacRxPayload + 1, LoRaMacDevNonce, LoRaMacNwkSKey, LoRaMacAppSKey );
 
                 LoRaMacAppNonce = ( uint32_t )LoRaMacRxPayload[1];
@@ -920,6 +957,11 @@ static void OnRadioRxDone( uint8_t *payload, uint16_t size, int16_t rssi, int8_t
 
                 if( isMicOk == true )
                 {
+                    if( multicast == 0 )
+                    {
+                        RxCalibrationRxValid( rxDelay );
+                        AdrPredictRxDone( McpsIndication.RxDatarate, snr, LoRaMacParams.MaxEirp );
+                    }
                     McpsIndication.Status = LORAMAC_EVENT_INFO_STATUS_OK;
                     McpsIndication.Multicast = multicast;
                     McpsIndication.FramePending = fCtrl.Bits.FPending;
@@ -1033,6 +1075,8 @@ static void OnRadioRxDone( uint8_t *payload, uint16_t size, int16_t rssi, int8_t
                         }
                         else
                         {
+                            uint8_t* rxPayload = ( skipIndication == false ) ? GetRxPayloadBuffer( frameLen ) : LoRaMacRxPayload;
+
                             if( fCtrl.Bits.FOptsLen > 0 )
                             {
                                 // Decode Options field MAC commands. Omit the fPort.
@@ -1046,14 +1090,14 @@ static void OnRadioRxDone( uint8_t *payload, uint16_t size, int16_t rssi, int8_t
                                                    address,
                                                    DOWN_LINK,
                                                    downLinkCounter,
-                                                   LoRaMacRxPayload );
+                                                   rxPayload );
 
                             if( skipIndication == false )
                             {
-                                McpsIndication.Buffer = LoRaMacRxPayload;
+                                McpsIndication.Buffer = rxPayload;
                                 McpsIndication.BufferSize = frameLen;
                                 McpsIndication.RxData = true;
-                                DUMP(0, LoRaMacRxPayload, frameLen, "%16s : ", "Rx Data");
+                                DUMP(0, rxPayload, frameLen, "%16s : ", "Rx Data");
                             }
                         }
                     }
@@ -1107,11 +1151,13 @@ static void OnRadioRxDone( uint8_t *payload, uint16_t size, int16_t rssi, int8_t
             break;
         case FRAME_TYPE_PROPRIETARY:
             {
-                memcpy1( LoRaMacRxPayload, &payload[pktHeaderLen], size );
+                uint8_t* rxPayload = GetRxPayloadBuffer( size - pktHeaderLen );
+
+                memcpy1( rxPayload, &payload[pktHeaderLen], size - pktHeaderLen );
 
                 McpsIndication.McpsIndication = MCPS_PROPRIETARY;
                 McpsIndication.Status = LORAMAC_EVENT_INFO_STATUS_OK;
-                McpsIndication.Buffer = LoRaMacRxPayload;
+                McpsIndication.Buffer = rxPayload;
                 McpsIndication.BufferSize = size - pktHeaderLen;
 
                 LoRaMacFlags.Bits.McpsInd = 1;
@@ -1216,6 +1262,13 @@ static void OnRadioRxTimeout( void )
         {
             LoRaMacFlags.Bits.MacDone = 1;
         }
+        // A downlink was expected in one of the windows
+        if( ( LoRaMacDeviceClass == CLASS_A ) &&
+            ( ( NodeAckRequested == true ) ||
+              ( ( LoRaMacFlags.Bits.MlmeReq == 1 ) && ( MlmeConfirm.MlmeRequest == MLME_JOIN ) ) ) )
+        {
+            RxCalibrationRxMissed( );
+        }
     }
 }
 
@@ -1335,6 +1388,7 @@ static void OnMacStateCheckTimerEvent( void )
             if( ( AckTimeoutRetriesCounter < AckTimeoutRetries ) && ( AckTimeoutRetriesCounter <= MAX_ACK_RETRIES ) )
             {
                 AckTimeoutRetriesCounter++;
+                AdrPredictMissed( );
 
                 if( ( AckTimeoutRetriesCounter % 2 ) == 1 )
                 {
@@ -1575,373 +1629,340 @@ static bool ValidatePayloadLength( uint8_t lenN, int8_t datarate, uint8_t fOptsL
     return false;
 }
 
-static LoRaMacStatus_t AddMacCommand( uint8_t cmd, uint8_t p1, uint8_t p2 )
+/*!
+ * MAC command processed in a block with the following commands of the same kind
+ */
+#define MAC_CMD_BLOCK                               0x01
+
+/*!
+ * MAC command answer repeated in every uplink until a downlink is received
+ */
+#define MAC_CMD_STICKY                              0x02
+
+/*!
+ * MAC command descriptor
+ */
+typedef struct sMacCommand
 {
-    LoRaMacStatus_t status = LORAMAC_STATUS_BUSY;
-    // The maximum buffer length must take MAC commands to re-send into account.
-    uint8_t bufLen = LORA_MAC_COMMAND_MAX_LENGTH - MacCommandsBufferToRepeatIndex;
+    /*!
+     * Command identifier
+     */
+    uint8_t Cid;
+    /*!
+     * Payload length, CID excluded
+     */
+    uint8_t Length;
+    /*!
+     * MAC_CMD_BLOCK and MAC_CMD_STICKY flags
+     */
+    uint8_t Flags;
+    /*!
+     * Downlink command handler. cmd points to the CID and size is the number of
+     * bytes of the command, or of the block of commands for MAC_CMD_BLOCK.
+     */
+    void ( *Handler )( uint8_t *cmd, uint8_t size, uint8_t snr );
+}MacCommand_t;
+
+static void ProcessLinkCheckAns( uint8_t *cmd, uint8_t size, uint8_t snr )
+{
+    MlmeConfirm.Status = LORAMAC_EVENT_INFO_STATUS_OK;
+    MlmeConfirm.DemodMargin = cmd[1];
+    MlmeConfirm.NbGateways = cmd[2];
+    AdrPredictLinkCheck( MlmeConfirm.DemodMargin, MlmeConfirm.NbGateways,
+                         LoRaMacParams.ChannelsDatarate, LoRaMacParams.ChannelsTxPower );
+}
 
-    switch( cmd )
-    {
-        case MOTE_MAC_LINK_CHECK_REQ:
-            if( MacCommandsBufferIndex < bufLen )
-            {
-                MacCommandsBuffer[MacCommandsBufferIndex++] = cmd;
-                // No payload for this command
-                status = LORAMAC_STATUS_OK;
-            }
-            break;
-        case MOTE_MAC_LINK_ADR_ANS:
-            if( MacCommandsBufferIndex < ( bufLen - 1 ) )
-            {
-                MacCommandsBuffer[MacCommandsBufferIndex++] = cmd;
-                // Margin
-                MacCommandsBuffer[MacCommandsBufferIndex++] = p1;
-                status = LORAMAC_STATUS_OK;
-            }
-            break;
-        case MOTE_MAC_DUTY_CYCLE_ANS:
-            if( MacCommandsBufferIndex < bufLen )
-            {
-                MacCommandsBuffer[MacCommandsBufferIndex++] = cmd;
-                // No payload for this answer
-                status = LORAMAC_STATUS_OK;
-            }
-            break;
-        case MOTE_MAC_RX_PARAM_SETUP_ANS:
-            if( MacCommandsBufferIndex < ( bufLen - 1 ) )
-            {
-                MacCommandsBuffer[MacCommandsBufferIndex++] = cmd;
-                // Status: Datarate ACK, Channel ACK
-                MacCommandsBuffer[MacCommandsBufferIndex++] = p1;
-                status = LORAMAC_STATUS_OK;
-            }
-            break;
-        case MOTE_MAC_DEV_STATUS_ANS:
-            if( MacCommandsBufferIndex < ( bufLen - 2 ) )
-            {
-                MacCommandsBuffer[MacCommandsBufferIndex++] = cmd;
-                // 1st byte Battery
-                // 2nd byte Margin
-                MacCommandsBuffer[MacCommandsBufferIndex++] = p1;
-                MacCommandsBuffer[MacCommandsBufferIndex++] = p2;
-                status = LORAMAC_STATUS_OK;
-            }
-            break;
-        case MOTE_MAC_NEW_CHANNEL_ANS:
-            if( MacCommandsBufferIndex < ( bufLen - 1 ) )
-            {
-                MacCommandsBuffer[MacCommandsBufferIndex++] = cmd;
-                // Status: Datarate range OK, Channel frequency OK
-                MacCommandsBuffer[MacCommandsBufferIndex++] = p1;
-                status = LORAMAC_STATUS_OK;
-            }
-            break;
-        case MOTE_MAC_RX_TIMING_SETUP_ANS:
-            if( MacCommandsBufferIndex < bufLen )
-            {
-                MacCommandsBuffer[MacCommandsBufferIndex++] = cmd;
-                // No payload for this answer
-                status = LORAMAC_STATUS_OK;
-            }
-            break;
-        case MOTE_MAC_TX_PARAM_SETUP_ANS:
-            if( MacCommandsBufferIndex < bufLen )
-            {
-                MacCommandsBuffer[MacCommandsBufferIndex++] = cmd;
-                // No payload for this answer
-                status = LORAMAC_STATUS_OK;
-            }
-            break;
-        case MOTE_MAC_DL_CHANNEL_ANS:
-            if( MacCommandsBufferIndex < bufLen )
-            {
-                MacCommandsBuffer[MacCommandsBufferIndex++] = cmd;
-                // Status: Uplink frequency exists, Channel frequency OK
-                MacCommandsBuffer[MacCommandsBufferIndex++] = p1;
-                status = LORAMAC_STATUS_OK;
-            }
-            break;
+static void ProcessLinkAdrReq( uint8_t *cmd, uint8_t size, uint8_t snr )
+{
+    LinkAdrReqParams_t linkAdrReq;
+    int8_t linkAdrDatarate = DR_0;
+    int8_t linkAdrTxPower = TX_POWER_0;
+    uint8_t linkAdrNbRep = 0;
+    uint8_t linkAdrNbBytesParsed = 0;
+    uint8_t status;
 
-        case MOTE_MAC_ACK:
-            if( MacCommandsBufferIndex < bufLen )
-            {
-                MacCommandsBuffer[MacCommandsBufferIndex++] = cmd;
-                status = LORAMAC_STATUS_OK;
-            }
-            break;
+    // Fill parameter structure
+    linkAdrReq.Payload = cmd;
+    linkAdrReq.PayloadSize = size;
+    linkAdrReq.AdrEnabled = AdrCtrlOn;
+    linkAdrReq.UplinkDwellTime = LoRaMacParams.UplinkDwellTime;
+    linkAdrReq.CurrentDatarate = LoRaMacParams.ChannelsDatarate;
+    linkAdrReq.CurrentTxPower = LoRaMacParams.ChannelsTxPower;
+    linkAdrReq.CurrentNbRep = LoRaMacParams.ChannelsNbRep;
 
-        case MOTE_MAC_DEV_TIME_REQ:
-            if( MacCommandsBufferIndex < bufLen )
-            {
-                MacCommandsBuffer[MacCommandsBufferIndex++] = cmd;
-                // No payload for this command
-                 status = LORAMAC_STATUS_OK;
-            }
-            break;
-        default:
-            return LORAMAC_STATUS_SERVICE_UNKNOWN;
+    // Process the ADR requests
+    status = RegionLinkAdrReq( LoRaMacRegion, &linkAdrReq, &linkAdrDatarate,
+                               &linkAdrTxPower, &linkAdrNbRep, &linkAdrNbBytesParsed );
+
+    if( ( status & 0x07 ) == 0x07 )
+    {
+        LoRaMacParams.ChannelsDatarate = linkAdrDatarate;
+        LoRaMacParams.ChannelsTxPower = linkAdrTxPower;
+        LoRaMacParams.ChannelsNbRep = linkAdrNbRep;
+        AdrPredictNetworkCommand( linkAdrDatarate, linkAdrTxPower );
     }
-    if( status == LORAMAC_STATUS_OK )
+
+    // Add the answers to the buffer
+    for( uint8_t i = 0; i < ( linkAdrNbBytesParsed / 5 ); i++ )
     {
-        MacCommandsInNextTx = true;
+        AddMacCommand( MOTE_MAC_LINK_ADR_ANS, status, 0 );
     }
-    return status;
 }
 
-static uint8_t ParseMacCommandsToRepeat( uint8_t* cmdBufIn, uint8_t length, uint8_t* cmdBufOut )
+static void ProcessDutyCycleReq( uint8_t *cmd, uint8_t size, uint8_t snr )
 {
-    uint8_t i = 0;
-    uint8_t cmdCount = 0;
+    // Bits 7:4 are RFU
+    MaxDCycle = cmd[1] & 0x0F;
+    AggregatedDCycle = 1 << MaxDCycle;
+    AddMacCommand( MOTE_MAC_DUTY_CYCLE_ANS, 0, 0 );
+}
+
+static void ProcessRxParamSetupReq( uint8_t *cmd, uint8_t size, uint8_t snr )
+{
+    RxParamSetupReqParams_t rxParamSetupReq;
+    uint8_t status;
+
+    rxParamSetupReq.DrOffset = ( cmd[1] >> 4 ) & 0x07;
+    rxParamSetupReq.Datarate = cmd[1] & 0x0F;
 
-    if( ( cmdBufIn == NULL ) || ( cmdBufOut == NULL ) )
+    rxParamSetupReq.Frequency =  ( uint32_t )cmd[2];
+    rxParamSetupReq.Frequency |= ( uint32_t )cmd[3] << 8;
+    rxParamSetupReq.Frequency |= ( uint32_t )cmd[4] << 16;
+    rxParamSetupReq.Frequency *= 100;
+
+    // Perform request on region
+    status = RegionRxParamSetupReq( LoRaMacRegion, &rxParamSetupReq );
+
+    if( ( status & 0x07 ) == 0x07 )
+    {
+        LoRaMacParams.Rx2Channel.Datarate = rxParamSetupReq.Datarate;
+        LoRaMacParams.Rx2Channel.Frequency = rxParamSetupReq.Frequency;
+        LoRaMacParams.Rx1DrOffset = rxParamSetupReq.DrOffset;
+
+        TRACE(2, "Rx Params Setup Req\n");
+        TRACE(2, "%16s : %d\n", "Rx1 DR Offset",  LoRaMacParams.Rx1DrOffset);
+        TRACE(2, "%16s : %d\n", "Rx2 DR", LoRaMacParams.Rx2Channel.Datarate);
+        TRACE(2, "%16s : %d\n", "Rx2 Frequency", LoRaMacParams.Rx2Channel.Frequency);
+    }
+    else
     {
-        return 0;
+    	ERROR("Status : %d\n", status);
     }
+    AddMacCommand( MOTE_MAC_RX_PARAM_SETUP_ANS, status, 0 );
+}
 
-    for( i = 0; i < length; i++ )
+static void ProcessDevStatusReq( uint8_t *cmd, uint8_t size, uint8_t snr )
+{
+    uint8_t batteryLevel = BAT_LEVEL_NO_MEASURE;
+    if( ( LoRaMacCallbacks != NULL ) && ( LoRaMacCallbacks->GetBatteryLevel != NULL ) )
     {
-        switch( cmdBufIn[i] )
-        {
-            // STICKY
-            case MOTE_MAC_DL_CHANNEL_ANS:
-            case MOTE_MAC_RX_PARAM_SETUP_ANS:
-            { // 1 byte payload
-                cmdBufOut[cmdCount++] = cmdBufIn[i++];
-                cmdBufOut[cmdCount++] = cmdBufIn[i];
-                break;
-            }
-            case MOTE_MAC_RX_TIMING_SETUP_ANS:
-            { // 0 byte payload
-                cmdBufOut[cmdCount++] = cmdBufIn[i];
-                break;
-            }
-            // NON-STICKY
-            case MOTE_MAC_DEV_STATUS_ANS:
-            { // 2 bytes payload
-                i += 2;
-                break;
-            }
-            case MOTE_MAC_LINK_ADR_ANS:
-            case MOTE_MAC_NEW_CHANNEL_ANS:
-            { // 1 byte payload
-                i++;
-                break;
-            }
-            case MOTE_MAC_TX_PARAM_SETUP_ANS:
-            case MOTE_MAC_DUTY_CYCLE_ANS:
-            case MOTE_MAC_LINK_CHECK_REQ:
-            case MOTE_MAC_DEV_TIME_REQ:
-            { // 0 byte payload
-                break;
-            }
-            default:
-                break;
-        }
+        batteryLevel = LoRaMacCallbacks->GetBatteryLevel( );
     }
+    AddMacCommand( MOTE_MAC_DEV_STATUS_ANS, batteryLevel, snr );
+}
+
+static void ProcessNewChannelReq( uint8_t *cmd, uint8_t size, uint8_t snr )
+{
+    NewChannelReqParams_t newChannelReq;
+    ChannelParams_t chParam;
+    uint8_t status;
 
-    return cmdCount;
+    newChannelReq.ChannelId = cmd[1];
+    newChannelReq.NewChannel = &chParam;
+
+    chParam.Frequency = ( uint32_t )cmd[2];
+    chParam.Frequency |= ( uint32_t )cmd[3] << 8;
+    chParam.Frequency |= ( uint32_t )cmd[4] << 16;
+    chParam.Frequency *= 100;
+    chParam.Rx1Frequency = 0;
+    chParam.DrRange.Value = cmd[5];
+
+    TRACE(2, "%16s : CH[%d] = %d\n", "New Channel", newChannelReq.ChannelId, chParam.Frequency);
+    TRACE(2, "%16s : DR_%d(%d ~ %d)\n", "DataRate", chParam.DrRange.Value, chParam.DrRange.Fields.Min, chParam.DrRange.Fields.Max);
+    status = RegionNewChannelReq( LoRaMacRegion, &newChannelReq );
+
+    AddMacCommand( MOTE_MAC_NEW_CHANNEL_ANS, status, 0 );
 }
 
-static void ProcessMacCommands( uint8_t *payload, uint8_t macIndex, uint8_t commandsSize, uint8_t snr )
+static void ProcessRxTimingSetupReq( uint8_t *cmd, uint8_t size, uint8_t snr )
 {
-    uint8_t status = 0;
+    uint8_t delay = cmd[1] & 0x0F;
 
-    while( macIndex < commandsSize )
+    if( delay == 0 )
     {
-        // Decode Frame MAC commands
-        switch( payload[macIndex++] )
-        {
-            case SRV_MAC_LINK_CHECK_ANS:
-                MlmeConfirm.Status = LORAMAC_EVENT_INFO_STATUS_OK;
-                MlmeConfirm.DemodMargin = payload[macIndex++];
-                MlmeConfirm.NbGateways = payload[macIndex++];
-                break;
-            case SRV_MAC_LINK_ADR_REQ:
-                {
-                    LinkAdrReqParams_t linkAdrReq;
-                    int8_t linkAdrDatarate = DR_0;
-                    int8_t linkAdrTxPower = TX_POWER_0;
-                    uint8_t linkAdrNbRep = 0;
-                    uint8_t linkAdrNbBytesParsed = 0;
-
-                    // Fill parameter structure
-                    linkAdrReq.Payload = &payload[macIndex - 1];
-                    linkAdrReq.PayloadSize = commandsSize - ( macIndex - 1 );
-                    linkAdrReq.AdrEnabled = AdrCtrlOn;
-                    linkAdrReq.UplinkDwellTime = LoRaMacParams.UplinkDwellTime;
-                    linkAdrReq.CurrentDatarate = LoRaMacParams.ChannelsDatarate;
-                    linkAdrReq.CurrentTxPower = LoRaMacParams.ChannelsTxPower;
-                    linkAdrReq.CurrentNbRep = LoRaMacParams.ChannelsNbRep;
-
-                    // Process the ADR requests
-                    status = RegionLinkAdrReq( LoRaMacRegion, &linkAdrReq, &linkAdrDatarate,
-                                               &linkAdrTxPower, &linkAdrNbRep, &linkAdrNbBytesParsed );
-
-                    if( ( status & 0x07 ) == 0x07 )
-                    {
-                        LoRaMacParams.ChannelsDatarate = linkAdrDatarate;
-                        LoRaMacParams.ChannelsTxPower = linkAdrTxPower;
-                        LoRaMacParams.ChannelsNbRep = linkAdrNbRep;
-                    }
-
-                    // Add the answers to the buffer
-                    for( uint8_t i = 0; i < ( linkAdrNbBytesParsed / 5 ); i++ )
-                    {
-                        AddMacCommand( MOTE_MAC_LINK_ADR_ANS, status, 0 );
-                    }
-                    // Update MAC index
-                    macIndex += linkAdrNbBytesParsed - 1;
-                }
-                break;
-            case SRV_MAC_DUTY_CYCLE_REQ:
-                MaxDCycle = payload[macIndex++];
-                AggregatedDCycle = 1 << MaxDCycle;
-                AddMacCommand( MOTE_MAC_DUTY_CYCLE_ANS, 0, 0 );
-                break;
-            case SRV_MAC_RX_PARAM_SETUP_REQ:
-                {
-                    RxParamSetupReqParams_t rxParamSetupReq;
-                    status = 0x07;
+        delay++;
+    }
+    LoRaMacParams.ReceiveDelay1 = delay * 1000;
+    LoRaMacParams.ReceiveDelay2 = LoRaMacParams.ReceiveDelay1 + 1000;
+    AddMacCommand( MOTE_MAC_RX_TIMING_SETUP_ANS, 0, 0 );
+}
 
-                    rxParamSetupReq.DrOffset = ( payload[macIndex] >> 4 ) & 0x07;
-                    rxParamSetupReq.Datarate = payload[macIndex] & 0x0F;
-                    macIndex++;
+static void ProcessTxParamSetupReq( uint8_t *cmd, uint8_t size, uint8_t snr )
+{
+    TxParamSetupReqParams_t txParamSetupReq;
+    uint8_t eirpDwellTime = cmd[1];
 
-                    rxParamSetupReq.Frequency =  ( uint32_t )payload[macIndex++];
-                    rxParamSetupReq.Frequency |= ( uint32_t )payload[macIndex++] << 8;
-                    rxParamSetupReq.Frequency |= ( uint32_t )payload[macIndex++] << 16;
-                    rxParamSetupReq.Frequency *= 100;
+    txParamSetupReq.UplinkDwellTime = 0;
+    txParamSetupReq.DownlinkDwellTime = 0;
 
-                    // Perform request on region
-                    status = RegionRxParamSetupReq( LoRaMacRegion, &rxParamSetupReq );
+    if( ( eirpDwellTime & 0x20 ) == 0x20 )
+    {
+        txParamSetupReq.DownlinkDwellTime = 1;
+    }
+    if( ( eirpDwellTime & 0x10 ) == 0x10 )
+    {
+        txParamSetupReq.UplinkDwellTime = 1;
+    }
+    txParamSetupReq.MaxEirp = eirpDwellTime & 0x0F;
 
-                    if( ( status & 0x07 ) == 0x07 )
-                    {
-                        LoRaMacParams.Rx2Channel.Datarate = rxParamSetupReq.Datarate;
-                        LoRaMacParams.Rx2Channel.Frequency = rxParamSetupReq.Frequency;
-                        LoRaMacParams.Rx1DrOffset = rxParamSetupReq.DrOffset;
-
-                        TRACE(2, "Rx Params Setup Req\n");
-                        TRACE(2, "%16s : %d\n", "Rx1 DR Offset",  LoRaMacParams.Rx1DrOffset);
-                        TRACE(2, "%16s : %d\n", "Rx2 DR", LoRaMacParams.Rx2Channel.Datarate);
-                        TRACE(2, "%16s : %d\n", "Rx2 Frequency", LoRaMacParams.Rx2Channel.Frequency);
-                    }
-                    else
-                    {
-                    	ERROR("Status : %d\n", status);
-                    }
-                    AddMacCommand( MOTE_MAC_RX_PARAM_SETUP_ANS, status, 0 );
-                }
-                break;
-            case SRV_MAC_DEV_STATUS_REQ:
-                {
-                    uint8_t batteryLevel = BAT_LEVEL_NO_MEASURE;
-                    if( ( LoRaMacCallbacks != NULL ) && ( LoRaMacCallbacks->GetBatteryLevel != NULL ) )
-                    {
-                        batteryLevel = LoRaMacCallbacks->GetBatteryLevel( );
-                    }
-                    AddMacCommand( MOTE_MAC_DEV_STATUS_ANS, batteryLevel, snr );
-                    break;
-                }
-            case SRV_MAC_NEW_CHANNEL_REQ:
-                {
-                    NewChannelReqParams_t newChannelReq;
-                    ChannelParams_t chParam;
-                    status = 0x03;
+    // Check the status for correctness
+    if( RegionTxParamSetupReq( LoRaMacRegion, &txParamSetupReq ) != -1 )
+    {
+        // Accept command
+        LoRaMacParams.UplinkDwellTime = txParamSetupReq.UplinkDwellTime;
+        LoRaMacParams.DownlinkDwellTime = txParamSetupReq.DownlinkDwellTime;
+        LoRaMacParams.MaxEirp = LoRaMacMaxEirpTable[txParamSetupReq.MaxEirp];
+        // Add command response
+        AddMacCommand( MOTE_MAC_TX_PARAM_SETUP_ANS, 0, 0 );
+    }
+}
 
-                    newChannelReq.ChannelId = payload[macIndex++];
-                    newChannelReq.NewChannel = &chParam;
+static void ProcessDlChannelReq( uint8_t *cmd, uint8_t size, uint8_t snr )
+{
+    DlChannelReqParams_t dlChannelReq;
+    uint8_t status;
 
-                    chParam.Frequency = ( uint32_t )payload[macIndex++];
-                    chParam.Frequency |= ( uint32_t )payload[macIndex++] << 8;
-                    chParam.Frequency |= ( uint32_t )payload[macIndex++] << 16;
-                    chParam.Frequency *= 100;
-                    chParam.Rx1Frequency = 0;
-                    chParam.DrRange.Value = payload[macIndex++];
+    dlChannelReq.ChannelId = cmd[1];
+    dlChannelReq.Rx1Frequency = ( uint32_t )cmd[2];
+    dlChannelReq.Rx1Frequency |= ( uint32_t )cmd[3] << 8;
+    dlChannelReq.Rx1Frequency |= ( uint32_t )cmd[4] << 16;
+    dlChannelReq.Rx1Frequency *= 100;
 
-                    TRACE(2, "%16s : CH[%d] = %d\n", "New Channel", newChannelReq.ChannelId, chParam.Frequency);
-                    TRACE(2, "%16s : DR_%d(%d ~ %d)\n", "DataRate", chParam.DrRange.Value, chParam.DrRange.Fields.Min, chParam.DrRange.Fields.Max);
-                    status = RegionNewChannelReq( LoRaMacRegion, &newChannelReq );
+    status = RegionDlChannelReq( LoRaMacRegion, &dlChannelReq );
 
-                    AddMacCommand( MOTE_MAC_NEW_CHANNEL_ANS, status, 0 );
-                }
-                break;
-            case SRV_MAC_RX_TIMING_SETUP_REQ:
-                {
-                    uint8_t delay = payload[macIndex++] & 0x0F;
+    AddMacCommand( MOTE_MAC_DL_CHANNEL_ANS, status, 0 );
+}
 
-                    if( delay == 0 )
-                    {
-                        delay++;
-                    }
-                    LoRaMacParams.ReceiveDelay1 = delay * 1000;
-                    LoRaMacParams.ReceiveDelay2 = LoRaMacParams.ReceiveDelay1 + 1000;
-                    AddMacCommand( MOTE_MAC_RX_TIMING_SETUP_ANS, 0, 0 );
-                }
-                break;
-            case SRV_MAC_TX_PARAM_SETUP_REQ:
-                {
-                    TxParamSetupReqParams_t txParamSetupReq;
-                    uint8_t eirpDwellTime = payload[macIndex++];
+static void ProcessDevTimeAns( uint8_t *cmd, uint8_t size, uint8_t snr )
+{
+	MlmeConfirm.Status = LORAMAC_EVENT_INFO_STATUS_OK;
+	MlmeConfirm.Epoch = (uint32_t)cmd[1];
+	MlmeConfirm.Epoch |= (uint32_t)cmd[2]<< 8;
+	MlmeConfirm.Epoch |= (uint32_t)cmd[3]<< 16;
+	MlmeConfirm.Epoch |= (uint32_t)cmd[4] << 24;
+	MlmeConfirm.FracSec = (uint16_t)cmd[5];
+	MlmeConfirm.FracSec |= (uint16_t)cmd[6]<< 8;
+}
 
-                    txParamSetupReq.UplinkDwellTime = 0;
-                    txParamSetupReq.DownlinkDwellTime = 0;
+/*!
+ * Uplink MAC commands
+ */
+static const MacCommand_t MoteMacCommands[] =
+{
+    { MOTE_MAC_LINK_CHECK_REQ,      0, 0,              NULL },
+    { MOTE_MAC_LINK_ADR_ANS,        1, 0,              NULL },  // Status
+    { MOTE_MAC_DUTY_CYCLE_ANS,      0, 0,              NULL },
+    { MOTE_MAC_RX_PARAM_SETUP_ANS,  1, MAC_CMD_STICKY, NULL },  // Status: Datarate ACK, Channel ACK
+    { MOTE_MAC_DEV_STATUS_ANS,      2, 0,              NULL },  // Battery, Margin
+    { MOTE_MAC_NEW_CHANNEL_ANS,     1, 0,              NULL },  // Status: Datarate range OK, Channel frequency OK
+    { MOTE_MAC_RX_TIMING_SETUP_ANS, 0, MAC_CMD_STICKY, NULL },
+    { MOTE_MAC_TX_PARAM_SETUP_ANS,  0, 0,              NULL },
+    { MOTE_MAC_DL_CHANNEL_ANS,      1, MAC_CMD_STICKY, NULL },  // Status: Uplink frequency exists, Channel frequency OK
+    { MOTE_MAC_DEV_TIME_REQ,        0, 0,              NULL },
+    { MOTE_MAC_ACK,                 0, 0,              NULL },
+};
 
-                    if( ( eirpDwellTime & 0x20 ) == 0x20 )
-                    {
-                        txParamSetupReq.DownlinkDwellTime = 1;
-                    }
-                    if( ( eirpDwellTime & 0x10 ) == 0x10 )
-                    {
-                        txParamSetupReq.UplinkDwellTime = 1;
-                    }
-                    txParamSetupReq.MaxEirp = eirpDwellTime & 0x0F;
+/*!
+ * Downlink MAC commands
+ */
+static const MacCommand_t SrvMacCommands[] =
+{
+    { SRV_MAC_LINK_CHECK_ANS,       2, 0,              ProcessLinkCheckAns },
+    { SRV_MAC_LINK_ADR_REQ,         4, MAC_CMD_BLOCK,  ProcessLinkAdrReq },
+    { SRV_MAC_DUTY_CYCLE_REQ,       1, 0,              ProcessDutyCycleReq },
+    { SRV_MAC_RX_PARAM_SETUP_REQ,   4, 0,              ProcessRxParamSetupReq },
+    { SRV_MAC_DEV_STATUS_REQ,       0, 0,              ProcessDevStatusReq },
+    { SRV_MAC_NEW_CHANNEL_REQ,      5, 0,              ProcessNewChannelReq },
+    { SRV_MAC_RX_TIMING_SETUP_REQ,  1, 0,              ProcessRxTimingSetupReq },
+    { SRV_MAC_TX_PARAM_SETUP_REQ,   1, 0,              ProcessTxParamSetupReq },
+    { SRV_MAC_DL_CHANNEL_REQ,       4, 0,              ProcessDlChannelReq },
+    { SRV_MAC_DEV_TIME_ANS,         6, 0,              ProcessDevTimeAns },    // Epoch, 16 bits fraction
+};
 
-                    // Check the status for correctness
-                    if( RegionTxParamSetupReq( LoRaMacRegion, &txParamSetupReq ) != -1 )
-                    {
-                        // Accept command
-                        LoRaMacParams.UplinkDwellTime = txParamSetupReq.UplinkDwellTime;
-                        LoRaMacParams.DownlinkDwellTime = txParamSetupReq.DownlinkDwellTime;
-                        LoRaMacParams.MaxEirp = LoRaMacMaxEirpTable[txParamSetupReq.MaxEirp];
-                        // Add command response
-                        AddMacCommand( MOTE_MAC_TX_PARAM_SETUP_ANS, 0, 0 );
-                    }
-                }
-                break;
-            case SRV_MAC_DL_CHANNEL_REQ:
-                {
-                    DlChannelReqParams_t dlChannelReq;
-                    status = 0x03;
+static const MacCommand_t* FindMacCommand( const MacCommand_t *table, uint8_t count, uint8_t cid )
+{
+    for( uint8_t i = 0; i < count; i++ )
+    {
+        if( table[i].Cid == cid )
+        {
+            return &table[i];
+        }
+    }
+    return NULL;
+}
 
-                    dlChannelReq.ChannelId = payload[macIndex++];
-                    dlChannelReq.Rx1Frequency = ( uint32_t )payload[macIndex++];
-                    dlChannelReq.Rx1Frequency |= ( uint32_t )payload[macIndex++] << 8;
-                    dlChannelReq.Rx1Frequency |= ( uint32_t )payload[macIndex++] << 16;
-                    dlChannelReq.Rx1Frequency *= 100;
+static LoRaMacStatus_t AddMacCommand( uint8_t cmd, uint8_t p1, uint8_t p2 )
+{
+    const MacCommand_t *command = FindMacCommand( MoteMacCommands, sizeof( MoteMacCommands ) / sizeof( MoteMacCommands[0] ), cmd );
+    uint8_t *buffer = MacCommandsBuffer;
+    uint8_t *index = &MacCommandsBufferIndex;
 
-                    status = RegionDlChannelReq( LoRaMacRegion, &dlChannelReq );
+    if( command == NULL )
+    {
+        return LORAMAC_STATUS_SERVICE_UNKNOWN;
+    }
+    // The maximum buffer length must take MAC commands to re-send into account.
+    if( ( MacCommandsBufferIndex + MacCommandsBufferToRepeatIndex + 1 + command->Length ) > LORA_MAC_COMMAND_MAX_LENGTH )
+    {
+        return LORAMAC_STATUS_BUSY;
+    }
+    // Sticky answers go straight to the commands to repeat, which are added to every uplink
+    if( ( command->Flags & MAC_CMD_STICKY ) != 0 )
+    {
+        buffer = MacCommandsBufferToRepeat;
+        index = &MacCommandsBufferToRepeatIndex;
+    }
+    buffer[( *index )++] = cmd;
+    if( command->Length > 0 )
+    {
+        buffer[( *index )++] = p1;
+    }
+    if( command->Length > 1 )
+    {
+        buffer[( *index )++] = p2;
+    }
+    MacCommandsInNextTx = true;
+    return LORAMAC_STATUS_OK;
+}
 
-                    AddMacCommand( MOTE_MAC_DL_CHANNEL_ANS, status, 0 );
-                }
-                break;
-            case SRV_MAC_DEV_TIME_ANS:
-				{
-					MlmeConfirm.Status = LORAMAC_EVENT_INFO_STATUS_OK;
-					MlmeConfirm.Epoch = (uint32_t)payload[macIndex++];
-					MlmeConfirm.Epoch |= (uint32_t)payload[macIndex++]<< 8;
-					MlmeConfirm.Epoch |= (uint32_t)payload[macIndex++]<< 16;
-					MlmeConfirm.Epoch |= (uint32_t)payload[macIndex++] << 24;
-					MlmeConfirm.FracSec = (uint16_t)payload[macIndex++];
-					MlmeConfirm.FracSec |= (uint16_t)payload[macIndex++]<< 8;
-				}
-                break;
+static void ProcessMacCommands( uint8_t *payload, uint8_t macIndex, uint8_t commandsSize, uint8_t snr )
+{
+    while( macIndex < commandsSize )
+    {
+        const MacCommand_t *command = FindMacCommand( SrvMacCommands, sizeof( SrvMacCommands ) / sizeof( SrvMacCommands[0] ), payload[macIndex] );
+        uint8_t size;
 
-            default:
-                // Unknown command. ABORT MAC commands processing
-                return;
+        if( command == NULL )
+        {
+            // Unknown command. ABORT MAC commands processing
+            return;
         }
+        size = 1 + command->Length;
+        if( size > ( commandsSize - macIndex ) )
+        {
+            // Truncated command. ABORT MAC commands processing
+            return;
+        }
+        if( ( command->Flags & MAC_CMD_BLOCK ) != 0 )
+        {
+            // Take the complete following commands of the same kind
+            while( ( ( commandsSize - macIndex - size ) >= ( 1 + command->Length ) ) && ( payload[macIndex + size] == command->Cid ) )
+            {
+                size += 1 + command->Length;
+            }
+        }
+        command->Handler( &payload[macIndex], size, snr );
+        macIndex += size;
     }
 }
 
@@ -2004,6 +2025,7 @@ static LoRaMacStatus_t ScheduleTx( void )
     // Select channel
 	if (!bTestMode)
 	{
+		PERF_BEGIN( PerfNextChannel );
 		while( RegionNextChannel( LoRaMacRegion, &nextChan, &Channel, &dutyCycleTimeOff, &AggregatedTimeOff ) == false )
 		{
 			// Set the default datarate
@@ -2011,20 +2033,32 @@ static LoRaMacStatus_t ScheduleTx( void )
 			// Update datarate in the function parameters
 			nextChan.Datarate = LoRaMacParams.ChannelsDatarate;
 		}
+		PERF_END( PerfNextChannel );
 	}
 
+    // Size RX windows from the observed downlink timing error
+    uint32_t rx1Delay = ( IsLoRaMacNetworkJoined == false ) ? LoRaMacParams.JoinAcceptDelay1 : LoRaMacParams.ReceiveDelay1;
+    uint32_t rx2Delay = ( IsLoRaMacNetworkJoined == false ) ? LoRaMacParams.JoinAcceptDelay2 : LoRaMacParams.ReceiveDelay2;
+    uint32_t rx1Error, rx2Error;
+    int32_t rx1Shift, rx2Shift;
+
+    RxCalibrationGetWindow( rx1Delay, LoRaMacParams.SystemMaxRxError, &rx1Error, &rx1Shift );
+    RxCalibrationGetWindow( rx2Delay, LoRaMacParams.SystemMaxRxError, &rx2Error, &rx2Shift );
+
 	// Compute Rx1 windows parameters
     RegionComputeRxWindowParameters( LoRaMacRegion,
                                      RegionApplyDrOffset( LoRaMacRegion, LoRaMacParams.DownlinkDwellTime, LoRaMacParams.ChannelsDatarate, LoRaMacParams.Rx1DrOffset ),
                                      LoRaMacParams.MinRxSymbols,
-                                     LoRaMacParams.SystemMaxRxError,
+                                     rx1Error,
                                      &RxWindow1Config );
     // Compute Rx2 windows parameters
     RegionComputeRxWindowParameters( LoRaMacRegion,
                                      LoRaMacParams.Rx2Channel.Datarate,
                                      LoRaMacParams.MinRxSymbols,
-                                     LoRaMacParams.SystemMaxRxError,
+                                     rx2Error,
                                      &RxWindow2Config );
+    RxWindow1Config.WindowOffset += rx1Shift;
+    RxWindow2Config.WindowOffset += rx2Shift;
 
     if( IsLoRaMacNetworkJoined == false )
     {
@@ -2095,6 +2129,7 @@ static void ResetMacParameters( void )
     UpLinkCounter = 0;
     DownLinkCounter = 0;
     AdrAckCounter = 0;
+    AdrPredictInit( );
 
     ChannelsNbRepCounter = 0;
 
@@ -2169,7 +2204,8 @@ LoRaMacStatus_t PrepareFrame( LoRaMacHeader_t *macHdr, LoRaMacFrameCtrl_t *fCtrl
             memcpyr( LoRaMacBuffer + LoRaMacBufferPktLen, LoRaMacDevEui, 8 );
             LoRaMacBufferPktLen += 8;
 
-            LoRaMacDevNonce = Radio.Random( );
+            // Increment instead of picking a random value so that a persisted value is never reused
+            LoRaMacDevNonce++;
 
             LoRaMacBuffer[LoRaMacBufferPktLen++] = LoRaMacDevNonce & 0xFF;
             LoRaMacBuffer[LoRaMacBufferPktLen++] = ( LoRaMacDevNonce >> 8 ) & 0xFF;
@@ -2202,6 +2238,33 @@ LoRaMacStatus_t PrepareFrame( LoRaMacHeader_t *macHdr, LoRaMacFrameCtrl_t *fCtrl
             fCtrl->Bits.AdrAckReq = RegionAdrNext( LoRaMacRegion, &adrNext,
                                                    &LoRaMacParams.ChannelsDatarate, &LoRaMacParams.ChannelsTxPower, &AdrAckCounter );
 
+            if( ( AdrPredictOn == true ) && ( fCtrl->Bits.Adr == 1 ) )
+            {
+                AdrPredictParams_t adrPredict;
+                GetPhyParams_t getPhy;
+                VerifyParams_t verify;
+
+                adrPredict.Datarate = LoRaMacParams.ChannelsDatarate;
+                adrPredict.TxPower = LoRaMacParams.ChannelsTxPower;
+                getPhy.Attribute = PHY_MIN_TX_DR;
+                getPhy.UplinkDwellTime = LoRaMacParams.UplinkDwellTime;
+                adrPredict.MinDatarate = RegionGetPhyParam( LoRaMacRegion, &getPhy ).Value;
+                getPhy.Attribute = PHY_MAX_TX_DR;
+                adrPredict.MaxDatarate = RegionGetPhyParam( LoRaMacRegion, &getPhy ).Value;
+                adrPredict.MaxTxPower = TX_POWER_0;
+                adrPredict.MinTxPower = TX_POWER_0;
+                verify.TxPower = TX_POWER_1;
+                while( RegionVerify( LoRaMacRegion, &verify, PHY_TX_POWER ) == true )
+                {
+                    adrPredict.MinTxPower = verify.TxPower++;
+                }
+
+                if( AdrPredictNext( &adrPredict, &LoRaMacParams.ChannelsDatarate, &LoRaMacParams.ChannelsTxPower ) == true )
+                {
+                    TRACE(5, "Predictive ADR : DR = %d, PWR = %d\n", LoRaMacParams.ChannelsDatarate, LoRaMacParams.ChannelsTxPower);
+                }
+            }
+
             if( SrvAckRequested == true )
             {
                 SrvAckRequested = false;
@@ -2254,13 +2317,9 @@ LoRaMacStatus_t PrepareFrame( LoRaMacHeader_t *macHdr, LoRaMacFrameCtrl_t *fCtrl
                     framePort = 0;
                 }
             }
-            MacCommandsInNextTx = false;
-            // Store MAC commands which must be re-send in case the device does not receive a downlink anymore
-            MacCommandsBufferToRepeatIndex = ParseMacCommandsToRepeat( MacCommandsBuffer, MacCommandsBufferIndex, MacCommandsBufferToRepeat );
-            if( MacCommandsBufferToRepeatIndex > 0 )
-            {
-                MacCommandsInNextTx = true;
-            }
+            // MAC commands which must be re-send in case the device does not receive a downlink anymore
+            // are kept in MacCommandsBufferToRepeat until a downlink is received
+            MacCommandsInNextTx = ( MacCommandsBufferToRepeatIndex > 0 );
 
             if( ( payload != NULL ) && ( LoRaMacTxPayloadLen > 0 ) )
             {
@@ -2319,6 +2378,7 @@ LoRaMacStatus_t SendFrameOnChannel( uint8_t channel )
     McpsConfirm.Status = LORAMAC_EVENT_INFO_STATUS_ERROR;
     McpsConfirm.Datarate = LoRaMacParams.ChannelsDatarate;
     McpsConfirm.TxPower = txPower;
+    McpsConfirm.Channel = channel;
 
     // Store the time on air
     McpsConfirm.TxTimeOnAir = TxTimeOnAir;
@@ -2418,7 +2478,8 @@ LoRaMacStatus_t LoRaMacInitialization( LoRaMacPrimitives_t *primitives, LoRaMacC
         return LORAMAC_STATUS_PARAMETER_INVALID;
     }
     // Verify if the region is supported
-    if( RegionIsActive( region ) == false )
+    // Resolve the region once, the Region* calls use it from now on
+    if( RegionSelect( region ) == false )
     {
         return LORAMAC_STATUS_REGION_NOT_SUPPORTED;
     }
@@ -2533,6 +2594,7 @@ LoRaMacStatus_t LoRaMacInitialization( LoRaMacPrimitives_t *primitives, LoRaMacC
 
     // Store the current initialization time
     LoRaMacInitializationTime = TimerGetCurrentTime( );
+    RxCalibrationInit( );
 
     // Initialize Radio driver
     RadioEvents.TxDone = OnRadioTxDone;
@@ -2544,6 +2606,7 @@ LoRaMacStatus_t LoRaMacInitialization( LoRaMacPrimitives_t *primitives, LoRaMacC
 
     // Random seed initialization
     srand1( Radio.Random( ) );
+    LoRaMacDevNonce = Radio.Random( );
 
     PublicNetwork = true;
     Radio.SetPublicNetwork( PublicNetwork );
@@ -2642,6 +2705,11 @@ LoRaMacStatus_t LoRaMacMibGetRequestConfirm( MibRequestConfirm_t *mibGet )
             mibGet->Param.AdrEnable = AdrCtrlOn;
             break;
         }
+        case MIB_ADR_PREDICT:
+        {
+            mibGet->Param.AdrPredictEnable = AdrPredictOn;
+            break;
+        }
         case MIB_NET_ID:
         {
             mibGet->Param.NetID = LoRaMacNetID;
@@ -2799,6 +2867,12 @@ LoRaMacStatus_t LoRaMacMibGetRequestConfirm( MibRequestConfirm_t *mibGet )
         	break;
         }
 
+        case MIB_DEV_NONCE:
+        {
+            mibGet->Param.DevNonce = LoRaMacDevNonce;
+            break;
+        }
+
         default:
             status = LORAMAC_STATUS_SERVICE_UNKNOWN;
             break;
@@ -2865,6 +2939,12 @@ LoRaMacStatus_t LoRaMacMibSetRequestConfirm( MibRequestConfirm_t *mibSet )
            	TRACE(5, "Set ADR control = %s\n", (AdrCtrlOn)?"ON":"OFF");
             break;
         }
+        case MIB_ADR_PREDICT:
+        {
+            AdrPredictOn = mibSet->Param.AdrPredictEnable;
+            TRACE(5, "Set predictive ADR = %s\n", (AdrPredictOn)?"ON":"OFF");
+            break;
+        }
         case MIB_NET_ID:
         {
             LoRaMacNetID = mibSet->Param.NetID;
@@ -3136,6 +3216,12 @@ LoRaMacStatus_t LoRaMacMibSetRequestConfirm( MibRequestConfirm_t *mibSet )
               	TRACE(5, "Add ACK\n");
                break;
             }
+        case MIB_DEV_NONCE:
+            {
+                LoRaMacDevNonce = mibSet->Param.DevNonce;
+                TRACE(5, "Set DevNonce = %04x\n", LoRaMacDevNonce);
+                break;
+            }
 
 
         default:
@@ -852,6 +852,10 @@ typedef struct sMcpsConfirm
      * The uplink frequency related to the frame
      */
     uint32_t UpLinkFrequency;
+    /*!
+     * The uplink channel related to the frame
+     */
+    uint8_t Channel;
 }McpsConfirm_t;
 
 /*!
@@ -917,6 +921,10 @@ typedef struct sMcpsIndication
      * The downlink counter value for the received frame
      */
     uint32_t DownLinkCounter;
+    /*!
+     * The uplink channel the receive windows were opened for
+     */
+    uint8_t Channel;
 }McpsIndication_t;
 
 /*!
@@ -1110,6 +1118,10 @@ typedef struct sMlmeConfirm
 
     uint32_t 	Epoch;
     uint16_t	FracSec;
+    /*!
+     * Time at the end of the last uplink transmission, DeviceTimeAns refers to it
+     */
+    TimerTime_t TxDoneTime;
 }MlmeConfirm_t;
 
 /*!
@@ -1373,7 +1385,15 @@ typedef enum eMib
     MIB_ANTENNA_GAIN,
 	MIB_JOIN_REQUEST_TRIALS,
 	MIB_APP_NONCE,
-	MIB_ADD_ACK
+	MIB_ADD_ACK,
+    /*!
+     * Last DevNonce used in a join request, the next join request uses the following value
+     */
+    MIB_DEV_NONCE,
+    /*!
+     * Device side predictive ADR, only active when ADR is enabled
+     */
+    MIB_ADR_PREDICT
 }Mib_t;
 
 /*!
@@ -1565,6 +1585,18 @@ typedef union uMibParam
     uint32_t	MaxJoinRequestTrials;
 
     uint32_t	AppNonce;
+    /*!
+     * Last DevNonce used
+     *
+     * Related MIB type: \ref MIB_DEV_NONCE
+     */
+    uint16_t DevNonce;
+    /*!
+     * Activation state of the predictive ADR
+     *
+     * Related MIB type: \ref MIB_ADR_PREDICT
+     */
+    bool AdrPredictEnable;
 }MibParam_t;
 
 /*!
@@ -1737,6 +1769,28 @@ typedef struct sLoRaMacCallback
      *          to measure the battery level]
      */
     uint8_t ( *GetBatteryLevel )( void );
+    /*!
+     * \brief   Provides the buffer the next received payload is decrypted into
+     *
+     * \param   [IN] size - Payload size
+     *
+     * \retval  Buffer of at least size bytes, handed back with the
+     *          MCPS-Indication, or NULL to use the MAC buffer
+     *
+     * \remark  Called from the radio interrupt. The buffer belongs to the MAC
+     *          until an indication points to it, it may be asked again for a
+     *          later frame if no indication was provided. Optional.
+     */
+    uint8_t* ( *GetRxBuffer )( uint8_t size );
+    /*!
+     * \brief   Notifies the end of a data uplink transmission
+     *
+     * \param   [IN] upLinkCounter - Frame counter the uplink was sent with
+     *
+     * \remark  Called from the radio interrupt, before the receive windows.
+     *          The MAC increments its frame counter only after them. Optional.
+     */
+    void ( *TxDone )( uint32_t upLinkCounter );
 }LoRaMacCallback_t;
 
 /*!
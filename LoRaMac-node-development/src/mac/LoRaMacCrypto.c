@@ -21,10 +21,10 @@ Maintainer: Miguel Luis ( Semtech ), Gregory Cristian ( Semtech ) and Daniel Jae
 #include <stdint.h>
 #include "utilities.h"
 
-#include "aes.h"
-#include "cmac.h"
+#include "crypto-backend.h"
 
 #include "LoRaMacCrypto.h"
+#include "perf.h"
 
 /*!
  * CMAC/AES Message Integrity Code (MIC) Block B0 size
@@ -46,24 +46,11 @@ static uint8_t MicBlockB0[] = { 0x49, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
 static uint8_t Mic[16];
 
 /*!
- * Encryption aBlock and sBlock
+ * Encryption aBlock
  */
 static uint8_t aBlock[] = { 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
                             0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00
                           };
-static uint8_t sBlock[] = { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-                            0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00
-                          };
-
-/*!
- * AES computation context variable
- */
-static aes_context AesContext;
-
-/*!
- * CMAC computation context variable
- */
-static AES_CMAC_CTX AesCmacCtx[1];
 
 /*!
  * \brief Computes the LoRaMAC frame MIC field  
@@ -78,6 +65,8 @@ static AES_CMAC_CTX AesCmacCtx[1];
  */
 void LoRaMacComputeMic( const uint8_t *buffer, uint16_t size, const uint8_t *key, uint32_t address, uint8_t dir, uint32_t sequenceCounter, uint32_t *mic )
 {
+    PERF_BEGIN( PerfComputeMic );
+
     MicBlockB0[5] = dir;
     
     MicBlockB0[6] = ( address ) & 0xFF;
@@ -92,27 +81,16 @@ void LoRaMacComputeMic( const uint8_t *buffer, uint16_t size, const uint8_t *key
 
     MicBlockB0[15] = size & 0xFF;
 
-    AES_CMAC_Init( AesCmacCtx );
-
-    AES_CMAC_SetKey( AesCmacCtx, key );
-
-    AES_CMAC_Update( AesCmacCtx, MicBlockB0, LORAMAC_MIC_BLOCK_B0_SIZE );
-    
-    AES_CMAC_Update( AesCmacCtx, buffer, size & 0xFF );
-    
-    AES_CMAC_Final( Mic, AesCmacCtx );
+    CryptoBackendCmac( key, MicBlockB0, LORAMAC_MIC_BLOCK_B0_SIZE, buffer, size & 0xFF, Mic );
     
     *mic = ( uint32_t )( ( uint32_t )Mic[3] << 24 | ( uint32_t )Mic[2] << 16 | ( uint32_t )Mic[1] << 8 | ( uint32_t )Mic[0] );
+
+    PERF_END( PerfComputeMic );
 }
 
 void LoRaMacPayloadEncrypt( const uint8_t *buffer, uint16_t size, const uint8_t *key, uint32_t address, uint8_t dir, uint32_t sequenceCounter, uint8_t *encBuffer )
 {
-    uint16_t i;
-    uint8_t bufferIndex = 0;
-    uint16_t ctr = 1;
-
-    memset1( AesContext.ksch, '\0', 240 );
-    aes_set_key( key, 16, &AesContext );
+    PERF_BEGIN( PerfPayloadEncrypt );
 
     aBlock[5] = dir;
 
@@ -126,28 +104,11 @@ void LoRaMacPayloadEncrypt( const uint8_t *buffer, uint16_t size, const uint8_t
     aBlock[12] = ( sequenceCounter >> 16 ) & 0xFF;
     aBlock[13] = ( sequenceCounter >> 24 ) & 0xFF;
 
-    while( size >= 16 )
-    {
-        aBlock[15] = ( ( ctr ) & 0xFF );
-        ctr++;
-        aes_encrypt( aBlock, sBlock, &AesContext );
-        for( i = 0; i < 16; i++ )
-        {
-            encBuffer[bufferIndex + i] = buffer[bufferIndex + i] ^ sBlock[i];
-        }
-        size -= 16;
-        bufferIndex += 16;
-    }
-
-    if( size > 0 )
-    {
-        aBlock[15] = ( ( ctr ) & 0xFF );
-        aes_encrypt( aBlock, sBlock, &AesContext );
-        for( i = 0; i < size; i++ )
-        {
-            encBuffer[bufferIndex + i] = buffer[bufferIndex + i] ^ sBlock[i];
-        }
-    }
+    aBlock[15] = 1;
+
+    CryptoBackendAesCtr( key, aBlock, buffer, size, encBuffer );
+
+    PERF_END( PerfPayloadEncrypt );
 }
 
 void LoRaMacPayloadDecrypt( const uint8_t *buffer, uint16_t size, const uint8_t *key, uint32_t address, uint8_t dir, uint32_t sequenceCounter, uint8_t *decBuffer )
@@ -157,60 +118,43 @@ void LoRaMacPayloadDecrypt( const uint8_t *buffer, uint16_t size, const uint8_t
 
 void LoRaMacJoinComputeMic( const uint8_t *buffer, uint16_t size, const uint8_t *key, uint32_t *mic )
 {
-    AES_CMAC_Init( AesCmacCtx );
-
-    AES_CMAC_SetKey( AesCmacCtx, key );
-
-    AES_CMAC_Update( AesCmacCtx, buffer, size & 0xFF );
-
-    AES_CMAC_Final( Mic, AesCmacCtx );
+    CryptoBackendCmac( key, NULL, 0, buffer, size & 0xFF, Mic );
 
     *mic = ( uint32_t )( ( uint32_t )Mic[3] << 24 | ( uint32_t )Mic[2] << 16 | ( uint32_t )Mic[1] << 8 | ( uint32_t )Mic[0] );
 }
 
 void LoRaMacJoinDecrypt( const uint8_t *buffer, uint16_t size, const uint8_t *key, uint8_t *decBuffer )
 {
-    memset1( AesContext.ksch, '\0', 240 );
-    aes_set_key( key, 16, &AesContext );
-    aes_encrypt( buffer, decBuffer, &AesContext );
     // Check if optional CFList is included
-    if( size >= 16 )
-    {
-        aes_encrypt( buffer + 16, decBuffer + 16, &AesContext );
-    }
+    CryptoBackendAesEncrypt( key, buffer, ( size >= 16 ) ? 32 : 16, decBuffer );
 }
 
 void LoRaMacJoinComputeSKeys( const uint8_t *key, const uint8_t *appNonce, uint16_t devNonce, uint8_t *nwkSKey, uint8_t *appSKey )
 {
-    uint8_t nonce[16];
+    uint8_t nonce[32];
     uint8_t *pDevNonce = ( uint8_t * )&devNonce;
-    
-    memset1( AesContext.ksch, '\0', 240 );
-    aes_set_key( key, 16, &AesContext );
 
     memset1( nonce, 0, sizeof( nonce ) );
     nonce[0] = 0x01;
     memcpy1( nonce + 1, appNonce, 6 );
     memcpy1( nonce + 7, pDevNonce, 2 );
-    aes_encrypt( nonce, nwkSKey, &AesContext );
 
-    memset1( nonce, 0, sizeof( nonce ) );
-    nonce[0] = 0x02;
-    memcpy1( nonce + 1, appNonce, 6 );
-    memcpy1( nonce + 7, pDevNonce, 2 );
-    aes_encrypt( nonce, appSKey, &AesContext );
+    nonce[16] = 0x02;
+    memcpy1( nonce + 17, appNonce, 6 );
+    memcpy1( nonce + 23, pDevNonce, 2 );
+
+    CryptoBackendAesEncrypt( key, nonce, sizeof( nonce ), nonce );
+    memcpy1( nwkSKey, nonce, 16 );
+    memcpy1( appSKey, nonce + 16, 16 );
 }
 
 void LoRaMacJoinComputeRealAppKey( const uint8_t *key, const uint8_t *appNonce, uint32_t netId, uint8_t *appKey )
 {
     uint8_t nonce[16];
 
-    memset1( AesContext.ksch, '\0', 240 );
-    aes_set_key( key, 16, &AesContext );
-
     memset1( nonce, 0, sizeof( nonce ) );
     memcpy1( nonce + 0, appNonce, 3 );
     memcpy1( nonce + 3, (uint8_t *)&netId, 3 );
-    aes_encrypt( nonce, appKey, &AesContext );
+    CryptoBackendAesEncrypt( key, nonce, sizeof( nonce ), appKey );
 
 }
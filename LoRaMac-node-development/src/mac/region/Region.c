@@ -31,6 +31,9 @@ Maintainer: Miguel Luis ( Semtech ), Gregory Cristian ( Semtech ) and Daniel Jae
 
 
 
+// Table dispatch is implemented in RegionOps.c
+#ifndef REGION_DISPATCH_TABLE
+
 // Setup regions
 #ifdef REGION_AS923
 #include "RegionAS923.h"
@@ -573,6 +576,11 @@ bool RegionIsActive( LoRaMacRegion_t region )
     }
 }
 
+bool RegionSelect( LoRaMacRegion_t region )
+{
+    return RegionIsActive( region );
+}
+
 PhyParam_t RegionGetPhyParam( LoRaMacRegion_t region, GetPhyParams_t* getPhy )
 {
     PhyParam_t phyParam = { 0 };
@@ -1035,3 +1043,5 @@ uint8_t RegionApplyDrOffset( LoRaMacRegion_t region, uint8_t downlinkDwellTime,
         }
     }
 }
+
+#endif // REGION_DISPATCH_TABLE
@@ -1167,6 +1167,40 @@ typedef struct sContinuousWaveParams
     uint16_t Timeout;
 }ContinuousWaveParams_t;
 
+/*!
+ * Region operations table
+ *
+ * \remark When REGION_DISPATCH_TABLE is defined, the Region* functions dispatch
+ *         through the table of the region selected by RegionSelect instead of
+ *         switching over the region on every call. When a single region is
+ *         enabled, its table is known at compile time and the calls are direct.
+ */
+typedef struct sRegionOps
+{
+    PhyParam_t ( *GetPhyParam )( GetPhyParams_t* getPhy );
+    void ( *SetBandTxDone )( SetBandTxDoneParams_t* txDone );
+    void ( *InitDefaults )( InitType_t type );
+    bool ( *Verify )( VerifyParams_t* verify, PhyAttribute_t phyAttribute );
+    void ( *ApplyCFList )( ApplyCFListParams_t* applyCFList );
+    bool ( *ChanMaskSet )( ChanMaskSetParams_t* chanMaskSet );
+    bool ( *AdrNext )( AdrNextParams_t* adrNext, int8_t* drOut, int8_t* txPowOut, uint32_t* adrAckCounter );
+    void ( *ComputeRxWindowParameters )( int8_t datarate, uint8_t minRxSymbols, uint32_t rxError, RxConfigParams_t *rxConfigParams );
+    bool ( *RxConfig )( RxConfigParams_t* rxConfig, int8_t* datarate );
+    bool ( *TxConfig )( TxConfigParams_t* txConfig, int8_t* txPower, TimerTime_t* txTimeOnAir );
+    uint8_t ( *LinkAdrReq )( LinkAdrReqParams_t* linkAdrReq, int8_t* drOut, int8_t* txPowOut, uint8_t* nbRepOut, uint8_t* nbBytesParsed );
+    uint8_t ( *RxParamSetupReq )( RxParamSetupReqParams_t* rxParamSetupReq );
+    uint8_t ( *NewChannelReq )( NewChannelReqParams_t* newChannelReq );
+    int8_t ( *TxParamSetupReq )( TxParamSetupReqParams_t* txParamSetupReq );
+    uint8_t ( *DlChannelReq )( DlChannelReqParams_t* dlChannelReq );
+    int8_t ( *AlternateDr )( AlternateDrParams_t* alternateDr );
+    void ( *CalcBackOff )( CalcBackOffParams_t* calcBackOff );
+    bool ( *NextChannel )( NextChanParams_t* nextChanParams, uint8_t* channel, TimerTime_t* time, TimerTime_t* aggregatedTimeOff );
+    LoRaMacStatus_t ( *ChannelAdd )( ChannelAddParams_t* channelAdd );
+    bool ( *ChannelsRemove )( ChannelRemoveParams_t* channelRemove );
+    void ( *SetContinuousWave )( ContinuousWaveParams_t* continuousWave );
+    uint8_t ( *ApplyDrOffset )( uint8_t downlinkDwellTime, int8_t dr, int8_t drOffset );
+}RegionOps_t;
+
 
 
 /*!
@@ -1179,6 +1213,20 @@ typedef struct sContinuousWaveParams
  */
 bool RegionIsActive( LoRaMacRegion_t region );
 
+/*!
+ * \brief Selects the region used by all the other Region* functions.
+ *
+ * \remark Must be called before any other Region* function but RegionIsActive.
+ *         With REGION_DISPATCH_TABLE, the other functions fail as for an
+ *         inactive region until a region is selected, or when their region
+ *         parameter is not the selected region.
+ *
+ * \param [IN] region LoRaWAN region.
+ *
+ * \retval Return true, if the region is supported.
+ */
+bool RegionSelect( LoRaMacRegion_t region );
+
 /*!
  * \brief The function gets a value of a specific phy attribute.
  *
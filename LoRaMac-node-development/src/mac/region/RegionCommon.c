@@ -36,18 +36,19 @@ Maintainer: Miguel Luis ( Semtech ), Gregory Cristian ( Semtech ) and Daniel Jae
 
 
 
-static uint8_t CountChannels( uint16_t mask, uint8_t nbBits )
+static uint8_t CountChannels( uint16_t mask )
 {
-    uint8_t nbActiveBits = 0;
+    // Sum the bits pairwise, then by nibble, byte and word
+    mask = mask - ( ( mask >> 1 ) & 0x5555 );
+    mask = ( mask & 0x3333 ) + ( ( mask >> 2 ) & 0x3333 );
+    mask = ( mask + ( mask >> 4 ) ) & 0x0F0F;
+    return ( mask + ( mask >> 8 ) ) & 0x001F;
+}
 
-    for( uint8_t j = 0; j < nbBits; j++ )
-    {
-        if( ( mask & ( 1 << j ) ) == ( 1 << j ) )
-        {
-            nbActiveBits++;
-        }
-    }
-    return nbActiveBits;
+static uint8_t LowestChannel( uint16_t mask )
+{
+    // The mask must not be 0, compiles to RBIT and CLZ on the Cortex-M3
+    return __builtin_ctz( mask );
 }
 
 
@@ -80,16 +81,20 @@ bool RegionCommonChanVerifyDr( uint8_t nbChannels, uint16_t* channelsMask, int8_
 
     for( uint8_t i = 0, k = 0; i < nbChannels; i += 16, k++ )
     {
-        for( uint8_t j = 0; j < 16; j++ )
+        uint16_t mask = channelsMask[k];
+
+        // Only visit the enabled channels
+        while( mask != 0 )
         {
-            if( ( ( channelsMask[k] & ( 1 << j ) ) != 0 ) )
-            {// Check datarate validity for enabled channels
-                if( RegionCommonValueInRange( dr, ( channels[i + j].DrRange.Fields.Min & 0x0F ),
-                                                  ( channels[i + j].DrRange.Fields.Max & 0x0F ) ) == 1 )
-                {
-                    // At least 1 channel has been found we can return OK.
-                    return true;
-                }
+            uint8_t id = i + LowestChannel( mask );
+
+            mask &= mask - 1;
+            // Check datarate validity for enabled channels
+            if( RegionCommonValueInRange( dr, ( channels[id].DrRange.Fields.Min & 0x0F ),
+                                              ( channels[id].DrRange.Fields.Max & 0x0F ) ) == 1 )
+            {
+                // At least 1 channel has been found we can return OK.
+                return true;
             }
         }
     }
@@ -131,12 +136,102 @@ uint8_t RegionCommonCountChannels( uint16_t* channelsMask, uint8_t startIdx, uin
 
     for( uint8_t i = startIdx; i < stopIdx; i++ )
     {
-        nbChannels += CountChannels( channelsMask[i], 16 );
+        nbChannels += CountChannels( channelsMask[i] );
     }
 
     return nbChannels;
 }
 
+uint8_t RegionCommonChanMaskNth( uint16_t* channelsMask, uint8_t len, uint8_t n )
+{
+    for( uint8_t k = 0; k < len; k++ )
+    {
+        uint16_t mask = channelsMask[k];
+        uint8_t nbChannels = CountChannels( mask );
+
+        if( n >= nbChannels )
+        { // Skip the whole word
+            n -= nbChannels;
+            continue;
+        }
+        // Skip the lower byte too if the channel is in the upper one
+        uint8_t id = k * 16;
+        nbChannels = CountChannels( mask & 0x00FF );
+        if( n >= nbChannels )
+        {
+            n -= nbChannels;
+            mask >>= 8;
+            id += 8;
+        }
+        // Clear the n lower channels of the byte
+        for( ; n > 0; n-- )
+        {
+            mask &= mask - 1;
+        }
+        return id + LowestChannel( mask );
+    }
+    return 0xFF;
+}
+
+uint8_t RegionCommonCountNbOfEnabledChannels( RegionCommonCountNbOfEnabledChannelsParams_t* params, uint16_t* enabledChannels, uint8_t* delayTx )
+{
+    uint8_t nbEnabledChannels = 0;
+    uint8_t delayTransmission = 0;
+    uint32_t bandsAvailable = 0;
+
+    // Mask of the bands available for transmission
+    for( uint8_t i = 0; i < params->NbBands; i++ )
+    {
+        if( params->Bands[i].TimeOff == 0 )
+        {
+            bandsAvailable |= 1UL << i;
+        }
+    }
+
+    for( uint8_t i = 0, k = 0; i < params->MaxNbChannels; i += 16, k++ )
+    {
+        uint16_t mask = params->ChannelsMask[k];
+
+        if( params->Joined == false )
+        {
+            mask &= params->JoinChannels;
+        }
+        if( ( params->MaxNbChannels - i ) < 16 )
+        { // Ignore the bits beyond the last channel
+            mask &= ( 1 << ( params->MaxNbChannels - i ) ) - 1;
+        }
+        enabledChannels[k] = 0;
+
+        // Only visit the enabled channels
+        while( mask != 0 )
+        {
+            uint8_t j = LowestChannel( mask );
+            ChannelParams_t* channel = &params->Channels[i + j];
+
+            mask &= mask - 1;
+            if( channel->Frequency == 0 )
+            { // Check if the channel is enabled
+                continue;
+            }
+            if( RegionCommonValueInRange( params->Datarate, channel->DrRange.Fields.Min,
+                                          channel->DrRange.Fields.Max ) == false )
+            { // Check if the current channel selection supports the given datarate
+                continue;
+            }
+            if( ( bandsAvailable & ( 1UL << channel->Band ) ) == 0 )
+            { // Check if the band is available for transmission
+                delayTransmission++;
+                continue;
+            }
+            enabledChannels[k] |= 1 << j;
+            nbEnabledChannels++;
+        }
+    }
+
+    *delayTx = delayTransmission;
+    return nbEnabledChannels;
+}
+
 void RegionCommonChanMaskCopy( uint16_t* channelsMaskDest, uint16_t* channelsMaskSrc, uint8_t len )
 {
     if( ( channelsMaskDest != NULL ) && ( channelsMaskSrc != NULL ) )
@@ -159,6 +159,42 @@ typedef struct sRegionCommonCalcBackOffParams
     TimerTime_t TxTimeOnAir;
 }RegionCommonCalcBackOffParams_t;
 
+typedef struct sRegionCommonCountNbOfEnabledChannelsParams
+{
+    /*!
+     * Set to true, if the node is joined.
+     */
+    bool Joined;
+    /*!
+     * The datarate of the next transmission.
+     */
+    uint8_t Datarate;
+    /*!
+     * Pointer to the first element of the channels mask.
+     */
+    uint16_t* ChannelsMask;
+    /*!
+     * A pointer to region specific channels.
+     */
+    ChannelParams_t* Channels;
+    /*!
+     * A pointer to region specific bands.
+     */
+    Band_t* Bands;
+    /*!
+     * The number of bands, 32 at most.
+     */
+    uint8_t NbBands;
+    /*!
+     * Maximum number of channels.
+     */
+    uint8_t MaxNbChannels;
+    /*!
+     * Mask applied to each channels mask word while the node is not joined.
+     */
+    uint16_t JoinChannels;
+}RegionCommonCountNbOfEnabledChannelsParams_t;
+
 /*!
  * \brief Calculates the join duty cycle.
  *        This is a generic function and valid for all regions.
@@ -232,6 +268,35 @@ bool RegionCommonChanDisable( uint16_t* channelsMask, uint8_t id, uint8_t maxCha
  */
 uint8_t RegionCommonCountChannels( uint16_t* channelsMask, uint8_t startIdx, uint8_t stopIdx );
 
+/*!
+ * \brief Finds the n-th active channel of a given channels mask.
+ *        This is a generic function and valid for all regions.
+ *
+ * \param [IN] channelsMask The channels mask of the region.
+ *
+ * \param [IN] len The number of words of the channels mask.
+ *
+ * \param [IN] n Rank of the channel, 0 for the first active channel.
+ *
+ * \retval Returns the id of the channel, 0xFF if there are not more than n active channels.
+ */
+uint8_t RegionCommonChanMaskNth( uint16_t* channelsMask, uint8_t len, uint8_t n );
+
+/*!
+ * \brief Finds the channels of a given channels mask which can be used for the next transmission.
+ *        This is a generic function and valid for all regions.
+ *
+ * \param [IN] params A pointer to the function parameters.
+ *
+ * \param [OUT] enabledChannels The channels mask of the usable channels,
+ *                              ( MaxNbChannels + 15 ) / 16 words.
+ *
+ * \param [OUT] delayTx The number of channels which can be used once their band is available.
+ *
+ * \retval Returns the number of usable channels.
+ */
+uint8_t RegionCommonCountNbOfEnabledChannels( RegionCommonCountNbOfEnabledChannelsParams_t* params, uint16_t* enabledChannels, uint8_t* delayTx );
+
 /*!
  * \brief Copy a channels mask.
  *        This is a generic function and valid for all regions.
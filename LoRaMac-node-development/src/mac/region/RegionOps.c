@@ -0,0 +1,389 @@
+/*
+ / _____)             _              | |
+( (____  _____ ____ _| |_ _____  ____| |__
+ \____ \| ___ |    (_   _) ___ |/ ___)  _ \
+ _____) ) ____| | | || |_| ____( (___| | | |
+(______/|_____)_|_|_| \__)_____)\____)_| |_|
+    (C)2013 Semtech
+ ___ _____ _   ___ _  _____ ___  ___  ___ ___
+/ __|_   _/_\ / __| |/ / __/ _ \| _ \/ __| __|
+\__ \ | |/ _ \ (__| ' <| _| (_) |   / (__| _|
+|___/ |_/_/ \_\___|_|\_\_| \___/|_|_\\___|___|
+embedded.connectivity.solutions===============
+
+Description: LoRa MAC region table dispatch, built with REGION_DISPATCH_TABLE
+
+License: Revised BSD License, see LICENSE.TXT file include in the project
+
+Maintainer: Miguel Luis ( Semtech ), Gregory Cristian ( Semtech ) and Daniel Jaeckle ( STACKFORCE )
+*/
+#include <stdbool.h>
+#include <string.h>
+#include <stdint.h>
+
+#include "timer.h"
+#include "LoRaMac.h"
+
+
+
+// Regional includes
+#include "Region.h"
+
+#ifdef REGION_DISPATCH_TABLE
+
+#define REGION_OPS_TABLE( name )                                \
+static const RegionOps_t Region##name##Ops =                    \
+{                                                               \
+    Region##name##GetPhyParam,                                  \
+    Region##name##SetBandTxDone,                                \
+    Region##name##InitDefaults,                                 \
+    Region##name##Verify,                                       \
+    Region##name##ApplyCFList,                                  \
+    Region##name##ChanMaskSet,                                  \
+    Region##name##AdrNext,                                      \
+    Region##name##ComputeRxWindowParameters,                    \
+    Region##name##RxConfig,                                     \
+    Region##name##TxConfig,                                     \
+    Region##name##LinkAdrReq,                                   \
+    Region##name##RxParamSetupReq,                              \
+    Region##name##NewChannelReq,                                \
+    Region##name##TxParamSetupReq,                              \
+    Region##name##DlChannelReq,                                 \
+    Region##name##AlternateDr,                                  \
+    Region##name##CalcBackOff,                                  \
+    Region##name##NextChannel,                                  \
+    Region##name##ChannelAdd,                                   \
+    Region##name##ChannelsRemove,                               \
+    Region##name##SetContinuousWave,                            \
+    Region##name##ApplyDrOffset                                 \
+}
+
+
+
+/*
+ * With a single region enabled, its table is a compile time constant and the
+ * compiler turns the dispatch into direct calls. Otherwise the table of the
+ * region selected by RegionSelect is used.
+ */
+#if ( defined( REGION_AS923 ) + defined( REGION_AU915 ) + defined( REGION_CN470 ) + defined( REGION_CN779 ) + defined( REGION_EU433 ) + \
+      defined( REGION_EU868 ) + defined( REGION_KR920 ) + defined( REGION_IN865 ) + defined( REGION_US915 ) + defined( REGION_US915_HYBRID ) ) == 1
+#define REGION_DISPATCH_SINGLE                     1
+#else
+#define REGION_DISPATCH_SINGLE                     0
+#endif
+
+
+
+// Setup regions
+#ifdef REGION_AS923
+#include "RegionAS923.h"
+REGION_OPS_TABLE( AS923 );
+#define AS923_OPS( )                               case LORAMAC_REGION_AS923: { return &RegionAS923Ops; }
+#if ( REGION_DISPATCH_SINGLE == 1 )
+#define REGION_OPS                                 ( &RegionAS923Ops )
+#define REGION_SELECTED                            LORAMAC_REGION_AS923
+#endif
+#else
+#define AS923_OPS( )
+#endif
+
+#ifdef REGION_AU915
+#include "RegionAU915.h"
+REGION_OPS_TABLE( AU915 );
+#define AU915_OPS( )                               case LORAMAC_REGION_AU915: { return &RegionAU915Ops; }
+#if ( REGION_DISPATCH_SINGLE == 1 )
+#define REGION_OPS                                 ( &RegionAU915Ops )
+#define REGION_SELECTED                            LORAMAC_REGION_AU915
+#endif
+#else
+#define AU915_OPS( )
+#endif
+
+#ifdef REGION_CN470
+#include "RegionCN470.h"
+REGION_OPS_TABLE( CN470 );
+#define CN470_OPS( )                               case LORAMAC_REGION_CN470: { return &RegionCN470Ops; }
+#if ( REGION_DISPATCH_SINGLE == 1 )
+#define REGION_OPS                                 ( &RegionCN470Ops )
+#define REGION_SELECTED                            LORAMAC_REGION_CN470
+#endif
+#else
+#define CN470_OPS( )
+#endif
+
+#ifdef REGION_CN779
+#include "RegionCN779.h"
+REGION_OPS_TABLE( CN779 );
+#define CN779_OPS( )                               case LORAMAC_REGION_CN779: { return &RegionCN779Ops; }
+#if ( REGION_DISPATCH_SINGLE == 1 )
+#define REGION_OPS                                 ( &RegionCN779Ops )
+#define REGION_SELECTED                            LORAMAC_REGION_CN779
+#endif
+#else
+#define CN779_OPS( )
+#endif
+
+#ifdef REGION_EU433
+#include "RegionEU433.h"
+REGION_OPS_TABLE( EU433 );
+#define EU433_OPS( )                               case LORAMAC_REGION_EU433: { return &RegionEU433Ops; }
+#if ( REGION_DISPATCH_SINGLE == 1 )
+#define REGION_OPS                                 ( &RegionEU433Ops )
+#define REGION_SELECTED                            LORAMAC_REGION_EU433
+#endif
+#else
+#define EU433_OPS( )
+#endif
+
+#ifdef REGION_EU868
+#include "RegionEU868.h"
+REGION_OPS_TABLE( EU868 );
+#define EU868_OPS( )                               case LORAMAC_REGION_EU868: { return &RegionEU868Ops; }
+#if ( REGION_DISPATCH_SINGLE == 1 )
+#define REGION_OPS                                 ( &RegionEU868Ops )
+#define REGION_SELECTED                            LORAMAC_REGION_EU868
+#endif
+#else
+#define EU868_OPS( )
+#endif
+
+#ifdef REGION_KR920
+#include "RegionKR920.h"
+REGION_OPS_TABLE( KR920 );
+#define KR920_OPS( )                               case LORAMAC_REGION_KR920: { return &RegionKR920Ops; }
+#if ( REGION_DISPATCH_SINGLE == 1 )
+#define REGION_OPS                                 ( &RegionKR920Ops )
+#define REGION_SELECTED                            LORAMAC_REGION_KR920
+#endif
+#else
+#define KR920_OPS( )
+#endif
+
+#ifdef REGION_IN865
+#include "RegionIN865.h"
+REGION_OPS_TABLE( IN865 );
+#define IN865_OPS( )                               case LORAMAC_REGION_IN865: { return &RegionIN865Ops; }
+#if ( REGION_DISPATCH_SINGLE == 1 )
+#define REGION_OPS                                 ( &RegionIN865Ops )
+#define REGION_SELECTED                            LORAMAC_REGION_IN865
+#endif
+#else
+#define IN865_OPS( )
+#endif
+
+#ifdef REGION_US915
+#include "RegionUS915.h"
+REGION_OPS_TABLE( US915 );
+#define US915_OPS( )                               case LORAMAC_REGION_US915: { return &RegionUS915Ops; }
+#if ( REGION_DISPATCH_SINGLE == 1 )
+#define REGION_OPS                                 ( &RegionUS915Ops )
+#define REGION_SELECTED                            LORAMAC_REGION_US915
+#endif
+#else
+#define US915_OPS( )
+#endif
+
+#ifdef REGION_US915_HYBRID
+#include "RegionUS915-Hybrid.h"
+REGION_OPS_TABLE( US915Hybrid );
+#define US915_HYBRID_OPS( )                        case LORAMAC_REGION_US915_HYBRID: { return &RegionUS915HybridOps; }
+#if ( REGION_DISPATCH_SINGLE == 1 )
+#define REGION_OPS                                 ( &RegionUS915HybridOps )
+#define REGION_SELECTED                            LORAMAC_REGION_US915_HYBRID
+#endif
+#else
+#define US915_HYBRID_OPS( )
+#endif
+
+#if ( REGION_DISPATCH_SINGLE == 0 )
+static const RegionOps_t* RegionOps = NULL;
+static LoRaMacRegion_t RegionSelected;
+#define REGION_OPS                                 RegionOps
+#endif
+
+/*
+ * Until RegionSelect succeeded, or when the region parameter is not the selected
+ * region, calls fail as the switch dispatch (Region.c) does for an inactive region.
+ */
+#if ( REGION_DISPATCH_SINGLE == 0 )
+#define REGION_OPS_CHECK( region, failure )        if( ( RegionOps == NULL ) || ( ( region ) != RegionSelected ) ) { return failure; }
+#else
+#define REGION_OPS_CHECK( region, failure )        if( ( region ) != REGION_SELECTED ) { return failure; }
+#endif
+
+static const RegionOps_t* RegionFind( LoRaMacRegion_t region )
+{
+    switch( region )
+    {
+        AS923_OPS( );
+        AU915_OPS( );
+        CN470_OPS( );
+        CN779_OPS( );
+        EU433_OPS( );
+        EU868_OPS( );
+        KR920_OPS( );
+        IN865_OPS( );
+        US915_OPS( );
+        US915_HYBRID_OPS( );
+        default:
+        {
+            return NULL;
+        }
+    }
+}
+
+bool RegionIsActive( LoRaMacRegion_t region )
+{
+    return RegionFind( region ) != NULL;
+}
+
+bool RegionSelect( LoRaMacRegion_t region )
+{
+    const RegionOps_t* ops = RegionFind( region );
+
+    if( ops == NULL )
+    {
+        return false;
+    }
+#if ( REGION_DISPATCH_SINGLE == 0 )
+    RegionOps = ops;
+    RegionSelected = region;
+#endif
+    return true;
+}
+
+PhyParam_t RegionGetPhyParam( LoRaMacRegion_t region, GetPhyParams_t* getPhy )
+{
+    PhyParam_t phyParam = { 0 };
+
+    REGION_OPS_CHECK( region, phyParam );
+    return REGION_OPS->GetPhyParam( getPhy );
+}
+
+void RegionSetBandTxDone( LoRaMacRegion_t region, SetBandTxDoneParams_t* txDone )
+{
+    REGION_OPS_CHECK( region, );
+    REGION_OPS->SetBandTxDone( txDone );
+}
+
+void RegionInitDefaults( LoRaMacRegion_t region, InitType_t type )
+{
+    REGION_OPS_CHECK( region, );
+    REGION_OPS->InitDefaults( type );
+}
+
+bool RegionVerify( LoRaMacRegion_t region, VerifyParams_t* verify, PhyAttribute_t phyAttribute )
+{
+    REGION_OPS_CHECK( region, false );
+    return REGION_OPS->Verify( verify, phyAttribute );
+}
+
+void RegionApplyCFList( LoRaMacRegion_t region, ApplyCFListParams_t* applyCFList )
+{
+    REGION_OPS_CHECK( region, );
+    REGION_OPS->ApplyCFList( applyCFList );
+}
+
+bool RegionChanMaskSet( LoRaMacRegion_t region, ChanMaskSetParams_t* chanMaskSet )
+{
+    REGION_OPS_CHECK( region, false );
+    return REGION_OPS->ChanMaskSet( chanMaskSet );
+}
+
+bool RegionAdrNext( LoRaMacRegion_t region, AdrNextParams_t* adrNext, int8_t* drOut, int8_t* txPowOut, uint32_t* adrAckCounter )
+{
+    REGION_OPS_CHECK( region, false );
+    return REGION_OPS->AdrNext( adrNext, drOut, txPowOut, adrAckCounter );
+}
+
+void RegionComputeRxWindowParameters( LoRaMacRegion_t region, int8_t datarate, uint8_t minRxSymbols, uint32_t rxError, RxConfigParams_t *rxConfigParams )
+{
+    REGION_OPS_CHECK( region, );
+    REGION_OPS->ComputeRxWindowParameters( datarate, minRxSymbols, rxError, rxConfigParams );
+}
+
+bool RegionRxConfig( LoRaMacRegion_t region, RxConfigParams_t* rxConfig, int8_t* datarate )
+{
+    REGION_OPS_CHECK( region, false );
+    return REGION_OPS->RxConfig( rxConfig, datarate );
+}
+
+bool RegionTxConfig( LoRaMacRegion_t region, TxConfigParams_t* txConfig, int8_t* txPower, TimerTime_t* txTimeOnAir )
+{
+    REGION_OPS_CHECK( region, false );
+    return REGION_OPS->TxConfig( txConfig, txPower, txTimeOnAir );
+}
+
+uint8_t RegionLinkAdrReq( LoRaMacRegion_t region, LinkAdrReqParams_t* linkAdrReq, int8_t* drOut, int8_t* txPowOut, uint8_t* nbRepOut, uint8_t* nbBytesParsed )
+{
+    REGION_OPS_CHECK( region, 0 );
+    return REGION_OPS->LinkAdrReq( linkAdrReq, drOut, txPowOut, nbRepOut, nbBytesParsed );
+}
+
+uint8_t RegionRxParamSetupReq( LoRaMacRegion_t region, RxParamSetupReqParams_t* rxParamSetupReq )
+{
+    REGION_OPS_CHECK( region, 0 );
+    return REGION_OPS->RxParamSetupReq( rxParamSetupReq );
+}
+
+uint8_t RegionNewChannelReq( LoRaMacRegion_t region, NewChannelReqParams_t* newChannelReq )
+{
+    REGION_OPS_CHECK( region, 0 );
+    return REGION_OPS->NewChannelReq( newChannelReq );
+}
+
+int8_t RegionTxParamSetupReq( LoRaMacRegion_t region, TxParamSetupReqParams_t* txParamSetupReq )
+{
+    REGION_OPS_CHECK( region, 0 );
+    return REGION_OPS->TxParamSetupReq( txParamSetupReq );
+}
+
+uint8_t RegionDlChannelReq( LoRaMacRegion_t region, DlChannelReqParams_t* dlChannelReq )
+{
+    REGION_OPS_CHECK( region, 0 );
+    return REGION_OPS->DlChannelReq( dlChannelReq );
+}
+
+int8_t RegionAlternateDr( LoRaMacRegion_t region, AlternateDrParams_t* alternateDr )
+{
+    REGION_OPS_CHECK( region, 0 );
+    return REGION_OPS->AlternateDr( alternateDr );
+}
+
+void RegionCalcBackOff( LoRaMacRegion_t region, CalcBackOffParams_t* calcBackOff )
+{
+    REGION_OPS_CHECK( region, );
+    REGION_OPS->CalcBackOff( calcBackOff );
+}
+
+bool RegionNextChannel( LoRaMacRegion_t region, NextChanParams_t* nextChanParams, uint8_t* channel, TimerTime_t* time, TimerTime_t* aggregatedTimeOff )
+{
+    REGION_OPS_CHECK( region, false );
+    return REGION_OPS->NextChannel( nextChanParams, channel, time, aggregatedTimeOff );
+}
+
+LoRaMacStatus_t RegionChannelAdd( LoRaMacRegion_t region, ChannelAddParams_t* channelAdd )
+{
+    REGION_OPS_CHECK( region, LORAMAC_STATUS_PARAMETER_INVALID );
+    return REGION_OPS->ChannelAdd( channelAdd );
+}
+
+bool RegionChannelsRemove( LoRaMacRegion_t region, ChannelRemoveParams_t* channelRemove )
+{
+    REGION_OPS_CHECK( region, false );
+    return REGION_OPS->ChannelsRemove( channelRemove );
+}
+
+void RegionSetContinuousWave( LoRaMacRegion_t region, ContinuousWaveParams_t* continuousWave )
+{
+    REGION_OPS_CHECK( region, );
+    REGION_OPS->SetContinuousWave( continuousWave );
+}
+
+uint8_t RegionApplyDrOffset( LoRaMacRegion_t region, uint8_t downlinkDwellTime, int8_t dr, int8_t drOffset )
+{
+    REGION_OPS_CHECK( region, dr );
+    return REGION_OPS->ApplyDrOffset( downlinkDwellTime, dr, drOffset );
+}
+
+#endif // REGION_DISPATCH_TABLE
@@ -18,6 +18,7 @@ Maintainer: Miguel Luis, Gregory Cristian and Wael Guibene
 #include "radio.h"
 #include "sx1276.h"
 #include "sx1276-board.h"
+#include "perf.h"
 
 /*
  * Local types definition
@@ -43,6 +44,38 @@ typedef struct
 }FskBandwidth_t;
 
 
+/*
+ * Register shadow
+ *
+ * The LoRa configuration registers are only changed by the driver, so their last written or
+ * read value is kept in RAM: reads are served from RAM and writes of an unchanged value are
+ * skipped, which removes most of the read-modify-write SPI transactions. The registers keep
+ * their value in sleep mode. The shadow is cleared by a reset and when the LongRangeMode bit
+ * switches the register bank. FSK registers are not shadowed.
+ */
+#ifndef SX1276_REG_SHADOW
+#define SX1276_REG_SHADOW                           1
+#endif
+
+#define SX1276_SHADOW_SIZE                          0x50
+
+#if ( SX1276_REG_SHADOW == 1 )
+/*!
+ * Shadowed LoRa registers bitmap: FRF, PA, FIFO base addresses, IRQ mask, modem, preamble,
+ * payload length, hop period, detection, IQ inversion, sync word, DIO mapping, TCXO and PA DAC
+ */
+static const uint8_t SX1276ShadowCacheable[SX1276_SHADOW_SIZE / 8] =
+{
+    0xC0, 0xCF, 0x02, 0xE0, 0x5F, 0x80, 0xCB, 0x0E, 0x03, 0x28
+};
+
+static uint8_t SX1276Shadow[SX1276_SHADOW_SIZE];
+static uint8_t SX1276ShadowValid[SX1276_SHADOW_SIZE / 8];
+static bool SX1276ShadowLoRa = false;
+#endif
+
+static SX1276SpiStats_t SX1276SpiStats;
+
 /*
  * Private functions prototypes
  */
@@ -691,6 +724,7 @@ void SX1276SetTxConfig( RadioModems_t modem, int8_t power, uint32_t fdev,
 uint32_t SX1276GetTimeOnAir( RadioModems_t modem, uint8_t pktLen )
 {
     uint32_t airTime = 0;
+    PERF_BEGIN( PerfTimeOnAir );
 
     switch( modem )
     {
@@ -764,6 +798,7 @@ uint32_t SX1276GetTimeOnAir( RadioModems_t modem, uint8_t pktLen )
         }
         break;
     }
+    PERF_END( PerfTimeOnAir );
     return airTime;
 }
 
@@ -1180,6 +1215,12 @@ void SX1276Reset( void )
 
     // Wait 6 ms
     DelayMs( 6 );
+
+#if ( SX1276_REG_SHADOW == 1 )
+    // All registers are back to their reset values, in FSK mode
+    memset( SX1276ShadowValid, 0, sizeof( SX1276ShadowValid ) );
+    SX1276ShadowLoRa = false;
+#endif
 }
 
 void SX1276SetOpMode( uint8_t opMode )
@@ -1233,22 +1274,104 @@ void SX1276SetModem( RadioModems_t modem )
     }
 }
 
+#if ( SX1276_REG_SHADOW == 1 )
+static bool SX1276ShadowIsCacheable( uint8_t addr )
+{
+    return ( SX1276ShadowLoRa == true ) && ( addr < SX1276_SHADOW_SIZE ) &&
+           ( ( SX1276ShadowCacheable[addr >> 3] & ( 1 << ( addr & 0x07 ) ) ) != 0 );
+}
+
+static void SX1276ShadowSetOpMode( uint8_t opMode )
+{
+    bool lora = ( opMode & RFLR_OPMODE_LONGRANGEMODE_ON ) != 0;
+
+    if( lora != SX1276ShadowLoRa )
+    {
+        memset( SX1276ShadowValid, 0, sizeof( SX1276ShadowValid ) );
+        SX1276ShadowLoRa = lora;
+    }
+}
+#endif
+
 void SX1276Write( uint8_t addr, uint8_t data )
 {
+#if ( SX1276_REG_SHADOW == 1 )
+    if( SX1276ShadowIsCacheable( addr ) == true )
+    {
+        uint8_t mask = 1 << ( addr & 0x07 );
+
+        if( ( ( SX1276ShadowValid[addr >> 3] & mask ) != 0 ) && ( SX1276Shadow[addr] == data ) )
+        {
+            SX1276SpiStats.WritesSkipped++;
+            return;
+        }
+        SX1276WriteBuffer( addr, &data, 1 );
+        SX1276Shadow[addr] = data;
+        SX1276ShadowValid[addr >> 3] |= mask;
+        return;
+    }
+    if( addr == REG_OPMODE )
+    {
+        SX1276ShadowSetOpMode( data );
+    }
+#endif
     SX1276WriteBuffer( addr, &data, 1 );
 }
 
 uint8_t SX1276Read( uint8_t addr )
 {
     uint8_t data;
+#if ( SX1276_REG_SHADOW == 1 )
+    bool cacheable = SX1276ShadowIsCacheable( addr );
+    uint8_t mask = 1 << ( addr & 0x07 );
+
+    if( ( cacheable == true ) && ( ( SX1276ShadowValid[addr >> 3] & mask ) != 0 ) )
+    {
+        SX1276SpiStats.ReadHits++;
+        return SX1276Shadow[addr];
+    }
+#endif
     SX1276ReadBuffer( addr, &data, 1 );
+#if ( SX1276_REG_SHADOW == 1 )
+    if( cacheable == true )
+    {
+        SX1276Shadow[addr] = data;
+        SX1276ShadowValid[addr >> 3] |= mask;
+    }
+    else if( addr == REG_OPMODE )
+    {
+        SX1276ShadowSetOpMode( data );
+    }
+#endif
     return data;
 }
 
+void SX1276GetSpiStats( SX1276SpiStats_t *stats )
+{
+    *stats = SX1276SpiStats;
+}
+
+void SX1276ResetSpiStats( void )
+{
+    memset( &SX1276SpiStats, 0, sizeof( SX1276SpiStats ) );
+}
+
 void SX1276WriteBuffer( uint8_t addr, uint8_t *buffer, uint8_t size )
 {
     uint8_t i;
 
+    SX1276SpiStats.Writes++;
+#if ( SX1276_REG_SHADOW == 1 )
+    if( addr != REG_FIFO )
+    {
+        // Writes through the radio driver interface bypass the shadow
+        for( i = addr; ( i < SX1276_SHADOW_SIZE ) && ( i < addr + size ); i++ )
+        {
+            SX1276ShadowValid[i >> 3] &= ~( 1 << ( i & 0x07 ) );
+        }
+    }
+#endif
+
     //NSS = 0;
     GpioWrite( &SX1276.Spi.Nss, 0 );
 
@@ -1266,6 +1389,8 @@ void SX1276ReadBuffer( uint8_t addr, uint8_t *buffer, uint8_t size )
 {
     uint8_t i;
 
+    SX1276SpiStats.Reads++;
+
     //NSS = 0;
     GpioWrite( &SX1276.Spi.Nss, 0 );
 
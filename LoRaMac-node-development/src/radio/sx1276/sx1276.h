@@ -394,6 +394,29 @@ void SX1276ReadBuffer( uint8_t addr, uint8_t *buffer, uint8_t size );
  */
 void SX1276SetMaxPayloadLength( RadioModems_t modem, uint8_t max );
 
+/*!
+ * Radio register access statistics
+ */
+typedef struct
+{
+    uint32_t Reads;         //!< SPI read transactions
+    uint32_t Writes;        //!< SPI write transactions
+    uint32_t ReadHits;      //!< Register reads served by the register shadow
+    uint32_t WritesSkipped; //!< Register writes skipped by the register shadow
+}SX1276SpiStats_t;
+
+/*!
+ * \brief Gets the radio register access statistics
+ *
+ * \param [OUT] stats Statistics
+ */
+void SX1276GetSpiStats( SX1276SpiStats_t *stats );
+
+/*!
+ * \brief Clears the radio register access statistics
+ */
+void SX1276ResetSpiStats( void );
+
 /*!
  * \brief Sets the network to public or private. Updates the sync byte.
  *
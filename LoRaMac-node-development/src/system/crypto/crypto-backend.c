@@ -0,0 +1,95 @@
+/*
+ / _____)             _              | |
+( (____  _____ ____ _| |_ _____  ____| |__
+ \____ \| ___ |    (_   _) ___ |/ ___)  _ \
+ _____) ) ____| | | || |_| ____( (___| | | |
+(______/|_____)_|_|_| \__)_____)\____)_| |_|
+    (C)2013 Semtech
+
+Description: Software AES-128 backend, see crypto-backend.h
+
+License: Revised BSD License, see LICENSE.TXT file include in the project
+*/
+#include <stdint.h>
+#include "utilities.h"
+
+#include "aes.h"
+#include "cmac.h"
+
+#include "crypto-backend.h"
+
+#if ( CRYPTO_BACKEND == CRYPTO_BACKEND_SOFTWARE )
+
+/*!
+ * AES computation context variable
+ */
+static aes_context AesContext;
+
+/*!
+ * CMAC computation context variable
+ */
+static AES_CMAC_CTX AesCmacCtx[1];
+
+/*!
+ * Counter block and key stream block
+ */
+static uint8_t aBlock[CRYPTO_BLOCK_SIZE];
+static uint8_t sBlock[CRYPTO_BLOCK_SIZE];
+
+static void CryptoBackendSetKey( const uint8_t *key )
+{
+    memset1( AesContext.ksch, '\0', 240 );
+    aes_set_key( key, 16, &AesContext );
+}
+
+void CryptoBackendAesEncrypt( const uint8_t *key, const uint8_t *in, uint16_t size, uint8_t *out )
+{
+    uint16_t i;
+
+    CryptoBackendSetKey( key );
+    for( i = 0; i < size; i += CRYPTO_BLOCK_SIZE )
+    {
+        aes_encrypt( in + i, out + i, &AesContext );
+    }
+}
+
+void CryptoBackendAesCtr( const uint8_t *key, const uint8_t *ctrBlock, const uint8_t *in, uint16_t size, uint8_t *out )
+{
+    uint16_t i;
+    uint16_t bufferIndex = 0;
+
+    CryptoBackendSetKey( key );
+    memcpy1( aBlock, ctrBlock, CRYPTO_BLOCK_SIZE );
+
+    while( size > 0 )
+    {
+        uint8_t blockSize = ( size >= CRYPTO_BLOCK_SIZE ) ? CRYPTO_BLOCK_SIZE : size;
+
+        aes_encrypt( aBlock, sBlock, &AesContext );
+        for( i = 0; i < blockSize; i++ )
+        {
+            out[bufferIndex + i] = in[bufferIndex + i] ^ sBlock[i];
+        }
+        aBlock[CRYPTO_BLOCK_SIZE - 1]++;
+        size -= blockSize;
+        bufferIndex += blockSize;
+    }
+}
+
+void CryptoBackendCmac( const uint8_t *key, const uint8_t *header, uint8_t headerSize, const uint8_t *buffer, uint16_t size, uint8_t *mac )
+{
+    AES_CMAC_Init( AesCmacCtx );
+
+    AES_CMAC_SetKey( AesCmacCtx, key );
+
+    if( headerSize > 0 )
+    {
+        AES_CMAC_Update( AesCmacCtx, header, headerSize );
+    }
+
+    AES_CMAC_Update( AesCmacCtx, buffer, size & 0xFF );
+
+    AES_CMAC_Final( mac, AesCmacCtx );
+}
+
+#endif // CRYPTO_BACKEND_SOFTWARE
@@ -0,0 +1,78 @@
+/*!
+ * \file      crypto-backend.h
+ *
+ * \brief     AES-128 primitives used by the LoRa MAC layer cryptography
+ *
+ * \copyright Revised BSD License, see section \ref LICENSE.
+ *
+ * \defgroup  CRYPTO_BACKEND AES-128 backend
+ *            LoRaMacCrypto.c only uses the three primitives below. They are
+ *            implemented either in software by aes.c and cmac.c
+ *            (crypto-backend.c), or by the board, e.g. with an AES hardware
+ *            accelerator. The implementation is selected at build time with
+ *            CRYPTO_BACKEND.
+ * \{
+ */
+#ifndef __CRYPTO_BACKEND_H__
+#define __CRYPTO_BACKEND_H__
+
+#include <stdint.h>
+
+/*!
+ * Software implementation, aes.c and cmac.c
+ */
+#define CRYPTO_BACKEND_SOFTWARE                     0
+
+/*!
+ * Board implementation
+ */
+#define CRYPTO_BACKEND_BOARD                        1
+
+#ifndef CRYPTO_BACKEND
+#define CRYPTO_BACKEND                              CRYPTO_BACKEND_SOFTWARE
+#endif
+
+/*!
+ * AES block size
+ */
+#define CRYPTO_BLOCK_SIZE                           16
+
+/*!
+ * Encrypts blocks in ECB mode
+ *
+ * \param [IN]  key             - AES-128 key
+ * \param [IN]  in              - Input blocks
+ * \param [IN]  size            - Input size, multiple of CRYPTO_BLOCK_SIZE
+ * \param [OUT] out             - Encrypted blocks, may be equal to in
+ */
+void CryptoBackendAesEncrypt( const uint8_t *key, const uint8_t *in, uint16_t size, uint8_t *out );
+
+/*!
+ * Encrypts a buffer in CTR mode
+ *
+ * \remark Only the last byte of the counter block is incremented. The MAC
+ *         frames are at most 255 bytes long, so it never wraps.
+ *
+ * \param [IN]  key             - AES-128 key
+ * \param [IN]  ctrBlock        - Counter block, its last byte holds the first counter
+ * \param [IN]  in              - Input buffer
+ * \param [IN]  size            - Input buffer size
+ * \param [OUT] out             - Encrypted buffer, may be equal to in
+ */
+void CryptoBackendAesCtr( const uint8_t *key, const uint8_t *ctrBlock, const uint8_t *in, uint16_t size, uint8_t *out );
+
+/*!
+ * Computes the AES-CMAC of a header followed by a buffer
+ *
+ * \param [IN]  key             - AES-128 key
+ * \param [IN]  header          - Header, NULL if headerSize is 0
+ * \param [IN]  headerSize      - Header size, at most CRYPTO_BLOCK_SIZE bytes
+ * \param [IN]  buffer          - Data buffer
+ * \param [IN]  size            - Data buffer size, at most 255 bytes
+ * \param [OUT] mac             - Computed CMAC, CRYPTO_BLOCK_SIZE bytes
+ */
+void CryptoBackendCmac( const uint8_t *key, const uint8_t *header, uint8_t headerSize, const uint8_t *buffer, uint16_t size, uint8_t *mac );
+
+/*! \} defgroup CRYPTO_BACKEND */
+
+#endif // __CRYPTO_BACKEND_H__
@@ -14,6 +14,7 @@ Maintainer: Miguel Luis and Gregory Cristian
 */
 #include "board.h"
 #include "rtc-board.h"
+#include "perf.h"
 
 
 /*!
@@ -84,6 +85,7 @@ void TimerStart( TimerEvent_t *obj )
 {
     uint32_t elapsedTime = 0;
     uint32_t remainingTime = 0;
+    PERF_BEGIN( PerfTimerStart );
 
     BoardDisableIrq( );
 
@@ -126,6 +128,7 @@ void TimerStart( TimerEvent_t *obj )
         }
     }
     BoardEnableIrq( );
+    PERF_END( PerfTimerStart );
 }
 
 static void TimerInsertTimer( TimerEvent_t *obj, uint32_t remainingTime )
@@ -0,0 +1,170 @@
+/*
+ * adr-predict.c
+ *
+ */
+/** \addtogroup LW LoRaWAN Implementation
+ *  @{
+ */
+
+#include "board.h"
+#include "adr-predict.h"
+
+/** @cond */
+#define ADRP_MAX_DATARATE           5       // Fastest data rate with a known demodulation floor
+#define ADRP_TX_POWER_STEP          8       // TX power index step in 1/4 dB (2 dB)
+#define ADRP_AVERAGE                4       // Samples averaging weight
+#define ADRP_MIN_SAMPLES            3       // Fresh samples needed before a faster setting
+#define ADRP_MISS_PENALTY           8       // Estimate decrease per missed acknowledgment in 1/4 dB
+#define ADRP_NO_CEILING             -1
+
+/*!
+ * LoRa demodulation floors in 1/4 dB, SF12 to SF7 at 125 kHz
+ */
+static const int16_t DemodFloor[ADRP_MAX_DATARATE + 1] = { -80, -70, -60, -50, -40, -30 };
+
+static AdrPredictStats_t Stats;
+static uint8_t FreshSamples = 0;
+static int8_t Ceiling = ADRP_NO_CEILING;
+/** @endcond */
+
+static void AdrPredictSample( int16_t snr )
+{
+    if( Stats.Valid == false )
+    {
+        Stats.Snr = snr;
+        Stats.Valid = true;
+    }
+    else
+    {
+        Stats.Snr += ( snr - Stats.Snr ) / ADRP_AVERAGE;
+    }
+    Stats.Samples++;
+    if( FreshSamples < ADRP_MIN_SAMPLES )
+    {
+        FreshSamples++;
+    }
+}
+
+void AdrPredictInit( void )
+{
+    memset( &Stats, 0, sizeof( Stats ) );
+    FreshSamples = 0;
+    Ceiling = ADRP_NO_CEILING;
+}
+
+void AdrPredictLinkCheck( uint8_t margin, uint8_t gateways, int8_t datarate, int8_t txPower )
+{
+    if( ( gateways == 0 ) || ( datarate < 0 ) || ( datarate > ADRP_MAX_DATARATE ) )
+    {
+        return;
+    }
+    // The margin was measured by the gateway on the uplink itself
+    AdrPredictSample( ( int16_t )margin * 4 + DemodFloor[datarate] + txPower * ADRP_TX_POWER_STEP );
+}
+
+void AdrPredictRxDone( int8_t datarate, int8_t snr, float maxEirp )
+{
+    if( ( datarate < 0 ) || ( datarate > ADRP_MAX_DATARATE ) )
+    {
+        return;
+    }
+    // Uplink at maximum TX power: the gateway transmits ADR_PREDICT_GATEWAY_EIRP - maxEirp dB louder
+    int16_t eirpDelta = ( int16_t )( ( ADR_PREDICT_GATEWAY_EIRP - maxEirp ) * 4 );
+    AdrPredictSample( ( ( int16_t )snr - ADR_PREDICT_DOWNLINK_BIAS ) * 4 - eirpDelta );
+}
+
+void AdrPredictMissed( void )
+{
+    if( Stats.Valid == true )
+    {
+        Stats.Snr -= ADRP_MISS_PENALTY;
+    }
+    FreshSamples = 0;
+}
+
+void AdrPredictNetworkCommand( int8_t datarate, int8_t txPower )
+{
+    ( void )txPower;
+    // The network settings stand until new samples show they do not fit
+    Ceiling = datarate;
+    Stats.Valid = false;
+    Stats.Overrides++;
+    FreshSamples = 0;
+}
+
+bool AdrPredictNext( AdrPredictParams_t* params, int8_t* drOut, int8_t* txPowOut )
+{
+    int8_t datarate = params->Datarate;
+    int8_t txPower = params->TxPower;
+    int8_t maxDatarate = MIN( params->MaxDatarate, ADRP_MAX_DATARATE );
+    int16_t margin;
+    int16_t target = ( ADR_PREDICT_MARGIN_MIN + ADR_PREDICT_HYSTERESIS ) * 4;
+
+    *drOut = datarate;
+    *txPowOut = txPower;
+
+    if( ( Stats.Valid == false ) || ( datarate < params->MinDatarate ) || ( datarate > ADRP_MAX_DATARATE ) )
+    {
+        return false;
+    }
+    if( ( Ceiling != ADRP_NO_CEILING ) && ( Ceiling < maxDatarate ) )
+    {
+        maxDatarate = Ceiling;
+    }
+
+    margin = Stats.Snr - txPower * ADRP_TX_POWER_STEP - DemodFloor[datarate];
+    if( margin < ( ADR_PREDICT_MARGIN_MIN * 4 ) )
+    {
+        if( txPower > params->MaxTxPower )
+        {
+            // Raise the TX power first, it costs no airtime
+            int8_t steps = ( int8_t )( ( ADR_PREDICT_MARGIN_MIN * 4 - margin + ADRP_TX_POWER_STEP - 1 ) / ADRP_TX_POWER_STEP );
+            txPower = MAX( params->MaxTxPower, txPower - steps );
+        }
+        else if( datarate > params->MinDatarate )
+        {
+            datarate--;
+        }
+        else
+        {
+            return false;
+        }
+        Stats.StepsDown++;
+    }
+    else if( FreshSamples >= ADRP_MIN_SAMPLES )
+    {
+        if( ( datarate < maxDatarate ) &&
+            ( ( Stats.Snr - params->MaxTxPower * ADRP_TX_POWER_STEP - DemodFloor[datarate + 1] ) >= target ) )
+        {
+            // Speed up first, at maximum TX power, it saves airtime and energy. The margin left
+            // is then spent on a lower TX power, otherwise a lowered TX power would block faster data rates
+            datarate++;
+            txPower = params->MaxTxPower;
+        }
+        else if( ( txPower < params->MinTxPower ) && ( ( margin - ADRP_TX_POWER_STEP ) >= target ) )
+        {
+            txPower++;
+        }
+        else
+        {
+            return false;
+        }
+        Stats.StepsUp++;
+        FreshSamples = 0;
+    }
+    else
+    {
+        return false;
+    }
+
+    *drOut = datarate;
+    *txPowOut = txPower;
+    return true;
+}
+
+void AdrPredictGetStats( AdrPredictStats_t* stats )
+{
+    *stats = Stats;
+}
+
+/** }@ */
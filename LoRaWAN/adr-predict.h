@@ -0,0 +1,141 @@
+/**
+ * @file adr-predict.h
+ * @brief Device side predictive ADR
+ *
+ * The uplink SNR, normalized to the maximum TX power, is estimated from the LinkCheckAns
+ * demodulation margins, the downlink SNR and the missed acknowledgments. The data rate and
+ * TX power are stepped down as soon as the estimated margin gets too low, instead of
+ * waiting for ADR_ACK_LIMIT + ADR_ACK_DELAY uplinks without downlink, and stepped back up
+ * when the margin is large again.
+ * The network keeps the last word: a LinkADRReq resets the estimate and its data rate
+ * becomes the highest one the estimator may select.
+ *
+ * \remark The demodulation floors assume DR_0..DR_5 map to SF12..SF7 at 125 kHz, as in
+ *         the KR920, EU868 and AS923 regions. Other data rates are left untouched.
+ */
+/** \addtogroup LW LoRaWAN Implementation
+ *  @{
+ */
+#ifndef __ADR_PREDICT_H__
+#define __ADR_PREDICT_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/*!
+ * Lowest uplink margin in dB before the link is made more robust
+ */
+#ifndef ADR_PREDICT_MARGIN_MIN
+#define ADR_PREDICT_MARGIN_MIN          3
+#endif
+
+/*!
+ * Margin in dB kept above ADR_PREDICT_MARGIN_MIN after a step to a faster data rate
+ * or a lower TX power
+ */
+#ifndef ADR_PREDICT_HYSTERESIS
+#define ADR_PREDICT_HYSTERESIS          3
+#endif
+
+/*!
+ * Gateway downlink EIRP in dBm
+ */
+#ifndef ADR_PREDICT_GATEWAY_EIRP
+#define ADR_PREDICT_GATEWAY_EIRP        20
+#endif
+
+/*!
+ * Downlink SNR in excess of the uplink SNR in dB for the same EIRP at both ends
+ * (receiver noise figures and antenna gains)
+ */
+#ifndef ADR_PREDICT_DOWNLINK_BIAS
+#define ADR_PREDICT_DOWNLINK_BIAS       0
+#endif
+
+/*!
+ * \brief Predictive ADR data rate and TX power limits
+ */
+typedef struct
+{
+    int8_t Datarate;        //!< Current data rate
+    int8_t TxPower;         //!< Current TX power index
+    int8_t MinDatarate;     //!< Slowest region data rate
+    int8_t MaxDatarate;     //!< Fastest region data rate
+    int8_t MaxTxPower;      //!< Index of the highest TX power
+    int8_t MinTxPower;      //!< Index of the lowest TX power
+} AdrPredictParams_t;
+
+/*!
+ * \brief Predictive ADR statistics
+ */
+typedef struct
+{
+    uint32_t Samples;       //!< Number of SNR samples used
+    uint32_t StepsDown;     //!< Number of steps to a more robust setting
+    uint32_t StepsUp;       //!< Number of steps to a faster or lower power setting
+    uint32_t Overrides;     //!< Number of LinkADRReq received
+    int16_t  Snr;           //!< Estimated uplink SNR at maximum TX power in 1/4 dB
+    bool     Valid;         //!< Set if Snr holds a valid estimate
+} AdrPredictStats_t;
+
+/*!
+ * \brief Reset the estimator, to be called on every new session
+ */
+void AdrPredictInit( void );
+
+/*!
+ * \brief Account a LinkCheckAns
+ *
+ * \param [IN] margin    Demodulation margin in dB
+ * \param [IN] gateways  Number of gateways that received the LinkCheckReq
+ * \param [IN] datarate  Data rate of the uplink that carried the LinkCheckReq
+ * \param [IN] txPower   TX power index of that uplink
+ */
+void AdrPredictLinkCheck( uint8_t margin, uint8_t gateways, int8_t datarate, int8_t txPower );
+
+/*!
+ * \brief Account a valid unicast downlink
+ *
+ * \details The downlink SNR does not depend on the device TX power. It is brought to the
+ *          uplink at maximum TX power by removing the difference between the gateway EIRP
+ *          and the device maximum EIRP.
+ *
+ * \param [IN] datarate  Downlink data rate
+ * \param [IN] snr       Downlink SNR in dB
+ * \param [IN] maxEirp   Device maximum EIRP in dBm
+ */
+void AdrPredictRxDone( int8_t datarate, int8_t snr, float maxEirp );
+
+/*!
+ * \brief Account a confirmed uplink transmission that was not acknowledged
+ */
+void AdrPredictMissed( void );
+
+/*!
+ * \brief Account a LinkADRReq applied by the MAC
+ *
+ * \param [IN] datarate  Data rate set by the network
+ * \param [IN] txPower   TX power index set by the network
+ */
+void AdrPredictNetworkCommand( int8_t datarate, int8_t txPower );
+
+/*!
+ * \brief Compute the data rate and TX power of the next uplink
+ *
+ * \param [IN]  params   Current settings and region limits
+ * \param [OUT] drOut    Data rate to use
+ * \param [OUT] txPowOut TX power index to use
+ * \retval true if the settings were changed
+ */
+bool AdrPredictNext( AdrPredictParams_t* params, int8_t* drOut, int8_t* txPowOut );
+
+/*!
+ * \brief Get the estimator statistics
+ *
+ * \param [OUT] stats    Statistics
+ */
+void AdrPredictGetStats( AdrPredictStats_t* stats );
+
+/**  }@
+ */
+#endif // __ADR_PREDICT_H__
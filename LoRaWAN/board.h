@@ -147,6 +147,14 @@ static inline void BoardEnableIrq( void ) { SystemIrqEnable(); }
  */
 static inline uint32_t BoardGetBatteryVoltage( void ) { return SystemBatteryGetVoltage(); }
 
+/*!
+ * \brief Get the MCU temperature
+ * \remark Opens and closes ADC0, only call from task context
+ *
+ * \retval temperature Temperature in 1/10 °C
+ */
+static inline int16_t BoardGetTemperature( void ) { return SystemGetTemperature(); }
+
 /*!
  * Battery thresholds
  */
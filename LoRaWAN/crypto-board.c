@@ -0,0 +1,156 @@
+/*
+ * crypto-board.c
+ *
+ */
+/** \addtogroup LW LoRaWAN Implementation
+ *  @{
+ */
+
+#include "board.h"
+#include "crypto-backend.h"
+
+#if ( CRYPTO_BACKEND == CRYPTO_BACKEND_BOARD )
+
+#include "em_cmu.h"
+#include "em_crypto.h"
+
+/** @cond */
+#define CRYPTO_CMAC_BUFFER_SIZE     ( CRYPTO_BLOCK_SIZE + 256 )     // B0 block and the largest frame, padded
+#define CRYPTO_CMAC_RB              0x87                            // CMAC subkey constant
+
+static const uint8_t ZeroBlock[CRYPTO_BLOCK_SIZE] = { 0 };
+
+static uint8_t CmacBuffer[CRYPTO_CMAC_BUFFER_SIZE];
+static uint8_t aBlock[CRYPTO_BLOCK_SIZE];
+static uint8_t sBlock[CRYPTO_BLOCK_SIZE];
+
+static uint8_t CryptoBoardUsers;			// Operations in progress
+static bool CryptoBoardClockOwner;			// The clock was enabled by the first operation
+/** @endcond */
+
+/*
+ * The CRYPTO clock is only enabled around each operation. The sequencer is fed
+ * by the CPU: a LoRaWAN frame is at most 17 blocks, setting up the LDMA would
+ * cost more than the transfer itself.
+ * The clock is counted: it is enabled by the first operation in progress,
+ * disabled by the last one, and left alone if it was already enabled by
+ * another CRYPTO user.
+ */
+static void CryptoBoardBegin( void )
+{
+	BoardDisableIrq();
+	if (CryptoBoardUsers++ == 0)
+	{
+		CryptoBoardClockOwner = (CMU->HFBUSCLKEN0 & CMU_HFBUSCLKEN0_CRYPTO) == 0;
+		if (CryptoBoardClockOwner)
+		{
+			CMU_ClockEnable(cmuClock_CRYPTO, true);
+		}
+	}
+	BoardEnableIrq();
+}
+
+static void CryptoBoardEnd( void )
+{
+	BoardDisableIrq();
+	if ((--CryptoBoardUsers == 0) && CryptoBoardClockOwner)
+	{
+		CMU_ClockEnable(cmuClock_CRYPTO, false);
+	}
+	BoardEnableIrq();
+}
+
+static void CryptoBoardShiftLeft( uint8_t *pBlock )
+{
+	uint8_t	nMsb = pBlock[0] & 0x80;
+
+	for(int i = 0 ; i < CRYPTO_BLOCK_SIZE - 1 ; i++)
+	{
+		pBlock[i] = (uint8_t)((pBlock[i] << 1) | (pBlock[i + 1] >> 7));
+	}
+	pBlock[CRYPTO_BLOCK_SIZE - 1] <<= 1;
+	if (nMsb != 0)
+	{
+		pBlock[CRYPTO_BLOCK_SIZE - 1] ^= CRYPTO_CMAC_RB;
+	}
+}
+
+void CryptoBackendAesEncrypt( const uint8_t *key, const uint8_t *in, uint16_t size, uint8_t *out )
+{
+	CryptoBoardBegin();
+	CRYPTO_AES_ECB128(CRYPTO, out, in, size, key, true);
+	CryptoBoardEnd();
+}
+
+void CryptoBackendAesCtr( const uint8_t *key, const uint8_t *ctrBlock, const uint8_t *in, uint16_t size, uint8_t *out )
+{
+	uint16_t	nBlocksSize = size & ~(CRYPTO_BLOCK_SIZE - 1);
+
+	memcpy(aBlock, ctrBlock, CRYPTO_BLOCK_SIZE);
+
+	CryptoBoardBegin();
+	if (nBlocksSize > 0)
+	{
+		// The hardware increments the last 32 bits of the counter block, the
+		// frame is too short for the increment to go past its last byte
+		CRYPTO_AES_CTR128(CRYPTO, out, in, nBlocksSize, key, aBlock, NULL);
+	}
+	if (size > nBlocksSize)
+	{
+		CRYPTO_AES_ECB128(CRYPTO, sBlock, aBlock, CRYPTO_BLOCK_SIZE, key, true);
+		for(int i = 0 ; i < size - nBlocksSize ; i++)
+		{
+			out[nBlocksSize + i] = in[nBlocksSize + i] ^ sBlock[i];
+		}
+	}
+	CryptoBoardEnd();
+}
+
+void CryptoBackendCmac( const uint8_t *key, const uint8_t *header, uint8_t headerSize, const uint8_t *buffer, uint16_t size, uint8_t *mac )
+{
+	uint16_t	nSize;
+	uint16_t	nLast;
+
+	size &= 0xFF;
+	nSize = headerSize + size;
+
+	if (headerSize > 0)
+	{
+		memcpy(CmacBuffer, header, headerSize);
+	}
+	memcpy(&CmacBuffer[headerSize], buffer, size);
+
+	CryptoBoardBegin();
+
+	// Subkey K1, K2 is K1 shifted once more
+	CRYPTO_AES_ECB128(CRYPTO, sBlock, ZeroBlock, CRYPTO_BLOCK_SIZE, key, true);
+	CryptoBoardShiftLeft(sBlock);
+
+	if ((nSize == 0) || ((nSize % CRYPTO_BLOCK_SIZE) != 0))
+	{
+		// Incomplete last block, padded and combined with K2
+		nLast = nSize - (nSize % CRYPTO_BLOCK_SIZE);
+		memset(&CmacBuffer[nSize], 0, nLast + CRYPTO_BLOCK_SIZE - nSize);
+		CmacBuffer[nSize] = 0x80;
+		CryptoBoardShiftLeft(sBlock);
+	}
+	else
+	{
+		nLast = nSize - CRYPTO_BLOCK_SIZE;
+	}
+
+	for(int i = 0 ; i < CRYPTO_BLOCK_SIZE ; i++)
+	{
+		CmacBuffer[nLast + i] ^= sBlock[i];
+	}
+
+	// The MAC is the last block of the CBC encryption with a zero IV
+	CRYPTO_AES_CBC128(CRYPTO, CmacBuffer, CmacBuffer, nLast + CRYPTO_BLOCK_SIZE, key, ZeroBlock, true);
+	memcpy(mac, &CmacBuffer[nLast], CRYPTO_BLOCK_SIZE);
+
+	CryptoBoardEnd();
+}
+
+#endif
+
+/** }@ */
@@ -12,6 +12,7 @@
 #include "rtc-board.h"
 #include "global.h"
 #include "mmi_timer.h"
+#include "timebase.h"
 
 static uint32_t LastSetTime = 0;	// To keep track of last Timer start tick time
 
@@ -42,9 +43,14 @@ TimerTime_t RtcGetTimerValue( void )
 	value += ((timer % 1024) * 1000) / 1024;
 	return value;
 */
-// Use System Ticks instead as it's implementing free run timer
-// That is not stopped during low power mode
-	return SystemGetSystemTicks();
+// Use the time base counter instead as it's shared with the timer compare channel
+// and is not stopped during low power mode
+	return TimeBaseGetMs();
+}
+
+uint32_t RtcGetTimerValueUs( void )
+{
+    return ( uint32_t )TimeBaseGetUs( );
 }
 
 TimerTime_t RtcGetElapsedAlarmTime( void )
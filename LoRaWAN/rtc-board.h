@@ -53,6 +53,13 @@ TimerTime_t RtcGetAdjustedTimeoutValue( uint32_t timeout );
  */
 TimerTime_t RtcGetTimerValue( void );
 
+/*!
+ * \brief Get the RTC timer value with microsecond resolution
+ *
+ * \retval RTC Timer value in us (wraps around every 71 minutes)
+ */
+uint32_t RtcGetTimerValueUs( void );
+
 /*!
  * \brief Get the RTC timer elapsed time since the last Alarm was set
  *
@@ -0,0 +1,233 @@
+/*
+ * rx-calibration.c
+ *
+ */
+/** \addtogroup LW LoRaWAN Implementation
+ *  @{
+ */
+
+#include "board.h"
+#include "rx-calibration.h"
+
+/** @cond */
+#define RXCAL_BUCKETS               8       // Temperature ranges of 10 °C from -20 °C
+#define RXCAL_MIN_SAMPLES           3       // Samples needed before narrowing windows
+#define RXCAL_AVERAGE               8       // Samples averaging weight
+#define RXCAL_DEVIATION_FACTOR      4       // Margin in number of mean deviations
+#define RXCAL_JITTER                1000    // Fixed margin in us (time on air resolution + IRQ latency)
+#define RXCAL_MIN_ERROR             5       // Narrowest RX error in ms (timer resolution and wake-up latency)
+#define RXCAL_NO_TEMPERATURE        INT16_MIN
+#define RXCAL_MAX_MISSED            3       // Missed windows before falling back to worst case
+#define RXCAL_MAX_ERROR             50000   // Samples beyond this error in us are outliers
+#define RXCAL_MIN_SPREAD            62500   // Delays variance in ms² (250 ms deviation) to measure the drift
+#define RXCAL_MAX_DRIFT             200     // Largest crystal drift in ppm, also the margin while unknown
+
+/*!
+ * Timing error of one temperature range: a constant error (wake-up and IRQ latencies, time
+ * on air rounding) plus a drift of the crystal in ppm (us per second of RX delay). The
+ * drift is only known once samples were taken at different delays (RX1 and RX2), until
+ * then windows at other delays are widened by the largest drift.
+ */
+typedef struct
+{
+    int32_t Error;          // Mean error in us at the mean delay
+    int32_t Drift;          // Error growth in us per second of delay, 0 if not known
+    uint32_t Deviation;     // Mean absolute deviation from the fitted error in us
+    uint32_t Delay;         // Mean delay in ms
+    uint32_t Spread;        // Delays variance in ms²
+    int32_t Covariance;     // Delays and errors covariance in ms.us
+    uint16_t Samples;       // Number of samples averaged
+} RxCalibrationBucket_t;
+
+static RxCalibrationBucket_t Buckets[RXCAL_BUCKETS];
+static RxCalibrationStats_t Stats;
+static uint8_t CurrentBucket = 0;
+static volatile int16_t Temperature = RXCAL_NO_TEMPERATURE;
+static uint8_t MissedWindows = 0;
+static uint32_t TxDoneTime = 0;
+static uint32_t RxPreambleTime = 0;
+static bool RxPending = false;
+/** @endcond */
+
+/*
+ * Error expected in us after a delay in ms
+ */
+static int32_t RxCalibrationError( const RxCalibrationBucket_t* bucket, uint32_t delay )
+{
+    return bucket->Error + ( int32_t )( ( ( int64_t )bucket->Drift * ( ( int32_t )delay - ( int32_t )bucket->Delay ) ) / 1000 );
+}
+
+static uint8_t RxCalibrationBucket( int16_t temperature )
+{
+    int32_t bucket = ( ( int32_t )temperature + 200 ) / 100;
+
+    if( bucket < 0 )
+    {
+        return 0;
+    }
+    return ( bucket >= RXCAL_BUCKETS ) ? ( RXCAL_BUCKETS - 1 ) : ( uint8_t )bucket;
+}
+
+void RxCalibrationInit( void )
+{
+    memset( Buckets, 0, sizeof( Buckets ) );
+    memset( &Stats, 0, sizeof( Stats ) );
+    MissedWindows = 0;
+    RxPending = false;
+    Temperature = RXCAL_NO_TEMPERATURE;
+    CurrentBucket = RXCAL_BUCKETS;
+}
+
+void RxCalibrationSetTemperature( int16_t temperature )
+{
+    Temperature = temperature;
+}
+
+void RxCalibrationGetWindow( uint32_t rxDelay, uint32_t maxRxError, uint32_t* rxError, int32_t* rxShift )
+{
+    int16_t temperature = Temperature;
+    const RxCalibrationBucket_t* bucket;
+    uint32_t deviation;
+
+    *rxError = maxRxError;
+    *rxShift = 0;
+    Stats.Windows++;
+
+    // Samples are only taken once the temperature range is known
+    if( temperature == RXCAL_NO_TEMPERATURE )
+    {
+        CurrentBucket = RXCAL_BUCKETS;
+        return;
+    }
+    bucket = &Buckets[CurrentBucket = RxCalibrationBucket( temperature )];
+
+    if( bucket->Samples < RXCAL_MIN_SAMPLES )
+    {
+        // Use an adjacent temperature range with twice the margin
+        const RxCalibrationBucket_t* lower = ( CurrentBucket > 0 ) ? bucket - 1 : bucket;
+        const RxCalibrationBucket_t* upper = ( CurrentBucket < ( RXCAL_BUCKETS - 1 ) ) ? bucket + 1 : bucket;
+        bucket = ( lower->Samples >= upper->Samples ) ? lower : upper;
+        if( bucket->Samples < RXCAL_MIN_SAMPLES )
+        {
+            return;
+        }
+        deviation = bucket->Deviation * 2;
+    }
+    else
+    {
+        deviation = bucket->Deviation;
+    }
+    if( MissedWindows >= RXCAL_MAX_MISSED )
+    {
+        return;
+    }
+    // Unknown drift on a delay not sampled yet, margin doubles on each missed window
+    uint32_t margin = deviation * RXCAL_DEVIATION_FACTOR + RXCAL_JITTER;
+    if( bucket->Spread < RXCAL_MIN_SPREAD )
+    {
+        uint32_t distance = ( rxDelay > bucket->Delay ) ? ( rxDelay - bucket->Delay ) : ( bucket->Delay - rxDelay );
+        margin += ( distance * RXCAL_MAX_DRIFT ) / 1000;
+    }
+    margin = ( margin << MissedWindows ) + 999;
+    if( ( margin / 1000 ) >= maxRxError )
+    {
+        return;
+    }
+    int32_t error = RxCalibrationError( bucket, rxDelay );
+    *rxError = MAX( margin / 1000, RXCAL_MIN_ERROR );
+    *rxShift = ( error + ( ( error < 0 ) ? -500 : 500 ) ) / 1000;
+    Stats.Calibrated++;
+    Stats.SavedRxError += 2 * ( maxRxError - *rxError );
+}
+
+void RxCalibrationTxDone( void )
+{
+    TxDoneTime = RtcGetTimerValueUs( );
+    RxPending = false;
+}
+
+void RxCalibrationRxDone( uint32_t airTime )
+{
+    RxPreambleTime = RtcGetTimerValueUs( ) - ( airTime * 1000 );
+    RxPending = true;
+}
+
+void RxCalibrationRxValid( uint32_t rxDelay )
+{
+    if( ( RxPending == false ) || ( rxDelay == 0 ) || ( CurrentBucket >= RXCAL_BUCKETS ) )
+    {
+        return;
+    }
+    RxPending = false;
+
+    // Error between actual and expected preamble start
+    int32_t error = ( int32_t )( RxPreambleTime - TxDoneTime ) - ( int32_t )( rxDelay * 1000 );
+    Stats.LastError = error;
+    if( ( error > RXCAL_MAX_ERROR ) || ( error < -RXCAL_MAX_ERROR ) )
+    {
+        Stats.Rejected++;
+        return;
+    }
+    Stats.Received++;
+    MissedWindows = 0;
+
+    // Constant error and crystal drift fitted on the errors at each delay
+    RxCalibrationBucket_t* bucket = &Buckets[CurrentBucket];
+    if( bucket->Samples == 0 )
+    {
+        bucket->Error = error;
+        bucket->Drift = 0;
+        bucket->Deviation = ( uint32_t )( ( error < 0 ) ? -error : error );
+        bucket->Delay = rxDelay;
+        bucket->Spread = 0;
+        bucket->Covariance = 0;
+    }
+    else
+    {
+        int32_t weight = ( bucket->Samples < RXCAL_AVERAGE ) ? ( bucket->Samples + 1 ) : RXCAL_AVERAGE;
+        int32_t residual = error - RxCalibrationError( bucket, rxDelay );
+        int32_t delay = ( int32_t )rxDelay - ( int32_t )bucket->Delay;
+        int32_t delta = error - bucket->Error;
+        bucket->Delay = ( uint32_t )( ( int32_t )bucket->Delay + delay / weight );
+        bucket->Error += delta / weight;
+        int64_t spread = ( ( int64_t )delay * delay * ( weight - 1 ) ) / weight - bucket->Spread;
+        bucket->Spread = ( uint32_t )( bucket->Spread + spread / weight );
+        int64_t covariance = ( ( int64_t )delay * delta * ( weight - 1 ) ) / weight - bucket->Covariance;
+        bucket->Covariance = ( int32_t )( bucket->Covariance + covariance / weight );
+        if( bucket->Spread >= RXCAL_MIN_SPREAD )
+        {
+            int64_t drift = ( ( int64_t )bucket->Covariance * 1000 ) / ( int64_t )bucket->Spread;
+            bucket->Drift = ( int32_t )MAX( MIN( drift, RXCAL_MAX_DRIFT ), -RXCAL_MAX_DRIFT );
+        }
+        else
+        {
+            bucket->Drift = 0;
+        }
+        residual = ( ( residual < 0 ) ? -residual : residual ) - ( int32_t )bucket->Deviation;
+        bucket->Deviation = ( uint32_t )( ( int32_t )bucket->Deviation + ( residual / weight ) );
+    }
+    if( bucket->Samples < 0xFFFF )
+    {
+        bucket->Samples++;
+    }
+}
+
+void RxCalibrationRxMissed( void )
+{
+    Stats.Missed++;
+    if( MissedWindows < RXCAL_MAX_MISSED )
+    {
+        MissedWindows++;
+    }
+}
+
+void RxCalibrationGetStats( RxCalibrationStats_t* stats )
+{
+    if( stats != NULL )
+    {
+        *stats = Stats;
+    }
+}
+
+/**  }@
+ */
@@ -0,0 +1,95 @@
+/**
+ * @file rx-calibration.h
+ * @brief Self calibrating RX windows sizing
+ *
+ * The timing error between the expected and the actual downlink preamble start is measured
+ * on every received downlink and tracked per temperature range, split into a constant error
+ * and a crystal drift growing with the RX delay. RX windows are then
+ * centered on the observed error and only opened as wide as its observed deviation,
+ * instead of the worst case SystemMaxRxError. Missed windows widen them again.
+ */
+/** \addtogroup LW LoRaWAN Implementation
+ *  @{
+ */
+#ifndef __RX_CALIBRATION_H__
+#define __RX_CALIBRATION_H__
+
+#include <stdint.h>
+
+/*!
+ * \brief RX windows calibration statistics
+ */
+typedef struct
+{
+    uint32_t Windows;       //!< Number of RX windows computed
+    uint32_t Calibrated;    //!< Number of RX windows narrowed by calibration
+    uint32_t Received;      //!< Number of downlinks used for calibration
+    uint32_t Rejected;      //!< Number of downlinks rejected as outliers
+    uint32_t Missed;        //!< Number of expected downlinks missed
+    uint32_t SavedRxError;  //!< Cumulated RX window reduction in ms
+    int32_t  LastError;     //!< Last measured timing error in us
+} RxCalibrationStats_t;
+
+/*!
+ * \brief Reset all calibration data
+ */
+void RxCalibrationInit( void );
+
+/*!
+ * \brief Update the temperature used to select the calibration data
+ * \remark Must be called from task context, the temperature is measured with the ADC
+ *          which the MAC must not touch from its timer and radio IRQs
+ *
+ * \param [IN] temperature Current temperature in 1/10 °C
+ */
+void RxCalibrationSetTemperature( int16_t temperature );
+
+/*!
+ * \brief Compute the RX window error margin and center shift for the next uplink
+ * \remark Uses the last temperature given to RxCalibrationSetTemperature, windows
+ *         are not narrowed until it is known
+ *
+ * \param [IN]  rxDelay     Nominal RX window delay after TX done in ms
+ * \param [IN]  maxRxError  Worst case RX error in ms (SystemMaxRxError)
+ * \param [OUT] rxError     RX error in ms to use for window computation
+ * \param [OUT] rxShift     Window delay correction in ms
+ */
+void RxCalibrationGetWindow( uint32_t rxDelay, uint32_t maxRxError, uint32_t* rxError, int32_t* rxShift );
+
+/*!
+ * \brief Time stamp the end of the uplink transmission
+ * \remark Must be called from the TX done IRQ
+ */
+void RxCalibrationTxDone( void );
+
+/*!
+ * \brief Time stamp the end of a downlink reception
+ * \remark Must be called from the RX done IRQ
+ *
+ * \param [IN] airTime  Downlink time on air in ms
+ */
+void RxCalibrationRxDone( uint32_t airTime );
+
+/*!
+ * \brief Use the last RX done time stamp as a calibration sample
+ * \remark Only call once the downlink was authenticated
+ *
+ * \param [IN] rxDelay  Nominal delay of the window the downlink was received in, in ms
+ */
+void RxCalibrationRxValid( uint32_t rxDelay );
+
+/*!
+ * \brief Signal that an expected downlink was not received in any window
+ */
+void RxCalibrationRxMissed( void );
+
+/*!
+ * \brief Get calibration statistics
+ *
+ * \param [OUT] stats   Statistics
+ */
+void RxCalibrationGetStats( RxCalibrationStats_t* stats );
+
+/**  }@
+ */
+#endif // __RX_CALIBRATION_H__
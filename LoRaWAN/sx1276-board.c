@@ -8,6 +8,9 @@
 
 #include "board.h"
 #include "global.h"
+#include "link_stats.h"
+
+static bool SX1276BoardIsChannelFree( RadioModems_t modem, uint32_t freq, int16_t rssiThresh, uint32_t maxCarrierSenseTime );
 
 const struct Radio_s Radio =
 {
@@ -15,7 +18,7 @@ const struct Radio_s Radio =
     SX1276GetStatus,
     SX1276SetModem,
     SX1276SetChannel,
-    SX1276IsChannelFree,
+    SX1276BoardIsChannelFree,
     SX1276Random,
     SX1276SetRxConfig,
     SX1276SetTxConfig,
@@ -37,6 +40,17 @@ const struct Radio_s Radio =
 };
 
 static SPIPORT RfSpi;
+
+/*!
+ * Counts the listen before talk checks done by the region before each transmission
+ */
+static bool SX1276BoardIsChannelFree( RadioModems_t modem, uint32_t freq, int16_t rssiThresh, uint32_t maxCarrierSenseTime )
+{
+    bool free = SX1276IsChannelFree( modem, freq, rssiThresh, maxCarrierSenseTime );
+
+    LINKSTATS_ChannelSensed( free );
+    return free;
+}
 /*!
  * \brief Initializes the radio I/Os pins interface
  */
@@ -171,7 +185,9 @@ uint8_t SX1276GetPaSelect( uint32_t channel ) {
  * \param [in] status enable or disable
  */
 void SX1276SetAntSwLowPower( bool status ) {
-	(void)status;
+	// Radio operations are timed by the time base, which is stopped in EM3
+	if( status ) vEFMEnergyRelease( EnergyClientRadio );
+	else vEFMEnergyRequire( EnergyClientRadio, EnergyModeEM2 );
 }
 
 /*!
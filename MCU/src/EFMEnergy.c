@@ -8,25 +8,151 @@
 
 #include "FreeRTOS.h"
 #include "EFMEnergy.h"
+#include "timebase.h"
+#include "system.h"
 #include <em_chip.h>
 #include <em_cmu.h>
 #include <em_emu.h>
+#include <em_cryotimer.h>
+
+/** @cond */
+#define ENERGY_ULFRCO_NOMINAL	((TIMEBASE_FREQUENCY << 16) / 1000)	// Time base ticks per ULFRCO cycle (Q16)
+#define ENERGY_CAL_COUNTS		65536UL								// ULFRCO calibration period (about 1 minute)
+#define ENERGY_ULFRCO_MIN		(ENERGY_ULFRCO_NOMINAL - (ENERGY_ULFRCO_NOMINAL >> 3))	// ULFRCO accuracy limits (1 kHz +/-12%)
+#define ENERGY_ULFRCO_MAX		(ENERGY_ULFRCO_NOMINAL + (ENERGY_ULFRCO_NOMINAL >> 3))
+#define ENERGY_CAL_MAX_STEP		(ENERGY_ULFRCO_NOMINAL >> 7)		// Largest rate correction per calibration (0.8%)
+/** @endcond */
 
   /* By default deep sleep mode is allowed */
   PRIVILEGED_DATA static volatile portBASE_TYPE LowPowerDisabled = 0;
+  /* Deepest energy mode per driver, 0 when not restricted */
+  PRIVILEGED_DATA static volatile unsigned char EnergyLimits[EnergyClients];
+  PRIVILEGED_DATA static ENERGY_RESIDENCY EnergyResidency;
+  /* ULFRCO calibration against the time base, the ULFRCO is the only clock running in EM3 */
+  PRIVILEGED_DATA static uint32_t UlfrcoRate = ENERGY_ULFRCO_NOMINAL;
+  PRIVILEGED_DATA static uint32_t CalCount, CalTicks;
+  PRIVILEGED_DATA static uint32_t SkipFraction = 0;	// Q16 remainder of the last sleep conversion
+  PRIVILEGED_DATA static BOOL CalValid = false;
+  PRIVILEGED_DATA static BOOL EnergyInitDone = false;
+
+//! @brief Define EXCLUDE_DEFAULT_CRYOTIMER_IRQ_HANDLER to use user defined CRYOTIMER IRQ handler instead
+#ifndef EXCLUDE_DEFAULT_CRYOTIMER_IRQ_HANDLER
+/*!
+ * @brief CRYOTIMER IRQ handler, only used to wake up from EM3
+ */
+__interrupt_handler __attribute__((used)) void CRYOTIMER_IRQHandler(void) {
+	CRYOTIMER_IntClear(CRYOTIMER_IntGet());
+}
+#endif
+
+/**
+ * \brief Start the free running ULFRCO counter used to measure EM3 sleeps
+ */
+static void vEFMEnergyInit(void) {
+	CRYOTIMER_Init_TypeDef init = CRYOTIMER_INIT_DEFAULT;
+	init.enable = false;
+	init.osc = cryotimerOscULFRCO;
+	init.presc = cryotimerPresc_1;
+	init.period = cryotimerPeriod_4096m;
+	CMU_ClockEnable(cmuClock_CRYOTIMER, true);
+	CRYOTIMER_Init(&init);
+	CRYOTIMER_IntClear(_CRYOTIMER_IFC_MASK);
+	NVIC_ClearPendingIRQ(CRYOTIMER_IRQn);
+	NVIC_EnableIRQ(CRYOTIMER_IRQn);
+	CRYOTIMER_Enable(true);
+	EnergyInitDone = true;
+}
+
+/**
+ * \brief Measure the ULFRCO frequency against the time base
+ */
+static void vEFMEnergyCalibrate(void) {
+	uint32_t count = CRYOTIMER_CounterGet();
+	uint32_t ticks = TimeBaseGetTicks();
+	uint32_t counts = count - CalCount;
+
+	if (CalValid && (counts >= ENERGY_CAL_COUNTS)) {
+		// A too long period would overflow the time base ticks difference
+		if (counts < (ENERGY_CAL_COUNTS << 4)) {
+			uint32_t rate = (uint32_t)(((uint64_t)(ticks - CalTicks) << 16) / counts);
+			// Discard impossible measurements and bound each correction, a single bad period
+			// would otherwise bias every following sleep
+			if ((rate >= ENERGY_ULFRCO_MIN) && (rate <= ENERGY_ULFRCO_MAX)) {
+				if (rate > UlfrcoRate + ENERGY_CAL_MAX_STEP) rate = UlfrcoRate + ENERGY_CAL_MAX_STEP;
+				else if (rate + ENERGY_CAL_MAX_STEP < UlfrcoRate) rate = UlfrcoRate - ENERGY_CAL_MAX_STEP;
+				UlfrcoRate = rate;
+			}
+		}
+		CalValid = false;
+	}
+	if (!CalValid) {
+		CalCount = count;
+		CalTicks = ticks;
+		CalValid = true;
+	}
+}
 
 /**
- * \brief Put EFM32 processor in Low Power mode EM1 or EM2
+ * \brief Put EFM32 processor in EM3 until the deadline minus the wake up latency
+ * \details The time base counter is stopped in EM3, the sleep is measured with the ULFRCO
+ * and the time base is moved forward accordingly.
+ * @param deadline	Time to the next deadline in time base ticks
+ */
+static void vEFMEnergyEnterEM3(uint32_t deadline) {
+	uint32_t period = 32;
+	if (deadline != TIMEBASE_NO_DEADLINE) {
+		uint32_t counts = (uint32_t)(((uint64_t)(deadline - TimeBaseMsToTicks(ENERGY_EM3_WAKEUP_MS)) << 16) / UlfrcoRate);
+		period = 31 - __CLZ(counts);		// Largest power of 2 not exceeding the sleep duration
+	}
+	CRYOTIMER->CMD = CRYOTIMER_CMD_CLEAR;
+	CRYOTIMER_PeriodSet(period);
+	CRYOTIMER_IntClear(CRYOTIMER_IFC_PERIOD);
+	CRYOTIMER_IntEnable(CRYOTIMER_IEN_PERIOD);
+	EMU_EnterEM3(true);
+	// The time base restarts only once its low frequency oscillator is stable
+	uint32_t ready = (CMU->STATUS & CMU_STATUS_LFXOENS) ? CMU_STATUS_LFXORDY : CMU_STATUS_LFRCORDY;
+	while ((CMU->STATUS & ready) == 0) ;
+	uint32_t elapsed = CRYOTIMER_CounterGet();
+	CRYOTIMER_IntDisable(CRYOTIMER_IEN_PERIOD);
+	CRYOTIMER_IntClear(CRYOTIMER_IFC_PERIOD);
+	CRYOTIMER_PeriodSet(cryotimerPeriod_4096m);
+	NVIC_ClearPendingIRQ(CRYOTIMER_IRQn);
+	// Carry the fractional tick so that truncation does not add up over many short sleeps
+	uint64_t skipped = (uint64_t)elapsed * UlfrcoRate + SkipFraction;
+	SkipFraction = (uint32_t)skipped & 0xFFFF;
+	TimeBaseSkip((uint32_t)(skipped >> 16));
+	CalValid = false;	// Counter was cleared
+}
+
+/**
+ * \brief Put EFM32 processor in the deepest Low Power mode allowed by drivers and timer deadlines
  * @param expected 	Number of expected ticks to sleep sent by FreeRTOS
+ * \details The OS tick and MAC timers deadlines are both programmed in the time base compare
+ * channels, so expected is not used.
  */
 void vEFMEnergyEnter(portTickType expected) {
-    if (LowPowerDisabled) {
-    	EMU_EnterEM1();
-//		SCB->SCR &= ~SCB_SCR_SLEEPDEEP_Msk;
-    } else {
-    	EMU_EnterEM2(false);
-//		SCB->SCR |= SCB_SCR_SLEEPDEEP_Msk;
-	} 
+	(void)expected;
+	SystemIrqDisable();	// Pending IRQs still wake up the processor, they are handled on exit
+	if (!EnergyInitDone) vEFMEnergyInit();
+	uint32_t deadline = TimeBaseGetNextDeadline();
+	ENERGY_MODE mode = eEFMEnergySelectMode(eEFMEnergyGetLimit(), deadline);
+	uint64_t start = TimeBaseGetTicks64();
+	switch(mode) {
+	case EnergyModeEM3:
+		vEFMEnergyEnterEM3(deadline);
+		break;
+	case EnergyModeEM2:
+		EMU_EnterEM2(false);
+		vEFMEnergyCalibrate();
+		break;
+	default:
+		EMU_EnterEM1();
+		vEFMEnergyCalibrate();
+		break;
+	}
+	EnergyResidency.Entries[mode]++;
+	EnergyResidency.Ticks[mode] += TimeBaseGetTicks64() - start;
+	SystemIrqEnable();
  }
 /**
  * \brief Restore EFM32 processor from Low Power Mode
@@ -41,14 +167,44 @@ void vEFMEnergyRestore(portTickType expected) {
  * @param enable	true to allow deep sleep mode
  */
 void vEFMEnergyEnableLowPowerMode(int enable) {
+	SystemIrqDisable();
 	if (enable) {
 		if (LowPowerDisabled) LowPowerDisabled--;
-		if (LowPowerDisabled == 0) EMU_EM2UnBlock();
 	}
 	else {
 		LowPowerDisabled++;
-		EMU_EM2Block();
 	}
+	EnergyLimits[EnergyClientLegacy] = (LowPowerDisabled) ? EnergyModeEM1 : 0;
+	SystemIrqEnable();
+}
+
+void vEFMEnergyRequire(ENERGY_CLIENT client, ENERGY_MODE deepest) {
+	if (client < EnergyClients)
+		EnergyLimits[client] = (deepest >= EnergyModeEM3) ? 0 : deepest;
+}
+
+ENERGY_MODE eEFMEnergyGetLimit(void) {
+	ENERGY_MODE limit = EnergyModeEM3;
+	for (int i = 0; i < EnergyClients; i++) {
+		if (EnergyLimits[i] && (EnergyLimits[i] < limit)) limit = (ENERGY_MODE)EnergyLimits[i];
+	}
+	return limit;
+}
+
+ENERGY_MODE eEFMEnergySelectMode(ENERGY_MODE limit, uint32_t deadline) {
+	if ((limit >= EnergyModeEM3) && ((deadline == TIMEBASE_NO_DEADLINE)
+			|| (deadline >= TimeBaseMsToTicks(ENERGY_EM3_WAKEUP_MS + ENERGY_EM3_MIN_SLEEP_MS))))
+		return EnergyModeEM3;
+	if ((limit >= EnergyModeEM2) && (deadline >= ENERGY_EM2_WAKEUP_TICKS))
+		return EnergyModeEM2;
+	return EnergyModeEM1;
+}
+
+void vEFMEnergyGetResidency(ENERGY_RESIDENCY *residency) {
+	if (!residency) return;
+	SystemIrqDisable();
+	*residency = EnergyResidency;
+	SystemIrqEnable();
 }
 /**  }@
  */
@@ -78,6 +78,8 @@
 #include "task.h"
 #include "em_cmu.h"
 #include "em_rtcc.h"
+#include "timebase.h"
+#include "system.h"
 #include "EFMEnergy.h"
 
 
@@ -113,7 +115,8 @@ FreeRTOS.org versions prior to V4.3.0 did not include this definition. */
 	#define configKERNEL_INTERRUPT_PRIORITY 0
 #endif
 
-#define xPortSysTickHandler     RTCC_IRQHandler
+/* The tick is one of the time base compare channels, RTCC IRQ is dispatched by timebase.c */
+#define xPortSysTickHandler     TimeBaseOSTick_Handler
 
 /*
  * Setup the timer to generate the tick interrupts.  The implementation in this
@@ -201,13 +204,15 @@ static StackType_t uxTimerTaskStack[ configTIMER_TASK_STACK_DEPTH ];
  * The number of SysTick increments that make up one tick period.
  */
 
+#define ONE_TICK	( configSYSTICK_CLOCK_HZ / configTICK_RATE_HZ )
 #if configUSE_TICKLESS_IDLE == 1
-	#define ONE_TICK	( configSYSTICK_CLOCK_HZ / configTICK_RATE_HZ )
-	#define xMaximumPossibleSuppressedTicks ((0xffffffffUL / ONE_TICK) - 1)
-	#define GET_TICK_CNT()			((RTCC_CounterGet() + 1) / ONE_TICK)
-	#define SET_TICK_COMP0(n)		RTCC_ChannelCCVSet(1,(n)-1); /* Remove 1 to COMP0 since RTC->CNT starts from 0 */
-	#define GET_TICK_COMP0()		(RTCC_ChannelCCVGet(1) + 1)
+	/* Time base counter is free running, compare values are only valid up to half its range */
+	#define xMaximumPossibleSuppressedTicks ((0x7fffffffUL / ONE_TICK) - 1)
 #endif /* configUSE_TICKLESS_IDLE */
+/* The time base counter is shared and never reset: ticks are tracked as absolute counter values */
+static volatile uint32_t ulTickBase;		/* Counter value of the last tick */
+static volatile uint32_t ulTickTarget;		/* Counter value of the next tick IRQ */
+static uint32_t ulTickNotified;				/* Counter value of the last INTRTC_IRQHandler call */
 
 	/* This exists purely to allow the const to be used from within the
 	port_asm.asm assembly file. */
@@ -225,10 +230,14 @@ __attribute__((weak))  void INTRTC_IRQHandler(unsigned long n) {
 #if configUSE_TICKLESS_IDLE == 1
 static volatile int bSysTickIRQDone;	/* Marker to show whether the RTC Irq was already fired */
 #endif
-__attribute__((interrupt)) void xPortSysTickHandler( void )
+void xPortSysTickHandler( void )
 {
-	INTRTC_IRQHandler((unsigned long)GET_TICK_COMP0());	/* Call external RTC to update real time clock information */
-	RTCC->IFC = _RTCC_IFC_MASK; //RTCC_IFC_CC1;
+	INTRTC_IRQHandler((unsigned long)(ulTickTarget - ulTickNotified));	/* Call external RTC to update real time clock information */
+	ulTickNotified = ulTickTarget;
+	/* Next tick period starts from the reached compare value, whatever the IRQ latency */
+	ulTickBase = ulTickTarget;
+	ulTickTarget = ulTickBase + ONE_TICK;
+	TimeBaseSetCompare(TimeBaseOSChannel, ulTickTarget);
 	if (xTaskGetSchedulerState()!=taskSCHEDULER_NOT_STARTED) {
 
 		/* If using preemption, also force a context switch. */
@@ -236,15 +245,9 @@ __attribute__((interrupt)) void xPortSysTickHandler( void )
 			portNVIC_INT_CTRL_REG = portNVIC_PENDSVSET_BIT;
 		#endif
 
-		/* Only reset the systick load register if configUSE_TICKLESS_IDLE is set to
-		1.  If it is set to 0 tickless idle is not being used.  If it is set to a
-		value other than 0 or 1 then a timer other than the SysTick is being used
-		to generate the tick interrupt. */
 		#if configUSE_TICKLESS_IDLE == 1
-			if (GET_TICK_COMP0() != ONE_TICK)
-				SET_TICK_COMP0(ONE_TICK);
-		#endif
 		bSysTickIRQDone = 1;            /* Set RTC Irq fired Marker */
+		#endif
 		( void ) portSET_INTERRUPT_MASK_FROM_ISR();
 		{
 			xTaskIncrementTick();
@@ -257,25 +260,24 @@ __attribute__((interrupt)) void xPortSysTickHandler( void )
 	void vPortSuppressTicksAndSleep( portTickType xExpectedIdleTime )
 	{
 #if configUSE_TICKLESS_IDLE == 1
-	unsigned long ulCompleteTickPeriods, ElapsedTicks;
+	unsigned long ulCompleteTickPeriods;
 		/* If a context switch is pending then abandon the low power entry as
 		the context switch might have been pended by an external interrupt that
 		requires processing. */
 		if( ( portNVIC_INT_CTRL_REG & portNVIC_PENDSVSET_BIT ) != 0 ) return;
 		bSysTickIRQDone = 0;            /* Reset RTC Irq Marker*/
-		/* Calculate elapsed ticks so far */
-		ElapsedTicks = GET_TICK_CNT();
 
-        /* Make sure the SysTick reload value does not overflow the counter. */
-		if( xExpectedIdleTime > (xMaximumPossibleSuppressedTicks - ElapsedTicks))
+        /* Make sure the compare value stays within the counter comparable range. */
+		if( xExpectedIdleTime > xMaximumPossibleSuppressedTicks )
 		{
-			xExpectedIdleTime = (xMaximumPossibleSuppressedTicks - ElapsedTicks);
+			xExpectedIdleTime = xMaximumPossibleSuppressedTicks;
 		}
 		if (xExpectedIdleTime < 5) return; 	/* Don't do all this for so short time */
 		if (bSysTickIRQDone) return;		/* Tick Irq occurred in the meantime, just abort */
-		/* Calculate the reload value required to wait xExpectedIdleTime
-		tick periods. Add elapsed Ticks as RTC value cannot be reset on Gecko */
-		SET_TICK_COMP0( ONE_TICK * ( ElapsedTicks + xExpectedIdleTime /*- 1UL*/));
+		/* Move the tick compare value xExpectedIdleTime tick periods after the last tick.
+		The counter itself is never touched as it is shared with the MAC timers */
+		ulTickTarget = ulTickBase + (ONE_TICK * xExpectedIdleTime);
+		TimeBaseSetCompare(TimeBaseOSChannel, ulTickTarget);
 
 		vTaskSuspendAll();	// Prevent task schedule from running until we're back
 		/* Sleep until something happens. */
@@ -283,7 +285,8 @@ __attribute__((interrupt)) void xPortSysTickHandler( void )
 //		if( xExpectedIdleTime > 0 ) __WFI();
 		configPOST_SLEEP_PROCESSING( xExpectedIdleTime );
 
-		if ( bSysTickIRQDone) /* Test RTC Irq Marker */
+		SystemIrqDisable();
+		if ( bSysTickIRQDone || TimeBaseIsPending(TimeBaseOSChannel)) /* Test RTC Irq Marker */
 		{
 				/* The tick interrupt handler will already have pended the tick
 				processing in the kernel.  As the pending tick will be
@@ -295,18 +298,15 @@ __attribute__((interrupt)) void xPortSysTickHandler( void )
 		else
 		{
 				/* Something other than the tick interrupt ended the sleep.
-				Work out how long the sleep lasted. = RTC since it's an upward counter */
-				/* How many complete tick periods passed while the processor
+				How many complete tick periods passed while the processor
 				was waiting? */
-				ulCompleteTickPeriods = GET_TICK_CNT();
-
-				/* The reload value is set to whatever fraction of a single tick
-				period remains. Plus the current value of RTC as we cannot reset the CNT register on Gecko */
-				/* Unless the tick IRQ already occurred */
-				if (!bSysTickIRQDone)
-					SET_TICK_COMP0( ( ulCompleteTickPeriods + 1 ) * ONE_TICK );
-				ulCompleteTickPeriods -= ElapsedTicks;
+				ulCompleteTickPeriods = (TimeBaseGetTicks() - ulTickBase) / ONE_TICK;
+				/* The next tick IRQ occurs at the end of the current tick period */
+				ulTickBase += ulCompleteTickPeriods * ONE_TICK;
+				ulTickTarget = ulTickBase + ONE_TICK;
+				TimeBaseSetCompare(TimeBaseOSChannel, ulTickTarget);
 		}
+		SystemIrqEnable();
 
 		vTaskStepTick(ulCompleteTickPeriods);
 		xTaskResumeAll();	// Restore Scheduler
@@ -317,30 +317,15 @@ __attribute__((interrupt)) void xPortSysTickHandler( void )
 /*-----------------------------------------------------------*/
 
 /*
- * Setup the systick timer to generate the tick interrupts at the required
+ * Setup the time base compare channel to generate the tick interrupts at the required
  * frequency.
  */
 void vPortSetupTimerInterrupt( void )
 {
-	CMU_ClockSelectSet(cmuClock_HFLE,(CMU->STATUS & CMU_STATUS_LFXORDY) ? cmuSelect_LFXO : cmuSelect_LFRCO);
-	CMU_ClockEnable(cmuClock_HFLE,true);
-	CMU_ClockSelectSet(cmuClock_RTCC,(CMU->STATUS & CMU_STATUS_LFXORDY) ? cmuSelect_LFXO : cmuSelect_LFRCO);
-	CMU_ClockEnable(cmuClock_LFE, true);	// Use LF for RTCC
-	CMU_ClockEnable(cmuClock_RTCC, true);	// Start RTCC
-	RTCC_Reset();
-	RTCC_CCChConf_TypeDef RtccChannelInit = RTCC_CH_INIT_COMPARE_DEFAULT;
-	RTCC_ChannelInit(1,&RtccChannelInit);
-	NVIC_ClearPendingIRQ(RTCC_IRQn);
-	NVIC_SetPriority (RTCC_IRQn, 1); 	/* Make sure to set priority lowest system priority */
-	/* Enable interrupt*/
-	RTCC_IntEnable(RTCC_IEN_CC1);
-	NVIC_EnableIRQ(RTCC_IRQn);
-    SET_TICK_COMP0(ONE_TICK);
-	RTCC_Init_TypeDef RtccInit = RTCC_INIT_DEFAULT;
-//	RtccInit.presc = rtccCntPresc_8;	// Any prescaler would fail => processor bug
-	RtccInit.presc = rtccCntPresc_1;
-	RtccInit.cntWrapOnCCV1 = true;
-	RTCC_Init(&RtccInit);
+	TimeBaseInit();		/* Keep counter running if already started by the MAC timers */
+	ulTickBase = ulTickNotified = TimeBaseGetTicks();
+	ulTickTarget = ulTickBase + ONE_TICK;
+	TimeBaseSetCompare(TimeBaseOSChannel, ulTickTarget);
 }
 /*-----------------------------------------------------------*/
 /**  }@
@@ -12,6 +12,9 @@
 #include <em_cmu.h>
 #include <em_adc.h>
 #include <em_acmp.h>
+#ifdef LDMA_PRESENT
+#include <em_ldma.h>
+#endif
 
 #ifdef ADC_PRESENT
 static const ADC_Init_TypeDef ADCInit = ADC_INIT_DEFAULT;
@@ -79,6 +82,9 @@ __weak void INTADCTrigger_Handler(int ADCNum, ADC_TRIGGER_OUTPUT level) {
 	(void)ADCNum;
 	(void)level;
 }
+__weak void INTADCCapture_Handler(int ADCNum) {
+	(void)ADCNum;
+}
 #ifdef ADC_PRESENT
 static ADC_TypeDef* _GetADC(int ADCNum) {
 #if ADC_COUNT > 0
@@ -219,6 +225,19 @@ int ADCGetFullScale(int ADCNum) {	// Returns ADC maximum value
 	return 0;
 }
 
+int ADCGetOversampledFullScale(int ADCNum) {	// Returns ADC maximum value, any oversampling ratio
+	(void)ADCNum;
+#if ADC_COUNT > 0
+	ADC_TypeDef* adc = _GetADC(ADCNum);
+	if (adc && ((adc->SINGLECTRL & _ADC_SINGLECTRL_RES_MASK) == ADC_SINGLECTRL_RES_OVS)) {
+		// 12 bits plus one bit per doubling up to 16 bits, the conversion result is 16 bits wide
+		uint32_t ratio = (adc->CTRL & _ADC_CTRL_OVSRSEL_MASK) >> _ADC_CTRL_OVSRSEL_SHIFT;
+		return (0x01 << ((ratio < 4) ? (13 + ratio) : 16)) - 1;
+	}
+#endif
+	return ADCGetFullScale(ADCNum);
+}
+
 void ADCSetSamplingTime(int ADCNum, int duration)
 {
 #if ADC_COUNT > 0
@@ -292,6 +311,92 @@ ADC_TypeDef* adc = _GetADC(ADCNum);
 #endif
 }
 
+/*
+ * DMA capture of oversampled conversions
+ */
+#if defined(LDMA_PRESENT) && (ADC_COUNT > 0)
+/** @cond */
+#ifndef ADC_LDMA_CHANNEL
+#define ADC_LDMA_CHANNEL	0		//!< LDMA channel used for ADC captures
+#endif
+static volatile int _captureADC = -1;
+static LDMA_Descriptor_t _captureDesc;
+/** @endcond */
+
+//! @brief Define EXCLUDE_DEFAULT_LDMA_IRQ_HANDLER to use user defined LDMA IRQ handler instead
+#ifndef EXCLUDE_DEFAULT_LDMA_IRQ_HANDLER
+__interrupt_handler __attribute__((used)) void LDMA_IRQHandler(void) {
+	uint32_t pending = LDMA_IntGetEnabled();
+	LDMA_IntClear(pending);
+	if ((pending & ((0x01UL << ADC_LDMA_CHANNEL) | LDMA_IF_ERROR)) && (_captureADC >= 0)) {
+		int ADCNum = _captureADC;
+		_GetADC(ADCNum)->CMD = ADC_CMD_SINGLESTOP;
+		_captureADC = -1;
+		INTADCCapture_Handler(ADCNum);
+	}
+}
+#endif
+#endif
+
+BOOL ADCCaptureStart(int ADCNum, ADC_OVERSAMPLE ratio, short* buffer, int count) {
+#if defined(LDMA_PRESENT) && (ADC_COUNT > 0)
+	ADC_TypeDef* adc = _GetADC(ADCNum);
+	if (!adc || !buffer || (count <= 0) || (count > 2048) || (_captureADC >= 0)) return false;
+	// Hardware averaging: each result is the mean of 2^ratio samples
+	adc->CTRL = (adc->CTRL & ~_ADC_CTRL_OVSRSEL_MASK)
+			| (((ratio > ADCOversampleNone) ? (ratio - 1) : 0) << _ADC_CTRL_OVSRSEL_SHIFT);
+	adc->SINGLECTRL = (adc->SINGLECTRL & ~_ADC_SINGLECTRL_RES_MASK)
+			| ((ratio > ADCOversampleNone) ? ADC_SINGLECTRL_RES_OVS : ADC_SINGLECTRL_RES_12BIT)
+			| ADC_SINGLECTRL_REP;
+	adc->SINGLEFIFOCLEAR = ADC_SINGLEFIFOCLEAR_SINGLEFIFOCLEAR;
+	CMU_ClockEnable(cmuClock_LDMA, true);
+	if (!(LDMA->CTRL & _LDMA_CTRL_NUMFIXED_MASK) && !(LDMA->CHEN)) {
+		LDMA_Init_t init = LDMA_INIT_DEFAULT;
+		LDMA_Init(&init);
+	}
+	SystemIRQEnable(LDMA_IRQn);	// Set Priority for FreeRTOS
+	LDMA_TransferCfg_t cfg = LDMA_TRANSFER_CFG_PERIPHERAL(ldmaPeripheralSignal_ADC0_SINGLE);
+	_captureDesc = (LDMA_Descriptor_t)LDMA_DESCRIPTOR_SINGLE_P2M_BYTE(&adc->SINGLEDATA, buffer, count);
+	_captureDesc.xfer.size = ldmaCtrlSizeHalf;	// Results are up to 16 bits
+	_captureADC = ADCNum;
+	LDMA_StartTransfer(ADC_LDMA_CHANNEL, &cfg, &_captureDesc);
+	ADC_Start(adc, adcStartSingle);
+	return true;
+#else
+	(void)ADCNum;
+	(void)ratio;
+	(void)buffer;
+	(void)count;
+	return false;
+#endif
+}
+
+BOOL ADCCaptureIsDone(int ADCNum) {
+#if defined(LDMA_PRESENT) && (ADC_COUNT > 0)
+	return (_captureADC != ADCNum) || LDMA_TransferDone(ADC_LDMA_CHANNEL);
+#else
+	(void)ADCNum;
+	return true;
+#endif
+}
+
+void ADCCaptureStop(int ADCNum) {
+#if defined(LDMA_PRESENT) && (ADC_COUNT > 0)
+	ADC_TypeDef* adc = _GetADC(ADCNum);
+	if (adc) {
+		if (_captureADC == ADCNum) {
+			LDMA_StopTransfer(ADC_LDMA_CHANNEL);
+			_captureADC = -1;
+		}
+		adc->CMD = ADC_CMD_SINGLESTOP;
+		adc->SINGLECTRL = (adc->SINGLECTRL & ~(_ADC_SINGLECTRL_RES_MASK | _ADC_SINGLECTRL_REP_MASK)) | ADC_SINGLECTRL_RES_12BIT;
+		adc->CTRL &= ~_ADC_CTRL_OVSRSEL_MASK;
+	}
+#else
+	(void)ADCNum;
+#endif
+}
+
 #if ACMP_COUNT > 0
 static ACMP_TypeDef *GetACMP(int ADCNum) {
 	if (ADCNum == 0) return ACMP0;
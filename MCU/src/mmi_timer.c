@@ -4,77 +4,149 @@
  */
 
 #include "mmi_timer.h"
+#include "timebase.h"
 #include <em_cmu.h>
-#include <em_letimer.h>
+#include <em_timer.h>
+#include <em_prs.h>
+#include <em_gpio.h>
 /** \addtogroup MMI MyMeterInfo add-on functions
  *  @{
  */
 
-static const LETIMER_Init_TypeDef  LETIMER_INIT =
-{
-  false,               /* Enable timer when init complete. */
-  false,               /* Stop counter during debug halt. */
-  false,               /* Do not load COMP0 into CNT on underflow. */
-  false,               /* Do not load COMP1 into COMP0 when REP0 reaches 0. */
-  0,                   /* Idle value 0 for output 0. */
-  0,                   /* Idle value 0 for output 1. */
-  letimerUFOANone,     /* No action on underflow on output 0. */
-  letimerUFOANone,     /* No action on underflow on output 1. */
-  letimerRepeatOneshot /* Count once and stop. */
-};
-
 /*!
- * @brief System Low Energy Timer 0 IRQ handler
+ * @brief Time base timer compare channel IRQ handler
  */
-__attribute__((interrupt)) __attribute__((used)) void LETIMER0_IRQHandler(void) {
-	LETIMER0->IFC = _LETIMER_IFC_MASK;
+void TimeBaseTimer_Handler(void) {
 	TimerIrqHandler();
 }
 
 __weak void TimerIrqHandler(void) { }
 
 void TIMERInit(void) {
-	// Initialize LETIMER
-    CMU_ClockEnable(cmuClock_HFLE,true);
-    CMU_ClockEnable(cmuClock_LETIMER0, true);
-    CMU_ClockDivSet(cmuClock_LETIMER0,cmuClkDiv_32); // 32 / 32768 = 1 / 1024 = 0.976 ms period
-    LETIMER_IntClear(LETIMER0,_LETIMER_IFC_MASK);
-    SystemIRQEnable(LETIMER0_IRQn);
-    LETIMER_IntEnable(LETIMER0,LETIMER_IEN_REP0);
-    LETIMER_Init(LETIMER0,&LETIMER_INIT);
+	// Timer shares the free running RTCC counter with the OS tick
+	TimeBaseInit();
 }
 
 void TIMERStart(int duration) {
-	// As letimer.c has a bug that ignores register sync
-	// we use our own implementation.
-	// Make sure we can write in the CMD register
-	while(LETIMER0->SYNCBUSY & LETIMER_SYNCBUSY_CMD) __nop();
-	LETIMER0->CMD = LETIMER_CMD_STOP | LETIMER_CMD_CLEAR;
-	// Make sure STOP CMD has been processed before changing any other register
-	while(LETIMER0->SYNCBUSY & LETIMER_SYNCBUSY_CMD) __nop();
-	// Cancel any pending IRQ
-    LETIMER0->IFC = _LETIMER_IFC_MASK;
-    // Compute duration in hardware timer increments
-	duration = ((duration * 1024) / 1000);
-	if (duration > 1) duration--; // Remove one as we decrement down to 0
-	// Store computed duration
-	// CNT is a 16 bits counter
-	LETIMER0->CNT = (duration & 0xFFFF) ? (duration & 0xFFFF) : 1;
-	// REP0 is an 8 bits counter
-	duration >>= 16;
-	duration &= 0x0FF;
-	// Check for rollover
-	if (duration == 0xFF) duration--;
-	LETIMER0->REP0 = (duration) ? (1 + duration) : 1;
-	LETIMER0->CMD = LETIMER_CMD_START;		// Start timer
+	// Compare value is computed in 1/32768 s from the current counter value
+	TimeBaseSetCompare(TimeBaseTimerChannel, TimeBaseGetTicks() + TimeBaseMsToTicks((uint32_t)duration));
 }
 
 void TIMERStop(void) {
-	// As letimer.c has a bug that ignores register sync
-	// we use our own implementation.
-	// Make sure we can write in the CMD register
-	while(LETIMER0->SYNCBUSY & LETIMER_SYNCBUSY_CMD) __nop();
-	LETIMER0->CMD = LETIMER_CMD_STOP;
+	TimeBaseStopCompare(TimeBaseTimerChannel);
+}
+
+/*
+ * Edge capture using TIMER0 CC0 input capture.
+ * The input port is routed to the timer through a PRS channel.
+ */
+/** @cond */
+#ifndef CAPTURE_PRS_CHANNEL
+#define CAPTURE_PRS_CHANNEL		0		//!< PRS channel used to route the captured input
+#endif
+static unsigned short* _captureBuffer = NULL;
+static volatile int _captureCount = 0;
+static int _captureSize = 0;
+static uint32_t _captureGap = 0;			// Idle time starting a frame (in timer ticks), 0 if none
+static BOOL _captureSynced = false;			// A frame start was found
+static uint32_t _captureWraps = 0;			// Counter overflows since the last edge
+static unsigned short _captureLast = 0;		// Last edge time stamp
+/** @endcond */
+
+__weak void INTTimerCapture_Handler(int count) { (void)count; }
+
+//! @brief Define EXCLUDE_DEFAULT_TIMER0_IRQ_HANDLER to use user defined TIMER0 IRQ handler instead
+#ifndef EXCLUDE_DEFAULT_TIMER0_IRQ_HANDLER
+/*!
+ * @brief Timer 0 IRQ handler, stores captured edges time stamps
+ */
+__attribute__((interrupt)) __attribute__((used)) void TIMER0_IRQHandler(void) {
+	uint32_t flags = TIMER_IntGetEnabled(TIMER0);
+	BOOL overflow = (flags & TIMER_IF_OF) != 0;
+	TIMER_IntClear(TIMER0, flags);
+	// Empty hardware capture buffer
+	while (TIMER0->STATUS & TIMER_STATUS_ICV0) {
+		unsigned short value = (unsigned short)TIMER_CaptureGet(TIMER0, 0);
+		if (overflow && (value < 0x8000)) {
+			// The overflow flagged with this edge happened before it
+			_captureWraps++;
+			overflow = false;
+		}
+		if (_captureGap) {
+			// An edge after a long enough idle time starts a new frame
+			if ((_captureWraps > 0xFFFF) || ((((uint32_t)_captureWraps << 16) + value - _captureLast) >= _captureGap)) {
+				_captureCount = 0;
+				_captureSynced = true;
+			}
+			_captureWraps = 0;
+			_captureLast = value;
+		}
+		if (_captureCount < _captureSize) _captureBuffer[_captureCount++] = value;
+		if (!_captureSynced && (_captureCount >= _captureSize)) _captureCount = 0;	// Started inside a frame
+	}
+	if (overflow) _captureWraps++;
+	if (_captureBuffer && _captureSynced && (_captureCount >= _captureSize)) {
+		TIMER_IntDisable(TIMER0, TIMER_IEN_CC0 | TIMER_IEN_ICBOF0 | TIMER_IEN_OF);
+		TIMER0->CMD = TIMER_CMD_STOP;
+		INTTimerCapture_Handler(_captureCount);
+	}
+}
+#endif
+
+BOOL TIMERCaptureStart(const SystemPort port, unsigned short* buffer, int count, unsigned long gap) {
+	if (!buffer || (count <= 0) || !IS_SYSTEMPORT_VALID(port)) return false;
+	_captureBuffer = buffer;
+	_captureSize = count;
+	_captureCount = 0;
+	_captureSynced = (gap == 0);
+	_captureWraps = 0;
+	_captureLast = 0;				// The counter starts from 0, the idle time is counted from now
+	// Route input port to PRS channel through its external interrupt line (IRQ disabled)
+	SystemDefinePortIrq(port, GPIOIRQNone);
+	CMU_ClockEnable(cmuClock_PRS, true);
+	PRS_SourceAsyncSignalSet(CAPTURE_PRS_CHANNEL,
+			(port.pin < 8) ? PRS_CH_CTRL_SOURCESEL_GPIOL : PRS_CH_CTRL_SOURCESEL_GPIOH,
+			(port.pin & 0x07) << _PRS_CH_CTRL_SIGSEL_SHIFT);
+	// Capture both edges from PRS channel
+	CMU_ClockEnable(cmuClock_TIMER0, true);
+	TIMER_InitCC_TypeDef cc = TIMER_INITCC_DEFAULT;
+	cc.mode = timerCCModeCapture;
+	cc.edge = timerEdgeBoth;
+	cc.prsSel = (TIMER_PRSSEL_TypeDef)CAPTURE_PRS_CHANNEL;
+	cc.prsInput = true;
+	cc.filter = true;
+	TIMER_InitCC(TIMER0, 0, &cc);
+	TIMER_Init_TypeDef init = TIMER_INIT_DEFAULT;
+	init.enable = false;
+	TIMER_Init(TIMER0, &init);
+	// Overflows are only counted to measure the idle time between edges
+	_captureGap = (gap) ? (uint32_t)(((uint64_t)CMU_ClockFreqGet(cmuClock_TIMER0) * gap) / 1000000UL) : 0;
+	TIMER_IntClear(TIMER0, _TIMER_IFC_MASK);
+	TIMER_IntEnable(TIMER0, TIMER_IEN_CC0 | TIMER_IEN_ICBOF0 | ((gap) ? TIMER_IEN_OF : 0));
+	SystemIRQEnable(TIMER0_IRQn);	// Set Priority for FreeRTOS
+	TIMER_Enable(TIMER0, true);
+	return true;
+}
+
+BOOL TIMERCaptureIsDone(void) {
+	return (_captureSynced && (_captureCount >= _captureSize));
+}
+
+int TIMERCaptureStop(void) {
+	TIMER_IntDisable(TIMER0, _TIMER_IEN_MASK);
+	TIMER0->CMD = TIMER_CMD_STOP;
+	NVIC_DisableIRQ(TIMER0_IRQn);
+	TIMER_Reset(TIMER0);
+	CMU_ClockEnable(cmuClock_TIMER0, false);
+	PRS->CH[CAPTURE_PRS_CHANNEL].CTRL = 0;
+	_captureBuffer = NULL;
+	_captureSize = 0;
+	_captureGap = 0;
+	return _captureCount;
+}
+
+unsigned long TIMERCaptureGetFrequency(void) {
+	return CMU_ClockFreqGet(cmuClock_TIMER0);
 }
 
 /** }@ */
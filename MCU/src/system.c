@@ -6,6 +6,7 @@
 
 #include "system.h"
 #include "mmi_adc.h"
+#include "timebase.h"
 #include <stdio.h>
 #include <em_device.h>
 #include <em_rtc.h>
@@ -15,7 +16,6 @@
 #include <em_gpio.h>
 #include <em_rmu.h>
 #include <em_rtcc.h>
-#include <em_cryotimer.h>
 #ifdef WDOG_PRESENT
 #include <em_wdog.h>
 #endif
@@ -74,107 +74,26 @@ __weak void SystemIrqEnable(void) {
 /*******************************************************************
 **                        RTC functions                           **
 *******************************************************************/
-/** @cond */
-#define RTC_POWEROF2 (15 - ((RTCC->CTRL & _RTCC_CTRL_CNTPRESC_MASK) >> _RTCC_CTRL_CNTPRESC_SHIFT))
-#define RTC_INCREMENT (0x0001UL << RTC_POWEROF2)
-static volatile unsigned long system_seconds = 0UL;
-static volatile unsigned long _micro_seconds = 0UL;
-/** @endcond */
-
-void INTRTC_IRQHandler(unsigned long n)
-{
-	if (n) {
-		int PowerOf2 = RTC_POWEROF2;
-		unsigned long _RTC_increment = (0x0001UL << PowerOf2)-1;
-		// Each n is  (1/(_RTC_increment+1))th of second
-		system_seconds += n >> PowerOf2;						// Division by _RTC_Increment+1
-		n &= _RTC_increment;									// Reminder = milliseconds
-		if (n) {
-			n *= 1000;											// plain milliseconds
-			if (n > _RTC_increment) {
-				_micro_seconds += (n >> PowerOf2) * 1000;		// milliseconds in microseconds
-				n &= _RTC_increment;							// reminder = microseconds
-			}
-			if (n) _micro_seconds += (n * 1000) >> PowerOf2;	// plain microseconds
-			if (_micro_seconds > 1000000) {						// Accumulated seconds in microseconds ?
-				// Now update seconds out of accumulated microseconds
-				system_seconds += (_micro_seconds / 1000000);
-				// Now keep only milli & microseconds
-				_micro_seconds %= 1000000;
-			}
-		}
-	}
-	// From here elapsed time is system_seconds._micro_seconds
-}
-//! @brief Define this macro to use user defined RTC IRQ handler
-#ifndef EXCLUDE_DEFAULT_RTC_IRQ_HANDLER
-__interrupt_handler void RTCC_IRQHandler() { INTRTC_IRQHandler(RTCC->CC[0].CCV +1); RTCC->IFC = RTCC_IFC_CNTTICK; }
-#endif
+// All system times are derived from the RTCC time base shared with the OS tick and MAC timers
 
 void SystemSetDefaultRTC(BOOL enable_irq) {
-	if ((RTCC->CTRL & RTCC_CTRL_ENABLE) == 0) {
-		// If RTC is not setup yet, just do it.
-		CMU_ClockSelectSet(cmuClock_HFLE,(CMU->STATUS & CMU_STATUS_LFXORDY) ? cmuSelect_LFXO : cmuSelect_LFRCO);
-		CMU_ClockEnable(cmuClock_HFLE,true);
-		CMU_ClockEnable(cmuClock_RTCC, true);	// Start RTCC
-		RTCC_CCChConf_TypeDef RtccChannelInit = RTCC_CH_INIT_COMPARE_DEFAULT;
-		RTCC_ChannelInit(0,&RtccChannelInit);
-	    // About 1 ms per increment in cnt
-		RTCC_ChannelCCVSet(0,32);
-		if (enable_irq)
-			RTCC_IntEnable(RTCC_IEN_CNTTICK);
-		RTCC_Init_TypeDef RtccInit = RTCC_INIT_DEFAULT;
-	//	RtccInit.presc = rtccCntPresc_8;	// Any prescaler would fail => processor bug
-		RtccInit.presc = rtccCntPresc_1;
-		RtccInit.precntWrapOnCCV0 = true;
-		/* Start Counter */
-		RTCC_Init(&RtccInit);
-	}
-  if (enable_irq)
-	  SystemIRQEnable(RTCC_IRQn);
+	(void)enable_irq;	// Time base IRQ is always enabled to track counter roll over
+	TimeBaseInit();
 }
 
 __inline__ unsigned long SystemGetMicroSeconds(void) {
-	return (_micro_seconds % 1000);
+	return (unsigned long)(TimeBaseGetUs() % 1000);
 }
 
 unsigned long SystemGetSystemTicks()
 {
-#if CRYOTIMER_COUNT > 0
-	// Use free run CRYOTIMER if exists
-	if (CRYOTIMER->CTRL & CRYOTIMER_CTRL_EN) {
-		// Get instantaneous CRYOTIMER value
-		register uint32_t timer = CRYOTIMER_CounterGet();
-		// Compute the number of full seconds in milliseconds
-		register uint32_t value = (timer / 1024) * 1000;
-		// Add remaining milliseconds
-		return value + (((timer % 1024) * 1000) / 1024);
-	}
-	else
-#endif
-	// Use RTCC instead
-	if (RTCC->IEN) {
-		// This is linked to RTCC IRQ usage, so might be out of sync
-		// (FreeRTOS Low Power mode for instance).
-		SystemIrqDisable();
-		unsigned long t = (system_seconds * 1000) + (_micro_seconds / 1000);
-		SystemIrqEnable();
-		return t;
-	}
-	else {
-		// RTCC is used as free run 32.768kHz / 1024
-		// Get instantaneous RTCC value
-		register uint32_t timer = RTCC_CounterGet();
-		// Compute the number of full seconds in milliseconds
-		register uint32_t value = (timer / 1024) * 1000;
-		// Add remaining milliseconds
-		return value + (((timer % 1024) * 1000) / 1024);
-	}
+	// Free run time base, not stopped during low power mode
+	return TimeBaseGetMs();
 }
 
 __inline__ unsigned long SystemGetSystemSeconds()
 {
-  return system_seconds;
+  return (unsigned long)(TimeBaseGetTicks64() >> TIMEBASE_SHIFT);
 }
 
 /*******************************************************************
@@ -344,20 +263,6 @@ BOOL SystemInitHardware(CLOCK_SPEED speed, BOOL useLFXO) {
 	CMU->LFBCLKSEL |= (CMU->STATUS & CMU_STATUS_LFXORDY) ? CMU_LFBCLKSEL_LFB_LFXO : CMU_LFBCLKSEL_LFB_LFRCO;
 	CMU->LFECLKSEL &= ~(_CMU_LFECLKSEL_LFE_MASK);
 	CMU->LFECLKSEL |= (CMU->STATUS & CMU_STATUS_LFXORDY) ? CMU_LFECLKSEL_LFE_LFXO : CMU_LFECLKSEL_LFE_LFRCO;
-	// Enable clock for CRYOTIMER
-	CMU_ClockEnable(cmuClock_CRYOTIMER, false);	// Reset CRYOTIMER
-	CMU_ClockEnable(cmuClock_CRYOTIMER, true);
-	CRYOTIMER_Init_TypeDef CRYOTIMER_INIT =
-	{
-	  true,                 /* Start counting when init done.                    */
-	  false,                /* Disable CRYOTIMER during debug halt.              */
-	  false,                /* Disable EM4 wakeup.                               */
-	  cryotimerOscLFXO,     /* Select Low Frequency RC Oscillator.               */
-	  cryotimerPresc_32,    /* LF Oscillator frequency divided by 32.            */
-	  cryotimerPeriod_4096m, /* Wakeup event after 4096M pre-scaled clock cycles. */
-	};
-	CRYOTIMER_INIT.osc = (CMU->STATUS & CMU_STATUS_LFXORDY) ?  cryotimerOscLFXO : cryotimerOscLFRCO;
-	CRYOTIMER_Init(&CRYOTIMER_INIT);	// Perpetual free run timer
 	return true;
 }
 
@@ -433,6 +338,24 @@ unsigned long SystemBatteryGetVoltage(void) {
 	return value;
 }
 
+/*******************************************************************
+**                  Temperature functions                         **
+*******************************************************************/
+/** @cond */
+#define TEMP_GRADIENT_UV	1840	// Temperature sensor gradient in uV/°C
+/** @endcond */
+short SystemGetTemperature(void) {
+	long calTemp = (DEVINFO->CAL & _DEVINFO_CAL_TEMP_MASK) >> _DEVINFO_CAL_TEMP_SHIFT;
+	long calValue = (DEVINFO->ADC0CAL3 & _DEVINFO_ADC0CAL3_TEMPREAD1V25_MASK) >> _DEVINFO_ADC0CAL3_TEMPREAD1V25_SHIFT;
+
+	ADCOpen(0,0,ADCChannelTemp,ADCLowReference,ADCSamplingTime8,15);
+	long value = (long)ADCConvertOnce(0);
+	ADCClose(0,ADCChannelTemp);
+	// Calibration read with 1.25 V reference, measure with 2.5 V reference (1 LSB = 2500000/4096 uV)
+	// Sensor voltage decreases when temperature increases
+	return (short)(calTemp * 10 + (long)((((long long)calValue * 1250000LL - (long long)value * 2500000LL) * 10LL) / (4096LL * TEMP_GRADIENT_UV)));
+}
+
 /*******************************************************************
 **                  CPU Clock functions                           **
 *******************************************************************/
@@ -0,0 +1,140 @@
+/*******************************************************************
+**                                                                **
+** Unified low frequency time base using RTCC                     **
+**                                                                **
+*******************************************************************/
+
+#include "timebase.h"
+#include "system.h"
+#include <em_cmu.h>
+#include <em_rtcc.h>
+#include <em_rmu.h>
+/** \addtogroup MMI MyMeterInfo add-on functions
+ *  @{
+ */
+
+/** @cond */
+#define TIMEBASE_IF(channel)	(RTCC_IF_CC0 << (channel))
+static volatile uint32_t _overflows = 0;
+static volatile uint64_t _skipped = 0;	// Ticks elapsed while the counter was stopped
+static bool _initialized = false;		// Set up since the last reset
+/** @endcond */
+
+__weak void TimeBaseOSTick_Handler(void) { }
+__weak void TimeBaseTimer_Handler(void) { }
+
+/*!
+ * @brief RTCC IRQ handler, dispatches compare channels to their owner
+ */
+__interrupt_handler __attribute__((used)) void RTCC_IRQHandler(void) {
+	uint32_t flags = RTCC_IntGetEnabled();
+	RTCC_IntClear(flags);
+	if (flags & RTCC_IF_OF) _overflows++;
+	if (flags & TIMEBASE_IF(TimeBaseTimerChannel)) TimeBaseTimer_Handler();
+	if (flags & TIMEBASE_IF(TimeBaseOSChannel)) TimeBaseOSTick_Handler();
+}
+
+void TimeBaseInit(void) {
+	if (_initialized) return;
+	_initialized = true;
+	// Limited resets keep the RTCC counter and retention registers (warm start), only a power-on clears them
+	RMU_ResetControl(rmuResetWdog, rmuResetModeLimited);
+	RMU_ResetControl(rmuResetCoreLockup, rmuResetModeLimited);
+	RMU_ResetControl(rmuResetSys, rmuResetModeLimited);
+	RMU_ResetControl(rmuResetPin, rmuResetModeLimited);
+	bool running = (RTCC->CTRL & RTCC_CTRL_ENABLE) != 0;
+	CMU_ClockSelectSet(cmuClock_HFLE,(CMU->STATUS & CMU_STATUS_LFXORDY) ? cmuSelect_LFXO : cmuSelect_LFRCO);
+	CMU_ClockEnable(cmuClock_HFLE,true);
+	CMU_ClockSelectSet(cmuClock_RTCC,(CMU->STATUS & CMU_STATUS_LFXORDY) ? cmuSelect_LFXO : cmuSelect_LFRCO);
+	CMU_ClockEnable(cmuClock_LFE, true);	// Use LF for RTCC
+	CMU_ClockEnable(cmuClock_RTCC, true);	// Start RTCC
+	RTCC_CCChConf_TypeDef RtccChannelInit = RTCC_CH_INIT_COMPARE_DEFAULT;
+	if (!running) RTCC_Reset();	// Counter kept running through a warm reset
+	RTCC_ChannelInit(TimeBaseOSChannel,&RtccChannelInit);
+	RTCC_ChannelInit(TimeBaseTimerChannel,&RtccChannelInit);
+	_overflows = 0;
+	_skipped = 0;
+	RTCC_IntDisable(_RTCC_IEN_MASK);	// Compares armed before the reset
+	RTCC_IntClear(_RTCC_IFC_MASK);
+	RTCC_IntEnable(RTCC_IEN_OF);
+	NVIC_ClearPendingIRQ(RTCC_IRQn);
+	NVIC_SetPriority(RTCC_IRQn, 1); 	/* Make sure to set priority lowest system priority */
+	NVIC_EnableIRQ(RTCC_IRQn);
+	RTCC_Init_TypeDef RtccInit = RTCC_INIT_DEFAULT;
+//	RtccInit.presc = rtccCntPresc_8;	// Any prescaler would fail => processor bug
+	RtccInit.presc = rtccCntPresc_1;	// Free run, no wrap on compare
+	if (!running) RTCC_Init(&RtccInit);
+}
+
+uint32_t TimeBaseGetTicks(void) {
+	return RTCC_CounterGet() + (uint32_t)_skipped;
+}
+
+uint64_t TimeBaseGetTicks64(void) {
+	SystemIrqDisable();
+	uint32_t high = _overflows;
+	uint32_t low = RTCC_CounterGet();
+	// Roll over occurred but IRQ is not processed yet
+	if ((RTCC->IF & RTCC_IF_OF) && (low < 0x80000000UL)) high++;
+	uint64_t ticks = (((uint64_t)high << 32) | low) + _skipped;
+	SystemIrqEnable();
+	return ticks;
+}
+
+uint32_t TimeBaseGetMs(void) {
+	return TimeBaseTicksToMs(TimeBaseGetTicks64());
+}
+
+uint64_t TimeBaseGetUs(void) {
+	return TimeBaseTicksToUs(TimeBaseGetTicks64());
+}
+
+void TimeBaseSetCompare(TIMEBASE_CHANNEL channel, uint32_t target) {
+	SystemIrqDisable();
+	RTCC_IntClear(TIMEBASE_IF(channel));
+	RTCC_ChannelCCVSet(channel, target - (uint32_t)_skipped);
+	RTCC_IntEnable(TIMEBASE_IF(channel));
+	// Compare only fires on match: if target is already reached, fire now
+	if (TimeBaseIsReached(target, TimeBaseGetTicks()) && !(RTCC->IF & TIMEBASE_IF(channel)))
+		RTCC_IntSet(TIMEBASE_IF(channel));
+	SystemIrqEnable();
+}
+
+void TimeBaseStopCompare(TIMEBASE_CHANNEL channel) {
+	RTCC_IntDisable(TIMEBASE_IF(channel));
+	RTCC_IntClear(TIMEBASE_IF(channel));
+}
+
+int TimeBaseIsPending(TIMEBASE_CHANNEL channel) {
+	return (RTCC->IF & RTCC->IEN & TIMEBASE_IF(channel)) != 0;
+}
+
+uint32_t TimeBaseGetNextDeadline(void) {
+	static const TIMEBASE_CHANNEL channels[] = { TimeBaseOSChannel, TimeBaseTimerChannel };
+	uint32_t deadline = TIMEBASE_NO_DEADLINE;
+	uint32_t now = RTCC_CounterGet();
+
+	for (unsigned i = 0; i < sizeof(channels)/sizeof(channels[0]); i++) {
+		if (!(RTCC->IEN & TIMEBASE_IF(channels[i]))) continue;
+		if (RTCC->IF & TIMEBASE_IF(channels[i])) return 0;
+		uint32_t left = RTCC_ChannelCCVGet(channels[i]) - now;
+		if ((int32_t)left < 0) return 0;
+		if (left < deadline) deadline = left;
+	}
+	return deadline;
+}
+
+void TimeBaseSkip(uint32_t ticks) {
+	static const TIMEBASE_CHANNEL channels[] = { TimeBaseOSChannel, TimeBaseTimerChannel };
+
+	SystemIrqDisable();
+	_skipped += ticks;
+	// Keep armed channels on their absolute target
+	for (unsigned i = 0; i < sizeof(channels)/sizeof(channels[0]); i++) {
+		if (RTCC->IEN & TIMEBASE_IF(channels[i]))
+			TimeBaseSetCompare(channels[i], RTCC_ChannelCCVGet(channels[i]) + (uint32_t)(_skipped - ticks));
+	}
+	SystemIrqEnable();
+}
+
+/** }@ */
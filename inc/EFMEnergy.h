@@ -9,6 +9,57 @@
  */
 
 #include "portable.h"
+#include <stdint.h>
+
+/*!
+ * @brief Energy modes the governor can select, from the shallowest to the deepest
+ */
+typedef enum {
+	EnergyModeEM1 = 1,	//!< Sleep, all peripherals running
+	EnergyModeEM2 = 2,	//!< Deep sleep, low frequency peripherals running
+	EnergyModeEM3 = 3,	//!< Stop, only asynchronous IRQs and ultra low frequency oscillator running
+	EnergyModes
+} ENERGY_MODE;
+
+/*!
+ * @brief Drivers that can restrict the deepest energy mode
+ * @remark GPIO edge IRQs (pulse inputs, radio DIOs) work down to EM3 and need no restriction
+ */
+typedef enum {
+	EnergyClientLegacy = 0,	//!< vEFMEnergyEnableLowPowerMode users
+	EnergyClientShell,		//!< LEUART console reception
+	EnergyClientRadio,		//!< Radio transceiver busy
+	EnergyClientADC,		//!< ADC DMA capture
+	EnergyClientCapture,	//!< Timer edge capture
+	EnergyClients
+} ENERGY_CLIENT;
+
+/*!
+ * @brief Time spent in each energy mode
+ */
+typedef struct {
+	unsigned long	Entries[EnergyModes];	//!< Number of sleeps per mode
+	uint64_t		Ticks[EnergyModes];		//!< Time spent per mode in 1/32768 s
+} ENERGY_RESIDENCY;
+
+#ifndef ENERGY_EM2_WAKEUP_TICKS
+/*!
+ * @brief Minimum time to the next deadline worth entering EM2, in 1/32768 s
+ */
+#define ENERGY_EM2_WAKEUP_TICKS		4
+#endif
+#ifndef ENERGY_EM3_WAKEUP_MS
+/*!
+ * @brief EM3 wake up latency in ms, dominated by the low frequency crystal restart
+ */
+#define ENERGY_EM3_WAKEUP_MS		500
+#endif
+#ifndef ENERGY_EM3_MIN_SLEEP_MS
+/*!
+ * @brief Minimum EM3 sleep duration in ms, shorter sleeps don't pay back the wake up cost
+ */
+#define ENERGY_EM3_MIN_SLEEP_MS		2048
+#endif
 
 /*!
  * @brief FreeRTOS Low Power Mode entry
@@ -25,7 +76,38 @@ void vEFMEnergyRestore(portTickType expected);
  * If a task uses a peripheral function that shall prevent the system to go to deep sleep mode
  * the task shall disable Low Power mode
  * @param[in] enable true to allow deep sleep mode
+ * @remark Calls are counted, disabling restricts the device to EM1 as EnergyClientLegacy
  */
 void vEFMEnergyEnableLowPowerMode(int enable);
+/*!
+ * @brief Register the deepest energy mode a driver can currently tolerate
+ * @param[in] client	Driver
+ * @param[in] deepest	Deepest energy mode, EnergyModeEM3 removes the restriction
+ */
+void vEFMEnergyRequire(ENERGY_CLIENT client, ENERGY_MODE deepest);
+/*!
+ * @brief Remove a driver energy mode restriction
+ * @param[in] client	Driver
+ */
+static inline void vEFMEnergyRelease(ENERGY_CLIENT client) { vEFMEnergyRequire(client, EnergyModeEM3); }
+/*!
+ * @brief Get the deepest energy mode allowed by all drivers
+ * @return energy mode
+ */
+ENERGY_MODE eEFMEnergyGetLimit(void);
+/*!
+ * @brief Select the energy mode for the next sleep
+ * @param[in] limit		Deepest energy mode allowed by drivers
+ * @param[in] deadline	Time to the next timer deadline in 1/32768 s, TIMEBASE_NO_DEADLINE if none
+ * @return energy mode to enter
+ * @remark The time base does not run in EM3, so EM3 is only selected if it can be left
+ * ENERGY_EM3_WAKEUP_MS before the deadline after at least ENERGY_EM3_MIN_SLEEP_MS
+ */
+ENERGY_MODE eEFMEnergySelectMode(ENERGY_MODE limit, uint32_t deadline);
+/*!
+ * @brief Get the time spent in each energy mode since start up
+ * @param[out] residency	Residency counters
+ */
+void vEFMEnergyGetResidency(ENERGY_RESIDENCY *residency);
 /** }@ */
 #endif
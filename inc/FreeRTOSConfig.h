@@ -211,10 +211,15 @@ See http://www.FreeRTOS.org/RTOS-Cortex-M3-M4.html. */
 	for( ;; ); \
 	}
 #else
-extern void SystemReboot(void);
-#define configASSERT( x )	if( ( x ) == 0 ) { taskDISABLE_INTERRUPTS(); SystemReboot(); }
+/* Save a crash record, then reboot */
+extern void CRASH_Assert(const char* file, int line);
+#define configASSERT( x )	if( ( x ) == 0 ) { taskDISABLE_INTERRUPTS(); CRASH_Assert( __FILE__, __LINE__ ); }
 #endif
 
+/* Keep track of the tasks for the crash records. */
+extern void CRASH_AddTask(void* task);
+#define traceTASK_CREATE( pxNewTCB )	CRASH_AddTask( pxNewTCB )
+
 /* Definitions that map the FreeRTOS port interrupt handlers to their CMSIS
 standard names. */
 #define vPortSVCHandler			SVC_Handler
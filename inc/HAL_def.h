@@ -130,11 +130,16 @@ const SystemPort HAL[] = {
 #endif
 #define ADCSAMPLEDELAY		ADCSamplingTime64
 #define ADCTIME				500
+#define ADCOVERSAMPLE		ADCOversample16		// Each DMA sample averages 16 conversions
+#define ADCSAMPLES			16					// Number of samples captured by DMA
+#define ADCFILTER			ADCFilterTrimmedMean	// Reject interference spikes
 #else
 //! @brief Define the number of pulse inputs
 #define DELAY_READ_DURATION 0
 #define HAL_NB_PULSE_IN		NODE_PULSE
 #define HAL_NB_LOOP			NODE_PULSE
+//! @brief PCNT0 S0IN location of the PULSE_PCNT_INPUT pulse input (first one, PD15), remove to count pulses with edge IRQs
+#define PULSE_PCNT_LOCATION	PCNT_ROUTELOC0_S0INLOC_LOC23
 #endif
 
 #define SPIBus 				MAKEPORTLIST(8)
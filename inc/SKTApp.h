@@ -18,6 +18,8 @@
 #define MSG_SKT_DEV_RESET						0x80
 #define MSG_SKT_DEV_SET_UPLINK_DATA_INTERVAL	0x81
 #define MSG_SKT_DEV_UPLINK_DATA_REQ				0x82
+#define MSG_SKT_DEV_LINK_STATS					0x83
+#define MSG_SKT_DEV_CRASH						0x84
 
 
 typedef	enum
@@ -41,10 +43,9 @@ typedef	enum
 void SKTAPP_SendPeriodic(bool retry);
 /*!
  * @brief Decode a down link message received from the LoRaWAN network
- * @param[in] McpsIndication pointer to a McpsIndication_t structure containing the last indication
- * event information
+ * @param[in] frame pointer to the received frame
  */
-bool SKTAPP_ParseMessage(McpsIndication_t* McpsIndication);
+bool SKTAPP_ParseMessage(LORAWAN_RX_FRAME* frame);
 /*!
  * @brief Decode a Mlme link confirm message received from the LoRaWAN network or LoRa MAC
  * @param[in] MlmeConfirm pointer to a MlmeConfirm_t structure containing the last Mlme confirm
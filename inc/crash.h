@@ -0,0 +1,149 @@
+/*******************************************************************
+**                                                                **
+** Post-mortem crash capture                                      **
+**                                                                **
+*******************************************************************/
+
+#ifndef __CRASH_H__
+#define __CRASH_H__
+/** \addtogroup S40 S40 Main Application
+ *  @{
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/*!
+ * @brief Number of words saved from the top of the crashed stack
+ */
+#define CRASH_STACK_WORDS	32
+/*!
+ * @brief Number of tasks saved
+ */
+#define CRASH_TASKS			8
+/*!
+ * @brief Number of words saved from the top of each task stack
+ */
+#define CRASH_TASK_WORDS	8
+/*!
+ * @brief Number of trace output bytes saved
+ */
+#define CRASH_TRACE_SIZE	256
+/*!
+ * @brief Task name size (configMAX_TASK_NAME_LEN, word aligned)
+ */
+#define CRASH_NAME_SIZE		12
+/*!
+ * @brief Largest compact crash report
+ */
+#define CRASH_REPORT_SIZE	34
+
+/*!
+ * @brief Crash causes
+ */
+typedef enum {
+	CrashHardFault = 1,			//!< Processor fault, Registers hold the exception frame
+	CrashStackOverflow,			//!< FreeRTOS stack overflow, Code is the task handle
+	CrashAssert,				//!< configASSERT failed, Code is the line and Arg the file name address
+	CrashErrorCode				//!< DeviceShowErrorCode, Code is the error code
+} CRASH_CAUSE;
+
+/*!
+ * @brief Saved task
+ */
+typedef struct {
+	uint32_t	Tcb;						//!< Task handle
+	uint32_t	Sp;							//!< Saved stack pointer (top of stack)
+	uint32_t	StackBase;					//!< Lowest stack address
+	uint16_t	HighWater;					//!< Minimum free stack ever (in words)
+	uint8_t		Running;					//!< 1 for the running task, its Sp is stale
+	uint8_t		Priority;					//!< Current priority
+	char		Name[CRASH_NAME_SIZE];		//!< Task name
+	uint32_t	Stack[CRASH_TASK_WORDS];	//!< Words from the saved stack pointer
+} CRASH_TASK;
+
+/*!
+ * @brief Crash record, as saved in Flash Memory
+ * @remark The tasks are saved after the rest of the record, with their own CRC, so that a
+ * fault while reading corrupted task control blocks does not lose the exception frame.
+ */
+typedef struct {
+	uint32_t	Magic;						//!< CRASH_MAGIC
+	uint32_t	Reported;					//!< Cleared once the crash was reported
+	uint16_t	Crc;						//!< CRC16 from Version to Trace
+	uint8_t		Version;					//!< Record layout version
+	uint8_t		Cause;						//!< CRASH_CAUSE
+	uint32_t	Code;						//!< Cause specific code
+	uint32_t	Arg;						//!< Cause specific argument
+	uint32_t	Ticks;						//!< Uptime (in FreeRTOS ticks)
+	uint32_t	Registers[8];				//!< R0, R1, R2, R3, R12, LR, PC, xPSR
+	uint32_t	ExcReturn;					//!< Exception return value (hard fault)
+	uint32_t	Sp;							//!< Stack pointer before the crash
+	uint32_t	Cfsr;						//!< Configurable fault status register
+	uint32_t	Hfsr;						//!< Hard fault status register
+	uint32_t	Mmfar;						//!< Memory manage fault address register
+	uint32_t	Bfar;						//!< Bus fault address register
+	char		Task[CRASH_NAME_SIZE];		//!< Running task name
+	uint32_t	Stack[CRASH_STACK_WORDS];	//!< Words from Sp
+	char		Trace[CRASH_TRACE_SIZE];	//!< Last trace output, oldest first
+	uint16_t	TasksCrc;					//!< CRC16 from TasksCount to Tasks
+	uint8_t		TasksCount;					//!< Number of saved tasks
+	uint8_t		Reserved;
+	CRASH_TASK	Tasks[CRASH_TASKS];			//!< Saved tasks
+} CRASH_RECORD;
+
+/*!
+ * @brief Load the crash record saved before the last reset
+ * @remark Must be called once before any other crash function
+ */
+void CRASH_Init(void);
+/*!
+ * @brief Get the crash record saved before the last reset
+ * @return crash record, NULL if none. Tasks are only valid if TasksCount is not 0.
+ */
+const CRASH_RECORD* CRASH_Get(void);
+/*!
+ * @brief Check whether a crash was not reported yet
+ * @return true if the crash report shall be sent
+ */
+bool CRASH_IsPending(void);
+/*!
+ * @brief Encode the compact crash report
+ * @param[out] buffer	Report buffer
+ * @param[in] size		Buffer size, at least CRASH_REPORT_SIZE bytes
+ * @return report size, 0 if there is no crash
+ */
+uint8_t CRASH_Encode(uint8_t* buffer, uint8_t size);
+/*!
+ * @brief Send the compact crash report as an uplink on the SKT device service port
+ * @return true if the report was sent, it will not be pending anymore
+ */
+bool CRASH_Send(void);
+/*!
+ * @brief Erase the saved crash record
+ */
+void CRASH_Clear(void);
+
+/*!
+ * @brief Register a created task, called by the FreeRTOS traceTASK_CREATE hook
+ * @param[in] task		Task handle
+ * @remark The crash handler cannot walk the FreeRTOS task lists safely from a fault
+ */
+void CRASH_AddTask(void* task);
+/*!
+ * @brief Save a crash record, from any context
+ * @param[in] cause		Crash cause
+ * @param[in] code		Cause specific code
+ * @param[in] arg		Cause specific argument
+ * @remark Returns to the caller, which shall then reset the system
+ */
+void CRASH_Capture(CRASH_CAUSE cause, uint32_t code, uint32_t arg);
+/*!
+ * @brief Save a crash record for a failed assertion and reset the system
+ * @param[in] file		Source file name
+ * @param[in] line		Source line
+ */
+__attribute__((noreturn)) void CRASH_Assert(const char* file, int line);
+
+/** }@ */
+#endif
@@ -41,10 +41,9 @@ void DEVICEAPP_SendPeriodic(bool retry);
 
 /*!
  * @brief Decode a down link message received from the LoRaWAN network
- * @param[in] McpsIndication pointer to a McpsIndication_t structure containing the last indication
- * event information
+ * @param[in] frame pointer to the received frame
  */
-void DEVICEAPP_ParseMessage(McpsIndication_t* McpsIndication);
+void DEVICEAPP_ParseMessage(LORAWAN_RX_FRAME* frame);
 
 /*!
  * @brief Decode a Mlme link confirm message received from the LoRaWAN network or LoRa MAC
@@ -59,9 +59,9 @@
 #endif
 
 /*!
- * @brief Defines the maximum number of historical values kept in memory. Put 0 not to keep any.
+ * @brief Defines the number of Flash Memory pages reserved to keep time stamped historical values. Put 0 not to keep any.
  */
-#define HISTORICAL_DATA			(100)
+#define HISTORICAL_DATA			(4)
 
 #if NODE_PULSE
 #define DEVICETYPE_DEFAULT	(0 + NODE_PULSE)
@@ -0,0 +1,92 @@
+/*******************************************************************
+**                                                                **
+** Flash backed time series history store                         **
+**                                                                **
+*******************************************************************/
+
+#ifndef __HISTORY_H__
+#define __HISTORY_H__
+/** \addtogroup S40 S40 Main Application
+ *  @{
+ */
+
+#include <stdbool.h>
+
+#ifndef HISTORY_PAGES
+/*!
+ * @brief Number of Flash Memory pages reserved for the history store
+ */
+#define HISTORY_PAGES		HISTORICAL_DATA
+#endif
+
+/*!
+ * @brief Maximum number of values stored per history record
+ */
+#define HISTORY_CHANNELS	HAL_NB_PULSE_IN
+
+/*!
+ * @brief History record iterator
+ * @remark Cursors are read only, a record appended after the cursor was opened is returned.
+ * Cursors refer to blocks by sequence number, so erasing the oldest block does not move them.
+ */
+typedef struct {
+	unsigned long	From;							//!< Lowest record time to return
+	unsigned long	To;								//!< Highest record time to return
+	unsigned long	Sequence;						//!< Sequence number of the block being read
+	unsigned short	Offset;							//!< Next record offset inside the block
+	unsigned long	Time;							//!< Last decoded record time
+	long			Delta;							//!< Last decoded record time delta
+	unsigned long	Values[HISTORY_CHANNELS];		//!< Last decoded record values
+} HISTORY_CURSOR;
+
+/*!
+ * @brief Rebuild the history block index from Flash Memory contents
+ * @remark Must be called once before any other history function
+ */
+void HISTORY_Init(void);
+/*!
+ * @brief Permanently append a record to the history store
+ * @param[in] time		Record time stamp (in seconds)
+ * @param[in] values	Array of HISTORY_CHANNELS values
+ * @return true if the record was written
+ * @remark When the store is full, the oldest block is erased
+ */
+bool HISTORY_Append(unsigned long time, const unsigned long* values);
+/*!
+ * @brief Get the number of records kept in the history store
+ * @return number of records
+ */
+unsigned long HISTORY_GetCount(void);
+/*!
+ * @brief Read the newest record of the history store
+ * @param[out] time		Record time stamp (can be NULL)
+ * @param[out] values	Array of HISTORY_CHANNELS values (can be NULL)
+ * @return false if the store is empty
+ */
+bool HISTORY_GetLast(unsigned long* time, unsigned long* values);
+/*!
+ * @brief Open a cursor on all records whose time stamp is in [from, to]
+ * @param[out] cursor	Cursor to initialize
+ * @param[in] from		Lowest record time
+ * @param[in] to		Highest record time
+ * @return true if the cursor could be opened
+ */
+bool HISTORY_OpenRange(HISTORY_CURSOR* cursor, unsigned long from, unsigned long to);
+/*!
+ * @brief Open a cursor on a record number
+ * @param[out] cursor	Cursor to initialize
+ * @param[in] index		Record number (0 = oldest record)
+ * @return true if the cursor could be opened
+ */
+bool HISTORY_OpenIndex(HISTORY_CURSOR* cursor, unsigned long index);
+/*!
+ * @brief Read the next record of a cursor
+ * @param[in,out] cursor	Opened cursor
+ * @param[out] time			Record time stamp (can be NULL)
+ * @param[out] values		Array of HISTORY_CHANNELS values (can be NULL)
+ * @return false when no more record is available
+ */
+bool HISTORY_Next(HISTORY_CURSOR* cursor, unsigned long* time, unsigned long* values);
+
+/** }@ */
+#endif
@@ -0,0 +1,92 @@
+/*******************************************************************
+**                                                                **
+** Join and provisioning retry scheduler                          **
+**                                                                **
+*******************************************************************/
+
+#ifndef __JOIN_RETRY_H__
+#define __JOIN_RETRY_H__
+/** \addtogroup S40 S40 Main Application
+ *  @{
+ */
+
+#include <stdbool.h>
+#include "retention.h"
+
+/*!
+ * @brief Join procedure stages that can be retried
+ */
+typedef enum {
+	JoinStagePseudoJoin = 0,	//!< SKT pseudo join with the default application key
+	JoinStageKeyAlloc,			//!< SKT real application key allocation request
+	JoinStageKeyRxReport,		//!< SKT real application key reception report
+	JoinStageRealJoin,			//!< SKT join with the real application key
+	JoinStageOTAA,				//!< Standard OTAA join
+	JoinStages
+} JOIN_STAGE;
+
+#ifndef JOIN_RETRY_MAX_ATTEMPTS
+/*!
+ * @brief Number of failed attempts of a stage before the long sleep
+ */
+#define JOIN_RETRY_MAX_ATTEMPTS		8
+#endif
+#ifndef JOIN_RETRY_LONG_SLEEP
+/*!
+ * @brief Long sleep duration after too many failed attempts (in seconds)
+ */
+#define JOIN_RETRY_LONG_SLEEP		(6UL * 60 * 60)
+#endif
+
+#ifndef JOIN_RETRY_PAGES
+/*!
+ * @brief Number of Flash Memory pages used for DevNonce reservations
+ */
+#define JOIN_RETRY_PAGES			2
+#endif
+
+/*!
+ * @brief Restore the retry state after a reset and hand the reserved DevNonce to the MAC
+ * @remark Must be called once the LoRaWAN stack is initialized
+ */
+void JOINRETRY_Init(void);
+/*!
+ * @brief Resume an interrupted join procedure after a reboot
+ * @return true if a retry was scheduled, false if the procedure shall start normally
+ */
+bool JOINRETRY_Resume(void);
+/*!
+ * @brief Make sure the DevNonce values used by the next join request are persisted
+ * @remark Call before any join request
+ */
+void JOINRETRY_ReserveDevNonce(void);
+/*!
+ * @brief Record a failed stage attempt and schedule its retry
+ * @param[in] stage			Failed stage
+ * @param[in] timeOnAir		Time on air of the failed attempt (in ms)
+ * @return retry delay in ms
+ */
+unsigned long JOINRETRY_Failed(JOIN_STAGE stage, unsigned long timeOnAir);
+/*!
+ * @brief Record a successful stage
+ * @param[in] stage			Successful stage
+ * @param[in] last			true if this was the last stage of the join procedure
+ */
+void JOINRETRY_Succeeded(JOIN_STAGE stage, bool last);
+/*!
+ * @brief Cancel any scheduled retry
+ */
+void JOINRETRY_Cancel(void);
+/*!
+ * @brief Get the time left before the scheduled retry
+ * @return number of FreeRTOS ticks, portMAX_DELAY if no retry is scheduled
+ */
+portTickType JOINRETRY_GetTimeout(void);
+/*!
+ * @brief Get the event to post when the scheduled retry is due
+ * @return the stage event, or IDLE_EVENT if no retry is due
+ */
+EVENT_TYPE JOINRETRY_Poll(void);
+
+/** }@ */
+#endif
@@ -0,0 +1,96 @@
+/*******************************************************************
+**                                                                **
+** Non blocking LED blink patterns                                **
+**                                                                **
+*******************************************************************/
+
+#ifndef __LED_PATTERN_H__
+#define __LED_PATTERN_H__
+/** \addtogroup S40 S40 Main Application
+ *  @{
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define LEDPATTERN_PRIORITY_FLASH	1		//!< Priority of the DeviceFlashLed notifications
+#define LEDPATTERN_PRIORITY_ALERT	2		//!< Priority of the error and alarm patterns
+
+/*!
+ * @brief Blink pattern step
+ * @remark A step with a null On duration is a pause of Count * Off
+ */
+typedef struct {
+	uint16_t		On;				//!< LED on duration (in ms)
+	uint16_t		Off;			//!< LED off duration (in ms)
+	uint8_t			Count;			//!< Number of flashes, 0 ends the steps list
+} LEDPATTERN_STEP;
+
+/*!
+ * @brief Blink pattern
+ */
+typedef struct {
+	const LEDPATTERN_STEP*	Steps;	//!< Steps list, ending with a null Count
+	uint8_t			Repeat;			//!< Number of times the steps are played, 0 to play them until stopped
+	uint8_t			Priority;		//!< A pattern only replaces a playing one of the same or a lower priority
+} LEDPATTERN;
+
+/*!
+ * @brief Initialize the pattern engine
+ */
+void LEDPATTERN_Init(void);
+/*!
+ * @brief Start playing a pattern on a LED
+ * @param[in] led		LED index
+ * @param[in] pattern	Pattern, must stay valid while it plays
+ * @return false if a pattern of a higher priority is playing
+ * @remark Returns immediately, the LED is driven from the timer IRQ
+ */
+bool LEDPATTERN_Play(uint8_t led, const LEDPATTERN* pattern);
+/*!
+ * @brief Play count flashes of period ms on a LED at LEDPATTERN_PRIORITY_FLASH
+ * @param[in] led		LED index
+ * @param[in] count		Number of flashes, 0 to flash until @ref LEDPATTERN_StopFlash
+ * @param[in] period	Flash on and off duration (in ms)
+ * @return false if a pattern of a higher priority is playing
+ */
+bool LEDPATTERN_Flash(uint8_t led, uint8_t count, uint16_t period);
+/*!
+ * @brief Play count flashes of period ms on a LED at LEDPATTERN_PRIORITY_ALERT
+ * @remark Preempts the flashes and is not interrupted by them
+ * @param[in] led		LED index
+ * @param[in] count		Number of flashes
+ * @param[in] period	Flash on and off duration (in ms)
+ * @return false if a pattern of a higher priority is playing
+ */
+bool LEDPATTERN_Alert(uint8_t led, uint8_t count, uint16_t period);
+/*!
+ * @brief Stop the flashes started by @ref LEDPATTERN_Flash, other patterns keep playing
+ */
+void LEDPATTERN_StopFlash(uint8_t led);
+/*!
+ * @brief Stop a pattern
+ * @param[in] led		LED index
+ * @param[in] pattern	Pattern to stop, NULL to stop any pattern
+ */
+void LEDPATTERN_Stop(uint8_t led, const LEDPATTERN* pattern);
+/*!
+ * @brief Check whether a pattern is playing on a LED
+ */
+bool LEDPATTERN_IsPlaying(uint8_t led);
+/*!
+ * @brief Wait until the pattern playing on a LED ends
+ * @remark Must not be used with endless patterns
+ */
+void LEDPATTERN_Wait(uint8_t led);
+/*!
+ * @brief Set the LED state shown when no pattern plays
+ */
+void LEDPATTERN_SetSteady(uint8_t led, bool on);
+/*!
+ * @brief Get the LED state shown when no pattern plays
+ */
+bool LEDPATTERN_GetSteady(uint8_t led);
+
+/** }@ */
+#endif
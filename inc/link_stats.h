@@ -0,0 +1,131 @@
+/*******************************************************************
+**                                                                **
+** LoRaWAN link quality statistics                                **
+**                                                                **
+*******************************************************************/
+
+#ifndef __LINK_STATS_H__
+#define __LINK_STATS_H__
+/** \addtogroup S40 S40 Main Application
+ *  @{
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifndef LINKSTATS_CHANNELS
+/*!
+ * @brief Number of uplink channels tracked (higher channel indexes only update the totals)
+ */
+#define LINKSTATS_CHANNELS		16
+#endif
+/*!
+ * @brief Pseudo channel index used for the downlinks received in the RX2 window
+ */
+#define LINKSTATS_CHANNEL_RX2	LINKSTATS_CHANNELS
+/*!
+ * @brief Number of data rates tracked
+ */
+#define LINKSTATS_DATARATES		8
+/*!
+ * @brief Number of bins of the RSSI and SNR histograms
+ * @remark RSSI bin n counts values >= LINKSTATS_RSSI_TOP - (n + 1) * LINKSTATS_RSSI_STEP, the
+ * last bin counts all lower values. The SNR histogram works the same way.
+ */
+#define LINKSTATS_BINS			8
+#define LINKSTATS_RSSI_TOP		(-40)	//!< Upper bound of the first RSSI bin (in dBm)
+#define LINKSTATS_RSSI_STEP		10		//!< Width of the RSSI bins (in dB)
+#define LINKSTATS_SNR_TOP		15		//!< Upper bound of the first SNR bin (in dB)
+#define LINKSTATS_SNR_STEP		5		//!< Width of the SNR bins (in dB)
+/*!
+ * @brief Number of confirmed uplink transmissions used by the rolling packet error rate
+ */
+#define LINKSTATS_PER_WINDOW	32
+
+/*!
+ * @brief Downlink signal histograms
+ * @remark Bins saturate at 0xFFFF
+ */
+typedef struct {
+	uint16_t		Rssi[LINKSTATS_BINS];		//!< RSSI histogram
+	uint16_t		Snr[LINKSTATS_BINS];		//!< SNR histogram
+} LINKSTATS_HISTOGRAM;
+
+/*!
+ * @brief Link quality counters
+ */
+typedef struct {
+	uint32_t		Uplinks;					//!< Uplink frames confirmed by the MAC
+	uint32_t		Confirmed;					//!< Confirmed uplink frames
+	uint32_t		Transmissions;				//!< Radio transmissions of the confirmed frames
+	uint32_t		AckMissed;					//!< Confirmed frames never acknowledged
+	uint32_t		Rx1;						//!< Downlinks received in the RX1 window
+	uint32_t		Rx2;						//!< Downlinks received in the RX2 window
+	uint32_t		DownlinkLost;				//!< Downlinks lost, from the downlink counter gaps
+	uint32_t		LbtChecks;					//!< Listen before talk channel checks
+	uint32_t		LbtBusy;					//!< Listen before talk checks that found the channel busy
+	uint32_t		UplinksPerChannel[LINKSTATS_CHANNELS];	//!< Uplink frames per channel
+	uint32_t		UplinksPerDatarate[LINKSTATS_DATARATES];//!< Uplink frames per data rate
+	int32_t			RssiSum[LINKSTATS_DATARATES];	//!< Sum of the downlink RSSI per data rate
+	int32_t			SnrSum[LINKSTATS_DATARATES];	//!< Sum of the downlink SNR per data rate
+	uint16_t		Samples[LINKSTATS_DATARATES];	//!< Downlinks per data rate (saturates at 0xFFFF)
+	LINKSTATS_HISTOGRAM	PerChannel[LINKSTATS_CHANNELS + 1];	//!< Histograms per channel, RX2 last
+	LINKSTATS_HISTOGRAM	PerDatarate[LINKSTATS_DATARATES];	//!< Histograms per data rate
+} LINKSTATS;
+
+/*!
+ * @brief Clear all statistics
+ */
+void LINKSTATS_Reset(void);
+/*!
+ * @brief Account an uplink frame confirmed by the MAC
+ * @param[in] channel		Uplink channel index
+ * @param[in] datarate		Uplink data rate
+ * @param[in] confirmed		true for a confirmed frame
+ * @param[in] transmissions	Number of radio transmissions of the frame
+ * @param[in] acked			true if the network acknowledged the frame
+ */
+void LINKSTATS_Uplink(uint8_t channel, uint8_t datarate, bool confirmed, uint8_t transmissions, bool acked);
+/*!
+ * @brief Account a downlink received by the MAC
+ * @param[in] channel	Uplink channel index for RX1, LINKSTATS_CHANNEL_RX2 for RX2
+ * @param[in] datarate	Downlink data rate
+ * @param[in] rssi		Downlink RSSI (in dBm)
+ * @param[in] snr		Downlink SNR (in dB)
+ * @param[in] counter	Downlink frame counter
+ */
+void LINKSTATS_Downlink(uint8_t channel, uint8_t datarate, int16_t rssi, int8_t snr, uint32_t counter);
+/*!
+ * @brief Account a listen before talk channel check
+ * @param[in] free	true if the channel was found free
+ * @remark May be called from the radio driver context
+ */
+void LINKSTATS_ChannelSensed(bool free);
+/*!
+ * @brief Get the rolling packet error rate of the last confirmed uplink transmissions
+ * @return Packet error rate in percent, -1 if no confirmed frame was sent yet
+ */
+int LINKSTATS_GetPER(void);
+/*!
+ * @brief Get the link quality counters
+ * @return Pointer to the read only statistics
+ */
+const LINKSTATS* LINKSTATS_Get(void);
+/*!
+ * @brief Encode a compact diagnostic report
+ * @param[out] buffer	Report buffer
+ * @param[in] size		Report buffer size
+ * @return Report length
+ * @remark The report holds the saturated 16 bit totals, the packet error rate and, for each data rate
+ * with downlinks, the mean RSSI and SNR. Data rates that do not fit in the buffer are dropped.
+ */
+uint8_t LINKSTATS_Encode(uint8_t* buffer, uint8_t size);
+/*!
+ * @brief Send the diagnostic report as an uplink on the SKT device service port
+ * @return true if the message was sent
+ * @remark Must not be called from the LoRaWAN event task
+ */
+bool LINKSTATS_Send(void);
+
+/** }@ */
+#endif
@@ -59,6 +59,9 @@ uint32_t	LORAMAC_GetJoinDelay2(void);
 bool	LORAMAC_GetADR(void);
 bool	LORAMAC_SetADR(bool bADR);
 
+bool	LORAMAC_GetADRPredict(void);
+bool	LORAMAC_SetADRPredict(bool bPredict);
+
 bool	LORAMAC_AddACK(void);
 
 bool	LORAMAC_TxCW(uint32_t xTimeout);
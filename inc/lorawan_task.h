@@ -29,6 +29,13 @@
  */
 #define LORAWAN_ADR_ON                              1
 
+/*!
+ * LoRaWAN device side predictive ADR
+ *
+ * \remark Steps the data rate and TX power from the link margin history, only when ADR is enabled
+ */
+#define LORAWAN_ADR_PREDICT_ON                      0
+
 #include "LoRaMacTest.h"
 
 #define USE_SEMTECH_DEFAULT_CHANNEL_LINEUP          0
@@ -135,6 +142,74 @@ LORA_MESSAGE *Message;
 };
 } LORA_PACKET;
 
+/*!
+ * @brief Number of received frames that can be in use at the same time
+ */
+#define LORAWAN_RX_FRAMES							3
+/*!
+ * @brief Largest received application payload
+ */
+#define LORAWAN_RX_FRAME_SIZE						242
+
+/*!
+ * @brief Received LoRaWAN frame
+ * @remark Frames are reference counted. A frame passed to a handler is valid until the handler
+ * returns, a task keeping it longer must use @ref LORAWAN_HoldFrame and @ref LORAWAN_ReleaseFrame.
+ */
+typedef struct {
+McpsIndication_t Indication;	//!< LoRaWAN indication information, Buffer points to Data
+LORA_PACKET Packet;				//!< LoRaWAN message view of the frame, Buffer points to Data
+uint8_t Refs;					//!< Number of references, 0 when the frame is free
+uint8_t Data[LORAWAN_RX_FRAME_SIZE];	//!< Frame payload
+} LORAWAN_RX_FRAME;
+
+/*!
+ * @brief Received frame handler of a LoRaWAN port
+ * @return true if the frame shall be acknowledged
+ */
+typedef bool (*LORAWAN_PORT_HANDLER)(LORAWAN_RX_FRAME* frame);
+
+/*!
+ * @brief LoRaWAN port handler table entry, tables end with a NULL handler
+ */
+typedef struct {
+uint8_t Port;					//!< LoRaWAN port
+LORAWAN_PORT_HANDLER Handler;	//!< Received frame handler
+} LORAWAN_PORT;
+
+/*!
+ * @brief Number of channel mask words kept in a session (largest region mask)
+ */
+#define LORAWAN_SESSION_MASKS						6
+/*!
+ * @brief First channel kept in a session, the lower ones are region default channels
+ */
+#define LORAWAN_SESSION_FIRST_CHANNEL				2
+/*!
+ * @brief Number of channels kept in a session, enough for a CFList
+ */
+#define LORAWAN_SESSION_CHANNELS					8
+
+/*!
+ * @brief Joined MAC session, everything needed to send again without joining
+ */
+typedef struct {
+uint32_t NetID;									//!< Network ID
+uint32_t DevAddr;								//!< Device address
+uint8_t NwkSKey[16];							//!< Network session key
+uint8_t AppSKey[16];							//!< Application session key
+uint32_t UpLinkCounter;							//!< Next uplink frame counter
+uint32_t DownLinkCounter;						//!< Last downlink frame counter
+uint32_t Rx2Frequency;							//!< RX2 frequency (in Hz)
+uint32_t Channels[LORAWAN_SESSION_CHANNELS];	//!< Frequency / 100 in bits 0-23, data rate range in bits 24-31, 0 if unused
+uint16_t ChannelsMask[LORAWAN_SESSION_MASKS];	//!< Channels mask
+uint16_t ReceiveDelay1;							//!< RX1 delay (in ms)
+int8_t Datarate;								//!< Uplink data rate
+int8_t TxPower;									//!< Uplink TX power index
+uint8_t Rx2Datarate;							//!< RX2 data rate
+uint8_t Reserved;
+} LORAWAN_SESSION;
+
 
 /*!
  * @brief LORAWAN Task initialization
@@ -161,6 +236,11 @@ bool LORAWAN_CancelJoinNetwork(void);
 bool LORAWAN_SendAck(void);
 
 bool	LORAWAN_SendDevTimeReq(void);
+/*!
+ * @brief Queues a DeviceTimeReq MAC command, sent with the next uplink
+ * @return true if the request was accepted by the MAC
+ */
+bool	LORAWAN_RequestDevTime(void);
 
 /*!
  * @brief Sends a link check request to the network
@@ -182,10 +262,41 @@ LoRaMacStatus_t LORAWAN_SendMessage(LORA_PACKET* message);
 bool LORAWAN_IsNetworkJoined();
 
 /*!
- * @brief Get a pointer to the last received LoRaWAN message from the network
- * @return a pointer if OK. Null otherwise.
+ * @brief Get the current MAC session
+ * @param[out] session	Session parameters
+ */
+void LORAWAN_GetSession(LORAWAN_SESSION* session);
+
+/*!
+ * @brief Restore a MAC session and mark the network as joined
+ * @param[in] session	Session parameters returned by @ref LORAWAN_GetSession
+ * @return true if the session was accepted by the MAC
+ */
+bool LORAWAN_RestoreSession(const LORAWAN_SESSION* session);
+
+/*!
+ * @brief Call the handler of the port of a received frame
+ * @param[in] frame	Received frame with data
+ * @param[in] ports	Port handler table
+ * @return the handler result, false if the port has no handler
  */
-LORA_PACKET* LORAWAN_GetMessage(void);
+bool LORAWAN_DispatchFrame(LORAWAN_RX_FRAME* frame, const LORAWAN_PORT* ports);
+
+/*!
+ * @brief Take the last received frame not processed by the LoRaWAN event task
+ * @return a pointer to the frame, to be released with @ref LORAWAN_ReleaseFrame. Null if none.
+ */
+LORAWAN_RX_FRAME* LORAWAN_TakeFrame(void);
+
+/*!
+ * @brief Add a reference to a received frame
+ */
+void LORAWAN_HoldFrame(LORAWAN_RX_FRAME* frame);
+
+/*!
+ * @brief Remove a reference to a received frame, the frame is free for reuse once unreferenced
+ */
+void LORAWAN_ReleaseFrame(LORAWAN_RX_FRAME* frame);
 
 /*!
  * @brief Get a pointer to the last received Mlme Confirm event from the network
@@ -198,11 +309,6 @@ MlmeConfirm_t* LORAWAN_GetMlmeConfirm(void);
  * @return a pointer if OK. Null otherwise.
  */
 McpsConfirm_t* LORAWAN_GetConfirm(void);
-/*!
- * @brief Get a pointer to the last received Indication event from the network
- * @return a pointer if OK. Null otherwise.
- */
-McpsIndication_t* LORAWAN_GetIndication(void);
 /*!
  * @brief Return the current LoRaWAN network down link counter
  * @return the number of received down link messages
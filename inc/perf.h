@@ -0,0 +1,124 @@
+/*******************************************************************
+**                                                                **
+** Hot path cycle count probes                                    **
+**                                                                **
+*******************************************************************/
+
+#ifndef __PERF_H__
+#define __PERF_H__
+/** \addtogroup S40 S40 Main Application
+ *  @{
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifndef PERF_PROBES
+/*!
+ * @brief Set to 1 to build the cycle count probes into the hot paths
+ */
+#define PERF_PROBES			0
+#endif
+#ifndef PERF_THRESHOLD_PCT
+/*!
+ * @brief Mean cycle count (or host instruction count) increase over the baseline reported as a regression (in percent)
+ */
+#define PERF_THRESHOLD_PCT	10
+#endif
+
+/*!
+ * @brief Instrumented hot paths
+ */
+typedef enum {
+	PerfComputeMic = 0,		//!< LoRaMacComputeMic
+	PerfPayloadEncrypt,		//!< LoRaMacPayloadEncrypt
+	PerfTimeOnAir,			//!< SX1276GetTimeOnAir
+	PerfNextChannel,		//!< RegionNextChannel
+	PerfTimerStart,			//!< TimerStart
+	PerfShellParse,			//!< SHELL_ParseLine
+	PerfProbes
+} PERF_PROBE;
+
+/*!
+ * @brief Cycle counts of a probe
+ */
+typedef struct {
+	uint32_t		Count;		//!< Number of runs
+	uint32_t		Min;		//!< Fewest cycles of a run
+	uint32_t		Max;		//!< Most cycles of a run
+	uint64_t		Total;		//!< Cycles of all runs
+} PERF_STATS;
+
+#if (PERF_PROBES > 0)
+#include "em_device.h"
+/*!
+ * @brief Start measuring a probe, must be used at the beginning of a block
+ * @hideinitializer
+ */
+#define PERF_BEGIN(probe)	uint32_t _perfStart_##probe = DWT->CYCCNT
+/*!
+ * @brief Stop measuring a probe started in the same block
+ * @hideinitializer
+ */
+#define PERF_END(probe)		PERF_Record(probe, DWT->CYCCNT - _perfStart_##probe)
+#else
+#define PERF_BEGIN(probe)
+#define PERF_END(probe)
+#endif
+
+/*!
+ * @brief Start the core cycle counter and clear the statistics
+ */
+void PERF_Init(void);
+/*!
+ * @brief Clear the statistics
+ */
+void PERF_Reset(void);
+/*!
+ * @brief Account a run of a probe
+ * @param[in] probe		Probe
+ * @param[in] cycles	Core cycles of the run
+ * @remark May be called from interrupt context
+ */
+void PERF_Record(PERF_PROBE probe, uint32_t cycles);
+/*!
+ * @brief Get the statistics of a probe
+ * @param[in] probe		Probe
+ * @param[out] stats	Statistics copy
+ */
+void PERF_Get(PERF_PROBE probe, PERF_STATS* stats);
+/*!
+ * @brief Get the name of a probe
+ */
+const char* PERF_GetName(PERF_PROBE probe);
+/*!
+ * @brief Get the baseline mean cycle count of a probe
+ * @return Mean cycles of the reference run, 0 if there is no baseline
+ */
+uint32_t PERF_GetBaseline(PERF_PROBE probe);
+/*!
+ * @brief Set the baseline mean cycle count of a probe
+ * @param[in] probe		Probe
+ * @param[in] cycles	Mean cycles of the reference run, 0 to clear the baseline
+ */
+void PERF_SetBaseline(PERF_PROBE probe, uint32_t cycles);
+/*!
+ * @brief Record the current mean cycle counts as the baselines of the probes that ran
+ * @remark The baselines are kept by PERF_Reset
+ */
+void PERF_MarkBaselines(void);
+/*!
+ * @brief Find a probe by name (case insensitive)
+ * @return Probe, PerfProbes if there is none of this name
+ */
+PERF_PROBE PERF_FindProbe(const char* name);
+/*!
+ * @brief Compare the mean cycle count of a probe to its baseline
+ * @param[in] probe		Probe
+ * @param[out] delta	Mean cycle count change in percent of the baseline
+ * @return true if the probe regressed by more than PERF_THRESHOLD_PCT
+ */
+bool PERF_Check(PERF_PROBE probe, int* delta);
+
+/** }@ */
+#endif
@@ -0,0 +1,36 @@
+/*******************************************************************
+**                                                                **
+** RTCC retention registers allocation                            **
+**                                                                **
+*******************************************************************/
+
+#ifndef __RETENTION_H__
+#define __RETENTION_H__
+/** \addtogroup S40 S40 Main Application
+ *  @{
+ */
+
+/*
+ * The registers (RET[], 32 words) survive every reset but a power-on reset. The warm start
+ * snapshot takes the registers from WARMSTART_NVRAM_INDEX on, warm_start.c checks at build
+ * time that it ends below the single registers of the other modules.
+ */
+/*!
+ * @brief First RTCC retention register of the warm start snapshot
+ */
+#define WARMSTART_NVRAM_INDEX		0
+/*!
+ * @brief RTCC retention register keeping the clock rate correction (time_sync.c)
+ */
+#define TIMESYNC_NVRAM_INDEX		30
+/*!
+ * @brief RTCC retention register keeping the join stage and attempt count (join_retry.c)
+ */
+#define JOIN_RETRY_NVRAM_INDEX		31
+/*!
+ * @brief Number of RTCC retention registers
+ */
+#define RETENTION_WORDS				32
+
+/** }@ */
+#endif
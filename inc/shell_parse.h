@@ -0,0 +1,25 @@
+/*******************************************************************
+**                                                                **
+** Shell command line tokenizer                                   **
+**                                                                **
+*******************************************************************/
+
+#ifndef __SHELL_PARSE_H__
+#define __SHELL_PARSE_H__
+/** \addtogroup S40 S40 Main Application
+ *  @{
+ */
+
+#include <stdint.h>
+
+/*!
+ * @brief Split a command line in place on spaces and tabs
+ * @param[in,out] pLine	Command line, the separators following the arguments are replaced by '\0'
+ * @param[out] pArgv	Arguments found, pointing into pLine
+ * @param[in] nMaxArgs	Size of pArgv, the arguments past it are left in pLine
+ * @return Number of arguments found
+ */
+int	SHELL_ParseLine(char* pLine, char* pArgv[], uint32_t nMaxArgs);
+
+/** }@ */
+#endif
@@ -0,0 +1,30 @@
+/*******************************************************************
+**                                                                **
+** SKT application payload builders                               **
+**                                                                **
+*******************************************************************/
+
+#ifndef __SKT_PAYLOAD_H__
+#define __SKT_PAYLOAD_H__
+/** \addtogroup S40 S40 Main Application
+ *  @{
+ */
+
+#include <stdint.h>
+#include "lorawan_task.h"
+
+/*!
+ * @brief Fill a periodic data message: the counter and the values as decimal text, separated by commas
+ * @param[out] pMessage		Message to fill
+ * @param[in] ulMaxSize		Size of the message buffer
+ * @param[in] nType			Message type
+ * @param[in] ulCount		Periodic message counter
+ * @param[in] pValues		Values to report
+ * @param[in] nValues		Number of values
+ * @return Message size including its header, 0 if it does not fit
+ */
+uint32_t	SKTPAYLOAD_SetPeriodic(LORA_MESSAGE* pMessage, uint32_t ulMaxSize, uint8_t nType, uint32_t ulCount,
+		const unsigned long* pValues, int nValues);
+
+/** }@ */
+#endif
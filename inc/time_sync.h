@@ -0,0 +1,100 @@
+/*******************************************************************
+**                                                                **
+** Network time synchronization                                   **
+**                                                                **
+*******************************************************************/
+
+#ifndef __TIME_SYNC_H__
+#define __TIME_SYNC_H__
+/** \addtogroup S40 S40 Main Application
+ *  @{
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "LoRaMac.h"
+#include "mcu_rtc.h"
+#include "retention.h"
+
+#ifndef TIMESYNC_PERIOD
+/*!
+ * @brief Time between two synchronizations (in seconds)
+ */
+#define TIMESYNC_PERIOD			(24UL * 60 * 60)
+#endif
+#ifndef TIMESYNC_RETRY
+/*!
+ * @brief Time before a request is repeated when no answer was received (in seconds)
+ */
+#define TIMESYNC_RETRY			(60UL * 60)
+#endif
+#ifndef TIMESYNC_MIN_INTERVAL
+/*!
+ * @brief Shortest time over which the clock drift is estimated (in seconds)
+ */
+#define TIMESYNC_MIN_INTERVAL	(6UL * 60 * 60)
+#endif
+#ifndef TIMESYNC_MAX_STEP
+/*!
+ * @brief Largest clock error explained by the drift (in seconds), the drift estimation restarts above
+ */
+#define TIMESYNC_MAX_STEP		60
+#endif
+#ifndef TIMESYNC_MAX_TRIM
+/*!
+ * @brief Largest rate correction (in parts per billion)
+ */
+#define TIMESYNC_MAX_TRIM		200000L
+#endif
+#ifndef TIMESYNC_EPOCH_OFFSET
+/*!
+ * @brief DeviceTimeAns epoch, as RTC seconds subtracted from the network time (Unix time)
+ */
+#define TIMESYNC_EPOCH_OFFSET	UNIX_TIMESTAMP_DIFF
+#endif
+#ifndef TIMESYNC_AT_TX_START
+/*!
+ * @brief Set to 1 if the network time refers to the start of the uplink instead of its end
+ */
+#define TIMESYNC_AT_TX_START	0
+#endif
+
+/*!
+ * @brief Synchronization status
+ */
+typedef struct {
+	uint32_t	Count;			//!< Number of synchronizations
+	uint32_t	LastSync;		//!< RTC time of the last synchronization (in seconds), 0 if never
+	int32_t		Offset;			//!< Clock error corrected by the last synchronization (in ms)
+	int32_t		Drift;			//!< Residual drift measured by the last estimation (in ppb)
+	uint32_t	Interval;		//!< Time covered by the last estimation (in seconds)
+} TIMESYNC_STATUS;
+
+/*!
+ * @brief Restore the rate correction learned before the last reset
+ * @remark Must be called once before any other time synchronization function
+ */
+void TIMESYNC_Init(void);
+/*!
+ * @brief Check whether the clock shall be synchronized
+ * @return true if TIMESYNC_Request shall be called before the next uplink
+ */
+bool TIMESYNC_IsDue(void);
+/*!
+ * @brief Request the network time, the DeviceTimeReq MAC command is sent with the next uplink
+ * @return true if the request was queued
+ */
+bool TIMESYNC_Request(void);
+/*!
+ * @brief Synchronize the clock with a received DeviceTimeAns
+ * @param[in] confirm	MLME_DEV_TIME confirm
+ */
+void TIMESYNC_Confirm(const MlmeConfirm_t* confirm);
+/*!
+ * @brief Get the synchronization status
+ * @return status
+ */
+const TIMESYNC_STATUS* TIMESYNC_GetStatus(void);
+
+/** }@ */
+#endif
@@ -26,6 +26,11 @@ typedef	enum
 	TRACE_LEVEL_FATAL
 }	TRACE_LEVEL;
 
+/*!
+ * @brief Size of the last trace output history, a power of 2
+ */
+#define	TRACE_HISTORY_SIZE	256
+
 
 void		TRACE_ShowConfig(void);
 
@@ -42,6 +47,7 @@ const char*	TRACE_GetLevelName(TRACE_LEVEL xLevel);
 void		TRACE_SetModule(uint16_t xModule, bool bEnable);
 bool		TRACE_GetModule(uint16_t xModule);
 const char*	TRACE_GetModuleName(unsigned short xModuleFlag);
+uint32_t	TRACE_GetHistory(char* pBuffer, uint32_t ulSize);
 
 #if DEBUG == 1
 #define	TRACE(level, format, ...)		TRACE_Printf(TRACE_LEVEL_DEBUG_##level, __MODULE__, format, ## __VA_ARGS__)
@@ -0,0 +1,65 @@
+/*******************************************************************
+**                                                                **
+** Retained MAC session snapshot (warm start)                     **
+**                                                                **
+*******************************************************************/
+
+#ifndef __WARM_START_H__
+#define __WARM_START_H__
+/** \addtogroup S40 S40 Main Application
+ *  @{
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifndef WARMSTART_PAGES
+/*!
+ * @brief Number of Flash Memory pages reserved for the session snapshots (at least 2)
+ */
+#define WARMSTART_PAGES			2
+#endif
+#ifndef WARMSTART_FCNT_GAP
+/*!
+ * @brief Uplink frame counter values reserved by each Flash Memory snapshot
+ */
+#define WARMSTART_FCNT_GAP		32
+#endif
+#ifndef WARMSTART_MAX_AGE
+/*!
+ * @brief Age of a session after which it is not restored anymore (in seconds)
+ */
+#define WARMSTART_MAX_AGE		(30UL * 24 * 60 * 60)
+#endif
+
+/*!
+ * @brief Restore the MAC session saved before the last reset
+ * @return true if the session was restored and the device can send without joining
+ * @remark Only brown-out, watchdog, lockup and software resets restore a session. The
+ * retained RAM copy is used first, then the Flash Memory one. Must be called once before
+ * any other warm start function.
+ */
+bool WARMSTART_Restore(void);
+/*!
+ * @brief Save the MAC session after a successful join
+ */
+void WARMSTART_Save(void);
+/*!
+ * @brief Update the saved MAC session after an uplink
+ * @remark Does nothing until a session was saved or restored
+ */
+void WARMSTART_Update(void);
+/*!
+ * @brief Update the saved MAC session when a data uplink was sent, before its receive windows
+ * @param[in] upLinkCounter Frame counter the uplink was sent with
+ * @remark The saved session already uses the next frame counter: a reset before the
+ * confirmation does not send this one again. Does nothing until a session was saved or restored
+ */
+void WARMSTART_TxDone(uint32_t upLinkCounter);
+/*!
+ * @brief Forget the saved MAC session, the next reset will join again
+ */
+void WARMSTART_Invalidate(void);
+
+/** }@ */
+#endif
@@ -16,6 +16,7 @@
 #include "trace.h"
 #include "LoRaMacCrypto.h"
 #include "lorawan_task.h"
+#include "skt_payload.h"
 
 #undef	__MODULE__
 #define	__MODULE__	FLAG_TRACE_SKT
@@ -131,6 +132,11 @@ static bool DEVICEAPP_ExecSKTDevice(LORA_MESSAGE* msg)
 		// Just force Supervisor to send standard uplink message
 		SUPERVISOR_RequestResend();
 		break;
+
+	case MSG_SKT_DEV_LINK_STATS:
+		// The report is sent by the Supervisor, not from the LoRaWAN event task
+		DevicePostEvent(LINK_STATS_EVENT);
+		break;
 	}
 	return rc;
 }
@@ -229,14 +235,12 @@ void SKTAPP_SendPeriodicDataExt(uint8_t messageType, bool retry)
 	LocalMessage.Port = LORAWAN_APP_PORT;
 	LocalMessage.Request = MCPS_UNCONFIRMED;
 
-	LocalMessage.Message->MessageType = messageType;
-	LocalMessage.Message->Version = LORA_MESSAGE_VERSION;
-	LocalMessage.Message->PayloadLen = sprintf((char*)&(LocalMessage.Message->Payload[0]),
-			"%ld,%ld",PeriodicCount++,(retry) ? SUPERVISOR_GetHistoricalValue(0,0) : DeviceGetPulseInValue(0));
-	if (DeviceGetPulseInNumber() > 1)
-		LocalMessage.Message->PayloadLen += sprintf((char*)&(LocalMessage.Message->Payload[LocalMessage.Message->PayloadLen]),
-				",%ld",(retry) ? SUPERVISOR_GetHistoricalValue(0,1) : DeviceGetPulseInValue(1));
-	LocalMessage.Size = LORA_MESSAGE_HEADER_SIZE + LocalMessage.Message->PayloadLen;
+	unsigned long values[2];
+	int nValues = (DeviceGetPulseInNumber() > 1) ? 2 : 1;
+	for (int i = 0; i < nValues; i++)
+		values[i] = (retry) ? SUPERVISOR_GetHistoricalValue(0,i) : DeviceGetPulseInValue(i);
+	LocalMessage.Size = SKTPAYLOAD_SetPeriodic(LocalMessage.Message, sizeof(LocalBuffer), messageType, PeriodicCount++,
+			values, nValues);
 	DUMP(0, LocalMessage.Message->Payload, LocalMessage.Message->PayloadLen, "SendPeriodicData : ");
 	if (LORAWAN_SendMessage(&LocalMessage)  != LORAMAC_STATUS_OK)
 	{
@@ -276,9 +280,47 @@ bool SKTAPP_Send(uint8_t port, uint8_t messageType, uint8_t *pFrame, uint32_t ul
 }
 
 
-bool SKTAPP_ParseMessage(McpsIndication_t* ind)
+static bool SKTAPP_OnDevicePort(LORAWAN_RX_FRAME* frame)
+{
+	TRACE(5, "SKT Device Service Port received.\n");
+	return	(frame->Packet.Size > 0) && DEVICEAPP_ExecSKTDevice(frame->Packet.Message);
+}
+
+static bool SKTAPP_OnNetworkPort(LORAWAN_RX_FRAME* frame)
+{
+	TRACE(5, "SKT Network Service Port received.\n");
+	return	(frame->Packet.Size > 0) && DEVICEAPP_ExecSKTNetwork(frame->Packet.Message);
+}
+
+static bool SKTAPP_OnDaliworksPort(LORAWAN_RX_FRAME* frame)
+{
+	TRACE(5, "Daliworks Service Port received.\n");
+	return	(frame->Packet.Size > 0) && DEVICEAPP_ExecDaliworks(frame->Packet.Message);
+}
+
+#if (INCLUDE_COMPLIANCE_TEST > 0)
+static bool SKTAPP_OnCompliancePort(LORAWAN_RX_FRAME* frame)
+{
+	DEVICEAPP_RunComplianceTest(&frame->Indication);
+	return	false;
+}
+#endif
+
+static const LORAWAN_PORT SKTAppPorts[] =
+{
+	{	SKT_DEVICE_SERVICE_PORT,	SKTAPP_OnDevicePort},
+	{	SKT_NETWORK_SERVICE_PORT,	SKTAPP_OnNetworkPort},
+	{	DALIWORKS_SERVICE_PORT,		SKTAPP_OnDaliworksPort},
+#if (INCLUDE_COMPLIANCE_TEST > 0)
+	{	224,						SKTAPP_OnCompliancePort},	// 0xE0
+#endif
+	{	0,	NULL}
+};
+
+bool SKTAPP_ParseMessage(LORAWAN_RX_FRAME* frame)
 {
 	bool rc = false;
+	McpsIndication_t* ind = frame ? &frame->Indication : NULL;
 	LocalMessage.Buffer = LocalBuffer;	/* Just to be sure */
 
 	if (ind)
@@ -292,39 +334,7 @@ bool SKTAPP_ParseMessage(McpsIndication_t* ind)
 
 			if (ind->RxData)
 			{
-				LORA_PACKET *msg = LORAWAN_GetMessage();
-				if (msg)
-				{
-					switch(msg->Port)
-					{
-					case SKT_DEVICE_SERVICE_PORT:
-						TRACE(5, "SKT Device Service Port received.\n");
-						if (msg->Size > 0) {
-							rc = DEVICEAPP_ExecSKTDevice(msg->Message);
-						}
-						break;
-					case SKT_NETWORK_SERVICE_PORT:
-						TRACE(5, "SKT Network Service Port received.\n");
-						if (msg->Size > 0) {
-							rc = DEVICEAPP_ExecSKTNetwork(msg->Message);
-						}
-						break;
-					case DALIWORKS_SERVICE_PORT:
-						TRACE(5, "Daliworks Service Port received.\n");
-						if (msg->Size > 0) {
-							rc = DEVICEAPP_ExecDaliworks(msg->Message);
-						}
-						break;
-#if (INCLUDE_COMPLIANCE_TEST > 0)
-					case 224: // 0xE0
-						DEVICEAPP_RunComplianceTest(ind);
-						break;
-#endif
-					default:
-						TRACE(5, "Unknown Port : %d\n", msg->Port);
-						break;
-					}
-				}
+				rc = LORAWAN_DispatchFrame(frame, SKTAppPorts);
 
 				/* If rc is true then send ACK. */
 				if (rc) {
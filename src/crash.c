@@ -0,0 +1,279 @@
+/*******************************************************************
+** crash.c                                                        **
+**                                                                **
+** Post-mortem crash capture                                      **
+**                                                                **
+*******************************************************************/
+/** \addtogroup S40 S40 Main Application
+ *  @{
+ */
+
+#include "global.h"
+#include "crash.h"
+#include "lorawan_task.h"
+#include "SKTApp.h"
+#include "system.h"
+#include "crc16.h"
+#include "trace.h"
+#include <em_device.h>
+#include <flash.h>
+#include <stddef.h>
+#include <string.h>
+
+#undef	__MODULE__
+#define	__MODULE__	FLAG_TRACE_SUPERVISOR
+
+/*
+ * A crash is saved in a reserved Flash Memory page by the fault handler, the FreeRTOS hooks
+ * or DeviceShowErrorCode, then the system is reset. Nothing but the Flash Memory driver is
+ * used while saving: the scheduler state and the stacks may be corrupted. Addresses are
+ * checked before being read so that a bad stack pointer does not fault again.
+ * The first crash is kept until it has been reported, so that a crash loop does not hide
+ * its origin. The Reported word is cleared in place (no erase needed).
+ * tools/crash_decode decodes the Flash Memory page or the compact report, and symbolizes the
+ * PC, LR and stack words with the firmware ELF file.
+ */
+/** @cond */
+#define CRASH_MAGIC			0x48535243UL	// "CRSH"
+#define CRASH_VERSION		1
+#define CRASH_PAGE_SIZE		2048			// Same as FLASH_PAGE
+#define CRASH_NOT_REPORTED	0xFFFFFFFFUL
+#define CRASH_CORE_SIZE		offsetof(CRASH_RECORD, TasksCrc)
+
+typedef char CRASH_SIZE_CHECK[(sizeof(CRASH_RECORD) <= CRASH_PAGE_SIZE) ? 1 : -1];
+
+static const uint8_t	__attribute__((aligned(CRASH_PAGE_SIZE)))
+						__attribute__ ((__used__))
+_CRASHPAGE_[CRASH_PAGE_SIZE] = { [0 ... (CRASH_PAGE_SIZE - 1)] = 0xFF };
+// Force the compiler to read real Flash Memory contents instead of the initialization values
+#define CRASH_PAGEPTR		((volatile const uint8_t*)_CRASHPAGE_)
+#define CRASH_RECORDPTR		((volatile const CRASH_RECORD*)_CRASHPAGE_)
+
+static CRASH_RECORD		CrashRecord;			// Saved record, or record being captured
+static bool				bValid = false;			// CrashRecord holds the saved record
+static TaskHandle_t		CrashTaskHandles[CRASH_TASKS];	// Tasks are allocated statically, never deleted
+static uint8_t			CrashTaskCount = 0;
+/** @endcond */
+
+static uint16_t CRASHCoreCrc(const CRASH_RECORD* record) {
+	return CRC16_CalculateRange((const unsigned char*)&record->Version,
+			CRASH_CORE_SIZE - offsetof(CRASH_RECORD, Version), 0xFFFF);
+}
+
+static uint16_t CRASHTasksCrc(const CRASH_RECORD* record) {
+	return CRC16_CalculateRange((const unsigned char*)&record->TasksCount,
+			sizeof(CRASH_RECORD) - offsetof(CRASH_RECORD, TasksCount), 0xFFFF);
+}
+
+static bool CRASHIsRam(uint32_t address, uint32_t size) {
+	return ((address & 3) == 0) && (address >= SRAM_BASE)
+			&& ((address + size) <= (SRAM_BASE + (uint32_t)SystemGetRAMSize() * 1024));
+}
+
+static void CRASHCopyStack(uint32_t* words, int count, uint32_t sp) {
+	for (int i = 0; i < count; i++)
+		words[i] = CRASHIsRam(sp + i * 4, 4) ? ((volatile const uint32_t*)(uintptr_t)sp)[i] : 0;
+}
+
+static void CRASHCopyName(char* name, const char* source) {
+	memset(name, 0, CRASH_NAME_SIZE);
+	if (source) strncpy(name, source, CRASH_NAME_SIZE - 1);
+}
+
+/*
+ * Save each task, the running one has a stale stack pointer in its TCB.
+ * Only FreeRTOS accessors without critical sections are used, they assert inside an ISR.
+ */
+static void CRASHCaptureTasks(CRASH_RECORD* record) {
+	TaskHandle_t current = NULL;
+	TaskStatus_t status;
+	uint8_t count = 0;
+	if (xTaskGetSchedulerState() != taskSCHEDULER_NOT_STARTED)
+		current = xTaskGetCurrentTaskHandle();
+	for (uint8_t i = 0; i < CrashTaskCount; i++) {
+		CRASH_TASK* task = &record->Tasks[count];
+		task->Tcb = (uint32_t)(uintptr_t)CrashTaskHandles[i];
+		if (!CRASHIsRam(task->Tcb, sizeof(StaticTask_t))) continue;
+		// The state is not computed: memset also keeps vTaskGetInfo from reading it as eSuspended
+		memset(&status, 0, sizeof(status));
+		vTaskGetInfo(CrashTaskHandles[i], &status, pdFALSE, eRunning);
+		// pxTopOfStack is the first member of the TCB
+		task->Sp = *(volatile const uint32_t*)(uintptr_t)task->Tcb;
+		task->StackBase = (uint32_t)(uintptr_t)status.pxStackBase;
+		if (CRASHIsRam(task->StackBase, 4))
+			task->HighWater = (uint16_t)uxTaskGetStackHighWaterMark(CrashTaskHandles[i]);
+		task->Running = (CrashTaskHandles[i] == current) ? 1 : 0;
+		task->Priority = (uint8_t)status.uxCurrentPriority;
+		CRASHCopyName(task->Name, status.pcTaskName);
+		CRASHCopyStack(task->Stack, CRASH_TASK_WORDS, task->Sp);
+		count++;
+	}
+	record->TasksCount = count;
+	record->TasksCrc = CRASHTasksCrc(record);
+}
+
+/*
+ * Write the record in two steps, the tasks are only saved once the rest is safe
+ */
+static void CRASHSave(CRASH_RECORD* record) {
+	bool bErase = (CRASH_RECORDPTR->Magic != 0xFFFFFFFFUL);
+	// Keep the first crash until it is reported
+	if ((CRASH_RECORDPTR->Magic == CRASH_MAGIC) && (CRASH_RECORDPTR->Reported == CRASH_NOT_REPORTED))
+		return;
+	record->Crc = CRASHCoreCrc(record);
+	FLASHOpen();
+	if (!bErase || (FLASHEraseBlock((void*)CRASH_PAGEPTR) == FLASH_NO_ERROR)) {
+		if (FLASHWrite((void*)CRASH_PAGEPTR, (unsigned char*)record, CRASH_CORE_SIZE) == FLASH_NO_ERROR) {
+			CRASHCaptureTasks(record);
+			FLASHWrite((void*)(CRASH_PAGEPTR + CRASH_CORE_SIZE), (unsigned char*)&record->TasksCrc,
+					sizeof(CRASH_RECORD) - CRASH_CORE_SIZE);
+		}
+	}
+	FLASHClose();
+}
+
+static void CRASHCaptureCore(CRASH_RECORD* record, CRASH_CAUSE cause, uint32_t code, uint32_t arg, uint32_t sp) {
+	TaskHandle_t current = NULL;
+	memset(record, 0, sizeof(CRASH_RECORD));
+	record->Magic = CRASH_MAGIC;
+	record->Reported = CRASH_NOT_REPORTED;
+	record->Version = CRASH_VERSION;
+	record->Cause = (uint8_t)cause;
+	record->Code = code;
+	record->Arg = arg;
+	record->Ticks = xTaskGetTickCount();
+	record->Sp = sp;
+	record->Cfsr = SCB->CFSR;
+	record->Hfsr = SCB->HFSR;
+	record->Mmfar = SCB->MMFAR;
+	record->Bfar = SCB->BFAR;
+	if (xTaskGetSchedulerState() != taskSCHEDULER_NOT_STARTED)
+		current = xTaskGetCurrentTaskHandle();
+	CRASHCopyName(record->Task, current ? pcTaskGetName(current) : "MAIN");
+	CRASHCopyStack(record->Stack, CRASH_STACK_WORDS, sp);
+	TRACE_GetHistory(record->Trace, sizeof(record->Trace));
+}
+
+#if defined(__arm__)	// The host unit tests have no exception entry
+/*
+ * Called by HardFault_Handler with the exception frame
+ */
+__attribute__((noreturn, used)) void CRASH_Fault(uint32_t* frame, uint32_t excReturn) {
+	uint32_t sp = (uint32_t)frame;
+	CRASHCaptureCore(&CrashRecord, CrashHardFault, 0, 0, sp + 8 * 4);
+	if (CRASHIsRam(sp, 8 * 4)) {
+		for (int i = 0; i < 8; i++) CrashRecord.Registers[i] = frame[i];
+	}
+	CrashRecord.ExcReturn = excReturn;
+	CRASHSave(&CrashRecord);
+	SystemReboot();
+}
+
+/*
+ * Pick the stack holding the exception frame and hand it to CRASH_Fault
+ */
+__attribute__((naked)) void HardFault_Handler(void) {
+	__asm volatile (
+		"	tst lr, #4		\n"
+		"	ite eq			\n"
+		"	mrseq r0, msp	\n"
+		"	mrsne r0, psp	\n"
+		"	mov r1, lr		\n"
+		"	b CRASH_Fault	\n"
+	);
+}
+#endif
+
+void CRASH_AddTask(void* task) {
+	if (CrashTaskCount < CRASH_TASKS)
+		CrashTaskHandles[CrashTaskCount++] = (TaskHandle_t)task;
+}
+
+void CRASH_Capture(CRASH_CAUSE cause, uint32_t code, uint32_t arg) {
+	uint32_t sp = (uint32_t)(uintptr_t)__builtin_frame_address(0);
+	taskDISABLE_INTERRUPTS();
+	CRASHCaptureCore(&CrashRecord, cause, code, arg, sp);
+	CrashRecord.Registers[5] = (uint32_t)(uintptr_t)__builtin_return_address(0);	// LR: the caller
+	CRASHSave(&CrashRecord);
+}
+
+__attribute__((noreturn)) void CRASH_Assert(const char* file, int line) {
+	CRASH_Capture(CrashAssert, (uint32_t)line, (uint32_t)(uintptr_t)file);
+	SystemReboot();
+}
+
+void CRASH_Init(void) {
+	volatile const uint8_t* ptr = CRASH_PAGEPTR;
+	bValid = false;
+	if (CRASH_RECORDPTR->Magic != CRASH_MAGIC) return;
+	for (int i = 0; i < sizeof(CRASH_RECORD); i++)
+		((uint8_t*)&CrashRecord)[i] = ptr[i];
+	if ((CrashRecord.Version != CRASH_VERSION) || (CrashRecord.Crc != CRASHCoreCrc(&CrashRecord))) return;
+	// Tasks not saved, or only partially
+	if ((CrashRecord.TasksCount > CRASH_TASKS) || (CrashRecord.TasksCrc != CRASHTasksCrc(&CrashRecord)))
+		CrashRecord.TasksCount = 0;
+	bValid = true;
+	INFO("Crash cause %d, code %08lX, PC %08lX, task %s.\n", CrashRecord.Cause, CrashRecord.Code,
+			CrashRecord.Registers[6], CrashRecord.Task);
+}
+
+const CRASH_RECORD* CRASH_Get(void) {
+	return bValid ? &CrashRecord : NULL;
+}
+
+bool CRASH_IsPending(void) {
+	return bValid && (CrashRecord.Reported == CRASH_NOT_REPORTED);
+}
+
+static uint8_t* CRASHPut32(uint8_t* p, uint32_t value) {
+	*p++ = (uint8_t)(value >> 24);
+	*p++ = (uint8_t)(value >> 16);
+	*p++ = (uint8_t)(value >> 8);
+	*p++ = (uint8_t)value;
+	return p;
+}
+
+uint8_t CRASH_Encode(uint8_t* buffer, uint8_t size) {
+	uint8_t* p = buffer;
+	if (!bValid || (size < CRASH_REPORT_SIZE)) return 0;
+	*p++ = CRASH_VERSION;
+	*p++ = CrashRecord.Cause;
+	p = CRASHPut32(p, CrashRecord.Code);
+	p = CRASHPut32(p, CrashRecord.Ticks / configTICK_RATE_HZ);
+	p = CRASHPut32(p, CrashRecord.Registers[6]);	// PC
+	p = CRASHPut32(p, CrashRecord.Registers[5]);	// LR
+	p = CRASHPut32(p, CrashRecord.Cfsr);
+	p = CRASHPut32(p, CrashRecord.Hfsr);
+	memcpy(p, CrashRecord.Task, 8);
+	p += 8;
+	return (uint8_t)(p - buffer);
+}
+
+bool CRASH_Send(void) {
+	uint8_t report[CRASH_REPORT_SIZE];
+	uint8_t len = CRASH_Encode(report, sizeof(report));
+	uint32_t reported = 0;
+	signed char rc;
+
+	if (!len) return false;
+	INFO("Sending crash report (%d bytes).\n", len);
+	if (!SKTAPP_Send(SKT_DEVICE_SERVICE_PORT, MSG_SKT_DEV_CRASH, report, len)) return false;
+	vTaskSuspendAll();
+	FLASHOpen();
+	rc = FLASHWrite((void*)&CRASH_RECORDPTR->Reported, (unsigned char*)&reported, sizeof(reported));
+	FLASHClose();
+	xTaskResumeAll();
+	if (rc == FLASH_NO_ERROR) CrashRecord.Reported = reported;
+	return true;
+}
+
+void CRASH_Clear(void) {
+	vTaskSuspendAll();
+	FLASHOpen();
+	FLASHEraseBlock((void*)CRASH_PAGEPTR);
+	FLASHClose();
+	xTaskResumeAll();
+	bValid = false;
+}
+
+/** }@ */
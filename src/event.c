@@ -12,64 +12,122 @@
 
 /*
  * Device Event Handling
+ *
+ * Events are numbered from 1 to 32 and kept as a pending bit set:
+ * an event already pending is never queued twice and a lower event number
+ * is always returned first.
  */
 
-static xQueueHandle xEventQueue = 0;
-static StaticQueue_t xStaticEventQueue;
-static uint8_t ucEventQueueStorageArea[ 16 * sizeof(uint32_t) ];
+#define	EVENT_MAX	32
+
+static volatile uint32_t	ulEventPending = 0;
+static SemaphoreHandle_t	xEventSignal = NULL;
+static StaticSemaphore_t	xEventSignalBuffer;
 
 void EVENT_Init(void)
 {
-	xEventQueue = xQueueCreateStatic(16,sizeof(uint32_t), ucEventQueueStorageArea, &xStaticEventQueue);
+	ulEventPending = 0;
+	xEventSignal = xSemaphoreCreateBinaryStatic(&xEventSignalBuffer);
+}
+
+static uint32_t EVENT_Take(void)
+{
+	uint32_t	evt = 0;
+
+	taskENTER_CRITICAL();
+	if (ulEventPending)
+	{
+		evt = __builtin_ctz(ulEventPending);
+		ulEventPending &= ~(1UL << evt);
+		evt++;
+	}
+	taskEXIT_CRITICAL();
+
+	return	evt;
 }
 
 uint32_t EVENT_WaitForEvent(portTickType duration)
 {
 	uint32_t	evt;
-	if (xEventQueue)
+	TimeOut_t	xTimeOut;
+
+	if (xEventSignal == NULL)
 	{
-		if (xQueueReceive(xEventQueue,&evt,duration) == pdTRUE)
+		return	0;
+	}
+
+	vTaskSetTimeOutState(&xTimeOut);
+	for(;;)
+	{
+		if ((evt = EVENT_Take()) != 0)
+		{
+			return	evt;
+		}
+
+		if (xSemaphoreTake(xEventSignal, duration) != pdTRUE)
 		{
-			return evt;
+			return	0;
+		}
+
+		if ((evt = EVENT_Take()) != 0)
+		{
+			return	evt;
+		}
+
+		if (xTaskCheckForTimeOut(&xTimeOut, &duration) != pdFALSE)
+		{
+			return	0;
 		}
 	}
-	return 0;
 }
+
 void EVENT_Send(uint32_t event)
 {
-	if (xEventQueue)
+	if ((xEventSignal != NULL) && (event != 0) && (event <= EVENT_MAX))
 	{
-		xQueueSendToBack(xEventQueue,&event,0);
+		uint32_t	ulPending;
+
+		taskENTER_CRITICAL();
+		ulPending = ulEventPending;
+		ulEventPending |= (1UL << (event - 1));
+		taskEXIT_CRITICAL();
+
+		if ((ulPending & (1UL << (event - 1))) == 0)
+		{
+			xSemaphoreGive(xEventSignal);
+		}
 	}
 }
+
 void EVENT_Post(uint32_t event)
 {
-	if (xEventQueue)
-	{
-		uint32_t e;
-		// Ignore already waiting event (avoid redondency)
-		if ((xQueuePeek(xEventQueue,&e,0) == pdTRUE) && (e == event)) return;
-		xQueueSendToFront(xEventQueue,&event,0);
-	}
-}
-
-void EVENT_PostFromISR(uint32_t event)
-{
-	if (xEventQueue)
-	{
-		uint32_t e;
-		// Ignore already waiting event (avoid redondency)
-		if ((xQueuePeekFromISR(xEventQueue,&e) == pdTRUE) && (e == event)) return;
-		xQueueSendToFrontFromISR(xEventQueue,&event,NULL);
-	}
+	EVENT_Send(event);
 }
 
 signed portBASE_TYPE EVENT_SendFromISR(uint32_t event)
 {
 	signed portBASE_TYPE sHigherPriorityTaskWoken = pdFALSE;
-	if (xEventQueue)
+
+	if ((xEventSignal != NULL) && (event != 0) && (event <= EVENT_MAX))
 	{
-		xQueueSendToBackFromISR(xEventQueue,&event,&sHigherPriorityTaskWoken);
+		uint32_t	ulPending;
+		UBaseType_t	uxMask;
+
+		uxMask = portSET_INTERRUPT_MASK_FROM_ISR();
+		ulPending = ulEventPending;
+		ulEventPending |= (1UL << (event - 1));
+		portCLEAR_INTERRUPT_MASK_FROM_ISR(uxMask);
+
+		if ((ulPending & (1UL << (event - 1))) == 0)
+		{
+			xSemaphoreGiveFromISR(xEventSignal, &sHigherPriorityTaskWoken);
+		}
 	}
+
 	return sHigherPriorityTaskWoken;
 }
+
+void EVENT_PostFromISR(uint32_t event)
+{
+	portEND_SWITCHING_ISR(EVENT_SendFromISR(event));
+}
@@ -0,0 +1,362 @@
+/*******************************************************************
+** history.c                                                      **
+**                                                                **
+** Flash backed time series history store                         **
+**                                                                **
+*******************************************************************/
+/** \addtogroup S40 S40 Main Application
+ *  @{
+ */
+
+#include "global.h"
+#include "history.h"
+#include <flash.h>
+#include <string.h>
+
+/*
+ * Storage layout
+ *
+ * Each reserved Flash page is one block starting with a HISTORY_HEADER.
+ * Blocks are used as a ring, the oldest one being erased when the store is full.
+ * Records follow the header, each one word aligned (Flash Memory is written by words):
+ *   - 1 byte: encoded record length (0xFF = end of block)
+ *   - zigzag varint: time delta of delta (the block header time is the base with a 0 delta)
+ *   - zigzag varint: for each channel, value delta to the previous record (or to 0)
+ *   - 0xFF padding to the next word
+ * Each block can be decoded by itself, so a range query only has to decode the
+ * blocks that overlap the requested time range.
+ */
+/** @cond */
+#if HISTORY_PAGES
+
+#define HISTORY_MAGIC		0x54534948UL	// "HIST"
+#define HISTORY_PAGE_SIZE	2048			// Same as FLASH_PAGE
+#define HISTORY_RECORD_MAX	(1 + (5 * (1 + HISTORY_CHANNELS)))
+#define HISTORY_ALIGN(n)	(((n) + 3) & ~3)
+
+typedef struct {
+	uint32_t Magic;
+	uint32_t Sequence;
+	uint32_t Time;
+	uint16_t Channels;
+	uint16_t Reserved;
+} HISTORY_HEADER;
+
+typedef struct {
+	uint32_t Sequence;
+	uint32_t FirstTime;
+	uint32_t LastTime;
+	uint16_t Count;
+	uint16_t Offset;		// End of written records, 0 if the block is not in use
+} HISTORY_BLOCK;
+
+static const uint8_t	__attribute__((aligned(HISTORY_PAGE_SIZE)))
+						__attribute__ ((__used__))
+_HISTORYPAGES_[HISTORY_PAGES][HISTORY_PAGE_SIZE] = {
+	[0 ... (HISTORY_PAGES - 1)] = { [0 ... (HISTORY_PAGE_SIZE - 1)] = 0xFF }
+};
+// Force the compiler to read real Flash Memory contents instead of the initialization values
+#define HISTORY_PAGEPTR(p)	((volatile const uint8_t*)_HISTORYPAGES_[(p)])
+#define HISTORY_HEADERPTR(p) ((volatile const HISTORY_HEADER*)_HISTORYPAGES_[(p)])
+
+static HISTORY_BLOCK	_blocks[HISTORY_PAGES];
+static uint8_t			_order[HISTORY_PAGES];		// Pages in use, from the oldest to the newest
+static int				_nbBlocks = 0;
+static int				_current = -1;				// Page being written
+static unsigned long	_count = 0;
+static bool				_sealed = false;			// Current block tail is not blank (interrupted write)
+// Last written record, base of the next record encoding
+static unsigned long	_lastTime;
+static long				_lastDelta;
+static unsigned long	_lastValues[HISTORY_CHANNELS];
+
+static inline unsigned long zigzag(long v) {
+	return ((unsigned long)v << 1) ^ (unsigned long)(0 - (v < 0));
+}
+static inline long unzigzag(unsigned long v) {
+	return (long)(v >> 1) ^ -(long)(v & 1);
+}
+
+static int putVarint(uint8_t* buf, unsigned long v) {
+	int n = 0;
+	while (v >= 0x80) {
+		buf[n++] = (uint8_t)(v | 0x80);
+		v >>= 7;
+	}
+	buf[n++] = (uint8_t)v;
+	return n;
+}
+
+static int getVarint(const uint8_t* buf, int len, unsigned long* v) {
+	unsigned long r = 0;
+	for (int n = 0; (n < len) && (n < 5); n++) {
+		r |= (unsigned long)(buf[n] & 0x7F) << (7 * n);
+		if (!(buf[n] & 0x80)) {
+			*v = r;
+			return n + 1;
+		}
+	}
+	return 0;
+}
+
+/*
+ * Encode a record in buf, returns the word aligned record size
+ */
+static int HISTORY_Encode(uint8_t* buf, unsigned long time, const unsigned long* values) {
+	long delta = (long)(time - _lastTime);
+	int n = 1;
+	n += putVarint(&buf[n], zigzag(delta - _lastDelta));
+	for (int i = 0; i < HISTORY_CHANNELS; i++)
+		n += putVarint(&buf[n], zigzag((long)(values[i] - _lastValues[i])));
+	buf[0] = (uint8_t)(n - 1);
+	memset(&buf[n], 0xFF, HISTORY_ALIGN(n) - n);
+	return HISTORY_ALIGN(n);
+}
+
+/*
+ * Decode the record at *offset in page, and update the record state
+ */
+static bool HISTORY_Decode(int page, unsigned short* offset, unsigned short end, unsigned long* time, long* delta, unsigned long* values) {
+	uint8_t buf[HISTORY_RECORD_MAX];
+	volatile const uint8_t* ptr = HISTORY_PAGEPTR(page) + *offset;
+	if ((*offset + 1) > end) return false;
+	int len = ptr[0];
+	if ((len == 0) || (len >= HISTORY_RECORD_MAX) || ((*offset + 1 + len) > end)) return false;
+	for (int i = 0; i < len; i++) buf[i] = ptr[1 + i];
+	unsigned long v;
+	int n = getVarint(buf, len, &v);
+	if (!n) return false;
+	*delta += unzigzag(v);
+	*time += (unsigned long)*delta;
+	for (int i = 0; i < HISTORY_CHANNELS; i++) {
+		int m = getVarint(&buf[n], len - n, &v);
+		if (!m) return false;
+		values[i] += (unsigned long)unzigzag(v);
+		n += m;
+	}
+	if (n != len) return false;
+	*offset += HISTORY_ALIGN(1 + len);
+	return true;
+}
+
+static void HISTORY_SortBlocks(void) {
+	_nbBlocks = 0;
+	_count = 0;
+	for (int p = 0; p < HISTORY_PAGES; p++) {
+		if (!_blocks[p].Offset) continue;
+		int i = _nbBlocks++;
+		while ((i > 0) && ((int32_t)(_blocks[_order[i-1]].Sequence - _blocks[p].Sequence) > 0)) {
+			_order[i] = _order[i-1];
+			i--;
+		}
+		_order[i] = (uint8_t)p;
+		_count += _blocks[p].Count;
+	}
+}
+
+static void HISTORY_ScanBlock(int page) {
+	volatile const HISTORY_HEADER* hdr = HISTORY_HEADERPTR(page);
+	HISTORY_BLOCK* blk = &_blocks[page];
+	memset(blk, 0, sizeof(HISTORY_BLOCK));
+	if ((hdr->Magic != HISTORY_MAGIC) || (hdr->Channels != HISTORY_CHANNELS)) return;
+	blk->Sequence = hdr->Sequence;
+	blk->FirstTime = blk->LastTime = hdr->Time;
+	blk->Offset = sizeof(HISTORY_HEADER);
+	unsigned long time = hdr->Time;
+	long delta = 0;
+	unsigned long values[HISTORY_CHANNELS];
+	memset(values, 0, sizeof(values));
+	while (HISTORY_Decode(page, &blk->Offset, HISTORY_PAGE_SIZE, &time, &delta, values)) {
+		blk->LastTime = time;
+		blk->Count++;
+	}
+	if ((_current < 0) || ((int32_t)(blk->Sequence - _blocks[_current].Sequence) > 0)) {
+		_current = page;
+		_sealed = (blk->Offset < HISTORY_PAGE_SIZE) && (HISTORY_PAGEPTR(page)[blk->Offset] != 0xFF);
+		_lastTime = time;
+		_lastDelta = delta;
+		memcpy(_lastValues, values, sizeof(values));
+	}
+}
+
+/*
+ * Erase the next page of the ring and make it the current block
+ */
+static bool HISTORY_OpenBlock(unsigned long time) {
+	int page = (_current < 0) ? 0 : ((_current + 1) % HISTORY_PAGES);
+	HISTORY_HEADER hdr = {
+		.Magic = HISTORY_MAGIC,
+		.Sequence = (_current < 0) ? 0 : (_blocks[_current].Sequence + 1),
+		.Time = time,
+		.Channels = HISTORY_CHANNELS,
+		.Reserved = 0xFFFF
+	};
+	signed char rc;
+	_blocks[page].Offset = 0;
+	vTaskSuspendAll();
+	FLASHOpen();
+	rc = FLASHEraseBlock((void*)HISTORY_PAGEPTR(page));
+	if (rc == FLASH_NO_ERROR)
+		rc = FLASHWrite((void*)HISTORY_PAGEPTR(page), (unsigned char*)&hdr, sizeof(hdr));
+	FLASHClose();
+	xTaskResumeAll();
+	if (rc == FLASH_NO_ERROR) {
+		_current = page;
+		_blocks[page].Sequence = hdr.Sequence;
+		_blocks[page].FirstTime = _blocks[page].LastTime = time;
+		_blocks[page].Count = 0;
+		_blocks[page].Offset = sizeof(HISTORY_HEADER);
+		_lastTime = time;
+		_lastDelta = 0;
+		memset(_lastValues, 0, sizeof(_lastValues));
+		_sealed = false;
+	}
+	HISTORY_SortBlocks();
+	return (rc == FLASH_NO_ERROR);
+}
+
+/*
+ * Find the oldest block whose sequence number is not below sequence
+ */
+static unsigned short HISTORY_FindBlock(uint32_t sequence) {
+	unsigned short block = 0;
+	while ((block < _nbBlocks) && ((int32_t)(_blocks[_order[block]].Sequence - sequence) < 0))
+		block++;
+	return block;
+}
+
+/*
+ * Start a cursor on the first record of a block, or after the newest block
+ */
+static void HISTORY_CursorStart(HISTORY_CURSOR* cursor, unsigned short block) {
+	cursor->Offset = sizeof(HISTORY_HEADER);
+	cursor->Delta = 0;
+	memset(cursor->Values, 0, sizeof(cursor->Values));
+	if (block < _nbBlocks) {
+		cursor->Sequence = _blocks[_order[block]].Sequence;
+		cursor->Time = HISTORY_HEADERPTR(_order[block])->Time;
+	} else {
+		cursor->Sequence = (_nbBlocks) ? (_blocks[_order[_nbBlocks - 1]].Sequence + 1) : 0;
+	}
+}
+
+/** @endcond */
+
+void HISTORY_Init(void) {
+	_current = -1;
+	for (int p = 0; p < HISTORY_PAGES; p++)
+		HISTORY_ScanBlock(p);
+	HISTORY_SortBlocks();
+}
+
+bool HISTORY_Append(unsigned long time, const unsigned long* values) {
+	uint32_t record[HISTORY_ALIGN(HISTORY_RECORD_MAX) / sizeof(uint32_t)];
+	int len = 0;
+	if (!values) return false;
+	if ((_current >= 0) && _blocks[_current].Offset && !_sealed) {
+		len = HISTORY_Encode((uint8_t*)record, time, values);
+		if ((_blocks[_current].Offset + len) > HISTORY_PAGE_SIZE) len = 0;
+	}
+	if (!len) {
+		if (!HISTORY_OpenBlock(time)) return false;
+		len = HISTORY_Encode((uint8_t*)record, time, values);
+	}
+	HISTORY_BLOCK* blk = &_blocks[_current];
+	signed char rc;
+	vTaskSuspendAll();
+	FLASHOpen();
+	rc = FLASHWrite((void*)(HISTORY_PAGEPTR(_current) + blk->Offset), (unsigned char*)record, len);
+	FLASHClose();
+	xTaskResumeAll();
+	if (rc != FLASH_NO_ERROR) return false;
+	blk->Offset += len;
+	blk->Count++;
+	blk->LastTime = time;
+	_lastDelta = (long)(time - _lastTime);
+	_lastTime = time;
+	memcpy(_lastValues, values, sizeof(_lastValues));
+	_count++;
+	return true;
+}
+
+unsigned long HISTORY_GetCount(void) {
+	return _count;
+}
+
+bool HISTORY_GetLast(unsigned long* time, unsigned long* values) {
+	HISTORY_CURSOR cursor;
+	// The newest block can be empty, so the record is decoded from Flash Memory
+	return (_count && HISTORY_OpenIndex(&cursor, _count - 1) && HISTORY_Next(&cursor, time, values));
+}
+
+bool HISTORY_OpenIndex(HISTORY_CURSOR* cursor, unsigned long index) {
+	if (!cursor || (index >= _count)) return false;
+	unsigned short block = 0;
+	while ((block < _nbBlocks) && (index >= _blocks[_order[block]].Count)) {
+		index -= _blocks[_order[block]].Count;
+		block++;
+	}
+	HISTORY_CursorStart(cursor, block);
+	cursor->From = 0;
+	cursor->To = 0xFFFFFFFFUL;
+	// Skip the records before index inside the block
+	while (index--) {
+		if (!HISTORY_Decode(_order[block], &cursor->Offset, _blocks[_order[block]].Offset,
+				&cursor->Time, &cursor->Delta, cursor->Values)) return false;
+	}
+	return true;
+}
+
+bool HISTORY_OpenRange(HISTORY_CURSOR* cursor, unsigned long from, unsigned long to) {
+	if (!cursor || (from > to)) return false;
+	unsigned short block = 0;
+	// Use the block index to skip all blocks that end before the requested range
+	while ((block < _nbBlocks) && (_blocks[_order[block]].LastTime < from))
+		block++;
+	HISTORY_CursorStart(cursor, block);
+	cursor->From = from;
+	cursor->To = to;
+	return true;
+}
+
+bool HISTORY_Next(HISTORY_CURSOR* cursor, unsigned long* time, unsigned long* values) {
+	if (!cursor) return false;
+	for (;;) {
+		unsigned short block = HISTORY_FindBlock(cursor->Sequence);
+		if (block >= _nbBlocks) return false;
+		int page = _order[block];
+		if (_blocks[page].Sequence != cursor->Sequence) {
+			// The block was erased since the cursor read it, go on with the oldest block left
+			HISTORY_CursorStart(cursor, block);
+			continue;
+		}
+		if (!HISTORY_Decode(page, &cursor->Offset, _blocks[page].Offset, &cursor->Time, &cursor->Delta, cursor->Values)) {
+			// Stay on the newest block, the next record will be appended to it
+			if ((block + 1) >= _nbBlocks) return false;
+			HISTORY_CursorStart(cursor, block + 1);
+			continue;
+		}
+		if (cursor->Time < cursor->From) continue;
+		if (cursor->Time > cursor->To) {
+			HISTORY_CursorStart(cursor, _nbBlocks);
+			return false;
+		}
+		if (time) *time = cursor->Time;
+		if (values) memcpy(values, cursor->Values, sizeof(cursor->Values));
+		return true;
+	}
+}
+
+#else
+
+void HISTORY_Init(void) { }
+bool HISTORY_Append(unsigned long time, const unsigned long* values) { (void)time; (void)values; return false; }
+unsigned long HISTORY_GetCount(void) { return 0; }
+bool HISTORY_GetLast(unsigned long* time, unsigned long* values) { (void)time; (void)values; return false; }
+bool HISTORY_OpenIndex(HISTORY_CURSOR* cursor, unsigned long index) { (void)cursor; (void)index; return false; }
+bool HISTORY_OpenRange(HISTORY_CURSOR* cursor, unsigned long from, unsigned long to) { (void)cursor; (void)from; (void)to; return false; }
+bool HISTORY_Next(HISTORY_CURSOR* cursor, unsigned long* time, unsigned long* values) { (void)cursor; (void)time; (void)values; return false; }
+
+#endif
+
+/** }@ */
@@ -0,0 +1,312 @@
+/*******************************************************************
+** join_retry.c                                                   **
+**                                                                **
+** Join and provisioning retry scheduler                          **
+**                                                                **
+*******************************************************************/
+/** \addtogroup S40 S40 Main Application
+ *  @{
+ */
+
+#include "global.h"
+#include "join_retry.h"
+#include "lorawan_task.h"
+#include "utilities.h"
+#include "system.h"
+#include "trace.h"
+#include <flash.h>
+
+#undef	__MODULE__
+#define	__MODULE__	FLAG_TRACE_SUPERVISOR
+
+/*
+ * Failed stages are retried after an exponential backoff with equal jitter: half of the
+ * delay is fixed, the other half is random so that a fleet of devices recovering from
+ * the same network outage spreads its requests instead of retrying in lockstep.
+ * The delay never goes below the LoRaWAN join duty cycle for the time on air of the
+ * failed attempt, which is spread as well: at SF12 it is longer than the first backoff
+ * delays and would otherwise synchronize the fleet again. After JOIN_RETRY_MAX_ATTEMPTS
+ * failures, the device sleeps for JOIN_RETRY_LONG_SLEEP before restarting the whole join
+ * procedure.
+ * The stage and attempt count are kept in an RTCC retention register so that a reset does not
+ * restart the backoff, without writing to Flash Memory on every failure.
+ * DevNonce values must never be reused, even after a power failure. They are reserved
+ * JOIN_NONCE_RESERVE at a time in records appended to their own ring of Flash Memory pages,
+ * so the user data page holding the keys is never rewritten by a join.
+ */
+/** @cond */
+#define JOIN_STAGE_NONE		0xFF
+#define JOIN_NONCE_RESERVE	16		// DevNonce values reserved per Flash Memory write
+#define JOIN_NONCE_TRIALS	3		// Join requests sent per join (see LORAWAN_JoinNetworkUseOTTA)
+#define JOIN_HOUR_TICKS		(60UL * 60 * configTICK_RATE_HZ)
+#define JOIN_PAGE_SIZE		2048	// Same as FLASH_PAGE
+#define JOIN_RECORDS		(JOIN_PAGE_SIZE / sizeof(JOIN_NONCE_RECORD))
+#define JOIN_SEQUENCE_BLANK	0xFFFFFFFFUL
+
+typedef struct {
+	uint32_t		Sequence;	// Record sequence number, the highest one is the current one
+	uint16_t		DevNonce;	// Highest DevNonce reserved for join requests
+	uint16_t		Check;		// Complement of DevNonce and of both halves of Sequence
+} JOIN_NONCE_RECORD;
+
+typedef struct {
+	unsigned long	Base;		// First retry delay (in ms)
+	unsigned long	Max;		// Maximum retry delay (in ms)
+	EVENT_TYPE		Event;		// Event running the stage
+} JOIN_STAGE_PARAMS;
+
+static const JOIN_STAGE_PARAMS JoinStageParams[JoinStages] = {
+	{ 15000, 30 * 60000, PSEUDO_JOIN_NETWORK },
+	{ 10000, 10 * 60000, REQ_REAL_APP_KEY_ALLOC },
+	{ 10000, 10 * 60000, REQ_REAL_APP_KEY_RX_REPORT },
+	{ 15000, 30 * 60000, REAL_JOIN_NETWORK },
+	{ 15000, 30 * 60000, RUN_ATTACH_USE_OTTA },
+};
+
+static const uint8_t	__attribute__((aligned(JOIN_PAGE_SIZE)))
+						__attribute__ ((__used__))
+_JOINNONCEPAGES_[JOIN_RETRY_PAGES][JOIN_PAGE_SIZE] = {
+	[0 ... (JOIN_RETRY_PAGES - 1)] = { [0 ... (JOIN_PAGE_SIZE - 1)] = 0xFF }
+};
+// Force the compiler to read real Flash Memory contents instead of the initialization values
+#define JOIN_RECORDPTR(p,r)	((volatile const JOIN_NONCE_RECORD*)&_JOINNONCEPAGES_[(p)][(r) * sizeof(JOIN_NONCE_RECORD)])
+
+static uint8_t		JoinStage = JOIN_STAGE_NONE;	// Stage being retried
+static uint8_t		JoinAttempts = 0;				// Failed attempts of the stage
+static uint16_t		ReservedNonce;					// Highest DevNonce persisted
+static bool			bNonceValid = false;			// ReservedNonce was read from or written to Flash Memory
+static int			NoncePage = 0;					// Page holding the newest record
+static unsigned		NonceRecord = 0;				// Next free record in NoncePage
+static uint32_t		NonceSequence = 0;
+static EVENT_TYPE	RetryEvent = IDLE_EVENT;	// Event to post when the retry is due
+static portTickType	RetryStart = 0;
+static portTickType	RetryDelay = 0;
+static bool			bLongSleep = false;
+static portTickType	CycleStart = 0;				// First failure of the current join procedure
+static bool			bCycleStarted = false;
+/** @endcond */
+
+static unsigned long JOINRETRYBackoff(JOIN_STAGE stage, unsigned attempts) {
+	unsigned long delay = JoinStageParams[stage].Base;
+	while ((--attempts > 0) && (delay < JoinStageParams[stage].Max)) delay <<= 1;
+	if (delay > JoinStageParams[stage].Max) delay = JoinStageParams[stage].Max;
+	return (delay / 2) + (unsigned long)randr(0, (int32_t)(delay / 2));
+}
+
+static unsigned long JOINRETRYLongSleep(void) {
+	unsigned long delay = JOIN_RETRY_LONG_SLEEP * 1000UL;
+	// +/-10% jitter
+	return delay - (delay / 10) + (unsigned long)randr(0, (int32_t)(delay / 5));
+}
+
+static unsigned long JOINRETRYDutyCycle(unsigned long timeOnAir) {
+	// Join duty cycle: 1% the first hour, 0.1% the next 10 hours, 0.01% afterwards
+	portTickType elapsed = (bCycleStarted) ? (xTaskGetTickCount() - CycleStart) : 0;
+	unsigned long factor = (elapsed < JOIN_HOUR_TICKS) ? 100 : (elapsed < (11 * JOIN_HOUR_TICKS)) ? 1000 : 10000;
+	return timeOnAir * (factor - 1);
+}
+
+static void JOINRETRYSchedule(EVENT_TYPE event, unsigned long delay) {
+	RetryEvent = event;
+	RetryStart = xTaskGetTickCount();
+	RetryDelay = (portTickType)(((unsigned long long)delay * configTICK_RATE_HZ) / 1000);
+}
+
+/*
+ * Retained stage and attempts: low half word holds them, high half word its complement
+ */
+static void JOINRETRYSaveState(void) {
+	if (SystemGetNVRAMSize() <= JOIN_RETRY_NVRAM_INDEX) return;
+	uint32_t value = (uint32_t)JoinStage | ((uint32_t)JoinAttempts << 8);
+	SystemSetNVRAMValue(JOIN_RETRY_NVRAM_INDEX, (int)(value | (~value << 16)));
+}
+
+static void JOINRETRYLoadState(void) {
+	JoinStage = JOIN_STAGE_NONE;
+	JoinAttempts = 0;
+	if (SystemGetNVRAMSize() <= JOIN_RETRY_NVRAM_INDEX) return;
+	uint32_t value = (uint32_t)SystemGetNVRAMValue(JOIN_RETRY_NVRAM_INDEX);
+	if ((value >> 16) != ((~value) & 0xFFFF)) return;
+	if (((value & 0xFF) >= JoinStages) || (((value >> 8) & 0xFF) > JOIN_RETRY_MAX_ATTEMPTS)) return;
+	JoinStage = (uint8_t)(value & 0xFF);
+	JoinAttempts = (uint8_t)((value >> 8) & 0xFF);
+}
+
+/*
+ * The check covers the sequence: an erase interrupted on the first word of a record leaves a
+ * garbage sequence in front of an older DevNonce, which must not become the newest record
+ */
+static uint16_t JOINRETRYCheck(uint32_t sequence, uint16_t devNonce) {
+	return (uint16_t)~(devNonce ^ sequence ^ (sequence >> 16));
+}
+
+/*
+ * Find the newest DevNonce reservation
+ */
+static void JOINRETRYReadNonce(void) {
+	bNonceValid = false;
+	NoncePage = 0;
+	NonceRecord = JOIN_RECORDS;		// Start on a fresh page if nothing is found
+	NonceSequence = 0;
+	for (int page = 0; page < JOIN_RETRY_PAGES; page++) {
+		for (unsigned r = 0; r < JOIN_RECORDS; r++) {
+			volatile const JOIN_NONCE_RECORD* record = JOIN_RECORDPTR(page, r);
+			if (record->Sequence == JOIN_SEQUENCE_BLANK) break;
+			if ((record->Check != JOINRETRYCheck(record->Sequence, record->DevNonce)) || (bNonceValid && (record->Sequence <= NonceSequence)))
+				continue;
+			bNonceValid = true;
+			NonceSequence = record->Sequence;
+			ReservedNonce = record->DevNonce;
+			NoncePage = page;
+			NonceRecord = r + 1;
+		}
+	}
+	// Do not append after a torn write: the next record starts on the first blank one
+	if (bNonceValid) {
+		while ((NonceRecord < JOIN_RECORDS) && (JOIN_RECORDPTR(NoncePage, NonceRecord)->Sequence != JOIN_SEQUENCE_BLANK))
+			NonceRecord++;
+	}
+}
+
+/*
+ * Append a DevNonce reservation to the Flash Memory ring
+ */
+static bool JOINRETRYWriteNonce(uint16_t devNonce) {
+	JOIN_NONCE_RECORD record = { NonceSequence + 1, devNonce, JOINRETRYCheck(NonceSequence + 1, devNonce) };
+	int page = NoncePage;
+	unsigned r = NonceRecord;
+	signed char rc = FLASH_NO_ERROR;
+	vTaskSuspendAll();
+	FLASHOpen();
+	if (r >= JOIN_RECORDS) {
+		// The other pages still hold the newest reservation if the erase is interrupted
+		page = (page + 1) % JOIN_RETRY_PAGES;
+		r = 0;
+		rc = FLASHEraseBlock((void*)JOIN_RECORDPTR(page, 0));
+	}
+	if (rc == FLASH_NO_ERROR)
+		rc = FLASHWrite((void*)JOIN_RECORDPTR(page, r), (unsigned char*)&record, sizeof(record));
+	FLASHClose();
+	xTaskResumeAll();
+	if (rc != FLASH_NO_ERROR) {
+		ERROR("DevNonce reservation write failed (%d).\n", rc);
+		NonceRecord = JOIN_RECORDS;		// Move to the next page on the next write
+		return false;
+	}
+	NoncePage = page;
+	NonceRecord = r + 1;
+	NonceSequence = record.Sequence;
+	ReservedNonce = devNonce;
+	bNonceValid = true;
+	return true;
+}
+
+void JOINRETRY_Init(void) {
+	MibRequestConfirm_t mib;
+
+	JOINRETRYLoadState();
+	JOINRETRYReadNonce();
+	mib.Type = MIB_DEV_NONCE;
+	if (bNonceValid) {
+		// Continue after the highest value that may have been used before the reboot
+		mib.Param.DevNonce = ReservedNonce;
+		LoRaMacMibSetRequestConfirm(&mib);
+	}
+	RetryEvent = IDLE_EVENT;
+	bLongSleep = false;
+	bCycleStarted = false;
+}
+
+bool JOINRETRY_Resume(void) {
+	unsigned long delay;
+
+	if ((JoinStage >= JoinStages) || (JoinAttempts == 0)) return false;
+	// The MAC session is lost: restart the whole procedure, as late as the interrupted stage would have
+	if (JoinAttempts >= JOIN_RETRY_MAX_ATTEMPTS) {
+		delay = JOINRETRYLongSleep();
+		bLongSleep = true;
+	} else {
+		delay = JOINRETRYBackoff((JOIN_STAGE)JoinStage, JoinAttempts);
+	}
+	JOINRETRYSchedule(RUN_ATTACH, delay);
+	INFO("Join resumes in %lu s (stage %d, attempt %d).\n", delay / 1000, JoinStage, JoinAttempts);
+	return true;
+}
+
+void JOINRETRY_ReserveDevNonce(void) {
+	MibRequestConfirm_t mib;
+
+	mib.Type = MIB_DEV_NONCE;
+	LoRaMacMibGetRequestConfirm(&mib);
+	uint16_t left = (uint16_t)(ReservedNonce - mib.Param.DevNonce);
+	if (!bNonceValid || (left <= JOIN_NONCE_TRIALS) || (left > JOIN_NONCE_RESERVE))
+		JOINRETRYWriteNonce((uint16_t)(mib.Param.DevNonce + JOIN_NONCE_RESERVE));
+}
+
+unsigned long JOINRETRY_Failed(JOIN_STAGE stage, unsigned long timeOnAir) {
+	unsigned long delay;
+
+	if (stage >= JoinStages) return 0;
+	if (!bCycleStarted) {
+		CycleStart = xTaskGetTickCount();
+		bCycleStarted = true;
+	}
+	if (JoinStage != stage) {
+		JoinStage = stage;
+		JoinAttempts = 0;
+	}
+	if (JoinAttempts < JOIN_RETRY_MAX_ATTEMPTS) JoinAttempts++;
+	if (JoinAttempts >= JOIN_RETRY_MAX_ATTEMPTS) {
+		delay = JOINRETRYLongSleep();
+		bLongSleep = true;
+		JOINRETRYSchedule(RUN_ATTACH, delay);
+		INFO("Too many join failures, next attempt in %lu s.\n", delay / 1000);
+	} else {
+		delay = JOINRETRYBackoff(stage, JoinAttempts);
+		unsigned long minDelay = JOINRETRYDutyCycle(timeOnAir);
+		if (delay < minDelay) delay = minDelay + (unsigned long)randr(0, (int32_t)(minDelay / 2));
+		JOINRETRYSchedule(JoinStageParams[stage].Event, delay);
+		INFO("Join stage %d retry %d in %lu ms.\n", stage, JoinAttempts, delay);
+	}
+	JOINRETRYSaveState();
+	return delay;
+}
+
+void JOINRETRY_Succeeded(JOIN_STAGE stage, bool last) {
+	if (JoinStage == stage) JoinAttempts = 0;
+	if (last) {
+		JoinStage = JOIN_STAGE_NONE;
+		JoinAttempts = 0;
+		bCycleStarted = false;
+	}
+	JOINRETRYSaveState();
+}
+
+void JOINRETRY_Cancel(void) {
+	RetryEvent = IDLE_EVENT;
+	bLongSleep = false;
+}
+
+portTickType JOINRETRY_GetTimeout(void) {
+	if (RetryEvent == IDLE_EVENT) return portMAX_DELAY;
+	portTickType elapsed = xTaskGetTickCount() - RetryStart;
+	return (elapsed >= RetryDelay) ? 0 : (RetryDelay - elapsed);
+}
+
+EVENT_TYPE JOINRETRY_Poll(void) {
+	EVENT_TYPE event = RetryEvent;
+
+	if ((event == IDLE_EVENT) || (JOINRETRY_GetTimeout() > 0)) return IDLE_EVENT;
+	RetryEvent = IDLE_EVENT;
+	if (bLongSleep) {
+		// Start over with a fresh backoff
+		bLongSleep = false;
+		bCycleStarted = false;
+		JoinStage = JOIN_STAGE_NONE;
+		JoinAttempts = 0;
+		JOINRETRYSaveState();
+	}
+	return event;
+}
+
+/** }@ */
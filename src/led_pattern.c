@@ -0,0 +1,213 @@
+/*******************************************************************
+** led_pattern.c                                                  **
+**                                                                **
+** Non blocking LED blink patterns                                **
+**                                                                **
+*******************************************************************/
+/** \addtogroup S40 S40 Main Application
+ *  @{
+ */
+
+#include "global.h"
+#include "timer.h"
+#include "led_pattern.h"
+
+/*
+ * Every LED plays its pattern from a single MAC timer: the timer IRQ advances the LEDs whose
+ * next change is due and is restarted for the earliest next change. The due times follow
+ * each other, so the pattern timing does not drift with the IRQ latency.
+ */
+/** @cond */
+#if (HAL_NB_LED > 0)
+#define LEDPATTERN_LEDS		HAL_NB_LED
+#else
+#define LEDPATTERN_LEDS		1
+#endif
+
+typedef struct {
+	const LEDPATTERN*		Pattern;	// NULL when no pattern plays
+	const LEDPATTERN_STEP*	Step;		// Step playing
+	uint8_t					Count;		// Flashes left in the step, including the playing one
+	uint8_t					Repeat;		// Sequences left, including the playing one, 0 for ever
+	bool					On;			// Playing the on part of a flash
+	bool					Steady;		// LED state without pattern
+	TimerTime_t				Due;		// Time of the next change
+	LEDPATTERN_STEP			FlashSteps[2];	// Steps of LEDPATTERN_Flash
+	LEDPATTERN				Flash;		// Pattern of LEDPATTERN_Flash
+	LEDPATTERN_STEP			AlertSteps[2];	// Steps of LEDPATTERN_Alert
+	LEDPATTERN				Alert;		// Pattern of LEDPATTERN_Alert
+} LEDPATTERN_STATE;
+
+static LEDPATTERN_STATE	LedStates[LEDPATTERN_LEDS];
+static TimerEvent_t		LedTimer;
+/** @endcond */
+
+static void LEDPATTERNSet(uint8_t led, bool on) {
+#if (HAL_NB_LED > 0)
+	SystemSetPortState(LED[led], on);
+#else
+	(void)led;
+	(void)on;
+#endif
+}
+
+static void LEDPATTERNSchedule(TimerTime_t now) {
+	TimerTime_t next = 0;
+	bool active = false;
+
+	TimerStop(&LedTimer);
+	for (uint8_t i = 0; i < LEDPATTERN_LEDS; i++) {
+		if (LedStates[i].Pattern == NULL) continue;
+		TimerTime_t delay = (TimerTime_t)(LedStates[i].Due - now);
+		if ((int32_t)delay < 1) delay = 1;
+		if (!active || (delay < next)) next = delay;
+		active = true;
+	}
+	if (active) {
+		TimerSetValue(&LedTimer, next);
+		TimerStart(&LedTimer);
+	}
+}
+
+static void LEDPATTERNStartStep(LEDPATTERN_STATE* state, uint8_t led) {
+	state->Count = state->Step->Count;
+	state->On = true;
+	LEDPATTERNSet(led, state->Step->On != 0);
+	state->Due += state->Step->On;
+}
+
+static void LEDPATTERNAdvance(LEDPATTERN_STATE* state, uint8_t led) {
+	if (state->On) {
+		state->On = false;
+		LEDPATTERNSet(led, false);
+		state->Due += state->Step->Off;
+		return;
+	}
+	if (--state->Count > 0) {
+		state->On = true;
+		LEDPATTERNSet(led, state->Step->On != 0);
+		state->Due += state->Step->On;
+		return;
+	}
+	state->Step++;
+	if (state->Step->Count == 0) {
+		if (state->Repeat == 1) {
+			state->Pattern = NULL;
+			LEDPATTERNSet(led, state->Steady);
+			return;
+		}
+		if (state->Repeat) state->Repeat--;
+		state->Step = state->Pattern->Steps;
+	}
+	LEDPATTERNStartStep(state, led);
+}
+
+static void LEDPATTERNOnTimer(void) {
+	TimerTime_t now = TimerGetCurrentTime();
+
+	for (uint8_t i = 0; i < LEDPATTERN_LEDS; i++) {
+		// A long IRQ latency plays the late changes at once rather than stretching the pattern
+		while ((LedStates[i].Pattern != NULL) && ((int32_t)(now - LedStates[i].Due) >= 0))
+			LEDPATTERNAdvance(&LedStates[i], i);
+	}
+	LEDPATTERNSchedule(now);
+}
+
+void LEDPATTERN_Init(void) {
+	memset(LedStates, 0, sizeof(LedStates));
+	TimerInit(&LedTimer, LEDPATTERNOnTimer);
+}
+
+bool LEDPATTERN_Play(uint8_t led, const LEDPATTERN* pattern) {
+	LEDPATTERN_STATE* state;
+	TimerTime_t now;
+
+	if ((led >= LEDPATTERN_LEDS) || (pattern == NULL) || (pattern->Steps[0].Count == 0)) return false;
+	state = &LedStates[led];
+	SystemIrqDisable();
+	if ((state->Pattern != NULL) && (state->Pattern->Priority > pattern->Priority)) {
+		SystemIrqEnable();
+		return false;
+	}
+	now = TimerGetCurrentTime();
+	state->Pattern = pattern;
+	state->Step = pattern->Steps;
+	state->Repeat = pattern->Repeat;
+	state->Due = now;
+	LEDPATTERNStartStep(state, led);
+	LEDPATTERNSchedule(now);
+	SystemIrqEnable();
+	return true;
+}
+
+static bool LEDPATTERNFlashes(uint8_t led, LEDPATTERN* pattern, LEDPATTERN_STEP* steps, uint8_t count, uint16_t period, uint8_t priority) {
+	LEDPATTERN_STATE* state = &LedStates[led];
+	bool played;
+
+	SystemIrqDisable();
+	// A higher priority pattern keeps playing and the steps it may be using are kept
+	if ((state->Pattern != NULL) && (state->Pattern->Priority > priority)) {
+		SystemIrqEnable();
+		return false;
+	}
+	state->Pattern = NULL;	// Restarted with the new steps
+	steps[0].On = period;
+	steps[0].Off = period;
+	steps[0].Count = (count) ? count : 1;
+	steps[1].Count = 0;
+	pattern->Steps = steps;
+	pattern->Repeat = (count) ? 1 : 0;
+	pattern->Priority = priority;
+	played = LEDPATTERN_Play(led, pattern);
+	SystemIrqEnable();
+	return played;
+}
+
+bool LEDPATTERN_Flash(uint8_t led, uint8_t count, uint16_t period) {
+	if (led >= LEDPATTERN_LEDS) return false;
+	return LEDPATTERNFlashes(led, &LedStates[led].Flash, LedStates[led].FlashSteps, count, period, LEDPATTERN_PRIORITY_FLASH);
+}
+
+bool LEDPATTERN_Alert(uint8_t led, uint8_t count, uint16_t period) {
+	if ((led >= LEDPATTERN_LEDS) || (count == 0)) return false;
+	return LEDPATTERNFlashes(led, &LedStates[led].Alert, LedStates[led].AlertSteps, count, period, LEDPATTERN_PRIORITY_ALERT);
+}
+
+void LEDPATTERN_StopFlash(uint8_t led) {
+	if (led >= LEDPATTERN_LEDS) return;
+	LEDPATTERN_Stop(led, &LedStates[led].Flash);
+}
+
+void LEDPATTERN_Stop(uint8_t led, const LEDPATTERN* pattern) {
+	if (led >= LEDPATTERN_LEDS) return;
+	SystemIrqDisable();
+	if ((LedStates[led].Pattern != NULL) && ((pattern == NULL) || (LedStates[led].Pattern == pattern))) {
+		LedStates[led].Pattern = NULL;
+		LEDPATTERNSet(led, LedStates[led].Steady);
+		LEDPATTERNSchedule(TimerGetCurrentTime());
+	}
+	SystemIrqEnable();
+}
+
+bool LEDPATTERN_IsPlaying(uint8_t led) {
+	return (led < LEDPATTERN_LEDS) && (LedStates[led].Pattern != NULL);
+}
+
+void LEDPATTERN_Wait(uint8_t led) {
+	while (LEDPATTERN_IsPlaying(led))
+		vTaskDelay(configTICK_RATE_HZ / 50);
+}
+
+void LEDPATTERN_SetSteady(uint8_t led, bool on) {
+	if (led >= LEDPATTERN_LEDS) return;
+	SystemIrqDisable();
+	LedStates[led].Steady = on;
+	if (LedStates[led].Pattern == NULL) LEDPATTERNSet(led, on);
+	SystemIrqEnable();
+}
+
+bool LEDPATTERN_GetSteady(uint8_t led) {
+	return (led < LEDPATTERN_LEDS) && LedStates[led].Steady;
+}
+
+/** }@ */
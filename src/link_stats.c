@@ -0,0 +1,184 @@
+/*******************************************************************
+** link_stats.c                                                   **
+**                                                                **
+** LoRaWAN link quality statistics                                **
+**                                                                **
+*******************************************************************/
+/** \addtogroup S40 S40 Main Application
+ *  @{
+ */
+
+#include <string.h>
+#include "global.h"
+#include "link_stats.h"
+#include "lorawan_task.h"
+#include "SKTApp.h"
+#include "system.h"
+#include "trace.h"
+
+#undef	__MODULE__
+#define	__MODULE__	FLAG_TRACE_SUPERVISOR
+
+/*
+ * All counters have a fixed size and are only updated from the LoRaWAN event task, except the
+ * listen before talk counters which are updated by the radio driver, from the MAC timer IRQs. The packet error rate is
+ * estimated from the outcome of the last LINKSTATS_PER_WINDOW radio transmissions of confirmed
+ * frames: every retransmission is a lost transmission, the last one is lost when no
+ * acknowledgment was received. Unconfirmed frames do not tell whether they were received.
+ */
+/** @cond */
+#define LINKSTATS_REPORT_VERSION	1
+#define LINKSTATS_NO_COUNTER		0xFFFFFFFFUL
+#define LINKSTATS_REPORT_HEADER		20		// Version, 9 totals and packet error rate
+#define LINKSTATS_REPORT_SIZE		(LINKSTATS_REPORT_HEADER + 5 * LINKSTATS_DATARATES)
+
+static LINKSTATS	LinkStats;
+static uint32_t		PerHistory = 0;			// 1 bit per transmission, 1 = lost
+static uint8_t		PerCount = 0;			// Valid bits in PerHistory
+static uint32_t		LastDownlink = LINKSTATS_NO_COUNTER;
+/** @endcond */
+
+static uint8_t LINKSTATSBin(int value, int top, int step) {
+	uint8_t bin = 0;
+	while ((bin < (LINKSTATS_BINS - 1)) && (value < (top - (bin + 1) * step))) bin++;
+	return bin;
+}
+
+static void LINKSTATSCount(uint16_t* bin) {
+	if (*bin != 0xFFFF) (*bin)++;
+}
+
+static void LINKSTATSPerPush(bool lost) {
+	PerHistory = (PerHistory << 1) | (lost ? 1 : 0);
+	if (PerCount < LINKSTATS_PER_WINDOW) PerCount++;
+}
+
+static uint8_t* LINKSTATSPut16(uint8_t* p, uint32_t value) {
+	if (value > 0xFFFF) value = 0xFFFF;
+	*p++ = (uint8_t)(value >> 8);
+	*p++ = (uint8_t)value;
+	return p;
+}
+
+static int8_t LINKSTATSMean(int32_t sum, uint16_t count) {
+	int32_t mean = sum / (int32_t)count;
+	if (mean < -128) mean = -128;
+	if (mean > 127) mean = 127;
+	return (int8_t)mean;
+}
+
+void LINKSTATS_Reset(void) {
+	taskENTER_CRITICAL();
+	memset(&LinkStats, 0, sizeof(LinkStats));
+	PerHistory = 0;
+	PerCount = 0;
+	LastDownlink = LINKSTATS_NO_COUNTER;
+	taskEXIT_CRITICAL();
+}
+
+void LINKSTATS_Uplink(uint8_t channel, uint8_t datarate, bool confirmed, uint8_t transmissions, bool acked) {
+	LinkStats.Uplinks++;
+	if (channel < LINKSTATS_CHANNELS) LinkStats.UplinksPerChannel[channel]++;
+	if (datarate < LINKSTATS_DATARATES) LinkStats.UplinksPerDatarate[datarate]++;
+	if (!confirmed) return;
+
+	if (transmissions == 0) transmissions = 1;
+	LinkStats.Confirmed++;
+	LinkStats.Transmissions += transmissions;
+	if (!acked) LinkStats.AckMissed++;
+	while (--transmissions > 0) LINKSTATSPerPush(true);
+	LINKSTATSPerPush(!acked);
+}
+
+void LINKSTATS_Downlink(uint8_t channel, uint8_t datarate, int16_t rssi, int8_t snr, uint32_t counter) {
+	uint8_t rssiBin = LINKSTATSBin(rssi, LINKSTATS_RSSI_TOP, LINKSTATS_RSSI_STEP);
+	uint8_t snrBin = LINKSTATSBin(snr, LINKSTATS_SNR_TOP, LINKSTATS_SNR_STEP);
+
+	if (channel == LINKSTATS_CHANNEL_RX2) LinkStats.Rx2++;
+	else LinkStats.Rx1++;
+	if (channel <= LINKSTATS_CHANNEL_RX2) {
+		LINKSTATSCount(&LinkStats.PerChannel[channel].Rssi[rssiBin]);
+		LINKSTATSCount(&LinkStats.PerChannel[channel].Snr[snrBin]);
+	}
+	if ((datarate < LINKSTATS_DATARATES) && (LinkStats.Samples[datarate] != 0xFFFF)) {
+		LinkStats.Samples[datarate]++;
+		LinkStats.RssiSum[datarate] += rssi;
+		LinkStats.SnrSum[datarate] += snr;
+		LINKSTATSCount(&LinkStats.PerDatarate[datarate].Rssi[rssiBin]);
+		LINKSTATSCount(&LinkStats.PerDatarate[datarate].Snr[snrBin]);
+	}
+	// A downlink counter going backward means a new session: only forward gaps are losses
+	if ((LastDownlink != LINKSTATS_NO_COUNTER) && (counter > LastDownlink + 1))
+		LinkStats.DownlinkLost += counter - LastDownlink - 1;
+	LastDownlink = counter;
+}
+
+void LINKSTATS_ChannelSensed(bool free) {
+	SystemIrqDisable();
+	LinkStats.LbtChecks++;
+	if (!free) LinkStats.LbtBusy++;
+	SystemIrqEnable();
+}
+
+int LINKSTATS_GetPER(void) {
+	if (PerCount == 0) return -1;
+	uint32_t history = (PerCount < LINKSTATS_PER_WINDOW) ? (PerHistory & ((1UL << PerCount) - 1)) : PerHistory;
+	return (__builtin_popcountl(history) * 100) / PerCount;
+}
+
+const LINKSTATS* LINKSTATS_Get(void) {
+	return &LinkStats;
+}
+
+uint8_t LINKSTATS_Encode(uint8_t* buffer, uint8_t size) {
+	uint8_t* p = buffer;
+	int per = LINKSTATS_GetPER();
+	uint32_t lbtChecks, lbtBusy;
+
+	if (size < LINKSTATS_REPORT_HEADER) return 0;
+	SystemIrqDisable();
+	lbtChecks = LinkStats.LbtChecks;
+	lbtBusy = LinkStats.LbtBusy;
+	SystemIrqEnable();
+	*p++ = LINKSTATS_REPORT_VERSION;
+	p = LINKSTATSPut16(p, LinkStats.Uplinks);
+	p = LINKSTATSPut16(p, LinkStats.Confirmed);
+	p = LINKSTATSPut16(p, LinkStats.Transmissions);
+	p = LINKSTATSPut16(p, LinkStats.AckMissed);
+	p = LINKSTATSPut16(p, LinkStats.Rx1);
+	p = LINKSTATSPut16(p, LinkStats.Rx2);
+	p = LINKSTATSPut16(p, LinkStats.DownlinkLost);
+	p = LINKSTATSPut16(p, lbtChecks);
+	p = LINKSTATSPut16(p, lbtBusy);
+	*p++ = (per < 0) ? 0xFF : (uint8_t)per;
+	for (uint8_t dr = 0; dr < LINKSTATS_DATARATES; dr++) {
+		if (LinkStats.Samples[dr] == 0) continue;
+		if ((p - buffer) + 5 > size) break;
+		*p++ = dr;
+		p = LINKSTATSPut16(p, LinkStats.Samples[dr]);
+		*p++ = (uint8_t)LINKSTATSMean(LinkStats.RssiSum[dr], LinkStats.Samples[dr]);
+		*p++ = (uint8_t)LINKSTATSMean(LinkStats.SnrSum[dr], LinkStats.Samples[dr]);
+	}
+	return (uint8_t)(p - buffer);
+}
+
+bool LINKSTATS_Send(void) {
+	uint8_t report[LINKSTATS_REPORT_SIZE];
+	LoRaMacTxInfo_t txInfo;
+	uint8_t size = sizeof(report);
+
+	// Per data rate entries that do not fit in the current data rate payload are left out
+	LoRaMacQueryTxPossible(0, &txInfo);
+	if (txInfo.MaxPossiblePayload < (size + LORA_MESSAGE_HEADER_SIZE))
+		size = (txInfo.MaxPossiblePayload > LORA_MESSAGE_HEADER_SIZE) ? (txInfo.MaxPossiblePayload - LORA_MESSAGE_HEADER_SIZE) : 0;
+	uint8_t len = LINKSTATS_Encode(report, size);
+	if (len == 0) {
+		ERROR("Link statistics report does not fit in %d bytes.\n", txInfo.MaxPossiblePayload);
+		return false;
+	}
+
+	INFO("Sending link statistics report (%d bytes).\n", len);
+	return SKTAPP_Send(SKT_DEVICE_SERVICE_PORT, MSG_SKT_DEV_LINK_STATS, report, len);
+}
+
+/** }@ */
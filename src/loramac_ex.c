@@ -328,6 +328,24 @@ bool	LORAMAC_SetADR(bool bADR)
 	return	(LoRaMacMibSetRequestConfirm( &mibReq )  == LORAMAC_STATUS_OK);
 }
 
+bool	LORAMAC_GetADRPredict(void)
+{
+	mibReq.Type =  MIB_ADR_PREDICT;
+	mibReq.Param.AdrPredictEnable = false;
+
+	LoRaMacMibGetRequestConfirm( &mibReq );
+
+	return	mibReq.Param.AdrPredictEnable;
+}
+
+bool	LORAMAC_SetADRPredict(bool bPredict)
+{
+	mibReq.Type =  MIB_ADR_PREDICT;
+	mibReq.Param.AdrPredictEnable = bPredict;
+
+	return	(LoRaMacMibSetRequestConfirm( &mibReq )  == LORAMAC_STATUS_OK);
+}
+
 bool	LORAMAC_TxCW(uint32_t xTimeout)
 {
 	MlmeReq_t mlmeReq;
@@ -9,13 +9,15 @@
 #include "Commissioning.h"
 #include "trace.h"
 #include "SKTApp.h"
+#include "join_retry.h"
+#include "link_stats.h"
+#include "warm_start.h"
 /** \addtogroup S40 S40 Main Application
  *  @{
  */
 #undef	__MODULE__
 #define	__MODULE__	FLAG_TRACE_LORAWAN
 
-static LORA_PACKET messageIn;
 static xSemaphoreHandle LORAWANSemaphore;
 
 #define LORAWAN_TIMEOUT			(50 * configTICK_RATE_HZ)	//!< LORAWAN_SendMessage Timeout value
@@ -24,18 +26,19 @@ static struct
 {
 	MlmeConfirm_t		mlme;
 	McpsConfirm_t		confirm;
-	McpsIndication_t	indication;
 } LocalMcps;
 
 static uint16_t LoRaDownLinkCounter = 0;
 static LoRaMacPrimitives_t LoRaMacPrimitives;
 static LoRaMacCallback_t LoRaMacCallbacks;
 static MibRequestConfirm_t mibReq;
+static volatile uint32_t TxDoneUpLinkCounter;	// Frame counter of the last data uplink sent
 
 /** @cond */
 #define MLME_EVENT			(0x01 << 0)
 #define CONFIRM_EVENT		(0x01 << 1)
 #define INDICATION_EVENT	(0x01 << 2)
+#define TXDONE_EVENT		(0x01 << 3)
 
 #define RF_EVENT_STACK		( configMINIMAL_STACK_SIZE * 8)
 static StackType_t RFEventStack[RF_EVENT_STACK];
@@ -48,8 +51,56 @@ static	LoRaWANStatus_t	LoRaWAN_Status = LORAWAN_STATUS_IDLE;
 static uint8_t		nSNR = 0;
 static int16_t		nRSSI = 0;
 
+/*
+ * The MAC decrypts a received payload straight into the Data of a free frame of the pool,
+ * claimed by GetRxBuffer. The indication callback then only records the frame information and
+ * passes the frame pointer, and its reference, to the event task. The frame stays valid while
+ * it is referenced, even if the MAC receives another frame.
+ */
+static LORAWAN_RX_FRAME	RxFrames[LORAWAN_RX_FRAMES];
+static LORAWAN_RX_FRAME* RxReceivingFrame = NULL;	// Frame owned by the MAC, until its indication
+static LORAWAN_RX_FRAME* RxPendingFrame = NULL;	// Frame waiting for the supervisor task
+static StaticQueue_t	RxQueueBuffer;
+static uint8_t			RxQueueStorage[LORAWAN_RX_FRAMES * sizeof(LORAWAN_RX_FRAME*)];
+static QueueHandle_t	RxQueue = NULL;
+
 /** @endcond */
 
+/*!
+ * @brief Process a received frame in the event task context
+ * @param[in] frame	Received frame, released on return
+ */
+static void ProcessIndication(LORAWAN_RX_FRAME* frame)
+{
+	McpsIndication_t* ind = &frame->Indication;
+
+	nRSSI = ind->Rssi;
+	nSNR  = ind->Snr;
+	if (ind->Status == LORAMAC_EVENT_INFO_STATUS_OK)
+	{
+		LINKSTATS_Downlink((ind->RxSlot == 0) ? ind->Channel : LINKSTATS_CHANNEL_RX2,
+				ind->RxDatarate, ind->Rssi, (int8_t)ind->Snr, ind->DownLinkCounter);
+	}
+	TRACE(5, "Indication event.\n");
+	// Indication event
+	// Perform any specific action
+	// and post event to let other tasks know
+	if (SKTAPP_ParseMessage(frame) == false)
+	{
+		LORAWAN_RX_FRAME* old;
+
+		// The supervisor gets its own reference, an unprocessed older frame is dropped
+		taskENTER_CRITICAL();
+		old = RxPendingFrame;
+		RxPendingFrame = frame;
+		frame->Refs++;
+		taskEXIT_CRITICAL();
+		LORAWAN_ReleaseFrame(old);
+		DevicePostEvent(RF_INDICATION);
+	}
+	LORAWAN_ReleaseFrame(frame);
+}
+
 static __attribute__((noreturn)) void LORAWAN_EventTask(void* pvParameter)
 {
 	uint32_t ulNotificationValue;
@@ -109,17 +160,36 @@ static __attribute__((noreturn)) void LORAWAN_EventTask(void* pvParameter)
 		            }
 		            break;
 		        }
+		        case MLME_DEV_TIME:
+		        {
+		            if( LocalMcps.mlme.Status == LORAMAC_EVENT_INFO_STATUS_OK )
+		            {
+		    			DevicePostEvent(RF_MLME);
+		            }
+		            break;
+		        }
 		        default:
 		            break;
 		    }
 		    if (LORAWANSemaphore) xSemaphoreGive( LORAWANSemaphore);
 		}
+		if (ulNotificationValue & TXDONE_EVENT)
+		{
+			// The frame is on air, a reset during the receive windows must not send its counter again
+			WARMSTART_TxDone(TxDoneUpLinkCounter);
+		}
 		if (ulNotificationValue & CONFIRM_EVENT)
 		{
         	TRACE(5, "Confirm event.\n");
 			// Confirm event
 			// Perform any specific action
 			// and Give Semaphore to unlock waiting task
+		    if( LocalMcps.confirm.Status != LORAMAC_EVENT_INFO_STATUS_TX_TIMEOUT )
+		    {
+		    	LINKSTATS_Uplink(LocalMcps.confirm.Channel, LocalMcps.confirm.Datarate,
+		    			(LocalMcps.confirm.McpsRequest == MCPS_CONFIRMED),
+		    			LocalMcps.confirm.NbRetries, LocalMcps.confirm.AckReceived);
+		    }
 		    if( LocalMcps.confirm.Status == LORAMAC_EVENT_INFO_STATUS_OK )
 		    {
 		    	LoRaDownLinkCounter++;
@@ -153,21 +223,19 @@ static __attribute__((noreturn)) void LORAWAN_EventTask(void* pvParameter)
 		    {
 		    	ERROR("Error : %d\n", LocalMcps.confirm.Status );
 		    }
+		    // Keep the frame counters before the waiting task goes on
+		    WARMSTART_Update();
 
 		    if (LORAWANSemaphore) xSemaphoreGive( LORAWANSemaphore);
 		}
 		if (ulNotificationValue & INDICATION_EVENT)
 		{
-			nRSSI = LocalMcps.indication.Rssi;
-			nSNR  = LocalMcps.indication.Snr;
-	       	TRACE(5, "Indication event.\n");
-			// Indication event
-			// Perform any specific action
-			// and post event to let other tasks know
-	       	if (SKTAPP_ParseMessage(LORAWAN_GetIndication()) == false)
-	       	{
-				DevicePostEvent(RF_INDICATION);
-	       	}
+			LORAWAN_RX_FRAME* frame;
+
+			while (xQueueReceive(RxQueue, &frame, 0) == pdTRUE)
+			{
+				ProcessIndication(frame);
+			}
 		}
 	}
 	__builtin_unreachable();
@@ -205,14 +273,91 @@ static void McpsConfirm( McpsConfirm_t *mcpsConfirm )
 	memcpy(&LocalMcps.confirm,mcpsConfirm,sizeof(McpsConfirm_t));
 	if (LORAWANEventTask) xTaskNotifyFromISR(LORAWANEventTask,CONFIRM_EVENT,eSetBits,NULL);
 }
+/*!
+ * \brief   Data uplink TX done event function
+ *
+ * \param   [IN] upLinkCounter - Frame counter the uplink was sent with
+ */
+static void TxDone( uint32_t upLinkCounter )
+{
+	TxDoneUpLinkCounter = upLinkCounter;
+	if (LORAWANEventTask) xTaskNotifyFromISR(LORAWANEventTask,TXDONE_EVENT,eSetBits,NULL);
+}
+/*!
+ * \brief   Claims a free frame of the pool, with one reference
+ *
+ * \retval  Frame, NULL if all frames are in use
+ */
+static LORAWAN_RX_FRAME* ClaimFrame(void)
+{
+	for (int i = 0 ; i < LORAWAN_RX_FRAMES ; i++)
+	{
+		if (RxFrames[i].Refs == 0)
+		{
+			RxFrames[i].Refs = 1;
+			return	&RxFrames[i];
+		}
+	}
+	return	NULL;
+}
+/*!
+ * \brief   Gives the MAC a frame of the pool to decrypt the next received payload into
+ *
+ * \param   [IN] size - Payload size
+ * \retval  Frame payload buffer, NULL if the payload does not fit or all frames are in use
+ */
+static uint8_t* GetRxBuffer( uint8_t size )
+{
+	// A frame the MAC got without an indication, like a repeated downlink, is used again
+	if (RxReceivingFrame == NULL) RxReceivingFrame = ClaimFrame();
+	if ((RxReceivingFrame == NULL) || (size > LORAWAN_RX_FRAME_SIZE)) return NULL;
+	return	RxReceivingFrame->Data;
+}
 /*!
  * \brief   MCPS-Indication event function
  *
  * \param   [IN] mcpsIndication - Pointer to the indication structure,
  *               containing indication attributes.
- */static void McpsIndication( McpsIndication_t *mcpsIndication )
+ */
+static void McpsIndication( McpsIndication_t *mcpsIndication )
 {
-	memcpy(&LocalMcps.indication,mcpsIndication,sizeof(McpsIndication_t));
+	LORAWAN_RX_FRAME* frame = RxReceivingFrame;
+	uint8_t size = mcpsIndication->BufferSize;
+
+	if ((frame != NULL) && (mcpsIndication->Buffer == frame->Data))
+	{
+		// The payload is already in the frame, the MAC hands its reference over
+		RxReceivingFrame = NULL;
+	}
+	else
+	{
+		// No payload, or the pool was empty when it was received: it is copied if a frame is free
+		frame = ClaimFrame();
+		if (frame == NULL) return;
+		if (size > LORAWAN_RX_FRAME_SIZE) size = LORAWAN_RX_FRAME_SIZE;
+		if (mcpsIndication->Buffer && size) memcpy(frame->Data, mcpsIndication->Buffer, size);
+	}
+	if (RxQueue == NULL)
+	{
+		frame->Refs = 0;
+		return;
+	}
+
+	frame->Indication = *mcpsIndication;
+	frame->Indication.Buffer = frame->Data;
+	frame->Indication.BufferSize = size;
+	frame->Packet.Port = mcpsIndication->Port;
+	frame->Packet.Request = mcpsIndication->McpsIndication;
+	frame->Packet.Status = mcpsIndication->Status;
+	frame->Packet.NbTrials = 0;
+	frame->Packet.FramePending = mcpsIndication->FramePending;
+	frame->Packet.Size = size;
+	frame->Packet.Buffer = frame->Data;
+	if (xQueueSendFromISR(RxQueue, &frame, NULL) != pdTRUE)
+	{
+		frame->Refs = 0;
+		return;
+	}
 	if (LORAWANEventTask) xTaskNotifyFromISR(LORAWANEventTask,INDICATION_EVENT,eSetBits,NULL);
 }
 
@@ -225,13 +370,17 @@ void LORAWAN_Init(void)
 
 	static StaticSemaphore_t xRFSemaphoreBuffer;
 	LORAWANSemaphore = xSemaphoreCreateBinaryStatic( &xRFSemaphoreBuffer );
+	RxQueue = xQueueCreateStatic( LORAWAN_RX_FRAMES, sizeof(LORAWAN_RX_FRAME*), RxQueueStorage, &RxQueueBuffer );
 	LoRaMacPrimitives.MacMcpsConfirm = McpsConfirm;
 	LoRaMacPrimitives.MacMcpsIndication = McpsIndication;
 	LoRaMacPrimitives.MacMlmeConfirm = MlmeConfirm;
 	LoRaMacCallbacks.GetBatteryLevel = BoardGetBatteryLevel;
+	LoRaMacCallbacks.GetRxBuffer = GetRxBuffer;
+	LoRaMacCallbacks.TxDone = TxDone;
 	LoRaMacInitialization( &LoRaMacPrimitives, &LoRaMacCallbacks,UNIT_REGION );
 
 	LORAMAC_SetADR(LORAWAN_ADR_ON);
+	LORAMAC_SetADRPredict(LORAWAN_ADR_PREDICT_ON);
 	LORAMAC_SetPublicNetwork(LORAWAN_PUBLIC_NETWORK);
 	LORAMAC_SetDutyCycle(PHY_DUTY_CYCLE);
 
@@ -266,7 +415,7 @@ void LORAWAN_Init(void)
 	}
 #endif
 
-    memset(&LocalMcps,0,sizeof(McpsIndication_t));
+    memset(&LocalMcps,0,sizeof(LocalMcps));
 }
 
 
@@ -318,6 +467,7 @@ bool LORAWAN_JoinNetworkUseOTTA(uint8_t* pDevEUI, uint8_t* pAppEUI, uint8_t* pAp
 
 	if (LORAWANSemaphore) xSemaphoreTake( LORAWANSemaphore, 0 );
 
+	JOINRETRY_ReserveDevNonce();
 	if (LoRaMacMlmeRequest( &mlmeReq ) != LORAMAC_STATUS_OK)
 	{
 		ERROR("LoRaMacMlmeRequest failed.\n");
@@ -499,20 +649,199 @@ LoRaMacStatus_t LORAWAN_SendMessage( LORA_PACKET* message )
     return result;
 }
 
-LORA_PACKET* LORAWAN_GetMessage(void)
+/*
+ * Number of channel mask words used by the region
+ */
+static uint8_t LORAWANChannelsMaskSize(void)
+{
+	switch(UNIT_REGION)
+	{
+	case	LORAMAC_REGION_AU915:
+	case	LORAMAC_REGION_CN470:
+	case	LORAMAC_REGION_US915:
+	case	LORAMAC_REGION_US915_HYBRID:
+		return	6;
+	default:
+		return	1;
+	}
+}
+
+void LORAWAN_GetSession(LORAWAN_SESSION* session)
+{
+	MibRequestConfirm_t mib;
+
+	memset(session, 0, sizeof(LORAWAN_SESSION));
+
+	mib.Type = MIB_NET_ID;
+	LoRaMacMibGetRequestConfirm( &mib );
+	session->NetID = mib.Param.NetID;
+
+	mib.Type = MIB_DEV_ADDR;
+	LoRaMacMibGetRequestConfirm( &mib );
+	session->DevAddr = mib.Param.DevAddr;
+
+	mib.Type = MIB_NWK_SKEY;
+	LoRaMacMibGetRequestConfirm( &mib );
+	memcpy(session->NwkSKey, mib.Param.NwkSKey, sizeof(session->NwkSKey));
+
+	mib.Type = MIB_APP_SKEY;
+	LoRaMacMibGetRequestConfirm( &mib );
+	memcpy(session->AppSKey, mib.Param.AppSKey, sizeof(session->AppSKey));
+
+	mib.Type = MIB_UPLINK_COUNTER;
+	LoRaMacMibGetRequestConfirm( &mib );
+	session->UpLinkCounter = mib.Param.UpLinkCounter;
+
+	mib.Type = MIB_DOWNLINK_COUNTER;
+	LoRaMacMibGetRequestConfirm( &mib );
+	session->DownLinkCounter = mib.Param.DownLinkCounter;
+
+	mib.Type = MIB_RX2_CHANNEL;
+	LoRaMacMibGetRequestConfirm( &mib );
+	session->Rx2Frequency = mib.Param.Rx2Channel.Frequency;
+	session->Rx2Datarate = mib.Param.Rx2Channel.Datarate;
+
+	mib.Type = MIB_CHANNELS;
+	LoRaMacMibGetRequestConfirm( &mib );
+	for(int i = 0 ; i < LORAWAN_SESSION_CHANNELS ; i++)
+	{
+		ChannelParams_t* channel = &mib.Param.ChannelList[LORAWAN_SESSION_FIRST_CHANNEL + i];
+
+		if (channel->Frequency != 0)
+		{
+			session->Channels[i] = ((channel->Frequency / 100) & 0x00FFFFFF) | ((uint32_t)(uint8_t)channel->DrRange.Value << 24);
+		}
+	}
+
+	mib.Type = MIB_CHANNELS_MASK;
+	LoRaMacMibGetRequestConfirm( &mib );
+	memcpy(session->ChannelsMask, mib.Param.ChannelsMask, LORAWANChannelsMaskSize() * sizeof(uint16_t));
+
+	mib.Type = MIB_RECEIVE_DELAY_1;
+	LoRaMacMibGetRequestConfirm( &mib );
+	session->ReceiveDelay1 = (uint16_t)mib.Param.ReceiveDelay1;
+
+	mib.Type = MIB_CHANNELS_DATARATE;
+	LoRaMacMibGetRequestConfirm( &mib );
+	session->Datarate = mib.Param.ChannelsDatarate;
+
+	mib.Type = MIB_CHANNELS_TX_POWER;
+	LoRaMacMibGetRequestConfirm( &mib );
+	session->TxPower = mib.Param.ChannelsTxPower;
+}
+
+bool LORAWAN_RestoreSession(const LORAWAN_SESSION* session)
+{
+	MibRequestConfirm_t mib;
+
+	mib.Type = MIB_NET_ID;
+	mib.Param.NetID = session->NetID;
+	LoRaMacMibSetRequestConfirm( &mib );
+
+	mib.Type = MIB_DEV_ADDR;
+	mib.Param.DevAddr = session->DevAddr;
+	LoRaMacMibSetRequestConfirm( &mib );
+
+	mib.Type = MIB_NWK_SKEY;
+	mib.Param.NwkSKey = (uint8_t*)session->NwkSKey;
+	LoRaMacMibSetRequestConfirm( &mib );
+
+	mib.Type = MIB_APP_SKEY;
+	mib.Param.AppSKey = (uint8_t*)session->AppSKey;
+	LoRaMacMibSetRequestConfirm( &mib );
+
+	mib.Type = MIB_UPLINK_COUNTER;
+	mib.Param.UpLinkCounter = session->UpLinkCounter;
+	LoRaMacMibSetRequestConfirm( &mib );
+
+	mib.Type = MIB_DOWNLINK_COUNTER;
+	mib.Param.DownLinkCounter = session->DownLinkCounter;
+	LoRaMacMibSetRequestConfirm( &mib );
+
+	// Channels added by the network, the default channels are refused by the region
+	for(int i = 0 ; i < LORAWAN_SESSION_CHANNELS ; i++)
+	{
+		ChannelParams_t channel = { 0, 0, { 0 }, 0 };
+
+		if (session->Channels[i] == 0) continue;
+		channel.Frequency = (session->Channels[i] & 0x00FFFFFF) * 100;
+		channel.DrRange.Value = (int8_t)(session->Channels[i] >> 24);
+		LoRaMacChannelAdd(LORAWAN_SESSION_FIRST_CHANNEL + i, channel);
+	}
+
+	mib.Type = MIB_CHANNELS_MASK;
+	mib.Param.ChannelsMask = (uint16_t*)session->ChannelsMask;
+	if (LoRaMacMibSetRequestConfirm( &mib ) != LORAMAC_STATUS_OK)
+	{
+		return	false;
+	}
+
+	mib.Type = MIB_RX2_CHANNEL;
+	mib.Param.Rx2Channel.Frequency = session->Rx2Frequency;
+	mib.Param.Rx2Channel.Datarate = session->Rx2Datarate;
+	LoRaMacMibSetRequestConfirm( &mib );
+
+	mib.Type = MIB_RECEIVE_DELAY_1;
+	mib.Param.ReceiveDelay1 = session->ReceiveDelay1;
+	LoRaMacMibSetRequestConfirm( &mib );
+
+	mib.Type = MIB_RECEIVE_DELAY_2;
+	mib.Param.ReceiveDelay2 = session->ReceiveDelay1 + 1000;
+	LoRaMacMibSetRequestConfirm( &mib );
+
+	mib.Type = MIB_CHANNELS_DATARATE;
+	mib.Param.ChannelsDatarate = session->Datarate;
+	LoRaMacMibSetRequestConfirm( &mib );
+
+	mib.Type = MIB_CHANNELS_TX_POWER;
+	mib.Param.ChannelsTxPower = session->TxPower;
+	LoRaMacMibSetRequestConfirm( &mib );
+
+	mib.Type = MIB_NETWORK_JOINED;
+	mib.Param.IsNetworkJoined = true;
+	LoRaMacMibSetRequestConfirm( &mib );
+
+	return	true;
+}
+
+bool LORAWAN_DispatchFrame(LORAWAN_RX_FRAME* frame, const LORAWAN_PORT* ports)
 {
-McpsIndication_t *ind = LORAWAN_GetIndication();
-	if (ind && (ind->RxData))
+	for( ; ports->Handler != NULL ; ports++)
 	{
-		messageIn.Port = ind->Port;
-		messageIn.Buffer = ind->Buffer;
-		messageIn.Size = ind->BufferSize;
-		messageIn.Request = ind->McpsIndication;
-		messageIn.Status = ind->Status;
-		messageIn.FramePending = ind->FramePending;
-		return &messageIn;
+		if (ports->Port == frame->Packet.Port)
+		{
+			return	ports->Handler(frame);
+		}
 	}
-	return NULL;
+	TRACE(5, "Unknown Port : %d\n", frame->Packet.Port);
+	return	false;
+}
+
+LORAWAN_RX_FRAME* LORAWAN_TakeFrame(void)
+{
+	LORAWAN_RX_FRAME* frame;
+
+	taskENTER_CRITICAL();
+	frame = RxPendingFrame;
+	RxPendingFrame = NULL;
+	taskEXIT_CRITICAL();
+	return	frame;
+}
+
+void LORAWAN_HoldFrame(LORAWAN_RX_FRAME* frame)
+{
+	if (frame == NULL) return;
+	taskENTER_CRITICAL();
+	frame->Refs++;
+	taskEXIT_CRITICAL();
+}
+
+void LORAWAN_ReleaseFrame(LORAWAN_RX_FRAME* frame)
+{
+	if (frame == NULL) return;
+	taskENTER_CRITICAL();
+	if (frame->Refs > 0) frame->Refs--;
+	taskEXIT_CRITICAL();
 }
 
 bool	LORAWAN_SendAck(void)
@@ -551,10 +880,8 @@ bool	LORAWAN_SendAck(void)
 }
 
 
-bool	LORAWAN_SendDevTimeReq(void)
+bool	LORAWAN_RequestDevTime(void)
 {
-	TRACE(5, "Send DevTimeReq\n");
-
 	MlmeReq_t mlmeReq;
 
 	mlmeReq.Type = MLME_DEV_TIME;
@@ -565,6 +892,18 @@ bool	LORAWAN_SendDevTimeReq(void)
 		return	false;
 	}
 
+	return	true;
+}
+
+bool	LORAWAN_SendDevTimeReq(void)
+{
+	TRACE(5, "Send DevTimeReq\n");
+
+	if (!LORAWAN_RequestDevTime())
+	{
+		return	false;
+	}
+
 	LORA_PACKET		xMessage;
 
 	xMessage.Port = 0;
@@ -624,10 +963,6 @@ McpsConfirm_t* LORAWAN_GetConfirm(void) {
 	return &LocalMcps.confirm;
 }
 
-McpsIndication_t* LORAWAN_GetIndication(void) {
-	return &LocalMcps.indication;
-}
-
 uint16_t LORAWAN_GetDownLinkCounter(void) {
 	return LoRaDownLinkCounter;
 }
@@ -698,14 +1033,14 @@ void	LORAWAN_ShowErrorStatus(LoRaMacEventInfoStatus_t xStatus)
 	{
 	case LORAMAC_EVENT_INFO_STATUS_ERROR:
 		ERROR("Error!\n");
-		DeviceFlashLed(10);
+		DeviceAlertLed(10);
 		break;
 	case LORAMAC_EVENT_INFO_STATUS_TX_TIMEOUT:
 		ERROR("Tx Timeout!\n");
-		DeviceFlashLed(3);
+		DeviceAlertLed(3);
 		break;
 	default:
-		DeviceFlashLed(5);
+		DeviceAlertLed(5);
 		break;
 	}
 }
@@ -13,6 +13,8 @@
 #include "lorawan_task.h"
 #include "SKTApp.h"
 #include "trace.h"
+#include "perf.h"
+#include "crash.h"
 /** @cond */
 /* Make sure that we initialize HAL array */
 #define DEFINE_HAL
@@ -45,6 +47,7 @@ __attribute__((noreturn)) void vApplicationStackOverflowHook( xTaskHandle pxTask
 	parameters have been corrupted, depending on the severity of the stack
 	overflow.  When this is the case pxCurrentTCB can be inspected in the
 	debugger to find the offending task. */
+	CRASH_Capture(CrashStackOverflow, (uint32_t)pxTask, (uint32_t)pcTaskName);
 #ifdef _DEBUG
 		DeviceShowErrorCode(DEVICE_STACK_ERROR);
 #endif
@@ -72,6 +75,9 @@ __attribute__((noreturn)) int main()
 {
 	// Initialize board GPIO and peripherals
 	DeviceInitHardware();
+#if (PERF_PROBES > 0)
+	PERF_Init();
+#endif
 
 	LORAWAN_Init();
 	SKTAPP_Init();
@@ -86,7 +92,7 @@ __attribute__((noreturn)) int main()
 	}
 
 	/* Start the scheduler. */
-	vEFMEnergyEnableLowPowerMode(false);	// Make sure FreeRTOS can go in deep sleep mode
+	/* Drivers restrict the energy mode themselves while they are active */
 	vTaskStartScheduler();
 
 	/* The scheduler should now be running the tasks so the following code should
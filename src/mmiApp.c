@@ -11,6 +11,7 @@
 #include "deviceApp.h"
 #include "supervisor.h"
 #include "trace.h"
+#include "history.h"
 
 #undef	__MODULE__
 #define	__MODULE__	"MMI"
@@ -50,6 +51,7 @@ typedef enum {
 	GetLastValues = 16,		//!< Re-send last sent values
 	GetMaximumArchivedValues=17, //!< Get the maximum depth of historical data saved
 	GetArchivedValues=18,	//!< Get a set of historical data values
+	GetArchivedRange=19,	//!< Get the time stamped historical values recorded between two times
 	FactoryReset=128,		//!< Perform a factory reset of the device -> <b>!! No more communication afterwards !!</b>
 	DeviceReset=129			//!< Perform a device reset. The communication restarts with a join network
 }SERVICE_CMD;
@@ -159,26 +161,62 @@ bool rc = false;
 				LocalMessage.Size = sizeof(short) + 1;
 				unsigned short size = (USERDATAPTR)->DeviceType;
 				memcpy(&LocalMessage.Buffer[1],&size, sizeof(short));
+				// If type > 16 then values can be contained in unsigned short, LoRaWAN message will be shorter
 				size = (size >= 16) ? sizeof(unsigned short) : sizeof(unsigned long);
 				LocalMessage.Buffer[3] = (uint8_t)(DeviceStatus);
 				// Copy input request parameters in case a new LORAWAN message would overwrite the buffer
-				int rank = msg->Buffer[1] + (msg->Buffer[2] * 256);
-				int nb = min(msg->Buffer[3],((LORAWAN_MAX_MESSAGE_SIZE - LocalMessage.Size) / (DeviceGetPulseInNumber()*size)));
-				nb = min(nb,SUPERVISOR_GetHistoricalCount());
-				// If type > 16 then values can be contained in unsigned short, LoRaWAN message will be shorter
-				unsigned long *ptr4 = (unsigned long*)&LocalMessage.Buffer[4];
-				unsigned short *ptr2= (unsigned short*)&LocalMessage.Buffer[4];
+				unsigned long rank = msg->Buffer[1] + (msg->Buffer[2] * 256);
 				// Compute maximum number of messages that can be sent out to avoid buffer overflow attack
 				// or LORAWAN maximum message size breach
-				while(nb--) {
-					for (int i = 0; i < DeviceGetPulseInNumber(); i++) {
-						if ( size < 4)
-							*(ptr2++) = (unsigned short)SUPERVISOR_GetHistoricalValue(rank,i);
-						else
-							*(ptr4++) = SUPERVISOR_GetHistoricalValue(rank,i);
-						LocalMessage.Size += size;
+				unsigned long nb = min(msg->Buffer[3],((LORAWAN_MAX_MESSAGE_SIZE - LocalMessage.Size) / (DeviceGetPulseInNumber()*size)));
+				unsigned long count = HISTORY_GetCount();
+				nb = (rank < count) ? min(nb, count - rank) : 0;
+				HISTORY_CURSOR cursor;
+				unsigned long values[HISTORY_CHANNELS];
+				// Records are read from the oldest requested one, but sent from the latest one
+				if (nb && HISTORY_OpenIndex(&cursor, count - rank - nb)) {
+					for (unsigned long j = nb; j && HISTORY_Next(&cursor, NULL, values); j--) {
+						uint8_t *ptr = &LocalMessage.Buffer[4 + ((j - 1) * DeviceGetPulseInNumber() * size)];
+						for (int i = 0; i < DeviceGetPulseInNumber(); i++) {
+							if ( size < 4)
+								*((unsigned short*)ptr) = (unsigned short)values[i];
+							else
+								*((unsigned long*)ptr) = values[i];
+							ptr += size;
+						}
+					}
+					LocalMessage.Size += nb * DeviceGetPulseInNumber() * size;
+				}
+				rc = true;
+			}
+			break;
+		case GetArchivedRange:
+			if (msg->Size > 8) {
+				LocalMessage.Size = sizeof(short) + 1;
+				unsigned short size = (USERDATAPTR)->DeviceType;
+				memcpy(&LocalMessage.Buffer[1],&size, sizeof(short));
+				size = (size >= 16) ? sizeof(unsigned short) : sizeof(unsigned long);
+				LocalMessage.Buffer[3] = (uint8_t)(DeviceStatus);
+				unsigned long from, to, time;
+				memcpy(&from, &msg->Buffer[1], sizeof(from));
+				memcpy(&to, &msg->Buffer[5], sizeof(to));
+				HISTORY_CURSOR cursor;
+				unsigned long values[HISTORY_CHANNELS];
+				// Stream time stamped records until the LoRaWAN message is full,
+				// the network server asks for the next range starting after the last received time
+				unsigned short recordSize = sizeof(unsigned long) + (DeviceGetPulseInNumber() * size);
+				if (HISTORY_OpenRange(&cursor, from, to)) {
+					while (((LocalMessage.Size + recordSize) <= (LORAWAN_MAX_MESSAGE_SIZE - 1))
+							&& HISTORY_Next(&cursor, &time, values)) {
+						uint8_t *ptr = &LocalMessage.Buffer[1 + LocalMessage.Size];
+						memcpy(ptr, &time, sizeof(time));
+						ptr += sizeof(time);
+						for (int i = 0; i < DeviceGetPulseInNumber(); i++) {
+							memcpy(ptr, &values[i], size);
+							ptr += size;
+						}
+						LocalMessage.Size += recordSize;
 					}
-					rank++;
 				}
 				rc = true;
 			}
@@ -227,7 +265,28 @@ void DEVICEAPP_SendPeriodic(bool retry) {
 	SendPacket();
 }
 
-void DEVICEAPP_ParseMessage(McpsIndication_t* ind) {
+static bool DEVICEAPP_OnServicePort(LORAWAN_RX_FRAME* frame) {
+	if (DEVICEAPP_ExecCommand(&frame->Packet)) SendPacket();
+	return false;
+}
+
+#if (INCLUDE_COMPLIANCE_TEST > 0)
+static bool DEVICEAPP_OnCompliancePort(LORAWAN_RX_FRAME* frame) {
+	DEVICEAPP_RunComplianceTest(&frame->Indication);
+	return false;
+}
+#endif
+
+static const LORAWAN_PORT DeviceAppPorts[] = {
+	{ SERVICE_PORT, DEVICEAPP_OnServicePort },
+#if (INCLUDE_COMPLIANCE_TEST > 0)
+	{ 224, DEVICEAPP_OnCompliancePort },
+#endif
+	{ 0, NULL }
+};
+
+void DEVICEAPP_ParseMessage(LORAWAN_RX_FRAME* frame) {
+	McpsIndication_t* ind = frame ? &frame->Indication : NULL;
 	LocalMessage.Buffer = LocalBuffer;	// Just in case
 	if (ind) {
 		if (ind->Status == LORAMAC_EVENT_INFO_STATUS_OK) {
@@ -236,20 +295,7 @@ void DEVICEAPP_ParseMessage(McpsIndication_t* ind) {
 				_loopUnconfirmed = 0;
 			}
 			if (ind->RxData) {
-				LORA_PACKET *msg = LORAWAN_GetMessage();
-				if (msg) {
-					switch(msg->Port) {
-					case SERVICE_PORT:
-						if (DEVICEAPP_ExecCommand(msg)) SendPacket();
-						break;
-#if (INCLUDE_COMPLIANCE_TEST > 0)
-					case 224:
-						DEVICEAPP_RunComplianceTest(ind);
-						break;
-#endif
-					default: break;
-					}
-				}
+				LORAWAN_DispatchFrame(frame, DeviceAppPorts);
 			}
 		}
 	}
@@ -0,0 +1,120 @@
+/*******************************************************************
+** perf.c                                                         **
+**                                                                **
+** Hot path cycle count probes                                    **
+**                                                                **
+*******************************************************************/
+/** \addtogroup S40 S40 Main Application
+ *  @{
+ */
+
+#include <string.h>
+#include "em_device.h"
+#include "perf.h"
+
+/*
+ * The probes read the DWT cycle counter of the core, so the counts are those of the real
+ * target with its flash wait states and caches. They are only built when PERF_PROBES is set.
+ * There are no built-in baselines: they are recorded on the target from the means of a
+ * reference run (or entered from the log of a previous build) and kept across PERF_Reset,
+ * so that the same workload can then be replayed and checked against them.
+ * They complement the host benchmarks of test/ (make -C test bench), which check the
+ * instruction counts of the same hot paths against test/perf_baselines.txt on every build.
+ */
+/** @cond */
+static const char* const PerfNames[PerfProbes] = {
+	"ComputeMic",
+	"PayloadEncrypt",
+	"TimeOnAir",
+	"NextChannel",
+	"TimerStart",
+	"ShellParse"
+};
+
+static uint32_t PerfBaselines[PerfProbes];
+
+static PERF_STATS PerfStats[PerfProbes];
+/** @endcond */
+
+void PERF_Init(void) {
+	CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+	DWT->CYCCNT = 0;
+	DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+	PERF_Reset();
+}
+
+void PERF_Reset(void) {
+	uint32_t primask = __get_PRIMASK();
+
+	__disable_irq();
+	memset(PerfStats, 0, sizeof(PerfStats));
+	__set_PRIMASK(primask);
+}
+
+void PERF_Record(PERF_PROBE probe, uint32_t cycles) {
+	uint32_t primask;
+	PERF_STATS* stats;
+
+	if (probe >= PerfProbes) return;
+	stats = &PerfStats[probe];
+	primask = __get_PRIMASK();
+	__disable_irq();
+	if ((stats->Count == 0) || (cycles < stats->Min)) stats->Min = cycles;
+	if (cycles > stats->Max) stats->Max = cycles;
+	stats->Total += cycles;
+	stats->Count++;
+	__set_PRIMASK(primask);
+}
+
+void PERF_Get(PERF_PROBE probe, PERF_STATS* stats) {
+	uint32_t primask = __get_PRIMASK();
+
+	__disable_irq();
+	*stats = PerfStats[probe];
+	__set_PRIMASK(primask);
+}
+
+const char* PERF_GetName(PERF_PROBE probe) {
+	return (probe < PerfProbes) ? PerfNames[probe] : "";
+}
+
+uint32_t PERF_GetBaseline(PERF_PROBE probe) {
+	return (probe < PerfProbes) ? PerfBaselines[probe] : 0;
+}
+
+void PERF_SetBaseline(PERF_PROBE probe, uint32_t cycles) {
+	if (probe < PerfProbes) PerfBaselines[probe] = cycles;
+}
+
+void PERF_MarkBaselines(void) {
+	PERF_STATS stats;
+
+	for (int i = 0; i < PerfProbes; i++) {
+		PERF_Get((PERF_PROBE)i, &stats);
+		if (stats.Count != 0) PerfBaselines[i] = (uint32_t)(stats.Total / stats.Count);
+	}
+}
+
+PERF_PROBE PERF_FindProbe(const char* name) {
+	int i;
+
+	for (i = 0; i < PerfProbes; i++) {
+		if (strcasecmp(PerfNames[i], name) == 0) break;
+	}
+	return (PERF_PROBE)i;
+}
+
+bool PERF_Check(PERF_PROBE probe, int* delta) {
+	PERF_STATS stats;
+	uint32_t baseline = PERF_GetBaseline(probe);
+	uint32_t mean;
+
+	*delta = 0;
+	PERF_Get(probe, &stats);
+	if ((baseline == 0) || (stats.Count == 0)) return false;
+	mean = (uint32_t)(stats.Total / stats.Count);
+	*delta = (int)(((int64_t)mean - baseline) * 100 / baseline);
+	return *delta > PERF_THRESHOLD_PCT;
+}
+
+/** }@ */
@@ -7,6 +7,7 @@
 
 #include <string.h>
 #include <stdarg.h>
+#include <stdlib.h>
 #include <ctype.h>
 #include <stdio.h>
 #include <time.h>
@@ -29,6 +30,12 @@
 #include "utilities.h"
 #include "SKTApp.h"
 #include "event.h"
+#include "link_stats.h"
+#include "adr-predict.h"
+#include "perf.h"
+#include "crash.h"
+#include "time_sync.h"
+#include "shell_parse.h"
 #undef	__MODULE__
 #define	__MODULE__ "TRACE"
 
@@ -71,6 +78,47 @@ extern SHELL_CMD	pShellLoRaWANCmds[];
 extern SHELL_CMD	pShellTestCmds[];
 
 #define	SHELL_TIMEOUT	(1 * configTICK_RATE_HZ)
+/* Console idle time before the device may go to EM3 again */
+#define	SHELL_IDLE_TIMEOUT	(30 * configTICK_RATE_HZ)
+#define	SHELL_EVENT_LINE	1
+#define	SHELL_EVENT_WAKE	2
+
+static volatile bool		bRxAwake = false;
+static volatile uint32_t	ulRxCount = 0;
+static const SystemPort		xRxPort = { (GPIOPORT)RETARGET_RXPORT, RETARGET_RXPIN, PortIn };
+
+/*!
+ * @brief LEUART reception needs EM2 from LFXO, EM1 above 9600 bits/s (HFCLKLE)
+ */
+static void SHELL_RequireEnergy(void)
+{
+	vEFMEnergyRequire(EnergyClientShell, (xConfig.xUART.baudrate <= 9600) ? EnergyModeEM2 : EnergyModeEM1);
+}
+
+/*!
+ * @brief Start bit on the idle console, the LEUART is clocked again until the console is idle
+ * @remark GPIO edge IRQs work in EM3, characters received while the LEUART clock restarts are lost
+ */
+static void SHELL_WakeIRQHandler(int pin)
+{
+	SystemDefinePortIrq(xRxPort, GPIOIRQNone);
+	bRxAwake = true;
+	SHELL_RequireEnergy();
+	EVENT_PostFromISR(SHELL_EVENT_WAKE);
+}
+
+/*!
+ * @brief Idle console: no restriction on the energy mode, wake up on the next start bit
+ */
+static void SHELL_Sleep(void)
+{
+	SystemIrqDisable();
+	bRxAwake = false;
+	vEFMEnergyRelease(EnergyClientShell);
+	SystemDefinePortIrqHandler(xRxPort, SHELL_WakeIRQHandler, GPIOIRQFalling);
+	SystemIrqEnable();
+}
+
 /***************************************************************************//**
  * @brief  Setting up LEUART
  ******************************************************************************/
@@ -286,57 +334,38 @@ uint32_t	SHELL_GetLine(char* pBuffer, uint32_t ulBufferLen)
 		ulReadLineLen = 0;
 		pReadLine = pBuffer;
 		ulMaxLineLen  = ulBufferLen;
-		LEUART_IntEnable(LEUART0, LEUART_IF_RXDATAV);
-
-		while(EVENT_WaitForEvent(10) == 0)
+		/* The LEUART is only clocked while the console is in use */
+		if (bRxAwake)
 		{
+			SHELL_RequireEnergy();
 		}
-
-		LEUART_IntDisable(LEUART0, LEUART_IF_RXDATAV);
-
-		return	ulReadLineLen;
-	}
-}
-
-int	SHELL_ParseLine(char* pLine, char* pArgv[], uint32_t nMaxArgs)
-{
-	int			nArgc = 0;
-
-	while(*pLine != '\0')
-	{
-		while(*pLine != '\0')
+		else
 		{
-			if ((*pLine != ' ') && (*pLine != '\t'))
-			{
-				break;
-			}
-			pLine++;
+			SHELL_Sleep();
 		}
+		LEUART_IntEnable(LEUART0, LEUART_IF_RXDATAV);
 
-		if (*pLine == '\0')
+		for(;;)
 		{
-			break;
-		}
-
-		pArgv[nArgc++] = pLine;
+			uint32_t	ulCount = ulRxCount;
+			uint32_t	evt = EVENT_WaitForEvent((bRxAwake) ? SHELL_IDLE_TIMEOUT : portMAX_DELAY);
 
-		while(*pLine != '\0')
-		{
-			if ((*pLine == ' ') || (*pLine == '\t'))
+			if (evt == SHELL_EVENT_LINE)
 			{
 				break;
 			}
-			pLine++;
+			if ((evt == 0) && (ulCount == ulRxCount))
+			{
+				SHELL_Sleep();
+			}
 		}
 
-		if (*pLine != '\0')
-		{
-			*pLine = '\0';
-			pLine++;
-		}
-	}
+		LEUART_IntDisable(LEUART0, LEUART_IF_RXDATAV);
+		SystemDefinePortIrq(xRxPort, GPIOIRQNone);
+		vEFMEnergyRelease(EnergyClientShell);
 
-	return	nArgc;
+		return	ulReadLineLen;
+	}
 }
 
 bool	SHELL_GetBool(char* pArgv, bool bDefault)
@@ -441,7 +470,7 @@ __attribute__((noreturn)) void SHELL_Task(void* pvParameters)
 		uint32_t ulLineLen = SHELL_GetLine(pLine, sizeof(pLine) - 1);
 		if (ulLineLen != 0)
 		{
-			int	nArgc = SHELL_ParseLine(pLine, ppArgv, 16);
+			int	nArgc = SHELL_ParseLine(pLine, ppArgv, sizeof(ppArgv) / sizeof(ppArgv[0]));
 			if (nArgc != 0)
 			{
 				SHELL_CMD*	pCmd = pShellCommonCmds;
@@ -1120,6 +1149,61 @@ int AT_CMD_ADR(char *ppArgv[], int nArgc)
 	return	0;
 }
 
+int AT_CMD_ADRPredict(char *ppArgv[], int nArgc)
+{
+	if (nArgc == 1)
+	{
+		AdrPredictStats_t xStats;
+
+		AdrPredictGetStats(&xStats);
+		SHELL_Printf("GET PREDICTIVE ADR FLAG\n");
+		SHELL_Printf("Predictive ADR Flag : %s\n", (LORAMAC_GetADRPredict()?"Enable":"Disable"));
+		if (xStats.Valid)
+		{
+			int nSnr = abs(xStats.Snr);
+			SHELL_Printf("- %16s : %s%d.%02d dB\n", "Uplink SNR", (xStats.Snr < 0)?"-":"", nSnr / 4, (nSnr % 4) * 25);
+		}
+		else
+		{
+			SHELL_Printf("- %16s : N/A\n", "Uplink SNR");
+		}
+		SHELL_Printf("- %16s : %lu\n", "Samples", xStats.Samples);
+		SHELL_Printf("- %16s : %lu\n", "Steps Down", xStats.StepsDown);
+		SHELL_Printf("- %16s : %lu\n", "Steps Up", xStats.StepsUp);
+		SHELL_Printf("- %16s : %lu\n", "Net Overrides", xStats.Overrides);
+	}
+	else
+	{
+		bool	ret = false;
+
+		if (nArgc == 2)
+		{
+			SHELL_Printf("SET PREDICTIVE ADR FLAG\n");
+
+			int8_t	bEnable = atoi(ppArgv[1]);
+			if (bEnable == 0)
+			{
+				ret = LORAMAC_SetADRPredict(false);
+			}
+			else if (bEnable == 1)
+			{
+				ret = LORAMAC_SetADRPredict(true);
+			}
+		}
+
+		if (ret)
+		{
+			SHELL_Printf("Predictive ADR Flag : %s\n", (LORAMAC_GetADRPredict()?"Enable":"Disable"));
+		}
+		else
+		{
+			SHELL_Printf("- ERROR, Invalid Arguments\n");
+		}
+	}
+
+	return	0;
+}
+
 int AT_CMD_CLS(char *ppArgv[], int nArgc)
 {
 	if (nArgc == 1)
@@ -1511,6 +1595,300 @@ int AT_CMD_GetTaskInfo(char* ppArgv[], int nArgc)
 	return	0;
 }
 
+int AT_CMD_EventStats(char* ppArgv[], int nArgc)
+{
+	if (nArgc == 1)
+	{
+		EVENT_STATS	xStats;
+
+		DeviceGetEventStats(&xStats);
+		SHELL_Printf("GET EVENT STATISTICS\n");
+		SHELL_Printf("- %16s : %lu\n", "Posted", xStats.Posted);
+		SHELL_Printf("- %16s : %lu\n", "Coalesced", xStats.Coalesced);
+		SHELL_Printf("- %16s : %lu\n", "Dispatched", xStats.Dispatched);
+		SHELL_Printf("- %16s : %d\n", "Pending", xStats.Pending);
+		SHELL_Printf("- %16s : %d\n", "Max Pending", xStats.MaxPending);
+	}
+	else
+	{
+		SHELL_Printf("- ERROR, Invalid Arguments\n");
+	}
+
+	return	0;
+}
+
+static void SHELL_PrintHistogram(const char* pName, const LINKSTATS_HISTOGRAM* pHistogram)
+{
+	SHELL_Printf("- %16s : RSSI", pName);
+	for(int i = 0 ; i < LINKSTATS_BINS ; i++)
+	{
+		SHELL_Printf(" %5u", pHistogram->Rssi[i]);
+	}
+	SHELL_Printf(" / SNR");
+	for(int i = 0 ; i < LINKSTATS_BINS ; i++)
+	{
+		SHELL_Printf(" %5u", pHistogram->Snr[i]);
+	}
+	SHELL_Printf("\n");
+}
+
+int AT_CMD_LinkStats(char* ppArgv[], int nArgc)
+{
+	if (nArgc == 1)
+	{
+		const LINKSTATS* pStats = LINKSTATS_Get();
+		// Every radio transmission opens the receive windows
+		unsigned long ulWindows = pStats->Transmissions + pStats->Uplinks - pStats->Confirmed;
+		int		nPER = LINKSTATS_GetPER();
+		char	pName[24];	// "CH15 (4294967295 up)"
+
+		SHELL_Printf("GET LINK QUALITY STATISTICS\n");
+		SHELL_Printf("- %16s : %lu\n", "Uplinks", pStats->Uplinks);
+		SHELL_Printf("- %16s : %lu\n", "Confirmed", pStats->Confirmed);
+		SHELL_Printf("- %16s : %lu\n", "Transmissions", pStats->Transmissions);
+		SHELL_Printf("- %16s : %lu\n", "Ack Missed", pStats->AckMissed);
+		SHELL_Printf("- %16s : %lu (%lu%%)\n", "RX1", pStats->Rx1, ulWindows ? (pStats->Rx1 * 100 / ulWindows) : 0);
+		SHELL_Printf("- %16s : %lu (%lu%%)\n", "RX2", pStats->Rx2, ulWindows ? (pStats->Rx2 * 100 / ulWindows) : 0);
+		SHELL_Printf("- %16s : %lu\n", "Downlink Lost", pStats->DownlinkLost);
+		SHELL_Printf("- %16s : %lu / %lu\n", "LBT Busy", pStats->LbtBusy, pStats->LbtChecks);
+		if (nPER < 0)
+			SHELL_Printf("- %16s : N/A\n", "PER");
+		else
+			SHELL_Printf("- %16s : %d%%\n", "PER", nPER);
+		SHELL_Printf("- %16s : >= %d dBm by %d dB, SNR >= %d dB by %d dB\n", "Bins",
+				LINKSTATS_RSSI_TOP - LINKSTATS_RSSI_STEP, LINKSTATS_RSSI_STEP,
+				LINKSTATS_SNR_TOP - LINKSTATS_SNR_STEP, LINKSTATS_SNR_STEP);
+		for(int i = 0 ; i < LINKSTATS_DATARATES ; i++)
+		{
+			if ((pStats->UplinksPerDatarate[i] == 0) && (pStats->Samples[i] == 0)) continue;
+			snprintf(pName, sizeof(pName), "DR%d (%lu up)", i, pStats->UplinksPerDatarate[i]);
+			SHELL_PrintHistogram(pName, &pStats->PerDatarate[i]);
+		}
+		for(int i = 0 ; i <= LINKSTATS_CHANNEL_RX2 ; i++)
+		{
+			if ((i < LINKSTATS_CHANNELS) && (pStats->UplinksPerChannel[i] == 0)) continue;
+			if ((i == LINKSTATS_CHANNEL_RX2) && (pStats->Rx2 == 0)) continue;
+			if (i < LINKSTATS_CHANNELS)
+				snprintf(pName, sizeof(pName), "CH%d (%lu up)", i, pStats->UplinksPerChannel[i]);
+			else
+				snprintf(pName, sizeof(pName), "RX2");
+			SHELL_PrintHistogram(pName, &pStats->PerChannel[i]);
+		}
+	}
+	else if ((nArgc == 2) && (strcasecmp(ppArgv[1], "reset") == 0))
+	{
+		LINKSTATS_Reset();
+		SHELL_Printf("RESET LINK QUALITY STATISTICS\n");
+	}
+	else if ((nArgc == 2) && (strcasecmp(ppArgv[1], "send") == 0))
+	{
+		DevicePostEvent(LINK_STATS_EVENT);
+		SHELL_Printf("SEND LINK QUALITY STATISTICS\n");
+	}
+	else
+	{
+		SHELL_Printf("- ERROR, Invalid Arguments\n");
+	}
+
+	return	0;
+}
+
+int AT_CMD_Perf(char* ppArgv[], int nArgc)
+{
+	if (nArgc == 1)
+	{
+		PERF_STATS	xStats;
+		int			nDelta;
+		int			nRegressions = 0;
+
+		SHELL_Printf("GET HOT PATH CYCLES\n");
+#if (PERF_PROBES == 0)
+		SHELL_Printf("- %16s : Disabled\n", "Probes");
+#endif
+		for(int i = 0 ; i < PerfProbes ; i++)
+		{
+			bool	bRegression = PERF_Check((PERF_PROBE)i, &nDelta);
+
+			PERF_Get((PERF_PROBE)i, &xStats);
+			if (xStats.Count == 0)
+			{
+				SHELL_Printf("- %16s : N/A\n", PERF_GetName((PERF_PROBE)i));
+				continue;
+			}
+			SHELL_Printf("- %16s : %lu (%lu..%lu) x %lu", PERF_GetName((PERF_PROBE)i),
+					(unsigned long)(xStats.Total / xStats.Count), xStats.Min, xStats.Max, xStats.Count);
+			if (PERF_GetBaseline((PERF_PROBE)i) != 0)
+			{
+				SHELL_Printf(", %lu %s%d%%%s", PERF_GetBaseline((PERF_PROBE)i), (nDelta >= 0) ? "+" : "", nDelta,
+						bRegression ? " REGRESSION" : "");
+			}
+			SHELL_Printf("\n");
+			if (bRegression) nRegressions++;
+		}
+		SHELL_Printf("- %16s : %d\n", "Regressions", nRegressions);
+	}
+	else if ((nArgc == 2) && (strcasecmp(ppArgv[1], "reset") == 0))
+	{
+		PERF_Reset();
+		SHELL_Printf("RESET HOT PATH CYCLES\n");
+	}
+	else if ((nArgc == 2) && (strcasecmp(ppArgv[1], "mark") == 0))
+	{
+		PERF_MarkBaselines();
+		SHELL_Printf("MARK HOT PATH BASELINES\n");
+	}
+	else if ((nArgc == 4) && (strcasecmp(ppArgv[1], "baseline") == 0))
+	{
+		PERF_PROBE	xProbe = PERF_FindProbe(ppArgv[2]);
+
+		if (xProbe == PerfProbes)
+		{
+			SHELL_Printf("- ERROR, Invalid Probe\n");
+		}
+		else
+		{
+			PERF_SetBaseline(xProbe, strtoul(ppArgv[3], NULL, 10));
+			SHELL_Printf("SET HOT PATH BASELINE\n");
+			SHELL_Printf("- %16s : %lu\n", PERF_GetName(xProbe), PERF_GetBaseline(xProbe));
+		}
+	}
+	else
+	{
+		SHELL_Printf("- ERROR, Invalid Arguments\n");
+	}
+
+	return	0;
+}
+
+int AT_CMD_Spi(char* ppArgv[], int nArgc)
+{
+	if (nArgc == 1)
+	{
+		SX1276SpiStats_t	xStats;
+
+		SX1276GetSpiStats(&xStats);
+		SHELL_Printf("GET RADIO SPI STATISTICS\n");
+		SHELL_Printf("- %16s : %lu\n", "Reads", xStats.Reads);
+		SHELL_Printf("- %16s : %lu\n", "Writes", xStats.Writes);
+		SHELL_Printf("- %16s : %lu\n", "Read Hits", xStats.ReadHits);
+		SHELL_Printf("- %16s : %lu\n", "Writes Skipped", xStats.WritesSkipped);
+	}
+	else if ((nArgc == 2) && (strcasecmp(ppArgv[1], "reset") == 0))
+	{
+		SX1276ResetSpiStats();
+		SHELL_Printf("RESET RADIO SPI STATISTICS\n");
+	}
+	else
+	{
+		SHELL_Printf("- ERROR, Invalid Arguments\n");
+	}
+
+	return	0;
+}
+
+static void SHELL_PrintWords(uint32_t ulAddress, const uint32_t* pWords, int nCount)
+{
+	for(int i = 0 ; i < nCount ; i += 4)
+	{
+		SHELL_Printf("  %08lX :", ulAddress + i * 4);
+		for(int j = i ; (j < i + 4) && (j < nCount) ; j++)
+		{
+			SHELL_Printf(" %08lX", pWords[j]);
+		}
+		SHELL_Printf("\n");
+	}
+}
+
+int AT_CMD_Crash(char* ppArgv[], int nArgc)
+{
+	static const char* pCauses[] = { "Unknown", "Hard Fault", "Stack Overflow", "Assert", "Error Code" };
+	const CRASH_RECORD*	pRecord = CRASH_Get();
+
+	if (nArgc == 1)
+	{
+		SHELL_Printf("GET CRASH RECORD\n");
+		if (pRecord == NULL)
+		{
+			SHELL_Printf("- %16s : None\n", "Cause");
+			return	0;
+		}
+		SHELL_Printf("- %16s : %s\n", "Cause", pCauses[(pRecord->Cause <= CrashErrorCode) ? pRecord->Cause : 0]);
+		SHELL_Printf("- %16s : %08lX\n", "Code", pRecord->Code);
+		SHELL_Printf("- %16s : %08lX\n", "Argument", pRecord->Arg);
+		SHELL_Printf("- %16s : %lu ticks\n", "Uptime", pRecord->Ticks);
+		SHELL_Printf("- %16s : %s\n", "Task", pRecord->Task);
+		SHELL_Printf("- %16s : %s\n", "Reported", (pRecord->Reported == 0) ? "Yes" : "No");
+		SHELL_Printf("- %16s : %08lX %08lX %08lX %08lX\n", "R0-R3", pRecord->Registers[0], pRecord->Registers[1],
+				pRecord->Registers[2], pRecord->Registers[3]);
+		SHELL_Printf("- %16s : %08lX\n", "R12", pRecord->Registers[4]);
+		SHELL_Printf("- %16s : %08lX\n", "LR", pRecord->Registers[5]);
+		SHELL_Printf("- %16s : %08lX\n", "PC", pRecord->Registers[6]);
+		SHELL_Printf("- %16s : %08lX\n", "xPSR", pRecord->Registers[7]);
+		SHELL_Printf("- %16s : %08lX\n", "EXC_RETURN", pRecord->ExcReturn);
+		SHELL_Printf("- %16s : %08lX %08lX\n", "CFSR HFSR", pRecord->Cfsr, pRecord->Hfsr);
+		SHELL_Printf("- %16s : %08lX %08lX\n", "MMFAR BFAR", pRecord->Mmfar, pRecord->Bfar);
+		SHELL_Printf("- %16s : %08lX\n", "SP", pRecord->Sp);
+		SHELL_PrintWords(pRecord->Sp, pRecord->Stack, CRASH_STACK_WORDS);
+		for(int i = 0 ; i < pRecord->TasksCount ; i++)
+		{
+			const CRASH_TASK* pTask = &pRecord->Tasks[i];
+
+			SHELL_Printf("- %16s : TCB %08lX, SP %08lX, Stack %08lX, Free %u, Priority %u%s\n", pTask->Name,
+					pTask->Tcb, pTask->Sp, pTask->StackBase, pTask->HighWater, pTask->Priority,
+					pTask->Running ? ", Running" : "");
+			SHELL_PrintWords(pTask->Sp, pTask->Stack, CRASH_TASK_WORDS);
+		}
+		SHELL_Printf("- %16s :\n", "Trace");
+		SHELL_Print(pRecord->Trace, strnlen(pRecord->Trace, CRASH_TRACE_SIZE));
+		SHELL_Printf("\n");
+	}
+	else if ((nArgc == 2) && (strcasecmp(ppArgv[1], "clear") == 0))
+	{
+		CRASH_Clear();
+		SHELL_Printf("CLEAR CRASH RECORD\n");
+	}
+	else if ((nArgc == 2) && (strcasecmp(ppArgv[1], "send") == 0))
+	{
+		DevicePostEvent(CRASH_REPORT_EVENT);
+		SHELL_Printf("SEND CRASH RECORD\n");
+	}
+	else
+	{
+		SHELL_Printf("- ERROR, Invalid Arguments\n");
+	}
+
+	return	0;
+}
+
+int AT_CMD_TimeSync(char* ppArgv[], int nArgc)
+{
+	if (nArgc == 1)
+	{
+		const TIMESYNC_STATUS* pStatus = TIMESYNC_GetStatus();
+
+		SHELL_Printf("GET TIME SYNCHRONIZATION\n");
+		SHELL_Printf("- %16s : %lu\n", "RTC", RTCGetSeconds());
+		SHELL_Printf("- %16s : %lu\n", "Synchronized", pStatus->Count);
+		SHELL_Printf("- %16s : %lu\n", "Last Sync", pStatus->LastSync);
+		SHELL_Printf("- %16s : %ld ms\n", "Last Error", pStatus->Offset);
+		SHELL_Printf("- %16s : %ld ppb over %lu s\n", "Drift", pStatus->Drift, pStatus->Interval);
+		SHELL_Printf("- %16s : %ld ppb\n", "Trim", RTCGetTrim());
+	}
+	else if ((nArgc == 2) && (strcasecmp(ppArgv[1], "now") == 0))
+	{
+		if (TIMESYNC_Request())
+			SHELL_Printf("REQUEST TIME SYNCHRONIZATION\n");
+		else
+			SHELL_Printf("- ERROR, Request failed\n");
+	}
+	else
+	{
+		SHELL_Printf("- ERROR, Invalid Arguments\n");
+	}
+
+	return	0;
+}
+
 int AT_CMD_Test(char *ppArgv[], int nArgc)
 {
 	if (nArgc == 2)
@@ -1698,6 +2076,7 @@ SHELL_CMD	pShellLoRaWANCmds[] =
 		{	"AT+AEUI", 	"Set/Get Application EUI",	AT_CMD_AppEUI},
 		{	"AT+CHTX", 	"Set Channel and Tx Power",	AT_CMD_SetChannelAndTxPower},
 		{	"AT+ADR", 	"Set/Get ADR Flag",	AT_CMD_ADR},
+		{	"AT+PADR", 	"Set/Get Predictive ADR Flag",	AT_CMD_ADRPredict},
 		{	"AT+CLS", 	"Set/Get Class",	AT_CMD_CLS},
 		{	"AT+SIG", 	"Latest RF Signal",	AT_CMD_LatestSignal},
 		{	"AT+RCNT", 	"Tx Retransmission Number",	AT_CMD_TxRetransmissionNumber},
@@ -1718,6 +2097,12 @@ SHELL_CMD	pShellLoRaWANCmds[] =
 		{	"AT+TASK",	"Get Task Information",	AT_CMD_Task},
 		{	"AT+STAT", 	"Get Status",	AT_CMD_Status},
 		{	"AT+TASK",	"Show Task Informations", AT_CMD_GetTaskInfo},
+		{	"AT+EVT",	"Get Event Statistics", AT_CMD_EventStats},
+		{	"AT+LQS",	"Link Quality Statistics [reset|send]", AT_CMD_LinkStats},
+		{	"AT+PERF",	"Hot Path Cycle Counts [reset|mark|baseline <probe> <cycles>]", AT_CMD_Perf},
+		{	"AT+SPI",	"Radio SPI Statistics [reset]", AT_CMD_Spi},
+		{	"AT+CRASH",	"Crash Record [clear|send]", AT_CMD_Crash},
+		{	"AT+TSYNC",	"Time Synchronization [now]", AT_CMD_TimeSync},
 		{	"AT+SLP",	"Sleep",	AT_CMD_Sleep},
 		{	"AT+MAC",	"Get/Set MAC",	AT_CMD_Mac},
 		{	"AT+FACTORY","Set Factory Test Mode",	AT_CMD_SetFactoryMode},
@@ -1735,6 +2120,7 @@ SHELL_CMD	pShellTestCmds[] =
 
 void	LEUART0_IRQHandler(void)
 {
+	ulRxCount++;
 	if ((pReadLine != NULL) && (ulReadLineLen < ulMaxLineLen))
 	{
 		char	ch = LEUART0->RXDATA;
@@ -1744,7 +2130,7 @@ void	LEUART0_IRQHandler(void)
 		case	'\n':
 			{
 				pReadLine[ulReadLineLen] = '\0';
-				EVENT_Send(1);
+				EVENT_PostFromISR(SHELL_EVENT_LINE);
 			}
 			break;
 
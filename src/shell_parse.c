@@ -0,0 +1,57 @@
+/*******************************************************************
+** shell_parse.c                                                  **
+**                                                                **
+** Shell command line tokenizer                                   **
+**                                                                **
+*******************************************************************/
+/** \addtogroup S40 S40 Main Application
+ *  @{
+ */
+
+#include "shell_parse.h"
+#include "perf.h"
+
+int	SHELL_ParseLine(char* pLine, char* pArgv[], uint32_t nMaxArgs)
+{
+	int			nArgc = 0;
+	PERF_BEGIN(PerfShellParse);
+
+	while((*pLine != '\0') && ((uint32_t)nArgc < nMaxArgs))
+	{
+		while(*pLine != '\0')
+		{
+			if ((*pLine != ' ') && (*pLine != '\t'))
+			{
+				break;
+			}
+			pLine++;
+		}
+
+		if (*pLine == '\0')
+		{
+			break;
+		}
+
+		pArgv[nArgc++] = pLine;
+
+		while(*pLine != '\0')
+		{
+			if ((*pLine == ' ') || (*pLine == '\t'))
+			{
+				break;
+			}
+			pLine++;
+		}
+
+		if (*pLine != '\0')
+		{
+			*pLine = '\0';
+			pLine++;
+		}
+	}
+
+	PERF_END(PerfShellParse);
+	return	nArgc;
+}
+
+/** }@ */
@@ -0,0 +1,44 @@
+/*******************************************************************
+** skt_payload.c                                                  **
+**                                                                **
+** SKT application payload builders                               **
+**                                                                **
+*******************************************************************/
+/** \addtogroup S40 S40 Main Application
+ *  @{
+ */
+
+#include <stdio.h>
+#include "system.h"
+#include "skt_payload.h"
+
+uint32_t	SKTPAYLOAD_SetPeriodic(LORA_MESSAGE* pMessage, uint32_t ulMaxSize, uint8_t nType, uint32_t ulCount,
+		const unsigned long* pValues, int nValues)
+{
+	char*		pText = (char*)pMessage->Payload;
+	uint32_t	ulRoom, ulLen;
+
+	if (ulMaxSize <= LORA_MESSAGE_HEADER_SIZE)
+	{
+		return	0;
+	}
+	ulRoom = ulMaxSize - LORA_MESSAGE_HEADER_SIZE;
+	// Signed as the counter and the values have always been reported
+	ulLen = snprintf(pText, ulRoom, "%ld", (long)ulCount);
+	for (int i = 0; (i < nValues) && (ulLen < ulRoom); i++)
+	{
+		ulLen += snprintf(&pText[ulLen], ulRoom - ulLen, ",%ld", (long)pValues[i]);
+	}
+	if ((ulLen >= ulRoom) || (ulLen > UINT8_MAX))
+	{
+		return	0;
+	}
+
+	pMessage->Version = LORA_MESSAGE_VERSION;
+	pMessage->MessageType = nType;
+	pMessage->PayloadLen = (uint8_t)ulLen;
+
+	return	LORA_MESSAGE_HEADER_SIZE + ulLen;
+}
+
+/** }@ */
@@ -13,6 +13,14 @@
 #include "SKTApp.h"
 #include "system.h"
 #include "trace.h"
+#include "history.h"
+#include "join_retry.h"
+#include "warm_start.h"
+#include "crash.h"
+#include "time_sync.h"
+#include "link_stats.h"
+#include "led_pattern.h"
+#include "rx-calibration.h"
 
 #undef	__MODULE__
 #define	__MODULE__	FLAG_TRACE_SUPERVISOR
@@ -81,14 +89,7 @@ __attribute__((noreturn)) static void SUPERVISORCyclicTask(void* pvParameters) {
 static void SUPERVISORUpdatePulseValue(void) {
     CLEAR_FLAG(DEVICE_COMM_ERROR);	/* Reset Communication Status */
 #if (NODE_TEMP > 0)
-	DeviceCaptureAnalogValue(0);
-	if (GET_FLAG(DEVICE_COMM_ERROR)) {
-		/* Give another trial */
-		CLEAR_FLAG(DEVICE_COMM_ERROR);
-		/* Wait some time for sensor to power down */
-		SysTimerWait1ms(100);
-		DeviceCaptureAnalogValue(0);
-	}
+	DeviceCaptureAnalogValue(0);	// Retries on next sensor frame are handled by the capture
 #elif (NODE_HYGRO > 0)
 	DeviceCaptureAnalogValue(0);
 #elif (NODE_ANALOG > 0)
@@ -96,6 +97,7 @@ static void SUPERVISORUpdatePulseValue(void) {
 #else
 	DevicePulseInCheck();			// Verify any sensor interface problem
 #endif
+	RxCalibrationSetTemperature(SystemGetTemperature());	// ADC is free once the capture is done
 }
 
 static void SUPERVISORRunAttach()
@@ -113,8 +115,10 @@ static void SUPERVISORRunAttach()
 static void SUPERVISORResetUnit(void) {
 	INFO("Reset Unit\n");
 	if (!UNIT_DISALLOW_RESET) {
+		WARMSTART_Invalidate();
 		DeviceUserDataSetFlag(FLAG_INSTALLED, 0);
-		DeviceFlashLed(20);
+		DeviceAlertLed(20);
+		LEDPATTERN_Wait(0);
 		SystemReboot();
 	}
 
@@ -124,53 +128,34 @@ static void SUPERVISORResetUnit(void) {
 
 /*
  * NOTE: Even if no historical data shall be kept (i.e. HISTORICAL_DATA = 0), the last captured
- * values will be stored to allow PERIODIC_RESEND event to send accurate information
+ * values will be stored to allow PERIODIC_RESEND event to send accurate information.
+ * Older values are kept, time stamped, in the Flash Memory history store.
  */
-
-#if HISTORICAL_DATA
-static unsigned long _historical[HISTORICAL_DATA ][HAL_NB_PULSE_IN];
-static int _historical_in = 0;
-static bool _historical_overflow = false;
-#else
-static unsigned long _historical[1][HAL_NB_PULSE_IN];
-#endif
+static unsigned long _historical[HAL_NB_PULSE_IN];
 
 static void SUPERVISOR_SaveHistorical(void) {
-#if HISTORICAL_DATA
 	for (int i=0; i < DeviceGetPulseInNumber(); i++)
-		_historical[_historical_in][i] = DeviceGetPulseInValue(i);
-	if (++_historical_in >= HISTORICAL_DATA) {
-		_historical_in = 0;
-		_historical_overflow = true;
-	}
-#else
-	for (int i=0; i < DeviceGetPulseInNumber(); i++)
-		_historical[0][i] = DeviceGetPulseInValue(i);
+		_historical[i] = DeviceGetPulseInValue(i);
+#if HISTORICAL_DATA
+	if (!HISTORY_Append(RTCGetSeconds(), _historical))
+		ERROR("History store write failed.\n");
 #endif
 }
 
 /**************************** PUBLIC Functions *********************/
 unsigned short SUPERVISOR_GetHistoricalCount(void) {
-#if HISTORICAL_DATA
-	return (unsigned short)((_historical_overflow) ? HISTORICAL_DATA : _historical_in);
-#else
-	return 0;
-#endif
+	return (unsigned short)min(HISTORY_GetCount(), 0xFFFFUL);
 }
 
 unsigned long SUPERVISOR_GetHistoricalValue(int rank, int index) {
-#if HISTORICAL_DATA
-	if (index > DeviceGetPulseInNumber()) return 0;
-	int nb = (_historical_overflow) ? HISTORICAL_DATA : _historical_in;
-	if (rank >= nb) return 0;
-	if (rank >= _historical_in) rank = _historical_in + rank - HISTORICAL_DATA -1;
-	else rank = _historical_in - rank - 1;
-	return _historical[rank][index];
-#else
-	if (index > DeviceGetPulseInNumber()) return 0;
-	if (rank) return 0;
-	return _historical[0][index];
-#endif
+	if ((index < 0) || (index >= DeviceGetPulseInNumber()) || (rank < 0)) return 0;
+	if (rank == 0) return _historical[index];
+	HISTORY_CURSOR cursor;
+	unsigned long values[HISTORY_CHANNELS];
+	unsigned long nb = HISTORY_GetCount();
+	if (((unsigned long)rank >= nb) || !HISTORY_OpenIndex(&cursor, nb - rank - 1)
+		|| !HISTORY_Next(&cursor, NULL, values)) return 0;
+	return values[index];
 }
 
 unsigned long SUPERVISOR_GetRFPeriod(void)
@@ -265,6 +250,12 @@ __attribute__((noreturn)) void SUPERVISOR_Task(void* pvParameters)
 {
 	// Wait 1 sec. for Radio Task to start
 	vTaskDelay(configTICK_RATE_HZ);
+	HISTORY_Init();
+	// Rank 0 is the newest record saved before the reset until the next capture
+	HISTORY_GetLast(NULL, _historical);
+	JOINRETRY_Init();
+	CRASH_Init();
+	TIMESYNC_Init();
 	if (UNIT_FACTORY_TEST)
 	{
 		CLEAR_USERFLAG(FLAG_FACTORY_TEST);
@@ -278,7 +269,13 @@ __attribute__((noreturn)) void SUPERVISOR_Task(void* pvParameters)
 	DeviceStatus |= (UNIT_INSTALLED) ? DEVICE_COMM_ERROR:  (DEVICE_COMM_ERROR | DEVICE_UNINSTALLED);
 	SUPERVISOR_StartCyclicTask(0,SUPERVISOR_ReadRFPeriod());
 
-	if (UNIT_AUTO_ATTACH)
+	if (WARMSTART_Restore())
+	{
+		// The MAC session survived the reset, no need to join again
+		CLEAR_FLAG(DEVICE_UNINSTALLED);
+		DevicePostEvent(PERIODIC_EVENT);		// Force immediate communication
+	}
+	else if (UNIT_AUTO_ATTACH)
 	{
 #if 0
 		if (UNIT_INSTALLED)
@@ -294,7 +291,9 @@ __attribute__((noreturn)) void SUPERVISOR_Task(void* pvParameters)
 			DeviceFlashLed(LED_FLASH_OFF);
 		}
 #else
-		DevicePostEvent(RUN_ATTACH);
+		// After a reboot during a join procedure, keep backing off
+		if (!JOINRETRY_Resume())
+			DevicePostEvent(RUN_ATTACH);
 #endif
 	}
 
@@ -303,17 +302,21 @@ __attribute__((noreturn)) void SUPERVISOR_Task(void* pvParameters)
   SUPERVISORUpdatePulseValue();
   DeviceFlashLed(LED_FLASH_OFF);
   if (GET_FLAG(DEVICE_COMM_ERROR))
-	  DeviceFlashLed(10);
+	  DeviceAlertLed(10);
 #endif
   DeviceFlashLed(LED_FLASH_OFF);
   for (;;) {
 	DeviceResetAllButtons();
-	EVENT_TYPE event = DeviceWaitForEvent(portMAX_DELAY);
+	EVENT_TYPE event = DeviceWaitForEvent(JOINRETRY_GetTimeout());
 	switch(event) {
 		/*
-		 * DeviceWaitForEvent timed out
+		 * DeviceWaitForEvent timed out: a join retry may be due
 		 */
 	case IDLE_EVENT:
+		{
+			EVENT_TYPE retry = JOINRETRY_Poll();
+			if (retry != IDLE_EVENT) DevicePostEvent(retry);
+		}
 		break;
 		/*
 		 * Button was pressed.
@@ -322,7 +325,7 @@ __attribute__((noreturn)) void SUPERVISOR_Task(void* pvParameters)
     	if (!DevicePerformKeypressTasks(0,buttonTasks))
     	{
     	}
-		lastButton = DeviceRTCGetSeconds();
+		lastButton = SystemGetSystemSeconds();
       break;
       /*
        * A system error occurred
@@ -340,11 +343,15 @@ __attribute__((noreturn)) void SUPERVISOR_Task(void* pvParameters)
          * A pulse occurred
          */
 	case PULSE_EVENT:
-		INFO("A pulse occurred.\n");
-		// Show Pulse LED if not installed or button was activated for less than 5 minutes
-		if (GET_FLAG(DEVICE_UNINSTALLED) || ((DeviceRTCGetSeconds() - lastButton) < (5*60))) {
-			DeviceFlashOneLedExt(0,1,LED_FLASH_SHORTER);
-			CLEAR_FLAG(DEVICE_PULSE_OFF);
+		{
+			// Inputs which fired since the event was posted, one bit per input
+			unsigned long inputs = DeviceGetEventPayload();
+			INFO("A pulse occurred on inputs 0x%lx.\n", inputs);
+			// Show Pulse LED if not installed or button was activated for less than 5 minutes, one flash per input
+			if (GET_FLAG(DEVICE_UNINSTALLED) || ((SystemGetSystemSeconds() - lastButton) < (5*60))) {
+				DeviceFlashOneLedExt(0,(inputs) ? __builtin_popcountl(inputs) : 1,LED_FLASH_SHORTER);
+				DevicePulseInRearm();
+			}
 		}
 		break;
 		/*
@@ -369,6 +376,9 @@ __attribute__((noreturn)) void SUPERVISOR_Task(void* pvParameters)
 	case PERIODIC_RESEND:
 		if (UNIT_INSTALLED == 0) break;
 		DeviceFlashLed(LED_FLASH_ON);
+		/* Piggyback the network time request on the periodic message */
+		if (TIMESYNC_IsDue())
+			TIMESYNC_Request();
 		if (UNIT_USE_SKT_APP)
 			SKTAPP_SendPeriodic(event == PERIODIC_RESEND);
 		else
@@ -376,17 +386,40 @@ __attribute__((noreturn)) void SUPERVISOR_Task(void* pvParameters)
 		DeviceFlashLed(LED_FLASH_OFF);
 		/* Reset Status Flags until next periodic message */
 		CLEAR_FLAG(DEVICE_COMM_ERROR | DEVICE_TEMPORARY_ERROR | DEVICE_PERMANENT_ERROR | DEVICE_LOW_BATTERY);
+		/* Report a crash that happened before the last reset, once the network is reachable */
+		if (CRASH_IsPending())
+			DevicePostEvent(CRASH_REPORT_EVENT);
+		break;
+		/*
+		 * Link quality report requested by the network or the shell
+		 */
+	case LINK_STATS_EVENT:
+		if (UNIT_INSTALLED == 0) break;
+		if (!LINKSTATS_Send())
+			ERROR("Link statistics report not sent.\n");
+		break;
+		/*
+		 * A crash record is waiting to be reported
+		 */
+	case CRASH_REPORT_EVENT:
+		if (UNIT_INSTALLED == 0) break;
+		if (!CRASH_Send())
+			ERROR("Crash report not sent.\n");
 		break;
 		/*
 		 * Received an indication event from the network.
 		 */
 	case RF_INDICATION:
 		{
+			LORAWAN_RX_FRAME* pFrame = LORAWAN_TakeFrame();
+
 			INFO("Received an indication event from the network.\n");
+			if (pFrame == NULL) break;
 			if (UNIT_USE_SKT_APP)
-				SKTAPP_ParseMessage(LORAWAN_GetIndication());
+				SKTAPP_ParseMessage(pFrame);
 			else
-				DEVICEAPP_ParseMessage(LORAWAN_GetIndication());
+				DEVICEAPP_ParseMessage(pFrame);
+			LORAWAN_ReleaseFrame(pFrame);
 		}
 		break;
 		/*
@@ -394,6 +427,8 @@ __attribute__((noreturn)) void SUPERVISOR_Task(void* pvParameters)
 		 */
 	case RF_MLME:
 		INFO("Received a Mlme confirm event from the network.\n");
+		if (LORAWAN_GetMlmeConfirm()->MlmeRequest == MLME_DEV_TIME)
+			TIMESYNC_Confirm(LORAWAN_GetMlmeConfirm());
 		if (UNIT_USE_SKT_APP)
 			SKTAPP_ParseMlme(LORAWAN_GetMlmeConfirm());
 		else
@@ -405,6 +440,8 @@ __attribute__((noreturn)) void SUPERVISOR_Task(void* pvParameters)
 
 	case	RUN_ATTACH:
 		INFO("Run Attach.\n");
+		JOINRETRY_Cancel();
+		WARMSTART_Invalidate();
 		if( UNIT_USE_SKT_APP)
 		{
 			if (UNIT_USE_RAK)
@@ -430,14 +467,17 @@ __attribute__((noreturn)) void SUPERVISOR_Task(void* pvParameters)
 		if (LORAWAN_JoinNetworkUseOTTA((uint8_t*)UNIT_DEVEUID, (uint8_t*)UNIT_APPEUID, (uint8_t*)UNIT_APPKEY))
 		{
 			DeviceFlashLed(5);
+			JOINRETRY_Succeeded(JoinStageOTAA, true);
 			CLEAR_FLAG(DEVICE_UNINSTALLED);
 			DeviceUserDataSetFlag(FLAG_INSTALLED,FLAG_INSTALLED);
+			WARMSTART_Save();
 			DevicePostEvent(PERIODIC_EVENT);		// Force immediate communication
 			INFO("Request to join has been completed.\n");
 		}
 		else
 		{
 			INFO("Request to join failed.\n");
+			JOINRETRY_Failed(JoinStageOTAA, LORAWAN_GetMlmeConfirm()->TxTimeOnAir);
 		}
 
 		CLEAR_FLAG(DEVICE_COMM_ERROR | DEVICE_TEMPORARY_ERROR | DEVICE_LOW_BATTERY);	/* Reset Communication Status and Low battery indicator */
@@ -456,6 +496,7 @@ __attribute__((noreturn)) void SUPERVISOR_Task(void* pvParameters)
 			DeviceFlashLed(5);
 			CLEAR_FLAG(DEVICE_UNINSTALLED);
 			DeviceUserDataSetFlag(FLAG_INSTALLED,FLAG_INSTALLED);
+			WARMSTART_Save();
 			DevicePostEvent(PERIODIC_EVENT);		// Force immediate communication
 		}
 		else
@@ -473,6 +514,7 @@ __attribute__((noreturn)) void SUPERVISOR_Task(void* pvParameters)
 		{
 			DeviceFlashLed(5);
 			INFO("Request to pseudo join has been completed.\n");
+			JOINRETRY_Succeeded(JoinStagePseudoJoin, false);
 			if (!bStepByStep)
 			{
 				DevicePostEvent(REQ_REAL_APP_KEY_ALLOC);
@@ -481,6 +523,10 @@ __attribute__((noreturn)) void SUPERVISOR_Task(void* pvParameters)
 		else
 		{
 			INFO("Request to pseudo join failed.\n");
+			if (!bStepByStep)
+			{
+				JOINRETRY_Failed(JoinStagePseudoJoin, LORAWAN_GetMlmeConfirm()->TxTimeOnAir);
+			}
 		}
 
 		CLEAR_FLAG(DEVICE_COMM_ERROR | DEVICE_TEMPORARY_ERROR | DEVICE_LOW_BATTERY);	/* Reset Communication Status and Low battery indicator */
@@ -494,6 +540,7 @@ __attribute__((noreturn)) void SUPERVISOR_Task(void* pvParameters)
 		if (SKTAPP_SendRealAppKeyAllocReq())
 		{
 			DeviceFlashLed(5);
+			JOINRETRY_Succeeded(JoinStageKeyAlloc, false);
 			if (!bStepByStep)
 			{
 				DevicePostEvent(REQ_REAL_APP_KEY_RX_REPORT);
@@ -505,7 +552,7 @@ __attribute__((noreturn)) void SUPERVISOR_Task(void* pvParameters)
 			INFO("Request to real app key alloc failed.\n");
 			if (!bStepByStep)
 			{
-				DevicePostEvent(REQ_REAL_APP_KEY_ALLOC);
+				JOINRETRY_Failed(JoinStageKeyAlloc, LORAWAN_GetConfirm()->TxTimeOnAir);
 			}
 		}
 
@@ -520,6 +567,7 @@ __attribute__((noreturn)) void SUPERVISOR_Task(void* pvParameters)
 		if (SKTAPP_SendRealAppKeyRxReportReq())
 		{
 			DeviceFlashLed(5);
+			JOINRETRY_Succeeded(JoinStageKeyRxReport, false);
 			if (!bStepByStep)
 			{
 				DevicePostEvent(REAL_JOIN_NETWORK);
@@ -531,7 +579,7 @@ __attribute__((noreturn)) void SUPERVISOR_Task(void* pvParameters)
 			INFO("Request to real app key rx report failed.\n");
 			if (!bStepByStep)
 			{
-				DevicePostEvent(REQ_REAL_APP_KEY_RX_REPORT);
+				JOINRETRY_Failed(JoinStageKeyRxReport, LORAWAN_GetConfirm()->TxTimeOnAir);
 			}
 		}
 
@@ -547,11 +595,16 @@ __attribute__((noreturn)) void SUPERVISOR_Task(void* pvParameters)
 		{
 			DeviceFlashLed(5);
 			INFO("Request to real join has been completed.\n");
+			JOINRETRY_Succeeded(JoinStageRealJoin, true);
 			DevicePostEvent(REAL_JOIN_NETWORK_COMPLETED);
 		}
 		else
 		{
 			INFO("Request to real join failed.\n");
+			if (!bStepByStep)
+			{
+				JOINRETRY_Failed(JoinStageRealJoin, LORAWAN_GetMlmeConfirm()->TxTimeOnAir);
+			}
 		}
 
 		CLEAR_FLAG(DEVICE_COMM_ERROR | DEVICE_TEMPORARY_ERROR | DEVICE_LOW_BATTERY);	/* Reset Communication Status and Low battery indicator */
@@ -562,6 +615,7 @@ __attribute__((noreturn)) void SUPERVISOR_Task(void* pvParameters)
 		CLEAR_FLAG(DEVICE_UNINSTALLED);
 		DeviceUserDataSetFlag(FLAG_INSTALLED,FLAG_INSTALLED);
 		DeviceUserDataSetFlag(FLAG_USE_RAK,FLAG_USE_RAK);
+		WARMSTART_Save();
 
 		if (!bStepByStep)
 		{
@@ -571,7 +625,8 @@ __attribute__((noreturn)) void SUPERVISOR_Task(void* pvParameters)
 
 	case SYSTEM_RESET:
 		{
-			DeviceFlashLed(20);
+			DeviceAlertLed(20);
+			LEDPATTERN_Wait(0);
 			SystemReboot();
 		}
 		break;
@@ -0,0 +1,127 @@
+/*******************************************************************
+** time_sync.c                                                    **
+**                                                                **
+** Network time synchronization                                   **
+**                                                                **
+*******************************************************************/
+/** \addtogroup S40 S40 Main Application
+ *  @{
+ */
+
+#include "global.h"
+#include "time_sync.h"
+#include "lorawan_task.h"
+#include "system.h"
+#include "timebase.h"
+#include "timer.h"
+#include "trace.h"
+
+#undef	__MODULE__
+#define	__MODULE__	FLAG_TRACE_SUPERVISOR
+
+/*
+ * The network time is requested with the DeviceTimeReq MAC command, piggybacked on a periodic
+ * uplink. DeviceTimeAns gives the time at the end of that uplink, so the time elapsed since the
+ * radio finished transmitting (receive windows, MAC and event processing) is added to it.
+ * Each synchronization steps the RTC to the network time. The errors corrected since the last
+ * drift estimation are accumulated, and once they cover TIMESYNC_MIN_INTERVAL, the residual
+ * drift of the crystal is added to the RTC rate correction, which trims every tick from then on.
+ * The rate correction is kept in an RTCC retention register so that it survives a reset: the
+ * low 20 bits hold the correction, the high 12 bits the complement of its low 12 bits.
+ */
+/** @cond */
+#define TIMESYNC_TICKS(seconds)		((int64_t)(seconds) << TIMEBASE_SHIFT)
+#define TIMESYNC_PPB				1000000000LL
+#define TIMESYNC_TRIM_BITS			20
+#define TIMESYNC_TRIM_MASK			((1UL << TIMESYNC_TRIM_BITS) - 1)
+
+// The rate correction must fit in the retained bits
+typedef char TIMESYNC_TRIM_CHECK[(TIMESYNC_MAX_TRIM < (1L << (TIMESYNC_TRIM_BITS - 1))) ? 1 : -1];
+
+static TIMESYNC_STATUS	Status;
+static unsigned long	NextSync = 0;		// Uptime of the next request (in seconds)
+static uint64_t			Reference = 0;		// Uptime of the last drift estimation (in ticks)
+static int64_t			Accumulated = 0;	// Errors corrected since the reference (in ticks)
+/** @endcond */
+
+static void TIMESYNCSaveTrim(long trim) {
+	if (SystemGetNVRAMSize() <= TIMESYNC_NVRAM_INDEX) return;
+	uint32_t value = (uint32_t)trim & TIMESYNC_TRIM_MASK;
+	SystemSetNVRAMValue(TIMESYNC_NVRAM_INDEX, (int)(value | (~value << TIMESYNC_TRIM_BITS)));
+}
+
+static long TIMESYNCClamp(int64_t value, long limit) {
+	if (value > limit) return limit;
+	if (value < -limit) return -limit;
+	return (long)value;
+}
+
+void TIMESYNC_Init(void) {
+	if (SystemGetNVRAMSize() <= TIMESYNC_NVRAM_INDEX) return;
+	uint32_t value = (uint32_t)SystemGetNVRAMValue(TIMESYNC_NVRAM_INDEX);
+	if ((value >> TIMESYNC_TRIM_BITS) != ((~value << TIMESYNC_TRIM_BITS) >> TIMESYNC_TRIM_BITS))
+		return;
+	// Sign extend the correction
+	long trim = (long)((value & TIMESYNC_TRIM_MASK) ^ (1UL << (TIMESYNC_TRIM_BITS - 1))) - (1L << (TIMESYNC_TRIM_BITS - 1));
+	if (trim != TIMESYNCClamp(trim, TIMESYNC_MAX_TRIM))
+		return;
+	RTCSetTrim(trim);
+	TRACE(5, "Clock trim %ld ppb restored.\n", trim);
+}
+
+bool TIMESYNC_IsDue(void) {
+	return ((long)(SystemGetSystemSeconds() - NextSync) >= 0);
+}
+
+bool TIMESYNC_Request(void) {
+	if (!LORAWAN_RequestDevTime()) return false;
+	NextSync = SystemGetSystemSeconds() + TIMESYNC_RETRY;
+	return true;
+}
+
+void TIMESYNC_Confirm(const MlmeConfirm_t* confirm) {
+	if ((confirm->Status != LORAMAC_EVENT_INFO_STATUS_OK) || (confirm->Epoch < TIMESYNC_EPOCH_OFFSET)) return;
+
+	// Network time at the end of the uplink, then now
+	uint64_t network = ((uint64_t)(confirm->Epoch - TIMESYNC_EPOCH_OFFSET) << TIMEBASE_SHIFT) +
+			(confirm->FracSec >> (16 - TIMEBASE_SHIFT));
+#if (TIMESYNC_AT_TX_START > 0)
+	network += TimeBaseMsToTicks(confirm->TxTimeOnAir);
+#endif
+	network += TimeBaseMsToTicks(TimerGetCurrentTime() - confirm->TxDoneTime);
+	uint64_t uptime = TimeBaseGetTicks64();
+	int64_t offset = (int64_t)(network - RTCGetTicks());
+
+	if ((Status.Count == 0) || (offset > TIMESYNC_TICKS(TIMESYNC_MAX_STEP)) || (offset < -TIMESYNC_TICKS(TIMESYNC_MAX_STEP))) {
+		// First synchronization, or the clock is too far off to be drifting: restart the estimation
+		Reference = uptime;
+		Accumulated = 0;
+	} else {
+		Accumulated += offset;
+		uint64_t interval = uptime - Reference;
+		if (interval >= (uint64_t)TIMESYNC_TICKS(TIMESYNC_MIN_INTERVAL)) {
+			// The rate correction did not change since the reference, the error left is its own
+			Status.Drift = (int32_t)TIMESYNCClamp((Accumulated * TIMESYNC_PPB) / (int64_t)interval, TIMESYNC_MAX_TRIM);
+			Status.Interval = (uint32_t)(interval >> TIMEBASE_SHIFT);
+			long trim = TIMESYNCClamp((int64_t)RTCGetTrim() + Status.Drift, TIMESYNC_MAX_TRIM);
+			RTCSetTrim(trim);
+			TIMESYNCSaveTrim(trim);
+			Reference = uptime;
+			Accumulated = 0;
+			INFO("Clock drift %ld ppb over %lu s, trim %ld ppb.\n", (long)Status.Drift, (unsigned long)Status.Interval, trim);
+		}
+	}
+	RTCSetTicks(network);
+
+	Status.Count++;
+	Status.LastSync = (uint32_t)(network >> TIMEBASE_SHIFT);
+	Status.Offset = (int32_t)TIMESYNCClamp((offset * 1000) >> TIMEBASE_SHIFT, 0x7FFFFFFFL);
+	NextSync = SystemGetSystemSeconds() + TIMESYNC_PERIOD;
+	INFO("Clock synchronized, error %ld ms.\n", (long)Status.Offset);
+}
+
+const TIMESYNC_STATUS* TIMESYNC_GetStatus(void) {
+	return &Status;
+}
+
+/** }@ */
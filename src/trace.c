@@ -55,6 +55,42 @@ const static TRACE_LEVEL_CONFIG pTraceLevelInfo[] =
 static TRACE_LEVEL	xTraceLevel = TRACE_LEVEL_DEBUG_3;
 static char			pTraceBuffer[256];
 
+/*!
+ * @brief Last trace output, kept for the crash reports
+ */
+static char			pTraceHistory[TRACE_HISTORY_SIZE];
+static uint32_t		ulTraceHistoryLen = 0;		// Number of bytes ever written
+
+static void	TRACE_Record(const char* pBuffer, uint32_t ulLen)
+{
+	if (ulLen >= sizeof(pTraceBuffer))
+	{
+		ulLen = sizeof(pTraceBuffer) - 1;
+	}
+
+	for(uint32_t i = 0 ; i < ulLen ; i++)
+	{
+		pTraceHistory[ulTraceHistoryLen++ % TRACE_HISTORY_SIZE] = pBuffer[i];
+	}
+}
+
+uint32_t	TRACE_GetHistory(char* pBuffer, uint32_t ulSize)
+{
+	uint32_t	ulLen = (ulTraceHistoryLen < TRACE_HISTORY_SIZE) ? ulTraceHistoryLen : TRACE_HISTORY_SIZE;
+
+	if (ulLen > ulSize)
+	{
+		ulLen = ulSize;
+	}
+
+	for(uint32_t i = 0 ; i < ulLen ; i++)
+	{
+		pBuffer[i] = pTraceHistory[(ulTraceHistoryLen - ulLen + i) % TRACE_HISTORY_SIZE];
+	}
+
+	return	ulLen;
+}
+
 void		TRACE_ShowConfig(void)
 {
 	SHELL_Printf("%16s : %s\n", "Mode", (TRACE_GetEnable())?"Enable":"Disabled");
@@ -112,6 +148,7 @@ uint32_t	TRACE_Printf(TRACE_LEVEL xLevel, uint16_t xModule, const char *pFormat,
 
 		va_end(xArgs);
 
+		TRACE_Record(pTraceBuffer, ulLen);
 		nOutputLength = SHELL_Print(pTraceBuffer, ulLen);
 	}
 
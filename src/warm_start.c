@@ -0,0 +1,308 @@
+/*******************************************************************
+** warm_start.c                                                   **
+**                                                                **
+** Retained MAC session snapshot (warm start)                     **
+**                                                                **
+*******************************************************************/
+/** \addtogroup S40 S40 Main Application
+ *  @{
+ */
+
+#include "global.h"
+#include "warm_start.h"
+#include "retention.h"
+#include "lorawan_task.h"
+#include "system.h"
+#include "crc16.h"
+#include "trace.h"
+#include <flash.h>
+#include <string.h>
+
+#undef	__MODULE__
+#define	__MODULE__	FLAG_TRACE_SUPERVISOR
+
+/*
+ * The joined MAC session is kept in two places:
+ *   - the RTCC retention registers, which survive every reset but a power-on reset (and EM4).
+ *     They are updated when each uplink is sent, already holding the next frame counter as the
+ *     MAC only increments it after the receive windows, and again after its confirmation.
+ *   - the Flash Memory, which survives a battery failure. Snapshots are appended to a ring
+ *     of pages, the one with the highest sequence number is the current one. To save Flash
+ *     Memory cycles, a snapshot reserves WARMSTART_FCNT_GAP uplink frame counter values and
+ *     is only written again once they are used, or when the network changed the session
+ *     parameters. A session restored from Flash Memory skips the reserved values, so a
+ *     frame counter is never sent twice.
+ * Each snapshot is protected by a CRC, and by a CRC of the provisioned keys so that a session
+ * is not restored after the device was provisioned again.
+ */
+/** @cond */
+#define WARMSTART_VERSION		1
+#define WARMSTART_PAGE_SIZE		2048		// Same as FLASH_PAGE
+#define WARMSTART_SLOT_SIZE		128
+#define WARMSTART_SLOTS			(WARMSTART_PAGE_SIZE / WARMSTART_SLOT_SIZE)
+#define WARMSTART_WORDS			((int)(sizeof(WARMSTART_SNAPSHOT) / sizeof(uint32_t)))
+#define WARMSTART_NVRAM_END		(WARMSTART_NVRAM_INDEX + WARMSTART_WORDS)
+#define WARMSTART_ACTIVE		0x0001		// Snapshot holds a session (cleared by an invalidation)
+
+typedef struct {
+	uint16_t Crc;					// CRC16 of the following bytes
+	uint8_t Version;
+	uint8_t Size;					// Snapshot size, in bytes
+	uint32_t Sequence;				// Flash Memory snapshot sequence number
+	uint32_t Age;					// Time since the join (in seconds)
+	uint16_t KeysCrc;				// CRC16 of the provisioned keys
+	uint16_t Flags;
+	LORAWAN_SESSION Session;
+} WARMSTART_SNAPSHOT;
+
+// A snapshot must fit in a Flash Memory slot and in the retention registers below the time_sync and join_retry ones
+typedef char WARMSTART_SIZE_CHECK[((sizeof(WARMSTART_SNAPSHOT) <= WARMSTART_SLOT_SIZE) && ((sizeof(WARMSTART_SNAPSHOT) % sizeof(uint32_t)) == 0)) ? 1 : -1];
+typedef char WARMSTART_NVRAM_CHECK[((WARMSTART_NVRAM_END <= TIMESYNC_NVRAM_INDEX) && (WARMSTART_NVRAM_END <= JOIN_RETRY_NVRAM_INDEX)) ? 1 : -1];
+
+static const uint8_t	__attribute__((aligned(WARMSTART_PAGE_SIZE)))
+						__attribute__ ((__used__))
+_WARMSTARTPAGES_[WARMSTART_PAGES][WARMSTART_PAGE_SIZE] = {
+	[0 ... (WARMSTART_PAGES - 1)] = { [0 ... (WARMSTART_PAGE_SIZE - 1)] = 0xFF }
+};
+// Force the compiler to read real Flash Memory contents instead of the initialization values
+#define WARMSTART_SLOTPTR(p,s)	((volatile const uint8_t*)&_WARMSTARTPAGES_[(p)][(s) * WARMSTART_SLOT_SIZE])
+
+static WARMSTART_SNAPSHOT	Snapshot;				// Last saved snapshot
+static bool				bActive = false;			// A session is saved after each uplink
+static unsigned long	AgeBase = 0;				// Session age when it was saved or restored
+static unsigned long	AgeStart = 0;				// RTC time when it was saved or restored
+// Flash Memory ring state
+static int				FlashPage = 0;				// Page holding the newest snapshot
+static int				FlashSlot = 0;				// Next free slot in FlashPage
+static uint32_t			FlashSequence = 0;
+static bool				bFlashActive = false;		// Newest snapshot holds a session
+static uint32_t			FlashUpLinkCounter = 0;		// Uplink counter reserved by the newest snapshot
+static uint16_t			FlashParamsCrc = 0;			// Session parameters of the newest snapshot
+/** @endcond */
+
+static uint16_t WARMSTARTCrc(const WARMSTART_SNAPSHOT* snapshot) {
+	return CRC16_CalculateRange(((const unsigned char*)snapshot) + sizeof(uint16_t), sizeof(WARMSTART_SNAPSHOT) - sizeof(uint16_t), 0xFFFF);
+}
+
+static bool WARMSTARTIsValid(const WARMSTART_SNAPSHOT* snapshot) {
+	return (snapshot->Version == WARMSTART_VERSION) && (snapshot->Size == sizeof(WARMSTART_SNAPSHOT))
+			&& (snapshot->Crc == WARMSTARTCrc(snapshot));
+}
+
+/*
+ * CRC of everything used to join: a new provisioning discards the saved session
+ */
+static uint16_t WARMSTARTKeysCrc(void) {
+	LORAWAN_INFO info;
+	unsigned char realAppKey[16];
+	unsigned char flags = (unsigned char)((UNIT_USE_OTAA ? 1 : 0) | (UNIT_USE_SKT_APP ? 2 : 0) | (UNIT_USE_RAK ? 4 : 0));
+	volatile const unsigned char* ptr = (volatile const unsigned char*)&(USERDATAPTR)->LoRaWAN;
+	for (int i = 0; i < sizeof(info); i++) ((unsigned char*)&info)[i] = ptr[i];
+	for (int i = 0; i < sizeof(realAppKey); i++) realAppKey[i] = UNIT_REALAPPKEY[i];
+	unsigned short crc = CRC16_Init();
+	crc = CRC16_Update(crc, &info, sizeof(info));
+	crc = CRC16_Update(crc, realAppKey, sizeof(realAppKey));
+	crc = CRC16_Update(crc, &flags, sizeof(flags));
+	return CRC16_Final(crc);
+}
+
+/*
+ * CRC of the session parameters, the frame counters excluded
+ */
+static uint16_t WARMSTARTParamsCrc(const LORAWAN_SESSION* session) {
+	LORAWAN_SESSION params = *session;
+	params.UpLinkCounter = 0;
+	params.DownLinkCounter = 0;
+	return CRC16_CalculateRange((unsigned char*)&params, sizeof(params), 0xFFFF);
+}
+
+static void WARMSTARTCapture(WARMSTART_SNAPSHOT* snapshot) {
+	memset(snapshot, 0, sizeof(WARMSTART_SNAPSHOT));
+	snapshot->Version = WARMSTART_VERSION;
+	snapshot->Size = sizeof(WARMSTART_SNAPSHOT);
+	snapshot->Age = AgeBase + (SystemGetSystemSeconds() - AgeStart);
+	snapshot->KeysCrc = WARMSTARTKeysCrc();
+	snapshot->Flags = WARMSTART_ACTIVE;
+	LORAWAN_GetSession(&snapshot->Session);
+	snapshot->Crc = WARMSTARTCrc(snapshot);
+}
+
+static bool WARMSTARTReadRetained(WARMSTART_SNAPSHOT* snapshot) {
+	if (SystemGetNVRAMSize() < WARMSTART_NVRAM_END) return false;
+	for (int i = 0; i < WARMSTART_WORDS; i++)
+		((uint32_t*)snapshot)[i] = (uint32_t)SystemGetNVRAMValue(WARMSTART_NVRAM_INDEX + i);
+	return WARMSTARTIsValid(snapshot) && (snapshot->Flags & WARMSTART_ACTIVE);
+}
+
+static void WARMSTARTWriteRetained(const WARMSTART_SNAPSHOT* snapshot) {
+	if (SystemGetNVRAMSize() < WARMSTART_NVRAM_END) return;
+	// The CRC word is written last, a reset in between leaves an invalid copy
+	SystemSetNVRAMValue(WARMSTART_NVRAM_INDEX, 0);
+	for (int i = 1; i < WARMSTART_WORDS; i++)
+		SystemSetNVRAMValue(WARMSTART_NVRAM_INDEX + i, (int)((const uint32_t*)snapshot)[i]);
+	SystemSetNVRAMValue(WARMSTART_NVRAM_INDEX, (int)((const uint32_t*)snapshot)[0]);
+}
+
+static void WARMSTARTReadSlot(int page, int slot, WARMSTART_SNAPSHOT* snapshot) {
+	volatile const uint8_t* ptr = WARMSTART_SLOTPTR(page, slot);
+	for (int i = 0; i < sizeof(WARMSTART_SNAPSHOT); i++)
+		((uint8_t*)snapshot)[i] = ptr[i];
+}
+
+/*
+ * Find the newest Flash Memory snapshot and the next free slot
+ */
+static bool WARMSTARTScanFlash(WARMSTART_SNAPSHOT* newest) {
+	WARMSTART_SNAPSHOT snapshot;
+	bool bFound = false;
+	FlashPage = 0;
+	FlashSlot = 0;
+	for (int p = 0; p < WARMSTART_PAGES; p++) {
+		int used = 0;
+		// Slots are written in order, the first blank one ends the page
+		while ((used < WARMSTART_SLOTS) && (*(volatile const uint32_t*)WARMSTART_SLOTPTR(p, used) != 0xFFFFFFFFUL)) {
+			WARMSTARTReadSlot(p, used++, &snapshot);
+			if (!WARMSTARTIsValid(&snapshot)) continue;
+			if (bFound && ((int32_t)(snapshot.Sequence - newest->Sequence) <= 0)) continue;
+			*newest = snapshot;
+			bFound = true;
+			FlashPage = p;
+		}
+		if (bFound && (FlashPage == p)) FlashSlot = used;
+	}
+	if (!bFound) {
+		// Nothing valid, the first write erases the first page
+		FlashPage = WARMSTART_PAGES - 1;
+		FlashSlot = WARMSTART_SLOTS;
+	}
+	FlashSequence = bFound ? newest->Sequence : 0;
+	bFlashActive = bFound && (newest->Flags & WARMSTART_ACTIVE);
+	FlashUpLinkCounter = bFlashActive ? newest->Session.UpLinkCounter : 0;
+	FlashParamsCrc = bFlashActive ? WARMSTARTParamsCrc(&newest->Session) : 0;
+	return bFlashActive;
+}
+
+/*
+ * Append a snapshot to the Flash Memory ring, reserving WARMSTART_FCNT_GAP uplink counter values
+ */
+static bool WARMSTARTWriteFlash(const WARMSTART_SNAPSHOT* snapshot) {
+	WARMSTART_SNAPSHOT record = *snapshot;
+	int page = FlashPage;
+	int slot = FlashSlot;
+	signed char rc = FLASH_NO_ERROR;
+	if (record.Flags & WARMSTART_ACTIVE)
+		record.Session.UpLinkCounter += WARMSTART_FCNT_GAP;
+	record.Sequence = FlashSequence + 1;
+	record.Crc = WARMSTARTCrc(&record);
+	vTaskSuspendAll();
+	FLASHOpen();
+	if (slot >= WARMSTART_SLOTS) {
+		// The other pages still hold the newest snapshot if the erase is interrupted
+		page = (page + 1) % WARMSTART_PAGES;
+		slot = 0;
+		rc = FLASHEraseBlock((void*)WARMSTART_SLOTPTR(page, 0));
+	}
+	if (rc == FLASH_NO_ERROR)
+		rc = FLASHWrite((void*)WARMSTART_SLOTPTR(page, slot), (unsigned char*)&record, sizeof(record));
+	FLASHClose();
+	xTaskResumeAll();
+	if (rc != FLASH_NO_ERROR) {
+		ERROR("Session snapshot write failed (%d).\n", rc);
+		FlashSlot = WARMSTART_SLOTS;		// Move to the next page on the next write
+		return false;
+	}
+	FlashPage = page;
+	FlashSlot = slot + 1;
+	FlashSequence = record.Sequence;
+	bFlashActive = (record.Flags & WARMSTART_ACTIVE) != 0;
+	FlashUpLinkCounter = record.Session.UpLinkCounter;
+	FlashParamsCrc = WARMSTARTParamsCrc(&record.Session);
+	return true;
+}
+
+/*
+ * Write a new Flash Memory snapshot before the reserved uplink counter values are used
+ */
+static void WARMSTARTReserve(void) {
+	if (!bFlashActive || (Snapshot.Session.UpLinkCounter >= FlashUpLinkCounter)
+			|| (WARMSTARTParamsCrc(&Snapshot.Session) != FlashParamsCrc))
+		WARMSTARTWriteFlash(&Snapshot);
+}
+
+bool WARMSTART_Restore(void) {
+	RESETCAUSE cause = SystemRebootCause();
+	WARMSTART_SNAPSHOT flash;
+	bool bFlash = WARMSTARTScanFlash(&flash);
+
+	bActive = false;
+	if (!UNIT_INSTALLED) return false;
+	// A power-on or an unknown reset always starts with a join
+	if ((cause == UNKNOWN) || (cause & POWER_ON)) {
+		INFO("Cold start (reset cause %02X).\n", cause);
+		return false;
+	}
+	// An external reset (or EM4 wake-up) only resumes a session kept in retained RAM
+	if (!WARMSTARTReadRetained(&Snapshot)) {
+		if (!bFlash || (cause == EXTERNAL)) return false;
+		Snapshot = flash;
+		TRACE(5, "Session restored from Flash Memory.\n");
+	}
+	if ((Snapshot.Age > WARMSTART_MAX_AGE) || (Snapshot.KeysCrc != WARMSTARTKeysCrc())) {
+		INFO("Session expired.\n");
+		return false;
+	}
+	if (!LORAWAN_RestoreSession(&Snapshot.Session)) {
+		ERROR("Session restore failed.\n");
+		return false;
+	}
+	AgeBase = Snapshot.Age;
+	AgeStart = SystemGetSystemSeconds();
+	bActive = true;
+	WARMSTARTWriteRetained(&Snapshot);
+	WARMSTARTReserve();
+	INFO("Warm start (reset cause %02X), DevAddr %08lX, FCnt %lu.\n", cause,
+			(unsigned long)Snapshot.Session.DevAddr, (unsigned long)Snapshot.Session.UpLinkCounter);
+	return true;
+}
+
+void WARMSTART_Save(void) {
+	AgeBase = 0;
+	AgeStart = SystemGetSystemSeconds();
+	bActive = true;
+	WARMSTARTCapture(&Snapshot);
+	WARMSTARTWriteRetained(&Snapshot);
+	WARMSTARTWriteFlash(&Snapshot);
+}
+
+void WARMSTART_Update(void) {
+	if (!bActive) return;
+	WARMSTARTCapture(&Snapshot);
+	WARMSTARTWriteRetained(&Snapshot);
+	WARMSTARTReserve();
+}
+
+void WARMSTART_TxDone(uint32_t upLinkCounter) {
+	if (!bActive) return;
+	WARMSTARTCapture(&Snapshot);
+	if ((int32_t)(Snapshot.Session.UpLinkCounter - upLinkCounter) <= 0) {
+		Snapshot.Session.UpLinkCounter = upLinkCounter + 1;
+		Snapshot.Crc = WARMSTARTCrc(&Snapshot);
+	}
+	WARMSTARTWriteRetained(&Snapshot);
+	WARMSTARTReserve();
+}
+
+void WARMSTART_Invalidate(void) {
+	bActive = false;
+	if (SystemGetNVRAMSize() >= WARMSTART_NVRAM_END)
+		SystemSetNVRAMValue(WARMSTART_NVRAM_INDEX, 0);
+	if (bFlashActive) {
+		WARMSTART_SNAPSHOT snapshot;
+		memset(&snapshot, 0, sizeof(snapshot));
+		snapshot.Version = WARMSTART_VERSION;
+		snapshot.Size = sizeof(WARMSTART_SNAPSHOT);
+		WARMSTARTWriteFlash(&snapshot);
+	}
+}
+
+/** }@ */
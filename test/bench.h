@@ -0,0 +1,191 @@
+/*******************************************************************
+**                                                                **
+** Host benchmark helpers                                         **
+**                                                                **
+*******************************************************************/
+/*
+ * A hot path operation is measured twice:
+ * - its instruction count, by single stepping one run in a traced child process (after a warm
+ *   up run resolving the lazy bindings), less the count of an empty operation. The count does
+ *   not depend on the load of the host, it is compared to the baseline of the operation in
+ *   BENCH_BASELINES and a count over it by more than PERF_THRESHOLD_PCT is a regression,
+ * - its time, as the mean of enough runs to last BENCH_TIME in a child process, reported only.
+ * The operations run in child processes only, so they all start from the state set by main.
+ * An operation must do the same work at every run.
+ *
+ * With --baseline, the counts are printed as baseline lines instead ("make -C test baselines").
+ * The PERF_THRESHOLD_PCT environment variable overrides the threshold.
+ */
+
+#ifndef __BENCH_H__
+#define __BENCH_H__
+
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/ptrace.h>
+#include <sys/wait.h>
+#include "perf.h"
+
+/** @cond */
+#define BENCH_BASELINES		"perf_baselines.txt"
+#define BENCH_TIME			0.1					// Timed runs duration (in s)
+
+static const char* BenchProgram;
+static int BenchBaselineMode;
+static int BenchThreshold;
+static unsigned long BenchOverhead;
+static unsigned long BenchRegressions;
+/** @endcond */
+
+static double BenchNow(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void BenchEmpty(void) {
+}
+
+/*
+ * Instructions of a run of op, between the two stops of the child
+ */
+static unsigned long BenchCountOnce(void (*op)(void)) {
+	unsigned long steps = 0;
+	int status;
+	pid_t pid;
+
+	fflush(stdout);
+	fflush(stderr);
+	pid = fork();
+	if (pid == 0) {
+		if (ptrace(PTRACE_TRACEME, 0, NULL, NULL) != 0) _exit(1);
+		op();
+		raise(SIGSTOP);
+		op();
+		raise(SIGSTOP);
+		_exit(0);
+	}
+	if ((pid < 0) || (waitpid(pid, &status, 0) != pid)) return 0;
+	if (!WIFSTOPPED(status)) return 0;
+	for (;;) {
+		if (ptrace(PTRACE_SINGLESTEP, pid, NULL, NULL) != 0) {
+			steps = 0;
+			break;
+		}
+		if ((waitpid(pid, &status, 0) != pid) || !WIFSTOPPED(status)) {
+			steps = 0;
+			break;
+		}
+		if (WSTOPSIG(status) != SIGTRAP) break;
+		steps++;
+	}
+	kill(pid, SIGKILL);
+	waitpid(pid, &status, 0);
+	return steps;
+}
+
+/*
+ * Mean time of a run of op (in ns), 0 on failure
+ */
+static double BenchTimeRuns(void (*op)(void)) {
+	double start, elapsed, ns = 0;
+	unsigned long runs;
+	int fds[2], status;
+	pid_t pid;
+
+	if (pipe(fds) != 0) return 0;
+	fflush(stdout);
+	fflush(stderr);
+	pid = fork();
+	if (pid == 0) {
+		close(fds[0]);
+		for (runs = 1;; runs *= 2) {
+			start = BenchNow();
+			for (unsigned long r = 0; r < runs; r++) op();
+			elapsed = BenchNow() - start;
+			if (elapsed >= BENCH_TIME) break;
+		}
+		ns = elapsed * 1e9 / runs;
+		_exit((write(fds[1], &ns, sizeof(ns)) == sizeof(ns)) ? 0 : 1);
+	}
+	close(fds[1]);
+	if ((pid > 0) && (read(fds[0], &ns, sizeof(ns)) != sizeof(ns))) ns = 0;
+	close(fds[0]);
+	if (pid > 0) waitpid(pid, &status, 0);
+	return ns;
+}
+
+static unsigned long BenchBaseline(const char* name) {
+	char line[160], program[64], op[64];
+	unsigned long count, baseline = 0;
+	FILE* file = fopen(BENCH_BASELINES, "r");
+
+	if (file == NULL) return 0;
+	while (fgets(line, sizeof(line), file) != NULL) {
+		if (line[0] == '#') continue;
+		if (sscanf(line, "%63s %63s %lu", program, op, &count) != 3) continue;
+		if ((strcmp(program, BenchProgram) == 0) && (strcmp(op, name) == 0)) baseline = count;
+	}
+	fclose(file);
+	return baseline;
+}
+
+/*!
+ * @brief Start the benchmark of a program
+ */
+static void BENCH_Init(int argc, char* argv[]) {
+	const char* slash = strrchr(argv[0], '/');
+
+	BenchProgram = (slash != NULL) ? slash + 1 : argv[0];
+	BenchBaselineMode = (argc > 1) && (strcmp(argv[1], "--baseline") == 0);
+	BenchThreshold = (getenv("PERF_THRESHOLD_PCT") != NULL) ? atoi(getenv("PERF_THRESHOLD_PCT")) : PERF_THRESHOLD_PCT;
+	BenchOverhead = BenchCountOnce(BenchEmpty);
+	if (BenchOverhead == 0) {
+		fprintf(stderr, "%s: cannot single step a child process\n", BenchProgram);
+		exit(1);
+	}
+}
+
+/*!
+ * @brief Measure an operation and check its instruction count against its baseline
+ * @return Instructions of a run
+ */
+static unsigned long BENCH_Run(const char* name, void (*op)(void)) {
+	unsigned long count = BenchCountOnce(op);
+	unsigned long baseline;
+
+	if (count <= BenchOverhead) {
+		fprintf(stderr, "%s: %s cannot be single stepped\n", BenchProgram, name);
+		BenchRegressions++;
+		return 0;
+	}
+	count -= BenchOverhead;
+	if (BenchBaselineMode) {
+		printf("%s %s %lu\n", BenchProgram, name, count);
+		return count;
+	}
+	baseline = BenchBaseline(name);
+	printf("%s: %-28s %10.1f ns/op %9lu instructions", BenchProgram, name, BenchTimeRuns(op), count);
+	if (baseline == 0) {
+		printf(", no baseline\n");
+		BenchRegressions++;
+	} else {
+		double delta = ((double)count - baseline) * 100 / baseline;
+		bool regression = delta > BenchThreshold;
+		printf(", baseline %lu %+.1f%%%s\n", baseline, delta, regression ? " REGRESSION" : "");
+		if (regression) BenchRegressions++;
+	}
+	return count;
+}
+
+/*!
+ * @brief Report the benchmark result, to be returned by main
+ */
+#define BENCH_END()	(fflush(stdout), (BenchRegressions) ? (fprintf(stderr, "%s: %lu operations without baseline or over it by more than %d%%\n", \
+	BenchProgram, BenchRegressions, BenchThreshold), 1) : 0)
+
+#endif
@@ -0,0 +1,173 @@
+/*******************************************************************
+**                                                                **
+** RegionCommon channels mask benchmark                           **
+**                                                                **
+*******************************************************************/
+/*
+ * Time of the channel selection of NextChannel, usable channels then n-th one, of
+ * RegionCommonCountChannels and of RegionCommonChanVerifyDr, against the previous loops
+ * which tested the 16 bits of each channels mask word, on 16, 72 and 96 channels plans.
+ */
+
+#include <stdlib.h>
+#include <time.h>
+#include "timer.h"
+#include "LoRaMac.h"
+#include "Region.h"
+#include "RegionCommon.h"
+#include "test.h"
+
+/** @cond */
+#define BENCH_CALLS			2000000UL
+#define MASK_WORDS			6
+#define MAX_CHANNELS		96
+#define NB_BANDS			1
+
+typedef struct {
+	const char*		Name;
+	uint8_t			MaxNbChannels;
+	uint16_t		Mask[MASK_WORDS];
+} PLAN;
+
+static const PLAN Plans[] = {
+	{ "KR920 3 channels", 16, { 0x0007 } },
+	{ "EU868 16 channels", 16, { 0xFFFF } },
+	{ "US915 sub-band 2", 72, { 0xFF00, 0x0000, 0x0000, 0x0000, 0x0002 } },
+	{ "US915 72 channels", 72, { 0xFFFF, 0xFFFF, 0xFFFF, 0xFFFF, 0x00FF } },
+	{ "CN470 96 channels", 96, { 0xFFFF, 0xFFFF, 0xFFFF, 0xFFFF, 0xFFFF, 0xFFFF } },
+};
+/** @endcond */
+
+/*
+ * Previous implementations, a bit at a time
+ */
+static uint8_t RefCountChannels(uint16_t* channelsMask, uint8_t startIdx, uint8_t stopIdx) {
+	uint8_t nbChannels = 0;
+	for (uint8_t i = startIdx; i < stopIdx; i++)
+		for (uint8_t j = 0; j < 16; j++)
+			if ((channelsMask[i] & (1 << j)) == (1 << j)) nbChannels++;
+	return nbChannels;
+}
+
+static uint8_t RefCountNbOfEnabledChannels(RegionCommonCountNbOfEnabledChannelsParams_t* params,
+		uint8_t* enabledChannels, uint8_t* delayTx) {
+	uint8_t nbEnabledChannels = 0, delayTransmission = 0;
+	for (uint8_t i = 0, k = 0; i < params->MaxNbChannels; i += 16, k++) {
+		for (uint8_t j = 0; j < 16; j++) {
+			ChannelParams_t* channel = &params->Channels[i + j];
+			if ((params->ChannelsMask[k] & (1 << j)) == 0) continue;
+			if (channel->Frequency == 0) continue;
+			if (!params->Joined && ((params->JoinChannels & (1 << j)) == 0)) continue;
+			if (!RegionCommonValueInRange(params->Datarate, channel->DrRange.Fields.Min, channel->DrRange.Fields.Max)) continue;
+			if (params->Bands[channel->Band].TimeOff > 0) {
+				delayTransmission++;
+				continue;
+			}
+			enabledChannels[nbEnabledChannels++] = i + j;
+		}
+	}
+	*delayTx = delayTransmission;
+	return nbEnabledChannels;
+}
+
+static bool RefChanVerifyDr(uint8_t nbChannels, uint16_t* channelsMask, int8_t dr, int8_t minDr, int8_t maxDr,
+		ChannelParams_t* channels) {
+	if (!RegionCommonValueInRange(dr, minDr, maxDr)) return false;
+	for (uint8_t i = 0, k = 0; i < nbChannels; i += 16, k++)
+		for (uint8_t j = 0; j < 16; j++)
+			if (((channelsMask[k] & (1 << j)) != 0) && RegionCommonValueInRange(dr,
+					(channels[i + j].DrRange.Fields.Min & 0x0F), (channels[i + j].DrRange.Fields.Max & 0x0F)))
+				return true;
+	return false;
+}
+
+static double Now(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/*******************************************************************
+** Emulated seams                                                 **
+*******************************************************************/
+TimerTime_t TimerGetElapsedTime(TimerTime_t past) {
+	return 0;
+}
+
+int main(int argc, char *argv[]) {
+	static ChannelParams_t channels[MAX_CHANNELS];
+	static uint8_t draws[256];
+	Band_t bands[NB_BANDS] = { { .TimeOff = 0 } };
+	volatile unsigned long sink;
+
+	// All channels on DR0-DR3, the datarate checked by ChanVerifyDr is only on the last one
+	for (int i = 0; i < MAX_CHANNELS; i++) {
+		channels[i].Frequency = 902300000 + i * 200000;
+		channels[i].DrRange.Value = (DR_3 << 4) | DR_0;
+	}
+	for (int i = 0; i < sizeof(draws); i++) draws[i] = (uint8_t)rand();
+
+	for (int p = 0; p < sizeof(Plans) / sizeof(Plans[0]); p++) {
+		const PLAN* plan = &Plans[p];
+		uint16_t mask[MASK_WORDS], enabled[MASK_WORDS];
+		uint8_t ids[MAX_CHANNELS], words = (plan->MaxNbChannels + 15) / 16, delayTx, last = 0;
+		unsigned long picked = 0, refPicked = 0, count = 0;
+		memcpy(mask, plan->Mask, sizeof(mask));
+		for (int i = 0; i < plan->MaxNbChannels; i++)
+			if (mask[i / 16] & (1 << (i % 16))) last = i;
+		channels[last].DrRange.Value = (DR_4 << 4) | DR_4;
+		RegionCommonCountNbOfEnabledChannelsParams_t params = {
+			.Joined = true, .Datarate = DR_0, .ChannelsMask = mask, .Channels = channels, .Bands = bands,
+			.NbBands = NB_BANDS, .MaxNbChannels = plan->MaxNbChannels, .JoinChannels = 0
+		};
+
+		// Channel selection of NextChannel
+		double start = Now();
+		for (unsigned long i = 0; i < BENCH_CALLS; i++) {
+			uint8_t n = RegionCommonCountNbOfEnabledChannels(&params, enabled, &delayTx);
+			picked += RegionCommonChanMaskNth(enabled, words, draws[i & 0xFF] % n);
+		}
+		double select = (Now() - start) * 1e9 / BENCH_CALLS;
+		start = Now();
+		for (unsigned long i = 0; i < BENCH_CALLS; i++) {
+			uint8_t n = RefCountNbOfEnabledChannels(&params, ids, &delayTx);
+			refPicked += ids[draws[i & 0xFF] % n];
+		}
+		double refSelect = (Now() - start) * 1e9 / BENCH_CALLS;
+		CHECK(picked == refPicked);
+
+		// Channels count of the whole mask
+		start = Now();
+		for (unsigned long i = 0; i < BENCH_CALLS; i++) {
+			mask[0] ^= i & 1;
+			count += RegionCommonCountChannels(mask, 0, words);
+		}
+		double countTime = (Now() - start) * 1e9 / BENCH_CALLS;
+		sink = count;
+		count = 0;
+		start = Now();
+		for (unsigned long i = 0; i < BENCH_CALLS; i++) {
+			mask[0] ^= i & 1;
+			count += RefCountChannels(mask, 0, words);
+		}
+		double refCount = (Now() - start) * 1e9 / BENCH_CALLS;
+		CHECK(count == sink);
+
+		// Datarate check, worst case as only the last channel supports it
+		unsigned long valid = 0, refValid = 0;
+		start = Now();
+		for (unsigned long i = 0; i < BENCH_CALLS; i++)
+			valid += RegionCommonChanVerifyDr(plan->MaxNbChannels, mask, DR_4, DR_0, DR_4, channels);
+		double verify = (Now() - start) * 1e9 / BENCH_CALLS;
+		start = Now();
+		for (unsigned long i = 0; i < BENCH_CALLS; i++)
+			refValid += RefChanVerifyDr(plan->MaxNbChannels, mask, DR_4, DR_0, DR_4, channels);
+		double refVerify = (Now() - start) * 1e9 / BENCH_CALLS;
+		CHECK((valid == BENCH_CALLS) && (refValid == BENCH_CALLS));
+		channels[last].DrRange.Value = (DR_3 << 4) | DR_0;
+
+		printf("%s: %-18s select %6.1f ns (bitwise %6.1f), count %5.1f ns (%5.1f), verify dr %6.1f ns (%6.1f)\n",
+				argv[0], plan->Name, select, refSelect, countTime, refCount, verify, refVerify);
+	}
+	return TEST_END();
+}
@@ -0,0 +1,65 @@
+/*******************************************************************
+**                                                                **
+** CRC16 benchmark                                                **
+**                                                                **
+*******************************************************************/
+/*
+ * Throughput of the CCITT CRC16 range computation of the build variant, against the previous
+ * bitwise implementation, on a USERDATA sized buffer and on a flash page. The instructions of
+ * both sizes are checked against their baselines.
+ */
+
+#include <stdlib.h>
+#include <time.h>
+#include "crc16.h"
+#include <stdio.h>
+#include "bench.h"
+
+/** @cond */
+#define BENCH_BYTES		200000000UL
+
+static unsigned char Buffer[2048];
+static volatile unsigned short Sink;
+/** @endcond */
+
+static unsigned short CRC16Reference(const unsigned char* buffer, unsigned int length, unsigned short crc) {
+	while (length--) {
+		crc ^= ((unsigned short)*buffer++) << 8;
+		for (int i = 0; i < 8; i++)
+			crc = (crc & 0x8000) ? (crc << 1) ^ CRC16_CCITT : crc << 1;
+	}
+	return crc;
+}
+
+static void Crc256(void) {
+	Sink = CRC16_CalculateRange(Buffer, 256, CRC16_CCITT_INIT);
+}
+
+static void Crc2048(void) {
+	Sink = CRC16_CalculateRange(Buffer, 2048, CRC16_CCITT_INIT);
+}
+
+int main(int argc, char *argv[]) {
+	static const unsigned int sizes[] = { 256, 2048 };
+
+	BENCH_Init(argc, argv);
+	for (int i = 0; i < sizeof(Buffer); i++) Buffer[i] = (unsigned char)rand();
+	BENCH_Run("CRC16_CalculateRange_256", Crc256);
+	BENCH_Run("CRC16_CalculateRange_2048", Crc2048);
+	if (BenchBaselineMode) return 0;
+	for (int s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+		unsigned long runs = BENCH_BYTES / sizes[s];
+		unsigned short crc = CRC16_CCITT_INIT;
+		double start = BenchNow();
+		for (unsigned long r = 0; r < runs; r++) crc = CRC16_CalculateRange(Buffer, sizes[s], crc);
+		double table = (BenchNow() - start) * 1e9 / BENCH_BYTES;
+		Sink = crc;
+		unsigned short ref = CRC16_CCITT_INIT;
+		start = BenchNow();
+		for (unsigned long r = 0; r < runs / 8; r++) ref = CRC16Reference(Buffer, sizes[s], ref);
+		double bitwise = (BenchNow() - start) * 8e9 / BENCH_BYTES;
+		Sink = ref;
+		printf("%s: %4u bytes, %.3f ns/byte, bitwise %.3f ns/byte (x%.1f)\n", argv[0], sizes[s], table, bitwise, bitwise / table);
+	}
+	return BENCH_END();
+}
@@ -0,0 +1,97 @@
+/*******************************************************************
+**                                                                **
+** LoRaMAC crypto benchmark                                       **
+**                                                                **
+*******************************************************************/
+/*
+ * Instructions and time of the software AES-128 primitives and of the LoRaMacCrypto.c
+ * functions run for every uplink (MIC and encryption of a 51 bytes frame, the largest at
+ * SF12) and every join (join accept MIC and decryption, session keys).
+ */
+
+#include <stdlib.h>
+#include "aes.h"
+#include "cmac.h"
+#include "LoRaMacCrypto.h"
+#include "bench.h"
+
+/** @cond */
+#define FRAME_SIZE		51
+#define ACCEPT_SIZE		33
+
+static uint8_t Key[16];
+static uint8_t Frame[FRAME_SIZE];
+static uint8_t Accept[ACCEPT_SIZE];
+static uint8_t Output[FRAME_SIZE];
+static uint8_t AppNonce[3];
+static aes_context AesContext;
+static volatile uint32_t Sink;
+/** @endcond */
+
+static void AesSetKey(void) {
+	aes_set_key(Key, 16, &AesContext);
+}
+
+static void AesEncrypt(void) {
+	aes_encrypt(Frame, Output, &AesContext);
+}
+
+static void Cmac(void) {
+	AES_CMAC_CTX ctx;
+	uint8_t digest[AES_CMAC_DIGEST_LENGTH];
+
+	AES_CMAC_Init(&ctx);
+	AES_CMAC_SetKey(&ctx, Key);
+	AES_CMAC_Update(&ctx, Frame, FRAME_SIZE);
+	AES_CMAC_Final(digest, &ctx);
+	Sink = digest[0];
+}
+
+static void ComputeMic(void) {
+	uint32_t mic;
+
+	LoRaMacComputeMic(Frame, FRAME_SIZE, Key, 0x01020304, 0, 1000, &mic);
+	Sink = mic;
+}
+
+static void PayloadEncrypt(void) {
+	LoRaMacPayloadEncrypt(Frame, FRAME_SIZE, Key, 0x01020304, 0, 1000, Output);
+}
+
+static void JoinComputeMic(void) {
+	uint32_t mic;
+
+	LoRaMacJoinComputeMic(Accept, ACCEPT_SIZE - 4, Key, &mic);
+	Sink = mic;
+}
+
+static void JoinDecrypt(void) {
+	LoRaMacJoinDecrypt(Accept + 1, ACCEPT_SIZE - 1, Key, Output + 1);
+}
+
+static void JoinComputeSKeys(void) {
+	uint8_t nwkSKey[16], appSKey[16];
+
+	LoRaMacJoinComputeSKeys(Key, AppNonce, 0x1234, nwkSKey, appSKey);
+	Sink = nwkSKey[0] ^ appSKey[0];
+}
+
+int main(int argc, char *argv[]) {
+	srand(38);
+	for (int i = 0; i < sizeof(Key); i++) Key[i] = (uint8_t)rand();
+	for (int i = 0; i < FRAME_SIZE; i++) Frame[i] = (uint8_t)rand();
+	for (int i = 0; i < ACCEPT_SIZE; i++) Accept[i] = (uint8_t)rand();
+	for (int i = 0; i < sizeof(AppNonce); i++) AppNonce[i] = (uint8_t)rand();
+	aes_set_key(Key, 16, &AesContext);
+
+	BENCH_Init(argc, argv);
+	BENCH_Run("aes_set_key", AesSetKey);
+	BENCH_Run("aes_encrypt", AesEncrypt);
+	BENCH_Run("AES_CMAC_51", Cmac);
+	BENCH_Run("LoRaMacComputeMic", ComputeMic);
+	BENCH_Run("LoRaMacPayloadEncrypt", PayloadEncrypt);
+	BENCH_Run("LoRaMacJoinComputeMic", JoinComputeMic);
+	BENCH_Run("LoRaMacJoinDecrypt", JoinDecrypt);
+	BENCH_Run("LoRaMacJoinComputeSKeys", JoinComputeSKeys);
+	return BENCH_END();
+}
@@ -0,0 +1,67 @@
+/*******************************************************************
+**                                                                **
+** DateTime conversions benchmark                                 **
+**                                                                **
+*******************************************************************/
+/*
+ * Instructions and time of the DateTime conversions run by the time stamping of the
+ * measures, the shell and the FAT file times, on a summer date of the European locale.
+ */
+
+#include "datetime.h"
+#include "bench.h"
+
+/** @cond */
+#define SECONDS		1561975200UL			// 2019-07-01T10:00:00
+
+static DATETIME_STRUCT Date;
+static unsigned char Text[32];
+static volatile unsigned long Sink;
+/** @endcond */
+
+static void FromSeconds(void) {
+	DATETIME_STRUCT dt;
+
+	DateTimeFromSeconds(SECONDS, &dt);
+	Sink = dt.day;
+}
+
+static void GetSeconds(void) {
+	Sink = DateTimeGetSeconds(&Date);
+}
+
+static void ToISO8601(void) {
+	unsigned char buffer[32];
+
+	Sink = DateTimeToISO8601Format(&Date, buffer);
+}
+
+static void FromISO8601(void) {
+	Sink = DateTimeSecondsFromISO8601String(Text);
+}
+
+static void ToFatTime(void) {
+	Sink = DateTimeSecondsToFatTime(SECONDS);
+}
+
+static void LocaleFromSeconds(void) {
+	DATETIME_STRUCT dt;
+
+	DateTimeLocaleFromSeconds(SECONDS, &dt);
+	Sink = dt.hour;
+}
+
+int main(int argc, char *argv[]) {
+	DateTimeSetLocale(EUROPEAN_DST);
+	DateTimeFromSeconds(SECONDS, &Date);
+	DateTimeToISO8601Format(&Date, Text);
+
+	BENCH_Init(argc, argv);
+	BENCH_Run("DateTimeFromSeconds", FromSeconds);
+	BENCH_Run("DateTimeGetSeconds", GetSeconds);
+	BENCH_Run("DateTimeToISO8601Format", ToISO8601);
+	BENCH_Run("DateTimeSecondsFromISO8601", FromISO8601);
+	BENCH_Run("DateTimeSecondsToFatTime", ToFatTime);
+	BENCH_Run("DateTimeLocaleFromSeconds", LocaleFromSeconds);
+	return BENCH_END();
+}
@@ -0,0 +1,96 @@
+/*******************************************************************
+**                                                                **
+** MAC command codec benchmark                                    **
+**                                                                **
+*******************************************************************/
+/*
+ * Measures ProcessMacCommands on mixed downlink command streams, from a FOpts field to a
+ * full port 0 payload, including the KR920 region handlers and the answers queued by
+ * AddMacCommand. LoRaMac.c is included to reach them, as in test_mac_commands.c.
+ */
+
+#include <time.h>
+#include "../LoRaMac-node-development/src/mac/LoRaMac.c"
+#include "test.h"
+
+/** @cond */
+#define BENCH_COMMANDS		20000000UL
+
+typedef struct {
+	const char*		Name;
+	uint8_t			Commands;
+	uint8_t			Answers;			// Answer bytes queued
+	uint8_t			Size;
+	uint8_t			Stream[64];
+} STREAM;
+
+// Frequencies in 100 Hz, little endian: 922.1 MHz is 0x8CB4E4
+static const STREAM Streams[] = {
+	{ "LinkADRReq", 1, 2, 5, { 0x03, 0x51, 0x07, 0x00, 0x01 } },
+	{ "DevStatusReq x 15", 15, 45, 15, { 0x06, 0x06, 0x06, 0x06, 0x06, 0x06, 0x06, 0x06, 0x06, 0x06, 0x06, 0x06, 0x06, 0x06, 0x06 } },
+	{ "FOpts mix", 4, 7, 10, { 0x03, 0x51, 0x07, 0x00, 0x01, 0x04, 0x02, 0x06, 0x08, 0x01 } },
+	{ "LinkADRReq block x 3", 3, 6, 15, { 0x03, 0x51, 0x07, 0x00, 0x01, 0x03, 0x51, 0x07, 0x00, 0x01,
+			0x03, 0x51, 0x07, 0x00, 0x01 } },
+	{ "port 0 mix", 11, 17, 47, {
+			0x03, 0x51, 0x07, 0x00, 0x01, 0x03, 0x51, 0x07, 0x00, 0x01,		// LinkADRReq block
+			0x07, 0x03, 0xE4, 0xB4, 0x8C, 0x50,								// NewChannelReq
+			0x07, 0x04, 0xA4, 0xBC, 0x8C, 0x50,
+			0x0A, 0x03, 0xE4, 0xB4, 0x8C,									// DlChannelReq
+			0x05, 0x00, 0xE4, 0xB4, 0x8C,									// RXParamSetupReq
+			0x08, 0x01,														// RXTimingSetupReq
+			0x04, 0x00,														// DutyCycleReq
+			0x06,															// DevStatusReq
+			0x02, 0x14, 0x02,												// LinkCheckAns
+			0x0D, 0x00, 0x10, 0x5E, 0x4F, 0x00, 0x80 } },					// DeviceTimeAns
+};
+/** @endcond */
+
+static double Now(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void OnMcpsConfirm( McpsConfirm_t *mcpsConfirm ) { }
+static void OnMcpsIndication( McpsIndication_t *mcpsIndication ) { }
+static void OnMlmeConfirm( MlmeConfirm_t *mlmeConfirm ) { }
+
+int main(int argc, char *argv[]) {
+	static LoRaMacPrimitives_t primitives = { OnMcpsConfirm, OnMcpsIndication, OnMlmeConfirm };
+	static LoRaMacCallback_t callbacks = { 0 };
+	static uint8_t payload[64];
+	CHECK(LoRaMacInitialization(&primitives, &callbacks, LORAMAC_REGION_KR920) == LORAMAC_STATUS_OK);
+
+	for (unsigned int s = 0; s < sizeof(Streams) / sizeof(Streams[0]); s++) {
+		const STREAM* stream = &Streams[s];
+		unsigned long runs = BENCH_COMMANDS / 10 / stream->Commands;
+		unsigned long answers = 0;
+		double start = Now();
+		for (unsigned long i = 0; i < runs; i++) {
+			// Copy from the radio buffer, as the MAC does
+			memcpy(payload, stream->Stream, stream->Size);
+			MacCommandsBufferIndex = 0;
+			MacCommandsBufferToRepeatIndex = 0;
+			ProcessMacCommands(payload, 0, stream->Size, 10);
+			answers += MacCommandsBufferIndex + MacCommandsBufferToRepeatIndex;
+		}
+		double elapsed = Now() - start;
+		CHECK(answers == runs * stream->Answers);
+		printf("%s: %-20s %3u bytes, %7.1f ns per stream, %5.1f ns per command, %6.1f MB/s\n", argv[0],
+				stream->Name, stream->Size, elapsed * 1e9 / runs, elapsed * 1e9 / runs / stream->Commands,
+				runs * stream->Size / elapsed / 1e6);
+	}
+
+	// Answer builder alone
+	unsigned long runs = BENCH_COMMANDS / 40;
+	double start = Now();
+	for (unsigned long i = 0; i < runs; i++) {
+		MacCommandsBufferIndex = 0;
+		MacCommandsBufferToRepeatIndex = 0;
+		for (int a = 0; a < 40; a++) AddMacCommand((a & 1) ? MOTE_MAC_LINK_ADR_ANS : MOTE_MAC_RX_TIMING_SETUP_ANS, 7, 0);
+	}
+	double elapsed = Now() - start;
+	CHECK(MacCommandsBufferIndex + MacCommandsBufferToRepeatIndex == 60);
+	printf("%s: %-20s %.1f ns per answer\n", argv[0], "AddMacCommand", elapsed * 1e9 / (runs * 40));
+	return TEST_END();
+}
@@ -0,0 +1,70 @@
+/*******************************************************************
+**                                                                **
+** KR920 region benchmark                                         **
+**                                                                **
+*******************************************************************/
+/*
+ * Instructions and time of the region functions run for every uplink: the channel selection
+ * with the band time offs and listen before talk (RegionNextChannel), the ADR backoff
+ * (RegionAdrNext, at its datarate step down) and the LinkADRReq handling, alone and as a
+ * block of 3 commands.
+ */
+
+#include "LoRaMac.h"
+#include "Region.h"
+#include "bench.h"
+
+/** @cond */
+// DR_5, TX power 1, channels 0 to 2, NbRep 1
+static uint8_t LinkAdrReq[] = { 0x03, 0x51, 0x07, 0x00, 0x01 };
+static uint8_t LinkAdrReqBlock[] = { 0x03, 0x51, 0x07, 0x00, 0x01, 0x03, 0x51, 0x07, 0x00, 0x01,
+		0x03, 0x51, 0x07, 0x00, 0x01 };
+static volatile uint32_t Sink;
+/** @endcond */
+
+static void NextChannel(void) {
+	NextChanParams_t params = { .AggrTimeOff = 0, .LastAggrTx = 0, .Datarate = DR_2, .Joined = true,
+			.DutyCycleEnabled = true };
+	TimerTime_t time, aggregatedTimeOff;
+	uint8_t channel = 0;
+
+	Sink = RegionNextChannel(LORAMAC_REGION_KR920, &params, &channel, &time, &aggregatedTimeOff) + channel;
+}
+
+static void AdrNext(void) {
+	AdrNextParams_t params = { .UpdateChanMask = true, .AdrEnabled = true, .AdrAckCounter = 64 + 32 + 1,
+			.Datarate = DR_5, .TxPower = 0, .UplinkDwellTime = 0 };
+	int8_t datarate, txPower;
+	uint32_t adrAckCounter;
+
+	Sink = RegionAdrNext(LORAMAC_REGION_KR920, &params, &datarate, &txPower, &adrAckCounter) + datarate;
+}
+
+static void LinkAdr(uint8_t* payload, uint8_t size) {
+	LinkAdrReqParams_t params = { .Payload = payload, .PayloadSize = size, .UplinkDwellTime = 0,
+			.AdrEnabled = true, .CurrentDatarate = DR_2, .CurrentTxPower = 0, .CurrentNbRep = 1 };
+	int8_t datarate, txPower;
+	uint8_t nbRep, parsed;
+
+	Sink = RegionLinkAdrReq(LORAMAC_REGION_KR920, &params, &datarate, &txPower, &nbRep, &parsed);
+}
+
+static void LinkAdrReqOne(void) {
+	LinkAdr(LinkAdrReq, sizeof(LinkAdrReq));
+}
+
+static void LinkAdrReqThree(void) {
+	LinkAdr(LinkAdrReqBlock, sizeof(LinkAdrReqBlock));
+}
+
+int main(int argc, char *argv[]) {
+	srand1(38);
+	RegionInitDefaults(LORAMAC_REGION_KR920, INIT_TYPE_INIT);
+
+	BENCH_Init(argc, argv);
+	BENCH_Run("RegionNextChannel", NextChannel);
+	BENCH_Run("RegionAdrNext", AdrNext);
+	BENCH_Run("RegionLinkAdrReq", LinkAdrReqOne);
+	BENCH_Run("RegionLinkAdrReq_3", LinkAdrReqThree);
+	return BENCH_END();
+}
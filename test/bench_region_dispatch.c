@@ -0,0 +1,125 @@
+/*******************************************************************
+**                                                                **
+** Region dispatch benchmark                                      **
+**                                                                **
+*******************************************************************/
+/*
+ * Measures the cost of a Region* call for the switch dispatch (Region.c) and the table
+ * dispatch (RegionOps.c, REGION_DISPATCH_TABLE), with several regions or a single one.
+ * The region functions are empty stand-ins so that only the dispatch is measured.
+ * Table builds also check that calls fail until a region is selected and when the region
+ * parameter is not the selected one.
+ *
+ * The sizes below are x86-64 object sizes (gcc 12 -Os) of the dispatch alone, not ARM flash
+ * sizes, and the tables are data on the host but rodata on the target. They only compare
+ * the two dispatches:
+ *   5 regions, switch (Region.c)      text 2635
+ *   5 regions, table (RegionOps.c)    text 1435, tables 944
+ *   KR920 only, switch                text  969
+ *   KR920 only, table                 text  988, tables 176
+ * The table saves code with several regions (Release configuration) and costs some with
+ * KR920 alone, so the Debug configuration keeps the switch. The call cost is within the
+ * run to run noise on the host.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include "timer.h"
+#include "LoRaMac.h"
+#include "Region.h"
+#include "test.h"
+
+/** @cond */
+#define BENCH_CALLS		50000000UL
+
+static volatile unsigned long Calls = 0;
+
+#define REGION_STUBS( name ) \
+PhyParam_t Region##name##GetPhyParam( GetPhyParams_t* getPhy ) { PhyParam_t p = { .Value = getPhy->Attribute }; Calls++; return p; } \
+void Region##name##SetBandTxDone( SetBandTxDoneParams_t* txDone ) { Calls++; } \
+void Region##name##InitDefaults( InitType_t type ) { Calls++; } \
+bool Region##name##Verify( VerifyParams_t* verify, PhyAttribute_t phyAttribute ) { Calls++; return true; } \
+void Region##name##ApplyCFList( ApplyCFListParams_t* applyCFList ) { Calls++; } \
+bool Region##name##ChanMaskSet( ChanMaskSetParams_t* chanMaskSet ) { Calls++; return true; } \
+bool Region##name##AdrNext( AdrNextParams_t* adrNext, int8_t* drOut, int8_t* txPowOut, uint32_t* adrAckCounter ) { Calls++; return true; } \
+void Region##name##ComputeRxWindowParameters( int8_t datarate, uint8_t minRxSymbols, uint32_t rxError, RxConfigParams_t *rxConfigParams ) { Calls++; } \
+bool Region##name##RxConfig( RxConfigParams_t* rxConfig, int8_t* datarate ) { Calls++; return true; } \
+bool Region##name##TxConfig( TxConfigParams_t* txConfig, int8_t* txPower, TimerTime_t* txTimeOnAir ) { Calls++; return true; } \
+uint8_t Region##name##LinkAdrReq( LinkAdrReqParams_t* linkAdrReq, int8_t* drOut, int8_t* txPowOut, uint8_t* nbRepOut, uint8_t* nbBytesParsed ) { Calls++; return 7; } \
+uint8_t Region##name##RxParamSetupReq( RxParamSetupReqParams_t* rxParamSetupReq ) { Calls++; return 7; } \
+uint8_t Region##name##NewChannelReq( NewChannelReqParams_t* newChannelReq ) { Calls++; return 3; } \
+int8_t Region##name##TxParamSetupReq( TxParamSetupReqParams_t* txParamSetupReq ) { Calls++; return 0; } \
+uint8_t Region##name##DlChannelReq( DlChannelReqParams_t* dlChannelReq ) { Calls++; return 3; } \
+int8_t Region##name##AlternateDr( AlternateDrParams_t* alternateDr ) { Calls++; return 1; } \
+void Region##name##CalcBackOff( CalcBackOffParams_t* calcBackOff ) { Calls++; } \
+bool Region##name##NextChannel( NextChanParams_t* nextChanParams, uint8_t* channel, TimerTime_t* time, TimerTime_t* aggregatedTimeOff ) { Calls++; return true; } \
+LoRaMacStatus_t Region##name##ChannelAdd( ChannelAddParams_t* channelAdd ) { Calls++; return LORAMAC_STATUS_OK; } \
+bool Region##name##ChannelsRemove( ChannelRemoveParams_t* channelRemove  ) { Calls++; return true; } \
+void Region##name##SetContinuousWave( ContinuousWaveParams_t* continuousWave ) { Calls++; } \
+uint8_t Region##name##ApplyDrOffset( uint8_t downlinkDwellTime, int8_t dr, int8_t drOffset ) { Calls++; return dr - drOffset; }
+
+#ifdef REGION_AS923
+#include "RegionAS923.h"
+REGION_STUBS( AS923 )
+#endif
+#ifdef REGION_AU915
+#include "RegionAU915.h"
+REGION_STUBS( AU915 )
+#endif
+#ifdef REGION_EU868
+#include "RegionEU868.h"
+REGION_STUBS( EU868 )
+#endif
+#ifdef REGION_KR920
+#include "RegionKR920.h"
+REGION_STUBS( KR920 )
+#endif
+#ifdef REGION_US915
+#include "RegionUS915.h"
+REGION_STUBS( US915 )
+#endif
+/** @endcond */
+
+static double Now(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+int main(int argc, char *argv[]) {
+	volatile LoRaMacRegion_t region = LORAMAC_REGION_KR920;
+	unsigned long sum = 0;
+
+#ifdef REGION_DISPATCH_TABLE
+	GetPhyParams_t getPhy = { .Attribute = PHY_MAX_PAYLOAD };
+
+	// Multi-region builds fail calls cleanly until a region is selected; a single region is known at build time
+#ifdef REGION_EU868
+	CHECK(RegionApplyDrOffset(region, 0, 5, 2) == 5);
+	CHECK(RegionGetPhyParam(region, &getPhy).Value == 0);
+	CHECK(RegionChannelAdd(region, NULL) == LORAMAC_STATUS_PARAMETER_INVALID);
+	CHECK(Calls == 0);
+#endif
+	CHECK(RegionSelect(LORAMAC_REGION_CN779) == false);
+	CHECK(RegionSelect(LORAMAC_REGION_KR920) == true);
+	CHECK(RegionApplyDrOffset(region, 0, 5, 2) == 3);
+	CHECK(RegionGetPhyParam(region, &getPhy).Value == PHY_MAX_PAYLOAD);
+	// A region other than the selected one fails as an inactive region
+	Calls = 0;
+	CHECK(RegionApplyDrOffset(LORAMAC_REGION_EU868, 0, 5, 2) == 5);
+	CHECK(RegionVerify(LORAMAC_REGION_EU868, NULL, PHY_TX_DR) == false);
+	CHECK(Calls == 0);
+#else
+	CHECK(RegionSelect(LORAMAC_REGION_KR920) == true);
+#endif
+
+	double start = Now();
+	for (unsigned long i = 0; i < BENCH_CALLS; i++)
+		sum += RegionApplyDrOffset(region, 0, 5, 2);
+	double elapsed = Now() - start;
+	CHECK(sum == BENCH_CALLS * 3);
+	printf("%s: %.2f ns per Region* call\n", argv[0], elapsed * 1e9 / BENCH_CALLS);
+	return TEST_END();
+}
@@ -0,0 +1,41 @@
+/*******************************************************************
+**                                                                **
+** Shell command line tokenizer benchmark                         **
+**                                                                **
+*******************************************************************/
+/*
+ * Instructions and time of SHELL_ParseLine on a short command, on an AppKey setting and on a
+ * line of more arguments than the shell takes. The line is copied before each parse, as the
+ * tokenizer splits it in place.
+ */
+
+#include "shell_parse.h"
+#include "bench.h"
+
+/** @cond */
+#define MAX_ARGS	16						// As the shell
+
+static const char* Line;
+static volatile int Sink;
+/** @endcond */
+
+static void Parse(void) {
+	char line[128];
+	char* argv[MAX_ARGS];
+	int i = 0;
+
+	// Not strcpy, whose instructions depend on the host processor
+	do line[i] = Line[i]; while (Line[i++] != '\0');
+	Sink = SHELL_ParseLine(line, argv, MAX_ARGS);
+}
+
+int main(int argc, char *argv[]) {
+	BENCH_Init(argc, argv);
+	Line = "AT+DR 5";
+	BENCH_Run("SHELL_ParseLine_short", Parse);
+	Line = "AT+AK 2B7E151628AED2A6ABF7158809CF4F3C";
+	BENCH_Run("SHELL_ParseLine_key", Parse);
+	Line = "AT+SCFG a b c d e f g h i j k l m n o p q r s t u v w x y z";
+	BENCH_Run("SHELL_ParseLine_max_args", Parse);
+	return BENCH_END();
+}
@@ -0,0 +1,34 @@
+/*******************************************************************
+**                                                                **
+** SKT application payload builders benchmark                     **
+**                                                                **
+*******************************************************************/
+/*
+ * Instructions and time of the periodic data message built for every uplink of the SKT
+ * application, with one and with two pulse inputs, on the counter and values of a device
+ * up for a long time.
+ */
+
+#include "system.h"
+#include "skt_payload.h"
+#include "bench.h"
+
+/** @cond */
+static uint8_t Buffer[255];				// As LocalBuffer
+static const unsigned long Values[2] = { 1234567UL, 89012UL };
+static int Count;
+static volatile uint32_t Sink;
+/** @endcond */
+
+static void Periodic(void) {
+	Sink = SKTPAYLOAD_SetPeriodic((LORA_MESSAGE*)Buffer, sizeof(Buffer), 1, 52560, Values, Count);
+}
+
+int main(int argc, char *argv[]) {
+	BENCH_Init(argc, argv);
+	Count = 1;
+	BENCH_Run("SKTPAYLOAD_SetPeriodic_1", Periodic);
+	Count = 2;
+	BENCH_Run("SKTPAYLOAD_SetPeriodic_2", Periodic);
+	return BENCH_END();
+}
@@ -0,0 +1,85 @@
+/*******************************************************************
+**                                                                **
+** SX1276 time on air benchmark                                   **
+**                                                                **
+*******************************************************************/
+/*
+ * Instructions and time of SX1276GetTimeOnAir, called by the LoRaMAC for every uplink (duty
+ * cycle and dwell time) and by the receive windows computation. The LoRa configurations are
+ * the KR920 ones set by SX1276SetTxConfig: SF7 and SF12 (low datarate optimisation), on an
+ * empty frame and on the largest frame of each.
+ */
+
+#include <stdlib.h>
+#include "board.h"
+#include "bench.h"
+
+/** @cond */
+static uint8_t EmuRegs[0x80];			// Flat register file, the driver only writes the configuration
+static bool EmuSelected;
+static int EmuByte;
+static uint8_t EmuAddr;
+static bool EmuWrite;
+static uint8_t Size;
+static volatile uint32_t Sink;
+/** @endcond */
+
+static void TimeOnAir(void) {
+	Sink = SX1276GetTimeOnAir(MODEM_LORA, Size);
+}
+
+static void Configure(uint8_t sf, uint8_t size) {
+	SX1276SetModem(MODEM_LORA);
+	SX1276SetTxConfig(MODEM_LORA, 14, 0, 0, sf, 1, 8, false, true, 0, 0, false, 5000);
+	Size = size;
+}
+
+/*******************************************************************
+** Emulated seams                                                 **
+*******************************************************************/
+void EmuPin(Gpio_t* pin, int level) {
+	if (pin != &SX1276.Spi.Nss) return;
+	if ((level == 0) && !EmuSelected) EmuByte = 0;
+	EmuSelected = (level == 0);
+}
+
+uint8_t EmuSpi(uint8_t out) {
+	uint8_t in = 0;
+
+	if (EmuByte++ == 0) {
+		EmuAddr = out & 0x7F;
+		EmuWrite = (out & 0x80) != 0;
+		return 0;
+	}
+	if (EmuWrite) EmuRegs[EmuAddr] = out;
+	else in = EmuRegs[EmuAddr];
+	if (EmuAddr != REG_FIFO) EmuAddr++;
+	return in;
+}
+
+void memcpy1(uint8_t *dst, const uint8_t *src, uint16_t size) { memcpy(dst, src, size); }
+void TimerInit(TimerEvent_t *obj, void (*callback)(void)) { }
+void TimerStart(TimerEvent_t *obj) { }
+void TimerStop(TimerEvent_t *obj) { }
+void TimerSetValue(TimerEvent_t *obj, uint32_t value) { }
+TimerTime_t TimerGetCurrentTime(void) { return 0; }
+TimerTime_t TimerGetElapsedTime(TimerTime_t savedTime) { return 0; }
+void SX1276IoIrqInit(DioIrqHandler **irqHandlers) { }
+void SX1276SetAntSwLowPower(bool status) { }
+void SX1276SetAntSw(uint8_t opMode) { }
+bool SX1276CheckRfFrequency(uint32_t frequency) { return true; }
+uint8_t SX1276GetPaSelect(uint32_t channel) { return RF_PACONFIG_PASELECT_PABOOST; }
+void SX1276SetRfTxPower(int8_t power) { }
+
+int main(int argc, char *argv[]) {
+	BENCH_Init(argc, argv);
+	Configure(7, 0);
+	BENCH_Run("SX1276GetTimeOnAir_SF7_0", TimeOnAir);
+	Configure(7, 242);
+	BENCH_Run("SX1276GetTimeOnAir_SF7_242", TimeOnAir);
+	Configure(12, 0);
+	BENCH_Run("SX1276GetTimeOnAir_SF12_0", TimeOnAir);
+	Configure(12, 51);
+	BENCH_Run("SX1276GetTimeOnAir_SF12_51", TimeOnAir);
+	return BENCH_END();
+}
@@ -0,0 +1,70 @@
+/*******************************************************************
+**                                                                **
+** Timer list benchmark                                           **
+**                                                                **
+*******************************************************************/
+/*
+ * Instructions and time of the timer.c list handling, with the timers the application keeps
+ * running (MAC, LED pattern, supervisor...): a timer started at the head, in the middle and
+ * at the tail of a list of 8, then stopped again.
+ */
+
+#include "board.h"
+#include "rtc-board.h"
+#include "bench.h"
+
+/** @cond */
+#define TIMERS		8
+
+static TimerEvent_t Timers[TIMERS];
+static TimerEvent_t Timer;
+static TimerTime_t Now;
+/** @endcond */
+
+static void OnTimer(void) {
+}
+
+static void StartStop(uint32_t value) {
+	TimerSetValue(&Timer, value);
+	TimerStart(&Timer);
+	TimerStop(&Timer);
+}
+
+static void StartStopHead(void) {
+	StartStop(50);
+}
+
+static void StartStopMiddle(void) {
+	StartStop(TIMERS * 1000 / 2 + 500);
+}
+
+static void StartStopTail(void) {
+	StartStop(TIMERS * 1000 + 500);
+}
+
+/*******************************************************************
+** Emulated seams                                                 **
+*******************************************************************/
+TimerTime_t RtcGetElapsedAlarmTime(void) { return 10; }
+TimerTime_t RtcGetTimerValue(void) { return Now; }
+uint32_t RtcGetTimerValueUs(void) { return Now * 1000; }
+TimerTime_t RtcComputeElapsedTime(TimerTime_t eventInTime) { return Now - eventInTime; }
+TimerTime_t RtcComputeFutureEventTime(TimerTime_t futureEventInTime) { return Now + futureEventInTime; }
+TimerTime_t RtcGetAdjustedTimeoutValue(uint32_t timeout) { return timeout; }
+void RtcSetTimeout(uint32_t timeout) { }
+void RtcEnterLowPowerStopMode(void) { }
+
+int main(int argc, char *argv[]) {
+	for (int i = 0; i < TIMERS; i++) {
+		TimerInit(&Timers[i], OnTimer);
+		TimerSetValue(&Timers[i], (i + 1) * 1000);
+		TimerStart(&Timers[i]);
+	}
+	TimerInit(&Timer, OnTimer);
+
+	BENCH_Init(argc, argv);
+	BENCH_Run("TimerStartStop_head", StartStopHead);
+	BENCH_Run("TimerStartStop_middle", StartStopMiddle);
+	BENCH_Run("TimerStartStop_tail", StartStopTail);
+	return BENCH_END();
+}
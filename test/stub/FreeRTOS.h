@@ -0,0 +1,55 @@
+/*
+ * Host replacement of the FreeRTOS kernel API used by EFM32_MMI/inc/device_event.h and MCU/src/EFMEnergy.c
+ * (single threaded: critical sections are no-ops, semaphores are counters)
+ */
+#ifndef INC_FREERTOS_H
+#define INC_FREERTOS_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+
+#define pdFALSE			0
+#define pdTRUE			1
+#define configASSERT(x)	do { if (!(x)) abort(); } while (0)
+#define portBASE_TYPE	long
+#define PRIVILEGED_DATA
+
+typedef uint32_t		portTickType;
+typedef uint32_t		TickType_t;
+typedef long			BaseType_t;
+typedef unsigned long	UBaseType_t;
+typedef struct {
+	unsigned long	Count;
+} StaticSemaphore_t;
+typedef StaticSemaphore_t* SemaphoreHandle_t;
+typedef struct {
+	TickType_t		Entered;
+} TimeOut_t;
+
+static inline void taskENTER_CRITICAL(void) { }
+static inline void taskEXIT_CRITICAL(void) { }
+static inline UBaseType_t portSET_INTERRUPT_MASK_FROM_ISR(void) { return 0; }
+static inline void portCLEAR_INTERRUPT_MASK_FROM_ISR(UBaseType_t mask) { }
+#define portEND_SWITCHING_ISR(x)	((void)(x))
+
+static inline SemaphoreHandle_t xSemaphoreCreateBinaryStatic(StaticSemaphore_t* buffer) {
+	buffer->Count = 0;
+	return buffer;
+}
+static inline BaseType_t xSemaphoreGive(SemaphoreHandle_t semaphore) {
+	if (semaphore->Count) return pdFALSE;
+	semaphore->Count = 1;
+	return pdTRUE;
+}
+static inline BaseType_t xSemaphoreGiveFromISR(SemaphoreHandle_t semaphore, BaseType_t* woken) {
+	*woken = pdTRUE;
+	return xSemaphoreGive(semaphore);
+}
+
+// Provided by the test
+BaseType_t xSemaphoreTake(SemaphoreHandle_t semaphore, TickType_t ticks);
+void vTaskSetTimeOutState(TimeOut_t* timeout);
+BaseType_t xTaskCheckForTimeOut(TimeOut_t* timeout, TickType_t* ticks);
+
+#endif
@@ -0,0 +1,53 @@
+/*
+ * Host replacement of inc/global.h and inc/trace.h for src/crash.c
+ * (forced with -include, the real headers are skipped by their include guards)
+ */
+#ifndef __GLOBAL_H__
+#define __GLOBAL_H__
+#define INC_TRACE_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <system.h>
+#include "timer.h"
+
+#define	TRACE(level, format, ...)
+#define	INFO(format, ...)
+#define	ERROR(format, ...)
+
+#define configTICK_RATE_HZ			1000
+#define pdFALSE						0
+#define taskSCHEDULER_NOT_STARTED	1
+#define taskSCHEDULER_RUNNING		2
+
+typedef void* TaskHandle_t;
+typedef struct {
+	uint32_t	Dummy[24];			// Same size as on the target
+} StaticTask_t;
+typedef enum { eRunning = 0, eReady, eBlocked, eSuspended, eDeleted, eInvalid } eTaskState;
+typedef struct {
+	TaskHandle_t	xHandle;
+	const char*		pcTaskName;
+	unsigned long	xTaskNumber;
+	eTaskState		eCurrentState;
+	unsigned long	uxCurrentPriority;
+	unsigned long	uxBasePriority;
+	uint32_t		ulRunTimeCounter;
+	uint32_t*		pxStackBase;
+	uint16_t		usStackHighWaterMark;
+} TaskStatus_t;
+
+// Provided by the test
+long xTaskGetSchedulerState(void);
+TaskHandle_t xTaskGetCurrentTaskHandle(void);
+void vTaskGetInfo(TaskHandle_t xTask, TaskStatus_t* pxTaskStatus, long xGetFreeStackSpace, eTaskState eState);
+unsigned long uxTaskGetStackHighWaterMark(TaskHandle_t xTask);
+uint32_t xTaskGetTickCount(void);
+char* pcTaskGetName(TaskHandle_t xTask);
+void vTaskSuspendAll(void);
+long xTaskResumeAll(void);
+uint32_t TRACE_GetHistory(char* pBuffer, uint32_t ulSize);
+static inline void taskDISABLE_INTERRUPTS(void) { }
+
+#endif
@@ -0,0 +1,7 @@
+/*
+ * Host replacement of the emlib CHIP header included by MCU/src/EFMEnergy.c
+ */
+#ifndef EM_CHIP_H
+#define EM_CHIP_H
+
+#endif
@@ -0,0 +1,43 @@
+/*
+ * Host replacement of the emlib CMU API used by LoRaWAN/crypto-board.c, MCU/src/mmi_timer.c,
+ * MCU/src/timebase.c and MCU/src/EFMEnergy.c
+ */
+#ifndef EM_CMU_H
+#define EM_CMU_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+typedef struct {
+	uint32_t HFBUSCLKEN0;
+	uint32_t STATUS;
+} CMU_TypeDef;
+
+typedef enum {
+	cmuClock_CRYPTO,
+	cmuClock_PRS,
+	cmuClock_TIMER0,
+	cmuClock_HFLE,
+	cmuClock_LFE,
+	cmuClock_RTCC,
+	cmuClock_CRYOTIMER
+} CMU_Clock_TypeDef;
+
+typedef enum {
+	cmuSelect_LFXO,
+	cmuSelect_LFRCO
+} CMU_Select_TypeDef;
+
+#define CMU_HFBUSCLKEN0_CRYPTO	(0x1UL << 0)
+#define CMU_STATUS_LFRCORDY		(0x1UL << 1)
+#define CMU_STATUS_LFXOENS		(0x1UL << 16)
+#define CMU_STATUS_LFXORDY		(0x1UL << 17)
+
+// Provided by the test
+extern CMU_TypeDef EmuCmu;
+#define CMU		(&EmuCmu)
+void CMU_ClockEnable(CMU_Clock_TypeDef clock, bool enable);
+uint32_t CMU_ClockFreqGet(CMU_Clock_TypeDef clock);
+void CMU_ClockSelectSet(CMU_Clock_TypeDef clock, CMU_Select_TypeDef ref);
+
+#endif
@@ -0,0 +1,59 @@
+/*
+ * Host replacement of the emlib CRYOTIMER API used by MCU/src/EFMEnergy.c
+ */
+#ifndef EM_CRYOTIMER_H
+#define EM_CRYOTIMER_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "em_device.h"
+
+#define CRYOTIMER_CMD_CLEAR			(0x1UL << 0)
+#define CRYOTIMER_IF_PERIOD			(0x1UL << 0)
+#define CRYOTIMER_IFC_PERIOD		CRYOTIMER_IF_PERIOD
+#define CRYOTIMER_IEN_PERIOD		CRYOTIMER_IF_PERIOD
+#define _CRYOTIMER_IFC_MASK			0x00000001UL
+
+typedef struct {
+	uint32_t	CMD;
+} CRYOTIMER_TypeDef;
+
+typedef enum {
+	cryotimerOscLFRCO,
+	cryotimerOscLFXO,
+	cryotimerOscULFRCO
+} CRYOTIMER_Osc_TypeDef;
+
+typedef enum {
+	cryotimerPresc_1
+} CRYOTIMER_Presc_TypeDef;
+
+typedef enum {
+	cryotimerPeriod_1 = 0,
+	cryotimerPeriod_4096m = 32
+} CRYOTIMER_Period_TypeDef;
+
+typedef struct {
+	bool					enable;
+	bool					debugRun;
+	bool					em4Wakeup;
+	CRYOTIMER_Osc_TypeDef	osc;
+	CRYOTIMER_Presc_TypeDef	presc;
+	CRYOTIMER_Period_TypeDef	period;
+} CRYOTIMER_Init_TypeDef;
+
+#define CRYOTIMER_INIT_DEFAULT	{ true, false, false, cryotimerOscULFRCO, cryotimerPresc_1, cryotimerPeriod_4096m }
+
+// Provided by the test
+extern CRYOTIMER_TypeDef EmuCryotimer;
+#define CRYOTIMER	(&EmuCryotimer)
+void CRYOTIMER_Init(const CRYOTIMER_Init_TypeDef* init);
+void CRYOTIMER_Enable(bool enable);
+uint32_t CRYOTIMER_CounterGet(void);
+void CRYOTIMER_PeriodSet(uint32_t period);
+uint32_t CRYOTIMER_IntGet(void);
+void CRYOTIMER_IntClear(uint32_t flags);
+void CRYOTIMER_IntEnable(uint32_t flags);
+void CRYOTIMER_IntDisable(uint32_t flags);
+
+#endif
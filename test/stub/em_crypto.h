@@ -0,0 +1,26 @@
+/*
+ * Host replacement of the emlib CRYPTO API used by LoRaWAN/crypto-board.c
+ */
+#ifndef EM_CRYPTO_H
+#define EM_CRYPTO_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+typedef struct {
+	int Unused;
+} CRYPTO_TypeDef;
+
+typedef void (*CRYPTO_AES_CtrFuncPtr_TypeDef)(uint8_t * ctr);
+
+// Provided by the test
+extern CRYPTO_TypeDef EmuCrypto;
+#define CRYPTO	(&EmuCrypto)
+void CRYPTO_AES_ECB128(CRYPTO_TypeDef *crypto, uint8_t *out, const uint8_t *in, unsigned int len,
+		const uint8_t *key, bool encrypt);
+void CRYPTO_AES_CBC128(CRYPTO_TypeDef *crypto, uint8_t *out, const uint8_t *in, unsigned int len,
+		const uint8_t *key, const uint8_t *iv, bool encrypt);
+void CRYPTO_AES_CTR128(CRYPTO_TypeDef *crypto, uint8_t *out, const uint8_t *in, unsigned int len,
+		const uint8_t *key, uint8_t *ctr, CRYPTO_AES_CtrFuncPtr_TypeDef ctrFunc);
+
+#endif
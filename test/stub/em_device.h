@@ -0,0 +1,35 @@
+/*
+ * Host replacement of the EFM32 device header for src/crash.c, MCU/src/mmi_timer.c, MCU/src/timebase.c
+ * and MCU/src/EFMEnergy.c
+ */
+#ifndef EM_DEVICE_H
+#define EM_DEVICE_H
+
+#include <stdint.h>
+
+#define SRAM_BASE	0x20000000UL
+
+typedef struct {
+	uint32_t	CFSR;
+	uint32_t	HFSR;
+	uint32_t	MMFAR;
+	uint32_t	BFAR;
+} SCB_Type;
+
+typedef enum {
+	TIMER0_IRQn = 10,
+	RTCC_IRQn = 30,
+	CRYOTIMER_IRQn = 31
+} IRQn_Type;
+
+#define __CLZ(x)	((uint32_t)__builtin_clz(x))
+
+extern SCB_Type		EmuScb;			// Provided by the test
+#define SCB			(&EmuScb)
+// Provided by the test
+void NVIC_DisableIRQ(IRQn_Type IRQn);
+void NVIC_EnableIRQ(IRQn_Type IRQn);
+void NVIC_ClearPendingIRQ(IRQn_Type IRQn);
+void NVIC_SetPriority(IRQn_Type IRQn, uint32_t priority);
+
+#endif
@@ -0,0 +1,14 @@
+/*
+ * Host replacement of the emlib EMU API used by MCU/src/EFMEnergy.c
+ */
+#ifndef EM_EMU_H
+#define EM_EMU_H
+
+#include <stdbool.h>
+
+// Provided by the test
+void EMU_EnterEM1(void);
+void EMU_EnterEM2(bool restore);
+void EMU_EnterEM3(bool restore);
+
+#endif
@@ -0,0 +1,7 @@
+/*
+ * Host replacement of the emlib GPIO API (MCU/src/mmi_timer.c only uses the system.h ports)
+ */
+#ifndef EM_GPIO_H
+#define EM_GPIO_H
+
+#endif
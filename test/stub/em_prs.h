@@ -0,0 +1,26 @@
+/*
+ * Host replacement of the emlib PRS API used by MCU/src/mmi_timer.c
+ */
+#ifndef EM_PRS_H
+#define EM_PRS_H
+
+#include <stdint.h>
+
+#define PRS_CH_CTRL_SOURCESEL_GPIOL		(0x30UL << 16)
+#define PRS_CH_CTRL_SOURCESEL_GPIOH		(0x31UL << 16)
+#define _PRS_CH_CTRL_SIGSEL_SHIFT		0
+
+typedef struct {
+	uint32_t	CTRL;
+} PRS_CH_TypeDef;
+
+typedef struct {
+	PRS_CH_TypeDef	CH[12];
+} PRS_TypeDef;
+
+// Provided by the test
+extern PRS_TypeDef EmuPrs;
+#define PRS		(&EmuPrs)
+void PRS_SourceAsyncSignalSet(unsigned int ch, uint32_t source, uint32_t signal);
+
+#endif
@@ -0,0 +1,23 @@
+/*
+ * Host replacement of the emlib RMU API used by MCU/src/timebase.c
+ */
+#ifndef EM_RMU_H
+#define EM_RMU_H
+
+typedef enum {
+	rmuResetWdog,
+	rmuResetCoreLockup,
+	rmuResetSys,
+	rmuResetPin
+} RMU_Reset_TypeDef;
+
+typedef enum {
+	rmuResetModeDisabled,
+	rmuResetModeLimited,
+	rmuResetModeExtended,
+	rmuResetModeFull
+} RMU_ResetMode_TypeDef;
+
+void RMU_ResetControl(RMU_Reset_TypeDef reset, RMU_ResetMode_TypeDef mode);	// Provided by the test
+
+#endif
@@ -0,0 +1,64 @@
+/*
+ * Host replacement of the emlib RTCC API used by MCU/src/timebase.c
+ */
+#ifndef EM_RTCC_H
+#define EM_RTCC_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "em_device.h"
+
+#define RTCC_CTRL_ENABLE		(0x1UL << 0)
+#define RTCC_IF_OF				(0x1UL << 0)
+#define RTCC_IF_CC0				(0x1UL << 1)
+#define RTCC_IEN_OF				RTCC_IF_OF
+#define _RTCC_IEN_MASK			0x0000007FUL
+#define _RTCC_IFC_MASK			0x0000007FUL
+#define RTCC_NUM_CHANNELS		3
+
+typedef struct {
+	uint32_t	CTRL;
+	uint32_t	CNT;
+	uint32_t	IF;
+	uint32_t	IEN;
+	uint32_t	CCV[RTCC_NUM_CHANNELS];
+} RTCC_TypeDef;
+
+typedef enum {
+	rtccCntPresc_1,
+	rtccCntPresc_8 = 3
+} RTCC_CntPresc_TypeDef;
+
+typedef struct {
+	bool					enable;
+	bool					debugRun;
+	bool					precntWrapOnCCV0;
+	bool					cntWrapOnCCV1;
+	RTCC_CntPresc_TypeDef	presc;
+} RTCC_Init_TypeDef;
+
+typedef struct {
+	int		chMode;
+	int		compMatchOutAction;
+} RTCC_CCChConf_TypeDef;
+
+#define RTCC_INIT_DEFAULT				{ true, false, false, false, rtccCntPresc_1 }
+#define RTCC_CH_INIT_COMPARE_DEFAULT	{ 2, 0 }
+
+// Provided by the test
+extern RTCC_TypeDef EmuRtcc;
+#define RTCC	(&EmuRtcc)
+void RTCC_Init(const RTCC_Init_TypeDef* init);
+void RTCC_Reset(void);
+void RTCC_ChannelInit(int ch, const RTCC_CCChConf_TypeDef* confPtr);
+
+static inline uint32_t RTCC_CounterGet(void) { return RTCC->CNT; }
+static inline void RTCC_ChannelCCVSet(int ch, uint32_t value) { RTCC->CCV[ch] = value; }
+static inline uint32_t RTCC_ChannelCCVGet(int ch) { return RTCC->CCV[ch]; }
+static inline void RTCC_IntClear(uint32_t flags) { RTCC->IF &= ~flags; }
+static inline void RTCC_IntSet(uint32_t flags) { RTCC->IF |= flags; }
+static inline void RTCC_IntEnable(uint32_t flags) { RTCC->IEN |= flags; }
+static inline void RTCC_IntDisable(uint32_t flags) { RTCC->IEN &= ~flags; }
+static inline uint32_t RTCC_IntGetEnabled(void) { return RTCC->IF & RTCC->IEN; }
+
+#endif
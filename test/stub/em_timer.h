@@ -0,0 +1,80 @@
+/*
+ * Host replacement of the emlib TIMER API used by MCU/src/mmi_timer.c
+ */
+#ifndef EM_TIMER_H
+#define EM_TIMER_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "em_device.h"
+
+#define TIMER_IF_OF				(0x1UL << 0)
+#define TIMER_IF_CC0			(0x1UL << 4)
+#define TIMER_IF_ICBOF0			(0x1UL << 8)
+#define TIMER_IEN_OF			TIMER_IF_OF
+#define TIMER_IEN_CC0			TIMER_IF_CC0
+#define TIMER_IEN_ICBOF0		TIMER_IF_ICBOF0
+#define _TIMER_IFC_MASK			0x00000FF7UL
+#define _TIMER_IEN_MASK			0x00000FF7UL
+#define TIMER_STATUS_ICV0		(0x1UL << 16)
+#define TIMER_CMD_START			(0x1UL << 0)
+#define TIMER_CMD_STOP			(0x1UL << 1)
+
+typedef struct {
+	uint32_t	CMD;
+	uint32_t	STATUS;
+	uint32_t	IEN;
+	uint32_t	IF;
+} TIMER_TypeDef;
+
+typedef enum {
+	timerCCModeOff,
+	timerCCModeCapture,
+	timerCCModeCompare,
+	timerCCModePWM
+} TIMER_CCMode_TypeDef;
+
+typedef enum {
+	timerEdgeRising,
+	timerEdgeFalling,
+	timerEdgeBoth,
+	timerEdgeNone
+} TIMER_Edge_TypeDef;
+
+typedef enum {
+	timerPRSSELCh0
+} TIMER_PRSSEL_TypeDef;
+
+typedef struct {
+	TIMER_Edge_TypeDef		eventCtrl;
+	TIMER_Edge_TypeDef		edge;
+	TIMER_PRSSEL_TypeDef	prsSel;
+	TIMER_CCMode_TypeDef	mode;
+	bool					filter;
+	bool					prsInput;
+} TIMER_InitCC_TypeDef;
+
+typedef struct {
+	bool		enable;
+	bool		debugRun;
+	uint32_t	prescale;
+} TIMER_Init_TypeDef;
+
+#define TIMER_INITCC_DEFAULT	{ timerEdgeRising, timerEdgeRising, timerPRSSELCh0, timerCCModeOff, false, false }
+#define TIMER_INIT_DEFAULT		{ true, false, 0 }
+
+// Provided by the test
+extern TIMER_TypeDef EmuTimer0;
+#define TIMER0	(&EmuTimer0)
+void TIMER_InitCC(TIMER_TypeDef* timer, unsigned int ch, const TIMER_InitCC_TypeDef* init);
+void TIMER_Init(TIMER_TypeDef* timer, const TIMER_Init_TypeDef* init);
+void TIMER_Enable(TIMER_TypeDef* timer, bool enable);
+void TIMER_Reset(TIMER_TypeDef* timer);
+uint32_t TIMER_CaptureGet(TIMER_TypeDef* timer, unsigned int ch);
+
+static inline void TIMER_IntClear(TIMER_TypeDef* timer, uint32_t flags) { timer->IF &= ~flags; }
+static inline void TIMER_IntEnable(TIMER_TypeDef* timer, uint32_t flags) { timer->IEN |= flags; }
+static inline void TIMER_IntDisable(TIMER_TypeDef* timer, uint32_t flags) { timer->IEN &= ~flags; }
+static inline uint32_t TIMER_IntGetEnabled(TIMER_TypeDef* timer) { return timer->IF & timer->IEN; }
+
+#endif
@@ -0,0 +1,28 @@
+/*
+ * Host replacement of inc/global.h and inc/trace.h for src/join_retry.c
+ * (forced with -include, the real headers are skipped by their include guards)
+ */
+#ifndef __GLOBAL_H__
+#define __GLOBAL_H__
+#define INC_TRACE_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include "FreeRTOS.h"
+#include "device_def.h"
+#include "timer.h"
+
+#define	TRACE(level, format, ...)
+#define	INFO(format, ...)
+#define	ERROR(format, ...)
+
+#define configTICK_RATE_HZ	1000
+#define portMAX_DELAY		0xFFFFFFFFUL
+
+// Provided by the test
+portTickType xTaskGetTickCount(void);
+void vTaskSuspendAll(void);
+long xTaskResumeAll(void);
+
+#endif
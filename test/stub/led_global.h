@@ -0,0 +1,24 @@
+/*
+ * Host replacement of inc/global.h for src/led_pattern.c
+ * (forced with -include, the real global.h is skipped by its include guard)
+ */
+#ifndef __GLOBAL_H__
+#define __GLOBAL_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+#define HAL_NB_LED			2
+#define configTICK_RATE_HZ	1000
+
+typedef int SystemPort;
+static const SystemPort LED[HAL_NB_LED] = { 0, 1 };
+
+// Provided by the test
+void SystemSetPortState(SystemPort port, bool on);
+void vTaskDelay(uint32_t ticks);
+static inline void SystemIrqDisable(void) { }
+static inline void SystemIrqEnable(void) { }
+
+#endif
@@ -0,0 +1,20 @@
+/*
+ * Host replacement of LoRaWAN/board.h for the hardware independent LoRaWAN modules
+ * (forced with -include, the real board.h is skipped by its include guard)
+ */
+#ifndef INC_BOARD_H_
+#define INC_BOARD_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+#define MIN( a, b ) ( ( ( a ) < ( b ) ) ? ( a ) : ( b ) )
+#define MAX( a, b ) ( ( ( a ) > ( b ) ) ? ( a ) : ( b ) )
+
+uint32_t RtcGetTimerValueUs( void );	// Provided by the test
+
+static inline void BoardDisableIrq( void ) { }
+static inline void BoardEnableIrq( void ) { }
+
+#endif
@@ -0,0 +1,39 @@
+/*
+ * Host replacement of the board, radio and timer functions used by the LoRaMAC
+ * The radio functions not listed are left NULL, a call is a test failure.
+ */
+#include "LoRaMac.h"
+
+/** @cond */
+static uint32_t Seed = 1;
+static TimerTime_t Time = 0;
+/** @endcond */
+
+SX1276_t SX1276;
+
+static void RadioInit( RadioEvents_t *events ) { }
+static uint32_t RadioRandom( void ) { return Seed = Seed * 1103515245UL + 12345; }
+static void RadioSetPublicNetwork( bool enable ) { }
+static void RadioSleep( void ) { }
+static bool RadioCheckRfFrequency( uint32_t frequency ) { return true; }
+static uint32_t RadioTimeOnAir( RadioModems_t modem, uint8_t pktLen ) { return 50; }
+static bool RadioIsChannelFree( RadioModems_t modem, uint32_t freq, int16_t rssiThresh, uint32_t maxCarrierSenseTime ) { return true; }
+
+const struct Radio_s Radio =
+{
+    .Init = RadioInit,
+    .Random = RadioRandom,
+    .SetPublicNetwork = RadioSetPublicNetwork,
+    .Sleep = RadioSleep,
+    .CheckRfFrequency = RadioCheckRfFrequency,
+    .TimeOnAir = RadioTimeOnAir,
+    .IsChannelFree = RadioIsChannelFree,
+};
+
+void TimerInit( TimerEvent_t *obj, void ( *callback )( void ) ) { }
+void TimerStart( TimerEvent_t *obj ) { }
+void TimerStop( TimerEvent_t *obj ) { }
+void TimerSetValue( TimerEvent_t *obj, uint32_t value ) { }
+TimerTime_t TimerGetCurrentTime( void ) { return Time += 10; }
+TimerTime_t TimerGetElapsedTime( TimerTime_t savedTime ) { return TimerGetCurrentTime( ) - savedTime; }
+uint32_t RtcGetTimerValueUs( void ) { return Time * 1000; }
@@ -0,0 +1,9 @@
+/*
+ * Host replacement of the FreeRTOS port header included by inc/EFMEnergy.h
+ */
+#ifndef PORTABLE_H
+#define PORTABLE_H
+
+#include "FreeRTOS.h"
+
+#endif
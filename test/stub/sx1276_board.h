@@ -0,0 +1,73 @@
+/*
+ * Host replacement of LoRaWAN/board.h for the SX1276 driver
+ * (forced with -include, the real board.h is skipped by its include guard)
+ * The pins and the SPI port are wired to the register emulator of the test.
+ */
+#ifndef INC_BOARD_H_
+#define INC_BOARD_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "timer.h"
+
+typedef enum
+{
+    PIN_INPUT = 0,
+    PIN_OUTPUT,
+    PIN_ALTERNATE_FCT,
+    PIN_ANALOGIC
+}PinModes;
+
+typedef enum
+{
+    PIN_NO_PULL = 0,
+    PIN_PULL_UP,
+    PIN_PULL_DOWN
+}PinTypes;
+
+typedef enum
+{
+    PIN_PUSH_PULL = 0,
+    PIN_OPEN_DRAIN
+}PinConfigs;
+
+typedef int PinNames;
+typedef struct {
+	void* port;
+} Gpio_t;
+
+typedef struct {
+	Gpio_t Nss;
+} Spi_t;
+
+#define RADIO_RESET		0
+
+#define MIN( a, b ) ( ( ( a ) < ( b ) ) ? ( a ) : ( b ) )
+#define MAX( a, b ) ( ( ( a ) > ( b ) ) ? ( a ) : ( b ) )
+
+// Provided by the test
+void EmuPin(Gpio_t* pin, int level);
+uint8_t EmuSpi(uint8_t out);
+void memcpy1(uint8_t *dst, const uint8_t *src, uint16_t size);
+
+static inline void GpioInit(void* port, PinNames name, PinModes mode, PinTypes type, PinConfigs pullup, int value) {
+	EmuPin((Gpio_t*)port, (mode == PIN_OUTPUT) ? value : 1);
+}
+
+static inline void GpioWrite(void* port, int value) {
+	EmuPin((Gpio_t*)port, value);
+}
+
+static inline uint8_t SpiInOut(Spi_t* spi, int address) {
+	return EmuSpi(address);
+}
+
+static inline void DelayMs(int delay) { }
+
+#include "radio.h"
+#include "sx1276/sx1276.h"
+#include "sx1276-board.h"
+
+#endif
@@ -0,0 +1,18 @@
+/*
+ * Host replacement of inc/global.h and inc/trace.h for src/time_sync.c
+ * (forced with -include, the real headers are skipped by their include guards)
+ */
+#ifndef __GLOBAL_H__
+#define __GLOBAL_H__
+#define INC_TRACE_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include "timer.h"
+
+#define	TRACE(level, format, ...)
+#define	INFO(format, ...)
+#define	ERROR(format, ...)
+
+#endif
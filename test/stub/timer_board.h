@@ -0,0 +1,24 @@
+/*
+ * Host replacement of LoRaWAN/board.h for the timer list of the LoRaMAC system
+ * (forced with -include, the real board.h is skipped by its include guard)
+ */
+#ifndef INC_BOARD_H_
+#define INC_BOARD_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "timer.h"
+
+enum BoardPowerSource
+{
+    USB_POWER = 0,
+    BATTERY_POWER,
+};
+
+static inline uint8_t GetBoardPowerSource( void ) { return BATTERY_POWER; }
+static inline void BoardDisableIrq( void ) { }
+static inline void BoardEnableIrq( void ) { }
+
+#endif
@@ -0,0 +1,52 @@
+/*
+ * Host replacement of inc/global.h and inc/trace.h for src/warm_start.c
+ * (forced with -include, the real headers are skipped by their include guards)
+ */
+#ifndef __GLOBAL_H__
+#define __GLOBAL_H__
+#define INC_TRACE_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <system.h>
+#include "timer.h"
+
+#define	TRACE(level, format, ...)
+#define	INFO(format, ...)
+#define	ERROR(format, ...)
+
+#define FLAG_INSTALLED		0x0001
+#define FLAG_USE_OTAA		0x0002
+#define FLAG_USE_SKT_APP	0x0004
+#define FLAG_USE_RAK		0x0008
+
+typedef struct __attribute__((packed)) {
+unsigned long Region;
+unsigned long NetID;
+unsigned char DevEui[8];
+unsigned char AppEui[8];
+unsigned char AppKey[16];
+unsigned char NwkSKey[16];
+unsigned char AppSKey[16];
+} LORAWAN_INFO;
+
+typedef struct __attribute__((packed)) {
+unsigned short DeviceFlags;
+LORAWAN_INFO LoRaWAN;
+struct { unsigned char RealAppKey[16]; } SKT;
+} USERDATA;
+
+// Provided by the test
+extern USERDATA UserData;
+void vTaskSuspendAll(void);
+long xTaskResumeAll(void);
+
+#define USERDATAPTR			((volatile const USERDATA*)&UserData)
+#define UNIT_INSTALLED		((USERDATAPTR)->DeviceFlags & FLAG_INSTALLED)
+#define UNIT_USE_OTAA		((USERDATAPTR)->DeviceFlags & FLAG_USE_OTAA)
+#define UNIT_USE_SKT_APP	((USERDATAPTR)->DeviceFlags & FLAG_USE_SKT_APP)
+#define UNIT_USE_RAK		((USERDATAPTR)->DeviceFlags & FLAG_USE_RAK)
+#define UNIT_REALAPPKEY		((const unsigned char*)(USERDATAPTR)->SKT.RealAppKey)
+
+#endif
@@ -0,0 +1,30 @@
+/*******************************************************************
+**                                                                **
+** Host unit tests helpers                                        **
+**                                                                **
+*******************************************************************/
+
+#ifndef __TEST_H__
+#define __TEST_H__
+
+#include <stdio.h>
+
+static unsigned long TestChecks = 0;
+static unsigned long TestFailures = 0;
+
+/*!
+ * @brief Check a condition, report the first failures
+ */
+#define CHECK(cond)	do { \
+	TestChecks++; \
+	if (!(cond) && (TestFailures++ < 20)) \
+		fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+} while (0)
+
+/*!
+ * @brief Report the test result, to be returned by main
+ */
+#define TEST_END()	(printf("%s: %lu checks, %lu failures\n", __FILE__, TestChecks, TestFailures), \
+	(TestFailures) ? 1 : 0)
+
+#endif
@@ -0,0 +1,213 @@
+/*******************************************************************
+**                                                                **
+** adc_filter.c host tests                                        **
+**                                                                **
+*******************************************************************/
+/*
+ * Compares the sample reductions with a sort and a mean in double on random buffers of 1 to
+ * 64 samples over the whole 16 bits range, checks the degenerate counts (none, 1, 2, 3 and
+ * even counts) and the saturation of the negated samples, and the 4-20 mA and 0-10 V scaling
+ * against the exact formulas and against the previous 32 bits formulas of device_impl.h.
+ * Captures are synthesized as on the target (ADCSAMPLES oversampled differential samples of
+ * a loop current with noise, mains hum, interference spikes and reversed wiring) and must
+ * give the loop current back.
+ */
+
+#include <math.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include "adc_filter.h"
+#include "test.h"
+
+/** @cond */
+#define TEST_RANDOM			200000UL
+#define MAX_SAMPLES			64
+#define CAPTURE_SAMPLES		16			// ADCSAMPLES of HAL_def.h
+#define FULL_SCALE_OVS16	32767		// ADCGetOversampledFullScale / 2 with ADCOversample16
+/** @endcond */
+
+static int CompareShort(const void* a, const void* b) {
+	return *(const short*)a - *(const short*)b;
+}
+
+static long RoundHalfAway(double value) {
+	return (long)((value >= 0) ? floor(value + 0.5) : -floor(-value + 0.5));
+}
+
+/*
+ * Reference: sorted copy, mean in double rounded half away from zero
+ */
+static long RefFilter(const short* samples, int count, ADC_FILTER filter) {
+	short sorted[MAX_SAMPLES];
+	int first = 0, last = count;
+	double sum = 0;
+	if (count <= 0) return 0;
+	memcpy(sorted, samples, count * sizeof(short));
+	qsort(sorted, count, sizeof(short), CompareShort);
+	if (filter == ADCFilterMedian) {
+		first = (count - 1) / 2;
+		last = count / 2 + 1;
+	}
+	else if (filter == ADCFilterTrimmedMean) {
+		first = count / 4;
+		last = count - count / 4;
+	}
+	for (int i = first; i < last; i++) sum += (filter == ADCFilterMean) ? samples[i] : sorted[i];
+	return RoundHalfAway(sum / (last - first));
+}
+
+static short RandomSample(void) {
+	switch (rand() % 8) {
+	case 0: return -32768;
+	case 1: return 32767;
+	case 2: return (short)(rand() % 5 - 2);
+	default: return (short)(rand() & 0xFFFF);
+	}
+}
+
+static void TestDegenerate(void) {
+	short samples[4] = { 7, -3, 100, 2 };
+	for (int f = ADCFilterMean; f <= ADCFilterTrimmedMean; f++) {
+		CHECK(ADCFilterSamples(NULL, 4, (ADC_FILTER)f) == 0);
+		CHECK(ADCFilterSamples(samples, 0, (ADC_FILTER)f) == 0);
+		CHECK(ADCFilterSamples(samples, -1, (ADC_FILTER)f) == 0);
+		samples[0] = -5;
+		CHECK(ADCFilterSamples(samples, 1, (ADC_FILTER)f) == -5);
+		samples[0] = 32767;
+		CHECK(ADCFilterSamples(samples, 1, (ADC_FILTER)f) == 32767);
+	}
+	// Two samples: every method is the rounded mean
+	for (int f = ADCFilterMean; f <= ADCFilterTrimmedMean; f++) {
+		short pair[2] = { 4, 7 };
+		CHECK(ADCFilterSamples(pair, 2, (ADC_FILTER)f) == 6);
+		pair[0] = -4;
+		pair[1] = -7;
+		CHECK(ADCFilterSamples(pair, 2, (ADC_FILTER)f) == -6);
+		pair[0] = -32768;
+		pair[1] = -32768;
+		CHECK(ADCFilterSamples(pair, 2, (ADC_FILTER)f) == -32768);
+	}
+	// Even count median: mean of the two middle samples
+	short even[4] = { 10, 1, 1000, 3 };
+	CHECK(ADCFilterSamples(even, 4, ADCFilterMedian) == 7);
+	// Trimmed mean of 4 samples drops one on each side
+	short trimmed[4] = { 10, 1, 1000, 3 };
+	CHECK(ADCFilterSamples(trimmed, 4, ADCFilterTrimmedMean) == 7);
+	// Trimmed mean of 3 samples or less keeps them all
+	short three[3] = { 0, 0, 3000 };
+	CHECK(ADCFilterSamples(three, 3, ADCFilterTrimmedMean) == 1000);
+	CHECK(ADCFilterSamples(three, 3, ADCFilterMedian) == 0);
+}
+
+static void TestRandom(void) {
+	short samples[MAX_SAMPLES], copy[MAX_SAMPLES];
+	for (unsigned long r = 0; r < TEST_RANDOM; r++) {
+		int count = 1 + rand() % MAX_SAMPLES;
+		for (int i = 0; i < count; i++) samples[i] = RandomSample();
+		for (int f = ADCFilterMean; f <= ADCFilterTrimmedMean; f++) {
+			memcpy(copy, samples, sizeof(copy));
+			CHECK(ADCFilterSamples(copy, count, (ADC_FILTER)f) == RefFilter(samples, count, (ADC_FILTER)f));
+			if (f != ADCFilterMean) {
+				// Sorted in place, same samples
+				short sorted[MAX_SAMPLES];
+				memcpy(sorted, samples, sizeof(sorted));
+				qsort(sorted, count, sizeof(short), CompareShort);
+				CHECK(memcmp(copy, sorted, count * sizeof(short)) == 0);
+			}
+			else CHECK(memcmp(copy, samples, count * sizeof(short)) == 0);
+		}
+		// Rectified: absolute values, -32768 saturates, nothing else touched
+		memcpy(copy, samples, sizeof(copy));
+		ADCFilterRectify(copy, count);
+		for (int i = 0; i < count; i++)
+			CHECK(copy[i] == ((samples[i] == -32768) ? 32767 : abs(samples[i])));
+		CHECK(memcmp(&copy[count], &samples[count], (MAX_SAMPLES - count) * sizeof(short)) == 0);
+	}
+	ADCFilterRectify(NULL, 4);
+}
+
+static void TestScaling(void) {
+	static const int references[] = { 1250, 2500, 3300, 5000 };
+	static const int fullScales[] = { 2047, 4095, 8191, 16383, FULL_SCALE_OVS16 };
+	for (unsigned int r = 0; r < sizeof(references) / sizeof(references[0]); r++) {
+		int reference = references[r];
+		for (unsigned int s = 0; s < sizeof(fullScales) / sizeof(fullScales[0]); s++) {
+			int fullScale = fullScales[s];
+			for (long value = 0; value <= fullScale; value++) {
+				// Exact: (reference / 2) mV per fullScale units on the 120 Ohms shunt, x4 divider for 0-10 V
+				double uA = (double)value * (reference / 2) / fullScale / 120 * 1000;
+				double mV = (double)value * reference * 2 / fullScale;
+				unsigned long current = ADCScale4_20mA(value, reference, fullScale);
+				unsigned long voltage = ADCScale0_10V(value, reference, fullScale);
+				CHECK((current <= uA + 1e-6) && (current > uA - 1));
+				CHECK((voltage <= mV + 1e-6) && (voltage > mV - 1));
+				// Previous 32 bits formulas, exact in this range
+				CHECK(current == ((reference / 2) * (unsigned long)value * 25) / (3 * fullScale));
+				CHECK(voltage == (reference * (unsigned long)value * 2) / fullScale);
+			}
+			// Values beyond the previous 32 bits range do not overflow
+			CHECK(ADCScale4_20mA(0x7FFFFFFFL, reference, fullScale) ==
+					(unsigned long)((0x7FFFFFFFULL * (reference / 2) * 25) / (3ULL * fullScale)));
+			CHECK(ADCScale0_10V(0x7FFFFFFFL, reference, fullScale) ==
+					(unsigned long)((0x7FFFFFFFULL * reference * 2) / fullScale));
+			CHECK(ADCScale4_20mA(-1, reference, fullScale) == 0);
+			CHECK(ADCScale0_10V(-32768, reference, fullScale) == 0);
+		}
+		CHECK(ADCScale4_20mA(1000, reference, 0) == 0);
+		CHECK(ADCScale0_10V(1000, reference, -1) == 0);
+	}
+}
+
+/*
+ * Capture of a loop current as on the target: 5 V reference, differential, 16x oversampling
+ */
+static void Capture(short* samples, double uA, double noise, int spikes, bool reversed) {
+	double phase = (rand() % 1000) * 2 * M_PI / 1000;
+	for (int i = 0; i < CAPTURE_SAMPLES; i++) {
+		double value = uA * 120 / 1000 / 2500 * FULL_SCALE_OVS16;
+		value += 30 * sin(phase + i * 2 * M_PI * 50 / 1000);			// 50 Hz hum, one sample per ms
+		value += noise * ((rand() % 2001) - 1000) / 1000;
+		samples[i] = (short)lrint(reversed ? -value : value);
+	}
+	for (int s = 0; s < spikes; s++) {
+		int i = rand() % CAPTURE_SAMPLES;
+		samples[i] = (rand() & 1) ? 32767 : -32768;
+	}
+}
+
+static void TestCaptures(void) {
+	short samples[CAPTURE_SAMPLES];
+	for (int r = 0; r < 20000; r++) {
+		double uA = 4000 + (rand() % 16001);
+		bool reversed = rand() & 1;
+		// Clean capture: every method is within 0.2 % of the loop current
+		for (int f = ADCFilterMean; f <= ADCFilterTrimmedMean; f++) {
+			Capture(samples, uA, 20, 0, reversed);
+			ADCFilterRectify(samples, CAPTURE_SAMPLES);
+			long value = ADCFilterSamples(samples, CAPTURE_SAMPLES, (ADC_FILTER)f);
+			CHECK(fabs(ADCScale4_20mA(value, 5000, FULL_SCALE_OVS16) - uA) < 40);
+		}
+		// Interference spikes up to the trimmed quarter: rejected by the median and the trimmed mean
+		int spikes = 1 + rand() % (CAPTURE_SAMPLES / 4);
+		for (int f = ADCFilterMedian; f <= ADCFilterTrimmedMean; f++) {
+			Capture(samples, uA, 20, spikes, reversed);
+			ADCFilterRectify(samples, CAPTURE_SAMPLES);
+			long value = ADCFilterSamples(samples, CAPTURE_SAMPLES, (ADC_FILTER)f);
+			CHECK(fabs(ADCScale4_20mA(value, 5000, FULL_SCALE_OVS16) - uA) < 40);
+		}
+	}
+	// A single spike moves the plain mean by more than 0.5 mA
+	Capture(samples, 12000, 0, 0, false);
+	samples[3] = 32767;
+	CHECK(ADCScale4_20mA(ADCFilterSamples(samples, CAPTURE_SAMPLES, ADCFilterMean), 5000, FULL_SCALE_OVS16) > 12500);
+}
+
+int main(void) {
+	srand(28);
+	TestDegenerate();
+	TestRandom();
+	TestScaling();
+	TestCaptures();
+	return TEST_END();
+}
@@ -0,0 +1,150 @@
+/*******************************************************************
+**                                                                **
+** adr-predict.c airtime simulation                               **
+**                                                                **
+*******************************************************************/
+/*
+ * A confirmed uplink is sent every period over a link whose SNR (at maximum TX power)
+ * follows a scenario: good link, sudden 12 dB loss (device moved), slow recovery.
+ * The predictive ADR is compared with the standard ADR backoff, which only steps down
+ * after ADR_ACK_LIMIT + ADR_ACK_DELAY uplinks without downlink, and with a device that
+ * always uses DR0. ADR devices start at DR5 and the network never sends LinkADRReq.
+ */
+
+#include <stdlib.h>
+#include <math.h>
+#include "adr-predict.h"
+#include "test.h"
+
+/** @cond */
+#define SIM_UPLINKS			3000
+#define SIM_PAYLOAD			20		// Application payload in bytes (13 bytes of LoRaWAN overhead)
+#define SIM_MAX_EIRP		14.0f	// KR920 device maximum EIRP
+#define SIM_GATEWAY_EIRP	20.0f
+#define SIM_FADING			2.0		// Uniform fading in dB
+#define ADR_ACK_LIMIT		64
+#define ADR_ACK_DELAY		32
+#define TX_POWER_STEP_DB	2.0
+#define MIN_TX_POWER		7		// Lowest KR920 TX power index
+
+typedef struct {
+	int dr;
+	int txPower;
+	int adrAckCounter;
+	unsigned long delivered;
+	unsigned long lostAfterDrop;
+	double airtime;			// In ms
+} SIM_DEVICE;
+/** @endcond */
+
+// Demodulation floors in dB, SF12 to SF7
+static const double Floor[6] = { -20.0, -17.5, -15.0, -12.5, -10.0, -7.5 };
+
+static double TimeOnAir(int dr, int size) {
+	int sf = 12 - dr;
+	double tSym = (double)(1 << sf) / 125.0;
+	int de = (sf >= 11) ? 1 : 0;
+	double payloadSymbols = 8 + fmax(ceil((8.0 * size - 4 * sf + 28 + 16) / (4.0 * (sf - 2 * de))) * 5, 0);
+	return (8 + 4.25 + payloadSymbols) * tSym;
+}
+
+static double LinkSnr(int n) {
+	if (n < 500) return -2.0;
+	if (n < 1500) return -14.0;
+	return -14.0 + (n - 1500) * 0.008;	// Back to -2 dB at the end
+}
+
+static double Fading(void) {
+	return ((double)rand() / RAND_MAX) * 2 * SIM_FADING - SIM_FADING;
+}
+
+/*
+ * One confirmed uplink: the acknowledgment uses the same data rate
+ */
+static bool Uplink(SIM_DEVICE* dev, int n, double* downlinkSnr) {
+	double snr = LinkSnr(n);
+	dev->airtime += TimeOnAir(dev->dr, SIM_PAYLOAD + 13);
+	bool up = (snr - dev->txPower * TX_POWER_STEP_DB + Fading()) >= Floor[dev->dr];
+	*downlinkSnr = snr + (SIM_GATEWAY_EIRP - SIM_MAX_EIRP) + Fading();
+	bool down = up && (*downlinkSnr >= Floor[dev->dr]);
+	if (down) dev->delivered++;
+	else if (n >= 500) dev->lostAfterDrop++;
+	return down;
+}
+
+/*
+ * Standard ADR backoff as in RegionCommon: maximum TX power first, then slower data rates
+ */
+static void StandardNext(SIM_DEVICE* dev, bool acked) {
+	if (acked) {
+		dev->adrAckCounter = 0;
+		return;
+	}
+	if (++dev->adrAckCounter < (ADR_ACK_LIMIT + ADR_ACK_DELAY)) return;
+	if (((dev->adrAckCounter - ADR_ACK_LIMIT) % ADR_ACK_DELAY) != 0) return;
+	if (dev->txPower > 0) dev->txPower = 0;
+	else if (dev->dr > 0) dev->dr--;
+}
+
+static void PredictNext(SIM_DEVICE* dev, bool acked, double downlinkSnr) {
+	AdrPredictParams_t params = { dev->dr, dev->txPower, 0, 5, 0, MIN_TX_POWER };
+	int8_t dr, txPower;
+	if (acked) AdrPredictRxDone((int8_t)dev->dr, (int8_t)lrint(downlinkSnr), SIM_MAX_EIRP);
+	else AdrPredictMissed();
+	if (AdrPredictNext(&params, &dr, &txPower)) {
+		dev->dr = dr;
+		dev->txPower = txPower;
+	}
+}
+
+static void TestNormalization(void) {
+	AdrPredictStats_t stats;
+	// A downlink at 0 dB SNR with a 6 dB louder gateway is a -6 dB uplink at maximum TX power
+	AdrPredictInit();
+	AdrPredictRxDone(5, 0, SIM_MAX_EIRP);
+	AdrPredictGetStats(&stats);
+	CHECK(stats.Valid && (stats.Snr == -6 * 4));
+	// The device TX power does not change downlink samples, but does change LinkCheckAns ones
+	AdrPredictInit();
+	AdrPredictLinkCheck(10, 1, 5, 3);
+	AdrPredictGetStats(&stats);
+	CHECK(stats.Snr == (10 * 4 - 30 + 3 * 8));
+}
+
+int main(void) {
+	SIM_DEVICE standard = { 5, 0, 0, 0, 0, 0 };
+	SIM_DEVICE predict = { 5, 0, 0, 0, 0, 0 };
+	SIM_DEVICE robust = { 0, 0, 0, 0, 0, 0 };
+	double snr;
+
+	TestNormalization();
+
+	srand(1);
+	for (int n = 0; n < SIM_UPLINKS; n++) StandardNext(&standard, Uplink(&standard, n, &snr));
+	srand(1);
+	for (int n = 0; n < SIM_UPLINKS; n++) Uplink(&robust, n, &snr);
+	srand(1);
+	AdrPredictInit();
+	for (int n = 0; n < SIM_UPLINKS; n++) {
+		bool acked = Uplink(&predict, n, &snr);
+		PredictNext(&predict, acked, snr);
+	}
+
+	printf("%-10s %10s %10s %14s %16s\n", "ADR", "delivered", "lost", "airtime (s)", "ms / delivered");
+	printf("%-10s %10lu %10lu %14.1f %16.1f\n", "standard", standard.delivered, standard.lostAfterDrop,
+			standard.airtime / 1000, standard.airtime / standard.delivered);
+	printf("%-10s %10lu %10lu %14.1f %16.1f\n", "DR0", robust.delivered, robust.lostAfterDrop,
+			robust.airtime / 1000, robust.airtime / robust.delivered);
+	printf("%-10s %10lu %10lu %14.1f %16.1f\n", "predictive", predict.delivered, predict.lostAfterDrop,
+			predict.airtime / 1000, predict.airtime / predict.delivered);
+
+	// Recovers from the loss far quicker than the standard backoff
+	CHECK(predict.lostAfterDrop * 4 < standard.lostAfterDrop);
+	CHECK(predict.delivered > standard.delivered);
+	// Almost as reliable as the most robust data rate, for a fraction of its airtime
+	CHECK(predict.delivered * 100 >= robust.delivered * 99);
+	CHECK(predict.airtime * 2 < robust.airtime);
+	// Speeds up again once the link is back
+	CHECK(predict.dr >= 4);
+	return TEST_END();
+}
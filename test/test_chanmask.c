@@ -0,0 +1,172 @@
+/*******************************************************************
+**                                                                **
+** RegionCommon channels mask host tests                          **
+**                                                                **
+*******************************************************************/
+/*
+ * Compares the bit mask functions of RegionCommon.c with the previous loops, which tested
+ * the 16 bits of each channels mask word: RegionCommonCountChannels and RegionCommonChanMaskNth
+ * on every single word mask and on random 6 words masks, RegionCommonCountNbOfEnabledChannels
+ * and RegionCommonChanVerifyDr on random channels, bands and masks of 16, 72 and 96 channels
+ * plans. The n-th channel of the usable channels mask must be the n-th entry of the previous
+ * list of ids, so that NextChannel picks the same channel from the same random draw.
+ */
+
+#include <stdlib.h>
+#include "timer.h"
+#include "LoRaMac.h"
+#include "RegionCommon.h"
+#include "test.h"
+
+/** @cond */
+#define TEST_RANDOM			2000000UL
+#define MASK_WORDS			6
+#define MAX_CHANNELS		96
+#define NB_BANDS			6
+/** @endcond */
+
+/*
+ * Previous implementations, a bit at a time
+ */
+static uint8_t RefCountChannels(uint16_t* channelsMask, uint8_t startIdx, uint8_t stopIdx) {
+	uint8_t nbChannels = 0;
+	for (uint8_t i = startIdx; i < stopIdx; i++)
+		for (uint8_t j = 0; j < 16; j++)
+			if ((channelsMask[i] & (1 << j)) == (1 << j)) nbChannels++;
+	return nbChannels;
+}
+
+static uint8_t RefCountNbOfEnabledChannels(RegionCommonCountNbOfEnabledChannelsParams_t* params,
+		uint8_t* enabledChannels, uint8_t* delayTx) {
+	uint8_t nbEnabledChannels = 0, delayTransmission = 0;
+	for (uint8_t i = 0, k = 0; i < params->MaxNbChannels; i += 16, k++) {
+		for (uint8_t j = 0; j < 16; j++) {
+			ChannelParams_t* channel = &params->Channels[i + j];
+			if ((params->ChannelsMask[k] & (1 << j)) == 0) continue;
+			if (channel->Frequency == 0) continue;
+			if (!params->Joined && ((params->JoinChannels & (1 << j)) == 0)) continue;
+			if (!RegionCommonValueInRange(params->Datarate, channel->DrRange.Fields.Min, channel->DrRange.Fields.Max)) continue;
+			if (params->Bands[channel->Band].TimeOff > 0) {
+				delayTransmission++;
+				continue;
+			}
+			enabledChannels[nbEnabledChannels++] = i + j;
+		}
+	}
+	*delayTx = delayTransmission;
+	return nbEnabledChannels;
+}
+
+static bool RefChanVerifyDr(uint8_t nbChannels, uint16_t* channelsMask, int8_t dr, int8_t minDr, int8_t maxDr,
+		ChannelParams_t* channels) {
+	if (!RegionCommonValueInRange(dr, minDr, maxDr)) return false;
+	for (uint8_t i = 0, k = 0; i < nbChannels; i += 16, k++)
+		for (uint8_t j = 0; j < 16; j++)
+			if (((channelsMask[k] & (1 << j)) != 0) && RegionCommonValueInRange(dr,
+					(channels[i + j].DrRange.Fields.Min & 0x0F), (channels[i + j].DrRange.Fields.Max & 0x0F)))
+				return true;
+	return false;
+}
+
+static uint16_t RandomWord(void) {
+	// Sparse, dense and uniform masks
+	switch (rand() % 4) {
+	case 0: return (uint16_t)(rand() & rand() & rand());
+	case 1: return (uint16_t)(rand() | rand() | rand());
+	case 2: return (rand() & 1) ? 0xFFFF : 0;
+	default: return (uint16_t)rand();
+	}
+}
+
+/*
+ * Every single word mask: count, every rank and one past the last
+ */
+static void TestSingleWord(void) {
+	for (uint32_t m = 0; m <= 0xFFFF; m++) {
+		uint16_t mask = (uint16_t)m;
+		uint8_t count = RegionCommonCountChannels(&mask, 0, 1);
+		CHECK(count == RefCountChannels(&mask, 0, 1));
+		for (uint8_t j = 0, n = 0; j < 16; j++)
+			if (mask & (1 << j)) CHECK(RegionCommonChanMaskNth(&mask, 1, n++) == j);
+		CHECK(RegionCommonChanMaskNth(&mask, 1, count) == 0xFF);
+		CHECK(RegionCommonChanMaskNth(&mask, 0, 0) == 0xFF);
+	}
+}
+
+/*
+ * Random 6 words masks, as the 96 channels plans
+ */
+static void TestMultiWord(void) {
+	uint16_t mask[MASK_WORDS];
+	for (unsigned long r = 0; r < TEST_RANDOM; r++) {
+		uint8_t ids[MAX_CHANNELS], count = 0;
+		for (int k = 0; k < MASK_WORDS; k++) mask[k] = RandomWord();
+		for (int i = 0; i < MAX_CHANNELS; i++)
+			if (mask[i / 16] & (1 << (i % 16))) ids[count++] = i;
+		uint8_t start = rand() % (MASK_WORDS + 1), stop = start + rand() % (MASK_WORDS + 1 - start);
+		CHECK(RegionCommonCountChannels(mask, start, stop) == RefCountChannels(mask, start, stop));
+		CHECK(RegionCommonCountChannels(mask, 0, MASK_WORDS) == count);
+		if (count > 0) {
+			uint8_t n = rand() % count;
+			CHECK(RegionCommonChanMaskNth(mask, MASK_WORDS, n) == ids[n]);
+			CHECK(RegionCommonChanMaskNth(mask, MASK_WORDS, count - 1) == ids[count - 1]);
+		}
+		CHECK(RegionCommonChanMaskNth(mask, MASK_WORDS, count) == 0xFF);
+	}
+}
+
+/*
+ * Usable channels and datarate check on random channels and bands of 16, 72 and 96 channels plans
+ */
+static void TestEnabledChannels(void) {
+	static const uint8_t plans[] = { 16, 72, 96 };
+	static ChannelParams_t channels[MAX_CHANNELS];
+	Band_t bands[NB_BANDS];
+	uint16_t mask[MASK_WORDS];
+	for (unsigned long r = 0; r < TEST_RANDOM / 4; r++) {
+		uint8_t maxNbChannels = plans[r % 3], ids[MAX_CHANNELS], n1, n2, delay1, delay2;
+		uint16_t enabled[MASK_WORDS];
+		for (int i = 0; i < MAX_CHANNELS; i++) {
+			channels[i].Frequency = (rand() % 4) ? 922100000 : 0;
+			channels[i].DrRange.Fields.Min = rand() % 6;
+			channels[i].DrRange.Fields.Max = channels[i].DrRange.Fields.Min + rand() % 4;
+			channels[i].Band = rand() % NB_BANDS;
+		}
+		for (int b = 0; b < NB_BANDS; b++) bands[b].TimeOff = (rand() % 3) ? 0 : 1000;
+		// The regions keep the bits beyond the last channel cleared
+		for (int k = 0; k < MASK_WORDS; k++) {
+			int bits = maxNbChannels - k * 16;
+			mask[k] = (bits >= 16) ? RandomWord() : ((bits > 0) ? RandomWord() & ((1 << bits) - 1) : 0);
+		}
+		RegionCommonCountNbOfEnabledChannelsParams_t params = {
+			.Joined = rand() & 1, .Datarate = rand() % 8, .ChannelsMask = mask, .Channels = channels,
+			.Bands = bands, .NbBands = NB_BANDS, .MaxNbChannels = maxNbChannels, .JoinChannels = RandomWord()
+		};
+		n1 = RefCountNbOfEnabledChannels(&params, ids, &delay1);
+		n2 = RegionCommonCountNbOfEnabledChannels(&params, enabled, &delay2);
+		CHECK(n1 == n2);
+		CHECK(delay1 == delay2);
+		CHECK(RegionCommonCountChannels(enabled, 0, (maxNbChannels + 15) / 16) == n1);
+		for (uint8_t n = 0; n < n1; n++) CHECK(RegionCommonChanMaskNth(enabled, (maxNbChannels + 15) / 16, n) == ids[n]);
+		CHECK(RegionCommonChanMaskNth(enabled, (maxNbChannels + 15) / 16, n1) == 0xFF);
+
+		int8_t dr = rand() % 10, minDr = rand() % 3, maxDr = minDr + rand() % 8;
+		CHECK(RegionCommonChanVerifyDr(maxNbChannels, mask, dr, minDr, maxDr, channels) ==
+				RefChanVerifyDr(maxNbChannels, mask, dr, minDr, maxDr, channels));
+	}
+}
+
+/*******************************************************************
+** Emulated seams                                                 **
+*******************************************************************/
+TimerTime_t TimerGetElapsedTime(TimerTime_t past) {
+	return 0;
+}
+
+int main(void) {
+	srand(50);
+	TestSingleWord();
+	TestMultiWord();
+	TestEnabledChannels();
+	return TEST_END();
+}
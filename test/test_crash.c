@@ -0,0 +1,400 @@
+/*******************************************************************
+**                                                                **
+** Crash capture unit tests                                       **
+**                                                                **
+*******************************************************************/
+/*
+ * src/crash.c runs on an emulated Flash Memory page (erased words read 0xFF, a write only
+ * clears bits) and an emulated SRAM mapped at the target address, holding the task control
+ * blocks and stacks. The module source is included to reach its Flash Memory page.
+ *
+ * Synthetic dumps are written to the page to check the CRASH_Init parsing: the core and
+ * tasks CRCs, the partial writes and the compact report encoding. The capture itself is
+ * checked through CRASH_Capture, then parsed back.
+ */
+
+#include <stdlib.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include "../src/crash.c"
+#include "test.h"
+
+/** @cond */
+#define RAM_KB			32
+#define RAM				((uint8_t*)(uintptr_t)SRAM_BASE)
+#define TASKS			4
+
+typedef struct {
+	uint32_t		TopOfStack;		// pxTopOfStack, first member of the TCB
+	uint32_t		Dummy[23];
+} EMU_TCB;
+
+typedef struct {
+	const char*		Name;
+	uint32_t		Tcb;			// Emulated SRAM offsets
+	uint32_t		StackBase;
+	uint32_t		Sp;
+	unsigned long	Priority;
+	unsigned long	HighWater;
+} EMU_TASK;
+
+SCB_Type			EmuScb;
+static const EMU_TASK EmuTasks[TASKS] = {
+	{ "SUPERVISOR", 0x0100, 0x1000, 0x13C0, 3, 40 },
+	{ "LW_EVENT", 0x0200, 0x2000, 0x27F0, 2, 12 },
+	{ "SHELL", 0x0300, 0x3000, 0x3200, 1, 100 },
+	{ "IDLE", 0x0400, 0x7000, RAM_KB * 1024 - 8, 0, 20 },	// Top of stack at the end of SRAM
+};
+static TaskHandle_t	Current;
+static long			SchedulerState = taskSCHEDULER_RUNNING;
+static uint32_t		Ticks;
+static const char*	TraceHistory = "";
+static bool			bFlashOpen;
+static int			Suspended;
+// SKTAPP_Send
+static bool			bSendOk = true;
+static uint8_t		SentPort;
+static uint8_t		SentType;
+static uint8_t		SentFrame[64];
+static uint32_t		SentLen;
+/** @endcond */
+
+/*******************************************************************
+** Emulated seams                                                 **
+*******************************************************************/
+static void RamInit(void) {
+	void* ram = mmap(RAM, RAM_KB * 1024, PROT_READ | PROT_WRITE,
+			MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED_NOREPLACE, -1, 0);
+	if (ram != RAM) {
+		perror("mmap");
+		exit(1);
+	}
+}
+
+int SystemGetRAMSize(void) {
+	return RAM_KB;
+}
+void SystemReboot(void) {
+	abort();
+}
+
+long xTaskGetSchedulerState(void) {
+	return SchedulerState;
+}
+TaskHandle_t xTaskGetCurrentTaskHandle(void) {
+	return Current;
+}
+static const EMU_TASK* EmuTask(TaskHandle_t task) {
+	for (int i = 0; i < TASKS; i++)
+		if (task == (TaskHandle_t)(RAM + EmuTasks[i].Tcb)) return &EmuTasks[i];
+	return NULL;
+}
+void vTaskGetInfo(TaskHandle_t xTask, TaskStatus_t* pxTaskStatus, long xGetFreeStackSpace, eTaskState eState) {
+	const EMU_TASK* task = EmuTask(xTask);
+	CHECK(task && !xGetFreeStackSpace && (eState == eRunning));
+	if (!task) return;
+	pxTaskStatus->xHandle = xTask;
+	pxTaskStatus->pcTaskName = task->Name;
+	pxTaskStatus->uxCurrentPriority = task->Priority;
+	pxTaskStatus->pxStackBase = (uint32_t*)(RAM + task->StackBase);
+}
+unsigned long uxTaskGetStackHighWaterMark(TaskHandle_t xTask) {
+	const EMU_TASK* task = EmuTask(xTask);
+	return task ? task->HighWater : 0;
+}
+uint32_t xTaskGetTickCount(void) {
+	return Ticks;
+}
+char* pcTaskGetName(TaskHandle_t xTask) {
+	const EMU_TASK* task = EmuTask(xTask);
+	return task ? (char*)task->Name : NULL;
+}
+void vTaskSuspendAll(void) {
+	Suspended++;
+}
+long xTaskResumeAll(void) {
+	CHECK(Suspended > 0);
+	Suspended--;
+	return 0;
+}
+uint32_t TRACE_GetHistory(char* pBuffer, uint32_t ulSize) {
+	size_t len = strnlen(TraceHistory, ulSize);
+	memset(pBuffer, 0, ulSize);
+	memcpy(pBuffer, TraceHistory, len);
+	return (uint32_t)len;
+}
+
+bool SKTAPP_Send(uint8_t port, uint8_t messageType, uint8_t *pFrame, uint32_t ulFrameLen) {
+	SentPort = port;
+	SentType = messageType;
+	SentLen = ulFrameLen;
+	CHECK(ulFrameLen <= sizeof(SentFrame));
+	memcpy(SentFrame, pFrame, ulFrameLen);
+	return bSendOk;
+}
+
+static void FlashProtect(int prot) {
+	uintptr_t page = (uintptr_t)sysconf(_SC_PAGESIZE);
+	uintptr_t start = (uintptr_t)_CRASHPAGE_ & ~(page - 1);
+	uintptr_t end = ((uintptr_t)_CRASHPAGE_ + sizeof(_CRASHPAGE_) + page - 1) & ~(page - 1);
+	if (mprotect((void*)start, end - start, prot) != 0) {
+		perror("mprotect");
+		exit(1);
+	}
+}
+void FLASHOpen(void) {
+	CHECK(!bFlashOpen);
+	bFlashOpen = true;
+	FlashProtect(PROT_READ | PROT_WRITE);
+}
+void FLASHClose(void) {
+	CHECK(bFlashOpen);
+	bFlashOpen = false;
+	FlashProtect(PROT_READ);
+}
+signed char FLASHEraseBlock(void* address) {
+	CHECK(bFlashOpen && (address == (void*)_CRASHPAGE_));
+	memset(address, 0xFF, sizeof(_CRASHPAGE_));
+	return FLASH_NO_ERROR;
+}
+signed char FLASHWrite(void* address, unsigned char* buffer, unsigned short count) {
+	uint8_t* flash = (uint8_t*)address;
+	CHECK(bFlashOpen && (flash >= _CRASHPAGE_) && (flash + count <= _CRASHPAGE_ + sizeof(_CRASHPAGE_)));
+	CHECK((((uintptr_t)flash % 4) == 0) && ((count % 4) == 0));
+	for (int i = 0; i < count; i++) {
+		CHECK(flash[i] == 0xFF);
+		flash[i] &= buffer[i];
+	}
+	return FLASH_NO_ERROR;
+}
+
+/*******************************************************************
+** Synthetic dumps                                                **
+*******************************************************************/
+static void PageErase(void) {
+	FlashProtect(PROT_READ | PROT_WRITE);
+	memset((void*)_CRASHPAGE_, 0xFF, sizeof(_CRASHPAGE_));
+	FlashProtect(PROT_READ);
+}
+
+static void PageWrite(const void* data, size_t offset, size_t size) {
+	FlashProtect(PROT_READ | PROT_WRITE);
+	memcpy((uint8_t*)_CRASHPAGE_ + offset, data, size);
+	FlashProtect(PROT_READ);
+}
+
+static void Synthetic(CRASH_RECORD* record) {
+	memset(record, 0, sizeof(CRASH_RECORD));
+	record->Magic = CRASH_MAGIC;
+	record->Reported = CRASH_NOT_REPORTED;
+	record->Version = CRASH_VERSION;
+	record->Cause = CrashHardFault;
+	record->Code = 0;
+	record->Ticks = 123456789;
+	for (int i = 0; i < 8; i++) record->Registers[i] = 0x11111111UL * i;
+	record->Registers[5] = 0x00012345UL;		// LR
+	record->Registers[6] = 0x0001ABCCUL;		// PC
+	record->Registers[7] = 0x21000003UL;
+	record->ExcReturn = 0xFFFFFFFDUL;
+	record->Sp = 0x20001F00UL;
+	record->Cfsr = 0x00008200UL;
+	record->Hfsr = 0x40000000UL;
+	record->Bfar = 0xDEADBEEFUL;
+	strcpy(record->Task, "LW_EVENT");
+	for (int i = 0; i < CRASH_STACK_WORDS; i++) record->Stack[i] = 0x20000000UL + i;
+	strcpy(record->Trace, "Last trace line\n");
+	record->Crc = CRASHCoreCrc(record);
+	record->TasksCount = 2;
+	for (int i = 0; i < 2; i++) {
+		record->Tasks[i].Tcb = 0x20000100UL * (i + 1);
+		record->Tasks[i].Sp = 0x20001000UL * (i + 1);
+		record->Tasks[i].Priority = (uint8_t)i;
+		sprintf(record->Tasks[i].Name, "TASK%d", i);
+	}
+	record->TasksCrc = CRASHTasksCrc(record);
+}
+
+static void TestBlank(void) {
+	uint8_t report[CRASH_REPORT_SIZE];
+	PageErase();
+	CRASH_Init();
+	CHECK(CRASH_Get() == NULL);
+	CHECK(!CRASH_IsPending());
+	CHECK(CRASH_Encode(report, sizeof(report)) == 0);
+	CHECK(!CRASH_Send());
+}
+
+/*
+ * A complete dump is loaded as is and encoded in the compact report
+ */
+static void TestParse(void) {
+	static const uint8_t expected[CRASH_REPORT_SIZE] = {
+		CRASH_VERSION, CrashHardFault,
+		0x00, 0x00, 0x00, 0x00,			// Code
+		0x00, 0x01, 0xE2, 0x40,			// Uptime: 123456 s
+		0x00, 0x01, 0xAB, 0xCC,			// PC
+		0x00, 0x01, 0x23, 0x45,			// LR
+		0x00, 0x00, 0x82, 0x00,			// CFSR
+		0x40, 0x00, 0x00, 0x00,			// HFSR
+		'L', 'W', '_', 'E', 'V', 'E', 'N', 'T'
+	};
+	CRASH_RECORD record;
+	uint8_t report[CRASH_REPORT_SIZE + 1];
+	Synthetic(&record);
+	PageErase();
+	PageWrite(&record, 0, sizeof(record));
+	CRASH_Init();
+	CHECK(CRASH_Get() && (memcmp(CRASH_Get(), &record, sizeof(record)) == 0));
+	CHECK(CRASH_IsPending());
+	memset(report, 0xAA, sizeof(report));
+	CHECK(CRASH_Encode(report, CRASH_REPORT_SIZE) == CRASH_REPORT_SIZE);
+	CHECK(memcmp(report, expected, sizeof(expected)) == 0);
+	CHECK(report[CRASH_REPORT_SIZE] == 0xAA);
+	CHECK(CRASH_Encode(report, CRASH_REPORT_SIZE - 1) == 0);
+
+	// Already reported
+	record.Reported = 0;
+	PageWrite(&record, 0, sizeof(record));
+	CRASH_Init();
+	CHECK(CRASH_Get() && !CRASH_IsPending());
+	CHECK(CRASH_Encode(report, CRASH_REPORT_SIZE) == CRASH_REPORT_SIZE);
+}
+
+/*
+ * A damaged core discards the dump, damaged tasks only discard the tasks
+ */
+static void TestDamaged(void) {
+	CRASH_RECORD record;
+	int core = 0;
+	int tasks = 0;
+	Synthetic(&record);
+	for (size_t i = 0; i < sizeof(record); i++) {
+		// Reported is the only word written after the record
+		if ((i >= offsetof(CRASH_RECORD, Reported)) && (i < offsetof(CRASH_RECORD, Crc))) continue;
+		for (int bit = 0; bit < 8; bit += 3) {
+			CRASH_RECORD damaged = record;
+			((uint8_t*)&damaged)[i] ^= (uint8_t)(1 << bit);
+			PageErase();
+			PageWrite(&damaged, 0, sizeof(damaged));
+			CRASH_Init();
+			if (i < CRASH_CORE_SIZE) {
+				CHECK(CRASH_Get() == NULL);
+				core++;
+			}
+			else {
+				CHECK(CRASH_Get() && (CRASH_Get()->TasksCount == 0) && (CRASH_Get()->Ticks == record.Ticks));
+				tasks++;
+			}
+		}
+	}
+	printf("%d core and %d tasks damaged dumps\n", core, tasks);
+
+	// Interrupted before the tasks were written
+	PageErase();
+	PageWrite(&record, 0, CRASH_CORE_SIZE);
+	CRASH_Init();
+	CHECK(CRASH_Get() && (CRASH_Get()->TasksCount == 0) && CRASH_IsPending());
+
+	// More tasks than saved, with a valid CRC
+	record.TasksCount = CRASH_TASKS + 1;
+	record.TasksCrc = CRASHTasksCrc(&record);
+	PageErase();
+	PageWrite(&record, 0, sizeof(record));
+	CRASH_Init();
+	CHECK(CRASH_Get() && (CRASH_Get()->TasksCount == 0));
+
+	// Another layout version
+	Synthetic(&record);
+	record.Version = CRASH_VERSION + 1;
+	record.Crc = CRASHCoreCrc(&record);
+	PageErase();
+	PageWrite(&record, 0, sizeof(record));
+	CRASH_Init();
+	CHECK(CRASH_Get() == NULL);
+}
+
+/*
+ * CRASH_Capture saves the running task and every registered task, the dump parses back
+ */
+static void TestCapture(void) {
+	const CRASH_RECORD* record;
+	uint8_t report[CRASH_REPORT_SIZE];
+	RamInit();
+	for (int i = 0; i < TASKS; i++) {
+		EMU_TCB* tcb = (EMU_TCB*)(RAM + EmuTasks[i].Tcb);
+		tcb->TopOfStack = SRAM_BASE + EmuTasks[i].Sp;
+		for (int w = 0; (w < CRASH_TASK_WORDS) && (EmuTasks[i].Sp + w * 4 < RAM_KB * 1024); w++)
+			((uint32_t*)(RAM + EmuTasks[i].Sp))[w] = 0xC0DE0000UL + (uint32_t)(i << 8) + (uint32_t)w;
+		// Not in SRAM: skipped
+		if (i == 1) CRASH_AddTask((void*)(uintptr_t)0x00010000UL);
+		CRASH_AddTask(tcb);
+	}
+
+	PageErase();
+	CRASH_Init();
+	Current = (TaskHandle_t)(RAM + EmuTasks[1].Tcb);
+	Ticks = 98765;
+	TraceHistory = "Radio timeout\n";
+	EmuScb.CFSR = 0x00010000UL;
+	CRASH_Capture(CrashErrorCode, 0x1234, 0);
+	CHECK(!bFlashOpen);
+	CRASH_Init();
+	record = CRASH_Get();
+	CHECK(record != NULL);
+	if (!record) return;
+	CHECK((record->Cause == CrashErrorCode) && (record->Code == 0x1234) && (record->Ticks == 98765));
+	CHECK((record->Cfsr == 0x00010000UL) && (strcmp(record->Task, "LW_EVENT") == 0));
+	CHECK(strcmp(record->Trace, "Radio timeout\n") == 0);
+	CHECK(record->TasksCount == TASKS);
+	for (int i = 0; i < TASKS; i++) {
+		const CRASH_TASK* task = &record->Tasks[i];
+		CHECK(task->Tcb == SRAM_BASE + EmuTasks[i].Tcb);
+		CHECK(task->Sp == SRAM_BASE + EmuTasks[i].Sp);
+		CHECK(task->StackBase == SRAM_BASE + EmuTasks[i].StackBase);
+		CHECK((task->HighWater == EmuTasks[i].HighWater) && (task->Priority == EmuTasks[i].Priority));
+		CHECK(task->Running == (i == 1));
+		CHECK(strncmp(task->Name, EmuTasks[i].Name, CRASH_NAME_SIZE - 1) == 0);
+		CHECK(task->Name[CRASH_NAME_SIZE - 1] == 0);
+		// The words after the end of SRAM read 0
+		for (int w = 0; w < CRASH_TASK_WORDS; w++)
+			CHECK(task->Stack[w] == ((EmuTasks[i].Sp + w * 4 < RAM_KB * 1024) ?
+					0xC0DE0000UL + (uint32_t)(i << 8) + (uint32_t)w : 0));
+	}
+
+	// The first crash is kept until it is reported
+	CRASH_Capture(CrashStackOverflow, 0, 0);
+	CRASH_Init();
+	CHECK(CRASH_Get() && (CRASH_Get()->Cause == CrashErrorCode));
+
+	// Not sent: still pending
+	bSendOk = false;
+	CHECK(!CRASH_Send() && CRASH_IsPending());
+	bSendOk = true;
+	CHECK(CRASH_Send() && !CRASH_IsPending());
+	CHECK((SentPort == SKT_DEVICE_SERVICE_PORT) && (SentType == MSG_SKT_DEV_CRASH));
+	CHECK((SentLen == CRASH_REPORT_SIZE) && (CRASH_Encode(report, sizeof(report)) == CRASH_REPORT_SIZE));
+	CHECK(memcmp(SentFrame, report, sizeof(report)) == 0);
+	CRASH_Init();
+	CHECK(CRASH_Get() && !CRASH_IsPending());
+
+	// Reported: the next crash replaces it, before the scheduler start
+	SchedulerState = taskSCHEDULER_NOT_STARTED;
+	CRASH_Capture(CrashAssert, __LINE__, 0x0001F000UL);
+	CRASH_Init();
+	CHECK(CRASH_Get() && (CRASH_Get()->Cause == CrashAssert) && CRASH_IsPending());
+	CHECK(CRASH_Get() && (strcmp(CRASH_Get()->Task, "MAIN") == 0) && (CRASH_Get()->Tasks[1].Running == 0));
+	CHECK(Suspended == 0);
+
+	CRASH_Clear();
+	CHECK(CRASH_Get() == NULL);
+	CRASH_Init();
+	CHECK(CRASH_Get() == NULL);
+}
+
+int main(void) {
+	TestBlank();
+	TestParse();
+	TestDamaged();
+	TestCapture();
+	return TEST_END();
+}
@@ -0,0 +1,78 @@
+/*******************************************************************
+**                                                                **
+** CRC16 unit tests                                               **
+**                                                                **
+*******************************************************************/
+/*
+ * Known answers of the CRC16 catalogue, and equivalence of the table driven CCITT variants
+ * (built with CRC16_NIBBLE_TABLE or CRC16_SLICE_BY_4) and of the streaming API with the
+ * previous bitwise implementation, on every length and alignment of a random buffer.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "crc16.h"
+#include "test.h"
+
+/** @cond */
+#define TEST_SIZE	1024
+/** @endcond */
+
+/*
+ * Previous implementation, a bit at a time
+ */
+static unsigned short CRC16Reference(const unsigned char* buffer, unsigned int length, unsigned short crc, unsigned short polynom) {
+	while (length--) {
+		crc ^= ((unsigned short)*buffer++) << 8;
+		for (int i = 0; i < 8; i++)
+			crc = (crc & 0x8000) ? (crc << 1) ^ polynom : crc << 1;
+	}
+	return crc;
+}
+
+int main(void) {
+	static const unsigned char check[] = "123456789";
+	unsigned char buffer[TEST_SIZE];
+
+	// Catalogue check values of "123456789"
+	CHECK(CRC16_CalculateRange(check, 9, 0xFFFF) == 0x29B1);		// CRC-16/CCITT-FALSE
+	CHECK(CRC16_CalculateRange(check, 9, 0x0000) == 0x31C3);		// CRC-16/XMODEM
+	CHECK(CRC16_CalculateRange(check, 9, 0x1D0F) == 0xE5CC);		// CRC-16/AUG-CCITT
+	CHECK(CRC16_CalculateRangePolynomial(check, 9, 0x0000, CRC16_ANSI) == 0xFEE8);	// CRC-16/UMTS
+	CHECK(CRC16_Final(CRC16_Update(CRC16_Init(), check, 9)) == 0x29B1);
+	CHECK(CRC16_CalculateRange(check, 0, 0x1234) == 0x1234);
+
+	srand(39);
+	for (int i = 0; i < TEST_SIZE; i++) buffer[i] = (unsigned char)rand();
+
+	// Every length and alignment against the bitwise computation
+	for (int offset = 0; offset < 8; offset++) {
+		for (int length = 0; length <= TEST_SIZE - offset; length++) {
+			unsigned short seed = (unsigned short)rand();
+			CHECK(CRC16_CalculateRange(buffer + offset, length, seed) ==
+					CRC16Reference(buffer + offset, length, seed, CRC16_CCITT));
+		}
+	}
+	for (int length = 0; length <= 64; length++) {
+		unsigned short crc = 0;
+		for (int i = 0; i < length; i++) crc = CRC16_Calculate(buffer[i], crc);
+		CHECK(crc == CRC16Reference(buffer, length, 0, CRC16_CCITT));
+		CHECK(CRC16_CalculateRangePolynomial(buffer, length, 0xFFFF, CRC16_ANSI) ==
+				CRC16Reference(buffer, length, 0xFFFF, CRC16_ANSI));
+	}
+
+	// The streamed CRC of any split is the CRC of the whole buffer
+	unsigned short whole = CRC16Reference(buffer, TEST_SIZE, CRC16_CCITT_INIT, CRC16_CCITT);
+	for (int run = 0; run < 10000; run++) {
+		unsigned short crc = CRC16_Init();
+		int done = 0;
+		while (done < TEST_SIZE) {
+			int length = rand() % 41;
+			if (length > TEST_SIZE - done) length = TEST_SIZE - done;
+			crc = CRC16_Update(crc, buffer + done, length);
+			done += length;
+		}
+		CHECK(CRC16_Final(crc) == whole);
+	}
+	return TEST_END();
+}
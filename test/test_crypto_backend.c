@@ -0,0 +1,337 @@
+/*******************************************************************
+**                                                                **
+** LoRaMAC crypto backends unit tests                             **
+**                                                                **
+*******************************************************************/
+/*
+ * Known answers of the AES-128 primitives (FIPS-197, SP 800-38A, RFC 4493 CMAC examples), then
+ * the LoRaMacCrypto.c functions compared with the aes.c/cmac.c sequences they used before the
+ * backends, on random keys, addresses, counters and frames of every size.
+ * Built with CRYPTO_BACKEND set to CRYPTO_BACKEND_BOARD, LoRaWAN/crypto-board.c runs on an
+ * emulated CRYPTO unit, which also checks the clock is enabled during each operation and only
+ * toggled by the outermost one.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "aes.h"
+#include "cmac.h"
+#include "crypto-backend.h"
+#include "LoRaMacCrypto.h"
+#include "test.h"
+#if (CRYPTO_BACKEND == CRYPTO_BACKEND_BOARD)
+#include "em_cmu.h"
+#include "em_crypto.h"
+#endif
+
+/** @cond */
+static const uint8_t RfcKey[16] = {
+	0x2b, 0x7e, 0x15, 0x16, 0x28, 0xae, 0xd2, 0xa6, 0xab, 0xf7, 0x15, 0x88, 0x09, 0xcf, 0x4f, 0x3c
+};
+static const uint8_t RfcMessage[64] = {
+	0x6b, 0xc1, 0xbe, 0xe2, 0x2e, 0x40, 0x9f, 0x96, 0xe9, 0x3d, 0x7e, 0x11, 0x73, 0x93, 0x17, 0x2a,
+	0xae, 0x2d, 0x8a, 0x57, 0x1e, 0x03, 0xac, 0x9c, 0x9e, 0xb7, 0x6f, 0xac, 0x45, 0xaf, 0x8e, 0x51,
+	0x30, 0xc8, 0x1c, 0x46, 0xa3, 0x5c, 0xe4, 0x11, 0xe5, 0xfb, 0xc1, 0x19, 0x1a, 0x0a, 0x52, 0xef,
+	0xf6, 0x9f, 0x24, 0x45, 0xdf, 0x4f, 0x9b, 0x17, 0xad, 0x2b, 0x41, 0x7b, 0xe6, 0x6c, 0x37, 0x10
+};
+// RFC 4493 section 4, examples 1 to 4
+static const struct {
+	uint16_t	Size;
+	uint8_t		Mac[16];
+} RfcCmac[] = {
+	{ 0,	{ 0xbb, 0x1d, 0x69, 0x29, 0xe9, 0x59, 0x37, 0x28, 0x7f, 0xa3, 0x7d, 0x12, 0x9b, 0x75, 0x67, 0x46 } },
+	{ 16,	{ 0x07, 0x0a, 0x16, 0xb4, 0x6b, 0x4d, 0x41, 0x44, 0xf7, 0x9b, 0xdd, 0x9d, 0xd0, 0x4a, 0x28, 0x7c } },
+	{ 40,	{ 0xdf, 0xa6, 0x67, 0x47, 0xde, 0x9a, 0xe6, 0x30, 0x30, 0xca, 0x32, 0x61, 0x14, 0x97, 0xc8, 0x27 } },
+	{ 64,	{ 0x51, 0xf0, 0xbe, 0xbf, 0x7e, 0x3b, 0x9d, 0x92, 0xfc, 0x49, 0x74, 0x17, 0x79, 0x36, 0x3c, 0xfe } },
+};
+// SP 800-38A F.1.1, ECB-AES128 of RfcMessage
+static const uint8_t EcbCipher[64] = {
+	0x3a, 0xd7, 0x7b, 0xb4, 0x0d, 0x7a, 0x36, 0x60, 0xa8, 0x9e, 0xca, 0xf3, 0x24, 0x66, 0xef, 0x97,
+	0xf5, 0xd3, 0xd5, 0x85, 0x03, 0xb9, 0x69, 0x9d, 0xe7, 0x85, 0x89, 0x5a, 0x96, 0xfd, 0xba, 0xaf,
+	0x43, 0xb1, 0xcd, 0x7f, 0x59, 0x8e, 0xce, 0x23, 0x88, 0x1b, 0x00, 0xe3, 0xed, 0x03, 0x06, 0x88,
+	0x7b, 0x0c, 0x78, 0x5e, 0x27, 0xe8, 0xad, 0x3f, 0x82, 0x23, 0x20, 0x71, 0x04, 0x72, 0x5d, 0xd4
+};
+// SP 800-38A F.5.1, CTR-AES128 first block
+static const uint8_t CtrCounter[16] = {
+	0xf0, 0xf1, 0xf2, 0xf3, 0xf4, 0xf5, 0xf6, 0xf7, 0xf8, 0xf9, 0xfa, 0xfb, 0xfc, 0xfd, 0xfe, 0xff
+};
+static const uint8_t CtrCipher[16] = {
+	0x87, 0x4d, 0x61, 0x91, 0xb6, 0x20, 0xe3, 0x26, 0x1b, 0xef, 0x68, 0x64, 0x99, 0x0d, 0xb6, 0xce
+};
+/** @endcond */
+
+void memcpy1(uint8_t *dst, const uint8_t *src, uint16_t size) { memcpy(dst, src, size); }
+void memset1(uint8_t *dst, uint8_t value, uint16_t size) { memset(dst, value, size); }
+
+static void Random(uint8_t* buffer, int size) {
+	while (size-- > 0) *buffer++ = (uint8_t)rand();
+}
+
+static void AesBlock(const uint8_t* key, const uint8_t* in, uint8_t* out) {
+	aes_context ctx;
+
+	memset(&ctx, 0, sizeof(ctx));
+	aes_set_key(key, 16, &ctx);
+	aes_encrypt(in, out, &ctx);
+}
+
+#if (CRYPTO_BACKEND == CRYPTO_BACKEND_BOARD)
+/*
+ * Emulated CRYPTO unit and clock
+ */
+CMU_TypeDef EmuCmu;
+CRYPTO_TypeDef EmuCrypto;
+static unsigned ClockToggles;
+static bool Preempt;
+
+void CMU_ClockEnable(CMU_Clock_TypeDef clock, bool enable) {
+	CHECK(clock == cmuClock_CRYPTO);
+	CHECK(((EmuCmu.HFBUSCLKEN0 & CMU_HFBUSCLKEN0_CRYPTO) != 0) != enable);
+	if (enable) EmuCmu.HFBUSCLKEN0 |= CMU_HFBUSCLKEN0_CRYPTO;
+	else EmuCmu.HFBUSCLKEN0 &= ~CMU_HFBUSCLKEN0_CRYPTO;
+	ClockToggles++;
+}
+
+static void CryptoRun(unsigned int len) {
+	CHECK(EmuCmu.HFBUSCLKEN0 & CMU_HFBUSCLKEN0_CRYPTO);
+	CHECK((len % 16) == 0);
+	if (Preempt) {
+		// Another task runs an operation in the middle of this one
+		uint8_t out[64];
+
+		Preempt = false;
+		CryptoBackendAesEncrypt(RfcKey, RfcMessage, sizeof(RfcMessage), out);
+		CHECK(memcmp(out, EcbCipher, sizeof(out)) == 0);
+		CHECK(EmuCmu.HFBUSCLKEN0 & CMU_HFBUSCLKEN0_CRYPTO);
+	}
+}
+
+void CRYPTO_AES_ECB128(CRYPTO_TypeDef *crypto, uint8_t *out, const uint8_t *in, unsigned int len,
+		const uint8_t *key, bool encrypt) {
+	CHECK(encrypt);
+	CryptoRun(len);
+	for (unsigned int i = 0; i < len; i += 16) AesBlock(key, in + i, out + i);
+}
+
+void CRYPTO_AES_CBC128(CRYPTO_TypeDef *crypto, uint8_t *out, const uint8_t *in, unsigned int len,
+		const uint8_t *key, const uint8_t *iv, bool encrypt) {
+	uint8_t x[16];
+
+	CHECK(encrypt);
+	CryptoRun(len);
+	memcpy(x, iv, 16);
+	for (unsigned int i = 0; i < len; i += 16) {
+		for (int j = 0; j < 16; j++) x[j] ^= in[i + j];
+		AesBlock(key, x, x);
+		memcpy(out + i, x, 16);
+	}
+}
+
+void CRYPTO_AES_CTR128(CRYPTO_TypeDef *crypto, uint8_t *out, const uint8_t *in, unsigned int len,
+		const uint8_t *key, uint8_t *ctr, CRYPTO_AES_CtrFuncPtr_TypeDef ctrFunc) {
+	uint8_t s[16];
+
+	CHECK(ctrFunc == NULL);
+	CryptoRun(len);
+	for (unsigned int i = 0; i < len; i += 16) {
+		AesBlock(key, ctr, s);
+		for (int j = 0; j < 16; j++) out[i + j] = in[i + j] ^ s[j];
+		// The hardware increments the last 32 bits of the counter
+		for (int j = 15; (j >= 12) && (++ctr[j] == 0); j--);
+	}
+}
+#endif
+
+/*
+ * LoRaMacCrypto.c before the backends, on aes.c and cmac.c
+ */
+static void PrevComputeMic(const uint8_t *buffer, uint16_t size, const uint8_t *key, uint32_t address, uint8_t dir, uint32_t sequenceCounter, uint32_t *mic) {
+	uint8_t b0[16] = { 0x49 }, m[16];
+	AES_CMAC_CTX ctx;
+
+	b0[5] = dir;
+	memcpy(&b0[6], &address, 4);
+	memcpy(&b0[10], &sequenceCounter, 4);
+	b0[15] = size & 0xFF;
+	AES_CMAC_Init(&ctx);
+	AES_CMAC_SetKey(&ctx, key);
+	AES_CMAC_Update(&ctx, b0, 16);
+	AES_CMAC_Update(&ctx, buffer, size & 0xFF);
+	AES_CMAC_Final(m, &ctx);
+	*mic = (uint32_t)m[3] << 24 | (uint32_t)m[2] << 16 | (uint32_t)m[1] << 8 | (uint32_t)m[0];
+}
+
+static void PrevPayloadEncrypt(const uint8_t *buffer, uint16_t size, const uint8_t *key, uint32_t address, uint8_t dir, uint32_t sequenceCounter, uint8_t *encBuffer) {
+	uint8_t a[16] = { 0x01 }, s[16];
+	uint16_t ctr = 1, index = 0;
+
+	a[5] = dir;
+	memcpy(&a[6], &address, 4);
+	memcpy(&a[10], &sequenceCounter, 4);
+	while (size > 0) {
+		uint16_t n = (size >= 16) ? 16 : size;
+
+		a[15] = ctr++ & 0xFF;
+		AesBlock(key, a, s);
+		for (int i = 0; i < n; i++) encBuffer[index + i] = buffer[index + i] ^ s[i];
+		size -= n;
+		index += n;
+	}
+}
+
+static void PrevJoinComputeMic(const uint8_t *buffer, uint16_t size, const uint8_t *key, uint32_t *mic) {
+	uint8_t m[16];
+	AES_CMAC_CTX ctx;
+
+	AES_CMAC_Init(&ctx);
+	AES_CMAC_SetKey(&ctx, key);
+	AES_CMAC_Update(&ctx, buffer, size & 0xFF);
+	AES_CMAC_Final(m, &ctx);
+	*mic = (uint32_t)m[3] << 24 | (uint32_t)m[2] << 16 | (uint32_t)m[1] << 8 | (uint32_t)m[0];
+}
+
+static void PrevJoinComputeSKeys(const uint8_t *key, const uint8_t *appNonce, uint16_t devNonce, uint8_t *nwkSKey, uint8_t *appSKey) {
+	uint8_t nonce[16];
+
+	memset(nonce, 0, sizeof(nonce));
+	nonce[0] = 0x01;
+	memcpy(nonce + 1, appNonce, 6);
+	memcpy(nonce + 7, &devNonce, 2);
+	AesBlock(key, nonce, nwkSKey);
+	nonce[0] = 0x02;
+	AesBlock(key, nonce, appSKey);
+}
+
+/*
+ * Tests
+ */
+static void TestKnownAnswers(void) {
+	static const uint8_t fipsKey[16] = {
+		0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0a, 0x0b, 0x0c, 0x0d, 0x0e, 0x0f
+	};
+	static const uint8_t fipsPlain[16] = {
+		0x00, 0x11, 0x22, 0x33, 0x44, 0x55, 0x66, 0x77, 0x88, 0x99, 0xaa, 0xbb, 0xcc, 0xdd, 0xee, 0xff
+	};
+	static const uint8_t fipsCipher[16] = {
+		0x69, 0xc4, 0xe0, 0xd8, 0x6a, 0x7b, 0x04, 0x30, 0xd8, 0xcd, 0xb7, 0x80, 0x70, 0xb4, 0xc5, 0x5a
+	};
+	uint8_t out[64], mac[16];
+
+	// FIPS-197 C.1, SP 800-38A ECB, in place
+	CryptoBackendAesEncrypt(fipsKey, fipsPlain, 16, out);
+	CHECK(memcmp(out, fipsCipher, 16) == 0);
+	CryptoBackendAesEncrypt(RfcKey, RfcMessage, 64, out);
+	CHECK(memcmp(out, EcbCipher, 64) == 0);
+	memcpy(out, RfcMessage, 64);
+	CryptoBackendAesEncrypt(RfcKey, out, 64, out);
+	CHECK(memcmp(out, EcbCipher, 64) == 0);
+
+	// SP 800-38A CTR first block, then partial blocks
+	CryptoBackendAesCtr(RfcKey, CtrCounter, RfcMessage, 16, out);
+	CHECK(memcmp(out, CtrCipher, 16) == 0);
+	for (int size = 1; size < 16; size++) {
+		memset(out, 0, sizeof(out));
+		CryptoBackendAesCtr(RfcKey, CtrCounter, RfcMessage, size, out);
+		CHECK(memcmp(out, CtrCipher, size) == 0);
+		CHECK(out[size] == 0);
+	}
+
+	// RFC 4493 examples, with the message whole and split in header and buffer
+	for (int i = 0; i < sizeof(RfcCmac) / sizeof(RfcCmac[0]); i++) {
+		uint16_t size = RfcCmac[i].Size;
+
+		CryptoBackendCmac(RfcKey, NULL, 0, RfcMessage, size, mac);
+		CHECK(memcmp(mac, RfcCmac[i].Mac, 16) == 0);
+		for (uint8_t header = 1; (header <= CRYPTO_BLOCK_SIZE) && (header <= size); header++) {
+			CryptoBackendCmac(RfcKey, RfcMessage, header, RfcMessage + header, size - header, mac);
+			CHECK(memcmp(mac, RfcCmac[i].Mac, 16) == 0);
+		}
+	}
+}
+
+static void TestPrevious(void) {
+	uint8_t key[16], frame[256], enc[256], prev[256], nonce[6], nwk[16], app[16], prevNwk[16], prevApp[16];
+	uint32_t address, counter, mic, prevMic;
+	uint16_t devNonce;
+
+	for (int run = 0; run < 20; run++) {
+		Random(key, sizeof(key));
+		Random((uint8_t*)&address, sizeof(address));
+		Random((uint8_t*)&counter, sizeof(counter));
+		for (int size = 0; size <= 255; size++) {
+			uint8_t dir = size & 1;
+
+			Random(frame, size);
+			LoRaMacComputeMic(frame, size, key, address, dir, counter, &mic);
+			PrevComputeMic(frame, size, key, address, dir, counter, &prevMic);
+			CHECK(mic == prevMic);
+			LoRaMacPayloadEncrypt(frame, size, key, address, dir, counter, enc);
+			PrevPayloadEncrypt(frame, size, key, address, dir, counter, prev);
+			CHECK(memcmp(enc, prev, size) == 0);
+			LoRaMacPayloadDecrypt(enc, size, key, address, dir, counter, prev);
+			CHECK(memcmp(frame, prev, size) == 0);
+			LoRaMacJoinComputeMic(frame, size, key, &mic);
+			PrevJoinComputeMic(frame, size, key, &prevMic);
+			CHECK(mic == prevMic);
+		}
+
+		// Join accept without and with CFList
+		Random(frame, 32);
+		LoRaMacJoinDecrypt(frame, 12, key, enc);
+		AesBlock(key, frame, prev);
+		CHECK(memcmp(enc, prev, 16) == 0);
+		LoRaMacJoinDecrypt(frame, 28, key, enc);
+		AesBlock(key, frame + 16, prev + 16);
+		CHECK(memcmp(enc, prev, 32) == 0);
+
+		Random(nonce, sizeof(nonce));
+		Random((uint8_t*)&devNonce, sizeof(devNonce));
+		LoRaMacJoinComputeSKeys(key, nonce, devNonce, nwk, app);
+		PrevJoinComputeSKeys(key, nonce, devNonce, prevNwk, prevApp);
+		CHECK(memcmp(nwk, prevNwk, 16) == 0);
+		CHECK(memcmp(app, prevApp, 16) == 0);
+	}
+}
+
+#if (CRYPTO_BACKEND == CRYPTO_BACKEND_BOARD)
+static void TestClock(void) {
+	uint8_t out[64], mac[16];
+
+	// Enabled and disabled once per operation
+	ClockToggles = 0;
+	CryptoBackendCmac(RfcKey, NULL, 0, RfcMessage, 40, mac);
+	CHECK(ClockToggles == 2);
+	CHECK((EmuCmu.HFBUSCLKEN0 & CMU_HFBUSCLKEN0_CRYPTO) == 0);
+
+	// Nested operation, the clock stays on until the outer one ends
+	ClockToggles = 0;
+	Preempt = true;
+	CryptoBackendCmac(RfcKey, NULL, 0, RfcMessage, 64, mac);
+	CHECK(Preempt == false);
+	CHECK(memcmp(mac, RfcCmac[3].Mac, 16) == 0);
+	CHECK(ClockToggles == 2);
+	CHECK((EmuCmu.HFBUSCLKEN0 & CMU_HFBUSCLKEN0_CRYPTO) == 0);
+	Preempt = true;
+	CryptoBackendAesCtr(RfcKey, CtrCounter, RfcMessage, 16, out);
+	CHECK(memcmp(out, CtrCipher, 16) == 0);
+	CHECK((EmuCmu.HFBUSCLKEN0 & CMU_HFBUSCLKEN0_CRYPTO) == 0);
+
+	// Clock enabled by another user is left alone
+	EmuCmu.HFBUSCLKEN0 |= CMU_HFBUSCLKEN0_CRYPTO;
+	ClockToggles = 0;
+	CryptoBackendAesEncrypt(RfcKey, RfcMessage, 64, out);
+	CHECK(memcmp(out, EcbCipher, 64) == 0);
+	CHECK(ClockToggles == 0);
+	CHECK(EmuCmu.HFBUSCLKEN0 & CMU_HFBUSCLKEN0_CRYPTO);
+	EmuCmu.HFBUSCLKEN0 = 0;
+}
+#endif
+
+int main(void) {
+	TestKnownAnswers();
+	TestPrevious();
+#if (CRYPTO_BACKEND == CRYPTO_BACKEND_BOARD)
+	TestClock();
+#endif
+	return TEST_END();
+}
@@ -0,0 +1,210 @@
+/*******************************************************************
+**                                                                **
+** datetime.c host tests                                          **
+**                                                                **
+*******************************************************************/
+/*
+ * Compares the constant time conversions and the DST cache with the
+ * previous implementation, kept below as the reference, for every hour
+ * from 2000 to 2106. Also checks that the DST cache gives the same
+ * results when several threads use different specifications at once.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include "datetime.h"
+#include "test.h"
+
+/*
+ * Reference: previous implementation
+ */
+static const unsigned short refNbDays[] = {31, 59, 90, 120, 151, 181, 212, 243, 273, 304, 334, 365 };
+#define refDaysinyear(m,y) ((((m) > 0) && ((m) < 13)) ? (refNbDays[(m)-1] + (((((y)%4) == 0) && ((m) > 1)) ? 1 : 0)) : 0)
+
+static void RefFromSeconds(const unsigned long seconds, DATETIME_STRUCT* dt) {
+	memset(dt,0,sizeof(DATETIME_STRUCT));
+	unsigned long N = seconds / 86400UL;
+	if (N) {
+		dt->dayOfWeek = ((N % 7) + 5) % 7;
+		unsigned short year = 0;
+		while (N > refDaysinyear(12,year)) {
+			N -= refDaysinyear(12,year);
+			year++;
+		}
+		dt->month = 0;
+		while ((++dt->month < 12) && (N > refDaysinyear(dt->month,year))) ;
+		N -= refDaysinyear(dt->month-1,year);
+		dt->day = (unsigned char)N;
+		dt->year = year + 2000;
+	} else {
+		dt->dayOfWeek = DateTimeFriday;
+		dt->month = 12;
+		dt->day = 31;
+		dt->year = 1999;
+	}
+	N = seconds % 86400UL;
+	dt->hour = (unsigned char)(N / 3600UL);
+	N %= 3600UL;
+	dt->min = (unsigned char)(N / 60UL);
+	dt->sec = (unsigned char)(N % 60UL);
+}
+
+static unsigned long RefSecondsToFatTime(unsigned long seconds) {
+	unsigned short N = seconds / 86400;
+	unsigned short year = 0;
+	while (N > (((year % 4) == 0) ? 366 : 365)) {
+		N -= (((year % 4) == 0) ? 366 : 365);
+		year++;
+	}
+	unsigned char month = 0;
+	while ((++month < 12) && (N > refDaysinyear(month,year))) ;
+	N -= refDaysinyear(month-1,year);
+	short day = (N) ? N : 1;
+	year += 2000;
+	short hour = (seconds % 86400) / 3600;
+	short min = (seconds % 86400) % 3600 / 60;
+	short sec = (seconds % 86400) % 3600 % 60;
+	return ((unsigned long)(year - 1980) << 25) | ((unsigned long)month << 21) | ((unsigned long)day << 16)
+		| ((unsigned long)hour << 11) | ((unsigned long)min << 5) | ((unsigned long)sec >> 1);
+}
+
+static unsigned char* RefGetDSTData(unsigned char* DSTSpecs, unsigned char* month,
+		unsigned char* week, unsigned char* dow, unsigned char *time) {
+	if (!DSTSpecs) return 0;
+	if (*(DSTSpecs++) != 'M') return 0;
+	*month = *week = *dow = *time = 0;
+	while ((*DSTSpecs >= '0') && (*DSTSpecs <= '9')) *month = (*month * 10) + *(DSTSpecs++) - '0';
+	if (*(DSTSpecs++) != '.') return 0;
+	while ((*DSTSpecs >= '0') && (*DSTSpecs <= '9')) *week = (*week * 10) + *(DSTSpecs++) - '0';
+	if (*(DSTSpecs++) != '.') return 0;
+	while ((*DSTSpecs >= '0') && (*DSTSpecs <= '9')) *dow = (*dow * 10) + *(DSTSpecs++) - '0';
+	if (*(DSTSpecs) == '/') {
+		DSTSpecs++;
+		while ((*DSTSpecs >= '0') && (*DSTSpecs <= '9')) *time = (*time * 10) + *(DSTSpecs++) - '0';
+	}
+	while (*DSTSpecs && (*DSTSpecs != ',')) DSTSpecs++;
+	return (*DSTSpecs) ? ++DSTSpecs : DSTSpecs;
+}
+
+static int RefIsDSTExt(DATETIME_STRUCT *dt, unsigned char* DSTSpecs, unsigned char* endMonth) {
+	unsigned char m1, w1, d1, t1;
+	unsigned char m2, w2, d2, t2;
+	unsigned char* p = (unsigned char*)strchr((char*)DSTSpecs,',');
+	if (*p) p++;
+	p = RefGetDSTData(p,&m1,&w1,&d1,&t1);
+	if (p) p = RefGetDSTData(p,&m2,&w2,&d2,&t2);
+	if (!p) return 0;
+	*endMonth = m2;
+	if ((dt->month < m1) || (dt->month > (m2+1))) return 0;
+	if ((dt->month > m1) && (dt->month < m2)) return 1;
+	unsigned char day = 1;
+	unsigned char dow = DateTimeDayOfWeek(dt->year,dt->month,day);
+	while (dow != ((dt->month == m1) ? d1 : d2)) { day++; dow = (dow + 1) % 7; }
+	day += (7 * (((dt->month == m1) ? w1 : w2)-1));
+	while (day > DateTimeDaysInMonth(dt->month,dt->year)) day -= 7;
+	if (dt->day < day) return (dt->month == m1) ? 0 : 1;
+	if (dt->day > day) return (dt->month == m1) ? 1 : 0;
+	if (dt->hour < ((dt->month == m1) ? t1 : t2)) return (dt->month == m1) ? 0 : 1;
+	return (dt->month == m1) ? 1 : 0;
+}
+
+/*
+ * Tests
+ */
+#define LAST_HOUR_2106	(106UL * 36525UL * 864UL)	// Start of 2106
+
+static unsigned char* const Specs[] = {
+	EUROPEAN_DST,
+	(unsigned char*)"America/New_York;EST5EDT,M3.2.0/2,M11.1.0/2",
+	(unsigned char*)"Australia/Sydney;AEST-10AEDT,M10.1.0/2,M4.1.0/3",
+};
+
+static void TestConversions(void) {
+	DATETIME_STRUCT dt, ref;
+	for (unsigned long s = 0; s < LAST_HOUR_2106; s += 3599) {
+		DateTimeFromSeconds(s, &dt);
+		RefFromSeconds(s, &ref);
+		CHECK(memcmp(&dt, &ref, sizeof(dt)) == 0);
+		if (s >= 86400UL) {
+			CHECK(DateTimeGetSeconds(&dt) == s);
+			CHECK(DateTimeSecondsToFatTime(s) == RefSecondsToFatTime(s));
+		}
+	}
+	// Batch conversion of records a few minutes apart
+	static unsigned long seconds[4096];
+	static DATETIME_STRUCT batch[4096];
+	for (int i = 0; i < 4096; i++) seconds[i] = 500000000UL + (unsigned long)i * 337;
+	DateTimeFromSecondsBatch(seconds, batch, 4096);
+	for (int i = 0; i < 4096; i++) {
+		DateTimeFromSeconds(seconds[i], &dt);
+		CHECK(memcmp(&dt, &batch[i], sizeof(dt)) == 0);
+	}
+}
+
+static void TestDST(void) {
+	DATETIME_STRUCT dt;
+	unsigned char endMonth = 0;
+	for (int k = 0; k < 2; k++) {
+		for (unsigned long s = 86400UL; s < LAST_HOUR_2106; s += 3600) {
+			DateTimeFromSeconds(s, &dt);
+			int ref = RefIsDSTExt(&dt, Specs[k], &endMonth);
+			// The previous implementation reported DST in the month after the end transition
+			if (dt.month == (endMonth + 1)) CHECK(DateTimeIsDSTExt(&dt, Specs[k]) == 0);
+			else CHECK(DateTimeIsDSTExt(&dt, Specs[k]) == ref);
+		}
+	}
+	// DST period over new year
+	DateTimeFromSeconds(DateTimeSecondsFromISO8601String((unsigned char*)"2020-01-15T12:00:00"), &dt);
+	CHECK(DateTimeIsDSTExt(&dt, Specs[2]) == 1);
+	DateTimeFromSeconds(DateTimeSecondsFromISO8601String((unsigned char*)"2020-06-15T12:00:00"), &dt);
+	CHECK(DateTimeIsDSTExt(&dt, Specs[2]) == 0);
+	DateTimeFromSeconds(DateTimeSecondsFromISO8601String((unsigned char*)"2020-12-15T12:00:00"), &dt);
+	CHECK(DateTimeIsDSTExt(&dt, Specs[2]) == 1);
+}
+
+/*
+ * Threads alternating specifications and years share the DST cache
+ */
+#define THREADS		4
+static char Expected[3][2][366 * 24];	// Specification, year 2021 or 2022, hour of year
+static unsigned long ThreadFailures[THREADS];
+
+static void* DSTThread(void* arg) {
+	int id = (int)(long)arg;
+	DATETIME_STRUCT dt;
+	unsigned long start[2] = { 662774400UL, 694310400UL };	// 2021 and 2022, January 1st
+	for (int loop = 0; loop < 20; loop++) {
+		for (int h = 0; h < 365 * 24; h++) {
+			int k = (id + h) % 3;
+			int y = (id + h + loop) & 1;
+			DateTimeFromSeconds(start[y] + (unsigned long)h * 3600, &dt);
+			if (DateTimeIsDSTExt(&dt, Specs[k]) != Expected[k][y][h]) ThreadFailures[id]++;
+		}
+	}
+	return NULL;
+}
+
+static void TestDSTThreads(void) {
+	pthread_t threads[THREADS];
+	DATETIME_STRUCT dt;
+	unsigned long start[2] = { 662774400UL, 694310400UL };
+	for (int k = 0; k < 3; k++)
+		for (int y = 0; y < 2; y++)
+			for (int h = 0; h < 365 * 24; h++) {
+				DateTimeFromSeconds(start[y] + (unsigned long)h * 3600, &dt);
+				Expected[k][y][h] = (char)DateTimeIsDSTExt(&dt, Specs[k]);
+			}
+	for (long i = 0; i < THREADS; i++) pthread_create(&threads[i], NULL, DSTThread, (void*)i);
+	for (int i = 0; i < THREADS; i++) {
+		pthread_join(threads[i], NULL);
+		CHECK(ThreadFailures[i] == 0);
+	}
+}
+
+int main(void) {
+	TestConversions();
+	TestDST();
+	TestDSTThreads();
+	return TEST_END();
+}
@@ -0,0 +1,316 @@
+/*******************************************************************
+**                                                                **
+** Energy mode governor host tests                                **
+**                                                                **
+*******************************************************************/
+/*
+ * Checks eEFMEnergySelectMode against its specification on both sides of the EM2 and EM3
+ * deadline thresholds, and the driver restrictions of vEFMEnergyRequire, vEFMEnergyRelease
+ * and the counted vEFMEnergyEnableLowPowerMode against a model on random sequences. Then
+ * runs vEFMEnergyEnter on an emulated ULFRCO 8% fast: the EM1 and EM2 sleeps calibrate the
+ * ULFRCO against the time base, the EM3 sleeps must end before the next deadline and move
+ * the stopped time base forward by the time really slept, also over many short sleeps
+ * (the conversion remainder is carried) and after a bad calibration period.
+ */
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include "system.h"
+#include "timebase.h"
+#include "EFMEnergy.h"
+#include "em_cmu.h"
+#include "em_cryotimer.h"
+#include "test.h"
+
+/** @cond */
+#define TEST_SEQUENCES		200000UL
+#define ULFRCO_HZ			1080.0					// Real ULFRCO frequency, nominal is 1 kHz
+#define EM3_THRESHOLD		TimeBaseMsToTicks(ENERGY_EM3_WAKEUP_MS + ENERGY_EM3_MIN_SLEEP_MS)
+
+typedef struct {
+	int				Legacy;							// vEFMEnergyEnableLowPowerMode(false) count
+	ENERGY_MODE		Limits[EnergyClients];			// 0 when not restricted
+} MODEL;
+
+CMU_TypeDef EmuCmu;
+CRYOTIMER_TypeDef EmuCryotimer;
+static MODEL Model;
+static double Real;									// Real time in s
+static uint64_t Ticks;								// Time base, stopped in EM3
+static uint64_t Cleared;							// ULFRCO count at the last counter clear
+static uint32_t Period = 32;						// CRYOTIMER wake up period (log2)
+static uint32_t Deadline = TIMEBASE_NO_DEADLINE;
+static double Sleep;								// Duration of the next EM1 or EM2 sleep in s
+static uint32_t EarlyWake;							// GPIO IRQ during the next EM3 sleep, in ULFRCO counts
+static ENERGY_MODE Entered;
+static int IrqDisabled;
+/** @endcond */
+
+/*
+ * Reference: EM3 if allowed and far enough, EM2 if allowed and not too close, EM1 otherwise
+ */
+static ENERGY_MODE RefSelect(ENERGY_MODE limit, uint32_t deadline) {
+	if ((limit == EnergyModeEM3) && (deadline >= 83493)) return EnergyModeEM3;		// 2548 ms
+	if ((limit >= EnergyModeEM2) && (deadline >= ENERGY_EM2_WAKEUP_TICKS)) return EnergyModeEM2;
+	return EnergyModeEM1;
+}
+
+static ENERGY_MODE ModelLimit(void) {
+	ENERGY_MODE limit = EnergyModeEM3;
+	for (int c = 0; c < EnergyClients; c++)
+		if (Model.Limits[c] && (Model.Limits[c] < limit)) limit = Model.Limits[c];
+	return limit;
+}
+
+static void TestSelect(void) {
+	static const int64_t around[] = { 0, ENERGY_EM2_WAKEUP_TICKS, 83493, TIMEBASE_NO_DEADLINE };
+	CHECK(EM3_THRESHOLD == 83493);
+	// Limits beyond EM3 are EM3
+	for (int limit = EnergyModeEM1; limit <= EnergyModes; limit++) {
+		ENERGY_MODE allowed = (limit > EnergyModeEM3) ? EnergyModeEM3 : (ENERGY_MODE)limit;
+		for (unsigned int a = 0; a < sizeof(around) / sizeof(around[0]); a++)
+			for (int64_t d = around[a] - 4; d <= around[a] + 4; d++)
+				if ((d >= 0) && (d <= TIMEBASE_NO_DEADLINE))
+					CHECK(eEFMEnergySelectMode((ENERGY_MODE)limit, (uint32_t)d) == RefSelect(allowed, (uint32_t)d));
+		for (unsigned long r = 0; r < TEST_SEQUENCES; r++) {
+			uint32_t d = (uint32_t)rand() >> (rand() % 31);
+			CHECK(eEFMEnergySelectMode((ENERGY_MODE)limit, d) == RefSelect(allowed, d));
+		}
+	}
+	// No deadline: as deep as allowed
+	CHECK(eEFMEnergySelectMode(EnergyModeEM3, TIMEBASE_NO_DEADLINE) == EnergyModeEM3);
+	CHECK(eEFMEnergySelectMode(EnergyModeEM2, TIMEBASE_NO_DEADLINE) == EnergyModeEM2);
+	CHECK(eEFMEnergySelectMode(EnergyModeEM1, TIMEBASE_NO_DEADLINE) == EnergyModeEM1);
+}
+
+/*
+ * Random restrictions and releases by every driver, the legacy calls nest
+ */
+static void TestClients(void) {
+	CHECK(eEFMEnergyGetLimit() == EnergyModeEM3);
+	for (unsigned long r = 0; r < TEST_SEQUENCES; r++) {
+		int client = rand() % (EnergyClients + 1);
+		switch (rand() % 4) {
+		case 0:
+			if (client == EnergyClientLegacy) break;
+			vEFMEnergyRelease((ENERGY_CLIENT)client);
+			if (client < EnergyClients) Model.Limits[client] = 0;
+			break;
+		case 1:
+			// Nested a few levels deep at most, more enables than disables are ignored
+			if ((rand() & 1) || (Model.Legacy > 3)) {
+				vEFMEnergyEnableLowPowerMode(true);
+				if (Model.Legacy) Model.Legacy--;
+			}
+			else {
+				vEFMEnergyEnableLowPowerMode(false);
+				Model.Legacy++;
+			}
+			Model.Limits[EnergyClientLegacy] = (Model.Legacy) ? EnergyModeEM1 : 0;
+			break;
+		default: {
+			if (client == EnergyClientLegacy) break;
+			ENERGY_MODE deepest = (ENERGY_MODE)(EnergyModeEM1 + rand() % EnergyModes);
+			vEFMEnergyRequire((ENERGY_CLIENT)client, deepest);
+			if (client < EnergyClients) Model.Limits[client] = (deepest >= EnergyModeEM3) ? 0 : deepest;
+			break;
+		}
+		}
+		CHECK(eEFMEnergyGetLimit() == ModelLimit());
+		CHECK(IrqDisabled == 0);
+	}
+	// Everything released: EM3 again
+	while (Model.Legacy) {
+		vEFMEnergyEnableLowPowerMode(true);
+		Model.Legacy--;
+	}
+	for (int c = EnergyClientShell; c < EnergyClients; c++) vEFMEnergyRelease((ENERGY_CLIENT)c);
+	vEFMEnergyEnableLowPowerMode(true);
+	CHECK(eEFMEnergyGetLimit() == EnergyModeEM3);
+}
+
+/*******************************************************************
+** Simulation                                                     **
+*******************************************************************/
+static uint64_t UlfrcoCount(void) {
+	return (uint64_t)floor(Real * ULFRCO_HZ);
+}
+
+/*
+ * One sleep with the deadline and limit given, returns the time base error in ticks
+ */
+static double Enter(uint32_t deadline, double sleep, uint32_t earlyWake) {
+	ENERGY_RESIDENCY before, after;
+	double real = Real;
+	uint64_t ticks = Ticks;
+	vEFMEnergyGetResidency(&before);
+	Deadline = deadline;
+	Sleep = sleep;
+	EarlyWake = earlyWake;
+	vEFMEnergyEnter(0);
+	vEFMEnergyGetResidency(&after);
+	CHECK(Entered == eEFMEnergySelectMode(eEFMEnergyGetLimit(), deadline));
+	CHECK(after.Entries[Entered] == before.Entries[Entered] + 1);
+	CHECK(after.Ticks[Entered] == before.Ticks[Entered] + (Ticks - ticks));
+	CHECK(IrqDisabled == 0);
+	return (double)(Ticks - ticks) - (Real - real) * TIMEBASE_FREQUENCY;
+}
+
+/*
+ * EM2 sleeps of 1 s, the ULFRCO is calibrated about once a minute
+ */
+static void Calibrate(int seconds) {
+	for (int s = 0; s < seconds; s++) Enter(TIMEBASE_FREQUENCY, 1.0, 0);
+}
+
+/*
+ * EM3 sleeps to a deadline of 3 to 60 s, returns the largest relative time base error
+ */
+static double DeepSleeps(int count) {
+	double worst = 0;
+	for (int i = 0; i < count; i++) {
+		uint32_t deadline = EM3_THRESHOLD + rand() % (57 * TIMEBASE_FREQUENCY);
+		double real = Real;
+		double error = Enter(deadline, 0, 0);
+		double slept = (Real - real) * TIMEBASE_FREQUENCY;
+		CHECK(Entered == EnergyModeEM3);
+		// Woken up in time: about half the sleep at least, before the deadline less the wake up latency
+		CHECK(slept * 2 >= (deadline - TimeBaseMsToTicks(ENERGY_EM3_WAKEUP_MS)) * 0.9);
+		CHECK(slept <= deadline - TimeBaseMsToTicks(ENERGY_EM3_WAKEUP_MS) * 0.9);
+		if (fabs(error) / slept > worst) worst = fabs(error) / slept;
+	}
+	return worst;
+}
+
+static void TestSleeps(void) {
+	EmuCmu.STATUS = CMU_STATUS_LFXOENS | CMU_STATUS_LFXORDY;
+	// Not calibrated: the EM3 time is counted at the nominal 1 kHz, 8% too long
+	double error = DeepSleeps(10);
+	CHECK((error > 0.075) && (error < 0.085));
+	// Corrections of 0.8% per minute at most, converged in about 10 minutes
+	Calibrate(300);
+	CHECK(DeepSleeps(10) > 0.02);
+	Calibrate(900);
+	CHECK(DeepSleeps(100) < 0.0002);
+
+	// Many short EM3 sleeps cut by a GPIO IRQ: the fractions of ticks add up
+	uint64_t ticks = Ticks;
+	double real = Real;
+	for (int i = 0; i < 100000; i++) {
+		Enter(TIMEBASE_NO_DEADLINE, 0, 1 + rand() % 8);
+		CHECK(Entered == EnergyModeEM3);
+		CHECK(Period == 32);
+	}
+	CHECK(fabs((Ticks - ticks) - (Real - real) * TIMEBASE_FREQUENCY) < (Real - real) * TIMEBASE_FREQUENCY * 0.0002);
+
+	// A time base jump during a calibration period is discarded, a 5% error moves the rate by 0.8% only
+	Calibrate(70);
+	Ticks += 30 * TIMEBASE_FREQUENCY;
+	Calibrate(70);
+	CHECK(DeepSleeps(10) < 0.0002);
+	Calibrate(70);
+	Ticks += 3 * TIMEBASE_FREQUENCY;
+	Calibrate(70);
+	error = DeepSleeps(10);
+	CHECK((error > 0.005) && (error < 0.009));
+	Calibrate(600);
+	CHECK(DeepSleeps(10) < 0.0002);
+
+	// Restricted to EM2 by a driver: a far deadline does not select EM3
+	vEFMEnergyRequire(EnergyClientShell, EnergyModeEM2);
+	Enter(TIMEBASE_FREQUENCY * 60, 1.0, 0);
+	CHECK(Entered == EnergyModeEM2);
+	vEFMEnergyRelease(EnergyClientShell);
+	Enter(TIMEBASE_FREQUENCY * 60, 1.0, 0);
+	CHECK(Entered == EnergyModeEM3);
+	vEFMEnergyEnableLowPowerMode(false);
+	Enter(TIMEBASE_FREQUENCY * 60, 1.0, 0);
+	CHECK(Entered == EnergyModeEM1);
+	vEFMEnergyEnableLowPowerMode(true);
+}
+
+/*******************************************************************
+** Emulated seams                                                 **
+*******************************************************************/
+void EMU_EnterEM1(void) {
+	Entered = EnergyModeEM1;
+	Real += Sleep;
+	Ticks += (uint64_t)llround(Sleep * TIMEBASE_FREQUENCY);
+}
+
+void EMU_EnterEM2(bool restore) {
+	Entered = EnergyModeEM2;
+	Real += Sleep;
+	Ticks += (uint64_t)llround(Sleep * TIMEBASE_FREQUENCY);
+}
+
+/*
+ * The time base stops, the CRYOTIMER period or a GPIO IRQ wakes up
+ */
+void EMU_EnterEM3(bool restore) {
+	Entered = EnergyModeEM3;
+	if (EmuCryotimer.CMD & CRYOTIMER_CMD_CLEAR) Cleared = UlfrcoCount();
+	EmuCryotimer.CMD = 0;
+	uint64_t counts = (uint64_t)1 << Period;
+	if (EarlyWake && (EarlyWake < counts)) counts = EarlyWake;
+	// Wakes on the ULFRCO edge ending the last count, at a random phase of the first one
+	Real = (Cleared + counts + (double)rand() / RAND_MAX * 0.999) / ULFRCO_HZ;
+}
+
+uint32_t CRYOTIMER_CounterGet(void) {
+	if (EmuCryotimer.CMD & CRYOTIMER_CMD_CLEAR) Cleared = UlfrcoCount();
+	EmuCryotimer.CMD = 0;
+	return (uint32_t)(UlfrcoCount() - Cleared);
+}
+
+void CRYOTIMER_PeriodSet(uint32_t period) {
+	Period = period;
+}
+
+void CRYOTIMER_Init(const CRYOTIMER_Init_TypeDef* init) {
+	CHECK(init->osc == cryotimerOscULFRCO);
+	Cleared = UlfrcoCount();
+}
+
+uint32_t TimeBaseGetNextDeadline(void) {
+	return Deadline;
+}
+
+uint32_t TimeBaseGetTicks(void) {
+	return (uint32_t)Ticks;
+}
+
+uint64_t TimeBaseGetTicks64(void) {
+	return Ticks;
+}
+
+void TimeBaseSkip(uint32_t ticks) {
+	Ticks += ticks;
+}
+
+void SystemIrqDisable(void) {
+	IrqDisabled++;
+}
+
+void SystemIrqEnable(void) {
+	CHECK(IrqDisabled > 0);
+	IrqDisabled--;
+}
+
+void CRYOTIMER_Enable(bool enable) { }
+uint32_t CRYOTIMER_IntGet(void) { return 0; }
+void CRYOTIMER_IntClear(uint32_t flags) { }
+void CRYOTIMER_IntEnable(uint32_t flags) { }
+void CRYOTIMER_IntDisable(uint32_t flags) { }
+void CMU_ClockEnable(CMU_Clock_TypeDef clock, bool enable) { }
+void NVIC_EnableIRQ(IRQn_Type IRQn) { }
+void NVIC_ClearPendingIRQ(IRQn_Type IRQn) { }
+
+int main(void) {
+	srand(33);
+	TestSelect();
+	TestClients();
+	TestSleeps();
+	return TEST_END();
+}
@@ -0,0 +1,263 @@
+/*******************************************************************
+**                                                                **
+** Device event set host tests                                    **
+**                                                                **
+*******************************************************************/
+/*
+ * Stress test of the pending event set of device_event.h against a model written from its
+ * specification: the events of the highest priority class pending are dispatched first, the
+ * events of a same class in the order they were first posted, an event posted again while
+ * pending is merged with its payload, and no event is lost when a whole class, or every
+ * class, is pending at once. Posts from task and ISR context and takes are interleaved at
+ * random, also across the wrap of the posting order counter.
+ */
+
+#include "device_event.h"
+#include "test.h"
+
+/** @cond */
+#define TEST_STEPS			2000000UL
+#define CLASS_SYSTEM		0
+#define CLASS_RADIO			1
+#define CLASS_JOIN			2
+#define CLASS_USER			3
+#define CLASS_BACKGROUND	4
+
+// Priority class of each event, IDLE_EVENT is not dispatchable
+static const int ModelClass[EVENT_COUNT] = {
+	[IDLE_EVENT] = -1,
+	[SYSTEM_RESET] = CLASS_SYSTEM, [RESET_EVENT] = CLASS_SYSTEM, [POWER_FAIL_EVENT] = CLASS_SYSTEM,
+	[BATTERYLOW_EVENT] = CLASS_SYSTEM, [ERROR_EVENT] = CLASS_SYSTEM, [RF_ERROR_EVENT] = CLASS_SYSTEM,
+	[RF_MLME] = CLASS_RADIO, [RF_INDICATION] = CLASS_RADIO,
+	[RUN_ATTACH] = CLASS_JOIN, [RUN_ATTACH_USE_OTTA] = CLASS_JOIN, [RUN_ATTACH_USE_ABP] = CLASS_JOIN,
+	[PSEUDO_JOIN_NETWORK] = CLASS_JOIN, [PSEUDO_JOIN_NETWORK_COMPLETED] = CLASS_JOIN,
+	[REQ_REAL_APP_KEY_ALLOC] = CLASS_JOIN, [REAL_APP_KEY_ALLOC_COMPLETED] = CLASS_JOIN,
+	[REQ_REAL_APP_KEY_RX_REPORT] = CLASS_JOIN, [REAL_APP_KEY_RX_REPORT_COMPLETED] = CLASS_JOIN,
+	[REAL_JOIN_NETWORK] = CLASS_JOIN, [REAL_JOIN_NETWORK_COMPLETED] = CLASS_JOIN, [JOIN_COMPLETED] = CLASS_JOIN,
+	[BUTTON_EVENT] = CLASS_USER, [RELOAD_EVENT] = CLASS_USER, [USER_EVENT] = CLASS_USER, [RUN_TEST_EVENT] = CLASS_USER,
+	[LINK_STATS_EVENT] = CLASS_BACKGROUND, [CRASH_REPORT_EVENT] = CLASS_BACKGROUND,
+	[PERIODIC_RESEND] = CLASS_BACKGROUND, [PERIODIC_EVENT] = CLASS_BACKGROUND, [PULSE_EVENT] = CLASS_BACKGROUND
+};
+
+typedef struct {
+	bool			Pending[EVENT_COUNT];
+	unsigned long	Order[EVENT_COUNT];		// First posting since the last dispatch
+	unsigned long	Payload[EVENT_COUNT];
+	unsigned long	Sequence;
+	unsigned long	Posted, Coalesced, Dispatched;
+	unsigned int	Count, MaxCount;
+} MODEL;
+
+static MODEL Model;
+/** @endcond */
+
+static void ModelPost(EVENT_TYPE event, unsigned long payload) {
+	if ((event <= IDLE_EVENT) || (event >= EVENT_COUNT)) return;
+	Model.Posted++;
+	Model.Payload[event] |= payload;
+	if (Model.Pending[event]) {
+		Model.Coalesced++;
+		return;
+	}
+	Model.Pending[event] = true;
+	Model.Order[event] = Model.Sequence++;
+	if (++Model.Count > Model.MaxCount) Model.MaxCount = Model.Count;
+}
+
+static EVENT_TYPE ModelTake(unsigned long* payload) {
+	EVENT_TYPE best = IDLE_EVENT;
+	for (int e = IDLE_EVENT + 1; e < EVENT_COUNT; e++) {
+		if (!Model.Pending[e]) continue;
+		if ((best == IDLE_EVENT) || (ModelClass[e] < ModelClass[best]) ||
+				((ModelClass[e] == ModelClass[best]) && (Model.Order[e] < Model.Order[best])))
+			best = (EVENT_TYPE)e;
+	}
+	if (best != IDLE_EVENT) {
+		*payload = Model.Payload[best];
+		Model.Payload[best] = 0;
+		Model.Pending[best] = false;
+		Model.Count--;
+		Model.Dispatched++;
+	}
+	return best;
+}
+
+static void Reset(uint32_t sequence) {
+	DeviceEventInit();
+	EventSequence = sequence;
+	memset(&Model, 0, sizeof(Model));
+}
+
+/*
+ * Take one event from the device set and from the model, and compare
+ */
+static EVENT_TYPE CheckTake(void) {
+	unsigned long payload = 0;
+	EVENT_TYPE expected = ModelTake(&payload);
+	EVENT_TYPE evt = DeviceWaitForEvent(0);
+	CHECK(evt == expected);
+	if (evt != IDLE_EVENT) CHECK(DeviceGetEventPayload() == payload);
+	return evt;
+}
+
+static void CheckStats(void) {
+	EVENT_STATS stats;
+	DeviceGetEventStats(&stats);
+	CHECK(stats.Posted == Model.Posted);
+	CHECK(stats.Coalesced == Model.Coalesced);
+	CHECK(stats.Dispatched == Model.Dispatched);
+	CHECK(stats.Pending == Model.Count);
+	CHECK(stats.MaxPending == Model.MaxCount);
+}
+
+static EVENT_TYPE RandomEvent(void) {
+	// Mostly valid events, sometimes IDLE_EVENT or out of range
+	int r = rand() % (EVENT_COUNT + 2);
+	return (EVENT_TYPE)((r <= EVENT_COUNT) ? r : UNKNOWN_EVENT);
+}
+
+/*
+ * Ranks: every dispatchable event has a rank and the classes partition the ranks in order
+ */
+static void TestRanks(void) {
+	uint32_t all = 0;
+	Reset(0);
+	for (int e = IDLE_EVENT + 1; e < EVENT_COUNT; e++) {
+		CHECK(EventPriorityOrder[EventRank[e]] == e);
+		CHECK((EventClassMask[ModelClass[e]] >> EventRank[e]) & 1);
+	}
+	for (unsigned int c = 0; c < EVENT_CLASS_COUNT; c++) {
+		CHECK((all & EventClassMask[c]) == 0);
+		CHECK(EventClassMask[c] > all);
+		all |= EventClassMask[c];
+	}
+	CHECK(all == (0x01UL << (EVENT_COUNT - 1)) - 1);
+}
+
+/*
+ * Highest class first, oldest first within a class, coalescing of the posts
+ */
+static void TestOrder(void) {
+	Reset(0);
+	CHECK(DeviceWaitForEvent(0) == IDLE_EVENT);
+	// Posted from the lowest to the highest class, dispatched the other way
+	DevicePostEvent(PULSE_EVENT);
+	DevicePostEvent(USER_EVENT);
+	DevicePostEvent(JOIN_COMPLETED);
+	DevicePostEvent(RF_MLME);
+	DevicePostEvent(ERROR_EVENT);
+	CHECK(DeviceWaitForEvent(0) == ERROR_EVENT);
+	CHECK(DeviceWaitForEvent(0) == RF_MLME);
+	CHECK(DeviceWaitForEvent(0) == JOIN_COMPLETED);
+	CHECK(DeviceWaitForEvent(0) == USER_EVENT);
+	CHECK(DeviceWaitForEvent(0) == PULSE_EVENT);
+	// Same class: posting order, not rank order, and a repost keeps the first position
+	DevicePostEventPayload(PULSE_EVENT, 0x01);
+	DevicePostEvent(PERIODIC_EVENT);
+	DevicePostEventPayload(PULSE_EVENT, 0x04);
+	DevicePostEvent(LINK_STATS_EVENT);
+	CHECK(DeviceWaitForEvent(0) == PULSE_EVENT);
+	CHECK(DeviceGetEventPayload() == 0x05);
+	CHECK(DeviceWaitForEvent(0) == PERIODIC_EVENT);
+	CHECK(DeviceGetEventPayload() == 0);
+	CHECK(DeviceWaitForEvent(0) == LINK_STATS_EVENT);
+	CHECK(DeviceWaitForEvent(0) == IDLE_EVENT);
+	// Not dispatchable events are ignored
+	DevicePostEvent(IDLE_EVENT);
+	DevicePostEvent(EVENT_COUNT);
+	DevicePostEventFromISR(UNKNOWN_EVENT);
+	CHECK(DeviceWaitForEvent(0) == IDLE_EVENT);
+	// A signal left by an event already dispatched does not return an event
+	DevicePostEvent(BUTTON_EVENT);
+	CHECK(DeviceEventTake() == BUTTON_EVENT);
+	CHECK(xEventSignalBuffer.Count == 1);
+	CHECK(DeviceWaitForEvent(10) == IDLE_EVENT);
+	CHECK(xEventSignalBuffer.Count == 0);
+}
+
+/*
+ * Every event of a class, then every event, pending at once, posted in random order
+ */
+static void TestOverflow(void) {
+	EVENT_TYPE events[EVENT_COUNT - 1];
+	for (int round = 0; round < 1000; round++) {
+		int count = 0, c = round % (EVENT_CLASS_COUNT + 1);
+		Reset((round & 1) ? 0xFFFFFFF0UL : 0);
+		for (int e = IDLE_EVENT + 1; e < EVENT_COUNT; e++)
+			if ((c == EVENT_CLASS_COUNT) || (ModelClass[e] == c)) events[count++] = (EVENT_TYPE)e;
+		for (int i = count - 1; i > 0; i--) {
+			int j = rand() % (i + 1);
+			EVENT_TYPE t = events[i];
+			events[i] = events[j];
+			events[j] = t;
+		}
+		// Each event twice, the second post is merged
+		for (int pass = 0; pass < 2; pass++)
+			for (int i = 0; i < count; i++) {
+				unsigned long payload = 1UL << (rand() % 32);
+				DevicePostEventPayload(events[i], payload);
+				ModelPost(events[i], payload);
+			}
+		CHECK(Model.Count == count);
+		for (int i = 0; i < count; i++) CHECK(CheckTake() != IDLE_EVENT);
+		CHECK(CheckTake() == IDLE_EVENT);
+		CheckStats();
+	}
+}
+
+/*
+ * Random interleavings of posts, ISR posts and takes, also across the posting counter wrap
+ */
+static void TestRandom(void) {
+	static const uint32_t starts[] = { 0, 0xFFFFFF00UL };
+	for (unsigned int s = 0; s < sizeof(starts) / sizeof(starts[0]); s++) {
+		Reset(starts[s]);
+		for (unsigned long step = 0; step < TEST_STEPS; step++) {
+			// Bursts of posts and of takes, so that the set fills and drains
+			int posts = ((step / 1000) & 1) ? 3 : 1;
+			if (rand() % (posts + 1)) {
+				EVENT_TYPE event = RandomEvent();
+				unsigned long payload = (rand() & 1) ? (unsigned long)rand() : 0;
+				if (rand() & 1) {
+					if (payload) DevicePostEventPayload(event, payload);
+					else if (rand() & 1) DevicePostEvent(event);
+					else DeviceSendEvent(event);
+				}
+				else if (payload) DevicePostEventPayloadFromISR(event, payload);
+				else if (rand() & 1) DevicePostEventFromISR(event);
+				else DeviceSendEventFromISR(event);
+				ModelPost(event, payload);
+			}
+			else CheckTake();
+			if ((step % 1024) == 0) CheckStats();
+		}
+		while (CheckTake() != IDLE_EVENT);
+		CheckStats();
+	}
+}
+
+/*******************************************************************
+** Emulated seams                                                 **
+*******************************************************************/
+BaseType_t xSemaphoreTake(SemaphoreHandle_t semaphore, TickType_t ticks) {
+	if (!semaphore->Count) return pdFALSE;
+	semaphore->Count = 0;
+	return pdTRUE;
+}
+
+void vTaskSetTimeOutState(TimeOut_t* timeout) {
+	timeout->Entered = 0;
+}
+
+BaseType_t xTaskCheckForTimeOut(TimeOut_t* timeout, TickType_t* ticks) {
+	return pdTRUE;
+}
+
+int main(void) {
+	srand(26);
+	TestRanks();
+	TestOrder();
+	TestOverflow();
+	TestRandom();
+	return TEST_END();
+}
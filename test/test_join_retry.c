@@ -0,0 +1,635 @@
+/*******************************************************************
+**                                                                **
+** Join retry host tests                                          **
+**                                                                **
+*******************************************************************/
+/*
+ * src/join_retry.c runs on top of emulated seams: the RTCC retention registers, the DevNonce
+ * Flash Memory pages (erased words read 0xFF, a write only clears bits), the MAC DevNonce
+ * and the tick count. The module source is included to reach its Flash Memory pages and to
+ * swap the state of many nodes.
+ *
+ * The stage and attempts retained in RET[31] must survive a reset, and any corrupted register
+ * value must be rejected unless it is a valid encoding. DevNonce values must never be used
+ * twice, also when a reset tears a Flash Memory write or erase of the reservation ring.
+ * Then a fleet of nodes powered at once joins through a network outage: each node retries
+ * with the backoff and the join duty cycle of the module, the join requests overlapping on
+ * the same channel collide. The spread of the join requests is reported and compared with
+ * the same fleet retrying without jitter.
+ */
+
+#include <limits.h>
+#include <setjmp.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include "../src/join_retry.c"
+#include "test.h"
+
+/** @cond */
+#define NVRAM_WORDS		32				// RTCC retention registers
+#define TEST_CORRUPTED	1000000UL
+#define TEST_JOINS		6000			// Joins of the DevNonce ring test, wraps the ring several times
+#define NODES			1000
+#define CHANNELS		3				// KR920 default join channels
+#define JOIN_AIRTIME	1483			// Join request at DR0 (SF12, 23 bytes) in ms
+#define JOIN_WINDOWS	6000			// Join accept windows after the request (ms)
+#define BOOT_SPREAD		5000			// Nodes powered within 5 s
+#define OUTAGE			(20 * 60000UL)	// Network down after the power restoration (ms)
+#define SIMULATED		(48 * 3600000UL)
+#define WINDOW			10000			// Join requests counted over windows of 10 s, the first one holds the boot
+#define WINDOWS			(SIMULATED / WINDOW)
+
+typedef struct {
+	// join_retry.c state
+	uint8_t			JoinStage;
+	uint8_t			JoinAttempts;
+	EVENT_TYPE		RetryEvent;
+	portTickType	RetryStart;
+	portTickType	RetryDelay;
+	bool			bLongSleep;
+	portTickType	CycleStart;
+	bool			bCycleStarted;
+	// Device
+	uint32_t		Nvram;				// RET[JOIN_RETRY_NVRAM_INDEX]
+	uint32_t		Seed;				// randr state, seeded from the radio on the target
+	bool			bCollided;
+} NODE;
+
+typedef struct {
+	portTickType	Time;
+	int				Node;
+	bool			bOutcome;			// End of the join accept windows, else start of the request
+} SIM_EVENT;
+
+typedef struct {
+	unsigned long	Requests;
+	unsigned long	Collisions;
+	unsigned long	LongSleeps;
+	unsigned long	Peak;				// Most join requests in a window, after the first one
+	int				Nodes;				// Nodes joined
+	unsigned long	Joined[4];			// Time to join 50, 90, 99 and 100 % of the fleet after the outage, if reached
+} STORM;
+
+static uint32_t		Nvram;
+static int			NvramSize = NVRAM_WORDS;
+static portTickType	Now;
+static uint16_t		MacDevNonce;
+static bool			bFlashOpen;
+static int			Suspended;
+static bool			bLockstep;			// randr returns its minimum: no jitter
+static uint32_t		Seed;
+static signed char	FlashFailure;		// Error returned by the next Flash Memory write
+// Reset injection
+static jmp_buf		ResetJump;
+static unsigned long Seams;				// Reset points passed
+static unsigned long ResetAt;			// Reset point of the injected reset, 0 for none
+static unsigned long Resets;
+// Fleet
+static NODE			Nodes[NODES];
+static NODE*		Node;				// Node running join_retry.c
+static SIM_EVENT	Events[2 * NODES];
+static int			EventCount;
+static unsigned long Requests[WINDOWS];
+static portTickType	JoinTimes[NODES];
+/** @endcond */
+
+/*******************************************************************
+** Emulated seams                                                 **
+*******************************************************************/
+static bool ResetPoint(void) {
+	return (++Seams == ResetAt);
+}
+
+static void Reset(void) {
+	longjmp(ResetJump, 1);
+}
+
+int SystemGetNVRAMSize(void) {
+	return NvramSize;
+}
+void SystemSetNVRAMValue(int index, int value) {
+	CHECK((index == JOIN_RETRY_NVRAM_INDEX) && (index < NvramSize));
+	Nvram = (uint32_t)value;
+}
+int SystemGetNVRAMValue(int index) {
+	CHECK((index == JOIN_RETRY_NVRAM_INDEX) && (index < NvramSize));
+	return (int)Nvram;
+}
+
+portTickType xTaskGetTickCount(void) {
+	return Now;
+}
+void vTaskSuspendAll(void) {
+	Suspended++;
+}
+long xTaskResumeAll(void) {
+	CHECK(Suspended > 0);
+	Suspended--;
+	return 0;
+}
+
+/*
+ * Same generator as utilities.c, one state per node
+ */
+int32_t randr(int32_t min, int32_t max) {
+	if (bLockstep) return min;
+	Seed = Seed * 1103515245 + 12345;
+	return (int32_t)((Seed % 2147483647) % (uint32_t)(max - min + 1)) + min;
+}
+
+LoRaMacStatus_t LoRaMacMibGetRequestConfirm(MibRequestConfirm_t* mibGet) {
+	CHECK(mibGet->Type == MIB_DEV_NONCE);
+	mibGet->Param.DevNonce = MacDevNonce;
+	return LORAMAC_STATUS_OK;
+}
+LoRaMacStatus_t LoRaMacMibSetRequestConfirm(MibRequestConfirm_t* mibSet) {
+	CHECK(mibSet->Type == MIB_DEV_NONCE);
+	MacDevNonce = mibSet->Param.DevNonce;
+	return LORAMAC_STATUS_OK;
+}
+
+static void FlashProtect(int prot) {
+	uintptr_t page = (uintptr_t)sysconf(_SC_PAGESIZE);
+	uintptr_t start = (uintptr_t)_JOINNONCEPAGES_ & ~(page - 1);
+	uintptr_t end = ((uintptr_t)_JOINNONCEPAGES_ + sizeof(_JOINNONCEPAGES_) + page - 1) & ~(page - 1);
+	if (mprotect((void*)start, end - start, prot) != 0) {
+		perror("mprotect");
+		exit(1);
+	}
+}
+static volatile uint32_t* FlashWord(void* address) {
+	uintptr_t offset = (uintptr_t)address - (uintptr_t)_JOINNONCEPAGES_;
+	CHECK(bFlashOpen);
+	CHECK((offset < sizeof(_JOINNONCEPAGES_)) && ((offset % sizeof(uint32_t)) == 0));
+	return (volatile uint32_t*)address;
+}
+void FLASHOpen(void) {
+	CHECK(!bFlashOpen && (Suspended > 0));
+	bFlashOpen = true;
+	FlashProtect(PROT_READ | PROT_WRITE);
+}
+void FLASHClose(void) {
+	CHECK(bFlashOpen);
+	bFlashOpen = false;
+	FlashProtect(PROT_READ);
+}
+signed char FLASHEraseBlock(void* address) {
+	volatile uint32_t* word = FlashWord(address);
+	CHECK((((uintptr_t)address - (uintptr_t)_JOINNONCEPAGES_) % JOIN_PAGE_SIZE) == 0);
+	for (int i = 0; i < JOIN_PAGE_SIZE / sizeof(uint32_t); i++) {
+		if (ResetPoint()) {
+			word[i] = (uint32_t)rand();
+			Reset();
+		}
+		word[i] = 0xFFFFFFFFUL;
+	}
+	return FLASH_NO_ERROR;
+}
+signed char FLASHWrite(void* address, unsigned char* buffer, unsigned short count) {
+	volatile uint32_t* word = FlashWord(address);
+	CHECK((count % sizeof(uint32_t)) == 0);
+	if (FlashFailure != FLASH_NO_ERROR) {
+		// The write verify failed on the first word
+		signed char rc = FlashFailure;
+		word[0] &= (uint32_t)rand();
+		FlashFailure = FLASH_NO_ERROR;
+		return rc;
+	}
+	for (int i = 0; i < count / sizeof(uint32_t); i++) {
+		uint32_t value;
+		memcpy(&value, &buffer[i * sizeof(uint32_t)], sizeof(value));
+		CHECK(word[i] == 0xFFFFFFFFUL);
+		if (ResetPoint()) {
+			word[i] &= (uint32_t)rand();
+			Reset();
+		}
+		word[i] &= value;
+	}
+	return FLASH_NO_ERROR;
+}
+
+/*******************************************************************
+** Retained state                                                 **
+*******************************************************************/
+/*
+ * Power the device: the module state is lost, the retention registers are kept
+ */
+static void PowerUp(void) {
+	JoinStage = JOIN_STAGE_NONE;
+	JoinAttempts = 0;
+	RetryEvent = IDLE_EVENT;
+	bLongSleep = false;
+	bCycleStarted = false;
+	bNonceValid = false;
+	JOINRETRY_Init();
+}
+
+static uint32_t Encode(unsigned stage, unsigned attempts) {
+	uint32_t value = stage | (attempts << 8);
+	return value | (~value << 16);
+}
+
+/*
+ * Delay range of a retry before the duty cycle floor
+ */
+static void BackoffRange(JOIN_STAGE stage, unsigned attempts, unsigned long* min, unsigned long* max) {
+	unsigned long delay = JoinStageParams[stage].Base;
+	for (unsigned i = 1; (i < attempts) && (delay < JoinStageParams[stage].Max); i++) delay <<= 1;
+	if (delay > JoinStageParams[stage].Max) delay = JoinStageParams[stage].Max;
+	*min = delay / 2;
+	*max = delay;
+}
+
+static void TestRetained(void) {
+	for (int stage = 0; stage < JoinStages; stage++) {
+		PowerUp();
+		for (unsigned attempts = 1; attempts <= JOIN_RETRY_MAX_ATTEMPTS; attempts++) {
+			unsigned long min, max, delay;
+			Now += 1000;
+			delay = JOINRETRY_Failed((JOIN_STAGE)stage, 0);
+			CHECK(Nvram == Encode(stage, attempts));
+			CHECK(JOINRETRY_GetTimeout() == delay);
+			if (attempts < JOIN_RETRY_MAX_ATTEMPTS) {
+				BackoffRange((JOIN_STAGE)stage, attempts, &min, &max);
+				CHECK((delay >= min) && (delay <= max));
+				CHECK(RetryEvent == JoinStageParams[stage].Event);
+			}
+			else {
+				CHECK((delay >= JOIN_RETRY_LONG_SLEEP * 900) && (delay <= JOIN_RETRY_LONG_SLEEP * 1100));
+				CHECK(RetryEvent == RUN_ATTACH);
+			}
+			// A reset keeps the stage and attempts, the whole procedure restarts as late as the stage would have
+			PowerUp();
+			CHECK((JoinStage == stage) && (JoinAttempts == attempts));
+			CHECK(JOINRETRY_GetTimeout() == portMAX_DELAY);
+			CHECK(JOINRETRY_Resume());
+			delay = JOINRETRY_GetTimeout();
+			if (attempts < JOIN_RETRY_MAX_ATTEMPTS) CHECK((delay >= min) && (delay <= max));
+			else CHECK((delay >= JOIN_RETRY_LONG_SLEEP * 900) && (delay <= JOIN_RETRY_LONG_SLEEP * 1100));
+			CHECK(JOINRETRY_Poll() == IDLE_EVENT);
+			Now += delay;
+			CHECK(JOINRETRY_Poll() == RUN_ATTACH);
+			CHECK(JOINRETRY_Poll() == IDLE_EVENT);
+			if (attempts == JOIN_RETRY_MAX_ATTEMPTS) {
+				// The long sleep starts over with a fresh backoff
+				CHECK(Nvram == Encode(JOIN_STAGE_NONE, 0));
+				PowerUp();
+				CHECK(!JOINRETRY_Resume());
+			}
+		}
+		// A success clears the retained state
+		PowerUp();
+		JOINRETRY_Failed((JOIN_STAGE)stage, 0);
+		JOINRETRY_Succeeded((JOIN_STAGE)stage, true);
+		PowerUp();
+		CHECK(!JOINRETRY_Resume());
+	}
+
+	// The first delays are spread over the whole jitter range, also when the duty cycle sets them
+	for (int stage = 0; stage < JoinStages; stage++) {
+		unsigned long min = ULONG_MAX, max = 0, floorMin = ULONG_MAX, floorMax = 0;
+		for (int r = 0; r < 1000; r++) {
+			JOINRETRY_Succeeded((JOIN_STAGE)stage, true);
+			unsigned long delay = JOINRETRY_Failed((JOIN_STAGE)stage, 0);
+			if (delay < min) min = delay;
+			if (delay > max) max = delay;
+			JOINRETRY_Succeeded((JOIN_STAGE)stage, true);
+			delay = JOINRETRY_Failed((JOIN_STAGE)stage, JOIN_AIRTIME);
+			CHECK((delay >= 99UL * JOIN_AIRTIME) && (delay <= 99UL * JOIN_AIRTIME * 3 / 2));
+			if (delay < floorMin) floorMin = delay;
+			if (delay > floorMax) floorMax = delay;
+		}
+		CHECK(max - min > JoinStageParams[stage].Base / 2 * 9 / 10);
+		CHECK(floorMax - floorMin > 99UL * JOIN_AIRTIME / 2 * 9 / 10);
+	}
+
+	// A stage success resets the attempts of the stage only
+	PowerUp();
+	JOINRETRY_Failed(JoinStagePseudoJoin, 0);
+	JOINRETRY_Failed(JoinStagePseudoJoin, 0);
+	JOINRETRY_Succeeded(JoinStagePseudoJoin, false);
+	CHECK(Nvram == Encode(JoinStagePseudoJoin, 0));
+	PowerUp();
+	CHECK(!JOINRETRY_Resume());
+	CHECK(JOINRETRY_Failed(JoinStages, 1000) == 0);
+
+	// Corrupted registers: only a valid encoding is accepted, anything else is the power on state
+	for (unsigned long r = 0; r < TEST_CORRUPTED + 0x10000 + JoinStages * 9 * 32; r++) {
+		uint32_t value;
+		if (r < 0x10000) value = (uint32_t)r | ((~(uint32_t)r) << 16);		// Every low half with its complement
+		else if (r < 0x10000 + JoinStages * 9 * 32) {
+			unsigned v = (unsigned)(r - 0x10000);
+			value = Encode(v / (9 * 32), (v / 32) % 9) ^ (1UL << (v % 32));	// Single bit flips
+		}
+		else value = ((uint32_t)rand() << 16) ^ (uint32_t)rand();
+		Nvram = value;
+		PowerUp();
+		unsigned stage = value & 0xFF, attempts = (value >> 8) & 0xFF;
+		bool bValid = (value == Encode(stage, attempts)) && (stage < JoinStages) && (attempts <= JOIN_RETRY_MAX_ATTEMPTS);
+		if (bValid) CHECK((JoinStage == stage) && (JoinAttempts == attempts));
+		else CHECK((JoinStage == JOIN_STAGE_NONE) && (JoinAttempts == 0));
+		CHECK(JOINRETRY_Resume() == (bValid && (attempts > 0)));
+		CHECK(Nvram == value);
+	}
+
+	// Without the register the state is neither read nor written
+	NvramSize = JOIN_RETRY_NVRAM_INDEX;
+	Nvram = Encode(JoinStageOTAA, 3);
+	PowerUp();
+	CHECK(!JOINRETRY_Resume());
+	JOINRETRY_Failed(JoinStageOTAA, 0);
+	CHECK(Nvram == Encode(JoinStageOTAA, 3));
+	NvramSize = NVRAM_WORDS;
+}
+
+/*******************************************************************
+** DevNonce ring                                                  **
+*******************************************************************/
+/*
+ * Highest DevNonce of the valid record with the highest sequence, false if none
+ */
+static bool RefReserved(uint16_t* devNonce) {
+	uint32_t sequence = 0;
+	bool bFound = false;
+	for (int page = 0; page < JOIN_RETRY_PAGES; page++)
+		for (unsigned r = 0; r < JOIN_RECORDS; r++) {
+			const JOIN_NONCE_RECORD* record = (const JOIN_NONCE_RECORD*)JOIN_RECORDPTR(page, r);
+			if (record->Sequence == JOIN_SEQUENCE_BLANK) break;
+			if (record->Check != (uint16_t)~(record->DevNonce ^ record->Sequence ^ (record->Sequence >> 16))) continue;
+			if (bFound && (record->Sequence <= sequence)) continue;
+			bFound = true;
+			sequence = record->Sequence;
+			*devNonce = record->DevNonce;
+		}
+	return bFound;
+}
+
+/*
+ * One join: reserve, then the MAC sends 1 to JOIN_NONCE_TRIALS requests
+ * @return false if the join was interrupted by a reset
+ */
+static bool Join(uint8_t* used) {
+	uint16_t reserved;
+	if (setjmp(ResetJump)) {
+		if (bFlashOpen) FLASHClose();
+		Suspended = 0;
+		ResetAt = 0;
+		Resets++;
+		return false;
+	}
+	JOINRETRY_ReserveDevNonce();
+	CHECK(RefReserved(&reserved));
+	for (int trial = 1 + rand() % JOIN_NONCE_TRIALS; trial > 0; trial--) {
+		MacDevNonce++;
+		// Persisted before it is sent, never sent twice
+		CHECK((uint16_t)(reserved - MacDevNonce) < JOIN_NONCE_RESERVE);
+		CHECK(!used[MacDevNonce]);
+		used[MacDevNonce] = 1;
+	}
+	return true;
+}
+
+static void TestDevNonce(void) {
+	static uint8_t used[0x10000];
+	uint16_t reserved;
+	unsigned long pageWraps = 0, failures = 0, erases = 0;
+	int page = 0;
+
+	FlashProtect(PROT_READ | PROT_WRITE);
+	memset((void*)_JOINNONCEPAGES_, 0xFF, sizeof(_JOINNONCEPAGES_));
+	FlashProtect(PROT_READ);
+	// Nothing reserved yet: the MAC keeps its random DevNonce
+	MacDevNonce = (uint16_t)rand();
+	PowerUp();
+	CHECK(!bNonceValid);
+	CHECK(!RefReserved(&reserved));
+	CHECK(Join(used));
+	for (unsigned long j = 0; j < TEST_JOINS; j++) {
+		switch (rand() % 16) {
+		case 0:
+			// Reset while the reservation is written: the MAC skips the DevNonce values left
+			MacDevNonce = ReservedNonce;
+			Seams = 0;
+			if (rand() % 2) NonceRecord = JOIN_RECORDS;		// As after a failed write, the next page is erased
+			if (NonceRecord >= JOIN_RECORDS) erases++;
+			ResetAt = 1 + rand() % ((NonceRecord >= JOIN_RECORDS) ? JOIN_PAGE_SIZE / sizeof(uint32_t) + 2 : 2);
+			CHECK(!Join(used));
+			ResetAt = 0;
+			// fall through
+		case 1:
+			// Reboot: the MAC DevNonce is random again after the reboot
+			MacDevNonce = (uint16_t)rand();
+			PowerUp();
+			CHECK(bNonceValid && RefReserved(&reserved) && (MacDevNonce == reserved));
+			break;
+		case 2:
+			// A failed write moves to the next page
+			if (rand() % 4) break;
+			FlashFailure = FLASH_WRITE_VERIFY_ERROR;
+			MacDevNonce = ReservedNonce;
+			JOINRETRY_ReserveDevNonce();
+			CHECK(FlashFailure == FLASH_NO_ERROR);
+			CHECK(NonceRecord == JOIN_RECORDS);
+			failures++;
+			// Reboot before the next reservation: nothing used beyond the persisted one
+			MacDevNonce = (uint16_t)rand();
+			PowerUp();
+			CHECK(MacDevNonce == ReservedNonce);
+			break;
+		}
+		CHECK(Join(used));
+		if (NoncePage != page) pageWraps++;
+		page = NoncePage;
+	}
+	CHECK(Suspended == 0);
+	CHECK(pageWraps > 2 * JOIN_RETRY_PAGES);
+	CHECK(Resets > TEST_JOINS / 32);
+	CHECK(erases > TEST_JOINS / 64);
+	CHECK(failures > 10);
+	// Reset on the first word of the erase of a page holding older records
+	for (int r = 0; r < 4; r++) {
+		while (NonceRecord < JOIN_RECORDS) {
+			MacDevNonce = ReservedNonce;
+			CHECK(Join(used));
+		}
+		MacDevNonce = ReservedNonce;
+		Seams = 0;
+		ResetAt = 1;
+		CHECK(!Join(used));
+		MacDevNonce = (uint16_t)rand();
+		PowerUp();
+		CHECK(bNonceValid && RefReserved(&reserved) && (MacDevNonce == reserved));
+		CHECK(Join(used));
+	}
+}
+
+/*******************************************************************
+** Fleet                                                          **
+*******************************************************************/
+static void Select(NODE* node) {
+	Node = node;
+	JoinStage = node->JoinStage;
+	JoinAttempts = node->JoinAttempts;
+	RetryEvent = node->RetryEvent;
+	RetryStart = node->RetryStart;
+	RetryDelay = node->RetryDelay;
+	bLongSleep = node->bLongSleep;
+	CycleStart = node->CycleStart;
+	bCycleStarted = node->bCycleStarted;
+	Nvram = node->Nvram;
+	Seed = node->Seed;
+}
+
+static void Deselect(void) {
+	Node->JoinStage = JoinStage;
+	Node->JoinAttempts = JoinAttempts;
+	Node->RetryEvent = RetryEvent;
+	Node->RetryStart = RetryStart;
+	Node->RetryDelay = RetryDelay;
+	Node->bLongSleep = bLongSleep;
+	Node->CycleStart = CycleStart;
+	Node->bCycleStarted = bCycleStarted;
+	Node->Nvram = Nvram;
+	Node->Seed = Seed;
+	Node = NULL;
+}
+
+static bool Earlier(int a, int b) {
+	return (Events[a].Time < Events[b].Time) || ((Events[a].Time == Events[b].Time) && (Events[a].Node < Events[b].Node));
+}
+
+static void Push(portTickType time, int node, bool bOutcome) {
+	int i = EventCount++;
+	Events[i].Time = time;
+	Events[i].Node = node;
+	Events[i].bOutcome = bOutcome;
+	while ((i > 0) && Earlier(i, (i - 1) / 2)) {
+		SIM_EVENT swap = Events[i];
+		Events[i] = Events[(i - 1) / 2];
+		Events[(i - 1) / 2] = swap;
+		i = (i - 1) / 2;
+	}
+}
+
+static SIM_EVENT Pop(void) {
+	SIM_EVENT first = Events[0];
+	int i = 0;
+	Events[0] = Events[--EventCount];
+	for (;;) {
+		int next = i, child = 2 * i + 1;
+		if ((child < EventCount) && Earlier(child, next)) next = child;
+		if ((child + 1 < EventCount) && Earlier(child + 1, next)) next = child + 1;
+		if (next == i) break;
+		SIM_EVENT swap = Events[i];
+		Events[i] = Events[next];
+		Events[next] = swap;
+		i = next;
+	}
+	return first;
+}
+
+static int CompareTicks(const void* a, const void* b) {
+	portTickType x = *(const portTickType*)a, y = *(const portTickType*)b;
+	return (x > y) - (x < y);
+}
+
+/*
+ * Power restoration: every node boots within BOOT_SPREAD, the network answers after OUTAGE
+ */
+static void Storm(bool lockstep, STORM* storm) {
+	struct {
+		portTickType	Start;
+		int				Node;
+	} last[CHANNELS];
+
+	memset(storm, 0, sizeof(*storm));
+	memset(Requests, 0, sizeof(Requests));
+	memset(last, 0xFF, sizeof(last));
+	bLockstep = lockstep;
+	EventCount = 0;
+	for (int n = 0; n < NODES; n++) {
+		memset(&Nodes[n], 0, sizeof(Nodes[n]));
+		Nodes[n].Nvram = ((uint32_t)rand() << 16) ^ (uint32_t)rand();		// Retention registers lost
+		Nodes[n].Seed = (uint32_t)rand();
+		Now = (portTickType)(rand() % BOOT_SPREAD);
+		Select(&Nodes[n]);
+		PowerUp();
+		if (JOINRETRY_Resume()) Push(Now + JOINRETRY_GetTimeout(), n, false);
+		else Push(Now, n, false);
+		Deselect();
+	}
+	while ((EventCount > 0) && (Events[0].Time < SIMULATED)) {
+		SIM_EVENT event = Pop();
+		NODE* node = &Nodes[event.Node];
+		Now = event.Time;
+		Select(node);
+		if (!event.bOutcome) {
+			// The scheduled retry is due, one join request on a random channel
+			if (RetryEvent != IDLE_EVENT) {
+				CHECK(JOINRETRY_GetTimeout() == 0);
+				EVENT_TYPE run = JOINRETRY_Poll();
+				CHECK((run == RUN_ATTACH_USE_OTTA) || (run == RUN_ATTACH));
+				if (run == RUN_ATTACH) storm->LongSleeps++;
+			}
+			int ch = rand() % CHANNELS;
+			node->bCollided = false;
+			if ((last[ch].Node >= 0) && (Now - last[ch].Start < JOIN_AIRTIME)) {
+				node->bCollided = true;
+				Nodes[last[ch].Node].bCollided = true;
+			}
+			last[ch].Start = Now;
+			last[ch].Node = event.Node;
+			storm->Requests++;
+			Requests[Now / WINDOW]++;
+			Push(Now + JOIN_AIRTIME + JOIN_WINDOWS, event.Node, true);
+		}
+		else if ((Now - JOIN_WINDOWS >= OUTAGE) && !node->bCollided) {
+			JOINRETRY_Succeeded(JoinStageOTAA, true);
+			CHECK(Nvram == Encode(JOIN_STAGE_NONE, 0));
+			JoinTimes[storm->Nodes++] = Now - OUTAGE;
+		}
+		else {
+			if (node->bCollided && (Now - JOIN_WINDOWS >= OUTAGE)) storm->Collisions++;
+			unsigned long delay = JOINRETRY_Failed(JoinStageOTAA, JOIN_AIRTIME);
+			CHECK(delay >= 99UL * JOIN_AIRTIME);
+			CHECK(JOINRETRY_GetTimeout() == delay);
+			Push(Now + delay, event.Node, false);
+		}
+		Deselect();
+	}
+	bLockstep = false;
+	for (int n = storm->Nodes; n < NODES; n++) JoinTimes[n] = SIMULATED - OUTAGE;
+	qsort(JoinTimes, NODES, sizeof(JoinTimes[0]), CompareTicks);
+	storm->Joined[0] = JoinTimes[NODES / 2 - 1];
+	storm->Joined[1] = JoinTimes[NODES * 9 / 10 - 1];
+	storm->Joined[2] = JoinTimes[NODES * 99 / 100 - 1];
+	storm->Joined[3] = JoinTimes[NODES - 1];
+	for (unsigned long w = 1; w < WINDOWS; w++)
+		if (Requests[w] > storm->Peak) storm->Peak = Requests[w];
+	printf("%s: %d of %d nodes joined, %lu requests, %lu collisions after the outage, %lu long sleeps\n",
+			lockstep ? "lockstep" : "jitter", storm->Nodes, NODES, storm->Requests, storm->Collisions, storm->LongSleeps);
+	printf("  peak %lu requests in %d s, joined after the outage: 50%% %lu s, 90%% %lu s, 99%% %lu s, 100%% %lu s\n",
+			storm->Peak, WINDOW / 1000, storm->Joined[0] / 1000, storm->Joined[1] / 1000, storm->Joined[2] / 1000,
+			storm->Joined[3] / 1000);
+}
+
+static void TestStorm(void) {
+	STORM jitter, lockstep;
+	Storm(false, &jitter);
+	Storm(true, &lockstep);
+	// The jitter spreads the requests and joins the whole fleet, in lockstep it keeps colliding
+	CHECK(jitter.Nodes == NODES);
+	CHECK(lockstep.Nodes < NODES / 10);
+	CHECK(jitter.Peak < NODES / 4);
+	CHECK(lockstep.Peak == NODES);
+	CHECK(jitter.Collisions * 2 < lockstep.Collisions);
+}
+
+int main(void) {
+	srand(34);
+	TestRetained();
+	TestDevNonce();
+	TestStorm();
+	return TEST_END();
+}
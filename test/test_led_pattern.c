@@ -0,0 +1,185 @@
+/*******************************************************************
+**                                                                **
+** LED patterns unit tests                                        **
+**                                                                **
+*******************************************************************/
+/*
+ * The MAC timer is replaced by a virtual clock in ms: the test moves the clock forward, the
+ * timer callback runs when its due time is reached (plus an optional IRQ latency) and every
+ * LED change is recorded in a timeline, which is checked against the expected one.
+ */
+
+#include <stdio.h>
+#include "timer.h"
+#include "led_pattern.h"
+#include "test.h"
+
+/** @cond */
+#define TIMELINE_SIZE	64
+
+typedef struct {
+	uint32_t	Time;
+	int			Led;
+	bool		On;
+} TOGGLE;
+
+static uint32_t		Now;
+static uint32_t		Latency;			// Timer IRQ latency (in ms)
+static TimerEvent_t* Timer;
+static uint32_t		TimerDue;
+static bool			Leds[HAL_NB_LED];
+static TOGGLE		Timeline[TIMELINE_SIZE];
+static int			Toggles;
+/** @endcond */
+
+void TimerInit(TimerEvent_t* obj, void (*callback)(void)) {
+	obj->Callback = callback;
+	obj->IsRunning = false;
+	Timer = obj;
+}
+void TimerSetValue(TimerEvent_t* obj, uint32_t value) {
+	obj->ReloadValue = value;
+}
+void TimerStart(TimerEvent_t* obj) {
+	obj->IsRunning = true;
+	TimerDue = Now + obj->ReloadValue;
+}
+void TimerStop(TimerEvent_t* obj) {
+	obj->IsRunning = false;
+}
+TimerTime_t TimerGetCurrentTime(void) {
+	return Now;
+}
+
+void SystemSetPortState(SystemPort port, bool on) {
+	if (Leds[port] == on) return;
+	Leds[port] = on;
+	if (Toggles < TIMELINE_SIZE) Timeline[Toggles] = (TOGGLE){ Now, port, on };
+	Toggles++;
+}
+
+/*
+ * Move the virtual clock forward, running the timer IRQs on the way
+ */
+static void Advance(uint32_t ms) {
+	uint32_t end = Now + ms;
+	while (Timer->IsRunning && ((int32_t)(end - (TimerDue + Latency)) >= 0)) {
+		Now = TimerDue + Latency;
+		Timer->IsRunning = false;
+		Timer->Callback();
+	}
+	Now = end;
+}
+void vTaskDelay(uint32_t ticks) {
+	Advance(ticks);
+}
+
+static void Reset(void) {
+	LEDPATTERN_Init();
+	Now = 1000;
+	Latency = 0;
+	memset(Leds, 0, sizeof(Leds));
+	Toggles = 0;
+}
+
+/*
+ * Check the timeline against the expected toggles, given as time, LED and state triplets
+ */
+static bool TimelineIs(int count, const uint32_t* expected) {
+	if (Toggles != count) {
+		fprintf(stderr, "%d toggles, %d expected\n", Toggles, count);
+		return false;
+	}
+	for (int i = 0; i < count; i++) {
+		if ((Timeline[i].Time != expected[3*i]) || (Timeline[i].Led != (int)expected[3*i+1]) || (Timeline[i].On != (expected[3*i+2] != 0))) {
+			fprintf(stderr, "toggle %d: %u LED%d %d, expected %u LED%u %u\n", i, Timeline[i].Time, Timeline[i].Led, Timeline[i].On,
+					expected[3*i], expected[3*i+1], expected[3*i+2]);
+			return false;
+		}
+	}
+	return true;
+}
+#define TIMELINE(...)	TimelineIs(sizeof((uint32_t[]){ __VA_ARGS__ }) / (3 * sizeof(uint32_t)), (uint32_t[]){ __VA_ARGS__ })
+
+int main(void) {
+	// Flashes, returning at once
+	Reset();
+	CHECK(LEDPATTERN_Flash(0, 3, 100));
+	CHECK(Toggles == 1);
+	Advance(599);
+	CHECK(LEDPATTERN_IsPlaying(0));
+	Advance(1);
+	CHECK(!LEDPATTERN_IsPlaying(0));
+	CHECK(!Timer->IsRunning);
+	CHECK(TIMELINE(1000,0,1, 1100,0,0, 1200,0,1, 1300,0,0, 1400,0,1, 1500,0,0));
+
+	// Back to the steady state at the end
+	Reset();
+	LEDPATTERN_SetSteady(0, true);
+	CHECK(LEDPATTERN_Flash(0, 1, 50));
+	Advance(1000);
+	CHECK(TIMELINE(1000,0,1, 1050,0,0, 1100,0,1));
+	CHECK(LEDPATTERN_GetSteady(0));
+
+	// An alert preempts the flashes, which cannot interrupt it
+	Reset();
+	CHECK(LEDPATTERN_Flash(0, 10, 100));
+	Advance(150);
+	CHECK(LEDPATTERN_Alert(0, 2, 200));
+	Advance(100);
+	CHECK(LEDPATTERN_Flash(0, 5, 10) == false);
+	CHECK(LEDPATTERN_Flash(0, 0, 10) == false);
+	Advance(1000);
+	CHECK(TIMELINE(1000,0,1, 1100,0,0, 1150,0,1, 1350,0,0, 1550,0,1, 1750,0,0));
+	CHECK(LEDPATTERN_Flash(0, 1, 10));
+
+	// Endless flashes, stopping them does not stop an alert
+	Reset();
+	CHECK(LEDPATTERN_Flash(0, 0, 50));
+	Advance(10000);
+	CHECK(LEDPATTERN_IsPlaying(0));
+	CHECK(Toggles == 201);
+	LEDPATTERN_StopFlash(0);
+	CHECK(!LEDPATTERN_IsPlaying(0));
+	CHECK(LEDPATTERN_Alert(0, 1, 100));
+	LEDPATTERN_StopFlash(0);
+	CHECK(LEDPATTERN_IsPlaying(0));
+
+	// A late IRQ plays the late changes at once, the next ones stay on time
+	Reset();
+	Latency = 250;
+	CHECK(LEDPATTERN_Flash(0, 4, 100));
+	Advance(360);
+	Latency = 0;
+	Advance(1000);
+	CHECK(TIMELINE(1000,0,1, 1350,0,0, 1350,0,1, 1350,0,0, 1400,0,1, 1500,0,0, 1600,0,1, 1700,0,0));
+
+	// Two LEDs from the single timer
+	Reset();
+	CHECK(LEDPATTERN_Flash(0, 2, 100));
+	Advance(50);
+	CHECK(LEDPATTERN_Flash(1, 1, 120));
+	Advance(1000);
+	CHECK(TIMELINE(1000,0,1, 1050,1,1, 1100,0,0, 1170,1,0, 1200,0,1, 1300,0,0));
+
+	// Declared pattern with a pause step, played twice
+	Reset();
+	{
+		static const LEDPATTERN_STEP steps[] = { { 20, 30, 2 }, { 0, 200, 1 }, { 500, 0, 1 }, { 0, 0, 0 } };
+		static const LEDPATTERN pattern = { steps, 2, LEDPATTERN_PRIORITY_ALERT };
+		CHECK(LEDPATTERN_Play(0, &pattern));
+		Advance(5000);
+		CHECK(TIMELINE(1000,0,1, 1020,0,0, 1050,0,1, 1070,0,0, 1300,0,1, 1800,0,0,
+				1800,0,1, 1820,0,0, 1850,0,1, 1870,0,0, 2100,0,1, 2600,0,0));
+	}
+
+	// Waiting for the end of the pattern, as before a reboot
+	Reset();
+	CHECK(LEDPATTERN_Alert(0, 20, 100));
+	LEDPATTERN_Wait(0);
+	CHECK(!LEDPATTERN_IsPlaying(0));
+	CHECK(Now >= 1000 + 20 * 200);
+	CHECK(Toggles == 40);
+
+	return TEST_END();
+}
@@ -0,0 +1,361 @@
+/*******************************************************************
+**                                                                **
+** MAC command codec tests and fuzz target                        **
+**                                                                **
+*******************************************************************/
+/*
+ * ProcessMacCommands decodes the downlink MAC commands with the SrvMacCommands table and
+ * AddMacCommand queues the answers with the MoteMacCommands table. LoRaMac.c is included to
+ * reach them, on top of the KR920 region and the host board, radio and timers of
+ * stub/mac_board.c.
+ *
+ * Each input is decoded after a fresh MAC initialization and compared with a model written
+ * from the LoRaWAN command list: the commands handled, the answers queued and their order,
+ * the sticky answers and the answers dropped when the buffers are full. The command bytes
+ * end on an inaccessible page, so that reading past them faults.
+ *
+ * An input is the SNR, the number of answers already queued, then the command bytes.
+ *
+ *   test_mac_commands				random and mutated command streams
+ *   test_mac_commands file...		the given inputs, e.g. afl-fuzz -i in -o out -- ./test_mac_commands @@
+ *   make -C test fuzz				libFuzzer build (clang), LLVMFuzzerTestOneInput only
+ */
+
+#include <stdlib.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include "../LoRaMac-node-development/src/mac/LoRaMac.c"
+#include "RegionKR920.h"
+#include "test.h"
+
+/** @cond */
+#define INPUT_HEADER		2
+#define COMMANDS_MAX		255				// ProcessMacCommands size is 8 bits
+#define BATTERY				0xA5
+#define RANDOM_INPUTS		300000
+#define RANDOM_SLACK		32
+
+typedef struct {
+	uint8_t		Cid;
+	uint8_t		Length;					// Payload length, CID excluded
+	uint8_t		Answer;					// Answer CID, 0 for none
+	uint8_t		AnswerLength;
+	bool		bSticky;				// The answer is repeated until a downlink
+} MODEL_COMMAND;
+
+// Downlink commands of LoRaWAN 1.0.2 and of this network, written apart from the MAC tables
+static const MODEL_COMMAND ModelCommands[] = {
+	{ 0x02, 2, 0x00, 0, false },		// LinkCheckAns
+	{ 0x03, 4, 0x03, 1, false },		// LinkADRReq, one answer for each request of a block
+	{ 0x04, 1, 0x04, 0, false },		// DutyCycleReq
+	{ 0x05, 4, 0x05, 1, true },			// RXParamSetupReq
+	{ 0x06, 0, 0x06, 2, false },		// DevStatusReq
+	{ 0x07, 5, 0x07, 1, false },		// NewChannelReq
+	{ 0x08, 1, 0x08, 0, true },			// RXTimingSetupReq
+	{ 0x09, 1, 0x00, 0, false },		// TxParamSetupReq, not supported by KR920: no answer
+	{ 0x0A, 4, 0x0A, 1, true },			// DlChannelReq
+	{ 0x0D, 6, 0x00, 0, false },		// DeviceTimeAns, with a 16 bits fraction
+};
+#define MODEL_COMMANDS		(sizeof(ModelCommands) / sizeof(ModelCommands[0]))
+
+typedef struct {
+	uint8_t		Buffer[LORA_MAC_COMMAND_MAX_LENGTH];
+	uint8_t		Known[LORA_MAC_COMMAND_MAX_LENGTH];	// The byte value is known, status bytes are not
+	uint8_t		Clear[LORA_MAC_COMMAND_MAX_LENGTH];	// Status bits known to be cleared
+	uint8_t		Index;
+	uint8_t		Repeat[LORA_MAC_COMMAND_MAX_LENGTH];
+	uint8_t		RepeatKnown[LORA_MAC_COMMAND_MAX_LENGTH];
+	uint8_t		RepeatClear[LORA_MAC_COMMAND_MAX_LENGTH];
+	uint8_t		RepeatIndex;
+	bool		bAnswers;
+	// Last values set by the commands, -1 if none
+	int			DemodMargin, NbGateways, MaxDCycle, ReceiveDelay1;
+	int64_t		Epoch;
+} MODEL;
+
+static uint8_t*		Guard;					// First inaccessible byte
+static MODEL		Model;
+static unsigned long Handled[256];			// Commands handled by the model, by CID
+static unsigned long Inputs;
+static unsigned long Dropped;				// Answers dropped on full buffers
+/** @endcond */
+
+/*******************************************************************
+** Emulated seams                                                 **
+*******************************************************************/
+static void OnMcpsConfirm( McpsConfirm_t *mcpsConfirm ) { }
+static void OnMcpsIndication( McpsIndication_t *mcpsIndication ) { }
+static void OnMlmeConfirm( MlmeConfirm_t *mlmeConfirm ) { }
+static uint8_t GetBatteryLevel( void ) { return BATTERY; }
+
+static LoRaMacPrimitives_t Primitives = { OnMcpsConfirm, OnMcpsIndication, OnMlmeConfirm };
+static LoRaMacCallback_t Callbacks = { .GetBatteryLevel = GetBatteryLevel };
+
+/*******************************************************************
+** Model                                                          **
+*******************************************************************/
+static const MODEL_COMMAND* ModelFind(uint8_t cid) {
+	for (unsigned int i = 0; i < MODEL_COMMANDS; i++)
+		if (ModelCommands[i].Cid == cid) return &ModelCommands[i];
+	return NULL;
+}
+
+/*
+ * Queue an answer, a negative parameter is a status computed by the region
+ * @return the status bits known to be cleared, NULL if the buffers are full
+ */
+static uint8_t* ModelAnswer(const MODEL_COMMAND* command, int p1, int p2) {
+	if (!command->Answer) return NULL;
+	if (Model.Index + Model.RepeatIndex + 1 + command->AnswerLength > LORA_MAC_COMMAND_MAX_LENGTH) {
+		Dropped++;
+		return NULL;
+	}
+	uint8_t* buffer = command->bSticky ? Model.Repeat : Model.Buffer;
+	uint8_t* known = command->bSticky ? Model.RepeatKnown : Model.Known;
+	uint8_t* clear = command->bSticky ? Model.RepeatClear : Model.Clear;
+	uint8_t* index = command->bSticky ? &Model.RepeatIndex : &Model.Index;
+	int values[2] = { p1, p2 };
+	buffer[*index] = command->Answer;
+	known[(*index)++] = 1;
+	for (int i = 0; i < command->AnswerLength; i++) {
+		buffer[*index] = (values[i] < 0) ? 0 : (uint8_t)values[i];
+		known[(*index)++] = (values[i] >= 0);
+	}
+	Model.bAnswers = true;
+	return &clear[*index - command->AnswerLength];
+}
+
+static void ModelProcess(const uint8_t* commands, int size, uint8_t snr) {
+	int index = 0;
+	while (index < size) {
+		const MODEL_COMMAND* command = ModelFind(commands[index]);
+		if (!command || (index + 1 + command->Length > size)) return;
+		const uint8_t* cmd = &commands[index];
+		Handled[command->Cid]++;
+		index += 1 + command->Length;
+		switch (command->Cid) {
+		case 0x02:
+			Model.DemodMargin = cmd[1];
+			Model.NbGateways = cmd[2];
+			break;
+		case 0x03: {
+			// The complete requests that follow make a block, answered with the same status
+			int requests = 1;
+			while ((index + 1 + command->Length <= size) && (commands[index] == command->Cid)) {
+				index += 1 + command->Length;
+				requests++;
+			}
+			for (int i = 0; i < requests; i++) ModelAnswer(command, -1, 0);
+			break;
+		}
+		case 0x04:
+			Model.MaxDCycle = cmd[1] & 0x0F;
+			ModelAnswer(command, 0, 0);
+			break;
+		case 0x06:
+			ModelAnswer(command, BATTERY, snr);
+			break;
+		case 0x08:
+			Model.ReceiveDelay1 = ((cmd[1] & 0x0F) ? (cmd[1] & 0x0F) : 1) * 1000;
+			ModelAnswer(command, 0, 0);
+			break;
+		case 0x0A: {
+			// No uplink frequency on a channel KR920 does not have
+			uint8_t* clear = ModelAnswer(command, -1, 0);
+			if (clear && (cmd[1] >= KR920_MAX_NB_CHANNELS)) *clear = 0x02;
+			break;
+		}
+		case 0x0D:
+			Model.Epoch = cmd[1] | (cmd[2] << 8) | (cmd[3] << 16) | ((uint32_t)cmd[4] << 24);
+			break;
+		default:
+			ModelAnswer(command, -1, 0);
+			break;
+		}
+	}
+}
+
+static void CheckBuffer(const uint8_t* buffer, const uint8_t* expected, const uint8_t* known, const uint8_t* clear, int size) {
+	for (int i = 0; i < size; i++) {
+		if (known[i]) CHECK(buffer[i] == expected[i]);
+		CHECK((buffer[i] & clear[i]) == 0);
+	}
+}
+
+/*******************************************************************
+** Fuzz target                                                    **
+*******************************************************************/
+static void MacInit(void) {
+	LoRaMacInitialization(&Primitives, &Callbacks, LORAMAC_REGION_KR920);
+	MacCommandsBufferIndex = 0;
+	MacCommandsBufferToRepeatIndex = 0;
+	MacCommandsInNextTx = false;
+	MaxDCycle = 0;
+	MlmeConfirm.DemodMargin = 0;
+	MlmeConfirm.NbGateways = 0;
+	MlmeConfirm.Epoch = 0;
+}
+
+static void RunInput(const uint8_t* data, size_t size) {
+	if (size < INPUT_HEADER) return;
+	uint8_t snr = data[0];
+	int queued = data[1] % 64;
+	size -= INPUT_HEADER;
+	if (size > COMMANDS_MAX) size = COMMANDS_MAX;
+	uint8_t* commands = Guard - size;
+	memcpy(commands, data + INPUT_HEADER, size);
+	Inputs++;
+
+	MacInit();
+	// Answers of the previous downlinks, sticky or not
+	for (int i = 0; i < queued; i++)
+		AddMacCommand((i & 1) ? MOTE_MAC_RX_TIMING_SETUP_ANS : MOTE_MAC_DEV_STATUS_ANS, (uint8_t)i, snr);
+	memset(&Model, 0, sizeof(Model));
+	memcpy(Model.Buffer, MacCommandsBuffer, MacCommandsBufferIndex);
+	memset(Model.Known, 1, MacCommandsBufferIndex);
+	Model.Index = MacCommandsBufferIndex;
+	memcpy(Model.Repeat, MacCommandsBufferToRepeat, MacCommandsBufferToRepeatIndex);
+	memset(Model.RepeatKnown, 1, MacCommandsBufferToRepeatIndex);
+	Model.RepeatIndex = MacCommandsBufferToRepeatIndex;
+	Model.bAnswers = MacCommandsInNextTx;
+	Model.DemodMargin = Model.NbGateways = Model.MaxDCycle = Model.ReceiveDelay1 = -1;
+	Model.Epoch = -1;
+	int receiveDelay1 = LoRaMacParams.ReceiveDelay1;
+
+	ModelProcess(commands, (int)size, snr);
+	ProcessMacCommands(commands, 0, (uint8_t)size, snr);
+
+	CHECK(MacCommandsBufferIndex == Model.Index);
+	CHECK(MacCommandsBufferToRepeatIndex == Model.RepeatIndex);
+	CHECK(MacCommandsBufferIndex + MacCommandsBufferToRepeatIndex <= LORA_MAC_COMMAND_MAX_LENGTH);
+	CHECK(MacCommandsInNextTx == Model.bAnswers);
+	if ((MacCommandsBufferIndex == Model.Index) && (MacCommandsBufferToRepeatIndex == Model.RepeatIndex)) {
+		CheckBuffer(MacCommandsBuffer, Model.Buffer, Model.Known, Model.Clear, Model.Index);
+		CheckBuffer(MacCommandsBufferToRepeat, Model.Repeat, Model.RepeatKnown, Model.RepeatClear, Model.RepeatIndex);
+	}
+	CHECK(MlmeConfirm.DemodMargin == ((Model.DemodMargin < 0) ? 0 : Model.DemodMargin));
+	CHECK(MlmeConfirm.NbGateways == ((Model.NbGateways < 0) ? 0 : Model.NbGateways));
+	CHECK(MaxDCycle == ((Model.MaxDCycle < 0) ? 0 : Model.MaxDCycle));
+	if (Model.MaxDCycle >= 0) CHECK(AggregatedDCycle == (1U << Model.MaxDCycle));
+	CHECK(LoRaMacParams.ReceiveDelay1 == ((Model.ReceiveDelay1 < 0) ? receiveDelay1 : (uint32_t)Model.ReceiveDelay1));
+	CHECK(MlmeConfirm.Epoch == ((Model.Epoch < 0) ? 0 : (uint32_t)Model.Epoch));
+}
+
+static void GuardInit(void) {
+	long page = sysconf(_SC_PAGESIZE);
+	uint8_t* pages = mmap(NULL, 2 * page, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	CHECK(pages != MAP_FAILED);
+	CHECK(mprotect(pages + page, page, PROT_NONE) == 0);
+	Guard = pages + page;
+}
+
+int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size) {
+	if (!Guard) GuardInit();
+	RunInput(data, size);
+	if (TestFailures) abort();
+	return 0;
+}
+
+#ifndef MAC_FUZZER
+/*******************************************************************
+** Standalone driver                                              **
+*******************************************************************/
+static int Random(int range) {
+	return rand() % range;
+}
+
+/*
+ * Command stream: valid commands, blocks of LinkADRReq, unknown commands or noise, cut at a
+ * random length so that the last command may be truncated. A step writes up to RANDOM_SLACK
+ * bytes past the cut.
+ */
+static size_t RandomInput(uint8_t* input) {
+	size_t size = INPUT_HEADER;
+	// FOpts or port 0 payload
+	size_t end = INPUT_HEADER + (Random(2) ? 15 : 1 + Random(Random(8) ? 64 : COMMANDS_MAX));
+	int kind = Random(8);
+	input[0] = (uint8_t)Random(256);
+	input[1] = (uint8_t)(Random(4) ? 0 : Random(64));
+	while (size < end) {
+		if (kind == 0) {
+			input[size++] = (uint8_t)Random(256);
+			continue;
+		}
+		const MODEL_COMMAND* command = &ModelCommands[Random(MODEL_COMMANDS)];
+		int count = ((command->Cid == 0x03) && Random(2)) ? 1 + Random(5) : 1;
+		for (int c = 0; c < count; c++) {
+			input[size++] = command->Cid;
+			for (int i = 0; i < command->Length; i++) input[size++] = (uint8_t)Random(256);
+		}
+		if ((kind == 1) && !Random(4)) input[size++] = (uint8_t)(0x0E + Random(0x72));
+	}
+	if (size > end) size = end;
+	// Mutations
+	if (kind == 2) {
+		for (int i = Random(4); i >= 0; i--) input[INPUT_HEADER + Random((int)(size - INPUT_HEADER))] ^= (uint8_t)(1 << Random(8));
+	}
+	return size;
+}
+
+static int RunFile(const char* file) {
+	static uint8_t input[INPUT_HEADER + COMMANDS_MAX];
+	FILE* f = fopen(file, "rb");
+	if (!f) {
+		perror(file);
+		return 1;
+	}
+	size_t size = fread(input, 1, sizeof(input), f);
+	fclose(f);
+	RunInput(input, size);
+	return 0;
+}
+
+static void TestAddMacCommand(void) {
+	MacInit();
+	CHECK(AddMacCommand(0x55, 0, 0) == LORAMAC_STATUS_SERVICE_UNKNOWN);
+	CHECK(MacCommandsInNextTx == false);
+	// 42 DevStatusAns fill 126 bytes, then only the 1 byte answers fit
+	for (int i = 0; i < 42; i++) CHECK(AddMacCommand(MOTE_MAC_DEV_STATUS_ANS, BATTERY, (uint8_t)i) == LORAMAC_STATUS_OK);
+	CHECK(AddMacCommand(MOTE_MAC_LINK_ADR_ANS, 7, 0) == LORAMAC_STATUS_OK);
+	CHECK(AddMacCommand(MOTE_MAC_RX_TIMING_SETUP_ANS, 0, 0) == LORAMAC_STATUS_BUSY);
+	CHECK(MacCommandsBufferIndex == 128);
+	CHECK(MacCommandsBuffer[125] == 41);
+	CHECK(MacCommandsBuffer[126] == MOTE_MAC_LINK_ADR_ANS);
+	CHECK(MacCommandsBuffer[127] == 7);
+	// The sticky answers share the capacity
+	MacCommandsBufferIndex = 125;
+	CHECK(AddMacCommand(MOTE_MAC_DL_CHANNEL_ANS, 3, 0) == LORAMAC_STATUS_OK);
+	CHECK(AddMacCommand(MOTE_MAC_RX_TIMING_SETUP_ANS, 0, 0) == LORAMAC_STATUS_OK);
+	CHECK(AddMacCommand(MOTE_MAC_DUTY_CYCLE_ANS, 0, 0) == LORAMAC_STATUS_BUSY);
+	CHECK(MacCommandsBufferToRepeatIndex == 3);
+	CHECK(MacCommandsBufferToRepeat[0] == MOTE_MAC_DL_CHANNEL_ANS);
+	CHECK(MacCommandsBufferToRepeat[1] == 3);
+	CHECK(MacCommandsBufferToRepeat[2] == MOTE_MAC_RX_TIMING_SETUP_ANS);
+}
+
+static void TestRandom(void) {
+	static uint8_t input[INPUT_HEADER + COMMANDS_MAX + RANDOM_SLACK];
+	srand(1);
+	for (unsigned long i = 0; i < RANDOM_INPUTS; i++) RunInput(input, RandomInput(input));
+	printf("%lu inputs, %lu answers dropped on full buffers, commands handled:", Inputs, Dropped);
+	for (unsigned int i = 0; i < MODEL_COMMANDS; i++) {
+		printf(" %02X:%lu", ModelCommands[i].Cid, Handled[ModelCommands[i].Cid]);
+		CHECK(Handled[ModelCommands[i].Cid] > RANDOM_INPUTS / 10);
+	}
+	printf("\n");
+	CHECK(Dropped > 0);
+}
+
+int main(int argc, char* argv[]) {
+	GuardInit();
+	if (argc > 1) {
+		for (int i = 1; i < argc; i++)
+			if (RunFile(argv[i])) return 1;
+		if (TestFailures) abort();
+		return 0;
+	}
+	TestAddMacCommand();
+	TestRandom();
+	return TEST_END();
+}
+#endif
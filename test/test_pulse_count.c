@@ -0,0 +1,153 @@
+/*******************************************************************
+**                                                                **
+** Pulse counting unit tests and wake up benchmark                **
+**                                                                **
+*******************************************************************/
+/*
+ * A meter output is emulated at time base resolution, with optional contact bounces, and fed to
+ * the three ways the firmware can count it:
+ * - edge IRQ per edge, as before (no debounce),
+ * - edge IRQ debounced with PulseCountDebounce,
+ * - an emulated PCNT0 clocked by the pin, synced with PulseCountDelta on its overflow IRQ and
+ *   on the periodic reads, the edge IRQ being armed once per PULSE_EVENT.
+ * The counts are checked and the core wake ups per 10k pulses are reported.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "pulse_count.h"
+#include "test.h"
+
+/** @cond */
+#define TICKS_PER_S		32768UL
+#define MS(ms)			((ms) * TICKS_PER_S / 1000)
+#define DEBOUNCE		MS(10)
+#define READ_PERIOD		(3600 * TICKS_PER_S)	// Periodic report reading the value
+#define PCNT_TOP		0xFFFF
+
+typedef struct {
+	const char*		Name;
+	unsigned long	Pulses;			// Real pulses
+	unsigned long	Period;			// Ticks between pulses
+	int				Bounces;		// Extra edges after each pulse, within 3 ms
+	unsigned long	Start;			// Time base at the first pulse
+} METER;
+
+typedef struct {
+	unsigned long	Counted;
+	unsigned long	Wakeups;
+} RESULT;
+
+// Emulated PCNT0: 16 bits counter clocked by the pin, overflow IRQ when passing TOP
+typedef struct {
+	unsigned short	Counter;
+	unsigned short	Last;			// Driver copy, PulsePcntLast
+	unsigned long	Value;			// Driver copy, PulseInValue
+} PCNT_EMU;
+/** @endcond */
+
+/*
+ * Calls edge(time) for every edge of the meter output, and read(time) at every report
+ */
+static void MeterRun(const METER* m, void (*edge)(void*, unsigned long), void (*read)(void*, unsigned long), void* ctx) {
+	unsigned long t = m->Start, nextRead = m->Start + READ_PERIOD;
+	for (unsigned long p = 0; p < m->Pulses; p++, t += m->Period) {
+		while ((long)(t - nextRead) >= 0) {
+			if (read) read(ctx, nextRead);
+			nextRead += READ_PERIOD;
+		}
+		edge(ctx, t);
+		for (int b = 1; b <= m->Bounces; b++) edge(ctx, t + (unsigned long)b * MS(3) / (m->Bounces + 1));
+	}
+	if (read) read(ctx, t);
+}
+
+static void IrqEdge(void* ctx, unsigned long t) {
+	RESULT* r = ctx;
+	(void)t;
+	r->Wakeups++;
+	r->Counted++;
+}
+
+static unsigned long DebounceLast;
+static void DebouncedEdge(void* ctx, unsigned long t) {
+	RESULT* r = ctx;
+	r->Wakeups++;
+	if (PulseCountDebounce(&DebounceLast, t, DEBOUNCE)) r->Counted++;
+}
+
+static PCNT_EMU Pcnt;
+static int PcntArmed;
+static void PcntSync(void) {
+	Pcnt.Value += PulseCountDelta(&Pcnt.Last, Pcnt.Counter);
+}
+static void PcntEdge(void* ctx, unsigned long t) {
+	RESULT* r = ctx;
+	(void)t;
+	if (Pcnt.Counter++ == PCNT_TOP) {
+		// Overflow IRQ
+		r->Wakeups++;
+		PcntSync();
+	}
+	if (PcntArmed) {
+		// Edge IRQ posting PULSE_EVENT, disarmed until the supervisor rearms it
+		r->Wakeups++;
+		PcntArmed = 0;
+	}
+}
+static void PcntRead(void* ctx, unsigned long t) {
+	(void)ctx; (void)t;
+	PcntSync();
+	PcntArmed = 1;	// DevicePulseInRearm after the report
+}
+
+static void Run(const METER* m) {
+	RESULT irq = { 0 }, debounced = { 0 }, pcnt = { 0 };
+
+	MeterRun(m, IrqEdge, NULL, &irq);
+	DebounceLast = m->Start - DEBOUNCE;
+	MeterRun(m, DebouncedEdge, NULL, &debounced);
+	Pcnt.Counter = (unsigned short)rand();	// Any start value
+	Pcnt.Last = Pcnt.Counter;
+	Pcnt.Value = 0;
+	PcntArmed = 1;
+	MeterRun(m, PcntEdge, PcntRead, &pcnt);
+	pcnt.Counted = Pcnt.Value;
+
+	CHECK(debounced.Counted == m->Pulses);
+	CHECK(pcnt.Counted == m->Pulses * (m->Bounces + 1));
+	CHECK(irq.Counted == m->Pulses * (m->Bounces + 1));
+	printf("%-28s %8lu %8.1f %8lu %8.1f %8lu %8.1f\n", m->Name,
+			irq.Counted, irq.Wakeups * 10000.0 / m->Pulses,
+			debounced.Counted, debounced.Wakeups * 10000.0 / m->Pulses,
+			pcnt.Counted, pcnt.Wakeups * 10000.0 / m->Pulses);
+}
+
+int main(void) {
+	static const METER meters[] = {
+		{ "10k pulses, 1 Hz",				10000,	TICKS_PER_S,	0,	0 },
+		{ "10k pulses, 10 Hz",				10000,	TICKS_PER_S / 10,	0,	0xFFFF0000UL },
+		{ "200k pulses, 20 Hz",				200000,	TICKS_PER_S / 20,	0,	12345 },
+		{ "10k pulses, 1 Hz, 3 bounces",	10000,	TICKS_PER_S,	3,	0xFFFFFFFFUL - TICKS_PER_S },
+	};
+	unsigned long last;
+	unsigned short count;
+
+	// Debounce limits, across the time base wrap
+	last = 0xFFFFFFF0UL;
+	CHECK(PulseCountDebounce(&last, 0xFFFFFFF0UL + DEBOUNCE - 1, DEBOUNCE) == false);
+	CHECK(last == 0xFFFFFFF0UL);
+	CHECK(PulseCountDebounce(&last, 0xFFFFFFF0UL + DEBOUNCE, DEBOUNCE) == true);
+	CHECK(last == (unsigned long)(0xFFFFFFF0UL + DEBOUNCE));
+	CHECK(PulseCountDebounce(&last, last, 0) == true);
+	// Counter delta across the counter wrap
+	count = 0xFFF0;
+	CHECK(PulseCountDelta(&count, 0x0010) == 0x20);
+	CHECK(count == 0x0010);
+	CHECK(PulseCountDelta(&count, 0x0010) == 0);
+
+	printf("%-28s %17s %17s %17s\n", "", "edge IRQ", "debounced IRQ", "PCNT");
+	printf("%-28s %8s %8s %8s %8s %8s %8s\n", "meter", "counted", "wake/10k", "counted", "wake/10k", "counted", "wake/10k");
+	for (int i = 0; i < sizeof(meters) / sizeof(meters[0]); i++) Run(&meters[i]);
+	return TEST_END();
+}
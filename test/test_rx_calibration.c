@@ -0,0 +1,267 @@
+/*******************************************************************
+**                                                                **
+** RX windows calibration host tests                              **
+**                                                                **
+*******************************************************************/
+/*
+ * Checks that rx-calibration.c keeps the constant timing error and the crystal drift apart:
+ * a constant error measured in RX1 at 1 s shifts the RX2 window at 2 s and the JoinAccept
+ * windows at 5 and 6 s by the same amount, a drift measured at several delays shifts them
+ * in proportion. Then simulates a class A node for two weeks on a TX/RX timeline: crystal
+ * drifting with the temperature, TX done and RX done IRQ latencies, time on air rounded to
+ * the ms, RX1 at SF7 and RX2 at SF12, confirmed uplinks and joins expecting a downlink. The
+ * windows are sized as by RegionCommonComputeRxWindowParameters and the radio catches a
+ * downlink when enough preamble symbols fall in the window. The calibrated windows must
+ * catch the downlinks which the worst case windows catch, with less RX time: an error
+ * normalized per second of delay would miss the JoinAccept windows at 5 s.
+ */
+
+#include <math.h>
+#include <stdlib.h>
+#include "rx-calibration.h"
+#include "test.h"
+
+/** @cond */
+#define MAX_RX_ERROR		10				// SystemMaxRxError default in ms
+#define MIN_RX_SYMBOLS		6				// MinRxSymbols default
+#define MIN_RX_ERROR		5				// RXCAL_MIN_ERROR of rx-calibration.c
+#define PREAMBLE_SYMBOLS	8
+#define RX1_DELAY			1000
+#define RX2_DELAY			2000
+#define JOIN1_DELAY			5000
+#define JOIN2_DELAY			6000
+#define UPLINK_PERIOD		600.0			// Seconds between uplinks
+#define SIMULATED_DAYS		14
+#define WARM_UP_DAYS		1				// Calibration gets its samples
+#define TX_LATENCY			300.0			// TX done IRQ time stamp latency in us
+#define RX_LATENCY			2500.0			// RX done time stamp latency in us (DIO IRQ, then the radio task)
+#define IRQ_JITTER			100.0			// IRQ latency variation in us
+
+typedef struct {
+	const char*		Name;
+	double			Offset, Curvature;		// Crystal error in ppm at 25 °C, parabolic in ppm/°C²
+} CRYSTAL;
+
+static const CRYSTAL Crystals[] = {
+	{ "nominal", 0, -0.034 },
+	{ "fast", 40, -0.034 },
+	{ "slow", -60, -0.040 },
+};
+
+typedef struct {
+	unsigned long	Downlinks, Caught, BaseCaught;
+	double			OnTime, BaseOnTime;		// RX time in ms
+} WINDOW_STATS;
+
+static double Now;							// Real time in s
+static double NodeUs;						// Node time in us
+static double Ppm;							// Crystal error
+/** @endcond */
+
+static double Random(double range) {
+	return range * (2.0 * rand() / RAND_MAX - 1);
+}
+
+/*
+ * Node time of an event dt us of real time from now
+ */
+static double NodeTime(double dt) {
+	return NodeUs + dt * (1 + Ppm * 1e-6);
+}
+
+/*
+ * Samples at some delays, with a constant error and a drift in ppm
+ */
+static void Calibrate(int count, const uint32_t* delays, int delayCount, double constant, double drift) {
+	uint32_t error;
+	int32_t shift;
+	for (int i = 0; i < count; i++) {
+		uint32_t delay = delays[i % delayCount];
+		RxCalibrationGetWindow(delay, MAX_RX_ERROR, &error, &shift);
+		NodeUs = 1e6 * i;
+		RxCalibrationTxDone();
+		NodeUs += delay * 1000.0 + constant + drift * delay / 1000;
+		RxCalibrationRxDone(0);
+		RxCalibrationRxValid(delay);
+	}
+}
+
+static int32_t Shift(uint32_t delay, uint32_t* error) {
+	int32_t shift;
+	RxCalibrationGetWindow(delay, MAX_RX_ERROR, error, &shift);
+	return shift;
+}
+
+static void TestConstantAndDrift(void) {
+	static const uint32_t rx1[] = { RX1_DELAY };
+	static const uint32_t both[] = { RX1_DELAY, RX1_DELAY, RX1_DELAY, RX2_DELAY };
+	uint32_t error, error2, error5;
+
+	// Not calibrated before the temperature and the samples are known
+	RxCalibrationInit();
+	CHECK(Shift(RX1_DELAY, &error) == 0);
+	CHECK(error == MAX_RX_ERROR);
+	RxCalibrationSetTemperature(250);
+	CHECK(Shift(RX1_DELAY, &error) == 0);
+	CHECK(error == MAX_RX_ERROR);
+
+	// A constant error in RX1 only: the same shift at every delay, wider windows further away
+	Calibrate(20, rx1, 1, 2400, 0);
+	CHECK(Shift(RX1_DELAY, &error) == 2);
+	CHECK(Shift(RX2_DELAY, &error2) == 2);
+	CHECK(Shift(JOIN1_DELAY, &error5) == 2);
+	CHECK(Shift(JOIN2_DELAY, &error5) == 2);
+	CHECK((error == MIN_RX_ERROR) && (error2 >= error) && (error5 >= error2));
+
+	// A drift of 180 ppm and no constant error, measured at 1 and 2 s
+	RxCalibrationInit();
+	RxCalibrationSetTemperature(250);
+	Calibrate(40, both, 4, 0, 180);
+	CHECK(Shift(RX1_DELAY, &error) == 0);
+	CHECK(Shift(RX2_DELAY, &error) == 0);
+	CHECK(Shift(JOIN1_DELAY, &error) == 1);
+	CHECK(Shift(JOIN2_DELAY, &error) == 1);
+	CHECK(Shift(15000, &error) == 3);
+
+	// Both: 1500 us constant error and 150 ppm
+	RxCalibrationInit();
+	RxCalibrationSetTemperature(250);
+	Calibrate(40, both, 4, 1500, 150);
+	CHECK(Shift(RX1_DELAY, &error) == 2);
+	CHECK(Shift(RX2_DELAY, &error) == 2);
+	CHECK(Shift(JOIN2_DELAY, &error) == 2);
+	CHECK(Shift(15000, &error) == 4);
+
+	// A drift beyond any crystal is limited to 200 ppm
+	RxCalibrationInit();
+	RxCalibrationSetTemperature(250);
+	Calibrate(40, both, 4, 0, 400);
+	CHECK(Shift(RX2_DELAY, &error) == 1);
+	CHECK(Shift(15000, &error) == 3);
+}
+
+/*******************************************************************
+** Simulation                                                     **
+*******************************************************************/
+/*
+ * Advance the real time, the crystal follows a daily temperature cycle
+ */
+static double Advance(double seconds) {
+	double temperature = 15 + 20 * sin(2 * M_PI * Now / 86400);
+	NodeUs = NodeTime(seconds * 1e6);
+	Now += seconds;
+	return temperature;
+}
+
+/*
+ * RX window opened delay ms after TX done, as computed by LoRaMac: returns true if the
+ * preamble, sent at preamble us of real time after TX done, is detected. The RX time is
+ * accumulated until the detection or the timeout.
+ */
+static bool Window(double txStamp, uint32_t delay, uint32_t rxError, int32_t rxShift, double symbol,
+		double preamble, double* onTime) {
+	uint32_t timeout = (uint32_t)ceil(((2 * MIN_RX_SYMBOLS - 8) * symbol + 2 * rxError) / symbol);
+	if (timeout < MIN_RX_SYMBOLS) timeout = MIN_RX_SYMBOLS;
+	int32_t offset = (int32_t)ceil(4.0 * symbol - timeout * symbol / 2.0) + rxShift;
+	// The node timer runs on its crystal from the TX done time stamp
+	double start = txStamp + (delay + offset) * 1000 / (1 + Ppm * 1e-6);
+	double end = start + timeout * symbol * 1000 / (1 + Ppm * 1e-6);
+	bool detected = (start <= preamble + (PREAMBLE_SYMBOLS - MIN_RX_SYMBOLS) * symbol * 1000) &&
+			(end >= preamble + MIN_RX_SYMBOLS * symbol * 1000);
+	*onTime += ((detected) ? preamble + MIN_RX_SYMBOLS * symbol * 1000 - start : end - start) / 1000;
+	return detected;
+}
+
+/*
+ * Uplink and its RX windows, with the worst case windows of the same timeline as reference
+ */
+static void Uplink(bool join, WINDOW_STATS* stats) {
+	static const double symbols[2] = { 1.024, 32.768 };	// RX1 at SF7, RX2 at SF12 (125 kHz)
+	uint32_t delays[2] = { join ? JOIN1_DELAY : RX1_DELAY, join ? JOIN2_DELAY : RX2_DELAY };
+	uint32_t rxError[2];
+	int32_t rxShift[2];
+	double temperature = Advance(UPLINK_PERIOD);
+	RxCalibrationSetTemperature((int16_t)lrint(temperature * 10));
+	for (int w = 0; w < 2; w++) RxCalibrationGetWindow(delays[w], MAX_RX_ERROR, &rxError[w], &rxShift[w]);
+
+	// TX done: time stamped with the IRQ latency, real time origin of the windows
+	double txLatency = TX_LATENCY + Random(IRQ_JITTER);
+	double saved = NodeUs;
+	NodeUs = NodeTime(txLatency);
+	RxCalibrationTxDone();
+	NodeUs = saved;
+	double txStamp = txLatency;
+
+	// Network answer: joins and confirmed uplinks expect one
+	bool expected = join || (rand() % 100 < 30);
+	bool sent = (expected) ? (rand() % 100 < 95) : (rand() % 100 < 5);
+	int window = (rand() % 100 < 70) ? 0 : 1;
+	bool caught = false, baseCaught = false;
+	double* onTime[2] = { &stats[0].OnTime, &stats[1].OnTime };
+	for (int w = 0; w < 2; w++) {
+		double preamble = (sent && (w == window)) ? delays[w] * 1000.0 : 1e12;
+		if (sent && (w == window)) stats[w].Downlinks++;
+		if (!caught && Window(txStamp, delays[w], rxError[w], rxShift[w], symbols[w], preamble, onTime[w])) {
+			caught = true;
+			stats[w].Caught++;
+			// RX done: time on air rounded up to the ms, time stamped with the IRQ latency
+			double airTime = (w == 0) ? 56576 : 1155072;		// 12 bytes at SF7 and at SF12
+			NodeUs = NodeTime(preamble + airTime + RX_LATENCY + Random(IRQ_JITTER));
+			RxCalibrationRxDone((uint32_t)ceil(airTime / 1000));
+			NodeUs = saved;
+			RxCalibrationRxValid(delays[w]);
+		}
+		if (!baseCaught && Window(txStamp, delays[w], MAX_RX_ERROR, 0, symbols[w], preamble, &stats[w].BaseOnTime)) {
+			baseCaught = true;
+			stats[w].BaseCaught++;
+		}
+	}
+	if (expected && !caught) RxCalibrationRxMissed();
+}
+
+static void Simulate(const CRYSTAL* crystal) {
+	WINDOW_STATS warm[2], stats[2];
+	RxCalibrationStats_t calibration;
+	memset(stats, 0, sizeof(stats));
+	RxCalibrationInit();
+	Now = 0;
+	NodeUs = 0;
+	int uplinks = (int)(SIMULATED_DAYS * 86400 / UPLINK_PERIOD);
+	for (int u = 0; u < uplinks; u++) {
+		if (u == (int)(WARM_UP_DAYS * 86400 / UPLINK_PERIOD)) {
+			memcpy(warm, stats, sizeof(warm));
+			memset(stats, 0, sizeof(stats));
+		}
+		double temperature = 15 + 20 * sin(2 * M_PI * Now / 86400);
+		Ppm = crystal->Offset + crystal->Curvature * (temperature - 25) * (temperature - 25);
+		Uplink((u % 144) == 0, stats);			// Rejoins daily
+	}
+	RxCalibrationGetStats(&calibration);
+	for (int w = 0; w < 2; w++) {
+		// Less than 0.5% of the downlinks lost, none in the first day of a nominal crystal
+		CHECK(stats[w].BaseCaught == stats[w].Downlinks);
+		CHECK(stats[w].Caught * 1000 >= stats[w].BaseCaught * 995);
+		CHECK(warm[w].Caught + 10 >= warm[w].BaseCaught);
+		printf("crystal %-7s RX%d: %5lu downlinks, %5lu caught (%lu with the worst case), RX time %6.0f s (%6.0f s) %4.1f%% less\n",
+				crystal->Name, w + 1, stats[w].Downlinks, stats[w].Caught, stats[w].BaseCaught, stats[w].OnTime / 1000,
+				stats[w].BaseOnTime / 1000, 100 * (1 - stats[w].OnTime / stats[w].BaseOnTime));
+	}
+	// RX1 at SF7 is mostly the error margin, RX2 at SF12 is the minimum symbols either way
+	CHECK(stats[0].OnTime < stats[0].BaseOnTime * 0.75);
+	CHECK(stats[1].OnTime < stats[1].BaseOnTime * 1.01);
+	CHECK(calibration.Calibrated > calibration.Windows * 9 / 10);
+}
+
+/*******************************************************************
+** Emulated seams                                                 **
+*******************************************************************/
+uint32_t RtcGetTimerValueUs(void) {
+	return (uint32_t)(uint64_t)NodeUs;
+}
+
+int main(void) {
+	srand(32);
+	TestConstantAndDrift();
+	for (unsigned int c = 0; c < sizeof(Crystals) / sizeof(Crystals[0]); c++) Simulate(&Crystals[c]);
+	return TEST_END();
+}
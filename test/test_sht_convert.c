@@ -0,0 +1,109 @@
+/*******************************************************************
+**                                                                **
+** sht_convert.c host tests                                       **
+**                                                                **
+*******************************************************************/
+/*
+ * Compares the fixed point conversions with the datasheet formulas evaluated in double,
+ * exhaustively: every 14 bits temperature reading, every 14 bits x 12 bits pair for the
+ * compensated humidity, and every temperature reading with every humidity in 0.01 %RH for
+ * the dew point. The largest errors are checked against the bounds documented in
+ * sht_convert.h and printed.
+ */
+
+#include <math.h>
+#include "sht_convert.h"
+#include "test.h"
+
+/*
+ * Reference: datasheet formulas, results in 0.01 units
+ */
+static double RefTemperature(unsigned short raw) {
+	return SHT_D1 + (double)raw;
+}
+
+static double RefHumidity(unsigned short raw) {
+	double s = raw;
+	return (-2.0468 + 0.0367 * s - 1.5955E-6 * s * s) * 100;
+}
+
+static double RefCompensateHumidity(unsigned short raw, long temperature) {
+	double rh = (temperature / 100.0 - 25) * (0.01 + 0.00008 * raw) * 100 + RefHumidity(raw);
+	return (rh < 0) ? 0 : ((rh > 10000) ? 10000 : rh);
+}
+
+static double RefDewPoint(long humidity, long temperature) {
+	double t = temperature / 100.0;
+	double tn = (t < 0) ? 272.62 : 243.12;
+	double m = (t < 0) ? 22.46 : 17.62;
+	double g = log(humidity / 10000.0) + m * t / (tn + t);
+	return tn * g / (m - g) * 100;
+}
+
+static void TestTemperature(void) {
+	double worst = 0;
+	for (unsigned int raw = 0; raw < 0x4000; raw++) {
+		double error = fabs(SHTConvertTemperature((unsigned short)raw) - RefTemperature((unsigned short)raw));
+		CHECK(error == 0);
+		if (error > worst) worst = error;
+		// Only the 14 bits of the reading are used
+		CHECK(SHTConvertTemperature((unsigned short)(raw | 0xC000)) == SHTConvertTemperature((unsigned short)raw));
+	}
+	printf("temperature: largest error %.3f\n", worst);
+}
+
+static void TestHumidity(void) {
+	double worst = 0, worstCompensated = 0;
+	for (unsigned int raw = 0; raw < 0x1000; raw++) {
+		double error = fabs(SHTConvertHumidity((unsigned short)raw) - RefHumidity((unsigned short)raw));
+		CHECK(error <= 0.51);
+		if (error > worst) worst = error;
+		CHECK(SHTConvertHumidity((unsigned short)(raw | 0xF000)) == SHTConvertHumidity((unsigned short)raw));
+		for (unsigned int t = 0; t < 0x4000; t++) {
+			long temperature = SHTConvertTemperature((unsigned short)t);
+			long rh = SHTCompensateHumidity((unsigned short)raw, temperature);
+			error = fabs(rh - RefCompensateHumidity((unsigned short)raw, temperature));
+			CHECK(error <= 1.01);
+			CHECK((rh >= 0) && (rh <= 10000));
+			if (error > worstCompensated) worstCompensated = error;
+		}
+	}
+	printf("linear humidity: largest error %.3f\n", worst);
+	printf("compensated humidity: largest error %.3f\n", worstCompensated);
+}
+
+static void TestDewPoint(void) {
+	double worst = 0;
+	long worstHumidity = 0, worstTemperature = 0;
+	for (unsigned int t = 0; t < 0x4000; t++) {
+		long temperature = SHTConvertTemperature((unsigned short)t);
+		long last = -100000;
+		for (long humidity = 1; humidity <= 10000; humidity++) {
+			long dew = SHTDewPoint(humidity, temperature);
+			double error = fabs(dew - RefDewPoint(humidity, temperature));
+			CHECK(error <= 2);
+			if (error > worst) {
+				worst = error;
+				worstHumidity = humidity;
+				worstTemperature = temperature;
+			}
+			// Rises with the humidity, within the rounding, and the air is never below its dew point
+			CHECK(dew >= last - 1);
+			CHECK(dew <= temperature + 2);
+			last = dew;
+		}
+		// Out of range humidities are clipped
+		CHECK(SHTDewPoint(0, temperature) == SHTDewPoint(1, temperature));
+		CHECK(SHTDewPoint(-500, temperature) == SHTDewPoint(1, temperature));
+		CHECK(SHTDewPoint(10500, temperature) == SHTDewPoint(10000, temperature));
+	}
+	printf("dew point: largest error %.3f at %ld.%02ld %%RH, %.2f C\n", worst,
+			worstHumidity / 100, worstHumidity % 100, worstTemperature / 100.0);
+}
+
+int main(void) {
+	TestTemperature();
+	TestHumidity();
+	TestDewPoint();
+	return TEST_END();
+}
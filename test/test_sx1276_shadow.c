@@ -0,0 +1,438 @@
+/*******************************************************************
+**                                                                **
+** SX1276 register shadow unit tests and SPI benchmark            **
+**                                                                **
+*******************************************************************/
+/*
+ * The SX1276 driver runs against a register level emulator of the radio: two register pages
+ * switched by LongRangeMode, the FIFO with its address pointer, write-one-to-clear IRQ flags, the
+ * image calibration and the modem state changes done by the chip itself (TxDone, RxDone and
+ * RxTimeout back to standby, reset).
+ *
+ * The LoRaMac KR920 call sequences (initialisation, LBT + uplink + RX1/RX2, a downlink in RX1,
+ * the Tx timeout workaround) are run twice:
+ * - verification pass: after every driver call and every chip event, every register read
+ *   through SX1276Read must match the emulated chip (the shadow never serves a stale value, so a
+ *   skipped write is always a no-op), and the resulting configuration is checked,
+ * - counting pass: SPI transactions and bytes of each sequence, to compare this build with
+ *   SX1276_REG_SHADOW set to 0 (test_sx1276_plain).
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "board.h"
+#include "test.h"
+
+/** @cond */
+#ifndef SX1276_REG_SHADOW
+#define SX1276_REG_SHADOW	1
+#endif
+#define CHANNELS			3
+#define RX2_FREQUENCY		921900000
+#define CYCLES				10
+
+static const uint32_t Channels[CHANNELS] = { 922100000, 922300000, 922500000 };
+
+// Emulated radio
+static uint8_t EmuCommon[0x80];			// Registers shared by both modems and FSK page
+static uint8_t EmuLoRa[0x80];			// LoRa page, 0x0D to 0x3F
+static uint8_t EmuFifo[256];
+static uint8_t EmuFskFifo;
+static bool EmuSelected;
+static int EmuByte;
+static uint8_t EmuAddr;
+static bool EmuWrite;
+static unsigned long EmuFrames, EmuBytes;
+
+static DioIrqHandler** EmuDio;
+static struct {
+	unsigned TxDone, RxDone, RxTimeout, TxTimeout;
+	uint8_t Size;
+} Events;
+static TimerTime_t Now;
+static bool Verify;
+/** @endcond */
+
+/*
+ * Emulated radio
+ */
+static bool EmuIsLoRa(void) {
+	return (EmuCommon[REG_OPMODE] & RFLR_OPMODE_LONGRANGEMODE_ON) != 0;
+}
+
+static uint8_t* EmuReg(uint8_t addr) {
+	if (EmuIsLoRa() && (addr >= 0x0D) && (addr <= 0x3F)) return &EmuLoRa[addr];
+	return &EmuCommon[addr];
+}
+
+static uint8_t EmuMode(void) {
+	return EmuCommon[REG_OPMODE] & ~RF_OPMODE_MASK;
+}
+
+static void EmuSetMode(uint8_t mode) {
+	EmuCommon[REG_OPMODE] = (EmuCommon[REG_OPMODE] & RF_OPMODE_MASK) | mode;
+}
+
+static void EmuReset(void) {
+	static const uint8_t common[][2] = {
+		{ REG_OPMODE, 0x09 }, { REG_FRFMSB, 0x6C }, { REG_FRFMID, 0x80 }, { REG_FRFLSB, 0x00 },
+		{ REG_PACONFIG, 0x4F }, { REG_PARAMP, 0x09 }, { REG_OCP, 0x2B }, { REG_LNA, 0x20 },
+		{ REG_RXCONFIG, 0x0E }, { REG_RSSICONFIG, 0x02 }, { REG_PREAMBLEDETECT, 0x40 },
+		{ REG_SYNCCONFIG, 0x93 }, { REG_PACKETCONFIG1, 0x90 }, { REG_PAYLOADLENGTH, 0x40 },
+		{ REG_FIFOTHRESH, 0x0F }, { REG_IMAGECAL, 0x82 }, { REG_DIOMAPPING1, 0x00 },
+		{ REG_DIOMAPPING2, 0x00 }, { REG_VERSION, 0x12 }, { REG_PLLHOP, 0x2D }, { REG_TCXO, 0x09 },
+		{ REG_PADAC, 0x84 },
+	};
+	static const uint8_t lora[][2] = {
+		{ REG_LR_FIFOTXBASEADDR, 0x80 }, { REG_LR_MODEMCONFIG1, 0x72 }, { REG_LR_MODEMCONFIG2, 0x70 },
+		{ REG_LR_SYMBTIMEOUTLSB, 0x64 }, { REG_LR_PREAMBLELSB, 0x08 }, { REG_LR_PAYLOADLENGTH, 0x01 },
+		{ REG_LR_PAYLOADMAXLENGTH, 0xFF }, { REG_LR_MODEMCONFIG3, 0x04 }, { REG_LR_TEST2F, 0x40 },
+		{ REG_LR_DETECTOPTIMIZE, 0xC3 }, { REG_LR_INVERTIQ, 0x27 }, { REG_LR_TEST36, 0x03 },
+		{ REG_LR_DETECTIONTHRESHOLD, 0x0A }, { REG_LR_SYNCWORD, 0x12 }, { REG_LR_TEST3A, 0x65 },
+		{ REG_LR_INVERTIQ2, 0x1D },
+	};
+
+	memset(EmuCommon, 0, sizeof(EmuCommon));
+	memset(EmuLoRa, 0, sizeof(EmuLoRa));
+	for (int i = 0; i < sizeof(common) / sizeof(common[0]); i++) EmuCommon[common[i][0]] = common[i][1];
+	for (int i = 0; i < sizeof(lora) / sizeof(lora[0]); i++) EmuLoRa[lora[i][0]] = lora[i][1];
+}
+
+static uint8_t EmuRead(uint8_t addr) {
+	if (addr == REG_FIFO) {
+		if (!EmuIsLoRa()) return EmuFifo[EmuFskFifo++];
+		return EmuFifo[EmuLoRa[REG_LR_FIFOADDRPTR]++];
+	}
+	if (EmuIsLoRa() && ((addr == REG_LR_RSSIWIDEBAND) || (addr == REG_LR_RSSIVALUE))) {
+		return (uint8_t)(rand() & 0x1F);	// Noise floor
+	}
+	return *EmuReg(addr);
+}
+
+static void EmuWriteReg(uint8_t addr, uint8_t value) {
+	if (addr == REG_FIFO) {
+		if (!EmuIsLoRa()) EmuFifo[EmuFskFifo++] = value;
+		else EmuFifo[EmuLoRa[REG_LR_FIFOADDRPTR]++] = value;
+	} else if (addr == REG_OPMODE) {
+		// LongRangeMode can only be changed in sleep mode
+		if (EmuMode() != RF_OPMODE_SLEEP) value = (value & RFLR_OPMODE_LONGRANGEMODE_MASK) | (EmuCommon[REG_OPMODE] & RFLR_OPMODE_LONGRANGEMODE_ON);
+		EmuCommon[REG_OPMODE] = value;
+	} else if (addr == REG_VERSION) {
+		// Read only
+	} else if (EmuIsLoRa()) {
+		if (addr == REG_LR_IRQFLAGS) EmuLoRa[addr] &= ~value;
+		else if ((addr == REG_LR_FIFORXCURRENTADDR) || ((addr >= REG_LR_RXNBBYTES) && (addr <= REG_LR_HOPCHANNEL)) ||
+				(addr == REG_LR_FIFORXBYTEADDR)) {
+			// Read only
+		} else *EmuReg(addr) = value;
+	} else if (addr == REG_IMAGECAL) {
+		// The calibration completes at once
+		EmuCommon[addr] = value & ~(RF_IMAGECAL_IMAGECAL_START | RF_IMAGECAL_IMAGECAL_RUNNING);
+	} else EmuCommon[addr] = value;
+}
+
+void EmuPin(Gpio_t* pin, int level) {
+	if (pin == &SX1276.Reset) {
+		if (level == 0) EmuReset();
+	} else if (pin == &SX1276.Spi.Nss) {
+		if ((level == 0) && !EmuSelected) {
+			EmuFrames++;
+			EmuByte = 0;
+		}
+		EmuSelected = (level == 0);
+	}
+}
+
+uint8_t EmuSpi(uint8_t out) {
+	uint8_t in = 0;
+
+	CHECK(EmuSelected);
+	EmuBytes++;
+	if (EmuByte++ == 0) {
+		EmuAddr = out & 0x7F;
+		EmuWrite = (out & 0x80) != 0;
+		return 0;
+	}
+	if (EmuWrite) EmuWriteReg(EmuAddr, out);
+	else in = EmuRead(EmuAddr);
+	if (EmuAddr != REG_FIFO) EmuAddr++;
+	return in;
+}
+
+/*
+ * Modem events done by the chip
+ */
+static void EmuTxDone(void) {
+	CHECK(EmuIsLoRa() && (EmuMode() == RFLR_OPMODE_TRANSMITTER));
+	EmuSetMode(RFLR_OPMODE_STANDBY);
+	EmuLoRa[REG_LR_IRQFLAGS] |= RFLR_IRQFLAGS_TXDONE;
+	CHECK((EmuCommon[REG_DIOMAPPING1] & ~RFLR_DIOMAPPING1_DIO0_MASK) == RFLR_DIOMAPPING1_DIO0_01);
+	EmuDio[0]();
+}
+
+static void EmuRxDone(const uint8_t* payload, uint8_t size) {
+	uint8_t base = EmuLoRa[REG_LR_FIFORXBASEADDR];
+
+	CHECK(EmuIsLoRa() && (EmuMode() == RFLR_OPMODE_RECEIVER_SINGLE));
+	for (int i = 0; i < size; i++) EmuFifo[(uint8_t)(base + i)] = payload[i];
+	EmuLoRa[REG_LR_FIFORXCURRENTADDR] = base;
+	EmuLoRa[REG_LR_FIFORXBYTEADDR] = base + size;
+	EmuLoRa[REG_LR_RXNBBYTES] = size;
+	EmuLoRa[REG_LR_PKTSNRVALUE] = 0x20;
+	EmuLoRa[REG_LR_PKTRSSIVALUE] = 0x40;
+	EmuSetMode(RFLR_OPMODE_STANDBY);
+	EmuLoRa[REG_LR_IRQFLAGS] |= RFLR_IRQFLAGS_RXDONE;
+	CHECK((EmuCommon[REG_DIOMAPPING1] & ~RFLR_DIOMAPPING1_DIO0_MASK) == RFLR_DIOMAPPING1_DIO0_00);
+	EmuDio[0]();
+}
+
+static void EmuRxTimeout(void) {
+	CHECK(EmuIsLoRa() && (EmuMode() == RFLR_OPMODE_RECEIVER_SINGLE));
+	EmuSetMode(RFLR_OPMODE_STANDBY);
+	EmuLoRa[REG_LR_IRQFLAGS] |= RFLR_IRQFLAGS_RXTIMEOUT;
+	CHECK((EmuCommon[REG_DIOMAPPING1] & ~RFLR_DIOMAPPING1_DIO1_MASK) == RFLR_DIOMAPPING1_DIO1_00);
+	EmuDio[1]();
+}
+
+/*
+ * Driver environment
+ */
+void SX1276OnTimeoutIrq(void);
+void memcpy1(uint8_t *dst, const uint8_t *src, uint16_t size) { memcpy(dst, src, size); }
+void TimerInit(TimerEvent_t *obj, void (*callback)(void)) { }
+void TimerStart(TimerEvent_t *obj) { }
+void TimerStop(TimerEvent_t *obj) { }
+void TimerSetValue(TimerEvent_t *obj, uint32_t value) { }
+TimerTime_t TimerGetCurrentTime(void) { return Now; }
+TimerTime_t TimerGetElapsedTime(TimerTime_t savedTime) { return ++Now - savedTime; }
+
+void SX1276IoIrqInit(DioIrqHandler **irqHandlers) { EmuDio = irqHandlers; }
+void SX1276SetAntSwLowPower(bool status) { }
+void SX1276SetAntSw(uint8_t opMode) { }
+bool SX1276CheckRfFrequency(uint32_t frequency) { return true; }
+
+// Same register accesses as LoRaWAN/sx1276-board.c
+uint8_t SX1276GetPaSelect(uint32_t channel) {
+	return (channel > RF_MID_BAND_THRESH) ? RF_PACONFIG_PASELECT_PABOOST : RF_PACONFIG_PASELECT_RFO;
+}
+
+void SX1276SetRfTxPower(int8_t power) {
+	uint8_t paConfig = SX1276Read(REG_PACONFIG);
+	uint8_t paDac = SX1276Read(REG_PADAC);
+
+	paConfig = (paConfig & RF_PACONFIG_PASELECT_MASK) | SX1276GetPaSelect(SX1276.Settings.Channel);
+	paConfig = (paConfig & RF_PACONFIG_MAX_POWER_MASK) | 0x70;
+	if (power > 17) paDac = (paDac & RF_PADAC_20DBM_MASK) | RF_PADAC_20DBM_ON;
+	else paDac = (paDac & RF_PADAC_20DBM_MASK) | RF_PADAC_20DBM_OFF;
+	if (power < 2) power = 2;
+	if (power > 17) power = 17;
+	paConfig = (paConfig & RF_PACONFIG_OUTPUTPOWER_MASK) | (uint8_t)((power - 2) & 0x0F);
+	SX1276Write(REG_PACONFIG, paConfig);
+	SX1276Write(REG_PADAC, paDac);
+}
+
+static void OnTxDone(void) { Events.TxDone++; }
+static void OnRxDone(uint8_t *payload, uint16_t size, int16_t rssi, int8_t snr) {
+	Events.RxDone++;
+	Events.Size = size;
+}
+static void OnTxTimeout(void) { Events.TxTimeout++; }
+static void OnRxTimeout(void) { Events.RxTimeout++; }
+static RadioEvents_t RadioEvents = { OnTxDone, OnTxTimeout, OnRxDone, OnRxTimeout, NULL, NULL, NULL };
+
+/*
+ * Verification
+ */
+static void CheckCoherent(const char* step) {
+	if (!Verify) return;
+	for (uint8_t addr = 1; addr < 0x50; addr++) {
+		uint8_t driver, chip;
+
+		if (EmuIsLoRa() && ((addr == REG_LR_RSSIWIDEBAND) || (addr == REG_LR_RSSIVALUE))) continue;
+		chip = *EmuReg(addr);
+		driver = SX1276Read(addr);
+		if (driver != chip) fprintf(stderr, "%s: register 0x%02X read 0x%02X, chip 0x%02X\n", step, addr, driver, chip);
+		CHECK(driver == chip);
+	}
+}
+
+static void CheckFrequency(uint32_t freq) {
+	uint32_t frf = ((uint32_t)EmuCommon[REG_FRFMSB] << 16) | ((uint32_t)EmuCommon[REG_FRFMID] << 8) | EmuCommon[REG_FRFLSB];
+
+	if (!Verify) return;
+	CHECK(frf == (uint32_t)((double)freq / FREQ_STEP));
+}
+
+static void CheckLoRa(uint8_t sf, bool iqInverted) {
+	if (!Verify) return;
+	CHECK(EmuIsLoRa());
+	CHECK((EmuLoRa[REG_LR_MODEMCONFIG1] & ~RFLR_MODEMCONFIG1_BW_MASK) == RFLR_MODEMCONFIG1_BW_125_KHZ);
+	CHECK((EmuLoRa[REG_LR_MODEMCONFIG2] >> 4) == sf);
+	CHECK(((EmuLoRa[REG_LR_MODEMCONFIG3] & ~RFLR_MODEMCONFIG3_LOWDATARATEOPTIMIZE_MASK) != 0) == (sf >= 11));
+	CHECK(EmuLoRa[REG_LR_PREAMBLEMSB] == 0 && EmuLoRa[REG_LR_PREAMBLELSB] == 8);
+	CHECK(EmuLoRa[REG_LR_SYNCWORD] == LORA_MAC_PUBLIC_SYNCWORD);
+	CHECK(EmuLoRa[REG_LR_INVERTIQ2] == (iqInverted ? RFLR_INVERTIQ2_ON : RFLR_INVERTIQ2_OFF));
+}
+
+/*
+ * LoRaMac call sequences, KR920 region
+ */
+static void MacInit(void) {
+	SX1276Init(&RadioEvents);
+	CheckCoherent("init");
+	srand(SX1276Random());
+	SX1276Random();
+	CheckCoherent("random");
+	SX1276SetPublicNetwork(true);
+	SX1276SetSleep();
+	CheckCoherent("public network");
+}
+
+static void MacUplink(uint32_t freq, uint8_t sf, uint8_t size) {
+	static uint8_t frame[255];
+	TimerTime_t timeOnAir;
+
+	// RegionKR920NextChannel: listen before talk
+	CHECK(SX1276IsChannelFree(MODEM_LORA, freq, -65, 6) == true);
+	CheckCoherent("LBT");
+	// RegionKR920TxConfig, SendFrameOnChannel
+	SX1276SetChannel(freq);
+	SX1276SetTxConfig(MODEM_LORA, 14, 0, 0, sf, 1, 8, false, true, 0, 0, false, 5000);
+	SX1276SetMaxPayloadLength(MODEM_LORA, size);
+	timeOnAir = SX1276GetTimeOnAir(MODEM_LORA, size);
+	CHECK(timeOnAir > 0);
+	SX1276Send(frame, size);
+	CheckCoherent("send");
+	CheckFrequency(freq);
+	CheckLoRa(sf, false);
+	if (Verify) {
+		CHECK(EmuMode() == RFLR_OPMODE_TRANSMITTER);
+		CHECK(EmuLoRa[REG_LR_PAYLOADLENGTH] == size);
+	}
+	EmuTxDone();
+	CHECK(SX1276GetStatus() == RF_IDLE);
+	// OnRadioTxDone
+	SX1276SetSleep();
+	CheckCoherent("tx done");
+}
+
+static void MacRxWindow(uint32_t freq, uint8_t sf, const uint8_t* downlink, uint8_t size) {
+	// RegionKR920RxConfig, RxWindowSetup
+	CHECK(SX1276GetStatus() == RF_IDLE);
+	SX1276SetChannel(freq);
+	SX1276SetRxConfig(MODEM_LORA, 0, sf, 1, 0, 8, 8, false, 0, false, 0, 0, true, false);
+	SX1276SetMaxPayloadLength(MODEM_LORA, 242 + 13);
+	SX1276SetRx(3000);
+	CheckCoherent("rx");
+	CheckFrequency(freq);
+	CheckLoRa(sf, true);
+	if (Verify) {
+		CHECK(EmuMode() == RFLR_OPMODE_RECEIVER_SINGLE);
+		CHECK(EmuLoRa[REG_LR_SYMBTIMEOUTLSB] == 8);
+	}
+	if (downlink) {
+		EmuRxDone(downlink, size);
+		CHECK(Events.Size == size);
+	} else EmuRxTimeout();
+	CHECK(SX1276GetStatus() == RF_IDLE);
+	// OnRadioRxDone, OnRadioRxTimeout
+	SX1276SetSleep();
+	CheckCoherent("rx done");
+}
+
+static void MacCycle(int cycle, bool downlink) {
+	static const uint8_t frame[20] = { 0x60, 0x04, 0x03, 0x02, 0x01 };
+	uint32_t freq = Channels[cycle % CHANNELS];
+
+	MacUplink(freq, 9, 24);
+	if (downlink) MacRxWindow(freq, 9, frame, sizeof(frame));
+	else {
+		MacRxWindow(freq, 9, NULL, 0);
+		MacRxWindow(RX2_FREQUENCY, 12, NULL, 0);
+	}
+}
+
+static void MacTxTimeout(void) {
+	static uint8_t frame[24];
+
+	SX1276SetChannel(Channels[0]);
+	SX1276SetTxConfig(MODEM_LORA, 14, 0, 0, 9, 1, 8, false, true, 0, 0, false, 5000);
+	SX1276Send(frame, sizeof(frame));
+	// Tx timer fired, the driver resets and restores the radio
+	SX1276OnTimeoutIrq();
+	CHECK(Events.TxTimeout == 1);
+	CheckCoherent("tx timeout");
+	if (Verify) {
+		CHECK(EmuIsLoRa());
+		CHECK(EmuLoRa[REG_LR_SYNCWORD] == LORA_MAC_PUBLIC_SYNCWORD);
+		CHECK(EmuCommon[REG_LNA] == 0x23);
+	}
+	SX1276SetSleep();
+	CheckCoherent("tx timeout sleep");
+}
+
+/*
+ * Runs the sequences, reports the SPI traffic of the counting pass
+ */
+static unsigned long Frames, Bytes;
+static void Count(void) {
+	Frames = EmuFrames;
+	Bytes = EmuBytes;
+}
+
+static void Report(const char* name, int runs) {
+	SX1276SpiStats_t stats;
+
+	if (Verify) return;
+	SX1276GetSpiStats(&stats);
+	CHECK(stats.Reads + stats.Writes == EmuFrames);
+	printf("%-36s %8.1f %8.1f\n", name, (double)(EmuFrames - Frames) / runs, (double)(EmuBytes - Bytes) / runs);
+	Count();
+}
+
+static void Run(bool verify) {
+	uint8_t value;
+
+	Verify = verify;
+	memset(&Events, 0, sizeof(Events));
+	memset(&SX1276, 0, sizeof(SX1276));
+	EmuFrames = EmuBytes = 0;
+	SX1276ResetSpiStats();
+	Count();
+
+	MacInit();
+	Report("init (Init, Random, SetPublicNetwork)", 1);
+	MacCycle(0, false);
+	Report("first uplink, RX1 + RX2 timeouts", 1);
+	for (int i = 1; i <= CYCLES; i++) MacCycle(i, false);
+	Report("next uplinks, RX1 + RX2 timeouts", CYCLES);
+	for (int i = 1; i <= CYCLES; i++) MacCycle(i, true);
+	Report("next uplinks, downlink in RX1", CYCLES);
+	CHECK(Events.TxDone == 1 + 2 * CYCLES);
+	CHECK(Events.RxTimeout == 2 * (1 + CYCLES));
+	CHECK(Events.RxDone == CYCLES);
+
+	// Writes through the radio interface bypass the shadow
+	SX1276SetModem(MODEM_LORA);
+	value = LORA_MAC_PRIVATE_SYNCWORD;
+	SX1276WriteBuffer(REG_LR_SYNCWORD, &value, 1);
+	CheckCoherent("write buffer");
+	SX1276SetPublicNetwork(true);
+	CheckCoherent("write buffer public network");
+	if (Verify) CHECK(EmuLoRa[REG_LR_SYNCWORD] == LORA_MAC_PUBLIC_SYNCWORD);
+	// FSK modem and back
+	SX1276SetModem(MODEM_FSK);
+	CheckCoherent("FSK");
+	SX1276SetModem(MODEM_LORA);
+	CheckCoherent("LoRa");
+	MacTxTimeout();
+	MacCycle(0, false);
+	Report("Tx timeout, uplink after reset", 1);
+}
+
+int main(void) {
+	printf("%-36s %8s %8s\n", (SX1276_REG_SHADOW == 1) ? "register shadow" : "no register shadow", "SPI xfer", "bytes");
+	Run(true);
+	Run(false);
+	return TEST_END();
+}
@@ -0,0 +1,356 @@
+/*******************************************************************
+**                                                                **
+** Time synchronization unit tests                                **
+**                                                                **
+*******************************************************************/
+/*
+ * src/time_sync.c and the RTC of EFM32_MMI/src/mcu_rtc.c run on top of an emulated time
+ * base driven by a drifting crystal: a constant error, a daily temperature cycle and some
+ * aging. The network answers DeviceTimeReq with its time at the end of the uplink, off by a
+ * random jitter, and some answers are lost. The sources are included to reset their state.
+ *
+ * Over 30 simulated days the RTC is compared with the true time every minute: once the
+ * drift is learned, the error must stay within TIMESYNC_BOUND_MS. A reset keeps the learned
+ * rate correction in its retention register, a power on reset does not.
+ */
+
+#include <math.h>
+#include <stdlib.h>
+#include "../EFM32_MMI/src/mcu_rtc.c"
+#include "../src/time_sync.c"
+#include "test.h"
+
+/** @cond */
+#define NVRAM_WORDS			32				// RTCC retention registers
+#define SIM_DAYS			30
+#define SIM_STEP			60				// Error sampling period (in seconds)
+#define UPLINK_PERIOD		(60 * 60)		// Periodic uplink (in seconds)
+#define TIME_ON_AIR			0.4				// Uplink time on air (in seconds)
+#define ANSWER_JITTER		0.020			// Network time error (in seconds, +/-)
+#define ANSWER_LOSS			10				// Lost answers (in %)
+#define START_TIME			(26UL * 365 * 86400 + 12345)	// True time at start up (since 01/01/2000)
+#define LEARN_DAYS			3				// Days before the error bound applies
+#define TIMESYNC_BOUND_MS	80				// Largest clock error once the drift is learned
+
+typedef struct {
+	double		Offset;				// Constant frequency error (in ppm)
+	double		Wander;				// Daily temperature cycle amplitude (in ppm)
+	double		Aging;				// Frequency change per day (in ppm)
+} CRYSTAL;
+
+static uint32_t		Nvram[NVRAM_WORDS];
+static CRYSTAL		Crystal;
+static double		Now;				// True time since start up (in seconds)
+static double		Ticks;				// Time base, fractional ticks kept
+static bool			bRequested;			// A DeviceTimeReq is pending
+static int			Requests;
+/** @endcond */
+
+/*******************************************************************
+** Emulated seams                                                 **
+*******************************************************************/
+void SystemIrqDisable(void) {
+}
+
+void SystemIrqEnable(void) {
+}
+
+int SystemGetNVRAMSize(void) {
+	return NVRAM_WORDS;
+}
+
+void SystemSetNVRAMValue(int index, int value) {
+	Nvram[index] = (uint32_t)value;
+}
+
+int SystemGetNVRAMValue(int index) {
+	return (int)Nvram[index];
+}
+
+uint64_t TimeBaseGetTicks64(void) {
+	return (uint64_t)Ticks;
+}
+
+unsigned long SystemGetSystemSeconds(void) {
+	return (unsigned long)(TimeBaseGetTicks64() >> TIMEBASE_SHIFT);
+}
+
+TimerTime_t TimerGetCurrentTime(void) {
+	return TimeBaseTicksToMs(TimeBaseGetTicks64());
+}
+
+bool LORAWAN_RequestDevTime(void) {
+	bRequested = true;
+	Requests++;
+	return true;
+}
+
+/*******************************************************************
+** Simulation                                                     **
+*******************************************************************/
+static double Frequency(double t) {
+	double ppm = Crystal.Offset + Crystal.Wander * sin(2 * M_PI * t / 86400) + Crystal.Aging * t / 86400;
+	return TIMEBASE_FREQUENCY * (1 + ppm * 1e-6);
+}
+
+static void Advance(double seconds) {
+	// Midpoint integration, the frequency changes slowly
+	Ticks += seconds * Frequency(Now + seconds / 2);
+	Now += seconds;
+}
+
+static double Random(double range) {
+	return range * (2.0 * rand() / RAND_MAX - 1);
+}
+
+/*
+ * RTC error (in ms)
+ */
+static double Error(void) {
+	double truth = ((double)START_TIME + Now) * TIMEBASE_FREQUENCY;
+	return ((double)RTCGetTicks() - truth) * 1000 / TIMEBASE_FREQUENCY;
+}
+
+/*
+ * Uplink, with the DeviceTimeAns when requested
+ */
+static void Uplink(void) {
+	Advance(TIME_ON_AIR);
+	TimerTime_t txDone = TimerGetCurrentTime();
+	double network = (double)START_TIME + Now + Random(ANSWER_JITTER);
+	bool bAnswer = bRequested && ((rand() % 100) >= ANSWER_LOSS);
+	// Receive windows, MAC and event processing
+	Advance(1 + 2.0 * rand() / RAND_MAX);
+	if (!bAnswer) return;
+	bRequested = false;
+	MlmeConfirm_t confirm = { 0 };
+	confirm.MlmeRequest = MLME_DEV_TIME;
+	confirm.Status = LORAMAC_EVENT_INFO_STATUS_OK;
+	confirm.Epoch = (uint32_t)floor(network) + TIMESYNC_EPOCH_OFFSET;
+	confirm.FracSec = (uint16_t)((network - floor(network)) * 65536);
+	confirm.TxDoneTime = txDone;
+	TIMESYNC_Confirm(&confirm);
+}
+
+/*
+ * Reset: the RAM state is lost, the time base keeps counting
+ */
+static void Reboot(bool bPowerOn) {
+	if (bPowerOn) memset(Nvram, 0, sizeof(Nvram));
+	_RTC_AnchorTicks = 0;
+	_RTC_AnchorTime = 86400ULL << TIMEBASE_SHIFT;
+	_RTC_Trim = 0;
+	memset(&Status, 0, sizeof(Status));
+	NextSync = 0;
+	Reference = 0;
+	Accumulated = 0;
+	bRequested = false;
+	TIMESYNC_Init();
+}
+
+/*
+ * Simulate SIM_DAYS days, reset on resetDay (none if negative)
+ * @return largest error (in ms) once the drift is learned, or after the reset
+ */
+static double Simulate(const CRYSTAL* crystal, int resetDay, bool bPowerOn, double* pResetError) {
+	double worst = 0, resetWorst = 0;
+	int resetSyncs = -1;
+	Crystal = *crystal;
+	Now = 0;
+	Ticks = 0;
+	Requests = 0;
+	srand(1);
+	Reboot(true);
+	for (int step = 1; step <= SIM_DAYS * 86400 / SIM_STEP; step++) {
+		Advance(SIM_STEP);
+		int day = (int)(Now / 86400);
+		if ((day == resetDay) && (resetSyncs < 0)) {
+			Reboot(bPowerOn);
+			resetSyncs = 0;
+		}
+		if ((step * SIM_STEP) % UPLINK_PERIOD == 0) {
+			if (TIMESYNC_IsDue()) TIMESYNC_Request();
+			Uplink();
+		}
+		// The RTC is unknown until the first synchronization
+		if (Status.Count == 0) continue;
+		double error = fabs(Error());
+		if (resetSyncs >= 0) {
+			if (day <= resetDay + 1) {
+				if (error > resetWorst) resetWorst = error;
+				continue;
+			}
+		}
+		if ((day >= LEARN_DAYS) && (error > worst)) worst = error;
+	}
+	if (pResetError) *pResetError = resetWorst;
+	return worst;
+}
+
+/*******************************************************************
+** Tests                                                          **
+*******************************************************************/
+static const CRYSTAL Crystals[] = {
+	{ 0, 0, 0 }, { 73, 0, 0 }, { -20, 1, 0 }, { 73, 2, 0.02 }, { -150, 1, -0.02 }, { 180, 2, 0 }
+};
+
+static void TestDrift(void) {
+	for (unsigned int i = 0; i < sizeof(Crystals) / sizeof(Crystals[0]); i++) {
+		const CRYSTAL* crystal = &Crystals[i];
+		double worst = Simulate(crystal, -1, false, NULL);
+		double expected = -crystal->Offset * 1000;
+		printf("crystal %+4.0f ppm, wander %.0f ppm, aging %+.2f ppm/day: trim %+7ld ppb, "
+				"error up to %.1f ms after day %d, %d requests\n", crystal->Offset, crystal->Wander,
+				crystal->Aging, RTCGetTrim(), worst, LEARN_DAYS, Requests);
+		CHECK(worst <= TIMESYNC_BOUND_MS);
+		// The trim follows the average frequency of the last day
+		expected -= crystal->Aging * 1000 * (SIM_DAYS - 0.5);
+		CHECK(fabs(RTCGetTrim() - expected) <= 1000);
+		// Daily synchronizations, and the retries of the lost answers
+		CHECK(Requests >= SIM_DAYS);
+		CHECK(Requests <= SIM_DAYS * 2);
+		CHECK((uint32_t)Nvram[TIMESYNC_NVRAM_INDEX] != 0);
+	}
+}
+
+static void TestReset(void) {
+	// A reset keeps the rate correction, a power on reset learns it again
+	for (unsigned int i = 0; i < sizeof(Crystals) / sizeof(Crystals[0]); i++) {
+		const CRYSTAL* crystal = &Crystals[i];
+		double resetError, powerOnError;
+		double worst = Simulate(crystal, 15, false, &resetError);
+		CHECK(worst <= TIMESYNC_BOUND_MS);
+		CHECK(resetError <= TIMESYNC_BOUND_MS);
+		Simulate(crystal, 15, true, &powerOnError);
+		printf("crystal %+4.0f ppm: error up to %.1f ms the day after a reset, %.1f ms after a power on reset\n",
+				crystal->Offset, resetError, powerOnError);
+		if (fabs(crystal->Offset) >= 20) CHECK(powerOnError > TIMESYNC_BOUND_MS);
+	}
+}
+
+static void TestCorrected(void) {
+	static const long Trims[] = { 0, 1, -1, 73000, -73000, TIMESYNC_MAX_TRIM, -TIMESYNC_MAX_TRIM };
+	Reboot(true);
+	for (unsigned int i = 0; i < sizeof(Trims) / sizeof(Trims[0]); i++) {
+		// Just below the 32 bits counter roll over
+		Ticks = 0xFFFFFF00UL + i * 1000;
+		RTCSetTicks(1000ULL << TIMEBASE_SHIFT);
+		CHECK(RTCGetTicks() == (1000ULL << TIMEBASE_SHIFT));
+		// The new rate applies from now on, without any step
+		uint64_t before = RTCGetTicks();
+		RTCSetTrim(Trims[i]);
+		CHECK(RTCGetTicks() == before);
+		CHECK(RTCGetTrim() == Trims[i]);
+		// Monotonic across the roll over
+		uint64_t last = before;
+		for (int t = 0; t < 1024; t++) {
+			Ticks += 1;
+			uint64_t time = RTCGetTicks();
+			CHECK(time >= last);
+			CHECK(time - last <= 2);
+			last = time;
+		}
+		// Rate over 30 days
+		uint64_t start = RTCGetTicks();
+		uint64_t elapsed = 30ULL * 86400 << TIMEBASE_SHIFT;
+		Ticks += elapsed;
+		int64_t gain = (int64_t)(RTCGetTicks() - start - elapsed);
+		int64_t expected = (int64_t)elapsed * Trims[i] / TIMESYNC_PPB;
+		CHECK(llabs(gain - expected) <= 1);
+		// A trim change keeps the time reached
+		before = RTCGetTicks();
+		RTCSetTrim(-Trims[i]);
+		CHECK(RTCGetTicks() == before);
+		Ticks += elapsed;
+		CHECK(llabs((int64_t)(RTCGetTicks() - before - elapsed) + expected) <= 1);
+	}
+	RTCSetSeconds(123456789UL);
+	CHECK(RTCGetSeconds() == 123456789UL);
+}
+
+static void TestStorage(void) {
+	// Every correction survives a reset
+	for (long trim = -TIMESYNC_MAX_TRIM; trim <= TIMESYNC_MAX_TRIM; trim += 997) {
+		Reboot(true);
+		TIMESYNCSaveTrim(trim);
+		Reboot(false);
+		CHECK(RTCGetTrim() == trim);
+	}
+	// An erased, unset or corrupted register is ignored
+	static const uint32_t Invalid[] = { 0, 0xFFFFFFFFUL, 0x00012345UL, 0x80000000UL };
+	for (unsigned int i = 0; i < sizeof(Invalid) / sizeof(Invalid[0]); i++) {
+		Reboot(true);
+		Nvram[TIMESYNC_NVRAM_INDEX] = Invalid[i];
+		TIMESYNC_Init();
+		CHECK(RTCGetTrim() == 0);
+	}
+	// The complement covers the low 12 bits and itself
+	for (int bit = 0; bit < 32; bit++) {
+		if ((bit >= 12) && (bit < TIMESYNC_TRIM_BITS)) continue;
+		Reboot(true);
+		TIMESYNCSaveTrim(-73000);
+		Nvram[TIMESYNC_NVRAM_INDEX] ^= 1UL << bit;
+		TIMESYNC_Init();
+		CHECK(RTCGetTrim() == 0);
+	}
+	// Out of range
+	Reboot(true);
+	TIMESYNCSaveTrim(TIMESYNC_MAX_TRIM + 1);
+	Reboot(false);
+	CHECK(RTCGetTrim() == 0);
+}
+
+static void TestRejected(void) {
+	MlmeConfirm_t confirm = { 0 };
+	CRYSTAL crystal = { 100, 0, 0 };
+	Crystal = crystal;
+	Now = 0;
+	Ticks = 0;
+	Reboot(true);
+	CHECK(TIMESYNC_IsDue());
+	// Failed or meaningless answers
+	confirm.Status = LORAMAC_EVENT_INFO_STATUS_RX2_TIMEOUT;
+	confirm.Epoch = TIMESYNC_EPOCH_OFFSET + START_TIME;
+	TIMESYNC_Confirm(&confirm);
+	CHECK(Status.Count == 0);
+	confirm.Status = LORAMAC_EVENT_INFO_STATUS_OK;
+	confirm.Epoch = TIMESYNC_EPOCH_OFFSET - 1;
+	TIMESYNC_Confirm(&confirm);
+	CHECK(Status.Count == 0);
+	CHECK(TIMESYNC_IsDue());
+	// First synchronization
+	bRequested = true;
+	Uplink();
+	CHECK(Status.Count == 1);
+	CHECK(!TIMESYNC_IsDue());
+	CHECK(fabs(Error()) <= ANSWER_JITTER * 1000 + 1);
+	// A step beyond TIMESYNC_MAX_STEP restarts the estimation
+	Advance(86400);
+	RTCSetTicks(RTCGetTicks() + TIMESYNC_TICKS(TIMESYNC_MAX_STEP + 1));
+	bRequested = true;
+	Uplink();
+	CHECK(Status.Count == 2);
+	CHECK(RTCGetTrim() == 0);
+	CHECK(Status.Offset <= -(TIMESYNC_MAX_STEP + 1) * 1000L + 100);
+	// Too early to estimate
+	Advance(TIMESYNC_MIN_INTERVAL - 10);
+	bRequested = true;
+	Uplink();
+	CHECK(RTCGetTrim() == 0);
+	// The next one learns the drift
+	Advance(60);
+	bRequested = true;
+	Uplink();
+	CHECK(labs(RTCGetTrim() + 100000) <= 3000);
+	CHECK(labs(Status.Drift + 100000) <= 3000);
+	CHECK(Status.Interval >= TIMESYNC_MIN_INTERVAL);
+}
+
+int main(void) {
+	TestCorrected();
+	TestStorage();
+	TestRejected();
+	TestDrift();
+	TestReset();
+	return TEST_END();
+}
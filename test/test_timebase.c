@@ -0,0 +1,274 @@
+/*******************************************************************
+**                                                                **
+** Time base host tests                                           **
+**                                                                **
+*******************************************************************/
+/*
+ * Checks the conversions of timebase.h against exact arithmetic, also where the ticks and
+ * the milliseconds wrap on 32 bits, and TimeBaseIsReached and TimeBaseElapsed on both sides
+ * of the counter roll over. Then runs timebase.c on an emulated RTCC, warm started close to
+ * its roll over, against a model of the elapsed time: the counter runs or is stopped in EM3
+ * and the stopped time is added back by TimeBaseSkip, the overflow and compare IRQs are
+ * serviced at once or later. TimeBaseGetTicks64 must follow the elapsed time, also with an
+ * overflow not serviced yet, and the compare channels must fire on their absolute target,
+ * before or after the skipped time, and never early.
+ */
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include "system.h"
+#include "timebase.h"
+#include "em_cmu.h"
+#include "em_rtcc.h"
+#include "em_rmu.h"
+#include "test.h"
+
+/** @cond */
+#define TEST_CONVERSIONS	2000000UL
+#define TEST_STEPS			1000000UL			// About 5 years of up time
+#define WARM_COUNTER		0xFFFFEC00UL		// Counter value kept through the warm reset
+#define CHANNELS			3					// Compare channels, 0 is unused
+
+typedef struct {
+	uint64_t	Now;					// Ticks since the counter start, stopped time included
+	uint64_t	Target[CHANNELS];		// Absolute compare targets
+	bool		Armed[CHANNELS];
+	unsigned long	Fired, Late, Skips, PendingOverflows;
+} MODEL;
+
+RTCC_TypeDef EmuRtcc;
+CMU_TypeDef EmuCmu;
+static MODEL Model;
+static int IrqDisabled;
+static int LimitedResets;
+/** @endcond */
+
+void RTCC_IRQHandler(void);				// Defined by timebase.c
+
+/*
+ * Exact conversions in long double, no tie can happen as 1000 does not divide 2^15 * ms + 500
+ */
+static uint32_t RefMsToTicks(uint32_t ms) {
+	return (uint32_t)(uint64_t)floorl(ms * 32.768L + 0.5L);
+}
+
+static uint32_t RefTicksToMs(uint64_t ticks) {
+	return (uint32_t)(uint64_t)floorl(ticks / 32.768L);
+}
+
+static uint32_t Random32(void) {
+	return ((uint32_t)rand() << 16) ^ (uint32_t)rand();
+}
+
+static void CheckConversion(uint32_t ms, uint64_t ticks) {
+	uint32_t t = TimeBaseMsToTicks(ms);
+	CHECK(t == RefMsToTicks(ms));
+	// Rounded then truncated: back to ms or one less, below the 32 bits ticks wrap (36.4 hours)
+	if (ms < 131072000UL) CHECK((TimeBaseTicksToMs(t) == ms) || (TimeBaseTicksToMs(t) == ms - 1));
+	CHECK(TimeBaseTicksToMs(ticks) == RefTicksToMs(ticks));
+	CHECK(TimeBaseTicksToUs(ticks) == (uint64_t)floorl(ticks * 1e6L / 32768));
+}
+
+static void TestConversions(void) {
+	// Around 0, the 32 bits ticks wrap (131072000 ms), the 32 bits ms wrap (2^32 * 32.768 ticks)
+	static const uint64_t ticks[] = { 0, 0x100000000ULL, 140737488355ULL, 0x80000000ULL };
+	static const uint32_t ms[] = { 0, 131072000UL, 0xFFFFFFFFUL - 100000, 65536000UL };
+	for (unsigned int w = 0; w < sizeof(ticks) / sizeof(ticks[0]); w++)
+		for (uint32_t i = 0; i < 200000; i++)
+			CheckConversion(ms[w] + i - 100000 * (ms[w] >= 100000), ticks[w] + i - 100000 * (ticks[w] >= 100000));
+	for (unsigned long r = 0; r < TEST_CONVERSIONS; r++)
+		CheckConversion(Random32(), ((uint64_t)Random32() << 8) ^ Random32());
+	CHECK(TimeBaseMsToTicks(1000) == TIMEBASE_FREQUENCY);
+	CHECK(TimeBaseMsToTicks(0xFFFFFFFFUL) == (uint32_t)140737488323ULL);
+	CHECK(TimeBaseTicksToMs(140737488355ULL) == 0xFFFFFFFFUL);
+	CHECK(TimeBaseTicksToMs(140737488356ULL) == 0);
+	// Reached and elapsed across the counter roll over, up to 2^31 ticks (18 hours) apart
+	for (unsigned long r = 0; r < TEST_CONVERSIONS; r++) {
+		uint32_t target = (r & 1) ? Random32() : 0xFFFFFFFFUL - (r % 1000);
+		int32_t delta = (int32_t)Random32();
+		CHECK(TimeBaseIsReached(target, target + delta) == (delta >= 0));
+		CHECK(TimeBaseElapsed(target, target + delta) == (uint32_t)delta);
+	}
+	CHECK(TimeBaseIsReached(0xFFFFFFF0UL, 0x10));
+	CHECK(!TimeBaseIsReached(0x10, 0xFFFFFFF0UL));
+	CHECK(TimeBaseIsReached(0x10, 0x10));
+	CHECK(TimeBaseElapsed(0xFFFFFFF0UL, 0x10) == 0x20);
+}
+
+/*
+ * Counter running for n ticks: the compare channels match on their value, the overflow
+ * flag is set on the roll over
+ */
+static void Run(uint32_t n) {
+	uint32_t from = EmuRtcc.CNT;
+	for (int ch = 1; ch < CHANNELS; ch++)
+		if ((uint32_t)(EmuRtcc.CCV[ch] - from - 1) < n) EmuRtcc.IF |= RTCC_IF_CC0 << ch;
+	EmuRtcc.CNT += n;
+	if (EmuRtcc.CNT < from) EmuRtcc.IF |= RTCC_IF_OF;
+	Model.Now += n;
+}
+
+/*
+ * Counter stopped for n ticks (EM3), then accounted for
+ */
+static void Stop(uint32_t n) {
+	Model.Now += n;
+	Model.Skips++;
+	TimeBaseSkip(n);
+}
+
+static void Service(void) {
+	if (RTCC_IntGetEnabled()) RTCC_IRQHandler();
+}
+
+static void Arm(TIMEBASE_CHANNEL ch, int64_t delta) {
+	Model.Target[ch] = Model.Now + delta;
+	Model.Armed[ch] = true;
+	TimeBaseSetCompare(ch, (uint32_t)Model.Target[ch]);
+	if (delta <= 0) Model.Late++;
+}
+
+static void CheckTime(void) {
+	CHECK(TimeBaseGetTicks64() == Model.Now);
+	CHECK(TimeBaseGetTicks() == (uint32_t)Model.Now);
+	CHECK(TimeBaseGetMs() == RefTicksToMs(Model.Now));
+	CHECK(TimeBaseGetUs() == (uint64_t)floorl(Model.Now * 1e6L / 32768));
+	CHECK(IrqDisabled == 0);
+}
+
+/*
+ * After the IRQ: armed channels are in the future, their deadline is the nearest
+ */
+static void CheckChannels(void) {
+	uint32_t deadline = TIMEBASE_NO_DEADLINE;
+	for (int ch = 1; ch < CHANNELS; ch++) {
+		CHECK(!TimeBaseIsPending((TIMEBASE_CHANNEL)ch));
+		if (!Model.Armed[ch]) continue;
+		CHECK(Model.Target[ch] > Model.Now);
+		if (Model.Target[ch] - Model.Now < deadline) deadline = (uint32_t)(Model.Target[ch] - Model.Now);
+	}
+	CHECK(TimeBaseGetNextDeadline() == deadline);
+}
+
+static void TestSkip(void) {
+	// Directed: a target reached during the stopped time fires as soon as it is accounted for
+	Arm(TimeBaseTimerChannel, 1000);
+	Stop(500);
+	Service();
+	CHECK(Model.Armed[TimeBaseTimerChannel]);
+	CHECK(TimeBaseGetNextDeadline() == 500);
+	Run(499);
+	Service();
+	CHECK(Model.Armed[TimeBaseTimerChannel]);
+	Run(1);
+	CHECK(TimeBaseIsPending(TimeBaseTimerChannel));
+	Service();
+	CHECK(!Model.Armed[TimeBaseTimerChannel]);
+	Arm(TimeBaseOSChannel, 1000);
+	Stop(1000);
+	CHECK(TimeBaseGetNextDeadline() == 0);
+	Service();
+	CHECK(!Model.Armed[TimeBaseOSChannel]);
+	CheckTime();
+
+	// Random runs, stopped times, arming and cancelling, with IRQs serviced at once or later
+	for (unsigned long step = 0; step < TEST_STEPS; step++) {
+		int ch = 1 + rand() % 2;
+		switch (rand() % 8) {
+		case 0:
+			Arm((TIMEBASE_CHANNEL)ch, (int64_t)(Random32() & ((rand() & 1) ? 0x00000FFF : 0x0FFFFFFF)) - 0x100);
+			break;
+		case 1:
+			if (rand() % 4) break;
+			TimeBaseStopCompare((TIMEBASE_CHANNEL)ch);
+			Model.Armed[ch] = false;
+			break;
+		case 2:
+			Stop(Random32() & ((rand() % 16) ? 0xFFF : 0x3FFFFFFF));
+			break;
+		default:
+			Run(Random32() & ((rand() % 64) ? 0xFFFF : 0x3FFFFFFF));
+			break;
+		}
+		// The overflow may not be serviced yet when the time is read
+		if (RTCC->IF & RTCC_IF_OF) Model.PendingOverflows++;
+		CheckTime();
+		Service();
+		CheckTime();
+		CheckChannels();
+	}
+	CHECK(Model.PendingOverflows > 100);
+	CHECK(Model.Skips > TEST_STEPS / 10);
+	CHECK(Model.Fired > TEST_STEPS / 100);
+	CHECK(Model.Late > 100);
+}
+
+/*******************************************************************
+** Emulated seams                                                 **
+*******************************************************************/
+static void Fire(TIMEBASE_CHANNEL ch) {
+	CHECK(Model.Armed[ch]);
+	CHECK(Model.Now >= Model.Target[ch]);
+	Model.Armed[ch] = false;
+	Model.Fired++;
+	TimeBaseStopCompare(ch);
+}
+
+void TimeBaseOSTick_Handler(void) {
+	Fire(TimeBaseOSChannel);
+}
+
+void TimeBaseTimer_Handler(void) {
+	Fire(TimeBaseTimerChannel);
+}
+
+void SystemIrqDisable(void) {
+	IrqDisabled++;
+}
+
+void SystemIrqEnable(void) {
+	CHECK(IrqDisabled > 0);
+	IrqDisabled--;
+}
+
+void RTCC_Init(const RTCC_Init_TypeDef* init) {
+	CHECK(init->presc == rtccCntPresc_1);
+	EmuRtcc.CTRL |= RTCC_CTRL_ENABLE;
+}
+
+void RTCC_Reset(void) {
+	memset(&EmuRtcc, 0, sizeof(EmuRtcc));
+}
+
+void RTCC_ChannelInit(int ch, const RTCC_CCChConf_TypeDef* confPtr) {
+	CHECK((ch == TimeBaseOSChannel) || (ch == TimeBaseTimerChannel));
+}
+
+void RMU_ResetControl(RMU_Reset_TypeDef reset, RMU_ResetMode_TypeDef mode) {
+	if (mode == rmuResetModeLimited) LimitedResets++;
+}
+
+void CMU_ClockEnable(CMU_Clock_TypeDef clock, bool enable) { }
+void CMU_ClockSelectSet(CMU_Clock_TypeDef clock, CMU_Select_TypeDef ref) { }
+void NVIC_EnableIRQ(IRQn_Type IRQn) { }
+void NVIC_ClearPendingIRQ(IRQn_Type IRQn) { }
+void NVIC_SetPriority(IRQn_Type IRQn, uint32_t priority) { }
+
+int main(void) {
+	srand(31);
+	TestConversions();
+	// Warm start: the counter kept running through the reset, close to its roll over
+	EmuRtcc.CTRL = RTCC_CTRL_ENABLE;
+	EmuRtcc.CNT = WARM_COUNTER;
+	EmuRtcc.IEN = RTCC_IF_CC0 << TimeBaseTimerChannel;
+	TimeBaseInit();
+	TimeBaseInit();
+	CHECK(LimitedResets == 4);
+	CHECK(EmuRtcc.CNT == WARM_COUNTER);
+	CHECK(EmuRtcc.IEN == RTCC_IEN_OF);
+	Model.Now = WARM_COUNTER;
+	CheckTime();
+	TestSkip();
+	return TEST_END();
+}
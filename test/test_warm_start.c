@@ -0,0 +1,486 @@
+/*******************************************************************
+**                                                                **
+** Warm start unit tests                                          **
+**                                                                **
+*******************************************************************/
+/*
+ * src/warm_start.c runs on top of emulated seams: the RTCC retention registers, the Flash
+ * Memory pages (erased words read 0xFF, a write only clears bits) and the MAC session, which
+ * is a plain structure. The module source is included to reach its Flash Memory pages.
+ *
+ * Every retention register write, Flash Memory word write or erase and every step of the
+ * uplink sequence is a point where a reset can be injected. A reset interrupting a Flash
+ * Memory word leaves garbage in it. After the reset the device boots again with the chosen
+ * reset cause, and the network side checks that a frame counter is never sent twice in a
+ * session, that a resumed session skips at most WARMSTART_FCNT_GAP counter values and that
+ * a session is resumed whenever the reset cause and the saved copies allow it.
+ */
+
+#include <setjmp.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include "../src/warm_start.c"
+#include "test.h"
+
+/** @cond */
+#define NVRAM_WORDS		32				// RTCC retention registers
+#define UPLINKS			40				// Uplinks sent by each boot
+#define PARAMS_PERIOD	13				// Uplinks between two session parameters changes
+#define NET_SESSIONS	16384			// Sessions known by the network, a power of 2
+
+typedef struct {
+	uint32_t	DevAddr;
+	uint32_t	UpLinkCounter;			// Last uplink frame counter
+	uint32_t	WindowCounter;			// Frame counter of a reset in the TX done window
+	bool		bUsed;
+	bool		bWindow;
+} NET_SESSION;
+
+typedef char NVRAM_CHECK[(WARMSTART_WORDS <= TIMESYNC_NVRAM_INDEX) ? 1 : -1];	// Registers 30 and 31 belong to time_sync and join_retry
+
+USERDATA UserData;
+static uint32_t		Nvram[NVRAM_WORDS];
+static RESETCAUSE	Cause;
+static unsigned long Seconds;
+static LORAWAN_SESSION Mac;				// MAC session, lost by a reset
+static bool			bMacJoined;
+static bool			bMibFail;			// LORAWAN_RestoreSession fails
+static bool			bTxDoneHook = true;	// WARMSTART_TxDone is called (false: behaviour before it)
+static bool			bFlashOpen;
+static int			Suspended;
+static unsigned long FlashWrites;		// Flash Memory snapshots written
+static unsigned long FlashErases;
+// Reset injection
+static jmp_buf		ResetJump;
+static unsigned long Seams;				// Reset points passed
+static unsigned long ResetAt;			// Reset point of the injected reset, 0 for none
+static int			WindowsReset;		// Reset in the receive windows of this uplink, 0 for none
+static unsigned long TxDoneSeam;		// Reset point between the TX done and the first register write
+// Network side
+static NET_SESSION	NetSessions[NET_SESSIONS];
+static bool			bSaved;				// The join of the current session completed its save
+static unsigned long Repeats;			// Uplinks sent again with an already used frame counter
+static unsigned long WindowRepeats;		// Same, after a reset in the TX done window
+static unsigned long WindowResets;
+static unsigned long MaxSkip;			// Most frame counter values skipped by a warm start
+static unsigned long Joins;
+static unsigned long WarmStarts;
+/** @endcond */
+
+/*******************************************************************
+** Emulated seams                                                 **
+*******************************************************************/
+static bool ResetPoint(void) {
+	return (++Seams == ResetAt);
+}
+
+static void Reset(void) {
+	longjmp(ResetJump, 1);
+}
+
+int SystemGetNVRAMSize(void) {
+	return NVRAM_WORDS;
+}
+void SystemSetNVRAMValue(int index, int value) {
+	CHECK((index >= 0) && (index < WARMSTART_WORDS));
+	if (ResetPoint()) Reset();
+	Nvram[index] = (uint32_t)value;
+}
+int SystemGetNVRAMValue(int index) {
+	CHECK((index >= 0) && (index < NVRAM_WORDS));
+	return (int)Nvram[index];
+}
+RESETCAUSE SystemRebootCause(void) {
+	return Cause;
+}
+unsigned long SystemGetSystemSeconds(void) {
+	return Seconds;
+}
+
+void vTaskSuspendAll(void) {
+	Suspended++;
+}
+long xTaskResumeAll(void) {
+	CHECK(Suspended > 0);
+	Suspended--;
+	return 0;
+}
+
+static void FlashProtect(int prot) {
+	uintptr_t page = (uintptr_t)sysconf(_SC_PAGESIZE);
+	uintptr_t start = (uintptr_t)_WARMSTARTPAGES_ & ~(page - 1);
+	uintptr_t end = ((uintptr_t)_WARMSTARTPAGES_ + sizeof(_WARMSTARTPAGES_) + page - 1) & ~(page - 1);
+	if (mprotect((void*)start, end - start, prot) != 0) {
+		perror("mprotect");
+		exit(1);
+	}
+}
+static volatile uint32_t* FlashWord(void* address) {
+	uintptr_t offset = (uintptr_t)address - (uintptr_t)_WARMSTARTPAGES_;
+	CHECK(bFlashOpen);
+	CHECK((offset < sizeof(_WARMSTARTPAGES_)) && ((offset % sizeof(uint32_t)) == 0));
+	return (volatile uint32_t*)address;
+}
+void FLASHOpen(void) {
+	CHECK(!bFlashOpen && (Suspended > 0));
+	bFlashOpen = true;
+	FlashProtect(PROT_READ | PROT_WRITE);
+}
+void FLASHClose(void) {
+	CHECK(bFlashOpen);
+	bFlashOpen = false;
+	FlashProtect(PROT_READ);
+}
+signed char FLASHEraseBlock(void* address) {
+	volatile uint32_t* word = FlashWord(address);
+	CHECK((((uintptr_t)address - (uintptr_t)_WARMSTARTPAGES_) % WARMSTART_PAGE_SIZE) == 0);
+	FlashErases++;
+	for (int i = 0; i < WARMSTART_PAGE_SIZE / sizeof(uint32_t); i++) {
+		if (ResetPoint()) {
+			word[i] = (uint32_t)rand();
+			Reset();
+		}
+		word[i] = 0xFFFFFFFFUL;
+	}
+	return FLASH_NO_ERROR;
+}
+signed char FLASHWrite(void* address, unsigned char* buffer, unsigned short count) {
+	volatile uint32_t* word = FlashWord(address);
+	CHECK((count % sizeof(uint32_t)) == 0);
+	FlashWrites++;
+	for (int i = 0; i < count / sizeof(uint32_t); i++) {
+		uint32_t value;
+		memcpy(&value, &buffer[i * sizeof(uint32_t)], sizeof(value));
+		CHECK(word[i] == 0xFFFFFFFFUL);
+		if (ResetPoint()) {
+			word[i] &= (uint32_t)rand();
+			Reset();
+		}
+		word[i] &= value;
+	}
+	return FLASH_NO_ERROR;
+}
+
+void LORAWAN_GetSession(LORAWAN_SESSION* session) {
+	CHECK(bMacJoined);
+	*session = Mac;
+}
+bool LORAWAN_RestoreSession(const LORAWAN_SESSION* session) {
+	if (bMibFail) return false;
+	Mac = *session;
+	bMacJoined = true;
+	return true;
+}
+
+/*******************************************************************
+** Device and network                                             **
+*******************************************************************/
+/*
+ * Power the device for the first time: blank Flash Memory, random retention registers
+ */
+static void Manufacture(void) {
+	memset(&UserData, 0x5A, sizeof(UserData));
+	UserData.DeviceFlags = FLAG_INSTALLED | FLAG_USE_OTAA;
+	FlashProtect(PROT_READ | PROT_WRITE);
+	memset((void*)_WARMSTARTPAGES_, 0xFF, sizeof(_WARMSTARTPAGES_));
+	FlashProtect(PROT_READ);
+	for (int i = 0; i < NVRAM_WORDS; i++) Nvram[i] = (uint32_t)rand();
+	memset(NetSessions, 0, sizeof(NetSessions));
+	bSaved = false;
+	Seconds = 0;
+}
+
+static void Join(void) {
+	memset(&Mac, 0, sizeof(Mac));
+	Mac.DevAddr = (uint32_t)rand();
+	Mac.NetID = 0x000024;
+	memset(Mac.NwkSKey, rand(), sizeof(Mac.NwkSKey));
+	memset(Mac.AppSKey, rand(), sizeof(Mac.AppSKey));
+	Mac.Rx2Frequency = 921900000;
+	Mac.ChannelsMask[0] = 0x0007;
+	Mac.ReceiveDelay1 = 1000;
+	bMacJoined = true;
+	bSaved = false;
+	Joins++;
+	WARMSTART_Save();
+	bSaved = true;
+}
+
+static NET_SESSION* NetSession(uint32_t devAddr) {
+	uint32_t i = devAddr;
+	while (NetSessions[i % NET_SESSIONS].bUsed && (NetSessions[i % NET_SESSIONS].DevAddr != devAddr)) i++;
+	NetSessions[i % NET_SESSIONS].DevAddr = devAddr;
+	return &NetSessions[i % NET_SESSIONS];
+}
+
+/*
+ * The network receives an uplink: its frame counter must be new for the session
+ */
+static void Receive(uint32_t upLinkCounter) {
+	NET_SESSION* session = NetSession(Mac.DevAddr);
+	if (session->bUsed && ((int32_t)(upLinkCounter - session->UpLinkCounter) <= 0)) {
+		if (session->bWindow && (session->WindowCounter == upLinkCounter)) WindowRepeats++;
+		else Repeats++;
+	}
+	session->bUsed = true;
+	session->UpLinkCounter = upLinkCounter;
+}
+
+/*
+ * One uplink, in the order of the MAC events: TX done, receive windows, confirmation
+ * @remark The frame is on air before the event task writes the retention registers: a reset
+ * in between still sends the frame counter again. This window is the event task latency,
+ * the resets there are counted apart.
+ */
+static void Uplink(void) {
+	uint32_t upLinkCounter = Mac.UpLinkCounter;
+	if (ResetPoint()) Reset();				// Before the TX done, the frame is not on air
+	Receive(upLinkCounter);
+	if (bTxDoneHook) {
+		TxDoneSeam = Seams + 1;
+		WARMSTART_TxDone(upLinkCounter);
+	}
+	if (ResetPoint() || (WindowsReset && (--WindowsReset == 0))) Reset();	// Receive windows
+	if ((upLinkCounter % PARAMS_PERIOD) == PARAMS_PERIOD - 1) {
+		// A MAC command changes the session parameters
+		Mac.ChannelsMask[0] ^= 0x0018;
+		Mac.Datarate = (int8_t)((Mac.Datarate + 1) % 6);
+	}
+	Mac.UpLinkCounter++;
+	Mac.DownLinkCounter += (upLinkCounter & 1);
+	WARMSTART_Update();
+	Seconds += 600;
+}
+
+/*
+ * Boot the device and send uplinks, until done or until the injected reset
+ * @return true if the boot was interrupted by a reset
+ */
+static bool Boot(int uplinks) {
+	bool bRestored;
+	if (setjmp(ResetJump)) {
+		// Everything but the retention registers and the Flash Memory is lost
+		if (Seams == TxDoneSeam) {
+			NET_SESSION* session = NetSession(Mac.DevAddr);
+			session->bWindow = true;
+			session->WindowCounter = session->UpLinkCounter;
+			WindowResets++;
+		}
+		if (bFlashOpen) FLASHClose();
+		Suspended = 0;
+		bMacJoined = false;
+		ResetAt = 0;
+		return true;
+	}
+	bMacJoined = false;
+	Seconds = 0;
+	TxDoneSeam = 0;
+	bRestored = WARMSTART_Restore();
+	if (bRestored) {
+		NET_SESSION* session = NetSession(Mac.DevAddr);
+		WarmStarts++;
+		int32_t skip = (int32_t)(Mac.UpLinkCounter - session->UpLinkCounter - 1);
+		if (session->bUsed && (skip > (int32_t)MaxSkip)) MaxSkip = (unsigned long)skip;
+	}
+	else {
+		Join();
+	}
+	for (int i = 0; i < uplinks; i++) Uplink();
+	return false;
+}
+
+/*
+ * Boot again after a reset, the session must be resumed if the reset cause allows it
+ */
+static void Reboot(RESETCAUSE cause) {
+	unsigned long warmStarts = WarmStarts;
+	// An external reset needs the retained copy, which a reset may have interrupted
+	bool bExpected = bSaved && (cause != POWER_ON) && (cause != UNKNOWN) && (cause != EXTERNAL);
+	Cause = cause;
+	if (cause == POWER_ON) {
+		for (int i = 0; i < NVRAM_WORDS; i++) Nvram[i] = (uint32_t)rand();
+	}
+	Boot(UPLINKS);
+	if (bExpected) CHECK(WarmStarts == warmStarts + 1);
+	if (cause == POWER_ON) CHECK(WarmStarts == warmStarts);
+}
+
+/*******************************************************************
+** Tests                                                          **
+*******************************************************************/
+static const RESETCAUSE Causes[] = { WATCHDOG, BROWN_OUT, SYSTEM_LOCKUP, SYSTEM_REQUEST, EXTERNAL, POWER_ON };
+
+/*
+ * A single reset at every reset point of a first boot, for every reset cause
+ * @return number of reset points
+ */
+static unsigned long SingleReset(RESETCAUSE cause) {
+	unsigned long points;
+	Manufacture();
+	Cause = POWER_ON;
+	Seams = 0;
+	ResetAt = 0;
+	Boot(UPLINKS);
+	points = Seams;
+	for (unsigned long at = 1; at <= points; at++) {
+		Manufacture();
+		Cause = POWER_ON;
+		Seams = 0;
+		ResetAt = at;
+		CHECK(Boot(UPLINKS));
+		Reboot(cause);
+	}
+	return points;
+}
+
+/*
+ * Chains of random resets over many boots
+ */
+static void RandomResets(void) {
+	Manufacture();
+	Cause = POWER_ON;
+	for (int boot = 0; boot < 3000; boot++) {
+		Seams = 0;
+		ResetAt = 1 + (unsigned long)rand() % 1500;
+		if (!Boot(UPLINKS)) continue;
+		Cause = Causes[rand() % (sizeof(Causes) / sizeof(Causes[0]))];
+		if (Cause == POWER_ON) {
+			for (int i = 0; i < NVRAM_WORDS; i++) Nvram[i] = (uint32_t)rand();
+		}
+	}
+}
+
+static void TestResets(void) {
+	unsigned long points = 0;
+	for (int i = 0; i < sizeof(Causes) / sizeof(Causes[0]); i++) {
+		Repeats = 0;
+		WindowRepeats = 0;
+		WindowResets = 0;
+		MaxSkip = 0;
+		points = SingleReset(Causes[i]);
+		CHECK(Repeats == 0);
+		CHECK(WindowRepeats <= WindowResets);
+		CHECK(MaxSkip <= WARMSTART_FCNT_GAP);
+	}
+	printf("%lu reset points in a boot of %d uplinks, %lu in the TX done window\n", points, UPLINKS, WindowResets);
+
+	Repeats = 0;
+	WindowRepeats = 0;
+	WindowResets = 0;
+	MaxSkip = 0;
+	Joins = 0;
+	WarmStarts = 0;
+	RandomResets();
+	CHECK(Repeats == 0);
+	CHECK(WindowRepeats <= WindowResets);
+	CHECK(MaxSkip <= WARMSTART_FCNT_GAP);
+	CHECK(WarmStarts > 0);
+	printf("random resets: %lu joins, %lu warm starts, up to %lu frame counter values skipped,\n"
+			"%lu frame counters sent again after %lu resets in the TX done window\n",
+			Joins, WarmStarts, MaxSkip, WindowRepeats, WindowResets);
+
+	// Before the TX done refresh, a reset in the receive windows sent the last counter again
+	bTxDoneHook = false;
+	Repeats = 0;
+	SingleReset(WATCHDOG);
+	CHECK(Repeats > 0);
+	printf("without the TX done refresh: %lu frame counters sent twice\n", Repeats);
+	bTxDoneHook = true;
+}
+
+/*
+ * A warm start from the retention registers resumes the exact frame counter, and the Flash
+ * Memory is only written once per reserved counter range or parameters change
+ */
+static void TestRetained(void) {
+	unsigned long joins;
+	Manufacture();
+	Cause = POWER_ON;
+	Seams = 0;
+	ResetAt = 0;
+	FlashWrites = 0;
+	Boot(UPLINKS * 4);
+	CHECK(FlashWrites <= 1 + (UPLINKS * 4) / WARMSTART_FCNT_GAP + (UPLINKS * 4) / PARAMS_PERIOD + 1);
+	Nvram[30] = 0xA5A5A5A5UL;
+	Nvram[31] = 0x5A5A5A5AUL;
+
+	// Reset in the receive windows: the next uplink uses the next counter
+	Cause = WATCHDOG;
+	WindowsReset = 3;
+	CHECK(Boot(UPLINKS));
+	Boot(0);
+	CHECK(Mac.UpLinkCounter == NetSession(Mac.DevAddr)->UpLinkCounter + 1);
+	CHECK((Nvram[30] == 0xA5A5A5A5UL) && (Nvram[31] == 0x5A5A5A5AUL));
+
+	// A corrupted retained copy falls back to the Flash Memory one
+	Nvram[5] ^= 0x100;
+	Cause = BROWN_OUT;
+	Boot(0);
+	CHECK(Mac.UpLinkCounter > NetSession(Mac.DevAddr)->UpLinkCounter + 1);
+	CHECK(Mac.UpLinkCounter <= NetSession(Mac.DevAddr)->UpLinkCounter + 1 + WARMSTART_FCNT_GAP);
+
+	// Not for an external reset, which only resumes the retained copy
+	joins = Joins;
+	Nvram[5] ^= 0x100;
+	Cause = EXTERNAL;
+	Boot(0);
+	CHECK(Joins == joins + 1);
+}
+
+/*
+ * Cases where the session must not be resumed
+ */
+static void TestRejected(void) {
+	unsigned long joins;
+	Manufacture();
+	Cause = POWER_ON;
+	Seams = 0;
+	ResetAt = 0;
+	Boot(2);
+
+	// The MAC refuses the session
+	bMibFail = true;
+	joins = Joins;
+	Cause = WATCHDOG;
+	Boot(1);
+	CHECK(Joins == joins + 1);
+	bMibFail = false;
+
+	// New provisioning
+	UserData.LoRaWAN.AppKey[3] ^= 1;
+	joins = Joins;
+	Boot(1);
+	CHECK(Joins == joins + 1);
+
+	// Too old
+	joins = Joins;
+	Boot(0);
+	CHECK(Joins == joins);
+	Seconds = WARMSTART_MAX_AGE + 1;
+	WARMSTART_Update();
+	Boot(0);
+	CHECK(Joins == joins + 1);
+
+	// Invalidated, in both copies
+	joins = Joins;
+	WARMSTART_Invalidate();
+	Boot(0);
+	CHECK(Joins == joins + 1);
+	WARMSTART_Invalidate();
+	Cause = BROWN_OUT;
+	Boot(0);
+	CHECK(Joins == joins + 2);
+
+	// Not installed
+	UserData.DeviceFlags &= ~FLAG_INSTALLED;
+	CHECK(!WARMSTART_Restore());
+}
+
+int main(void) {
+	srand(45);
+	TestRetained();
+	TestRejected();
+	TestResets();
+	return TEST_END();
+}
@@ -0,0 +1,405 @@
+/*******************************************************************
+**                                                                **
+** ZACWire decoding and edge capture host tests                   **
+**                                                                **
+*******************************************************************/
+/*
+ * Synthesizes TSIC frames (2 packets of a 50% start strobe and 9 bits of 125 us, 25% low for
+ * a 1 and 75% for a 0, one stop bit between packets, a frame every 100 ms) and checks that
+ * ZACWireDecode gives back every 11 bits value at any counter phase, reports the flipped bits
+ * as parity errors and the missing edges as errors, never as a value. The edges are then
+ * captured through the TIMER0 capture IRQ of mmi_timer.c, on an emulated 16 bits timer with
+ * a 2 edges hardware buffer and an IRQ latency: the capture must hold the 40 edges of the
+ * first whole frame following the ZACWIRE_FRAME_GAP idle time, whether it starts in the idle
+ * time, right before a frame or in the middle of one, across the counter wraps inside the
+ * frame and over 2^32 ticks of idle time, and skip a frame with a missing edge.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "zacwire.h"
+#include "mmi_timer.h"
+#include "timebase.h"
+#include "em_cmu.h"
+#include "em_prs.h"
+#include "em_timer.h"
+#include "test.h"
+
+/** @cond */
+#define TEST_FRAMES			20000
+#define TEST_CAPTURES		20000
+#define BIT_NS				125000LL			// TSIC bit period
+#define FRAME_PERIOD_NS		100000000LL			// TSIC 306 sampling rate is 10 Hz
+#define PACKET_BITS			10					// Start strobe, 8 data bits, parity
+#define MAX_FRAMES			4
+#define MAX_EDGES			(MAX_FRAMES * ZACWIRE_FRAME_EDGES)
+#define MAX_LATENCY_NS		20000				// IRQ latency, less than the shortest low level
+
+// Line edges in ns since the time origin, and frame of each edge
+typedef struct {
+	int64_t			Time[MAX_EDGES];
+	int				Frame[MAX_EDGES];
+	unsigned short	Value[MAX_FRAMES];
+	int				Count;
+} LINE;
+
+static const SystemPort Port = { GPIOPortC, 11, PortIn };
+static const uint32_t Frequencies[] = { 1000000UL, 14000000UL, 19000000UL, 38400000UL };
+
+TIMER_TypeDef EmuTimer0;
+PRS_TypeDef EmuPrs;
+CMU_TypeDef EmuCmu;
+static uint32_t Frequency;						// TIMER0 clock
+static unsigned short Fifo[2];					// Hardware capture buffer
+static int FifoCount;
+static int CapturedCount = -1;					// INTTimerCapture_Handler count, -1 if not called
+static unsigned long Overflows, OverflowEdges;	// IRQs with an overflow, with an edge after it
+/** @endcond */
+
+void TIMER0_IRQHandler(void);					// Defined by mmi_timer.c
+
+/*
+ * Append the edges of a packet starting at time t, parity makes the number of 1 even
+ */
+static int64_t AddPacket(int64_t* edges, int64_t t, unsigned char byte) {
+	unsigned int bits = (byte << 1) | (__builtin_popcount(byte) & 1);
+	edges[0] = t;
+	edges[1] = t + BIT_NS / 2;
+	for (int b = 0; b < PACKET_BITS - 1; b++) {
+		t += BIT_NS;
+		edges[2 + 2 * b] = t;
+		edges[3 + 2 * b] = t + ((bits & (0x100 >> b)) ? BIT_NS / 4 : 3 * BIT_NS / 4);
+	}
+	return t + 2 * BIT_NS;						// End of the last bit, then the stop bit
+}
+
+static void AddFrame(int64_t* edges, int64_t t, unsigned short value) {
+	t = AddPacket(edges, t, (unsigned char)(value >> 8));
+	AddPacket(&edges[ZACWIRE_FRAME_EDGES / 2], t, (unsigned char)value);
+}
+
+/*
+ * Time stamps of the edges on a counter running at frequency from the time origin
+ */
+static uint64_t Ticks(int64_t t, uint32_t frequency) {
+	return (uint64_t)t * frequency / 1000000000ULL;
+}
+
+static void Stamp(unsigned short* stamps, const int64_t* edges, int count, int64_t origin, uint32_t frequency) {
+	for (int i = 0; i < count; i++) stamps[i] = (unsigned short)Ticks(edges[i] - origin, frequency);
+}
+
+/*
+ * Every value at a random counter phase and frequency, with up to 2% of bit timing error
+ */
+static void TestDecode(void) {
+	int64_t edges[ZACWIRE_FRAME_EDGES + 1];
+	unsigned short stamps[ZACWIRE_FRAME_EDGES + 1], value;
+	for (int r = 0; r < TEST_FRAMES; r++) {
+		unsigned short expected = r & 0x07FF;
+		uint32_t frequency = Frequencies[r % 4];
+		AddFrame(edges, (rand() % 65536) * 1000000000LL / frequency, expected);
+		for (int i = 0; i < ZACWIRE_FRAME_EDGES; i++) edges[i] += (int64_t)edges[i] * ((r % 5) - 2) / 100;
+		Stamp(stamps, edges, ZACWIRE_FRAME_EDGES, 0, frequency);
+		value = 0xFFFF;
+		CHECK(ZACWireDecode(stamps, ZACWIRE_FRAME_EDGES, &value) == ZACWireOK);
+		CHECK(value == expected);
+		CHECK(ZACWireDecode(stamps, ZACWIRE_FRAME_EDGES, NULL) == ZACWireOK);
+		// Degenerate captures, value untouched
+		CHECK(ZACWireDecode(stamps, ZACWIRE_FRAME_EDGES - 1, &value) == ZACWireFrameError);
+		CHECK(ZACWireDecode(stamps, 0, &value) == ZACWireNoSignal);
+		CHECK(ZACWireDecode(NULL, ZACWIRE_FRAME_EDGES, &value) == ZACWireNoSignal);
+		CHECK(value == expected);
+	}
+	// Only 11 bits are significant
+	AddFrame(edges, 0, 0x0800 | (rand() & 0x7FF));
+	Stamp(stamps, edges, ZACWIRE_FRAME_EDGES, 0, Frequencies[1]);
+	CHECK(ZACWireDecode(stamps, ZACWIRE_FRAME_EDGES, &value) == ZACWireFrameError);
+	// No edge at all, line stuck
+	memset(stamps, 0, sizeof(stamps));
+	CHECK(ZACWireDecode(stamps, ZACWIRE_FRAME_EDGES, &value) == ZACWireFrameError);
+}
+
+/*
+ * Any single flipped data or parity bit is a parity error
+ */
+static void TestParity(void) {
+	int64_t edges[ZACWIRE_FRAME_EDGES];
+	unsigned short stamps[ZACWIRE_FRAME_EDGES], value = 0x1234;
+	for (int r = 0; r < TEST_FRAMES / 10; r++) {
+		AddFrame(edges, rand() % 1000000, rand() & 0x07FF);
+		int packet = rand() & 1, b = rand() % (PACKET_BITS - 1);
+		int64_t* bit = &edges[packet * ZACWIRE_FRAME_EDGES / 2 + 2 + 2 * b];
+		bit[1] = bit[0] + ((bit[1] - bit[0] < BIT_NS / 2) ? 3 * BIT_NS / 4 : BIT_NS / 4);
+		Stamp(stamps, edges, ZACWIRE_FRAME_EDGES, 0, Frequencies[r % 4]);
+		CHECK(ZACWireDecode(stamps, ZACWIRE_FRAME_EDGES, &value) == ZACWireParityError);
+		CHECK(value == 0x1234);
+	}
+}
+
+/*
+ * A missed edge shifts the following ones, the first edge of the next frame completes the
+ * capture: never decoded as a value. Without its last rising edge, the frame ends on an edge
+ * of the next one, at any counter value: the capture only rejects it by the idle time before.
+ */
+static void TestMissingEdge(void) {
+	int64_t edges[ZACWIRE_FRAME_EDGES + 1];
+	unsigned short stamps[ZACWIRE_FRAME_EDGES], value = 0x1234;
+	for (int r = 0; r < TEST_FRAMES; r++) {
+		int missing = r % (ZACWIRE_FRAME_EDGES - 1);
+		AddFrame(edges, 0, rand() & 0x07FF);
+		edges[ZACWIRE_FRAME_EDGES] = FRAME_PERIOD_NS + (rand() % 65536) * 1000LL;
+		memmove(&edges[missing], &edges[missing + 1], (ZACWIRE_FRAME_EDGES - missing) * sizeof(edges[0]));
+		Stamp(stamps, edges, ZACWIRE_FRAME_EDGES, 0, Frequencies[rand() % 4]);
+		CHECK(ZACWireDecode(stamps, ZACWIRE_FRAME_EDGES, &value) != ZACWireOK);
+		CHECK(value == 0x1234);
+	}
+}
+
+static void TestTemperature(void) {
+	// TSIC 206/306 (-50 to 150 °C) and 506 (-10 to 60 °C)
+	CHECK(ZACWireToTemperature(0, -50, 150) == -500);
+	CHECK(ZACWireToTemperature(2047, -50, 150) == 1500);
+	CHECK(ZACWireToTemperature(0, -10, 60) == -100);
+	CHECK(ZACWireToTemperature(2047, -10, 60) == 600);
+	for (unsigned short v = 0; v < 2048; v++) {
+		CHECK(ZACWireToTemperature(v, -50, 150) == (long)v * 2000 / 2047 - 500);
+		CHECK(ZACWireToTemperature(v, -10, 60) == (long)v * 700 / 2047 - 100);
+		if (v) CHECK(ZACWireToTemperature(v, -50, 150) >= ZACWireToTemperature(v - 1, -50, 150));
+	}
+}
+
+/*
+ * Line with frames every 100 ms (+/- 1 ms) from first, one of them may miss an edge
+ */
+static void MakeLine(LINE* line, int64_t first, int missingFrame) {
+	line->Count = 0;
+	for (int f = 0; f < MAX_FRAMES; f++) {
+		line->Value[f] = rand() & 0x07FF;
+		AddFrame(&line->Time[line->Count], first + f * FRAME_PERIOD_NS + (rand() % 2000001) - 1000000,
+				line->Value[f]);
+		for (int i = 0; i < ZACWIRE_FRAME_EDGES; i++) line->Frame[line->Count++] = f;
+		if (f == missingFrame) {
+			int missing = line->Count - ZACWIRE_FRAME_EDGES + rand() % ZACWIRE_FRAME_EDGES;
+			memmove(&line->Time[missing], &line->Time[missing + 1], (line->Count - missing - 1) * sizeof(int64_t));
+			line->Count--;
+		}
+	}
+}
+
+/*
+ * Reference capture from the 64 bits time stamps: the first edge after a gap idle time (from
+ * the capture start or the previous edge) starts a frame, the capture is the first frame
+ * which gets its 40 edges before another gap. Returns the index of its first edge, or -1.
+ */
+static int Expected(const LINE* line, int64_t start, uint32_t frequency, uint64_t gap) {
+	uint64_t last = 0;
+	int first = -1;
+	for (int i = 0; i < line->Count; i++) {
+		if (line->Time[i] < start) continue;
+		uint64_t tick = Ticks(line->Time[i] - start, frequency);
+		if ((first < 0) && !gap) first = i;
+		if (gap && (tick - last >= gap)) first = i;
+		last = tick;
+		if ((first >= 0) && (i - first + 1 == ZACWIRE_FRAME_EDGES)) return first;
+	}
+	return -1;
+}
+
+/*
+ * Run the timer from start: the hardware latches the edges and flags the overflows, the IRQ
+ * is serviced a random latency after the first one, until the capture is complete
+ */
+static void Run(const LINE* line, int64_t start, uint32_t frequency) {
+	int e = 0;
+	uint64_t wrap = 1;
+	while ((e < line->Count) && (line->Time[e] < start)) e++;
+	while ((CapturedCount < 0) && (EmuTimer0.CMD & TIMER_CMD_START)) {
+		int64_t wrapTime = start + (int64_t)((wrap * 0x10000ULL * 1000000000ULL + frequency - 1) / frequency);
+		int64_t next = (e < line->Count) ? line->Time[e] : wrapTime;
+		if (wrapTime < next) next = wrapTime;
+		if (next > line->Time[line->Count - 1] + FRAME_PERIOD_NS) break;
+		int64_t service = next + rand() % MAX_LATENCY_NS;
+		while ((e < line->Count) && (line->Time[e] <= service)) {
+			if (FifoCount < 2) Fifo[FifoCount++] = (unsigned short)Ticks(line->Time[e] - start, frequency);
+			else EmuTimer0.IF |= TIMER_IF_ICBOF0;
+			EmuTimer0.IF |= TIMER_IF_CC0;
+			e++;
+		}
+		for (; wrapTime <= service; wrap++) {
+			EmuTimer0.IF |= TIMER_IF_OF;
+			wrapTime = start + (int64_t)(((wrap + 1) * 0x10000ULL * 1000000000ULL + frequency - 1) / frequency);
+		}
+		EmuTimer0.STATUS = (FifoCount) ? TIMER_STATUS_ICV0 : 0;
+		if (EmuTimer0.IF & EmuTimer0.IEN) {
+			if ((EmuTimer0.IF & TIMER_IF_OF) && FifoCount) {
+				Overflows++;
+				if (Fifo[0] < 0x8000) OverflowEdges++;
+			}
+			TIMER0_IRQHandler();
+		}
+	}
+}
+
+/*
+ * One capture of a line started at start, gap in us: compare with the reference and decode
+ */
+static void Capture(const LINE* line, int64_t start, uint32_t frequency, unsigned long gap, int missingFrame) {
+	unsigned short buffer[ZACWIRE_FRAME_EDGES + 1], stamps[ZACWIRE_FRAME_EDGES], value;
+	Frequency = frequency;
+	CapturedCount = -1;
+	FifoCount = 0;
+	buffer[ZACWIRE_FRAME_EDGES] = 0xA5A5;
+	CHECK(TIMERCaptureStart(Port, buffer, ZACWIRE_FRAME_EDGES, gap));
+	CHECK(!TIMERCaptureIsDone());
+	CHECK(TIMERCaptureGetFrequency() == frequency);
+	Run(line, start, frequency);
+	int first = Expected(line, start, frequency, (uint64_t)frequency * gap / 1000000UL);
+	CHECK(first >= 0);
+	CHECK(CapturedCount == ZACWIRE_FRAME_EDGES);
+	CHECK(TIMERCaptureIsDone());
+	CHECK(TIMERCaptureStop() == ZACWIRE_FRAME_EDGES);
+	CHECK(buffer[ZACWIRE_FRAME_EDGES] == 0xA5A5);
+	if ((first < 0) || (CapturedCount != ZACWIRE_FRAME_EDGES)) return;
+	Stamp(stamps, &line->Time[first], ZACWIRE_FRAME_EDGES, start, frequency);
+	CHECK(memcmp(buffer, stamps, sizeof(stamps)) == 0);
+	// Synchronized captures hold a whole frame, the one missing an edge is skipped
+	if (gap) {
+		int frame = line->Frame[first];
+		CHECK((first == 0) || (line->Frame[first - 1] != frame));
+		CHECK(frame != missingFrame);
+		CHECK(ZACWireDecode(buffer, ZACWIRE_FRAME_EDGES, &value) == ZACWireOK);
+		CHECK(value == line->Value[frame]);
+	}
+}
+
+static void TestCapture(void) {
+	static LINE line;
+	for (int r = 0; r < TEST_CAPTURES; r++) {
+		uint32_t frequency = Frequencies[r % 4];
+		int missingFrame = (rand() % 4) ? -1 : rand() % 2;
+		int64_t start;
+		MakeLine(&line, FRAME_PERIOD_NS, missingFrame);
+		switch ((r / 4) % 3) {
+		case 0:			// In the idle time before the first frame
+			start = rand() % (FRAME_PERIOD_NS - 2000000);
+			break;
+		case 1:			// Less than a gap before the first frame
+			start = line.Time[0] - rand() % (2 * ZACWIRE_FRAME_GAP * 1000);
+			break;
+		default:		// Inside the first frame
+			start = line.Time[0] + rand() % (line.Time[ZACWIRE_FRAME_EDGES - 1] - line.Time[0]);
+			break;
+		}
+		Capture(&line, start, frequency, ZACWIRE_FRAME_GAP, missingFrame);
+	}
+	// Without a gap the capture starts with the first edge, not necessarily on a frame start
+	for (int r = 0; r < TEST_CAPTURES / 10; r++) {
+		MakeLine(&line, FRAME_PERIOD_NS, -1);
+		int64_t start = line.Time[0] + rand() % (line.Time[ZACWIRE_FRAME_EDGES - 1] - line.Time[0]);
+		Capture(&line, start, Frequencies[r % 4], 0, -1);
+	}
+	// Edges stamped right after an overflow flagged in the same IRQ were met
+	CHECK(Overflows > 0);
+	CHECK(OverflowEdges > 0);
+	// Idle time of 2^32 ticks and half a gap, which is less than a gap when counted in 32 bits
+	MakeLine(&line, 0, -1);
+	int64_t shift = (int64_t)(0x100000000ULL * 1000000000ULL / Frequencies[3]) + ZACWIRE_FRAME_GAP * 500LL - line.Time[0];
+	for (int i = 0; i < line.Count; i++) line.Time[i] += shift;
+	Capture(&line, 0, Frequencies[3], ZACWIRE_FRAME_GAP, -1);
+}
+
+/*******************************************************************
+** Emulated seams                                                 **
+*******************************************************************/
+void INTTimerCapture_Handler(int count) {
+	CapturedCount = count;
+}
+
+void TIMER_InitCC(TIMER_TypeDef* timer, unsigned int ch, const TIMER_InitCC_TypeDef* init) {
+	CHECK((timer == TIMER0) && (ch == 0));
+	CHECK((init->mode == timerCCModeCapture) && (init->edge == timerEdgeBoth) && init->prsInput);
+}
+
+void TIMER_Init(TIMER_TypeDef* timer, const TIMER_Init_TypeDef* init) {
+	CHECK(!init->enable && (init->prescale == 0));
+	timer->CMD = 0;
+}
+
+void TIMER_Enable(TIMER_TypeDef* timer, bool enable) {
+	timer->CMD = (enable) ? TIMER_CMD_START : TIMER_CMD_STOP;
+}
+
+void TIMER_Reset(TIMER_TypeDef* timer) {
+	memset(timer, 0, sizeof(*timer));
+	FifoCount = 0;
+}
+
+uint32_t TIMER_CaptureGet(TIMER_TypeDef* timer, unsigned int ch) {
+	unsigned short value = Fifo[0];
+	CHECK(FifoCount > 0);
+	Fifo[0] = Fifo[1];
+	if (FifoCount) FifoCount--;
+	timer->STATUS = (FifoCount) ? TIMER_STATUS_ICV0 : 0;
+	return value;
+}
+
+void CMU_ClockEnable(CMU_Clock_TypeDef clock, bool enable) {
+	CHECK((clock == cmuClock_PRS) || (clock == cmuClock_TIMER0));
+}
+
+uint32_t CMU_ClockFreqGet(CMU_Clock_TypeDef clock) {
+	CHECK(clock == cmuClock_TIMER0);
+	return Frequency;
+}
+
+void PRS_SourceAsyncSignalSet(unsigned int ch, uint32_t source, uint32_t signal) {
+	CHECK(source == PRS_CH_CTRL_SOURCESEL_GPIOH);
+	CHECK(signal == (Port.pin & 0x07));
+	EmuPrs.CH[ch].CTRL = source | signal;
+}
+
+void NVIC_DisableIRQ(IRQn_Type IRQn) {
+	CHECK(IRQn == TIMER0_IRQn);
+}
+
+void SystemDefinePortIrq(const SystemPort p, GPIOIRQ IRQMode) {
+	CHECK(IRQMode == GPIOIRQNone);
+}
+
+void SystemIRQEnable(int IRQn) {
+	CHECK(IRQn == TIMER0_IRQn);
+}
+
+void TimeBaseInit(void) { }
+
+uint32_t TimeBaseGetTicks(void) {
+	return 0xFFFFF000UL;
+}
+
+void TimeBaseSetCompare(TIMEBASE_CHANNEL channel, uint32_t target) {
+	CHECK((channel == TimeBaseTimerChannel) && (target == (uint32_t)(0xFFFFF000UL + 32768)));
+}
+
+void TimeBaseStopCompare(TIMEBASE_CHANNEL channel) {
+	CHECK(channel == TimeBaseTimerChannel);
+}
+
+int main(void) {
+	srand(29);
+	TestDecode();
+	TestParity();
+	TestMissingEdge();
+	TestTemperature();
+	TestCapture();
+	// Capture arguments
+	unsigned short buffer[ZACWIRE_FRAME_EDGES];
+	const SystemPort invalid = SYSTEMPORT_INVALID;
+	CHECK(!TIMERCaptureStart(invalid, buffer, ZACWIRE_FRAME_EDGES, ZACWIRE_FRAME_GAP));
+	CHECK(!TIMERCaptureStart(Port, NULL, ZACWIRE_FRAME_EDGES, ZACWIRE_FRAME_GAP));
+	CHECK(!TIMERCaptureStart(Port, buffer, 0, ZACWIRE_FRAME_GAP));
+	TIMERInit();
+	TIMERStart(1000);
+	TIMERStop();
+	return TEST_END();
+}
@@ -0,0 +1,217 @@
+/*******************************************************************
+**                                                                **
+** Crash record decoder (Linux host)                              **
+**                                                                **
+*******************************************************************/
+/*
+ * Decodes the crash record saved by src/crash.c, or the compact report sent as an uplink,
+ * and symbolizes the code addresses with the firmware ELF file.
+ *
+ *   crash_decode [-e S40.elf] page.bin		crash Flash Memory page, e.g. read with
+ *											commander readmem --range <_CRASHPAGE_>:+2048
+ *   crash_decode [-e S40.elf] -r <hex>		MSG_SKT_DEV_CRASH uplink payload
+ *
+ * The addresses are symbolized by $ADDR2LINE (arm-none-eabi-addr2line by default). The
+ * record layout is the one of inc/crash.h, which is the same on the target and on the host.
+ */
+
+#include <ctype.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "crash.h"
+#include "crc16.h"
+
+/** @cond */
+#define CRASH_MAGIC			0x48535243UL	// Same as src/crash.c
+#define CRASH_VERSION		1
+#define CRASH_PAGE_SIZE		2048
+#define CRASH_CORE_SIZE		offsetof(CRASH_RECORD, TasksCrc)
+#define FLASH_END			0x00040000UL	// Code addresses (EFM32JG1B256)
+
+typedef struct {
+	uint32_t	Mask;
+	const char*	Name;
+} FAULT_BIT;
+
+static const char* Causes[] = { "Unknown", "Hard Fault", "Stack Overflow", "Assert", "Error Code" };
+static const FAULT_BIT CfsrBits[] = {
+	{ 1UL << 0, "IACCVIOL" }, { 1UL << 1, "DACCVIOL" }, { 1UL << 3, "MUNSTKERR" },
+	{ 1UL << 4, "MSTKERR" }, { 1UL << 5, "MLSPERR" }, { 1UL << 7, "MMARVALID" },
+	{ 1UL << 8, "IBUSERR" }, { 1UL << 9, "PRECISERR" }, { 1UL << 10, "IMPRECISERR" },
+	{ 1UL << 11, "UNSTKERR" }, { 1UL << 12, "STKERR" }, { 1UL << 13, "LSPERR" },
+	{ 1UL << 15, "BFARVALID" }, { 1UL << 16, "UNDEFINSTR" }, { 1UL << 17, "INVSTATE" },
+	{ 1UL << 18, "INVPC" }, { 1UL << 19, "NOCP" }, { 1UL << 24, "UNALIGNED" },
+	{ 1UL << 25, "DIVBYZERO" }, { 0, NULL }
+};
+static const FAULT_BIT HfsrBits[] = {
+	{ 1UL << 1, "VECTTBL" }, { 1UL << 30, "FORCED" }, { 1UL << 31, "DEBUGEVT" }, { 0, NULL }
+};
+
+static const char* Elf = NULL;
+/** @endcond */
+
+/*
+ * Function and source line of a code address, empty without ELF file
+ */
+static const char* Symbol(uint32_t address) {
+	static char symbol[512];
+	char command[1024];
+	const char* addr2line = getenv("ADDR2LINE");
+	FILE* pipe;
+	symbol[0] = 0;
+	if (!Elf || (address >= FLASH_END)) return symbol;
+	snprintf(command, sizeof(command), "%s -f -C -p -e '%s' 0x%08lX",
+			addr2line ? addr2line : "arm-none-eabi-addr2line", Elf, (unsigned long)(address & ~1UL));
+	pipe = popen(command, "r");
+	if (!pipe) return symbol;
+	if (fgets(symbol, sizeof(symbol), pipe)) symbol[strcspn(symbol, "\r\n")] = 0;
+	pclose(pipe);
+	if (strncmp(symbol, "??", 2) == 0) symbol[0] = 0;
+	return symbol;
+}
+
+static void PrintBits(uint32_t value, const FAULT_BIT* bits) {
+	for (; bits->Name; bits++)
+		if (value & bits->Mask) printf(" %s", bits->Name);
+}
+
+static void PrintCode(const char* name, uint32_t address) {
+	printf("- %16s : %08lX %s\n", name, (unsigned long)address, Symbol(address));
+}
+
+/*
+ * Stack words, the ones that look like return addresses (Thumb bit set, in Flash Memory) are symbolized
+ */
+static void PrintWords(uint32_t address, const uint32_t* words, int count) {
+	for (int i = 0; i < count; i++) {
+		printf("  %08lX : %08lX", (unsigned long)(address + i * 4), (unsigned long)words[i]);
+		if ((words[i] & 1) && (words[i] < FLASH_END)) printf(" %s", Symbol(words[i]));
+		printf("\n");
+	}
+}
+
+static const char* Cause(uint8_t cause) {
+	return Causes[(cause <= CrashErrorCode) ? cause : 0];
+}
+
+static int DecodeRecord(const char* file) {
+	static uint8_t page[CRASH_PAGE_SIZE];
+	CRASH_RECORD record;
+	FILE* f = fopen(file, "rb");
+	size_t size;
+	if (!f) {
+		perror(file);
+		return 1;
+	}
+	size = fread(page, 1, sizeof(page), f);
+	fclose(f);
+	if (size < sizeof(record)) {
+		fprintf(stderr, "%s: %zu bytes, a crash record needs %zu\n", file, size, sizeof(record));
+		return 1;
+	}
+	memcpy(&record, page, sizeof(record));
+	if (record.Magic != CRASH_MAGIC) {
+		printf("No crash record (magic %08lX)\n", (unsigned long)record.Magic);
+		return 1;
+	}
+	if (record.Version != CRASH_VERSION) {
+		printf("Unknown crash record version %u\n", record.Version);
+		return 1;
+	}
+	if (record.Crc != CRC16_CalculateRange(&record.Version, CRASH_CORE_SIZE - offsetof(CRASH_RECORD, Version), 0xFFFF)) {
+		printf("Crash record CRC error\n");
+		return 1;
+	}
+	printf("- %16s : %s\n", "Cause", Cause(record.Cause));
+	printf("- %16s : %08lX\n", "Code", (unsigned long)record.Code);
+	printf("- %16s : %08lX\n", "Argument", (unsigned long)record.Arg);
+	printf("- %16s : %lu ticks\n", "Uptime", (unsigned long)record.Ticks);
+	printf("- %16s : %.*s\n", "Task", CRASH_NAME_SIZE, record.Task);
+	printf("- %16s : %s\n", "Reported", (record.Reported == 0) ? "Yes" : "No");
+	printf("- %16s : %08lX %08lX %08lX %08lX\n", "R0-R3", (unsigned long)record.Registers[0],
+			(unsigned long)record.Registers[1], (unsigned long)record.Registers[2], (unsigned long)record.Registers[3]);
+	printf("- %16s : %08lX\n", "R12", (unsigned long)record.Registers[4]);
+	PrintCode("LR", record.Registers[5]);
+	PrintCode("PC", record.Registers[6]);
+	printf("- %16s : %08lX\n", "xPSR", (unsigned long)record.Registers[7]);
+	printf("- %16s : %08lX\n", "EXC_RETURN", (unsigned long)record.ExcReturn);
+	printf("- %16s : %08lX", "CFSR", (unsigned long)record.Cfsr);
+	PrintBits(record.Cfsr, CfsrBits);
+	printf("\n- %16s : %08lX", "HFSR", (unsigned long)record.Hfsr);
+	PrintBits(record.Hfsr, HfsrBits);
+	printf("\n");
+	if (record.Cfsr & (1UL << 7)) printf("- %16s : %08lX\n", "MMFAR", (unsigned long)record.Mmfar);
+	if (record.Cfsr & (1UL << 15)) printf("- %16s : %08lX\n", "BFAR", (unsigned long)record.Bfar);
+	printf("- %16s : %08lX\n", "SP", (unsigned long)record.Sp);
+	PrintWords(record.Sp, record.Stack, CRASH_STACK_WORDS);
+	if ((record.TasksCount > CRASH_TASKS) || (record.TasksCrc != CRC16_CalculateRange(&record.TasksCount,
+			sizeof(record) - offsetof(CRASH_RECORD, TasksCount), 0xFFFF))) {
+		printf("- %16s : not saved\n", "Tasks");
+		record.TasksCount = 0;
+	}
+	for (int i = 0; i < record.TasksCount; i++) {
+		const CRASH_TASK* task = &record.Tasks[i];
+		printf("- %16.*s : TCB %08lX, SP %08lX, Stack %08lX, Free %u, Priority %u%s\n", CRASH_NAME_SIZE,
+				task->Name, (unsigned long)task->Tcb, (unsigned long)task->Sp, (unsigned long)task->StackBase,
+				task->HighWater, task->Priority, task->Running ? ", Running" : "");
+		PrintWords(task->Sp, task->Stack, CRASH_TASK_WORDS);
+	}
+	printf("- %16s :\n%.*s\n", "Trace", CRASH_TRACE_SIZE, record.Trace);
+	return 0;
+}
+
+static uint32_t Get32(const uint8_t* p) {
+	return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+}
+
+/*
+ * Compact report, as encoded by CRASH_Encode
+ */
+static int DecodeReport(const char* hex) {
+	uint8_t report[CRASH_REPORT_SIZE];
+	int size = 0;
+	while (*hex && (size < CRASH_REPORT_SIZE)) {
+		unsigned int byte;
+		if (isspace((unsigned char)*hex) || (*hex == ':')) {
+			hex++;
+			continue;
+		}
+		if (sscanf(hex, "%2x", &byte) != 1) break;
+		report[size++] = (uint8_t)byte;
+		hex += 2;
+	}
+	if ((size != CRASH_REPORT_SIZE) || (report[0] != CRASH_VERSION)) {
+		fprintf(stderr, "Not a version %d crash report of %d bytes\n", CRASH_VERSION, CRASH_REPORT_SIZE);
+		return 1;
+	}
+	printf("- %16s : %s\n", "Cause", Cause(report[1]));
+	printf("- %16s : %08lX\n", "Code", (unsigned long)Get32(&report[2]));
+	printf("- %16s : %lu s\n", "Uptime", (unsigned long)Get32(&report[6]));
+	PrintCode("PC", Get32(&report[10]));
+	PrintCode("LR", Get32(&report[14]));
+	printf("- %16s : %08lX", "CFSR", (unsigned long)Get32(&report[18]));
+	PrintBits(Get32(&report[18]), CfsrBits);
+	printf("\n- %16s : %08lX", "HFSR", (unsigned long)Get32(&report[22]));
+	PrintBits(Get32(&report[22]), HfsrBits);
+	printf("\n- %16s : %.8s\n", "Task", (const char*)&report[26]);
+	return 0;
+}
+
+static int Usage(void) {
+	fprintf(stderr, "usage: crash_decode [-e firmware.elf] page.bin\n"
+			"       crash_decode [-e firmware.elf] -r <report hex>\n");
+	return 2;
+}
+
+int main(int argc, char* argv[]) {
+	int i = 1;
+	if ((argc > i + 1) && (strcmp(argv[i], "-e") == 0)) {
+		Elf = argv[i + 1];
+		i += 2;
+	}
+	if ((argc == i + 2) && (strcmp(argv[i], "-r") == 0)) return DecodeReport(argv[i + 1]);
+	if (argc == i + 1) return DecodeRecord(argv[i]);
+	return Usage();
+}